@@ -46,6 +46,25 @@ infinoted_config_reload_update_connection_sasl_context(InfXmlConnection* xml,
   );
 }
 
+static void
+infinoted_config_reload_update_send_queue(InfdXmppServer* xmpp,
+                                          guint send_queue)
+{
+  InfdTcpServer* tcp;
+
+  g_object_get(G_OBJECT(xmpp), "tcp-server", &tcp, NULL);
+
+  /* This only affects connections accepted from now on */
+  g_object_set(
+    G_OBJECT(tcp),
+    "send-queue-high-watermark", send_queue,
+    "send-queue-low-watermark", send_queue / 4,
+    NULL
+  );
+
+  g_object_unref(tcp);
+}
+
 /**
  * infinoted_config_reload:
  * @run: A #InfinotedRun.
@@ -65,6 +84,7 @@ infinoted_config_reload(InfinotedRun* run,
   gnutls_dh_params_t dh_params;
   InfdTcpServer* tcp6;
   InfdTcpServer* tcp4;
+  guint send_queue;
 
   guint port;
   InfIpAddress* addr4;
@@ -162,6 +182,8 @@ infinoted_config_reload(InfinotedRun* run,
       "io", run->io,
       "local-address", addr6,
       "local-port", startup->options->port,
+      "backlog", startup->options->listen_backlog,
+      "reuse-port", startup->options->reuse_port,
       NULL
     );
 
@@ -179,6 +201,8 @@ infinoted_config_reload(InfinotedRun* run,
       "io", run->io,
       "local-address", addr4,
       "local-port", startup->options->port,
+      "backlog", startup->options->listen_backlog,
+      "reuse-port", startup->options->reuse_port,
       NULL
     );
 
@@ -315,6 +339,12 @@ infinoted_config_reload(InfinotedRun* run,
 
       g_object_unref(tcp6);
 
+      g_object_set(
+        G_OBJECT(run->xmpp6),
+        "admission-control", run->admission_control,
+        NULL
+      );
+
       infd_server_pool_add_server(run->pool, INFD_XML_SERVER(run->xmpp6));
 
 #ifdef LIBINFINITY_HAVE_AVAHI
@@ -338,6 +368,12 @@ infinoted_config_reload(InfinotedRun* run,
 
       g_object_unref(tcp4);
 
+      g_object_set(
+        G_OBJECT(run->xmpp4),
+        "admission-control", run->admission_control,
+        NULL
+      );
+
       infd_server_pool_add_server(run->pool, INFD_XML_SERVER(run->xmpp4));
 
 #ifdef LIBINFINITY_HAVE_AVAHI
@@ -375,6 +411,12 @@ infinoted_config_reload(InfinotedRun* run,
     }
   }
 
+  send_queue = MIN(startup->options->max_send_queue, G_MAXUINT / 1024) * 1024;
+  if(run->xmpp6 != NULL)
+    infinoted_config_reload_update_send_queue(run->xmpp6, send_queue);
+  if(run->xmpp4 != NULL)
+    infinoted_config_reload_update_send_queue(run->xmpp4, send_queue);
+
   /* Now, re-initialize plugins. This is a bit tricky, because it can fail,
    * and because we need to unload the previous plugins first.
    *
@@ -405,6 +447,24 @@ infinoted_config_reload(InfinotedRun* run,
     g_object_unref(filesystem_account_storage);
   }
 
+  g_object_set(
+    G_OBJECT(run->directory),
+    "memory-budget",
+    (guint64)startup->options->max_session_memory * 1024 * 1024,
+    "drop-congested-subscribers",
+    startup->options->max_send_queue > 0,
+    NULL
+  );
+
+  g_object_set(
+    G_OBJECT(run->admission_control),
+    "max-connections", startup->options->max_connections,
+    "max-handshakes", startup->options->max_handshakes,
+    "connection-rate", startup->options->connection_rate,
+    "connection-burst", startup->options->connection_burst,
+    NULL
+  );
+
 #ifdef G_OS_WIN32
   module_path = g_win32_get_package_installation_directory_of_module(NULL);
   plugin_path = g_build_filename(module_path, "lib", PLUGIN_PATH, NULL);
@@ -416,7 +476,8 @@ infinoted_config_reload(InfinotedRun* run,
   plugin_manager = infinoted_plugin_manager_new(
     run->directory,
     startup->log,
-    startup->credentials
+    startup->credentials,
+    run->admission_control
   );
 
   local_error = NULL;
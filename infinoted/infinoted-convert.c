@@ -0,0 +1,294 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Converts text documents in an infinoted root directory between the XML
+ * format and the compact binary format. The server should not be running
+ * on the same root directory while documents are converted. */
+
+#include "config.h"
+
+#include <libinftext/inf-text-filesystem-format.h>
+#include <libinftext/inf-text-default-buffer.h>
+
+#include <libinfinity/server/infd-filesystem-storage.h>
+#include <libinfinity/common/inf-init.h>
+#include <libinfinity/inf-i18n.h>
+
+#include <locale.h>
+#include <string.h>
+#include <stdio.h>
+
+typedef struct _InfinotedConvert InfinotedConvert;
+struct _InfinotedConvert {
+  InfdFilesystemStorage* storage;
+  gboolean compact;
+  gboolean compress;
+
+  guint n_converted;
+  guint n_failed;
+};
+
+static gboolean
+infinoted_convert_document(InfinotedConvert* convert,
+                           const gchar* path,
+                           GError** error)
+{
+  InfUserTable* user_table;
+  InfTextBuffer* buffer;
+  gboolean result;
+
+  user_table = inf_user_table_new();
+  buffer = INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
+
+  result = inf_text_filesystem_format_read(
+    convert->storage,
+    path,
+    user_table,
+    buffer,
+    error
+  );
+
+  if(result == TRUE)
+  {
+    if(convert->compact == TRUE)
+    {
+      result = inf_text_filesystem_format_write_compact(
+        convert->storage,
+        path,
+        user_table,
+        buffer,
+        convert->compress,
+        error
+      );
+    }
+    else
+    {
+      result = inf_text_filesystem_format_write(
+        convert->storage,
+        path,
+        user_table,
+        buffer,
+        error
+      );
+    }
+  }
+
+  g_object_unref(buffer);
+  g_object_unref(user_table);
+  return result;
+}
+
+static void
+infinoted_convert_path(InfinotedConvert* convert,
+                       const gchar* path)
+{
+  GSList* list;
+  GSList* item;
+  InfdStorageNode* node;
+  gchar* child_path;
+  GError* error;
+
+  error = NULL;
+  list = infd_storage_read_subdirectory(
+    INFD_STORAGE(convert->storage),
+    path,
+    &error
+  );
+
+  if(error != NULL)
+  {
+    fprintf(stderr, "%s: %s\n", path, error->message);
+    g_error_free(error);
+    ++convert->n_failed;
+    return;
+  }
+
+  for(item = list; item != NULL; item = item->next)
+  {
+    node = (InfdStorageNode*)item->data;
+
+    if(strcmp(path, "/") == 0)
+      child_path = g_strconcat("/", node->name, NULL);
+    else
+      child_path = g_strconcat(path, "/", node->name, NULL);
+
+    if(node->type == INFD_STORAGE_NODE_SUBDIRECTORY)
+    {
+      infinoted_convert_path(convert, child_path);
+    }
+    else if(strcmp(node->identifier, "InfText") == 0)
+    {
+      if(infinoted_convert_document(convert, child_path, &error))
+      {
+        printf("%s\n", child_path);
+        ++convert->n_converted;
+      }
+      else
+      {
+        fprintf(stderr, "%s: %s\n", child_path, error->message);
+        g_error_free(error);
+        error = NULL;
+        ++convert->n_failed;
+      }
+    }
+
+    g_free(child_path);
+  }
+
+  infd_storage_node_list_free(list);
+}
+
+int
+main(int argc,
+     char* argv[])
+{
+  InfinotedConvert convert;
+  GOptionContext* context;
+  GError* error;
+  gchar* root_directory;
+  gchar* format;
+  gboolean compress;
+  int i;
+
+  GOptionEntry entries[] = {
+    { "root-directory", 'r', 0,
+      G_OPTION_ARG_FILENAME, NULL,
+      N_("The directory containing the documents to convert"),
+      N_("DIRECTORY") },
+    { "format", 'f', 0,
+      G_OPTION_ARG_STRING, NULL,
+      N_("The format to convert the documents to, either \"xml\" or "
+         "\"compact\". Defaults to \"compact\"."),
+      N_("FORMAT") },
+    { "compress", 'z', 0,
+      G_OPTION_ARG_NONE, NULL,
+      N_("Compress documents written in the compact format"), NULL },
+    { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL }
+  };
+
+  setlocale(LC_ALL, "");
+
+  root_directory = NULL;
+  format = NULL;
+  compress = FALSE;
+
+  entries[0].arg_data = &root_directory;
+  entries[1].arg_data = &format;
+  entries[2].arg_data = &compress;
+
+  error = NULL;
+  if(!inf_init(&error))
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return -1;
+  }
+
+  context = g_option_context_new(_("[PATH...] - convert text documents"));
+  g_option_context_add_main_entries(context, entries, GETTEXT_PACKAGE);
+
+  if(!g_option_context_parse(context, &argc, &argv, &error))
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    g_option_context_free(context);
+    return -1;
+  }
+
+  g_option_context_free(context);
+
+  if(root_directory == NULL)
+  {
+    fprintf(stderr, "%s\n", _("No root directory given"));
+    g_free(format);
+    return -1;
+  }
+
+  if(format == NULL || strcmp(format, "compact") == 0)
+  {
+    convert.compact = TRUE;
+  }
+  else if(strcmp(format, "xml") == 0)
+  {
+    convert.compact = FALSE;
+  }
+  else
+  {
+    fprintf(stderr, _("Invalid format: \"%s\"\n"), format);
+    g_free(format);
+    g_free(root_directory);
+    return -1;
+  }
+
+  g_free(format);
+
+  if(compress && !convert.compact)
+  {
+    fprintf(stderr, "%s\n",
+            _("Compression is only available for the compact format"));
+    g_free(root_directory);
+    return -1;
+  }
+
+  convert.storage = infd_filesystem_storage_new(root_directory);
+  convert.compress = compress;
+  convert.n_converted = 0;
+  convert.n_failed = 0;
+  g_free(root_directory);
+
+  if(argc < 2)
+  {
+    infinoted_convert_path(&convert, "/");
+  }
+  else
+  {
+    for(i = 1; i < argc; ++i)
+    {
+      if(infinoted_convert_document(&convert, argv[i], &error))
+      {
+        printf("%s\n", argv[i]);
+        ++convert.n_converted;
+      }
+      else
+      {
+        fprintf(stderr, "%s: %s\n", argv[i], error->message);
+        g_error_free(error);
+        error = NULL;
+        ++convert.n_failed;
+      }
+    }
+  }
+
+  g_object_unref(convert.storage);
+  inf_deinit();
+
+  fprintf(
+    stderr,
+    _("Converted %u documents, %u failed\n"),
+    convert.n_converted,
+    convert.n_failed
+  );
+
+  if(convert.n_failed > 0)
+    return -1;
+
+  return 0;
+}
+
+/* vim:set et sw=2 ts=2: */
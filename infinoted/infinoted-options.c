@@ -101,6 +101,83 @@ const InfinotedParameterInfo INFINOTED_OPTIONS[] = {
     0,
     N_("The IP address to listen on."),
     N_("ADDRESS"),
+  }, {
+    "listen-backlog",
+    INFINOTED_PARAMETER_INT,
+    0,
+    offsetof(InfinotedOptions, listen_backlog),
+    infinoted_parameter_convert_positive,
+    0,
+    N_("Maximum number of incoming connections that the operating system "
+       "queues before the server accepts them. Raise this if many clients "
+       "connect at the same time. [Default=128]"),
+    N_("CONNECTIONS")
+  }, {
+    "reuse-port",
+    INFINOTED_PARAMETER_BOOLEAN,
+    0,
+    offsetof(InfinotedOptions, reuse_port),
+    infinoted_parameter_convert_boolean,
+    0,
+    N_("Allow other processes to listen on the same port, with incoming "
+       "connections being distributed among them. Only supported on some "
+       "platforms. [Default=false]"),
+    N_("true|false")
+  }, {
+    "max-connections",
+    INFINOTED_PARAMETER_INT,
+    0,
+    offsetof(InfinotedOptions, max_connections),
+    infinoted_parameter_convert_nonnegative,
+    0,
+    N_("Maximum number of clients that can be connected at the same time. "
+       "Further clients are rejected until others disconnect. 0 means no "
+       "limit. [Default=0]"),
+    N_("CONNECTIONS")
+  }, {
+    "max-handshakes",
+    INFINOTED_PARAMETER_INT,
+    0,
+    offsetof(InfinotedOptions, max_handshakes),
+    infinoted_parameter_convert_nonnegative,
+    0,
+    N_("Maximum number of clients that can perform the TLS handshake and "
+       "authentication at the same time. Limiting this keeps the server "
+       "responsive for connected clients when many clients connect at once. "
+       "0 means no limit. [Default=0]"),
+    N_("CONNECTIONS")
+  }, {
+    "connection-rate",
+    INFINOTED_PARAMETER_INT,
+    0,
+    offsetof(InfinotedOptions, connection_rate),
+    infinoted_parameter_convert_nonnegative,
+    0,
+    N_("Maximum number of new connections per minute from a single IP "
+       "address. 0 means no limit. [Default=0]"),
+    N_("CONNECTIONS")
+  }, {
+    "connection-burst",
+    INFINOTED_PARAMETER_INT,
+    0,
+    offsetof(InfinotedOptions, connection_burst),
+    infinoted_parameter_convert_positive,
+    0,
+    N_("Number of connections a single IP address can open in quick "
+       "succession before connection-rate applies. [Default=10]"),
+    N_("CONNECTIONS")
+  }, {
+    "max-send-queue",
+    INFINOTED_PARAMETER_INT,
+    0,
+    offsetof(InfinotedOptions, max_send_queue),
+    infinoted_parameter_convert_nonnegative,
+    0,
+    N_("Amount of data, in kilobytes, that may pile up for a client which "
+       "does not read fast enough. When the limit is exceeded, the client "
+       "is unsubscribed from all documents, and it needs to subscribe "
+       "again to continue editing. 0 means no limit. [Default=0]"),
+    N_("KILOBYTES")
   }, {
     "security-policy",
     INFINOTED_PARAMETER_STRING,
@@ -128,6 +205,19 @@ const InfinotedParameterInfo INFINOTED_OPTIONS[] = {
        "documents on the server, and where they are read from after a "
        "server restart. [Default=~/.infinote]"),
     N_("DIRECTORY")
+  }, {
+    "max-session-memory",
+    INFINOTED_PARAMETER_INT,
+    0,
+    offsetof(InfinotedOptions, max_session_memory),
+    infinoted_parameter_convert_nonnegative,
+    0,
+    N_("Approximate amount of memory, in megabytes, that documents loaded "
+       "into memory may occupy. When the limit is exceeded, cached data of "
+       "active sessions is dropped first, and then idle documents are "
+       "saved and unloaded, least recently used first, before their "
+       "regular unload timeout. 0 means no limit. [Default=0]"),
+    N_("MEGABYTES")
   }, {
     "plugins",
     INFINOTED_PARAMETER_STRING_LIST,
@@ -972,9 +1062,17 @@ infinoted_options_new(const gchar* const* config_files,
   options->create_certificate = FALSE;
   options->port = inf_protocol_get_default_port();
   options->listen_address = NULL;
+  options->listen_backlog = 128;
+  options->reuse_port = FALSE;
+  options->max_connections = 0;
+  options->max_handshakes = 0;
+  options->connection_rate = 0;
+  options->connection_burst = 10;
+  options->max_send_queue = 0;
   options->security_policy = INF_XMPP_CONNECTION_SECURITY_ONLY_TLS;
   options->root_directory =
     g_build_filename(g_get_home_dir(), ".infinote", NULL);
+  options->max_session_memory = 0;
   options->plugins = g_malloc(2 * sizeof(gchar*));
   options->plugins[0] = g_strdup("note-text");
   options->plugins[1] = NULL;
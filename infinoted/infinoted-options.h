@@ -40,8 +40,16 @@ struct _InfinotedOptions {
   gboolean create_certificate;
   guint port;
   InfIpAddress *listen_address;
+  guint listen_backlog;
+  gboolean reuse_port;
+  guint max_connections;
+  guint max_handshakes;
+  guint connection_rate;
+  guint connection_burst;
+  guint max_send_queue;
   InfXmppConnectionSecurityPolicy security_policy;
   gchar* root_directory;
+  guint max_session_memory;
 
   gchar** plugins;
 
@@ -42,6 +42,7 @@ struct _InfinotedPluginManagerPrivate {
   InfdDirectory* directory;
   InfinotedLog* log;
   InfCertificateCredentials* credentials;
+  InfdAdmissionControl* admission_control;
   gchar* path;
 
   GSList* plugins;
@@ -75,6 +76,7 @@ enum {
   PROP_DIRECTORY,
   PROP_LOG,
   PROP_CREDENTIALS,
+  PROP_ADMISSION_CONTROL,
   PROP_PATH
 };
 
@@ -720,6 +722,7 @@ infinoted_plugin_manager_init(InfinotedPluginManager* manager)
   priv->directory = NULL;
   priv->log = NULL;
   priv->credentials = NULL;
+  priv->admission_control = NULL;
   priv->path = NULL;
   priv->plugins = NULL;
   priv->connections = g_hash_table_new(NULL, NULL);
@@ -758,6 +761,12 @@ infinoted_plugin_manager_dispose(GObject* object)
     priv->credentials = NULL;
   }
 
+  if(priv->admission_control != NULL)
+  {
+    g_object_unref(priv->admission_control);
+    priv->admission_control = NULL;
+  }
+
   G_OBJECT_CLASS(infinoted_plugin_manager_parent_class)->dispose(object);
 }
 
@@ -812,6 +821,11 @@ infinoted_plugin_manager_set_property(GObject* object,
     g_assert(priv->credentials == NULL); /* construct only */
     priv->credentials = (InfCertificateCredentials*)g_value_dup_boxed(value);
     break;
+  case PROP_ADMISSION_CONTROL:
+    g_assert(priv->admission_control == NULL); /* construct only */
+    priv->admission_control =
+      (InfdAdmissionControl*)g_value_dup_object(value);
+    break;
   case PROP_PATH:
     /* read only */
   default:
@@ -843,6 +857,9 @@ infinoted_plugin_manager_get_property(GObject* object,
   case PROP_CREDENTIALS:
     g_value_set_boxed(value, priv->credentials);
     break;
+  case PROP_ADMISSION_CONTROL:
+    g_value_set_object(value, priv->admission_control);
+    break;
   case PROP_PATH:
     g_value_set_string(value, priv->path);
     break;
@@ -900,6 +917,18 @@ infinoted_plugin_manager_class_init(
     )
   );
 
+  g_object_class_install_property(
+    object_class,
+    PROP_ADMISSION_CONTROL,
+    g_param_spec_object(
+      "admission-control",
+      "Admission control",
+      "Decides which incoming connections the server serves",
+      INFD_TYPE_ADMISSION_CONTROL,
+      G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY
+    )
+  );
+
   g_object_class_install_property(
     object_class,
     PROP_PATH,
@@ -919,10 +948,12 @@ infinoted_plugin_manager_class_init(
  * @log: The #InfinotedLog to write log messages to.
  * @creds: (allow-none): The #InfCertificateCredentials used to secure data
  * transfer with the clients, or %NULL.
+ * @admission_control: (allow-none): The #InfdAdmissionControl deciding
+ * which connections the server accepts, or %NULL.
  *
- * Creates a new #InfinotedPluginManager with the given directory, log
- * and credentials. These three objects will be available for plugins
- * to enhance the infinoted functionality. Plugins can be loaded
+ * Creates a new #InfinotedPluginManager with the given directory, log,
+ * credentials and admission control. These objects will be available for
+ * plugins to enhance the infinoted functionality. Plugins can be loaded
  * with infinoted_plugin_manager_load().
  *
  * Returns: (transfer full): A new #InfinotedPluginManager.
@@ -930,7 +961,8 @@ infinoted_plugin_manager_class_init(
 InfinotedPluginManager*
 infinoted_plugin_manager_new(InfdDirectory* directory,
                              InfinotedLog* log,
-                             InfCertificateCredentials* creds)
+                             InfCertificateCredentials* creds,
+                             InfdAdmissionControl* admission_control)
 {
   GObject* object;
 
@@ -942,6 +974,7 @@ infinoted_plugin_manager_new(InfdDirectory* directory,
     "directory", directory,
     "log", log,
     "credentials", creds,
+    "admission-control", admission_control,
     NULL
   );
 
@@ -1095,6 +1128,25 @@ infinoted_plugin_manager_get_credentials(InfinotedPluginManager* manager)
   return INFINOTED_PLUGIN_MANAGER_PRIVATE(manager)->credentials;
 }
 
+/**
+ * infinoted_plugin_manager_get_admission_control:
+ * @manager: A #InfinotedPluginManager.
+ *
+ * Returns the #InfdAdmissionControl which decides which incoming
+ * connections the server accepts, or %NULL if the server accepts all
+ * connections.
+ *
+ * Returns: (transfer none) (allow-none): A #InfdAdmissionControl owned by
+ * the plugin manager, or %NULL.
+ */
+InfdAdmissionControl*
+infinoted_plugin_manager_get_admission_control(
+  InfinotedPluginManager* manager)
+{
+  g_return_val_if_fail(INFINOTED_IS_PLUGIN_MANAGER(manager), NULL);
+  return INFINOTED_PLUGIN_MANAGER_PRIVATE(manager)->admission_control;
+}
+
 /**
  * infinoted_plugin_manager_error_quark:
  *
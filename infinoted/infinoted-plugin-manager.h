@@ -35,6 +35,7 @@
 #include <infinoted/infinoted-log.h>
 
 #include <libinfinity/server/infd-directory.h>
+#include <libinfinity/server/infd-admission-control.h>
 
 #include <glib-object.h>
 
@@ -181,7 +182,8 @@ infinoted_plugin_manager_get_type(void) G_GNUC_CONST;
 InfinotedPluginManager*
 infinoted_plugin_manager_new(InfdDirectory* directory,
                              InfinotedLog* log,
-                             InfCertificateCredentials* creds);
+                             InfCertificateCredentials* creds,
+                             InfdAdmissionControl* admission_control);
 
 gboolean
 infinoted_plugin_manager_load(InfinotedPluginManager* manager,
@@ -202,6 +204,10 @@ infinoted_plugin_manager_get_log(InfinotedPluginManager* manager);
 InfCertificateCredentials*
 infinoted_plugin_manager_get_credentials(InfinotedPluginManager* manager);
 
+InfdAdmissionControl*
+infinoted_plugin_manager_get_admission_control(
+  InfinotedPluginManager* manager);
+
 GQuark
 infinoted_plugin_manager_error_quark(void);
 
@@ -67,8 +67,28 @@ infinoted_run_load_directory(InfinotedRun* run,
 
   infd_directory_enable_chat(run->directory, TRUE);
 
+  g_object_set(
+    G_OBJECT(run->directory),
+    "memory-budget",
+    (guint64)startup->options->max_session_memory * 1024 * 1024,
+    "drop-congested-subscribers",
+    startup->options->max_send_queue > 0,
+    NULL
+  );
+
   g_object_unref(communication_manager);
 
+  run->admission_control = INFD_ADMISSION_CONTROL(
+    g_object_new(
+      INFD_TYPE_ADMISSION_CONTROL,
+      "max-connections", startup->options->max_connections,
+      "max-handshakes", startup->options->max_handshakes,
+      "connection-rate", startup->options->connection_rate,
+      "connection-burst", startup->options->connection_burst,
+      NULL
+    )
+  );
+
   /* Load server plugins via plugin manager */
 #ifdef G_OS_WIN32
   module_path = g_win32_get_package_installation_directory_of_module(NULL);
@@ -81,7 +101,8 @@ infinoted_run_load_directory(InfinotedRun* run,
   run->plugin_manager = infinoted_plugin_manager_new(
     run->directory,
     startup->log,
-    startup->credentials
+    startup->credentials,
+    run->admission_control
   );
 
   result = infinoted_plugin_manager_load(
@@ -100,9 +121,11 @@ infinoted_run_load_directory(InfinotedRun* run,
     g_object_unref(storage);
 
     g_object_unref(run->plugin_manager);
+    g_object_unref(run->admission_control);
     g_object_unref(run->directory);
     g_object_unref(run->io);
     run->plugin_manager = NULL;
+    run->admission_control = NULL;
     run->directory = NULL;
     run->io = NULL;
     return FALSE;
@@ -129,9 +152,11 @@ infinoted_run_load_directory(InfinotedRun* run,
       g_object_unref(account_storage);
 
       g_object_unref(run->plugin_manager);
+      g_object_unref(run->admission_control);
       g_object_unref(run->directory);
       g_object_unref(run->io);
       run->plugin_manager = NULL;
+      run->admission_control = NULL;
       run->directory = NULL;
       run->io = NULL;
 
@@ -160,6 +185,11 @@ infinoted_run_create_server(InfinotedRun* run,
 {
   InfdTcpServer* tcp;
   InfdXmppServer* xmpp;
+  guint send_queue;
+
+  /* Connections are no longer considered congested when the queue has been
+   * drained to a quarter of the limit. */
+  send_queue = MIN(startup->options->max_send_queue, G_MAXUINT / 1024) * 1024;
 
   tcp = INFD_TCP_SERVER(
     g_object_new(
@@ -167,6 +197,10 @@ infinoted_run_create_server(InfinotedRun* run,
       "io", INF_IO(run->io),
       "local-address", address,
       "local-port", startup->options->port,
+      "backlog", startup->options->listen_backlog,
+      "reuse-port", startup->options->reuse_port,
+      "send-queue-high-watermark", send_queue,
+      "send-queue-low-watermark", send_queue / 4,
       NULL
     )
   );
@@ -187,6 +221,12 @@ infinoted_run_create_server(InfinotedRun* run,
     startup->sasl_context ? "PLAIN" : NULL
   );
 
+  g_object_set(
+    G_OBJECT(xmpp),
+    "admission-control", run->admission_control,
+    NULL
+  );
+
   infd_server_pool_add_server(run->pool, INFD_XML_SERVER(xmpp));
 
 #ifdef LIBINFINITY_HAVE_AVAHI
@@ -297,6 +337,7 @@ infinoted_run_new(InfinotedStartup* startup,
       g_object_unref(run->pool);
       g_object_unref(run->directory);
       g_object_unref(run->io);
+      g_object_unref(run->admission_control);
       g_slice_free(InfinotedRun, run);
       run = NULL;
     }
@@ -349,6 +390,7 @@ infinoted_run_free(InfinotedRun* run)
     run->plugin_manager = NULL;
   }
 
+  g_object_unref(run->admission_control);
   g_object_unref(run->io);
   g_object_unref(run->directory);
   g_object_unref(run->pool);
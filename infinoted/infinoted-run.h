@@ -27,6 +27,7 @@
 
 #include <libinfinity/server/infd-server-pool.h>
 #include <libinfinity/server/infd-directory.h>
+#include <libinfinity/server/infd-admission-control.h>
 #include <libinfinity/common/inf-standalone-io.h>
 #include <libinfinity/common/inf-discovery-avahi.h>
 
@@ -42,6 +43,7 @@ struct _InfinotedRun {
   InfdDirectory* directory;
   InfdServerPool* pool;
 
+  InfdAdmissionControl* admission_control;
   InfinotedPluginManager* plugin_manager;
 
   InfdXmppServer* xmpp4;
@@ -280,6 +280,129 @@ infinoted_startup_sasl_callback_set_error(InfXmppConnection* connection,
   }
 }
 
+typedef enum _InfinotedStartupSaslOutcome {
+  INFINOTED_STARTUP_SASL_PAM_SUCCEEDED,
+  INFINOTED_STARTUP_SASL_PAM_FAILED,
+  INFINOTED_STARTUP_SASL_PAM_NOT_ALLOWED,
+  INFINOTED_STARTUP_SASL_PASSWORD_SUCCEEDED,
+  INFINOTED_STARTUP_SASL_PASSWORD_WRONG
+} InfinotedStartupSaslOutcome;
+
+/* The outcome of a login attempt, collected in a SASL worker thread and
+ * reported in the main thread */
+typedef struct _InfinotedStartupSaslResult InfinotedStartupSaslResult;
+struct _InfinotedStartupSaslResult {
+  InfinotedStartup* startup;
+  InfinotedStartupSaslOutcome outcome;
+  gchar* username;
+  GError* error;
+};
+
+static void
+infinoted_startup_sasl_result_free(gpointer data)
+{
+  InfinotedStartupSaslResult* result;
+  result = (InfinotedStartupSaslResult*)data;
+
+  g_free(result->username);
+  if(result->error != NULL)
+    g_error_free(result->error);
+  g_slice_free(InfinotedStartupSaslResult, result);
+}
+
+/* This runs in the main thread after the SASL step has finished, so that the
+ * connection can be accessed safely. */
+static void
+infinoted_startup_sasl_result_func(InfSaslContextSession* session,
+                                   gpointer session_data,
+                                   gpointer user_data)
+{
+  InfinotedStartupSaslResult* result;
+  InfXmppConnection* xmpp;
+  gchar* remote_id;
+
+  result = (InfinotedStartupSaslResult*)user_data;
+  xmpp = INF_XMPP_CONNECTION(session_data);
+  g_object_get(xmpp, "remote-id", &remote_id, NULL);
+
+  switch(result->outcome)
+  {
+  case INFINOTED_STARTUP_SASL_PAM_SUCCEEDED:
+    infinoted_log_info(
+      result->startup->log,
+      _("User %s logged in from %s via PAM"),
+      result->username,
+      remote_id
+    );
+
+    break;
+  case INFINOTED_STARTUP_SASL_PAM_FAILED:
+    infinoted_log_warning(
+      result->startup->log,
+      _("User %s failed to log in from %s: PAM authentication failed"),
+      result->username,
+      remote_id
+    );
+
+    infinoted_startup_sasl_callback_set_error(
+      xmpp,
+      INF_AUTHENTICATION_DETAIL_ERROR_AUTHENTICATION_FAILED,
+      NULL
+    );
+
+    break;
+  case INFINOTED_STARTUP_SASL_PAM_NOT_ALLOWED:
+    infinoted_log_warning(
+      result->startup->log,
+      _("User %s failed to log in from %s: PAM user not allowed"),
+      result->username,
+      remote_id
+    );
+
+    infinoted_startup_sasl_callback_set_error(
+      xmpp,
+      INF_AUTHENTICATION_DETAIL_ERROR_USER_NOT_AUTHORIZED,
+      result->error
+    );
+
+    break;
+  case INFINOTED_STARTUP_SASL_PASSWORD_SUCCEEDED:
+    infinoted_log_info(
+      result->startup->log,
+      _("User %s logged in from %s via password"),
+      result->username,
+      remote_id
+    );
+
+    break;
+  case INFINOTED_STARTUP_SASL_PASSWORD_WRONG:
+    infinoted_log_warning(
+      result->startup->log,
+      _("User %s failed to log in from %s: wrong password"),
+      result->username,
+      remote_id
+    );
+
+    infinoted_startup_sasl_callback_set_error(
+      xmpp,
+      INF_AUTHENTICATION_DETAIL_ERROR_AUTHENTICATION_FAILED,
+      NULL
+    );
+
+    break;
+  default:
+    g_assert_not_reached();
+    break;
+  }
+
+  g_free(remote_id);
+}
+
+/* This runs in a worker thread of the SASL context, so that PAM can block
+ * without stalling the server. It only reads the options, which do not
+ * change while the context is in use. It must not access the connection
+ * given as session_data, so the outcome is logged and reported to the
+ * connection by infinoted_startup_sasl_result_func() in the main thread. */
 static void
 infinoted_startup_sasl_callback(InfSaslContextSession* session,
                                 Gsasl_property prop,
@@ -287,21 +410,16 @@ infinoted_startup_sasl_callback(InfSaslContextSession* session,
                                 gpointer user_data)
 {
   InfinotedStartup* startup;
+  InfinotedStartupSaslResult* result;
   const char* username;
   const char* password;
-  InfXmppConnection* xmpp;
   gchar cmp;
   gsize password_len;
   gsize i;
 
 #ifdef LIBINFINITY_HAVE_PAM
   const gchar* pam_service;
-  GError* error;
 #endif
-  gchar* remote_id;
-
-  xmpp = INF_XMPP_CONNECTION(session_data);
-  g_object_get(xmpp, "remote-id", &remote_id, NULL);
 
   switch(prop)
   {
@@ -309,61 +427,28 @@ infinoted_startup_sasl_callback(InfSaslContextSession* session,
     startup = (InfinotedStartup*)user_data;
     username = inf_sasl_context_session_get_property(session, GSASL_AUTHID);
     password = inf_sasl_context_session_get_property(session, GSASL_PASSWORD);
+
+    result = g_slice_new(InfinotedStartupSaslResult);
+    result->startup = startup;
+    result->username = g_strdup(username);
+    result->error = NULL;
+
 #ifdef LIBINFINITY_HAVE_PAM
     pam_service = startup->options->pam_service;
     if(pam_service != NULL)
     {
-      error = NULL;
       if(!infinoted_pam_authenticate(pam_service, username, password))
       {
-        infinoted_log_warning(
-          startup->log,
-          _("User %s failed to log in from %s: PAM authentication failed"),
-          username,
-          remote_id
-        );
-
-        infinoted_startup_sasl_callback_set_error(
-          xmpp,
-          INF_AUTHENTICATION_DETAIL_ERROR_AUTHENTICATION_FAILED,
-          NULL
-        );
-
-        inf_sasl_context_session_continue(
-          session,
-          GSASL_AUTHENTICATION_ERROR
-        );
+        result->outcome = INFINOTED_STARTUP_SASL_PAM_FAILED;
       }
-      else if(!infinoted_pam_user_is_allowed(startup, username, &error))
+      else if(!infinoted_pam_user_is_allowed(startup, username,
+                                             &result->error))
       {
-        infinoted_log_warning(
-          startup->log,
-          _("User %s failed to log in from %s: PAM user not allowed"),
-          username,
-          remote_id
-        );
-
-        infinoted_startup_sasl_callback_set_error(
-          xmpp,
-          INF_AUTHENTICATION_DETAIL_ERROR_USER_NOT_AUTHORIZED,
-          error
-        );
-
-        inf_sasl_context_session_continue(
-          session,
-          GSASL_AUTHENTICATION_ERROR
-        );
+        result->outcome = INFINOTED_STARTUP_SASL_PAM_NOT_ALLOWED;
       }
       else
       {
-        infinoted_log_info(
-          startup->log,
-          _("User %s logged in from %s via PAM"),
-          username,
-          remote_id
-        );
-
-        inf_sasl_context_session_continue(session, GSASL_OK);
+        result->outcome = INFINOTED_STARTUP_SASL_PAM_SUCCEEDED;
       }
     }
     else
@@ -386,36 +471,29 @@ infinoted_startup_sasl_callback(InfSaslContextSession* session,
         cmp |= 0xFF;
 
       if(cmp == 0)
-      {
-        infinoted_log_info(
-          startup->log,
-          _("User %s logged in from %s via password"),
-          username,
-          remote_id
-        );
-
-        inf_sasl_context_session_continue(session, GSASL_OK);
-      }
+        result->outcome = INFINOTED_STARTUP_SASL_PASSWORD_SUCCEEDED;
       else
-      {
-        infinoted_log_warning(
-          startup->log,
-          _("User %s failed to log in from %s: wrong password"),
-          username,
-          remote_id
-        );
-
-        infinoted_startup_sasl_callback_set_error(
-          xmpp,
-          INF_AUTHENTICATION_DETAIL_ERROR_AUTHENTICATION_FAILED,
-          NULL
-        );
-
-        inf_sasl_context_session_continue(
-          session,
-          GSASL_AUTHENTICATION_ERROR
-        );
-      }
+        result->outcome = INFINOTED_STARTUP_SASL_PASSWORD_WRONG;
+    }
+
+    inf_sasl_context_session_set_result(
+      session,
+      infinoted_startup_sasl_result_func,
+      result,
+      infinoted_startup_sasl_result_free
+    );
+
+    if(result->outcome == INFINOTED_STARTUP_SASL_PAM_SUCCEEDED ||
+       result->outcome == INFINOTED_STARTUP_SASL_PASSWORD_SUCCEEDED)
+    {
+      inf_sasl_context_session_continue(session, GSASL_OK);
+    }
+    else
+    {
+      inf_sasl_context_session_continue(
+        session,
+        GSASL_AUTHENTICATION_ERROR
+      );
     }
 
     break;
@@ -423,8 +501,6 @@ infinoted_startup_sasl_callback(InfSaslContextSession* session,
     inf_sasl_context_session_continue(session, GSASL_AUTHENTICATION_ERROR);
     break;
   }
-
-  g_free(remote_id);
 }
 
 static gboolean
@@ -456,7 +532,7 @@ infinoted_startup_load(InfinotedStartup* startup,
     startup->sasl_context = inf_sasl_context_new(error);
     if(!startup->sasl_context) return FALSE;
 
-    inf_sasl_context_set_callback(
+    inf_sasl_context_set_blocking_callback(
       startup->sasl_context,
       infinoted_startup_sasl_callback,
       startup,
@@ -20,7 +20,9 @@
 #include "util/infinoted-plugin-util-navigate-browser.h"
 
 #include <infinoted/infinoted-plugin-manager.h>
+#include <libinfinity/adopted/inf-adopted-session.h>
 #include <libinfinity/common/inf-request-result.h>
+#include <libinfinity/common/inf-trace.h>
 #include <libinfinity/inf-i18n.h>
 
 #include <gio/gio.h>
@@ -58,6 +60,17 @@ static const gchar infinoted_plugin_dbus_introspection[] =
   "      <arg type='as' name='permissions' direction='in'/>"
   "      <arg type='a{sb}' name='sheet' direction='out'/>"
   "    </method>"
+  "    <method name='query_memory'>"
+  "      <arg type='t' name='budget' direction='out'/>"
+  "      <arg type='t' name='usage' direction='out'/>"
+  "      <arg type='u' name='evicted' direction='out'/>"
+  "    </method>"
+  "    <method name='query_trace'>"
+  "      <arg type='a(ssttat)' name='probes' direction='out'/>"
+  "    </method>"
+  "    <method name='query_sessions'>"
+  "      <arg type='a(sttttt)' name='sessions' direction='out'/>"
+  "    </method>"
   "  </interface>"
   "</node>";
 
@@ -75,6 +88,13 @@ struct _InfinotedPluginDbus {
   guint id;
 
   GSList* invocations; /* invocations currently being processed */
+  GSList* sessions; /* running sessions, accessed in the main thread only */
+};
+
+typedef struct _InfinotedPluginDbusSessionInfo InfinotedPluginDbusSessionInfo;
+struct _InfinotedPluginDbusSessionInfo {
+  InfSessionProxy* proxy;
+  InfBrowserIter iter;
 };
 
 typedef struct _InfinotedPluginDbusInvocation InfinotedPluginDbusInvocation;
@@ -684,6 +704,134 @@ infinoted_plugin_dbus_check_acl(InfinotedPluginDbus* plugin,
   infinoted_plugin_dbus_invocation_free(plugin, invocation);
 }
 
+static void
+infinoted_plugin_dbus_query_memory(InfinotedPluginDbus* plugin,
+                                   InfinotedPluginDbusInvocation* invocation)
+{
+  InfdDirectory* directory;
+  guint64 budget;
+
+  directory = infinoted_plugin_manager_get_directory(plugin->manager);
+  g_object_get(G_OBJECT(directory), "memory-budget", &budget, NULL);
+
+  g_dbus_method_invocation_return_value(
+    invocation->invocation,
+    g_variant_new(
+      "(ttu)",
+      budget,
+      infd_directory_get_memory_usage(directory),
+      infd_directory_get_n_evicted_sessions(directory)
+    )
+  );
+
+  infinoted_plugin_dbus_invocation_free(plugin, invocation);
+}
+
+static void
+infinoted_plugin_dbus_query_trace(InfinotedPluginDbus* plugin,
+                                  InfinotedPluginDbusInvocation* invocation)
+{
+  InfTraceHistogram histogram;
+  GVariantBuilder builder;
+  GVariant* buckets;
+  guint i;
+
+  /* Each probe is reported as name, unit, count, sum and the histogram
+   * buckets. The sum can be used to compute the mean value. */
+  g_variant_builder_init(&builder, G_VARIANT_TYPE("a(ssttat)"));
+  for(i = 0; i < INF_TRACE_N_PROBES; ++i)
+  {
+    inf_trace_get_histogram(i, &histogram);
+
+    buckets = g_variant_new_fixed_array(
+      G_VARIANT_TYPE_UINT64,
+      histogram.buckets,
+      INF_TRACE_N_BUCKETS,
+      sizeof(guint64)
+    );
+
+    g_variant_builder_add(
+      &builder,
+      "(sstt@at)",
+      inf_trace_probe_get_name(i),
+      inf_trace_probe_get_unit(i),
+      histogram.count,
+      histogram.sum,
+      buckets
+    );
+  }
+
+  g_dbus_method_invocation_return_value(
+    invocation->invocation,
+    g_variant_new("(a(ssttat))", &builder)
+  );
+
+  infinoted_plugin_dbus_invocation_free(plugin, invocation);
+}
+
+static void
+infinoted_plugin_dbus_query_sessions(InfinotedPluginDbus* plugin,
+                                     InfinotedPluginDbusInvocation* invocation)
+{
+  InfinotedPluginDbusSessionInfo* info;
+  InfSession* session;
+  InfSessionStatistics statistics;
+  InfAdoptedAlgorithm* algorithm;
+  InfAdoptedAlgorithmStatistics algorithm_statistics;
+  GVariantBuilder builder;
+  gchar* path;
+  GSList* item;
+
+  /* Each session is reported as path, processing time in nanoseconds,
+   * received, relayed and sent messages, and the number of
+   * transformations. All values are totals since the session was
+   * created; comparing two queries yields the current load. */
+  g_variant_builder_init(&builder, G_VARIANT_TYPE("a(sttttt)"));
+  for(item = plugin->sessions; item != NULL; item = item->next)
+  {
+    info = (InfinotedPluginDbusSessionInfo*)item->data;
+
+    g_object_get(G_OBJECT(info->proxy), "session", &session, NULL);
+    inf_session_get_statistics(session, &statistics);
+
+    algorithm_statistics.n_transformations = 0;
+    if(INF_ADOPTED_IS_SESSION(session))
+    {
+      algorithm =
+        inf_adopted_session_get_algorithm(INF_ADOPTED_SESSION(session));
+      if(algorithm != NULL)
+        inf_adopted_algorithm_get_statistics(algorithm, &algorithm_statistics);
+    }
+
+    g_object_unref(session);
+
+    path = inf_browser_get_path(
+      INF_BROWSER(infinoted_plugin_manager_get_directory(plugin->manager)),
+      &info->iter
+    );
+
+    g_variant_builder_add(
+      &builder,
+      "(sttttt)",
+      path,
+      statistics.processing_time,
+      statistics.n_messages_received,
+      statistics.n_messages_relayed,
+      statistics.n_messages_sent,
+      algorithm_statistics.n_transformations
+    );
+
+    g_free(path);
+  }
+
+  g_dbus_method_invocation_return_value(
+    invocation->invocation,
+    g_variant_new("(a(sttttt))", &builder)
+  );
+
+  infinoted_plugin_dbus_invocation_free(plugin, invocation);
+}
+
 static void
 infinoted_plugin_dbus_navigate_done(InfBrowser* browser,
                                     const InfBrowserIter* iter,
@@ -824,6 +972,19 @@ infinoted_plugin_dbus_main_invocation(gpointer user_data)
     if(navigate != NULL)
       invocation->navigate = navigate;
   }
+  /* These commands do not refer to a node in the directory */
+  else if(strcmp(invocation->method_name, "query_memory") == 0)
+  {
+    infinoted_plugin_dbus_query_memory(invocation->plugin, invocation);
+  }
+  else if(strcmp(invocation->method_name, "query_trace") == 0)
+  {
+    infinoted_plugin_dbus_query_trace(invocation->plugin, invocation);
+  }
+  else if(strcmp(invocation->method_name, "query_sessions") == 0)
+  {
+    infinoted_plugin_dbus_query_sessions(invocation->plugin, invocation);
+  }
   else
   {
     g_dbus_method_invocation_return_error_literal(
@@ -1033,6 +1194,7 @@ infinoted_plugin_dbus_info_initialize(gpointer plugin_info)
   plugin->loop = NULL;
   plugin->id = 0;
   plugin->invocations = NULL;
+  plugin->sessions = NULL;
 }
 
 static gboolean
@@ -1160,6 +1322,36 @@ infinoted_plugin_dbus_deinitialize(gpointer plugin_info)
   g_free(plugin->bus_name);
 }
 
+static void
+infinoted_plugin_dbus_session_added(const InfBrowserIter* iter,
+                                    InfSessionProxy* proxy,
+                                    gpointer plugin_info,
+                                    gpointer session_info)
+{
+  InfinotedPluginDbus* plugin;
+  InfinotedPluginDbusSessionInfo* info;
+
+  plugin = (InfinotedPluginDbus*)plugin_info;
+  info = (InfinotedPluginDbusSessionInfo*)session_info;
+
+  info->proxy = proxy;
+  info->iter = *iter;
+
+  plugin->sessions = g_slist_prepend(plugin->sessions, info);
+}
+
+static void
+infinoted_plugin_dbus_session_removed(const InfBrowserIter* iter,
+                                      InfSessionProxy* proxy,
+                                      gpointer plugin_info,
+                                      gpointer session_info)
+{
+  InfinotedPluginDbus* plugin;
+  plugin = (InfinotedPluginDbus*)plugin_info;
+
+  plugin->sessions = g_slist_remove(plugin->sessions, session_info);
+}
+
 static gboolean
 infinoted_plugin_dbus_parameter_convert_bus_type(gpointer out,
                                                  gpointer in,
@@ -1231,15 +1423,15 @@ const InfinotedPlugin INFINOTED_PLUGIN = {
   INFINOTED_PLUGIN_DBUS_OPTIONS,
   sizeof(InfinotedPluginDbus),
   0,
-  0,
+  sizeof(InfinotedPluginDbusSessionInfo),
   NULL,
   infinoted_plugin_dbus_info_initialize,
   infinoted_plugin_dbus_initialize,
   infinoted_plugin_dbus_deinitialize,
   NULL,
   NULL,
-  NULL,
-  NULL
+  infinoted_plugin_dbus_session_added,
+  infinoted_plugin_dbus_session_removed
 };
 
 /* vim:set et sw=2 ts=2: */
@@ -25,6 +25,7 @@
 
 #include <libinfinity/adopted/inf-adopted-session-record.h>
 #include <libinfinity/common/inf-cert-util.h>
+#include <libinfinity/common/inf-trace.h>
 
 #include <libinfinity/inf-signals.h>
 #include <libinfinity/inf-i18n.h>
@@ -41,10 +42,20 @@ struct _InfinotedPluginLogging {
   gboolean log_connection_errors;
   gboolean log_session_errors;
   gboolean log_session_request_extra;
+  guint session_statistics_interval;
+  guint admission_statistics_interval;
 
   /* TODO: Make this a hash table, and use the thread ID as a key */
   gchar* extra_message;
   InfSessionProxy* current_session;
+
+  GSList* sessions;
+  InfIoTimeout* statistics_timeout;
+  guint64 statistics_time;
+
+  /* Counters at the time of the previous admission report */
+  InfdAdmissionControlStatistics admission_statistics;
+  InfIoTimeout* admission_timeout;
 };
 
 typedef struct _InfinotedPluginLoggingSessionInfo
@@ -53,6 +64,18 @@ struct _InfinotedPluginLoggingSessionInfo {
   InfinotedPluginLogging* plugin;
   InfSessionProxy* proxy;
   InfBrowserIter iter;
+
+  /* Counters at the time of the previous statistics report */
+  InfSessionStatistics statistics;
+  guint64 n_transformations;
+};
+
+typedef struct _InfinotedPluginLoggingSessionLoad
+  InfinotedPluginLoggingSessionLoad;
+struct _InfinotedPluginLoggingSessionLoad {
+  InfinotedPluginLoggingSessionInfo* info;
+  InfSessionStatistics statistics;
+  guint64 n_transformations;
 };
 
 static gchar*
@@ -341,6 +364,230 @@ infinoted_pluggin_logging_session_error_cb(InfSession* session,
   info->plugin->extra_message = NULL;
 }
 
+static void
+infinoted_plugin_logging_session_get_counters(
+  InfinotedPluginLoggingSessionInfo* info,
+  InfSessionStatistics* statistics,
+  guint64* n_transformations)
+{
+  InfSession* session;
+  InfAdoptedAlgorithm* algorithm;
+  InfAdoptedAlgorithmStatistics algorithm_statistics;
+
+  g_object_get(G_OBJECT(info->proxy), "session", &session, NULL);
+  inf_session_get_statistics(session, statistics);
+
+  *n_transformations = 0;
+  if(INF_ADOPTED_IS_SESSION(session))
+  {
+    algorithm =
+      inf_adopted_session_get_algorithm(INF_ADOPTED_SESSION(session));
+
+    if(algorithm != NULL)
+    {
+      inf_adopted_algorithm_get_statistics(algorithm, &algorithm_statistics);
+      *n_transformations = algorithm_statistics.n_transformations;
+    }
+  }
+
+  g_object_unref(session);
+}
+
+static gint
+infinoted_plugin_logging_session_load_compare(gconstpointer first,
+                                              gconstpointer second)
+{
+  const InfinotedPluginLoggingSessionLoad* first_load;
+  const InfinotedPluginLoggingSessionLoad* second_load;
+
+  first_load = (const InfinotedPluginLoggingSessionLoad*)first;
+  second_load = (const InfinotedPluginLoggingSessionLoad*)second;
+
+  /* Sessions that used the most processing time come first */
+  if(first_load->statistics.processing_time >
+     second_load->statistics.processing_time)
+    return -1;
+  if(first_load->statistics.processing_time <
+     second_load->statistics.processing_time)
+    return 1;
+  return 0;
+}
+
+static void
+infinoted_plugin_logging_report_session_statistics(
+  InfinotedPluginLogging* plugin)
+{
+  InfinotedPluginLoggingSessionInfo* info;
+  InfinotedPluginLoggingSessionLoad* load;
+  InfSessionStatistics statistics;
+  guint64 n_transformations;
+  GArray* loads;
+  GSList* item;
+  guint64 now;
+  gdouble elapsed;
+  gchar* document_name;
+  guint i;
+
+  now = inf_trace_now();
+  elapsed = (now - plugin->statistics_time) / 1e9;
+  plugin->statistics_time = now;
+
+  /* Only sessions that received messages since the previous report are
+   * logged, since only these cause load on the server. */
+  loads = g_array_new(FALSE, FALSE, sizeof(InfinotedPluginLoggingSessionLoad));
+  for(item = plugin->sessions; item != NULL; item = item->next)
+  {
+    info = (InfinotedPluginLoggingSessionInfo*)item->data;
+
+    infinoted_plugin_logging_session_get_counters(
+      info,
+      &statistics,
+      &n_transformations
+    );
+
+    if(statistics.n_messages_received > info->statistics.n_messages_received)
+    {
+      g_array_set_size(loads, loads->len + 1);
+      load = &g_array_index(loads, InfinotedPluginLoggingSessionLoad,
+                            loads->len - 1);
+
+      load->info = info;
+      load->statistics.processing_time =
+        statistics.processing_time - info->statistics.processing_time;
+      load->statistics.n_messages_received =
+        statistics.n_messages_received -
+        info->statistics.n_messages_received;
+      load->statistics.n_messages_relayed =
+        statistics.n_messages_relayed - info->statistics.n_messages_relayed;
+      load->statistics.n_messages_sent =
+        statistics.n_messages_sent - info->statistics.n_messages_sent;
+      load->n_transformations = n_transformations - info->n_transformations;
+    }
+
+    info->statistics = statistics;
+    info->n_transformations = n_transformations;
+  }
+
+  g_array_sort(loads, infinoted_plugin_logging_session_load_compare);
+
+  for(i = 0; i < loads->len; ++i)
+  {
+    load = &g_array_index(loads, InfinotedPluginLoggingSessionLoad, i);
+    document_name = infinoted_plugin_logging_get_document_name(load->info);
+
+    infinoted_log_info(
+      infinoted_plugin_manager_get_log(plugin->manager),
+      _("Session %s: %.1f ms processing time (%.1f%%), "
+        "%.1f messages/s received, %.1f messages/s relayed, "
+        "%.1f messages/s sent, %.1f transformations/s"),
+      document_name,
+      load->statistics.processing_time / 1e6,
+      load->statistics.processing_time / 1e7 / elapsed,
+      load->statistics.n_messages_received / elapsed,
+      load->statistics.n_messages_relayed / elapsed,
+      load->statistics.n_messages_sent / elapsed,
+      load->n_transformations / elapsed
+    );
+
+    g_free(document_name);
+  }
+
+  g_array_free(loads, TRUE);
+}
+
+static void
+infinoted_plugin_logging_statistics_timeout_cb(gpointer user_data);
+
+static void
+infinoted_plugin_logging_schedule_statistics(InfinotedPluginLogging* plugin)
+{
+  plugin->statistics_timeout = inf_io_add_timeout(
+    infinoted_plugin_manager_get_io(plugin->manager),
+    plugin->session_statistics_interval * 1000,
+    infinoted_plugin_logging_statistics_timeout_cb,
+    plugin,
+    NULL
+  );
+}
+
+static void
+infinoted_plugin_logging_statistics_timeout_cb(gpointer user_data)
+{
+  InfinotedPluginLogging* plugin;
+  plugin = (InfinotedPluginLogging*)user_data;
+
+  plugin->statistics_timeout = NULL;
+  infinoted_plugin_logging_report_session_statistics(plugin);
+  infinoted_plugin_logging_schedule_statistics(plugin);
+}
+
+static void
+infinoted_plugin_logging_report_admission_statistics(
+  InfinotedPluginLogging* plugin,
+  InfdAdmissionControl* control)
+{
+  InfdAdmissionControlStatistics statistics;
+  InfdAdmissionControlStatistics* previous;
+
+  infd_admission_control_get_statistics(control, &statistics);
+  previous = &plugin->admission_statistics;
+
+  /* Stay quiet if no client attempted to connect */
+  if(statistics.n_admitted != previous->n_admitted ||
+     statistics.n_rejected_connections != previous->n_rejected_connections ||
+     statistics.n_rejected_handshakes != previous->n_rejected_handshakes ||
+     statistics.n_rejected_rate != previous->n_rejected_rate)
+  {
+    infinoted_log_info(
+      infinoted_plugin_manager_get_log(plugin->manager),
+      _("Connections: %u open, %u authenticating; %" G_GUINT64_FORMAT " "
+        "admitted, %" G_GUINT64_FORMAT " rejected at the connection limit, "
+        "%" G_GUINT64_FORMAT " rejected at the handshake limit, "
+        "%" G_GUINT64_FORMAT " rejected at the per-address rate"),
+      statistics.n_connections,
+      statistics.n_handshakes,
+      statistics.n_admitted - previous->n_admitted,
+      statistics.n_rejected_connections - previous->n_rejected_connections,
+      statistics.n_rejected_handshakes - previous->n_rejected_handshakes,
+      statistics.n_rejected_rate - previous->n_rejected_rate
+    );
+  }
+
+  *previous = statistics;
+}
+
+static void
+infinoted_plugin_logging_admission_timeout_cb(gpointer user_data);
+
+static void
+infinoted_plugin_logging_schedule_admission_statistics(
+  InfinotedPluginLogging* plugin)
+{
+  plugin->admission_timeout = inf_io_add_timeout(
+    infinoted_plugin_manager_get_io(plugin->manager),
+    plugin->admission_statistics_interval * 1000,
+    infinoted_plugin_logging_admission_timeout_cb,
+    plugin,
+    NULL
+  );
+}
+
+static void
+infinoted_plugin_logging_admission_timeout_cb(gpointer user_data)
+{
+  InfinotedPluginLogging* plugin;
+  plugin = (InfinotedPluginLogging*)user_data;
+
+  plugin->admission_timeout = NULL;
+
+  infinoted_plugin_logging_report_admission_statistics(
+    plugin,
+    infinoted_plugin_manager_get_admission_control(plugin->manager)
+  );
+
+  infinoted_plugin_logging_schedule_admission_statistics(plugin);
+}
+
 static void
 infinoted_plugin_logging_notify_status_cb(InfSession* session,
                                           GParamSpec* pspec,
@@ -384,6 +631,8 @@ infinoted_plugin_logging_info_initialize(gpointer plugin_info)
   plugin->log_connection_errors = TRUE;
   plugin->log_session_errors = TRUE;
   plugin->log_session_request_extra = TRUE;
+  plugin->session_statistics_interval = 0;
+  plugin->admission_statistics_interval = 0;
 }
 
 static gboolean
@@ -392,8 +641,9 @@ infinoted_plugin_logging_initialize(InfinotedPluginManager* manager,
                                     GError** error)
 {
   InfinotedPluginLogging* plugin;
-  plugin = (InfinotedPluginLogging*)plugin_info;
+  InfdAdmissionControl* control;
 
+  plugin = (InfinotedPluginLogging*)plugin_info;
   plugin->manager = manager;
 
   g_signal_connect(
@@ -406,6 +656,32 @@ infinoted_plugin_logging_initialize(InfinotedPluginManager* manager,
   plugin->extra_message = NULL;
   plugin->current_session = NULL;
 
+  plugin->sessions = NULL;
+  plugin->statistics_timeout = NULL;
+  plugin->statistics_time = inf_trace_now();
+
+  if(plugin->session_statistics_interval > 0)
+    infinoted_plugin_logging_schedule_statistics(plugin);
+
+  plugin->admission_timeout = NULL;
+  memset(
+    &plugin->admission_statistics,
+    0,
+    sizeof(plugin->admission_statistics)
+  );
+
+  control = infinoted_plugin_manager_get_admission_control(manager);
+  if(control != NULL && plugin->admission_statistics_interval > 0)
+  {
+    /* Only report what happens from now on */
+    infd_admission_control_get_statistics(
+      control,
+      &plugin->admission_statistics
+    );
+
+    infinoted_plugin_logging_schedule_admission_statistics(plugin);
+  }
+
   return TRUE;
 }
 
@@ -415,6 +691,22 @@ infinoted_plugin_logging_deinitialize(gpointer plugin_info)
   InfinotedPluginLogging* plugin;
   plugin = (InfinotedPluginLogging*)plugin_info;
 
+  if(plugin->statistics_timeout != NULL)
+  {
+    inf_io_remove_timeout(
+      infinoted_plugin_manager_get_io(plugin->manager),
+      plugin->statistics_timeout
+    );
+  }
+
+  if(plugin->admission_timeout != NULL)
+  {
+    inf_io_remove_timeout(
+      infinoted_plugin_manager_get_io(plugin->manager),
+      plugin->admission_timeout
+    );
+  }
+
   inf_signal_handlers_disconnect_by_func(
     G_OBJECT(infinoted_plugin_manager_get_log(plugin->manager)),
     G_CALLBACK(infinoted_plugin_logging_log_message_cb),
@@ -598,6 +890,15 @@ infinoted_plugin_logging_session_added(const InfBrowserIter* iter,
   g_object_ref(proxy);
   g_object_get(G_OBJECT(proxy), "session", &session, NULL);
 
+  /* Only the work done after the session was added is reported */
+  infinoted_plugin_logging_session_get_counters(
+    info,
+    &info->statistics,
+    &info->n_transformations
+  );
+
+  info->plugin->sessions = g_slist_prepend(info->plugin->sessions, info);
+
   if(info->plugin->log_session_errors)
   {
     g_signal_connect(
@@ -657,6 +958,7 @@ infinoted_plugin_logging_session_removed(const InfBrowserIter* iter,
   info = (InfinotedPluginLoggingSessionInfo*)session_info;
   g_assert(info->proxy == proxy);
 
+  info->plugin->sessions = g_slist_remove(info->plugin->sessions, info);
   g_object_get(G_OBJECT(proxy), "session", &session, NULL);
 
   if(info->plugin->log_session_errors)
@@ -743,6 +1045,32 @@ static const InfinotedParameterInfo INFINOTED_PLUGIN_LOGGING_OPTIONS[] = {
        "used for debugging purposes to find problems in the server "
        "implementation itself."),
     NULL
+  }, {
+    "session-statistics-interval",
+    INFINOTED_PARAMETER_INT,
+    0,
+    offsetof(InfinotedPluginLogging, session_statistics_interval),
+    infinoted_parameter_convert_nonnegative,
+    0,
+    N_("Interval, in seconds, after which to write the processing time, "
+       "message rates and transformation rates of each active session into "
+       "the log, busiest session first. This allows to find the documents "
+       "that cause most load on the server. 0 disables the report, which is "
+       "the default."),
+    N_("SECONDS")
+  }, {
+    "admission-statistics-interval",
+    INFINOTED_PARAMETER_INT,
+    0,
+    offsetof(InfinotedPluginLogging, admission_statistics_interval),
+    infinoted_parameter_convert_nonnegative,
+    0,
+    N_("Interval, in seconds, after which to write the number of open "
+       "connections, and how many connections were admitted or rejected "
+       "by the max-connections, max-handshakes and connection-rate "
+       "settings, into the log. Nothing is written for intervals in which "
+       "no client connected. 0 disables the report, which is the default."),
+    N_("SECONDS")
   }, {
     NULL,
     0,
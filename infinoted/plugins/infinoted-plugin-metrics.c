@@ -0,0 +1,1240 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* This plugin serves metrics in the Prometheus text exposition format via
+ * HTTP on the loopback interface. Most values are computed only when the
+ * metrics are requested, so that the plugin does not add work to the hot
+ * paths of the server. */
+
+#include <infinoted/infinoted-plugin-manager.h>
+#include <infinoted/infinoted-parameter.h>
+#include <infinoted/infinoted-log.h>
+
+#include <libinfinity/server/infd-session-proxy.h>
+#include <libinfinity/adopted/inf-adopted-session.h>
+#include <libinfinity/common/inf-xmpp-connection.h>
+#include <libinfinity/common/inf-trace.h>
+#include <libinfinity/inf-signals.h>
+#include <libinfinity/inf-i18n.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+#include "config.h"
+
+/* Upper bounds, in seconds, of the main loop lag histogram buckets */
+static const gdouble INFINOTED_PLUGIN_METRICS_LAG_BUCKETS[] = {
+  0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5
+};
+
+#define INFINOTED_PLUGIN_METRICS_N_LAG_BUCKETS \
+  G_N_ELEMENTS(INFINOTED_PLUGIN_METRICS_LAG_BUCKETS)
+
+/* Maximum size of a HTTP request header we accept */
+#define INFINOTED_PLUGIN_METRICS_MAX_REQUEST_SIZE 8192
+
+typedef struct _InfinotedPluginMetrics InfinotedPluginMetrics;
+struct _InfinotedPluginMetrics {
+  InfinotedPluginManager* manager;
+  guint port;
+  guint loop_interval;
+
+  InfNativeSocket socket;
+  InfIoWatch* watch;
+  GSList* clients;
+
+  InfIoTimeout* loop_timeout;
+  gint64 loop_expected;
+  guint64 loop_lag_count;
+  gdouble loop_lag_sum;
+  guint64 loop_lag_buckets[INFINOTED_PLUGIN_METRICS_N_LAG_BUCKETS];
+
+  GSList* connections;
+  guint64 n_connections_total;
+  /* Traffic of connections that have been closed already */
+  InfXmppConnectionStatistics closed_statistics;
+
+  GSList* sessions;
+};
+
+typedef struct _InfinotedPluginMetricsConnectionInfo
+  InfinotedPluginMetricsConnectionInfo;
+struct _InfinotedPluginMetricsConnectionInfo {
+  InfXmlConnection* connection;
+};
+
+typedef struct _InfinotedPluginMetricsSessionInfo
+  InfinotedPluginMetricsSessionInfo;
+struct _InfinotedPluginMetricsSessionInfo {
+  InfinotedPluginMetrics* plugin;
+  InfSessionProxy* proxy;
+  gchar* path;
+  guint n_subscriptions;
+};
+
+typedef struct _InfinotedPluginMetricsClient InfinotedPluginMetricsClient;
+struct _InfinotedPluginMetricsClient {
+  InfinotedPluginMetrics* plugin;
+  InfNativeSocket socket;
+  InfIoWatch* watch;
+
+  GString* request;
+  gchar* response;
+  gsize response_len;
+  gsize response_pos;
+};
+
+static void
+infinoted_plugin_metrics_make_system_error(int code,
+                                           GError** error)
+{
+  g_set_error_literal(
+    error,
+    g_quark_from_static_string("INFINOTED_PLUGIN_METRICS_SYSTEM_ERROR"),
+    code,
+    strerror(code)
+  );
+}
+
+static void
+infinoted_plugin_metrics_append_label(GString* str,
+                                      const gchar* value)
+{
+  const gchar* p;
+
+  /* Escape the label value as required by the exposition format */
+  g_string_append(str, "{path=\"");
+  for(p = value; *p != '\0'; ++p)
+  {
+    switch(*p)
+    {
+    case '\\': g_string_append(str, "\\\\"); break;
+    case '"': g_string_append(str, "\\\""); break;
+    case '\n': g_string_append(str, "\\n"); break;
+    default: g_string_append_c(str, *p); break;
+    }
+  }
+  g_string_append(str, "\"}");
+}
+
+static void
+infinoted_plugin_metrics_append_header(GString* str,
+                                       const gchar* name,
+                                       const gchar* type,
+                                       const gchar* help)
+{
+  g_string_append_printf(str, "# HELP %s %s\n", name, help);
+  g_string_append_printf(str, "# TYPE %s %s\n", name, type);
+}
+
+static void
+infinoted_plugin_metrics_append_value(GString* str,
+                                      const gchar* name,
+                                      guint64 value)
+{
+  g_string_append_printf(str, "%s %" G_GUINT64_FORMAT "\n", name, value);
+}
+
+static void
+infinoted_plugin_metrics_append_double(GString* str,
+                                       const gchar* name,
+                                       const gchar* suffix,
+                                       gdouble value)
+{
+  gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+
+  /* Use g_ascii_dtostr so that the output does not depend on the locale */
+  g_string_append_printf(
+    str,
+    "%s%s %s\n",
+    name,
+    suffix,
+    g_ascii_dtostr(buf, sizeof(buf), value)
+  );
+}
+
+static void
+infinoted_plugin_metrics_append_bucket(GString* str,
+                                       const gchar* name,
+                                       gdouble bound,
+                                       guint64 count)
+{
+  gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+
+  g_string_append_printf(
+    str,
+    "%s_bucket{le=\"%s\"} %" G_GUINT64_FORMAT "\n",
+    name,
+    g_ascii_dtostr(buf, sizeof(buf), bound),
+    count
+  );
+}
+
+static void
+infinoted_plugin_metrics_append_trace(GString* str,
+                                      InfTraceProbe probe)
+{
+  InfTraceHistogram histogram;
+  gboolean is_time;
+  gchar* name;
+  gchar* help;
+  gdouble scale;
+  guint64 cumulative;
+  guint first;
+  guint last;
+  guint i;
+
+  inf_trace_get_histogram(probe, &histogram);
+  is_time = strcmp(inf_trace_probe_get_unit(probe), "ns") == 0;
+
+  /* Times are exported in seconds as recommended for Prometheus, and only
+   * the buckets from about 1us to 1min are reported separately. */
+  if(is_time)
+  {
+    name = g_strdup_printf(
+      "infinoted_trace_%s_seconds",
+      inf_trace_probe_get_name(probe)
+    );
+
+    scale = 1e9;
+    first = 10;
+    last = 36;
+  }
+  else
+  {
+    name = g_strdup_printf(
+      "infinoted_trace_%s",
+      inf_trace_probe_get_name(probe)
+    );
+
+    scale = 1.0;
+    first = 0;
+    last = 20;
+  }
+
+  g_strdelimit(name, "-", '_');
+
+  help = g_strdup_printf(
+    "Values recorded by the %s trace probe",
+    inf_trace_probe_get_name(probe)
+  );
+
+  infinoted_plugin_metrics_append_header(str, name, "histogram", help);
+  g_free(help);
+
+  /* Bucket i of the trace histogram holds values below 2^i */
+  cumulative = 0;
+  for(i = 0; i <= last; ++i)
+  {
+    cumulative += histogram.buckets[i];
+    if(i >= first)
+    {
+      infinoted_plugin_metrics_append_bucket(
+        str,
+        name,
+        (gdouble)(G_GUINT64_CONSTANT(1) << i) / scale,
+        cumulative
+      );
+    }
+  }
+
+  g_string_append_printf(
+    str,
+    "%s_bucket{le=\"+Inf\"} %" G_GUINT64_FORMAT "\n",
+    name,
+    histogram.count
+  );
+
+  infinoted_plugin_metrics_append_double(
+    str,
+    name,
+    "_sum",
+    histogram.sum / scale
+  );
+
+  g_string_append_printf(
+    str,
+    "%s_count %" G_GUINT64_FORMAT "\n",
+    name,
+    histogram.count
+  );
+
+  g_free(name);
+}
+
+static void
+infinoted_plugin_metrics_count_requests_foreach_func(InfUser* user,
+                                                     gpointer user_data)
+{
+  InfAdoptedRequestLog* log;
+  guint* counts;
+
+  counts = (guint*)user_data;
+  log = inf_adopted_user_get_request_log(INF_ADOPTED_USER(user));
+
+  counts[0] += inf_adopted_request_log_get_end(log) -
+    inf_adopted_request_log_get_begin(log);
+  counts[1] += inf_adopted_request_log_get_cache_size(log);
+}
+
+static void
+infinoted_plugin_metrics_append_sessions(InfinotedPluginMetrics* plugin,
+                                         GString* str)
+{
+  InfinotedPluginMetricsSessionInfo* info;
+  InfSession* session;
+  InfUserTable* user_table;
+  GString* subscriptions;
+  GString* request_logs;
+  GString* caches;
+  guint counts[2];
+  GSList* item;
+
+  subscriptions = g_string_new(NULL);
+  request_logs = g_string_new(NULL);
+  caches = g_string_new(NULL);
+
+  for(item = plugin->sessions; item != NULL; item = item->next)
+  {
+    info = (InfinotedPluginMetricsSessionInfo*)item->data;
+
+    g_string_append(subscriptions, "infinoted_session_subscriptions");
+    infinoted_plugin_metrics_append_label(subscriptions, info->path);
+    g_string_append_printf(subscriptions, " %u\n", info->n_subscriptions);
+
+    g_object_get(G_OBJECT(info->proxy), "session", &session, NULL);
+    if(INF_ADOPTED_IS_SESSION(session))
+    {
+      counts[0] = 0;
+      counts[1] = 0;
+
+      user_table = inf_session_get_user_table(session);
+      inf_user_table_foreach_user(
+        user_table,
+        infinoted_plugin_metrics_count_requests_foreach_func,
+        counts
+      );
+
+      g_string_append(request_logs, "infinoted_session_request_log_size");
+      infinoted_plugin_metrics_append_label(request_logs, info->path);
+      g_string_append_printf(request_logs, " %u\n", counts[0]);
+
+      g_string_append(caches, "infinoted_session_transform_cache_size");
+      infinoted_plugin_metrics_append_label(caches, info->path);
+      g_string_append_printf(caches, " %u\n", counts[1]);
+    }
+
+    g_object_unref(session);
+  }
+
+  infinoted_plugin_metrics_append_header(
+    str,
+    "infinoted_session_subscriptions",
+    "gauge",
+    "Number of connections subscribed to a session"
+  );
+
+  g_string_append_len(str, subscriptions->str, subscriptions->len);
+
+  infinoted_plugin_metrics_append_header(
+    str,
+    "infinoted_session_request_log_size",
+    "gauge",
+    "Number of requests in the request logs of all users of a session"
+  );
+
+  g_string_append_len(str, request_logs->str, request_logs->len);
+
+  infinoted_plugin_metrics_append_header(
+    str,
+    "infinoted_session_transform_cache_size",
+    "gauge",
+    "Number of cached translated requests of all users of a session"
+  );
+
+  g_string_append_len(str, caches->str, caches->len);
+
+  g_string_free(subscriptions, TRUE);
+  g_string_free(request_logs, TRUE);
+  g_string_free(caches, TRUE);
+}
+
+static gchar*
+infinoted_plugin_metrics_render(InfinotedPluginMetrics* plugin,
+                                gsize* len)
+{
+  InfinotedPluginMetricsConnectionInfo* info;
+  InfXmppConnectionStatistics total;
+  InfXmppConnectionStatistics statistics;
+  GString* str;
+  guint64 cumulative;
+  GSList* item;
+  guint i;
+
+  str = g_string_sized_new(4096);
+
+  infinoted_plugin_metrics_append_header(
+    str,
+    "infinoted_connections",
+    "gauge",
+    "Number of client connections"
+  );
+
+  infinoted_plugin_metrics_append_value(
+    str,
+    "infinoted_connections",
+    g_slist_length(plugin->connections)
+  );
+
+  infinoted_plugin_metrics_append_header(
+    str,
+    "infinoted_connections_total",
+    "counter",
+    "Number of client connections since the plugin was loaded"
+  );
+
+  infinoted_plugin_metrics_append_value(
+    str,
+    "infinoted_connections_total",
+    plugin->n_connections_total
+  );
+
+  infinoted_plugin_metrics_append_header(
+    str,
+    "infinoted_sessions_loaded",
+    "gauge",
+    "Number of sessions loaded into memory"
+  );
+
+  infinoted_plugin_metrics_append_value(
+    str,
+    "infinoted_sessions_loaded",
+    g_slist_length(plugin->sessions)
+  );
+
+  infinoted_plugin_metrics_append_sessions(plugin, str);
+
+  total = plugin->closed_statistics;
+  for(item = plugin->connections; item != NULL; item = item->next)
+  {
+    info = (InfinotedPluginMetricsConnectionInfo*)item->data;
+    if(INF_IS_XMPP_CONNECTION(info->connection))
+    {
+      inf_xmpp_connection_get_statistics(
+        INF_XMPP_CONNECTION(info->connection),
+        &statistics
+      );
+
+      total.n_messages_sent += statistics.n_messages_sent;
+      total.n_messages_received += statistics.n_messages_received;
+      total.n_bytes_sent += statistics.n_bytes_sent;
+      total.n_bytes_received += statistics.n_bytes_received;
+    }
+  }
+
+  infinoted_plugin_metrics_append_header(
+    str,
+    "infinoted_messages_sent_total",
+    "counter",
+    "Number of XML messages sent to clients"
+  );
+
+  infinoted_plugin_metrics_append_value(
+    str,
+    "infinoted_messages_sent_total",
+    total.n_messages_sent
+  );
+
+  infinoted_plugin_metrics_append_header(
+    str,
+    "infinoted_messages_received_total",
+    "counter",
+    "Number of XML messages received from clients"
+  );
+
+  infinoted_plugin_metrics_append_value(
+    str,
+    "infinoted_messages_received_total",
+    total.n_messages_received
+  );
+
+  infinoted_plugin_metrics_append_header(
+    str,
+    "infinoted_bytes_sent_total",
+    "counter",
+    "Number of bytes sent to clients"
+  );
+
+  infinoted_plugin_metrics_append_value(
+    str,
+    "infinoted_bytes_sent_total",
+    total.n_bytes_sent
+  );
+
+  infinoted_plugin_metrics_append_header(
+    str,
+    "infinoted_bytes_received_total",
+    "counter",
+    "Number of bytes received from clients"
+  );
+
+  infinoted_plugin_metrics_append_value(
+    str,
+    "infinoted_bytes_received_total",
+    total.n_bytes_received
+  );
+
+  infinoted_plugin_metrics_append_header(
+    str,
+    "infinoted_main_loop_lag_seconds",
+    "histogram",
+    "Delay of a periodic timer in the main loop"
+  );
+
+  cumulative = 0;
+  for(i = 0; i < INFINOTED_PLUGIN_METRICS_N_LAG_BUCKETS; ++i)
+  {
+    cumulative += plugin->loop_lag_buckets[i];
+    infinoted_plugin_metrics_append_bucket(
+      str,
+      "infinoted_main_loop_lag_seconds",
+      INFINOTED_PLUGIN_METRICS_LAG_BUCKETS[i],
+      cumulative
+    );
+  }
+
+  g_string_append_printf(
+    str,
+    "infinoted_main_loop_lag_seconds_bucket{le=\"+Inf\"} %"
+    G_GUINT64_FORMAT "\n",
+    plugin->loop_lag_count
+  );
+
+  infinoted_plugin_metrics_append_double(
+    str,
+    "infinoted_main_loop_lag_seconds",
+    "_sum",
+    plugin->loop_lag_sum
+  );
+
+  infinoted_plugin_metrics_append_value(
+    str,
+    "infinoted_main_loop_lag_seconds_count",
+    plugin->loop_lag_count
+  );
+
+  /* Save latency and the other trace probes are only available if
+   * libinfinity was built with tracing support. */
+  infinoted_plugin_metrics_append_header(
+    str,
+    "infinoted_tracing_enabled",
+    "gauge",
+    "Whether libinfinity was built with tracing support"
+  );
+
+  infinoted_plugin_metrics_append_value(
+    str,
+    "infinoted_tracing_enabled",
+    inf_trace_is_enabled() ? 1 : 0
+  );
+
+  if(inf_trace_is_enabled())
+    for(i = 0; i < INF_TRACE_N_PROBES; ++i)
+      infinoted_plugin_metrics_append_trace(str, i);
+
+  *len = str->len;
+  return g_string_free(str, FALSE);
+}
+
+static void
+infinoted_plugin_metrics_loop_schedule(InfinotedPluginMetrics* plugin);
+
+static void
+infinoted_plugin_metrics_loop_timeout_cb(gpointer user_data)
+{
+  InfinotedPluginMetrics* plugin;
+  gint64 now;
+  gdouble lag;
+  guint i;
+
+  plugin = (InfinotedPluginMetrics*)user_data;
+  plugin->loop_timeout = NULL;
+
+  /* The time by which the timer fired late is the time the main loop was
+   * busy with other work. */
+  now = g_get_monotonic_time();
+  lag = 0.0;
+  if(now > plugin->loop_expected)
+    lag = (now - plugin->loop_expected) / 1e6;
+
+  ++plugin->loop_lag_count;
+  plugin->loop_lag_sum += lag;
+
+  for(i = 0; i < INFINOTED_PLUGIN_METRICS_N_LAG_BUCKETS; ++i)
+  {
+    if(lag <= INFINOTED_PLUGIN_METRICS_LAG_BUCKETS[i])
+    {
+      ++plugin->loop_lag_buckets[i];
+      break;
+    }
+  }
+
+  infinoted_plugin_metrics_loop_schedule(plugin);
+}
+
+static void
+infinoted_plugin_metrics_loop_schedule(InfinotedPluginMetrics* plugin)
+{
+  plugin->loop_expected =
+    g_get_monotonic_time() + (gint64)plugin->loop_interval * 1000;
+
+  plugin->loop_timeout = inf_io_add_timeout(
+    infinoted_plugin_manager_get_io(plugin->manager),
+    plugin->loop_interval,
+    infinoted_plugin_metrics_loop_timeout_cb,
+    plugin,
+    NULL
+  );
+}
+
+static void
+infinoted_plugin_metrics_close_client(InfinotedPluginMetricsClient* client)
+{
+  InfinotedPluginMetrics* plugin;
+  plugin = client->plugin;
+
+  plugin->clients = g_slist_remove(plugin->clients, client);
+
+  inf_io_remove_watch(
+    infinoted_plugin_manager_get_io(plugin->manager),
+    client->watch
+  );
+
+  close(client->socket);
+  g_string_free(client->request, TRUE);
+  g_free(client->response);
+  g_slice_free(InfinotedPluginMetricsClient, client);
+}
+
+static void
+infinoted_plugin_metrics_respond(InfinotedPluginMetricsClient* client)
+{
+  static const gchar NOT_FOUND[] = "Not found, try /metrics\n";
+  const gchar* path;
+  const gchar* path_end;
+  gchar* body;
+  gsize body_len;
+  GString* response;
+
+  /* The request line is "GET /path HTTP/1.x". Anything but a GET for the
+   * root or the /metrics path is answered with 404. */
+  path = NULL;
+  if(g_str_has_prefix(client->request->str, "GET "))
+    path = client->request->str + 4;
+
+  path_end = NULL;
+  if(path != NULL)
+    path_end = strchr(path, ' ');
+
+  response = g_string_sized_new(128);
+  if(path_end != NULL &&
+     ((path_end - path == 8 && strncmp(path, "/metrics", 8) == 0) ||
+      (path_end - path == 1 && *path == '/')))
+  {
+    body = infinoted_plugin_metrics_render(client->plugin, &body_len);
+
+    g_string_append_printf(
+      response,
+      "HTTP/1.0 200 OK\r\n"
+      "Content-Type: text/plain; version=0.0.4\r\n"
+      "Content-Length: %" G_GSIZE_FORMAT "\r\n"
+      "Connection: close\r\n"
+      "\r\n",
+      body_len
+    );
+
+    g_string_append_len(response, body, body_len);
+    g_free(body);
+  }
+  else
+  {
+    g_string_append_printf(
+      response,
+      "HTTP/1.0 404 Not Found\r\n"
+      "Content-Type: text/plain\r\n"
+      "Content-Length: %" G_GSIZE_FORMAT "\r\n"
+      "Connection: close\r\n"
+      "\r\n"
+      "%s",
+      sizeof(NOT_FOUND) - 1,
+      NOT_FOUND
+    );
+  }
+
+  client->response_len = response->len;
+  client->response_pos = 0;
+  client->response = g_string_free(response, FALSE);
+
+  inf_io_update_watch(
+    infinoted_plugin_manager_get_io(client->plugin->manager),
+    client->watch,
+    INF_IO_OUTGOING
+  );
+}
+
+static gboolean
+infinoted_plugin_metrics_client_io_in(InfinotedPluginMetricsClient* client,
+                                      GError** error)
+{
+  gchar buf[1024];
+  ssize_t bytes;
+
+  do
+  {
+    bytes = recv(client->socket, buf, sizeof(buf), 0);
+  } while(bytes < 0 && errno == EINTR);
+
+  if(bytes < 0)
+  {
+    if(errno == EAGAIN)
+      return TRUE;
+
+    infinoted_plugin_metrics_make_system_error(errno, error);
+    return FALSE;
+  }
+
+  if(bytes == 0)
+  {
+    /* Connection closed before the request was complete */
+    infinoted_plugin_metrics_close_client(client);
+    return TRUE;
+  }
+
+  g_string_append_len(client->request, buf, bytes);
+  if(strstr(client->request->str, "\r\n\r\n") != NULL ||
+     strstr(client->request->str, "\n\n") != NULL)
+  {
+    infinoted_plugin_metrics_respond(client);
+  }
+  else if(client->request->len > INFINOTED_PLUGIN_METRICS_MAX_REQUEST_SIZE)
+  {
+    infinoted_plugin_metrics_close_client(client);
+  }
+
+  return TRUE;
+}
+
+static gboolean
+infinoted_plugin_metrics_client_io_out(InfinotedPluginMetricsClient* client,
+                                       GError** error)
+{
+  ssize_t bytes;
+
+  g_assert(client->response != NULL);
+
+  do
+  {
+    bytes = send(
+      client->socket,
+      client->response + client->response_pos,
+      client->response_len - client->response_pos,
+#ifdef HAVE_MSG_NOSIGNAL
+      MSG_NOSIGNAL
+#else
+      0
+#endif
+    );
+  } while(bytes < 0 && errno == EINTR);
+
+  if(bytes < 0)
+  {
+    if(errno == EAGAIN)
+      return TRUE;
+
+    infinoted_plugin_metrics_make_system_error(errno, error);
+    return FALSE;
+  }
+
+  client->response_pos += bytes;
+  if(client->response_pos == client->response_len)
+    infinoted_plugin_metrics_close_client(client);
+
+  return TRUE;
+}
+
+static void
+infinoted_plugin_metrics_client_io_func(InfNativeSocket* socket,
+                                        InfIoEvent event,
+                                        gpointer user_data)
+{
+  InfinotedPluginMetricsClient* client;
+  InfinotedPluginManager* manager;
+  gboolean result;
+  GError* error;
+
+  client = (InfinotedPluginMetricsClient*)user_data;
+  manager = client->plugin->manager;
+  error = NULL;
+
+  if(event & INF_IO_ERROR)
+  {
+    infinoted_plugin_metrics_close_client(client);
+    return;
+  }
+  else if(event & INF_IO_INCOMING)
+  {
+    result = infinoted_plugin_metrics_client_io_in(client, &error);
+  }
+  else if(event & INF_IO_OUTGOING)
+  {
+    result = infinoted_plugin_metrics_client_io_out(client, &error);
+  }
+  else
+  {
+    result = TRUE;
+  }
+
+  if(!result)
+  {
+    infinoted_log_warning(
+      infinoted_plugin_manager_get_log(manager),
+      "Metrics client error: %s",
+      error->message
+    );
+
+    g_error_free(error);
+    infinoted_plugin_metrics_close_client(client);
+  }
+}
+
+static gboolean
+infinoted_plugin_metrics_set_nonblock(InfNativeSocket socket,
+                                      GError** error)
+{
+  int result;
+
+  result = fcntl(socket, F_GETFL);
+  if(result == -1)
+  {
+    infinoted_plugin_metrics_make_system_error(errno, error);
+    return FALSE;
+  }
+
+  if(fcntl(socket, F_SETFL, result | O_NONBLOCK) == -1)
+  {
+    infinoted_plugin_metrics_make_system_error(errno, error);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static void
+infinoted_plugin_metrics_accept_func(InfNativeSocket* socket,
+                                     InfIoEvent event,
+                                     gpointer user_data)
+{
+  InfinotedPluginMetrics* plugin;
+  InfinotedPluginMetricsClient* client;
+  InfNativeSocket new_socket;
+  GError* error;
+
+  plugin = (InfinotedPluginMetrics*)user_data;
+
+  if(event & INF_IO_INCOMING)
+  {
+    error = NULL;
+
+    new_socket = accept(*socket, NULL, NULL);
+    if(new_socket == -1)
+    {
+      infinoted_plugin_metrics_make_system_error(errno, &error);
+    }
+    else if(!infinoted_plugin_metrics_set_nonblock(new_socket, &error))
+    {
+      close(new_socket);
+    }
+
+    if(error != NULL)
+    {
+      infinoted_log_warning(
+        infinoted_plugin_manager_get_log(plugin->manager),
+        "Failed to accept metrics client: %s",
+        error->message
+      );
+
+      g_error_free(error);
+    }
+    else
+    {
+      client = g_slice_new(InfinotedPluginMetricsClient);
+      client->plugin = plugin;
+      client->socket = new_socket;
+      client->request = g_string_new(NULL);
+      client->response = NULL;
+      client->response_len = 0;
+      client->response_pos = 0;
+
+      client->watch = inf_io_add_watch(
+        infinoted_plugin_manager_get_io(plugin->manager),
+        &client->socket,
+        INF_IO_INCOMING,
+        infinoted_plugin_metrics_client_io_func,
+        client,
+        NULL
+      );
+
+      plugin->clients = g_slist_prepend(plugin->clients, client);
+    }
+  }
+}
+
+static void
+infinoted_plugin_metrics_add_subscription_cb(InfdSessionProxy* proxy,
+                                             InfXmlConnection* connection,
+                                             guint seq_id,
+                                             gpointer user_data)
+{
+  InfinotedPluginMetricsSessionInfo* info;
+  info = (InfinotedPluginMetricsSessionInfo*)user_data;
+
+  ++info->n_subscriptions;
+}
+
+static void
+infinoted_plugin_metrics_remove_subscription_cb(InfdSessionProxy* proxy,
+                                                InfXmlConnection* connection,
+                                                gpointer user_data)
+{
+  InfinotedPluginMetricsSessionInfo* info;
+  info = (InfinotedPluginMetricsSessionInfo*)user_data;
+
+  g_assert(info->n_subscriptions > 0);
+  --info->n_subscriptions;
+}
+
+static void
+infinoted_plugin_metrics_info_initialize(gpointer plugin_info)
+{
+  InfinotedPluginMetrics* plugin;
+  plugin = (InfinotedPluginMetrics*)plugin_info;
+
+  plugin->manager = NULL;
+  plugin->port = 9523;
+  plugin->loop_interval = 250;
+
+  plugin->socket = -1;
+  plugin->watch = NULL;
+  plugin->clients = NULL;
+
+  plugin->loop_timeout = NULL;
+  plugin->loop_expected = 0;
+  plugin->loop_lag_count = 0;
+  plugin->loop_lag_sum = 0.0;
+  memset(plugin->loop_lag_buckets, 0, sizeof(plugin->loop_lag_buckets));
+
+  plugin->connections = NULL;
+  plugin->n_connections_total = 0;
+  memset(&plugin->closed_statistics, 0, sizeof(plugin->closed_statistics));
+
+  plugin->sessions = NULL;
+}
+
+static gboolean
+infinoted_plugin_metrics_initialize(InfinotedPluginManager* manager,
+                                    gpointer plugin_info,
+                                    GError** error)
+{
+  InfinotedPluginMetrics* plugin;
+  struct sockaddr_in addr;
+  int value;
+
+  plugin = (InfinotedPluginMetrics*)plugin_info;
+  plugin->manager = manager;
+
+  plugin->socket = socket(AF_INET, SOCK_STREAM, 0);
+  if(plugin->socket == -1)
+  {
+    infinoted_plugin_metrics_make_system_error(errno, error);
+    return FALSE;
+  }
+
+  value = 1;
+  setsockopt(plugin->socket, SOL_SOCKET, SO_REUSEADDR, &value, sizeof(value));
+
+  if(!infinoted_plugin_metrics_set_nonblock(plugin->socket, error))
+    return FALSE;
+
+  /* Metrics are only served locally; a reverse proxy or an SSH tunnel can
+   * be used to make them available remotely. */
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(plugin->port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  if(bind(plugin->socket, (struct sockaddr*)&addr, sizeof(addr)) == -1)
+  {
+    infinoted_plugin_metrics_make_system_error(errno, error);
+    return FALSE;
+  }
+
+  if(listen(plugin->socket, 5) == -1)
+  {
+    infinoted_plugin_metrics_make_system_error(errno, error);
+    return FALSE;
+  }
+
+  plugin->watch = inf_io_add_watch(
+    infinoted_plugin_manager_get_io(plugin->manager),
+    &plugin->socket,
+    INF_IO_INCOMING,
+    infinoted_plugin_metrics_accept_func,
+    plugin,
+    NULL
+  );
+
+  infinoted_plugin_metrics_loop_schedule(plugin);
+  return TRUE;
+}
+
+static void
+infinoted_plugin_metrics_deinitialize(gpointer plugin_info)
+{
+  InfinotedPluginMetrics* plugin;
+  plugin = (InfinotedPluginMetrics*)plugin_info;
+
+  while(plugin->clients != NULL)
+  {
+    infinoted_plugin_metrics_close_client(
+      (InfinotedPluginMetricsClient*)plugin->clients->data
+    );
+  }
+
+  if(plugin->loop_timeout != NULL)
+  {
+    inf_io_remove_timeout(
+      infinoted_plugin_manager_get_io(plugin->manager),
+      plugin->loop_timeout
+    );
+  }
+
+  if(plugin->watch != NULL)
+  {
+    inf_io_remove_watch(
+      infinoted_plugin_manager_get_io(plugin->manager),
+      plugin->watch
+    );
+  }
+
+  if(plugin->socket != -1)
+  {
+    close(plugin->socket);
+  }
+}
+
+static void
+infinoted_plugin_metrics_connection_added(InfXmlConnection* connection,
+                                          gpointer plugin_info,
+                                          gpointer connection_info)
+{
+  InfinotedPluginMetrics* plugin;
+  InfinotedPluginMetricsConnectionInfo* info;
+
+  plugin = (InfinotedPluginMetrics*)plugin_info;
+  info = (InfinotedPluginMetricsConnectionInfo*)connection_info;
+
+  info->connection = connection;
+  plugin->connections = g_slist_prepend(plugin->connections, info);
+  ++plugin->n_connections_total;
+}
+
+static void
+infinoted_plugin_metrics_connection_removed(InfXmlConnection* connection,
+                                            gpointer plugin_info,
+                                            gpointer connection_info)
+{
+  InfinotedPluginMetrics* plugin;
+  InfinotedPluginMetricsConnectionInfo* info;
+  InfXmppConnectionStatistics statistics;
+
+  plugin = (InfinotedPluginMetrics*)plugin_info;
+  info = (InfinotedPluginMetricsConnectionInfo*)connection_info;
+
+  /* Keep the traffic of the connection, so that the counters do not go
+   * backwards when a client disconnects. */
+  if(INF_IS_XMPP_CONNECTION(connection))
+  {
+    inf_xmpp_connection_get_statistics(
+      INF_XMPP_CONNECTION(connection),
+      &statistics
+    );
+
+    plugin->closed_statistics.n_messages_sent +=
+      statistics.n_messages_sent;
+    plugin->closed_statistics.n_messages_received +=
+      statistics.n_messages_received;
+    plugin->closed_statistics.n_bytes_sent +=
+      statistics.n_bytes_sent;
+    plugin->closed_statistics.n_bytes_received +=
+      statistics.n_bytes_received;
+  }
+
+  plugin->connections = g_slist_remove(plugin->connections, info);
+}
+
+static void
+infinoted_plugin_metrics_session_added(const InfBrowserIter* iter,
+                                       InfSessionProxy* proxy,
+                                       gpointer plugin_info,
+                                       gpointer session_info)
+{
+  InfinotedPluginMetrics* plugin;
+  InfinotedPluginMetricsSessionInfo* info;
+  InfinotedPluginMetricsConnectionInfo* connection_info;
+  GSList* item;
+
+  plugin = (InfinotedPluginMetrics*)plugin_info;
+  info = (InfinotedPluginMetricsSessionInfo*)session_info;
+
+  info->plugin = plugin;
+  info->proxy = proxy;
+  g_object_ref(proxy);
+
+  info->path = inf_browser_get_path(
+    INF_BROWSER(infinoted_plugin_manager_get_directory(plugin->manager)),
+    iter
+  );
+
+  /* If the plugin is loaded while the server is running, the session
+   * might have subscriptions already. */
+  info->n_subscriptions = 0;
+  for(item = plugin->connections; item != NULL; item = item->next)
+  {
+    connection_info = (InfinotedPluginMetricsConnectionInfo*)item->data;
+    if(infd_session_proxy_is_subscribed(INFD_SESSION_PROXY(proxy),
+                                        connection_info->connection))
+    {
+      ++info->n_subscriptions;
+    }
+  }
+
+  g_signal_connect_after(
+    G_OBJECT(proxy),
+    "add-subscription",
+    G_CALLBACK(infinoted_plugin_metrics_add_subscription_cb),
+    info
+  );
+
+  g_signal_connect_after(
+    G_OBJECT(proxy),
+    "remove-subscription",
+    G_CALLBACK(infinoted_plugin_metrics_remove_subscription_cb),
+    info
+  );
+
+  plugin->sessions = g_slist_prepend(plugin->sessions, info);
+}
+
+static void
+infinoted_plugin_metrics_session_removed(const InfBrowserIter* iter,
+                                         InfSessionProxy* proxy,
+                                         gpointer plugin_info,
+                                         gpointer session_info)
+{
+  InfinotedPluginMetrics* plugin;
+  InfinotedPluginMetricsSessionInfo* info;
+
+  plugin = (InfinotedPluginMetrics*)plugin_info;
+  info = (InfinotedPluginMetricsSessionInfo*)session_info;
+
+  inf_signal_handlers_disconnect_by_func(
+    G_OBJECT(proxy),
+    G_CALLBACK(infinoted_plugin_metrics_add_subscription_cb),
+    info
+  );
+
+  inf_signal_handlers_disconnect_by_func(
+    G_OBJECT(proxy),
+    G_CALLBACK(infinoted_plugin_metrics_remove_subscription_cb),
+    info
+  );
+
+  plugin->sessions = g_slist_remove(plugin->sessions, info);
+
+  g_free(info->path);
+  g_object_unref(info->proxy);
+}
+
+static const InfinotedParameterInfo INFINOTED_PLUGIN_METRICS_OPTIONS[] = {
+  {
+    "port",
+    INFINOTED_PARAMETER_INT,
+    0,
+    offsetof(InfinotedPluginMetrics, port),
+    infinoted_parameter_convert_port,
+    0,
+    N_("The TCP port on the loopback interface on which to serve metrics "
+       "via HTTP. Defaults to 9523."),
+    N_("PORT")
+  }, {
+    "loop-interval",
+    INFINOTED_PARAMETER_INT,
+    0,
+    offsetof(InfinotedPluginMetrics, loop_interval),
+    infinoted_parameter_convert_positive,
+    0,
+    N_("Interval, in milliseconds, at which to probe how long the main loop "
+       "is blocked. Defaults to 250 milliseconds."),
+    N_("MILLISECONDS")
+  }, {
+    NULL,
+    0,
+    0,
+    0,
+    NULL
+  }
+};
+
+const InfinotedPlugin INFINOTED_PLUGIN = {
+  "metrics",
+  N_("Serves server metrics such as the number of connections and loaded "
+     "sessions, traffic counters and main loop latency via HTTP in the "
+     "Prometheus text format."),
+  INFINOTED_PLUGIN_METRICS_OPTIONS,
+  sizeof(InfinotedPluginMetrics),
+  sizeof(InfinotedPluginMetricsConnectionInfo),
+  sizeof(InfinotedPluginMetricsSessionInfo),
+  NULL,
+  infinoted_plugin_metrics_info_initialize,
+  infinoted_plugin_metrics_initialize,
+  infinoted_plugin_metrics_deinitialize,
+  infinoted_plugin_metrics_connection_added,
+  infinoted_plugin_metrics_connection_removed,
+  infinoted_plugin_metrics_session_added,
+  infinoted_plugin_metrics_session_removed
+};
+
+/* vim:set et sw=2 ts=2: */
@@ -19,19 +19,72 @@
 
 #include <infinoted/infinoted-plugin-manager.h>
 #include <infinoted/infinoted-parameter.h>
+#include <infinoted/infinoted-log.h>
 
 #include <libinftext/inf-text-session.h>
 #include <libinftext/inf-text-default-buffer.h>
 #include <libinftext/inf-text-filesystem-format.h>
+#include <libinftext/inf-text-filesystem-journal.h>
 
 #include <libinfinity/inf-i18n.h>
 
 typedef struct _InfinotedPluginNoteText InfinotedPluginNoteText;
 struct _InfinotedPluginNoteText {
   InfinotedPluginManager* manager;
+  gboolean compact;
+  gboolean compress;
+  gboolean journal;
+  guint journal_flush_interval;
+  guint journal_max_size;
+  guint caret_coalesce_interval;
+
+  InfdNotePlugin note_plugin;
   const InfdNotePlugin* plugin;
+
+  /* InfSession -> InfinotedPluginNoteTextSessionInfo, for journaled
+   * sessions */
+  GHashTable* sessions;
 };
 
+typedef struct _InfinotedPluginNoteTextSessionInfo
+  InfinotedPluginNoteTextSessionInfo;
+struct _InfinotedPluginNoteTextSessionInfo {
+  InfinotedPluginNoteText* plugin;
+  InfBrowserIter iter;
+  InfSession* session;
+  InfTextFilesystemJournal* journal;
+  InfIoTimeout* timeout;
+};
+
+static gboolean
+infinoted_plugin_note_text_write(InfinotedPluginNoteText* plugin,
+                                 InfdFilesystemStorage* storage,
+                                 const gchar* path,
+                                 InfUserTable* user_table,
+                                 InfTextBuffer* buffer,
+                                 GError** error)
+{
+  if(plugin != NULL && plugin->compact == TRUE)
+  {
+    return inf_text_filesystem_format_write_compact(
+      storage,
+      path,
+      user_table,
+      buffer,
+      plugin->compress,
+      error
+    );
+  }
+
+  return inf_text_filesystem_format_write(
+    storage,
+    path,
+    user_table,
+    buffer,
+    error
+  );
+}
+
 /* Note plugin implementation */
 static InfSession*
 infinoted_plugin_note_text_session_new(InfIo* io,
@@ -42,9 +95,11 @@ infinoted_plugin_note_text_session_new(InfIo* io,
                                        const gchar* path,
                                        gpointer user_data)
 {
+  InfinotedPluginNoteText* plugin;
   InfTextSession* session;
   InfTextBuffer* buffer;
 
+  plugin = (InfinotedPluginNoteText*)user_data;
   buffer = INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
 
   session = inf_text_session_new(
@@ -58,6 +113,15 @@ infinoted_plugin_note_text_session_new(InfIo* io,
 
   g_object_unref(buffer);
 
+  if(plugin != NULL)
+  {
+    g_object_set(
+      G_OBJECT(session),
+      "coalesce-interval", plugin->caret_coalesce_interval,
+      NULL
+    );
+  }
+
   return INF_SESSION(session);
 }
 
@@ -69,12 +133,15 @@ infinoted_plugin_note_text_session_read(InfdStorage* storage,
                                         gpointer user_data,
                                         GError** error)
 {
+  InfinotedPluginNoteText* plugin;
   InfUserTable* user_table;
   InfTextBuffer* buffer;
   gboolean result;
   InfTextSession* session;
+  guint n_records;
 
   g_assert(INFD_IS_FILESYSTEM_STORAGE(storage));
+  plugin = (InfinotedPluginNoteText*)user_data;
 
   user_table = inf_user_table_new();
   buffer = INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
@@ -87,6 +154,41 @@ infinoted_plugin_note_text_session_read(InfdStorage* storage,
     error
   );
 
+  /* Apply changes that were journaled but not yet written to the document,
+   * for example because the server crashed. The document is written right
+   * away, since a new journal is started as soon as the session is added,
+   * which discards the old one. */
+  if(result == TRUE && plugin != NULL && plugin->journal == TRUE)
+  {
+    result = inf_text_filesystem_journal_replay(
+      INFD_FILESYSTEM_STORAGE(storage),
+      path,
+      user_table,
+      buffer,
+      &n_records,
+      error
+    );
+
+    if(result == TRUE && n_records > 0)
+    {
+      infinoted_log_info(
+        infinoted_plugin_manager_get_log(plugin->manager),
+        _("Recovered %u journal records for document \"%s\""),
+        n_records,
+        path
+      );
+
+      result = infinoted_plugin_note_text_write(
+        plugin,
+        INFD_FILESYSTEM_STORAGE(storage),
+        path,
+        user_table,
+        buffer,
+        error
+      );
+    }
+  }
+
   if(result == FALSE)
   {
     g_object_unref(user_table);
@@ -107,6 +209,15 @@ infinoted_plugin_note_text_session_read(InfdStorage* storage,
   g_object_unref(user_table);
   g_object_unref(buffer);
 
+  if(plugin != NULL)
+  {
+    g_object_set(
+      G_OBJECT(session),
+      "coalesce-interval", plugin->caret_coalesce_interval,
+      NULL
+    );
+  }
+
   return INF_SESSION(session);
 }
 
@@ -117,13 +228,45 @@ infinoted_plugin_note_text_session_write(InfdStorage* storage,
                                          gpointer user_data,
                                          GError** error)
 {
-  return inf_text_filesystem_format_write(
-    INFD_FILESYSTEM_STORAGE(storage),
-    path,
-    inf_session_get_user_table(session),
-    INF_TEXT_BUFFER(inf_session_get_buffer(session)),
-    error
-  );
+  InfinotedPluginNoteText* plugin;
+  InfinotedPluginNoteTextSessionInfo* info;
+  GError* local_error;
+
+  plugin = (InfinotedPluginNoteText*)user_data;
+
+  if(!infinoted_plugin_note_text_write(
+       plugin,
+       INFD_FILESYSTEM_STORAGE(storage),
+       path,
+       inf_session_get_user_table(session),
+       INF_TEXT_BUFFER(inf_session_get_buffer(session)),
+       error))
+  {
+    return FALSE;
+  }
+
+  /* All journaled changes are contained in the document now */
+  info = NULL;
+  if(plugin != NULL && plugin->sessions != NULL)
+    info = g_hash_table_lookup(plugin->sessions, session);
+
+  if(info != NULL)
+  {
+    local_error = NULL;
+    if(!inf_text_filesystem_journal_reset(info->journal, &local_error))
+    {
+      infinoted_log_warning(
+        infinoted_plugin_manager_get_log(plugin->manager),
+        _("Failed to reset journal for document \"%s\": %s"),
+        path,
+        local_error->message
+      );
+
+      g_error_free(local_error);
+    }
+  }
+
+  return TRUE;
 }
 
 const InfdNotePlugin INFINOTED_PLUGIN_NOTE_TEXT_PLUGIN = {
@@ -135,6 +278,97 @@ const InfdNotePlugin INFINOTED_PLUGIN_NOTE_TEXT_PLUGIN = {
   infinoted_plugin_note_text_session_write
 };
 
+/* Journal handling */
+static void
+infinoted_plugin_note_text_journal_timeout_cb(gpointer user_data);
+
+static void
+infinoted_plugin_note_text_journal_schedule(
+  InfinotedPluginNoteTextSessionInfo* info)
+{
+  InfIo* io;
+
+  io = infd_directory_get_io(
+    infinoted_plugin_manager_get_directory(info->plugin->manager)
+  );
+
+  g_assert(info->timeout == NULL);
+
+  info->timeout = inf_io_add_timeout(
+    io,
+    info->plugin->journal_flush_interval,
+    infinoted_plugin_note_text_journal_timeout_cb,
+    info,
+    NULL
+  );
+}
+
+static void
+infinoted_plugin_note_text_journal_timeout_cb(gpointer user_data)
+{
+  InfinotedPluginNoteTextSessionInfo* info;
+  InfdDirectory* directory;
+  GError* error;
+  gchar* path;
+  gboolean save;
+
+  info = (InfinotedPluginNoteTextSessionInfo*)user_data;
+  info->timeout = NULL;
+
+  directory = infinoted_plugin_manager_get_directory(info->plugin->manager);
+
+  error = NULL;
+  save = FALSE;
+  if(!inf_text_filesystem_journal_flush(info->journal, &error))
+  {
+    path = inf_browser_get_path(INF_BROWSER(directory), &info->iter);
+
+    infinoted_log_warning(
+      infinoted_plugin_manager_get_log(info->plugin->manager),
+      _("Failed to write journal for document \"%s\": %s"),
+      path,
+      error->message
+    );
+
+    g_free(path);
+    g_error_free(error);
+    error = NULL;
+
+    /* The journal stops recording changes after a failed write, so the
+     * changes are only safe once the full document has been written. */
+    save = TRUE;
+  }
+
+  /* Compact the journal by writing the full document once the journal
+   * grows too large. This resets the journal in session_write. */
+  if(info->plugin->journal_max_size > 0 &&
+     inf_text_filesystem_journal_get_size(info->journal) >
+     (guint64)info->plugin->journal_max_size * 1024)
+  {
+    save = TRUE;
+  }
+
+  if(save == TRUE)
+  {
+    if(!infd_directory_iter_save_session(directory, &info->iter, &error))
+    {
+      path = inf_browser_get_path(INF_BROWSER(directory), &info->iter);
+
+      infinoted_log_warning(
+        infinoted_plugin_manager_get_log(info->plugin->manager),
+        _("Failed to save document \"%s\": %s"),
+        path,
+        error->message
+      );
+
+      g_free(path);
+      g_error_free(error);
+    }
+  }
+
+  infinoted_plugin_note_text_journal_schedule(info);
+}
+
 /* Infinoted plugin glue */
 static void
 infinoted_plugin_note_text_info_initialize(gpointer plugin_info)
@@ -143,7 +377,14 @@ infinoted_plugin_note_text_info_initialize(gpointer plugin_info)
   plugin = (InfinotedPluginNoteText*)plugin_info;
 
   plugin->manager = NULL;
+  plugin->compact = FALSE;
+  plugin->compress = FALSE;
+  plugin->journal = FALSE;
+  plugin->journal_flush_interval = 1000;
+  plugin->journal_max_size = 4096;
+  plugin->caret_coalesce_interval = 0;
   plugin->plugin = NULL;
+  plugin->sessions = NULL;
 }
 
 static gboolean
@@ -158,9 +399,27 @@ infinoted_plugin_note_text_initialize(InfinotedPluginManager* manager,
 
   plugin->manager = manager;
 
+  if(plugin->compress == TRUE &&
+     !inf_text_filesystem_format_supports_compression())
+  {
+    g_set_error_literal(
+      error,
+      g_quark_from_static_string("INFINOTED_PLUGIN_NOTE_TEXT_ERROR"),
+      1,
+      _("Compression of text documents is not supported by this build")
+    );
+
+    return FALSE;
+  }
+
+  /* Use a copy of the note plugin so that the session write function has
+   * access to the plugin options. */
+  plugin->note_plugin = INFINOTED_PLUGIN_NOTE_TEXT_PLUGIN;
+  plugin->note_plugin.user_data = plugin;
+
   result = infd_directory_add_plugin(
     infinoted_plugin_manager_get_directory(manager),
-    &INFINOTED_PLUGIN_NOTE_TEXT_PLUGIN
+    &plugin->note_plugin
   );
 
   if(result != TRUE)
@@ -176,7 +435,11 @@ infinoted_plugin_note_text_initialize(InfinotedPluginManager* manager,
     return FALSE;
   }
 
-  plugin->plugin = &INFINOTED_PLUGIN_NOTE_TEXT_PLUGIN;
+  plugin->plugin = &plugin->note_plugin;
+
+  if(plugin->journal == TRUE)
+    plugin->sessions = g_hash_table_new(NULL, NULL);
+
   return TRUE;
 }
 
@@ -200,10 +463,185 @@ infinoted_plugin_note_text_deinitialize(gpointer plugin_info)
 
     plugin->plugin = NULL;
   }
+
+  if(plugin->sessions != NULL)
+  {
+    g_hash_table_destroy(plugin->sessions);
+    plugin->sessions = NULL;
+  }
+}
+
+static void
+infinoted_plugin_note_text_session_added(const InfBrowserIter* iter,
+                                         InfSessionProxy* proxy,
+                                         gpointer plugin_info,
+                                         gpointer session_info)
+{
+  InfinotedPluginNoteText* plugin;
+  InfinotedPluginNoteTextSessionInfo* info;
+  InfdDirectory* directory;
+  InfdStorage* storage;
+  InfSession* session;
+  gchar* path;
+  GError* error;
+
+  plugin = (InfinotedPluginNoteText*)plugin_info;
+  info = (InfinotedPluginNoteTextSessionInfo*)session_info;
+
+  info->plugin = plugin;
+  info->iter = *iter;
+  info->session = NULL;
+  info->journal = NULL;
+  info->timeout = NULL;
+
+  if(plugin->sessions == NULL)
+    return;
+
+  directory = infinoted_plugin_manager_get_directory(plugin->manager);
+  storage = infd_directory_get_storage(directory);
+  if(storage == NULL || !INFD_IS_FILESYSTEM_STORAGE(storage))
+    return;
+
+  g_object_get(G_OBJECT(proxy), "session", &session, NULL);
+  if(!INF_TEXT_IS_SESSION(session))
+  {
+    g_object_unref(session);
+    return;
+  }
+
+  path = inf_browser_get_path(INF_BROWSER(directory), iter);
+
+  error = NULL;
+  info->journal = inf_text_filesystem_journal_new(
+    INFD_FILESYSTEM_STORAGE(storage),
+    path,
+    inf_session_get_user_table(session),
+    INF_TEXT_BUFFER(inf_session_get_buffer(session)),
+    &error
+  );
+
+  if(info->journal == NULL)
+  {
+    infinoted_log_warning(
+      infinoted_plugin_manager_get_log(plugin->manager),
+      _("Failed to start journal for document \"%s\": %s"),
+      path,
+      error->message
+    );
+
+    g_error_free(error);
+  }
+  else
+  {
+    info->session = session;
+    g_hash_table_insert(plugin->sessions, session, info);
+    infinoted_plugin_note_text_journal_schedule(info);
+  }
+
+  g_free(path);
+  g_object_unref(session);
+}
+
+static void
+infinoted_plugin_note_text_session_removed(const InfBrowserIter* iter,
+                                           InfSessionProxy* proxy,
+                                           gpointer plugin_info,
+                                           gpointer session_info)
+{
+  InfinotedPluginNoteTextSessionInfo* info;
+  InfIo* io;
+
+  info = (InfinotedPluginNoteTextSessionInfo*)session_info;
+  if(info->journal == NULL)
+    return;
+
+  if(info->timeout != NULL)
+  {
+    io = infd_directory_get_io(
+      infinoted_plugin_manager_get_directory(info->plugin->manager)
+    );
+
+    inf_io_remove_timeout(io, info->timeout);
+    info->timeout = NULL;
+  }
+
+  /* Any pending changes are flushed to the journal */
+  inf_text_filesystem_journal_free(info->journal);
+  info->journal = NULL;
+
+  if(info->plugin->sessions != NULL)
+    g_hash_table_remove(info->plugin->sessions, info->session);
+  info->session = NULL;
 }
 
 static const InfinotedParameterInfo INFINOTED_PLUGIN_NOTE_TEXT_OPTIONS[] = {
   {
+    "compact",
+    INFINOTED_PARAMETER_BOOLEAN,
+    0,
+    offsetof(InfinotedPluginNoteText, compact),
+    infinoted_parameter_convert_boolean,
+    0,
+    N_("Whether to store text documents in a compact binary format instead "
+       "of XML. Documents in the compact format are loaded faster and use "
+       "less memory. Documents in either format can always be read."),
+    NULL
+  }, {
+    "compress",
+    INFINOTED_PARAMETER_BOOLEAN,
+    0,
+    offsetof(InfinotedPluginNoteText, compress),
+    infinoted_parameter_convert_boolean,
+    0,
+    N_("Whether to compress the text of documents stored in the compact "
+       "format. This reduces disk usage, but documents need to be "
+       "decompressed into memory when they are loaded."),
+    NULL
+  }, {
+    "journal",
+    INFINOTED_PARAMETER_BOOLEAN,
+    0,
+    offsetof(InfinotedPluginNoteText, journal),
+    infinoted_parameter_convert_boolean,
+    0,
+    N_("Whether to record changes to text documents in an append-only "
+       "journal next to the document. Changes in the journal survive a "
+       "server crash and are applied when the document is loaded again."),
+    NULL
+  }, {
+    "journal-flush-interval",
+    INFINOTED_PARAMETER_INT,
+    0,
+    offsetof(InfinotedPluginNoteText, journal_flush_interval),
+    infinoted_parameter_convert_positive,
+    0,
+    N_("Interval, in milliseconds, after which recorded changes are written "
+       "to the journal and synchronized to disk."),
+    N_("MILLISECONDS")
+  }, {
+    "journal-max-size",
+    INFINOTED_PARAMETER_INT,
+    0,
+    offsetof(InfinotedPluginNoteText, journal_max_size),
+    infinoted_parameter_convert_nonnegative,
+    0,
+    N_("Size, in kilobytes, after which the journal is compacted by saving "
+       "the full document. 0 means the journal is only compacted when the "
+       "document is saved otherwise."),
+    N_("KILOBYTES")
+  }, {
+    "caret-coalesce-interval",
+    INFINOTED_PARAMETER_INT,
+    0,
+    offsetof(InfinotedPluginNoteText, caret_coalesce_interval),
+    infinoted_parameter_convert_nonnegative,
+    0,
+    N_("Interval, in milliseconds, for which caret and selection changes are "
+       "held back before being forwarded to other users. Within this "
+       "interval, only the latest change of each user is forwarded. 0 means "
+       "that changes are forwarded immediately."),
+    N_("MILLISECONDS")
+  }, {
     NULL,
     0,
     0,
@@ -218,15 +656,15 @@ const InfinotedPlugin INFINOTED_PLUGIN = {
   INFINOTED_PLUGIN_NOTE_TEXT_OPTIONS,
   sizeof(InfinotedPluginNoteText),
   0,
-  0,
+  sizeof(InfinotedPluginNoteTextSessionInfo),
   NULL,
   infinoted_plugin_note_text_info_initialize,
   infinoted_plugin_note_text_initialize,
   infinoted_plugin_note_text_deinitialize,
   NULL,
   NULL,
-  NULL,
-  NULL
+  infinoted_plugin_note_text_session_added,
+  infinoted_plugin_note_text_session_removed
 };
 
 /* vim:set et sw=2 ts=2: */
@@ -0,0 +1,190 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include <infinoted/infinoted-plugin-manager.h>
+#include <infinoted/infinoted-parameter.h>
+#include <infinoted/infinoted-log.h>
+
+#include <libinfinity/common/inf-certificate-credentials.h>
+#include <libinfinity/inf-i18n.h>
+
+typedef struct _InfinotedPluginSessionTickets InfinotedPluginSessionTickets;
+struct _InfinotedPluginSessionTickets {
+  InfinotedPluginManager* manager;
+  guint rotation_interval;
+
+  InfCertificateCredentials* credentials;
+  InfIoTimeout* timeout;
+};
+
+static void
+infinoted_plugin_session_tickets_timeout_cb(gpointer user_data);
+
+static void
+infinoted_plugin_session_tickets_schedule(
+  InfinotedPluginSessionTickets* plugin)
+{
+  plugin->timeout = inf_io_add_timeout(
+    infinoted_plugin_manager_get_io(plugin->manager),
+    plugin->rotation_interval * 1000,
+    infinoted_plugin_session_tickets_timeout_cb,
+    plugin,
+    NULL
+  );
+}
+
+static void
+infinoted_plugin_session_tickets_timeout_cb(gpointer user_data)
+{
+  InfinotedPluginSessionTickets* plugin;
+  GError* error;
+
+  plugin = (InfinotedPluginSessionTickets*)user_data;
+  plugin->timeout = NULL;
+
+  error = NULL;
+  if(!inf_certificate_credentials_rotate_session_ticket_key(
+       plugin->credentials, &error))
+  {
+    /* Stop handing out tickets rather than keep using the old key
+     * indefinitely. */
+    infinoted_log_warning(
+      infinoted_plugin_manager_get_log(plugin->manager),
+      _("Failed to rotate the session ticket key, disabling session "
+        "tickets: %s"),
+      error->message
+    );
+
+    g_error_free(error);
+    inf_certificate_credentials_clear_session_ticket_key(plugin->credentials);
+    return;
+  }
+
+  infinoted_plugin_session_tickets_schedule(plugin);
+}
+
+static void
+infinoted_plugin_session_tickets_info_initialize(gpointer plugin_info)
+{
+  InfinotedPluginSessionTickets* plugin;
+  plugin = (InfinotedPluginSessionTickets*)plugin_info;
+
+  plugin->manager = NULL;
+  plugin->rotation_interval = 3600;
+  plugin->credentials = NULL;
+  plugin->timeout = NULL;
+}
+
+static gboolean
+infinoted_plugin_session_tickets_initialize(InfinotedPluginManager* manager,
+                                            gpointer plugin_info,
+                                            GError** error)
+{
+  InfinotedPluginSessionTickets* plugin;
+  InfCertificateCredentials* credentials;
+
+  plugin = (InfinotedPluginSessionTickets*)plugin_info;
+  plugin->manager = manager;
+
+  credentials = infinoted_plugin_manager_get_credentials(manager);
+  if(credentials == NULL)
+  {
+    infinoted_log_warning(
+      infinoted_plugin_manager_get_log(manager),
+      _("The server does not use TLS, no session tickets will be issued.")
+    );
+
+    return TRUE;
+  }
+
+  if(!inf_certificate_credentials_rotate_session_ticket_key(
+       credentials, error))
+  {
+    return FALSE;
+  }
+
+  plugin->credentials = inf_certificate_credentials_ref(credentials);
+  infinoted_plugin_session_tickets_schedule(plugin);
+  return TRUE;
+}
+
+static void
+infinoted_plugin_session_tickets_deinitialize(gpointer plugin_info)
+{
+  InfinotedPluginSessionTickets* plugin;
+  plugin = (InfinotedPluginSessionTickets*)plugin_info;
+
+  if(plugin->timeout != NULL)
+  {
+    inf_io_remove_timeout(
+      infinoted_plugin_manager_get_io(plugin->manager),
+      plugin->timeout
+    );
+  }
+
+  if(plugin->credentials != NULL)
+  {
+    inf_certificate_credentials_clear_session_ticket_key(plugin->credentials);
+    inf_certificate_credentials_unref(plugin->credentials);
+  }
+}
+
+static const InfinotedParameterInfo
+INFINOTED_PLUGIN_SESSION_TICKETS_OPTIONS[] = {
+  {
+    "rotation-interval",
+    INFINOTED_PARAMETER_INT,
+    0,
+    offsetof(InfinotedPluginSessionTickets, rotation_interval),
+    infinoted_parameter_convert_positive,
+    0,
+    N_("Interval, in seconds, after which the key to encrypt session "
+       "tickets is replaced by a new one. Clients that reconnect after the "
+       "key has been replaced need a full handshake. Defaults to 3600 "
+       "seconds."),
+    N_("SECONDS")
+  }, {
+    NULL,
+    0,
+    0,
+    0,
+    NULL
+  }
+};
+
+const InfinotedPlugin INFINOTED_PLUGIN = {
+  "session-tickets",
+  N_("Hands out TLS session tickets to clients, so that clients which "
+     "reconnect can resume their previous session without a full TLS "
+     "handshake. The key to encrypt the tickets is regularly rotated."),
+  INFINOTED_PLUGIN_SESSION_TICKETS_OPTIONS,
+  sizeof(InfinotedPluginSessionTickets),
+  0,
+  0,
+  NULL,
+  infinoted_plugin_session_tickets_info_initialize,
+  infinoted_plugin_session_tickets_initialize,
+  infinoted_plugin_session_tickets_deinitialize,
+  NULL,
+  NULL,
+  NULL,
+  NULL
+};
+
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,210 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include <infinoted/infinoted-plugin-manager.h>
+#include <infinoted/infinoted-parameter.h>
+#include <infinoted/infinoted-log.h>
+
+#include <libinfinity/common/inf-trace.h>
+#include <libinfinity/inf-i18n.h>
+
+#include <string.h>
+
+typedef struct _InfinotedPluginTracing InfinotedPluginTracing;
+struct _InfinotedPluginTracing {
+  InfinotedPluginManager* manager;
+  guint interval;
+  gboolean reset;
+
+  InfIoTimeout* timeout;
+};
+
+static void
+infinoted_plugin_tracing_timeout_cb(gpointer user_data);
+
+static void
+infinoted_plugin_tracing_schedule(InfinotedPluginTracing* plugin)
+{
+  plugin->timeout = inf_io_add_timeout(
+    infinoted_plugin_manager_get_io(plugin->manager),
+    plugin->interval * 1000,
+    infinoted_plugin_tracing_timeout_cb,
+    plugin,
+    NULL
+  );
+}
+
+static void
+infinoted_plugin_tracing_report(InfinotedPluginTracing* plugin)
+{
+  InfTraceHistogram histogram;
+  const gchar* unit;
+  gdouble scale;
+  guint i;
+
+  for(i = 0; i < INF_TRACE_N_PROBES; ++i)
+  {
+    inf_trace_get_histogram(i, &histogram);
+    if(histogram.count == 0) continue;
+
+    /* Report times in microseconds, which is more readable */
+    unit = inf_trace_probe_get_unit(i);
+    scale = 1.0;
+    if(strcmp(unit, "ns") == 0)
+    {
+      unit = "us";
+      scale = 1000.0;
+    }
+    else
+    {
+      unit = "";
+    }
+
+    infinoted_log_info(
+      infinoted_plugin_manager_get_log(plugin->manager),
+      _("Trace %s: %" G_GUINT64_FORMAT " samples, mean %.1f%s, "
+        "p50 %.1f%s, p99 %.1f%s, p999 %.1f%s, max %.1f%s"),
+      inf_trace_probe_get_name(i),
+      histogram.count,
+      (gdouble)histogram.sum / histogram.count / scale, unit,
+      inf_trace_histogram_get_percentile(&histogram, 0.5) / scale, unit,
+      inf_trace_histogram_get_percentile(&histogram, 0.99) / scale, unit,
+      inf_trace_histogram_get_percentile(&histogram, 0.999) / scale, unit,
+      histogram.max / scale, unit
+    );
+  }
+
+  if(plugin->reset == TRUE)
+    inf_trace_reset();
+}
+
+static void
+infinoted_plugin_tracing_timeout_cb(gpointer user_data)
+{
+  InfinotedPluginTracing* plugin;
+  plugin = (InfinotedPluginTracing*)user_data;
+
+  plugin->timeout = NULL;
+  infinoted_plugin_tracing_report(plugin);
+  infinoted_plugin_tracing_schedule(plugin);
+}
+
+static void
+infinoted_plugin_tracing_info_initialize(gpointer plugin_info)
+{
+  InfinotedPluginTracing* plugin;
+  plugin = (InfinotedPluginTracing*)plugin_info;
+
+  plugin->manager = NULL;
+  plugin->interval = 60;
+  plugin->reset = FALSE;
+  plugin->timeout = NULL;
+}
+
+static gboolean
+infinoted_plugin_tracing_initialize(InfinotedPluginManager* manager,
+                                    gpointer plugin_info,
+                                    GError** error)
+{
+  InfinotedPluginTracing* plugin;
+  plugin = (InfinotedPluginTracing*)plugin_info;
+
+  plugin->manager = manager;
+
+  if(!inf_trace_is_enabled())
+  {
+    infinoted_log_warning(
+      infinoted_plugin_manager_get_log(manager),
+      _("libinfinity was built without tracing support, no trace "
+        "statistics will be reported. Configure it with --enable-tracing "
+        "to enable tracing.")
+    );
+
+    return TRUE;
+  }
+
+  infinoted_plugin_tracing_schedule(plugin);
+  return TRUE;
+}
+
+static void
+infinoted_plugin_tracing_deinitialize(gpointer plugin_info)
+{
+  InfinotedPluginTracing* plugin;
+  plugin = (InfinotedPluginTracing*)plugin_info;
+
+  if(plugin->timeout != NULL)
+  {
+    inf_io_remove_timeout(
+      infinoted_plugin_manager_get_io(plugin->manager),
+      plugin->timeout
+    );
+  }
+}
+
+static const InfinotedParameterInfo INFINOTED_PLUGIN_TRACING_OPTIONS[] = {
+  {
+    "interval",
+    INFINOTED_PARAMETER_INT,
+    0,
+    offsetof(InfinotedPluginTracing, interval),
+    infinoted_parameter_convert_positive,
+    0,
+    N_("Interval, in seconds, after which to write trace statistics into "
+       "the log. Defaults to 60 seconds."),
+    N_("SECONDS")
+  }, {
+    "reset",
+    INFINOTED_PARAMETER_BOOLEAN,
+    0,
+    offsetof(InfinotedPluginTracing, reset),
+    infinoted_parameter_convert_boolean,
+    0,
+    N_("Whether to discard the trace statistics after each report, so that "
+       "each report only covers the preceding interval."),
+    NULL
+  }, {
+    NULL,
+    0,
+    0,
+    0,
+    NULL
+  }
+};
+
+const InfinotedPlugin INFINOTED_PLUGIN = {
+  "tracing",
+  N_("Periodically writes latency histograms of libinfinity's hot code "
+     "paths, such as request execution and message parsing, into the log. "
+     "This requires libinfinity to be built with --enable-tracing."),
+  INFINOTED_PLUGIN_TRACING_OPTIONS,
+  sizeof(InfinotedPluginTracing),
+  0,
+  0,
+  NULL,
+  infinoted_plugin_tracing_info_initialize,
+  infinoted_plugin_tracing_initialize,
+  infinoted_plugin_tracing_deinitialize,
+  NULL,
+  NULL,
+  NULL,
+  NULL
+};
+
+/* vim:set et sw=2 ts=2: */
@@ -17,6 +17,12 @@
  * MA 02110-1301, USA.
  */
 
+/* Log lines are produced on the main loop and written to disk by a
+ * separate writer thread, so that file I/O never blocks the main loop.
+ * The main loop only serializes the XML and appends a record to a bounded
+ * queue. If the queue is full, the record is dropped and the number of
+ * dropped records is written to the log file later. */
+
 #include <infinoted/infinoted-plugin-manager.h>
 #include <infinoted/infinoted-parameter.h>
 #include <infinoted/infinoted-util.h>
@@ -24,15 +30,77 @@
 #include <libinfinity/inf-signals.h>
 #include <libinfinity/inf-i18n.h>
 
-#include <libxml/xmlsave.h>
+#include <libxml/tree.h>
+
+#include <glib/gstdio.h>
 
 #include <string.h>
+#include <stdio.h>
 #include <errno.h>
 
+typedef enum _InfinotedPluginTrafficLoggingRecordType {
+  INFINOTED_PLUGIN_TRAFFIC_LOGGING_RECORD_OPEN,
+  INFINOTED_PLUGIN_TRAFFIC_LOGGING_RECORD_RECEIVED,
+  INFINOTED_PLUGIN_TRAFFIC_LOGGING_RECORD_SENT,
+  INFINOTED_PLUGIN_TRAFFIC_LOGGING_RECORD_ERROR,
+  INFINOTED_PLUGIN_TRAFFIC_LOGGING_RECORD_CLOSE
+} InfinotedPluginTrafficLoggingRecordType;
+
+/* A log file for one connection. It is created on the main thread, and
+ * once the OPEN record has been queued it is only accessed by the writer
+ * thread, which also frees it when processing the CLOSE record. The
+ * n_dropped field is only accessed by the main thread. */
+typedef struct _InfinotedPluginTrafficLoggingFile
+  InfinotedPluginTrafficLoggingFile;
+struct _InfinotedPluginTrafficLoggingFile {
+  gchar* filename;
+  FILE* file;
+  guint64 size;
+  gboolean dirty;
+
+  guint n_dropped;
+};
+
+typedef struct _InfinotedPluginTrafficLoggingRecord
+  InfinotedPluginTrafficLoggingRecord;
+struct _InfinotedPluginTrafficLoggingRecord {
+  InfinotedPluginTrafficLoggingFile* file;
+  InfinotedPluginTrafficLoggingRecordType type;
+  gint64 time;
+  /* Number of records dropped for this file before this one */
+  guint n_dropped;
+  gsize len;
+  /* followed by len bytes of text and a terminating NUL byte */
+};
+
 typedef struct _InfinotedPluginTrafficLogging InfinotedPluginTrafficLogging;
 struct _InfinotedPluginTrafficLogging {
   InfinotedPluginManager* manager;
   gchar* path;
+  guint buffer_size;
+  guint flush_interval;
+  guint flush_size;
+  guint max_file_size;
+
+  /* Serialization buffer, reused for every message, main thread only */
+  xmlBufferPtr xml_buffer;
+  guint64 n_dropped;
+
+  /* Protected by mutex */
+  GMutex mutex;
+  GCond cond;
+  GQueue queue;
+  gsize queued_bytes;
+  gboolean stop;
+
+  GThread* thread;
+
+  /* Writer thread only */
+  GSList* files;
+  gsize unflushed_bytes;
+  gint64 last_flush;
+  gint64 last_second;
+  gchar* last_prefix;
 };
 
 typedef struct _InfinotedPluginTrafficLoggingConnectionInfo
@@ -40,87 +108,373 @@ typedef struct _InfinotedPluginTrafficLoggingConnectionInfo
 struct _InfinotedPluginTrafficLoggingConnectionInfo {
   InfinotedPluginTrafficLogging* plugin;
   InfXmlConnection* connection;
-  gchar* filename;
-  FILE* file;
+  InfinotedPluginTrafficLoggingFile* file;
 };
 
+static gsize
+infinoted_plugin_traffic_logging_record_size(gsize len)
+{
+  return sizeof(InfinotedPluginTrafficLoggingRecord) + len + 1;
+}
+
 static void
-infinoted_plugin_traffic_logging_write(
+infinoted_plugin_traffic_logging_enqueue(
   InfinotedPluginTrafficLoggingConnectionInfo* info,
-  const gchar* fmt,
-  ...)
+  InfinotedPluginTrafficLoggingRecordType type,
+  const gchar* text,
+  gsize len)
 {
-  GTimeVal cur_timeval;
-  time_t cur_time;
-  struct tm* cur_tm;
-  char time_msg[128];
-  va_list arglist;
+  InfinotedPluginTrafficLogging* plugin;
+  InfinotedPluginTrafficLoggingRecord* record;
+  gsize size;
+  gboolean droppable;
 
+  plugin = info->plugin;
   g_assert(info->file != NULL);
 
-  g_get_current_time(&cur_timeval);
-  cur_time = cur_timeval.tv_sec;
-  cur_tm = localtime(&cur_time);
-  strftime(time_msg, 128, "[%c ", cur_tm);
-  fputs(time_msg, info->file);
-  fprintf(info->file, ".%06ld] ", cur_timeval.tv_usec);
+  size = infinoted_plugin_traffic_logging_record_size(len);
+
+  /* Opening and closing records transfer ownership of the file to or from
+   * the writer thread, so they are never dropped. */
+  droppable = type != INFINOTED_PLUGIN_TRAFFIC_LOGGING_RECORD_OPEN &&
+              type != INFINOTED_PLUGIN_TRAFFIC_LOGGING_RECORD_CLOSE;
+
+  g_mutex_lock(&plugin->mutex);
+
+  if(droppable &&
+     plugin->queued_bytes + size > (gsize)plugin->buffer_size * 1024)
+  {
+    g_mutex_unlock(&plugin->mutex);
 
-  va_start(arglist, fmt);
-  vfprintf(info->file, fmt, arglist);
-  va_end(arglist);
-  fputc('\n', info->file);
+    ++info->file->n_dropped;
+    ++plugin->n_dropped;
+    return;
+  }
 
-  fflush(info->file);
+  g_mutex_unlock(&plugin->mutex);
+
+  /* Allocate and fill the record outside of the lock */
+  record = g_malloc(size);
+  record->file = info->file;
+  record->type = type;
+  record->time = g_get_real_time();
+  record->n_dropped = info->file->n_dropped;
+  record->len = len;
+  memcpy(record + 1, text, len);
+  ((gchar*)(record + 1))[len] = '\0';
+
+  info->file->n_dropped = 0;
+
+  g_mutex_lock(&plugin->mutex);
+  g_queue_push_tail(&plugin->queue, record);
+  plugin->queued_bytes += size;
+  if(plugin->queue.length == 1)
+    g_cond_signal(&plugin->cond);
+  g_mutex_unlock(&plugin->mutex);
 }
 
 static void
-infinoted_plugin_traffic_logging_received_cb(InfXmlConnection* conn,
-                                             xmlNodePtr xml,
-                                             gpointer user_data)
+infinoted_plugin_traffic_logging_enqueue_xml(
+  InfinotedPluginTrafficLoggingConnectionInfo* info,
+  InfinotedPluginTrafficLoggingRecordType type,
+  xmlNodePtr xml)
 {
-  InfinotedPluginTrafficLoggingConnectionInfo* info;
-  xmlBufferPtr buffer;
-  xmlSaveCtxtPtr ctx;
-
-  info = (InfinotedPluginTrafficLoggingConnectionInfo*)user_data;
+  InfinotedPluginTrafficLogging* plugin;
+  plugin = info->plugin;
 
-  buffer = xmlBufferCreate();
-  ctx = xmlSaveToBuffer(buffer, "UTF-8", 0);
-  xmlSaveTree(ctx, xml);
-  xmlSaveClose(ctx);
+  xmlBufferEmpty(plugin->xml_buffer);
+  xmlNodeDump(plugin->xml_buffer, xml->doc, xml, 0, 0);
 
-  infinoted_plugin_traffic_logging_write(
+  infinoted_plugin_traffic_logging_enqueue(
     info,
-    "<<< %s",
-    (const gchar*)xmlBufferContent(buffer)
+    type,
+    (const gchar*)xmlBufferContent(plugin->xml_buffer),
+    xmlBufferLength(plugin->xml_buffer)
   );
+}
+
+static void
+infinoted_plugin_traffic_logging_rotate(
+  InfinotedPluginTrafficLogging* plugin,
+  InfinotedPluginTrafficLoggingFile* file)
+{
+  gchar* rotated;
+
+  fclose(file->file);
+  file->file = NULL;
+  file->dirty = FALSE;
 
-  xmlBufferFree(buffer);
+  rotated = g_strconcat(file->filename, ".1", NULL);
+
+  /* rename() does not overwrite an existing file on Windows */
+  g_unlink(rotated);
+  if(g_rename(file->filename, rotated) == -1)
+  {
+    infinoted_log_warning(
+      infinoted_plugin_manager_get_log(plugin->manager),
+      _("Failed to rotate traffic log \"%s\": %s"),
+      file->filename,
+      strerror(errno)
+    );
+  }
+
+  g_free(rotated);
+
+  file->file = fopen(file->filename, "w");
+  file->size = 0;
+
+  if(file->file == NULL)
+  {
+    infinoted_log_warning(
+      infinoted_plugin_manager_get_log(plugin->manager),
+      _("Failed to open file \"%s\": %s"),
+      file->filename,
+      strerror(errno)
+    );
+  }
 }
 
 static void
-infinoted_plugin_traffic_logging_sent_cb(InfXmlConnection* conn,
-                                         xmlNodePtr xml,
-                                         gpointer user_data)
+infinoted_plugin_traffic_logging_write_line(
+  InfinotedPluginTrafficLogging* plugin,
+  InfinotedPluginTrafficLoggingFile* file,
+  gint64 time,
+  const gchar* marker,
+  const gchar* text)
 {
-  InfinotedPluginTrafficLoggingConnectionInfo* info;
-  xmlBufferPtr buffer;
-  xmlSaveCtxtPtr ctx;
+  GDateTime* datetime;
+  gint64 second;
+  int written;
 
-  info = (InfinotedPluginTrafficLoggingConnectionInfo*)user_data;
+  if(file->file == NULL)
+    return;
+
+  /* Formatting the local time is expensive, so only do it once per
+   * second. */
+  second = time / G_USEC_PER_SEC;
+  if(plugin->last_prefix == NULL || second != plugin->last_second)
+  {
+    g_free(plugin->last_prefix);
 
-  buffer = xmlBufferCreate();
-  ctx = xmlSaveToBuffer(buffer, "UTF-8", 0);
-  xmlSaveTree(ctx, xml);
-  xmlSaveClose(ctx);
+    datetime = g_date_time_new_from_unix_local(second);
+    plugin->last_prefix = g_date_time_format(datetime, "[%c ");
+    g_date_time_unref(datetime);
 
-  infinoted_plugin_traffic_logging_write(
-    info,
-    ">>> %s",
-    (const gchar*)xmlBufferContent(buffer)
+    if(plugin->last_prefix == NULL)
+      plugin->last_prefix = g_strdup("[");
+    plugin->last_second = second;
+  }
+
+  written = fprintf(
+    file->file,
+    "%s.%06ld] %s %s\n",
+    plugin->last_prefix,
+    (long)(time % G_USEC_PER_SEC),
+    marker,
+    text
   );
 
-  xmlBufferFree(buffer);
+  if(written > 0)
+  {
+    file->size += written;
+    plugin->unflushed_bytes += written;
+    file->dirty = TRUE;
+  }
+
+  if(plugin->max_file_size > 0 &&
+     file->size >= (guint64)plugin->max_file_size * 1024)
+  {
+    infinoted_plugin_traffic_logging_rotate(plugin, file);
+  }
+}
+
+static void
+infinoted_plugin_traffic_logging_flush(InfinotedPluginTrafficLogging* plugin)
+{
+  InfinotedPluginTrafficLoggingFile* file;
+  GSList* item;
+
+  for(item = plugin->files; item != NULL; item = item->next)
+  {
+    file = (InfinotedPluginTrafficLoggingFile*)item->data;
+    if(file->dirty == TRUE && file->file != NULL)
+      fflush(file->file);
+    file->dirty = FALSE;
+  }
+
+  plugin->unflushed_bytes = 0;
+  plugin->last_flush = g_get_monotonic_time();
+}
+
+static void
+infinoted_plugin_traffic_logging_process(
+  InfinotedPluginTrafficLogging* plugin,
+  InfinotedPluginTrafficLoggingRecord* record)
+{
+  InfinotedPluginTrafficLoggingFile* file;
+  const gchar* text;
+  gchar* dropped;
+
+  file = record->file;
+  text = (const gchar*)(record + 1);
+
+  if(record->n_dropped > 0)
+  {
+    dropped = g_strdup_printf(
+      _("%u messages dropped because the log buffer was full"),
+      record->n_dropped
+    );
+
+    infinoted_plugin_traffic_logging_write_line(
+      plugin,
+      file,
+      record->time,
+      "!!!",
+      dropped
+    );
+
+    g_free(dropped);
+  }
+
+  switch(record->type)
+  {
+  case INFINOTED_PLUGIN_TRAFFIC_LOGGING_RECORD_OPEN:
+    plugin->files = g_slist_prepend(plugin->files, file);
+    infinoted_plugin_traffic_logging_write_line(
+      plugin, file, record->time, "!!!", text
+    );
+    break;
+  case INFINOTED_PLUGIN_TRAFFIC_LOGGING_RECORD_RECEIVED:
+    infinoted_plugin_traffic_logging_write_line(
+      plugin, file, record->time, "<<<", text
+    );
+    break;
+  case INFINOTED_PLUGIN_TRAFFIC_LOGGING_RECORD_SENT:
+    infinoted_plugin_traffic_logging_write_line(
+      plugin, file, record->time, ">>>", text
+    );
+    break;
+  case INFINOTED_PLUGIN_TRAFFIC_LOGGING_RECORD_ERROR:
+    infinoted_plugin_traffic_logging_write_line(
+      plugin, file, record->time, "!!!", text
+    );
+    break;
+  case INFINOTED_PLUGIN_TRAFFIC_LOGGING_RECORD_CLOSE:
+    infinoted_plugin_traffic_logging_write_line(
+      plugin, file, record->time, "!!!", text
+    );
+
+    plugin->files = g_slist_remove(plugin->files, file);
+
+    if(file->file != NULL && fclose(file->file) == EOF)
+    {
+      infinoted_log_warning(
+        infinoted_plugin_manager_get_log(plugin->manager),
+        _("Failed to close file \"%s\": %s"),
+        file->filename,
+        strerror(errno)
+      );
+    }
+
+    g_free(file->filename);
+    g_slice_free(InfinotedPluginTrafficLoggingFile, file);
+    break;
+  default:
+    g_assert_not_reached();
+    break;
+  }
+}
+
+static gpointer
+infinoted_plugin_traffic_logging_thread_func(gpointer data)
+{
+  InfinotedPluginTrafficLogging* plugin;
+  InfinotedPluginTrafficLoggingRecord* record;
+  GQueue batch;
+  gboolean stop;
+  gint64 now;
+
+  plugin = (InfinotedPluginTrafficLogging*)data;
+  plugin->last_flush = g_get_monotonic_time();
+
+  g_mutex_lock(&plugin->mutex);
+
+  for(;;)
+  {
+    if(plugin->queue.length == 0 && plugin->stop == FALSE)
+    {
+      /* Wake up in time to flush pending data when there is no more
+       * traffic. */
+      if(plugin->unflushed_bytes > 0)
+      {
+        g_cond_wait_until(
+          &plugin->cond,
+          &plugin->mutex,
+          plugin->last_flush +
+          (gint64)plugin->flush_interval * G_TIME_SPAN_MILLISECOND
+        );
+      }
+      else
+      {
+        g_cond_wait(&plugin->cond, &plugin->mutex);
+      }
+    }
+
+    batch = plugin->queue;
+    g_queue_init(&plugin->queue);
+    plugin->queued_bytes = 0;
+    stop = plugin->stop;
+
+    g_mutex_unlock(&plugin->mutex);
+
+    while((record = g_queue_pop_head(&batch)) != NULL)
+    {
+      infinoted_plugin_traffic_logging_process(plugin, record);
+      g_free(record);
+    }
+
+    now = g_get_monotonic_time();
+    if(plugin->unflushed_bytes >= (gsize)plugin->flush_size * 1024 ||
+       now - plugin->last_flush >=
+       (gint64)plugin->flush_interval * G_TIME_SPAN_MILLISECOND)
+    {
+      infinoted_plugin_traffic_logging_flush(plugin);
+    }
+
+    g_mutex_lock(&plugin->mutex);
+
+    if(stop == TRUE && plugin->queue.length == 0)
+      break;
+  }
+
+  g_mutex_unlock(&plugin->mutex);
+
+  infinoted_plugin_traffic_logging_flush(plugin);
+  return NULL;
+}
+
+static void
+infinoted_plugin_traffic_logging_received_cb(InfXmlConnection* conn,
+                                             xmlNodePtr xml,
+                                             gpointer user_data)
+{
+  infinoted_plugin_traffic_logging_enqueue_xml(
+    (InfinotedPluginTrafficLoggingConnectionInfo*)user_data,
+    INFINOTED_PLUGIN_TRAFFIC_LOGGING_RECORD_RECEIVED,
+    xml
+  );
+}
+
+static void
+infinoted_plugin_traffic_logging_sent_cb(InfXmlConnection* conn,
+                                         xmlNodePtr xml,
+                                         gpointer user_data)
+{
+  infinoted_plugin_traffic_logging_enqueue_xml(
+    (InfinotedPluginTrafficLoggingConnectionInfo*)user_data,
+    INFINOTED_PLUGIN_TRAFFIC_LOGGING_RECORD_SENT,
+    xml
+  );
 }
 
 static void
@@ -134,7 +488,14 @@ infinoted_plugin_traffic_logging_error_cb(InfXmlConnection* conn,
   info = (InfinotedPluginTrafficLoggingConnectionInfo*)user_data;
 
   text = g_strdup_printf(_("Connection error: %s"), error->message);
-  infinoted_plugin_traffic_logging_write(info, "!!! %s", text);
+
+  infinoted_plugin_traffic_logging_enqueue(
+    info,
+    INFINOTED_PLUGIN_TRAFFIC_LOGGING_RECORD_ERROR,
+    text,
+    strlen(text)
+  );
+
   g_free(text);
 }
 
@@ -146,6 +507,26 @@ infinoted_plugin_traffic_logging_info_initialize(gpointer plugin_info)
 
   plugin->manager = NULL;
   plugin->path = NULL;
+  plugin->buffer_size = 1024;
+  plugin->flush_interval = 1000;
+  plugin->flush_size = 64;
+  plugin->max_file_size = 0;
+
+  plugin->xml_buffer = NULL;
+  plugin->n_dropped = 0;
+
+  g_mutex_init(&plugin->mutex);
+  g_cond_init(&plugin->cond);
+  g_queue_init(&plugin->queue);
+  plugin->queued_bytes = 0;
+  plugin->stop = FALSE;
+  plugin->thread = NULL;
+
+  plugin->files = NULL;
+  plugin->unflushed_bytes = 0;
+  plugin->last_flush = 0;
+  plugin->last_second = 0;
+  plugin->last_prefix = NULL;
 }
 
 static gboolean
@@ -157,6 +538,17 @@ infinoted_plugin_traffic_logging_initialize(InfinotedPluginManager* manager,
   plugin = (InfinotedPluginTrafficLogging*)plugin_info;
 
   plugin->manager = manager;
+  plugin->xml_buffer = xmlBufferCreate();
+
+  plugin->thread = g_thread_try_new(
+    "InfinotedPluginTrafficLogging",
+    infinoted_plugin_traffic_logging_thread_func,
+    plugin,
+    error
+  );
+
+  if(plugin->thread == NULL)
+    return FALSE;
 
   return TRUE;
 }
@@ -167,6 +559,38 @@ infinoted_plugin_traffic_logging_deinitialize(gpointer plugin_info)
   InfinotedPluginTrafficLogging* plugin;
   plugin = (InfinotedPluginTrafficLogging*)plugin_info;
 
+  /* All connections have been removed at this point, so the writer thread
+   * only needs to write out the remaining records. */
+  if(plugin->thread != NULL)
+  {
+    g_mutex_lock(&plugin->mutex);
+    plugin->stop = TRUE;
+    g_cond_signal(&plugin->cond);
+    g_mutex_unlock(&plugin->mutex);
+
+    g_thread_join(plugin->thread);
+    plugin->thread = NULL;
+  }
+
+  g_assert(plugin->files == NULL);
+  g_assert(plugin->queue.length == 0);
+
+  if(plugin->n_dropped > 0)
+  {
+    infinoted_log_warning(
+      infinoted_plugin_manager_get_log(plugin->manager),
+      _("%" G_GUINT64_FORMAT " traffic log messages were dropped because "
+        "the log buffer was full"),
+      plugin->n_dropped
+    );
+  }
+
+  if(plugin->xml_buffer != NULL)
+    xmlBufferFree(plugin->xml_buffer);
+
+  g_free(plugin->last_prefix);
+  g_cond_clear(&plugin->cond);
+  g_mutex_clear(&plugin->mutex);
   g_free(plugin->path);
 }
 
@@ -180,8 +604,11 @@ infinoted_plugin_traffic_logging_connection_added(
   InfinotedPluginTrafficLoggingConnectionInfo* info;
   gchar* remote_id;
   gchar* basename;
+  gchar* filename;
   gchar* c;
   gchar* text;
+  FILE* file;
+  long offset;
   GError* error;
 
   plugin = (InfinotedPluginTrafficLogging*)plugin_info;
@@ -189,7 +616,6 @@ infinoted_plugin_traffic_logging_connection_added(
 
   info->plugin = plugin;
   info->connection = connection;
-  info->filename = NULL;
   info->file = NULL;
 
   g_object_get(G_OBJECT(connection), "remote-id", &remote_id, NULL);
@@ -198,13 +624,13 @@ infinoted_plugin_traffic_logging_connection_added(
   for(c = basename; *c != '\0'; ++c)
     if(*c == '[' || *c == ']')
       *c = '_';
-  info->filename = g_build_filename(plugin->path, basename, NULL);
+  filename = g_build_filename(plugin->path, basename, NULL);
   g_free(basename);
 
   error = NULL;
-  if(infinoted_util_create_dirname(info->filename, &error) == FALSE)
+  if(infinoted_util_create_dirname(filename, &error) == FALSE)
   {
-    basename = g_path_get_dirname(info->filename);
+    basename = g_path_get_dirname(filename);
 
     infinoted_log_warning(
       infinoted_plugin_manager_get_log(plugin->manager),
@@ -217,25 +643,42 @@ infinoted_plugin_traffic_logging_connection_added(
 
     g_error_free(error);
     g_free(basename);
+    g_free(filename);
   }
   else
   {
-    info->file = fopen(info->filename, "a");
-    if(info->file == NULL)
+    file = fopen(filename, "a");
+    if(file == NULL)
     {
       infinoted_log_warning(
         infinoted_plugin_manager_get_log(plugin->manager),
         _("Failed to open file \"%s\": %s\nTraffic logging "
           "for connection \"%s\" is disabled."),
-        info->filename,
+        filename,
         strerror(errno),
         remote_id
       );
+
+      g_free(filename);
     }
     else
     {
+      info->file = g_slice_new(InfinotedPluginTrafficLoggingFile);
+      info->file->filename = filename;
+      info->file->file = file;
+      info->file->size = 0;
+      if(fseek(file, 0, SEEK_END) == 0 && (offset = ftell(file)) > 0)
+        info->file->size = offset;
+      info->file->dirty = FALSE;
+      info->file->n_dropped = 0;
+
       text = g_strdup_printf(_("%s connected"), remote_id);
-      infinoted_plugin_traffic_logging_write(info, "!!! %s", text);
+      infinoted_plugin_traffic_logging_enqueue(
+        info,
+        INFINOTED_PLUGIN_TRAFFIC_LOGGING_RECORD_OPEN,
+        text,
+        strlen(text)
+      );
       g_free(text);
 
       g_signal_connect(
@@ -270,11 +713,9 @@ infinoted_plugin_traffic_logging_connection_removed(
   gpointer plugin_info,
   gpointer connection_info)
 {
-  InfinotedPluginTrafficLogging* plugin;
   InfinotedPluginTrafficLoggingConnectionInfo* info;
-  gchar* remote_id;
+  const gchar* text;
 
-  plugin = (InfinotedPluginTrafficLogging*)plugin_info;
   info = (InfinotedPluginTrafficLoggingConnectionInfo*)connection_info;
 
   if(info->file != NULL)
@@ -297,20 +738,17 @@ infinoted_plugin_traffic_logging_connection_removed(
       info
     );
 
-    infinoted_plugin_traffic_logging_write(info, "!!! %s", _("Log closed"));
+    /* The writer thread closes the file and frees it */
+    text = _("Log closed");
+    infinoted_plugin_traffic_logging_enqueue(
+      info,
+      INFINOTED_PLUGIN_TRAFFIC_LOGGING_RECORD_CLOSE,
+      text,
+      strlen(text)
+    );
 
-    if(fclose(info->file) == -1)
-    {
-      infinoted_log_warning(
-        infinoted_plugin_manager_get_log(plugin->manager),
-        "Failed to close file \"%s\": %s",
-        info->filename,
-        strerror(errno)
-      );
-    }
+    info->file = NULL;
   }
-
-  g_free(info->filename);
 }
 
 static const InfinotedParameterInfo
@@ -324,6 +762,48 @@ INFINOTED_PLUGIN_TRAFFIC_LOGGING_OPTIONS[] = {
     0,
     N_("The directory into which to write the log files."),
     N_("DIRECTORY")
+  }, {
+    "buffer-size",
+    INFINOTED_PARAMETER_INT,
+    0,
+    offsetof(InfinotedPluginTrafficLogging, buffer_size),
+    infinoted_parameter_convert_positive,
+    0,
+    N_("Maximum amount of log data, in kilobytes, that is kept in memory "
+       "before it is written to disk. If more traffic arrives while the "
+       "buffer is full, log messages are dropped."),
+    N_("KILOBYTES")
+  }, {
+    "flush-interval",
+    INFINOTED_PARAMETER_INT,
+    0,
+    offsetof(InfinotedPluginTrafficLogging, flush_interval),
+    infinoted_parameter_convert_positive,
+    0,
+    N_("Interval, in milliseconds, after which written log data is "
+       "flushed to the log files."),
+    N_("MILLISECONDS")
+  }, {
+    "flush-size",
+    INFINOTED_PARAMETER_INT,
+    0,
+    offsetof(InfinotedPluginTrafficLogging, flush_size),
+    infinoted_parameter_convert_positive,
+    0,
+    N_("Amount of log data, in kilobytes, after which the log files are "
+       "flushed before the flush interval has elapsed."),
+    N_("KILOBYTES")
+  }, {
+    "max-file-size",
+    INFINOTED_PARAMETER_INT,
+    0,
+    offsetof(InfinotedPluginTrafficLogging, max_file_size),
+    infinoted_parameter_convert_nonnegative,
+    0,
+    N_("Size, in kilobytes, after which a log file is renamed by appending "
+       "\".1\" to its name, replacing a previously rotated file, and a "
+       "new log file is started. 0 means log files are never rotated."),
+    N_("KILOBYTES")
   }, {
     NULL,
     0,
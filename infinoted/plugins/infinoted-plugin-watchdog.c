@@ -0,0 +1,179 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include <infinoted/infinoted-plugin-manager.h>
+#include <infinoted/infinoted-parameter.h>
+#include <infinoted/infinoted-log.h>
+
+#include <libinfinity/common/inf-standalone-io.h>
+#include <libinfinity/inf-signals.h>
+#include <libinfinity/inf-i18n.h>
+
+typedef struct _InfinotedPluginWatchdog InfinotedPluginWatchdog;
+struct _InfinotedPluginWatchdog {
+  InfinotedPluginManager* manager;
+  guint threshold;
+
+  InfStandaloneIo* io;
+};
+
+static void
+infinoted_plugin_watchdog_stall_cb(InfStandaloneIo* io,
+                                   const InfStandaloneIoStall* stall,
+                                   gpointer user_data)
+{
+  InfinotedPluginWatchdog* plugin;
+  GEnumClass* enum_class;
+  GEnumValue* value;
+  gchar* name;
+
+  plugin = (InfinotedPluginWatchdog*)user_data;
+
+  enum_class = G_ENUM_CLASS(
+    g_type_class_ref(INF_TYPE_STANDALONE_IO_CALLBACK_TYPE)
+  );
+
+  value = g_enum_get_value(enum_class, stall->type);
+  name = inf_standalone_io_stall_get_function_name(stall);
+
+  infinoted_log_warning(
+    infinoted_plugin_manager_get_log(plugin->manager),
+    _("Main loop stalled for %.1f ms in %s callback %s"),
+    stall->duration / 1000.0,
+    value->value_nick,
+    name
+  );
+
+  g_free(name);
+  g_type_class_unref(enum_class);
+}
+
+static void
+infinoted_plugin_watchdog_info_initialize(gpointer plugin_info)
+{
+  InfinotedPluginWatchdog* plugin;
+  plugin = (InfinotedPluginWatchdog*)plugin_info;
+
+  plugin->manager = NULL;
+  plugin->threshold = 100;
+  plugin->io = NULL;
+}
+
+static gboolean
+infinoted_plugin_watchdog_initialize(InfinotedPluginManager* manager,
+                                     gpointer plugin_info,
+                                     GError** error)
+{
+  InfinotedPluginWatchdog* plugin;
+  InfIo* io;
+
+  plugin = (InfinotedPluginWatchdog*)plugin_info;
+  plugin->manager = manager;
+
+  io = infinoted_plugin_manager_get_io(manager);
+  if(!INF_IS_STANDALONE_IO(io))
+  {
+    infinoted_log_warning(
+      infinoted_plugin_manager_get_log(manager),
+      _("The server does not use a standalone main loop, stalls of the main "
+        "loop cannot be detected.")
+    );
+
+    return TRUE;
+  }
+
+  plugin->io = INF_STANDALONE_IO(io);
+  g_object_ref(plugin->io);
+
+  g_signal_connect(
+    G_OBJECT(plugin->io),
+    "stall",
+    G_CALLBACK(infinoted_plugin_watchdog_stall_cb),
+    plugin
+  );
+
+  g_object_set(
+    G_OBJECT(plugin->io),
+    "stall-threshold", plugin->threshold,
+    NULL
+  );
+
+  return TRUE;
+}
+
+static void
+infinoted_plugin_watchdog_deinitialize(gpointer plugin_info)
+{
+  InfinotedPluginWatchdog* plugin;
+  plugin = (InfinotedPluginWatchdog*)plugin_info;
+
+  if(plugin->io != NULL)
+  {
+    g_object_set(G_OBJECT(plugin->io), "stall-threshold", 0, NULL);
+
+    inf_signal_handlers_disconnect_by_func(
+      G_OBJECT(plugin->io),
+      G_CALLBACK(infinoted_plugin_watchdog_stall_cb),
+      plugin
+    );
+
+    g_object_unref(plugin->io);
+  }
+}
+
+static const InfinotedParameterInfo INFINOTED_PLUGIN_WATCHDOG_OPTIONS[] = {
+  {
+    "threshold",
+    INFINOTED_PARAMETER_INT,
+    0,
+    offsetof(InfinotedPluginWatchdog, threshold),
+    infinoted_parameter_convert_positive,
+    0,
+    N_("Runtime, in milliseconds, above which a single callback of the main "
+       "loop is logged as a stall. Defaults to 100 milliseconds."),
+    N_("MILLISECONDS")
+  }, {
+    NULL,
+    0,
+    0,
+    0,
+    NULL
+  }
+};
+
+const InfinotedPlugin INFINOTED_PLUGIN = {
+  "watchdog",
+  N_("Measures the runtime of each callback of the server's main loop, and "
+     "writes a warning into the log when a single callback blocks the "
+     "server for longer than a threshold."),
+  INFINOTED_PLUGIN_WATCHDOG_OPTIONS,
+  sizeof(InfinotedPluginWatchdog),
+  0,
+  0,
+  NULL,
+  infinoted_plugin_watchdog_info_initialize,
+  infinoted_plugin_watchdog_initialize,
+  infinoted_plugin_watchdog_deinitialize,
+  NULL,
+  NULL,
+  NULL,
+  NULL
+};
+
+/* vim:set et sw=2 ts=2: */
@@ -54,6 +54,11 @@ enum {
   INF_GTK_PERMISSIONS_DIALOG_COLUMN_NAME = 1
 };
 
+/* If the server has more accounts than this, we do not offer a list of all
+ * accounts to choose from when adding a new sheet, but let the user type in
+ * the account name, and perform a reverse lookup. */
+static const guint INF_GTK_PERMISSIONS_DIALOG_MAX_LISTED_ACCOUNTS = 100;
+
 typedef struct _InfGtkPermissionsDialogPendingSheet
   InfGtkPermissionsDialogPendingSheet;
 struct _InfGtkPermissionsDialogPendingSheet {
@@ -1522,9 +1527,10 @@ inf_gtk_permissions_dialog_add_clicked_cb(GtkButton* button,
     NULL
   );
 
-  /* TODO: If there are more than, say 25 accounts (should be configurable),
-   * then use a free edit instead, and add a GtkEntryCompletion with all the
-   * accounts, and perform a lookup-by-name in our cached list first. */
+  /* If there are more than INF_GTK_PERMISSIONS_DIALOG_MAX_LISTED_ACCOUNTS
+   * accounts, then priv->accounts is NULL and we use a free edit instead.
+   * TODO: Add a GtkEntryCompletion in that case, which is filled via
+   * inf_browser_query_acl_account_range() with the typed text as prefix. */
   if(priv->accounts != NULL)
   {
     /* Create a list of possible accounts */
@@ -2188,6 +2194,7 @@ inf_gtk_permissions_dialog_query_acl_account_list_finished_cb(
   InfGtkPermissionsDialogPrivate* priv;
   const InfAclAccount* accounts;
   guint n_accounts;
+  InfAclAccountId next;
   guint i;
 
   InfAclAccountId account_id;
@@ -2209,12 +2216,12 @@ inf_gtk_permissions_dialog_query_acl_account_list_finished_cb(
   }
   else
   {
-    inf_request_result_get_query_acl_account_list(
+    inf_request_result_get_query_acl_account_range(
       res,
       NULL,
       &accounts,
       &n_accounts,
-      NULL
+      &next
     );
 
     /* Update user names from local account cache */
@@ -2236,6 +2243,11 @@ inf_gtk_permissions_dialog_query_acl_account_list_finished_cb(
       }
     }
 
+    /* If there are too many accounts, we do not keep a local list of all
+     * accounts, and fall back to free editing. */
+    if(next != 0)
+      return;
+
     /* Update local account cache */
     for(i = 0; i < priv->n_accounts; ++i)
       g_free(priv->accounts[i].name);
@@ -2340,32 +2352,17 @@ inf_gtk_permissions_dialog_update(InfGtkPermissionsDialog* dialog,
     if(inf_acl_mask_has(&perms, INF_ACL_CAN_QUERY_ACCOUNT_LIST) &&
        inf_acl_mask_has(&perms, INF_ACL_CAN_SET_ACL))
     {
-      priv->query_acl_account_list_request = inf_browser_get_pending_request(
-        priv->browser,
-        NULL,
-        "query-acl-account-list"
-      );
-
-      if(priv->query_acl_account_list_request == NULL)
-      {
-        priv->query_acl_account_list_request =
-          inf_browser_query_acl_account_list(
-            priv->browser,
-            inf_gtk_permissions_dialog_query_acl_account_list_finished_cb,
-            dialog
-          );
-      }
-      else
-      {
-        g_signal_connect(
-          G_OBJECT(priv->query_acl_account_list_request),
-          "finished",
-          G_CALLBACK(
-            inf_gtk_permissions_dialog_query_acl_account_list_finished_cb
-          ),
+      /* Only query the first few accounts; if there are more, we do not
+       * need the account list anyway, see above. */
+      priv->query_acl_account_list_request =
+        inf_browser_query_acl_account_range(
+          priv->browser,
+          NULL,
+          0,
+          INF_GTK_PERMISSIONS_DIALOG_MAX_LISTED_ACCOUNTS,
+          inf_gtk_permissions_dialog_query_acl_account_list_finished_cb,
           dialog
         );
-      }
     }
   }
 
@@ -67,6 +67,7 @@
  * dynamically as O(active users^2). */
 
 #include <libinfinity/adopted/inf-adopted-algorithm.h>
+#include <libinfinity/common/inf-trace.h>
 #include <libinfinity/inf-signals.h>
 #include <libinfinity/inf-i18n.h>
 
@@ -86,6 +87,8 @@ struct _InfAdoptedAlgorithmPrivate {
   InfAdoptedStateVector* buffer_modified_time;
 
   InfAdoptedRequest* execute_request;
+  /* Nesting depth of inf_adopted_algorithm_begin_batch() */
+  guint batch_depth;
 
   InfUserTable* user_table;
   InfBuffer* buffer;
@@ -96,6 +99,8 @@ struct _InfAdoptedAlgorithmPrivate {
   InfAdoptedUser** users_end;
 
   GSList* local_users;
+
+  InfAdoptedAlgorithmStatistics statistics;
 };
 
 enum {
@@ -126,6 +131,10 @@ enum {
 
 static guint algorithm_signals[LAST_SIGNAL];
 
+/* Average number of bytes a request in a request log occupies, including
+ * its state vector and operation. Used for memory usage estimates only. */
+static const gsize INF_ADOPTED_ALGORITHM_REQUEST_SIZE_ESTIMATE = 256;
+
 G_DEFINE_TYPE_WITH_CODE(InfAdoptedAlgorithm, inf_adopted_algorithm, G_TYPE_OBJECT,
   G_ADD_PRIVATE(InfAdoptedAlgorithm))
 
@@ -686,6 +695,8 @@ inf_adopted_algorithm_transform_request(InfAdoptedAlgorithm* algorithm,
     lcs_against
   );
 
+  ++INF_ADOPTED_ALGORITHM_PRIVATE(algorithm)->statistics.n_transformations;
+
   if(lcs_request != NULL)
     g_object_unref(lcs_request);
   if(lcs_against != NULL)
@@ -759,6 +770,7 @@ inf_adopted_algorithm_translate_request_forward(InfAdoptedAlgorithm* algorithm,
           inf_adopted_request_get_index(associated) - from_n + 1
         );
 
+        ++priv->statistics.n_folds;
         break;
       }
       else
@@ -831,6 +843,8 @@ inf_adopted_algorithm_translate_request_forward(InfAdoptedAlgorithm* algorithm,
           cur_req,
           associated_index - from_n
         );
+
+        ++priv->statistics.n_mirrors;
       }
     }
 
@@ -1035,6 +1049,7 @@ inf_adopted_algorithm_init(InfAdoptedAlgorithm* algorithm)
 
   priv->max_total_log_size = 2048;
   priv->execute_request = NULL;
+  priv->batch_depth = 0;
 
   priv->current = inf_adopted_state_vector_new();
   priv->buffer_modified_time = NULL;
@@ -1047,6 +1062,13 @@ inf_adopted_algorithm_init(InfAdoptedAlgorithm* algorithm)
   priv->users_end = NULL;
 
   priv->local_users = NULL;
+
+  priv->statistics.n_executed = 0;
+  priv->statistics.n_transformations = 0;
+  priv->statistics.n_folds = 0;
+  priv->statistics.n_mirrors = 0;
+  priv->statistics.n_cache_lookups = 0;
+  priv->statistics.n_cache_hits = 0;
 }
 
 static void
@@ -1743,8 +1765,11 @@ inf_adopted_algorithm_translate_request(InfAdoptedAlgorithm* algorithm,
   if(inf_adopted_request_affects_buffer(request))
   {
     result = inf_adopted_request_log_lookup_cached_request(log, to);
+    ++priv->statistics.n_cache_lookups;
+
     if(result != NULL)
     {
+      ++priv->statistics.n_cache_hits;
       g_object_ref(result);
       return result;
     }
@@ -1832,6 +1857,9 @@ inf_adopted_algorithm_execute_request(InfAdoptedAlgorithm* algorithm,
   GError* local_error;
   gchar* request_str;
 
+  INF_TRACE_DECLARE(trace_start);
+  INF_TRACE_DECLARE(trace_transformations);
+
   g_return_val_if_fail(INF_ADOPTED_IS_ALGORITHM(algorithm), FALSE);
   g_return_val_if_fail(INF_ADOPTED_IS_REQUEST(request), FALSE);
 
@@ -1869,6 +1897,11 @@ inf_adopted_algorithm_execute_request(InfAdoptedAlgorithm* algorithm,
   g_return_val_if_fail(priv->execute_request == NULL, FALSE);
   priv->execute_request = request;
 
+  INF_TRACE_BEGIN(trace_start);
+#ifdef LIBINFINITY_HAVE_TRACING
+  trace_transformations = priv->statistics.n_transformations;
+#endif
+
   inf_adopted_request_set_execute_time(request, g_get_real_time());
 
   g_signal_emit(
@@ -1966,11 +1999,15 @@ inf_adopted_algorithm_execute_request(InfAdoptedAlgorithm* algorithm,
     inf_adopted_request_get_request_type(translated) == INF_ADOPTED_REQUEST_DO
   );
 
-  inf_signal_handlers_block_by_func(
-    G_OBJECT(priv->buffer),
-    G_CALLBACK(inf_adopted_algorithm_buffer_notify_modified_cb),
-    algorithm
-  );
+  /* Within a batch, this is done once for all requests */
+  if(priv->batch_depth == 0)
+  {
+    inf_signal_handlers_block_by_func(
+      G_OBJECT(priv->buffer),
+      G_CALLBACK(inf_adopted_algorithm_buffer_notify_modified_cb),
+      algorithm
+    );
+  }
 
   if(apply == TRUE)
   {
@@ -1984,11 +2021,14 @@ inf_adopted_algorithm_execute_request(InfAdoptedAlgorithm* algorithm,
 
     if(local_error != NULL)
     {
-      inf_signal_handlers_unblock_by_func(
-        G_OBJECT(priv->buffer),
-        G_CALLBACK(inf_adopted_algorithm_buffer_notify_modified_cb),
-        algorithm
-      );
+      if(priv->batch_depth == 0)
+      {
+        inf_signal_handlers_unblock_by_func(
+          G_OBJECT(priv->buffer),
+          G_CALLBACK(inf_adopted_algorithm_buffer_notify_modified_cb),
+          algorithm
+        );
+      }
 
       g_signal_emit(
         G_OBJECT(algorithm),
@@ -2019,13 +2059,16 @@ inf_adopted_algorithm_execute_request(InfAdoptedAlgorithm* algorithm,
     log_request
   );
 
-  inf_signal_handlers_unblock_by_func(
-    G_OBJECT(priv->buffer),
-    G_CALLBACK(inf_adopted_algorithm_buffer_notify_modified_cb),
-    algorithm
-  );
+  if(priv->batch_depth == 0)
+  {
+    inf_signal_handlers_unblock_by_func(
+      G_OBJECT(priv->buffer),
+      G_CALLBACK(inf_adopted_algorithm_buffer_notify_modified_cb),
+      algorithm
+    );
 
-  inf_adopted_algorithm_update_undo_redo(algorithm);
+    inf_adopted_algorithm_update_undo_redo(algorithm);
+  }
 
   g_signal_emit(
     G_OBJECT(algorithm),
@@ -2040,10 +2083,146 @@ inf_adopted_algorithm_execute_request(InfAdoptedAlgorithm* algorithm,
   g_object_unref(translated);
   g_object_unref(log_request);
 
+  ++priv->statistics.n_executed;
   priv->execute_request = NULL;
+
+  INF_TRACE_END(INF_TRACE_ALGORITHM_EXECUTE, trace_start);
+  INF_TRACE_VALUE(
+    INF_TRACE_ALGORITHM_TRANSFORMATIONS,
+    priv->statistics.n_transformations - trace_transformations
+  );
+
   return TRUE;
 }
 
+/**
+ * inf_adopted_algorithm_begin_batch:
+ * @algorithm: A #InfAdoptedAlgorithm.
+ *
+ * Starts a batch of requests to be executed. Until the batch is ended with
+ * inf_adopted_algorithm_end_batch(), requests executed with
+ * inf_adopted_algorithm_execute_request() still emit the
+ * #InfAdoptedAlgorithm::begin-execute-request and
+ * #InfAdoptedAlgorithm::end-execute-request signals, but the
+ * #InfAdoptedAlgorithm::can-undo-changed and
+ * #InfAdoptedAlgorithm::can-redo-changed signals and property change
+ * notifications of the algorithm and its buffer are deferred until the end
+ * of the batch, and emitted only once. This saves work when many requests
+ * are executed in a row, for example when catching up with other
+ * participants.
+ *
+ * While a batch is in progress, inf_adopted_algorithm_can_undo() and
+ * inf_adopted_algorithm_can_redo() compute their result for local users
+ * instead of returning the cached value, so that Undo and Redo requests
+ * within the batch are validated against the requests executed before them.
+ * Batches can be nested; only the end of the outermost batch has an effect.
+ **/
+void
+inf_adopted_algorithm_begin_batch(InfAdoptedAlgorithm* algorithm)
+{
+  InfAdoptedAlgorithmPrivate* priv;
+
+  g_return_if_fail(INF_ADOPTED_IS_ALGORITHM(algorithm));
+
+  priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
+  g_return_if_fail(priv->execute_request == NULL);
+
+  if(priv->batch_depth++ == 0)
+  {
+    g_object_freeze_notify(G_OBJECT(algorithm));
+    g_object_freeze_notify(G_OBJECT(priv->buffer));
+
+    inf_signal_handlers_block_by_func(
+      G_OBJECT(priv->buffer),
+      G_CALLBACK(inf_adopted_algorithm_buffer_notify_modified_cb),
+      algorithm
+    );
+  }
+}
+
+/**
+ * inf_adopted_algorithm_end_batch:
+ * @algorithm: A #InfAdoptedAlgorithm.
+ *
+ * Ends a batch of requests started with inf_adopted_algorithm_begin_batch().
+ * If this ends the outermost batch, then deferred signals and notifications
+ * are emitted.
+ **/
+void
+inf_adopted_algorithm_end_batch(InfAdoptedAlgorithm* algorithm)
+{
+  InfAdoptedAlgorithmPrivate* priv;
+
+  g_return_if_fail(INF_ADOPTED_IS_ALGORITHM(algorithm));
+
+  priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
+  g_return_if_fail(priv->batch_depth > 0);
+  g_return_if_fail(priv->execute_request == NULL);
+
+  if(--priv->batch_depth == 0)
+  {
+    /* Thaw the buffer while the handler is still blocked, since changes of
+     * the modified flag caused by executed requests are tracked by
+     * inf_adopted_algorithm_log_request() already. */
+    g_object_thaw_notify(G_OBJECT(priv->buffer));
+
+    inf_signal_handlers_unblock_by_func(
+      G_OBJECT(priv->buffer),
+      G_CALLBACK(inf_adopted_algorithm_buffer_notify_modified_cb),
+      algorithm
+    );
+
+    inf_adopted_algorithm_update_undo_redo(algorithm);
+    g_object_thaw_notify(G_OBJECT(algorithm));
+  }
+}
+
+/**
+ * inf_adopted_algorithm_execute_requests:
+ * @algorithm: A #InfAdoptedAlgorithm.
+ * @requests: (array length=n_requests): The requests to execute.
+ * @n_requests: The number of requests in @requests.
+ * @apply: Whether to apply the requests to the buffer.
+ * @error: Location to store error information, if any, or %NULL.
+ *
+ * Executes all requests in @requests in order, as if
+ * inf_adopted_algorithm_execute_request() was called for each of them, within
+ * a single batch as with inf_adopted_algorithm_begin_batch(). Each request
+ * needs to be causally before the state that @algorithm is in after having
+ * executed the previous ones.
+ *
+ * If a request cannot be executed, the remaining ones are not executed and
+ * @error is set.
+ *
+ * Returns: The number of requests that were executed successfully.
+ **/
+guint
+inf_adopted_algorithm_execute_requests(InfAdoptedAlgorithm* algorithm,
+                                       InfAdoptedRequest** requests,
+                                       guint n_requests,
+                                       gboolean apply,
+                                       GError** error)
+{
+  guint i;
+
+  g_return_val_if_fail(INF_ADOPTED_IS_ALGORITHM(algorithm), 0);
+  g_return_val_if_fail(requests != NULL || n_requests == 0, 0);
+
+  inf_adopted_algorithm_begin_batch(algorithm);
+
+  for(i = 0; i < n_requests; ++i)
+  {
+    if(!inf_adopted_algorithm_execute_request(
+         algorithm, requests[i], apply, error))
+    {
+      break;
+    }
+  }
+
+  inf_adopted_algorithm_end_batch(algorithm);
+  return i;
+}
+
 /**
  * inf_adopted_algorithm_cleanup:
  * @algorithm: A #InfAdoptedAlgorithm.
@@ -2175,6 +2354,98 @@ inf_adopted_algorithm_cleanup(InfAdoptedAlgorithm* algorithm)
   inf_adopted_state_vector_free(lcp);
 }
 
+/**
+ * inf_adopted_algorithm_get_memory_usage:
+ * @algorithm: A #InfAdoptedAlgorithm.
+ *
+ * Returns an estimate of the number of bytes occupied by the request logs of
+ * all users known to @algorithm, including their caches of translated
+ * requests. The memory used by the buffer itself is not included. The
+ * estimate assumes a fixed average size per request, and is therefore only
+ * meaningful to compare the relative size of different sessions.
+ *
+ * Returns: The approximate memory usage of the request logs, in bytes.
+ **/
+gsize
+inf_adopted_algorithm_get_memory_usage(InfAdoptedAlgorithm* algorithm)
+{
+  InfAdoptedAlgorithmPrivate* priv;
+  InfAdoptedUser** user;
+  InfAdoptedRequestLog* log;
+  gsize n_requests;
+
+  g_return_val_if_fail(INF_ADOPTED_IS_ALGORITHM(algorithm), 0);
+
+  priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
+  n_requests = 0;
+
+  for(user = priv->users_begin; user != priv->users_end; ++ user)
+  {
+    log = inf_adopted_user_get_request_log(*user);
+
+    n_requests += inf_adopted_request_log_get_end(log) -
+      inf_adopted_request_log_get_begin(log);
+    n_requests += inf_adopted_request_log_get_cache_size(log);
+  }
+
+  return n_requests * INF_ADOPTED_ALGORITHM_REQUEST_SIZE_ESTIMATE;
+}
+
+/**
+ * inf_adopted_algorithm_get_statistics:
+ * @algorithm: A #InfAdoptedAlgorithm.
+ * @statistics: (out): Location to store the statistics.
+ *
+ * Fills @statistics with counters of the work @algorithm has done since it
+ * was created. This is meant for benchmarking and profiling; comparing the
+ * counters before and after an operation shows how many transformations it
+ * required and how effective the caches of translated requests were.
+ **/
+void
+inf_adopted_algorithm_get_statistics(InfAdoptedAlgorithm* algorithm,
+                                     InfAdoptedAlgorithmStatistics* statistics)
+{
+  g_return_if_fail(INF_ADOPTED_IS_ALGORITHM(algorithm));
+  g_return_if_fail(statistics != NULL);
+
+  *statistics = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm)->statistics;
+}
+
+/**
+ * inf_adopted_algorithm_trim:
+ * @algorithm: A #InfAdoptedAlgorithm.
+ *
+ * Reduces the memory used by @algorithm as far as possible without affecting
+ * its behaviour. This runs inf_adopted_algorithm_cleanup() and then drops the
+ * caches of translated requests of all request logs. Translations that are
+ * required later are computed again on demand.
+ *
+ * Requests that may still be undone, or that not all participants have
+ * processed yet, are kept, so the request history remains valid for all
+ * participants of the session.
+ **/
+void
+inf_adopted_algorithm_trim(InfAdoptedAlgorithm* algorithm)
+{
+  InfAdoptedAlgorithmPrivate* priv;
+  InfAdoptedUser** user;
+
+  g_return_if_fail(INF_ADOPTED_IS_ALGORITHM(algorithm));
+
+  priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
+  if(priv->users_begin == priv->users_end)
+    return;
+
+  inf_adopted_algorithm_cleanup(algorithm);
+
+  for(user = priv->users_begin; user != priv->users_end; ++ user)
+  {
+    inf_adopted_request_log_clear_cache(
+      inf_adopted_user_get_request_log(*user)
+    );
+  }
+}
+
 /**
  * inf_adopted_algorithm_can_undo:
  * @algorithm: A #InfAdoptedAlgorithm.
@@ -2193,14 +2464,18 @@ gboolean
 inf_adopted_algorithm_can_undo(InfAdoptedAlgorithm* algorithm,
                                InfAdoptedUser* user)
 {
+  InfAdoptedAlgorithmPrivate* priv;
   InfAdoptedAlgorithmLocalUser* local;
   InfAdoptedRequestLog* log;
 
   g_return_val_if_fail(INF_ADOPTED_IS_ALGORITHM(algorithm), FALSE);
   g_return_val_if_fail(INF_ADOPTED_IS_USER(user), FALSE);
 
+  priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
+
+  /* The cached value is only updated at the end of a batch */
   local = inf_adopted_algorithm_find_local_user(algorithm, user);
-  if(local != NULL)
+  if(local != NULL && priv->batch_depth == 0)
   {
     return local->can_undo;
   }
@@ -2234,14 +2509,18 @@ gboolean
 inf_adopted_algorithm_can_redo(InfAdoptedAlgorithm* algorithm,
                                InfAdoptedUser* user)
 {
+  InfAdoptedAlgorithmPrivate* priv;
   InfAdoptedAlgorithmLocalUser* local;
   InfAdoptedRequestLog* log;
 
   g_return_val_if_fail(INF_ADOPTED_IS_ALGORITHM(algorithm), FALSE);
   g_return_val_if_fail(INF_ADOPTED_IS_USER(user), FALSE);
 
+  priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
+
+  /* The cached value is only updated at the end of a batch */
   local = inf_adopted_algorithm_find_local_user(algorithm, user);
-  if(local != NULL)
+  if(local != NULL && priv->batch_depth == 0)
   {
     return local->can_redo;
   }
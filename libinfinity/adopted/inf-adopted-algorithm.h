@@ -96,6 +96,31 @@ struct _InfAdoptedAlgorithmClass {
                              const GError* error);
 };
 
+/**
+ * InfAdoptedAlgorithmStatistics:
+ * @n_executed: The number of requests that were executed successfully.
+ * @n_transformations: The number of times a request was transformed against
+ * a concurrent request.
+ * @n_folds: The number of times a request was folded along an undo/redo
+ * pair.
+ * @n_mirrors: The number of times a request was mirrored.
+ * @n_cache_lookups: The number of lookups in the caches of translated
+ * requests.
+ * @n_cache_hits: The number of cache lookups that found a translated request.
+ *
+ * Counters of the work done by a #InfAdoptedAlgorithm, see
+ * inf_adopted_algorithm_get_statistics().
+ */
+typedef struct _InfAdoptedAlgorithmStatistics InfAdoptedAlgorithmStatistics;
+struct _InfAdoptedAlgorithmStatistics {
+  guint64 n_executed;
+  guint64 n_transformations;
+  guint64 n_folds;
+  guint64 n_mirrors;
+  guint64 n_cache_lookups;
+  guint64 n_cache_hits;
+};
+
 /**
  * InfAdoptedAlgorithm:
  *
@@ -143,9 +168,32 @@ inf_adopted_algorithm_execute_request(InfAdoptedAlgorithm* algorithm,
                                       gboolean apply,
                                       GError** error);
 
+void
+inf_adopted_algorithm_begin_batch(InfAdoptedAlgorithm* algorithm);
+
+void
+inf_adopted_algorithm_end_batch(InfAdoptedAlgorithm* algorithm);
+
+guint
+inf_adopted_algorithm_execute_requests(InfAdoptedAlgorithm* algorithm,
+                                       InfAdoptedRequest** requests,
+                                       guint n_requests,
+                                       gboolean apply,
+                                       GError** error);
+
 void
 inf_adopted_algorithm_cleanup(InfAdoptedAlgorithm* algorithm);
 
+gsize
+inf_adopted_algorithm_get_memory_usage(InfAdoptedAlgorithm* algorithm);
+
+void
+inf_adopted_algorithm_get_statistics(InfAdoptedAlgorithm* algorithm,
+                                     InfAdoptedAlgorithmStatistics* statistics);
+
+void
+inf_adopted_algorithm_trim(InfAdoptedAlgorithm* algorithm);
+
 gboolean
 inf_adopted_algorithm_can_undo(InfAdoptedAlgorithm* algorithm,
                                InfAdoptedUser* user);
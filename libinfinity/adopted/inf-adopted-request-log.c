@@ -1396,4 +1396,51 @@ inf_adopted_request_log_lookup_cached_request(InfAdoptedRequestLog* log,
   return INF_ADOPTED_REQUEST(g_tree_lookup(priv->cache, vec));
 }
 
+/**
+ * inf_adopted_request_log_get_cache_size:
+ * @log: A #InfAdoptedRequestLog.
+ *
+ * Returns the number of translated requests that are currently stored in
+ * the request cache of @log.
+ *
+ * Returns: The number of cached requests.
+ */
+guint
+inf_adopted_request_log_get_cache_size(InfAdoptedRequestLog* log)
+{
+  InfAdoptedRequestLogPrivate* priv;
+
+  g_return_val_if_fail(INF_ADOPTED_IS_REQUEST_LOG(log), 0);
+
+  priv = INF_ADOPTED_REQUEST_LOG_PRIVATE(log);
+  if(priv->cache == NULL) return 0;
+
+  return g_tree_nnodes(priv->cache);
+}
+
+/**
+ * inf_adopted_request_log_clear_cache:
+ * @log: A #InfAdoptedRequestLog.
+ *
+ * Removes all requests from the request cache of @log. This does not affect
+ * the requests in the log itself, and it does not change the result of any
+ * transformation, but cached translations will need to be computed again
+ * when they are requested the next time. This can be used to reduce memory
+ * usage.
+ */
+void
+inf_adopted_request_log_clear_cache(InfAdoptedRequestLog* log)
+{
+  InfAdoptedRequestLogPrivate* priv;
+
+  g_return_if_fail(INF_ADOPTED_IS_REQUEST_LOG(log));
+
+  priv = INF_ADOPTED_REQUEST_LOG_PRIVATE(log);
+  if(priv->cache != NULL)
+  {
+    g_tree_destroy(priv->cache);
+    priv->cache = NULL;
+  }
+}
+
 /* vim:set et sw=2 ts=2: */
@@ -133,6 +133,12 @@ InfAdoptedRequest*
 inf_adopted_request_log_lookup_cached_request(InfAdoptedRequestLog* log,
                                               InfAdoptedStateVector* vec);
 
+guint
+inf_adopted_request_log_get_cache_size(InfAdoptedRequestLog* log);
+
+void
+inf_adopted_request_log_clear_cache(InfAdoptedRequestLog* log);
+
 G_END_DECLS
 
 #endif /* __INF_ADOPTED_REQUEST_LOG_H__ */
@@ -0,0 +1,76 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef __INF_ADOPTED_SESSION_RECORD_PRIVATE_H__
+#define __INF_ADOPTED_SESSION_RECORD_PRIVATE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Layout of binary session records, shared between InfAdoptedSessionRecord
+ * and InfAdoptedSessionReplay. All integers are stored in little endian.
+ *
+ * The file starts with a 16 byte header: the magic, a 32 bit version number
+ * and 32 reserved bits. It is followed by a sequence of records, each of
+ * which consists of a 32 bit record type, the 32 bit payload length and the
+ * payload. The payload of INITIAL, REQUEST and USER records is an encoded
+ * XML node with the same content as in the XML format. The payload of a
+ * CHECKPOINT record is the 64 bit number of REQUEST records preceding it,
+ * followed by an encoded XML node like the one of the INITIAL record, which
+ * synchronizes the complete session state at that point.
+ *
+ * When recording is stopped properly, an INDEX record with the 32 bit
+ * number of checkpoints and, for each checkpoint, its 64 bit number of
+ * preceding requests and 64 bit file offset is written, followed by a 16
+ * byte footer with the 64 bit offset of the INDEX record and the index
+ * magic. If the footer is missing, readers scan the file for checkpoints.
+ *
+ * An encoded XML element is the byte 1, the 16 bit length of the element
+ * name, the name, the 16 bit number of attributes, for each attribute the
+ * 16 bit name length, the name, the 32 bit value length and the value, then
+ * the 32 bit number of children and the encoded children. An encoded text
+ * node is the byte 2, the 32 bit length of the text and the text. */
+
+#define INF_ADOPTED_SESSION_RECORD_BINARY_MAGIC "\211InfRcrd"
+#define INF_ADOPTED_SESSION_RECORD_BINARY_INDEX_MAGIC "InfRcIdx"
+#define INF_ADOPTED_SESSION_RECORD_BINARY_MAGIC_SIZE 8
+#define INF_ADOPTED_SESSION_RECORD_BINARY_VERSION 1
+#define INF_ADOPTED_SESSION_RECORD_BINARY_HEADER_SIZE 16
+#define INF_ADOPTED_SESSION_RECORD_BINARY_FOOTER_SIZE 16
+#define INF_ADOPTED_SESSION_RECORD_BINARY_RECORD_HEADER_SIZE 8
+
+typedef enum _InfAdoptedSessionRecordBinaryType {
+  INF_ADOPTED_SESSION_RECORD_BINARY_INITIAL = 1,
+  INF_ADOPTED_SESSION_RECORD_BINARY_REQUEST = 2,
+  INF_ADOPTED_SESSION_RECORD_BINARY_USER = 3,
+  INF_ADOPTED_SESSION_RECORD_BINARY_CHECKPOINT = 4,
+  INF_ADOPTED_SESSION_RECORD_BINARY_INDEX = 5
+} InfAdoptedSessionRecordBinaryType;
+
+typedef enum _InfAdoptedSessionRecordBinaryNode {
+  INF_ADOPTED_SESSION_RECORD_BINARY_NODE_ELEMENT = 1,
+  INF_ADOPTED_SESSION_RECORD_BINARY_NODE_TEXT = 2
+} InfAdoptedSessionRecordBinaryNode;
+
+G_END_DECLS
+
+#endif /* __INF_ADOPTED_SESSION_RECORD_PRIVATE_H__ */
+
+/* vim:set et sw=2 ts=2: */
@@ -39,12 +39,22 @@
  * to make it easy to reproduce bugs in libinfinity. However, it might be
  * extended in the future.
  *
+ * By default the record is written as XML. With the
+ * #InfAdoptedSessionRecord:format property set to
+ * %INF_ADOPTED_SESSION_RECORD_FORMAT_BINARY, a compact binary format is
+ * used instead, which is not flushed after every request and which contains
+ * a checkpoint of the complete session state every
+ * #InfAdoptedSessionRecord:checkpoint-interval requests. Replaying can
+ * start at any of these checkpoints, see inf_adopted_session_replay_seek().
+ *
  * To replay a record, use #InfAdoptedSessionReplay or the tool
  * <literal>inf-test-text-replay</literal> in the infinote test suite.
  */
 
 #include <libinfinity/adopted/inf-adopted-session-record.h>
+#include <libinfinity/adopted/inf-adopted-session-record-private.h>
 #include <libinfinity/common/inf-xml-util.h>
+#include <libinfinity/inf-define-enum.h>
 #include <libinfinity/inf-i18n.h>
 #include <libinfinity/inf-signals.h>
 
@@ -56,13 +66,46 @@
 /* TODO: Record user join/leave events, and update last send vectors on
  * rejoin. */
 
+static const GEnumValue inf_adopted_session_record_format_values[] = {
+  {
+    INF_ADOPTED_SESSION_RECORD_FORMAT_XML,
+    "INF_ADOPTED_SESSION_RECORD_FORMAT_XML",
+    "xml"
+  }, {
+    INF_ADOPTED_SESSION_RECORD_FORMAT_BINARY,
+    "INF_ADOPTED_SESSION_RECORD_FORMAT_BINARY",
+    "binary"
+  }, {
+    0,
+    NULL,
+    NULL
+  }
+};
+
+typedef struct _InfAdoptedSessionRecordCheckpoint
+  InfAdoptedSessionRecordCheckpoint;
+struct _InfAdoptedSessionRecordCheckpoint {
+  guint64 n_requests;
+  guint64 offset;
+};
+
 typedef struct _InfAdoptedSessionRecordPrivate InfAdoptedSessionRecordPrivate;
 struct _InfAdoptedSessionRecordPrivate {
   InfAdoptedSession* session;
+  InfAdoptedSessionRecordFormat format;
+  guint checkpoint_interval;
+
   xmlTextWriterPtr writer;
   FILE* file;
   gchar* filename;
 
+  /* Binary format only */
+  gboolean binary;
+  guint64 offset;
+  guint64 n_requests;
+  guint64 last_checkpoint;
+  GArray* checkpoints;
+
   GHashTable* last_send_table;
 };
 
@@ -71,13 +114,18 @@ enum {
 
   /* construct only */
   PROP_SESSION,
-  PROP_FILENAME
+  PROP_FILENAME,
+
+  /* read/write */
+  PROP_FORMAT,
+  PROP_CHECKPOINT_INTERVAL
 };
 
 #define INF_ADOPTED_SESSION_RECORD_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE((obj), INF_ADOPTED_TYPE_SESSION_RECORD, InfAdoptedSessionRecordPrivate))
 
 static GQuark libxml2_writer_error_quark;
 
+INF_DEFINE_ENUM_TYPE(InfAdoptedSessionRecordFormat, inf_adopted_session_record_format, inf_adopted_session_record_format_values)
 G_DEFINE_TYPE_WITH_CODE(InfAdoptedSessionRecord, inf_adopted_session_record, G_TYPE_OBJECT,
   G_ADD_PRIVATE(InfAdoptedSessionRecord))
 
@@ -98,6 +146,154 @@ inf_adopted_session_record_handle_xml_error(InfAdoptedSessionRecord* record)
   );
 }
 
+static void
+inf_adopted_session_record_handle_errno_error(InfAdoptedSessionRecord* record)
+{
+  InfAdoptedSessionRecordPrivate* priv;
+  priv = INF_ADOPTED_SESSION_RECORD_PRIVATE(record);
+
+  g_warning(
+    /* Error writing record `<filename>': <Reason> */
+    _("Error writing record \"%s\": %s"),
+    priv->filename,
+    strerror(errno)
+  );
+}
+
+static void
+inf_adopted_session_record_append_uint(GByteArray* array,
+                                       guint64 value,
+                                       guint n_bytes)
+{
+  guint8 data[8];
+  guint i;
+
+  g_assert(n_bytes <= 8);
+
+  for(i = 0; i < n_bytes; ++i)
+    data[i] = (value >> (8 * i)) & 0xff;
+
+  g_byte_array_append(array, data, n_bytes);
+}
+
+static void
+inf_adopted_session_record_append_string(GByteArray* array,
+                                         const xmlChar* str,
+                                         guint n_length_bytes)
+{
+  gsize len;
+  len = strlen((const char*)str);
+
+  inf_adopted_session_record_append_uint(array, len, n_length_bytes);
+  g_byte_array_append(array, (const guint8*)str, len);
+}
+
+static void
+inf_adopted_session_record_encode_node(GByteArray* array,
+                                       xmlNodePtr xml)
+{
+  xmlAttrPtr attr;
+  xmlChar* value;
+  xmlNodePtr child;
+  guint n;
+
+  inf_adopted_session_record_append_uint(
+    array,
+    INF_ADOPTED_SESSION_RECORD_BINARY_NODE_ELEMENT,
+    1
+  );
+
+  inf_adopted_session_record_append_string(array, xml->name, 2);
+
+  n = 0;
+  for(attr = xml->properties; attr != NULL; attr = attr->next)
+    ++n;
+  inf_adopted_session_record_append_uint(array, n, 2);
+
+  for(attr = xml->properties; attr != NULL; attr = attr->next)
+  {
+    inf_adopted_session_record_append_string(array, attr->name, 2);
+
+    value = xmlGetProp(xml, attr->name);
+    inf_adopted_session_record_append_string(array, value, 4);
+    xmlFree(value);
+  }
+
+  n = 0;
+  for(child = xml->children; child != NULL; child = child->next)
+    if(child->type == XML_ELEMENT_NODE || child->type == XML_TEXT_NODE)
+      ++n;
+  inf_adopted_session_record_append_uint(array, n, 4);
+
+  for(child = xml->children; child != NULL; child = child->next)
+  {
+    if(child->type == XML_ELEMENT_NODE)
+    {
+      inf_adopted_session_record_encode_node(array, child);
+    }
+    else if(child->type == XML_TEXT_NODE)
+    {
+      inf_adopted_session_record_append_uint(
+        array,
+        INF_ADOPTED_SESSION_RECORD_BINARY_NODE_TEXT,
+        1
+      );
+
+      value = xmlNodeGetContent(child);
+      inf_adopted_session_record_append_string(array, value, 4);
+      xmlFree(value);
+    }
+  }
+}
+
+static void
+inf_adopted_session_record_write_data(InfAdoptedSessionRecord* record,
+                                      const guint8* data,
+                                      gsize len)
+{
+  InfAdoptedSessionRecordPrivate* priv;
+  priv = INF_ADOPTED_SESSION_RECORD_PRIVATE(record);
+
+  if(len > 0 && fwrite(data, 1, len, priv->file) != len)
+    inf_adopted_session_record_handle_errno_error(record);
+
+  priv->offset += len;
+}
+
+static void
+inf_adopted_session_record_write_record(InfAdoptedSessionRecord* record,
+                                        InfAdoptedSessionRecordBinaryType type,
+                                        GByteArray* payload)
+{
+  GByteArray* header;
+
+  header = g_byte_array_sized_new(
+    INF_ADOPTED_SESSION_RECORD_BINARY_RECORD_HEADER_SIZE
+  );
+
+  inf_adopted_session_record_append_uint(header, type, 4);
+  inf_adopted_session_record_append_uint(header, payload->len, 4);
+
+  inf_adopted_session_record_write_data(record, header->data, header->len);
+  inf_adopted_session_record_write_data(record, payload->data, payload->len);
+
+  g_byte_array_free(header, TRUE);
+}
+
+static void
+inf_adopted_session_record_write_node_record(
+  InfAdoptedSessionRecord* record,
+  InfAdoptedSessionRecordBinaryType type,
+  xmlNodePtr xml)
+{
+  GByteArray* payload;
+
+  payload = g_byte_array_new();
+  inf_adopted_session_record_encode_node(payload, xml);
+  inf_adopted_session_record_write_record(record, type, payload);
+  g_byte_array_free(payload, TRUE);
+}
+
 static void
 inf_adopted_session_record_write_node(InfAdoptedSessionRecord* record,
                                       xmlNodePtr xml)
@@ -154,6 +350,82 @@ inf_adopted_session_record_user_joined(InfAdoptedSessionRecord* record,
   );
 }
 
+static void
+inf_adopted_session_record_start_foreach_user_func(InfUser* user,
+                                                   gpointer user_data);
+
+static xmlNodePtr
+inf_adopted_session_record_make_initial(InfAdoptedSessionRecord* record)
+{
+  InfAdoptedSessionRecordPrivate* priv;
+  InfSessionClass* session_class;
+  xmlNodePtr xml;
+  xmlNodePtr child;
+  xmlNodePtr cur;
+  guint total;
+
+  priv = INF_ADOPTED_SESSION_RECORD_PRIVATE(record);
+  session_class = INF_SESSION_GET_CLASS(priv->session);
+
+  /* TODO: Have someone else inserting sync-begin and sync-end... that's quite
+   * hacky here. */
+  xml = xmlNewNode(NULL, (const xmlChar*)"initial");
+  child = xmlNewChild(xml, NULL, (const xmlChar*)"sync-begin", NULL);
+  session_class->to_xml_sync(INF_SESSION(priv->session), xml);
+  xmlNewChild(xml, NULL, (const xmlChar*)"sync-end", NULL);
+
+  total = 0;
+  for(cur = child; cur != NULL; cur = cur->next)
+    ++ total;
+  inf_xml_util_set_attribute_uint(child, "num-messages", total - 2);
+
+  return xml;
+}
+
+static void
+inf_adopted_session_record_write_checkpoint(InfAdoptedSessionRecord* record)
+{
+  InfAdoptedSessionRecordPrivate* priv;
+  InfAdoptedSessionRecordCheckpoint checkpoint;
+  GByteArray* payload;
+  xmlNodePtr xml;
+
+  priv = INF_ADOPTED_SESSION_RECORD_PRIVATE(record);
+
+  checkpoint.n_requests = priv->n_requests;
+  checkpoint.offset = priv->offset;
+  g_array_append_val(priv->checkpoints, checkpoint);
+
+  payload = g_byte_array_new();
+  inf_adopted_session_record_append_uint(payload, priv->n_requests, 8);
+
+  xml = inf_adopted_session_record_make_initial(record);
+  inf_adopted_session_record_encode_node(payload, xml);
+  xmlFreeNode(xml);
+
+  inf_adopted_session_record_write_record(
+    record,
+    INF_ADOPTED_SESSION_RECORD_BINARY_CHECKPOINT,
+    payload
+  );
+
+  g_byte_array_free(payload, TRUE);
+
+  /* A replay starting at this checkpoint knows the user vectors from the
+   * synchronization only, so subsequent requests must be relative to
+   * those. */
+  inf_user_table_foreach_user(
+    inf_session_get_user_table(INF_SESSION(priv->session)),
+    inf_adopted_session_record_start_foreach_user_func,
+    record
+  );
+
+  priv->last_checkpoint = priv->n_requests;
+
+  if(fflush(priv->file) == EOF)
+    inf_adopted_session_record_handle_errno_error(record);
+}
+
 static void
 inf_adopted_session_record_begin_execute_request_cb(InfAdoptedAlgorithm* algo,
                                                     InfAdoptedUser* user,
@@ -171,6 +443,15 @@ inf_adopted_session_record_begin_execute_request_cb(InfAdoptedAlgorithm* algo,
   priv = INF_ADOPTED_SESSION_RECORD_PRIVATE(record);
   session_class = INF_ADOPTED_SESSION_GET_CLASS(priv->session);
 
+  /* The checkpoint is written before the request is executed. At this
+   * point the vector of the executing user already includes the request,
+   * which is what a replay starting at the checkpoint expects. */
+  if(priv->binary == TRUE && priv->checkpoint_interval > 0 &&
+     priv->n_requests - priv->last_checkpoint >= priv->checkpoint_interval)
+  {
+    inf_adopted_session_record_write_checkpoint(record);
+  }
+
   xml = xmlNewNode(NULL, (const xmlChar*)"request");
   previous = g_hash_table_lookup(priv->last_send_table, user);
   g_assert(previous != NULL);
@@ -189,12 +470,26 @@ inf_adopted_session_record_begin_execute_request_cb(InfAdoptedAlgorithm* algo,
     inf_adopted_request_get_execute_time(req) / 1000000.
   );
 
-  inf_adopted_session_record_write_node(record, xml);
-  xmlFreeNode(xml);
+  if(priv->binary == TRUE)
+  {
+    inf_adopted_session_record_write_node_record(
+      record,
+      INF_ADOPTED_SESSION_RECORD_BINARY_REQUEST,
+      xml
+    );
 
-  result = xmlTextWriterFlush(priv->writer);
-  if(result < 0) inf_adopted_session_record_handle_xml_error(record);
-  fflush(priv->file);
+    xmlFreeNode(xml);
+    ++priv->n_requests;
+  }
+  else
+  {
+    inf_adopted_session_record_write_node(record, xml);
+    xmlFreeNode(xml);
+
+    result = xmlTextWriterFlush(priv->writer);
+    if(result < 0) inf_adopted_session_record_handle_xml_error(record);
+    fflush(priv->file);
+  }
 
   /* Update last send entry */
   previous =
@@ -219,9 +514,6 @@ inf_adopted_session_record_add_user_cb(InfUserTable* user_table,
 
   inf_adopted_session_record_user_joined(record, INF_ADOPTED_USER(user));
 
-  result = xmlTextWriterWriteString(priv->writer, (const xmlChar*)"\n  ");
-  if(result < 0) inf_adopted_session_record_handle_xml_error(record);
-
   xml = xmlNewNode(NULL, (const xmlChar*)"user");
   inf_session_user_to_xml(INF_SESSION(priv->session), user, xml);
 
@@ -231,12 +523,28 @@ inf_adopted_session_record_add_user_cb(InfUserTable* user_table,
     g_get_real_time() / 1000000.
   );
 
-  inf_adopted_session_record_write_node(record, xml);
-  xmlFreeNode(xml);
+  if(priv->binary == TRUE)
+  {
+    inf_adopted_session_record_write_node_record(
+      record,
+      INF_ADOPTED_SESSION_RECORD_BINARY_USER,
+      xml
+    );
 
-  result = xmlTextWriterFlush(priv->writer);
-  if(result < 0) inf_adopted_session_record_handle_xml_error(record);
-  fflush(priv->file);
+    xmlFreeNode(xml);
+  }
+  else
+  {
+    result = xmlTextWriterWriteString(priv->writer, (const xmlChar*)"\n  ");
+    if(result < 0) inf_adopted_session_record_handle_xml_error(record);
+
+    inf_adopted_session_record_write_node(record, xml);
+    xmlFreeNode(xml);
+
+    result = xmlTextWriterFlush(priv->writer);
+    if(result < 0) inf_adopted_session_record_handle_xml_error(record);
+    fflush(priv->file);
+  }
 }
 
 static void
@@ -256,17 +564,11 @@ inf_adopted_session_record_real_start(InfAdoptedSessionRecord* record)
   InfAdoptedAlgorithm* algorithm;
   InfUserTable* user_table;
   xmlNodePtr xml;
-  xmlNodePtr child;
-  xmlNodePtr cur;
   int result;
-  guint total;
-
-  InfSessionClass* session_class;
 
   priv = INF_ADOPTED_SESSION_RECORD_PRIVATE(record);
   algorithm = inf_adopted_session_get_algorithm(priv->session);
   user_table = inf_session_get_user_table(INF_SESSION(priv->session));
-  session_class = INF_SESSION_GET_CLASS(priv->session);
 
   g_signal_connect(
     G_OBJECT(algorithm),
@@ -295,6 +597,23 @@ inf_adopted_session_record_real_start(InfAdoptedSessionRecord* record)
     record
   );
 
+  xml = inf_adopted_session_record_make_initial(record);
+
+  if(priv->binary == TRUE)
+  {
+    inf_adopted_session_record_write_node_record(
+      record,
+      INF_ADOPTED_SESSION_RECORD_BINARY_INITIAL,
+      xml
+    );
+
+    xmlFreeNode(xml);
+
+    if(fflush(priv->file) == EOF)
+      inf_adopted_session_record_handle_errno_error(record);
+    return;
+  }
+
   result = xmlTextWriterStartDocument(priv->writer, NULL, "UTF-8", NULL);
   if(result < 0) inf_adopted_session_record_handle_xml_error(record);
 
@@ -304,18 +623,6 @@ inf_adopted_session_record_real_start(InfAdoptedSessionRecord* record)
   );
   if(result < 0) inf_adopted_session_record_handle_xml_error(record);
 
-  /* TODO: Have someone else inserting sync-begin and sync-end... that's quite
-   * hacky here. */
-  xml = xmlNewNode(NULL, (const xmlChar*)"initial");
-  child = xmlNewChild(xml, NULL, (const xmlChar*)"sync-begin", NULL);
-  session_class->to_xml_sync(INF_SESSION(priv->session), xml);
-  xmlNewChild(xml, NULL, (const xmlChar*)"sync-end", NULL);
-
-  total = 0;
-  for(cur = child; cur != NULL; cur = cur->next)
-    ++ total;
-  inf_xml_util_set_attribute_uint(child, "num-messages", total - 2);
-
   inf_adopted_session_record_write_node(record, xml);
   xmlFreeNode(xml);
 
@@ -341,6 +648,75 @@ inf_adopted_session_record_synchronization_complete_cb(InfSession* session,
   inf_adopted_session_record_real_start(record);
 }
 
+/* Writes the checkpoint index and closes the file of a binary record */
+static gboolean
+inf_adopted_session_record_finish_binary(InfAdoptedSessionRecord* record,
+                                         GError** error)
+{
+  InfAdoptedSessionRecordPrivate* priv;
+  InfAdoptedSessionRecordCheckpoint* checkpoint;
+  GByteArray* payload;
+  guint64 index_offset;
+  guint i;
+  int errcode;
+
+  priv = INF_ADOPTED_SESSION_RECORD_PRIVATE(record);
+
+  payload = g_byte_array_new();
+  inf_adopted_session_record_append_uint(payload, priv->checkpoints->len, 4);
+  for(i = 0; i < priv->checkpoints->len; ++i)
+  {
+    checkpoint = &g_array_index(
+      priv->checkpoints,
+      InfAdoptedSessionRecordCheckpoint,
+      i
+    );
+
+    inf_adopted_session_record_append_uint(payload, checkpoint->n_requests, 8);
+    inf_adopted_session_record_append_uint(payload, checkpoint->offset, 8);
+  }
+
+  index_offset = priv->offset;
+  inf_adopted_session_record_write_record(
+    record,
+    INF_ADOPTED_SESSION_RECORD_BINARY_INDEX,
+    payload
+  );
+
+  g_byte_array_set_size(payload, 0);
+  inf_adopted_session_record_append_uint(payload, index_offset, 8);
+  g_byte_array_append(
+    payload,
+    (const guint8*)INF_ADOPTED_SESSION_RECORD_BINARY_INDEX_MAGIC,
+    INF_ADOPTED_SESSION_RECORD_BINARY_MAGIC_SIZE
+  );
+
+  inf_adopted_session_record_write_data(record, payload->data, payload->len);
+  g_byte_array_free(payload, TRUE);
+
+  g_array_free(priv->checkpoints, TRUE);
+  priv->checkpoints = NULL;
+  priv->binary = FALSE;
+
+  if(ferror(priv->file) != 0 || fclose(priv->file) == EOF)
+  {
+    errcode = errno;
+    priv->file = NULL;
+
+    g_set_error_literal(
+      error,
+      g_quark_from_static_string("ERRNO_ERROR"),
+      errcode,
+      strerror(errcode)
+    );
+
+    return FALSE;
+  }
+
+  priv->file = NULL;
+  return TRUE;
+}
+
 /*
  * GObject overrides.
  */
@@ -352,9 +728,19 @@ inf_adopted_session_record_init(InfAdoptedSessionRecord* record)
   priv = INF_ADOPTED_SESSION_RECORD_PRIVATE(record);
 
   priv->session = NULL;
+  priv->format = INF_ADOPTED_SESSION_RECORD_FORMAT_XML;
+  priv->checkpoint_interval = 1000;
+
   priv->writer = NULL;
   priv->file = NULL;
   priv->filename = NULL;
+
+  priv->binary = FALSE;
+  priv->offset = 0;
+  priv->n_requests = 0;
+  priv->last_checkpoint = 0;
+  priv->checkpoints = NULL;
+
   priv->last_send_table = NULL;
 }
 
@@ -368,7 +754,7 @@ inf_adopted_session_record_dispose(GObject* object)
   record = INF_ADOPTED_SESSION_RECORD(object);
   priv = INF_ADOPTED_SESSION_RECORD_PRIVATE(record);
 
-  if(priv->writer != NULL)
+  if(priv->file != NULL)
   {
     error = NULL;
     inf_adopted_session_record_stop_recording(record, &error);
@@ -428,6 +814,12 @@ inf_adopted_session_record_set_property(GObject* object,
     g_assert(priv->session == NULL); /* construct only */
     priv->session = INF_ADOPTED_SESSION(g_value_dup_object(value));
     break;
+  case PROP_FORMAT:
+    priv->format = g_value_get_enum(value);
+    break;
+  case PROP_CHECKPOINT_INTERVAL:
+    priv->checkpoint_interval = g_value_get_uint(value);
+    break;
   case PROP_FILENAME:
     /* read only */
   default:
@@ -456,6 +848,12 @@ inf_adopted_session_record_get_property(GObject* object,
   case PROP_FILENAME:
     g_value_set_string(value, priv->filename);
     break;
+  case PROP_FORMAT:
+    g_value_set_enum(value, priv->format);
+    break;
+  case PROP_CHECKPOINT_INTERVAL:
+    g_value_set_uint(value, priv->checkpoint_interval);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
@@ -504,6 +902,35 @@ inf_adopted_session_record_class_init(
       G_PARAM_READABLE
     )
   );
+
+  g_object_class_install_property(
+    object_class,
+    PROP_FORMAT,
+    g_param_spec_enum(
+      "format",
+      "Format",
+      "The format in which to write the record. Changes take effect the "
+      "next time recording is started",
+      INF_ADOPTED_TYPE_SESSION_RECORD_FORMAT,
+      INF_ADOPTED_SESSION_RECORD_FORMAT_XML,
+      G_PARAM_READWRITE
+    )
+  );
+
+  g_object_class_install_property(
+    object_class,
+    PROP_CHECKPOINT_INTERVAL,
+    g_param_spec_uint(
+      "checkpoint-interval",
+      "Checkpoint interval",
+      "Number of requests after which a checkpoint of the session state is "
+      "written to a binary record, or 0 to write no checkpoints",
+      0,
+      G_MAXUINT,
+      1000,
+      G_PARAM_READWRITE
+    )
+  );
 }
 
 /*
@@ -557,6 +984,7 @@ inf_adopted_session_record_start_recording(InfAdoptedSessionRecord* record,
   InfSessionStatus status;
   xmlOutputBufferPtr buffer;
   xmlErrorPtr xmlerror;
+  GByteArray* header;
   int errcode;
 
   g_return_val_if_fail(INF_ADOPTED_IS_SESSION_RECORD(record), FALSE);
@@ -566,10 +994,14 @@ inf_adopted_session_record_start_recording(InfAdoptedSessionRecord* record,
   priv = INF_ADOPTED_SESSION_RECORD_PRIVATE(record);
   status = inf_session_get_status(INF_SESSION(priv->session));
 
-  g_return_val_if_fail(priv->writer == NULL, FALSE);
+  g_return_val_if_fail(priv->file == NULL, FALSE);
   g_return_val_if_fail(status != INF_SESSION_CLOSED, FALSE);
 
-  priv->file = fopen(filename, "w");
+  priv->file = fopen(
+    filename,
+    priv->format == INF_ADOPTED_SESSION_RECORD_FORMAT_BINARY ? "wb" : "w"
+  );
+
   if(priv->file == NULL)
   {
     errcode = errno;
@@ -584,44 +1016,103 @@ inf_adopted_session_record_start_recording(InfAdoptedSessionRecord* record,
     return FALSE;
   }
 
-  buffer = xmlOutputBufferCreateFile(priv->file, NULL);
-  if(buffer == NULL)
+  if(priv->format == INF_ADOPTED_SESSION_RECORD_FORMAT_BINARY)
   {
-    fclose(priv->file);
-    priv->file = NULL;
+    priv->binary = TRUE;
+    priv->offset = 0;
+    priv->n_requests = 0;
+    priv->last_checkpoint = 0;
+    priv->checkpoints = g_array_new(
+      FALSE,
+      FALSE,
+      sizeof(InfAdoptedSessionRecordCheckpoint)
+    );
 
-    xmlerror = xmlGetLastError();
+    header = g_byte_array_sized_new(
+      INF_ADOPTED_SESSION_RECORD_BINARY_HEADER_SIZE
+    );
 
-    g_set_error_literal(
-      error,
-      libxml2_writer_error_quark,
-      xmlerror->code,
-      xmlerror->message
+    g_byte_array_append(
+      header,
+      (const guint8*)INF_ADOPTED_SESSION_RECORD_BINARY_MAGIC,
+      INF_ADOPTED_SESSION_RECORD_BINARY_MAGIC_SIZE
     );
 
-    return FALSE;
-  }
+    inf_adopted_session_record_append_uint(
+      header,
+      INF_ADOPTED_SESSION_RECORD_BINARY_VERSION,
+      4
+    );
+
+    inf_adopted_session_record_append_uint(header, 0, 4);
 
-  priv->writer = xmlNewTextWriter(buffer);
-  if(priv->writer == NULL)
+    if(fwrite(header->data, 1, header->len, priv->file) != header->len)
+    {
+      errcode = errno;
+      g_byte_array_free(header, TRUE);
+      g_array_free(priv->checkpoints, TRUE);
+      priv->checkpoints = NULL;
+      priv->binary = FALSE;
+      fclose(priv->file);
+      priv->file = NULL;
+
+      g_set_error_literal(
+        error,
+        g_quark_from_static_string("ERRNO_ERROR"),
+        errcode,
+        strerror(errcode)
+      );
+
+      return FALSE;
+    }
+
+    priv->offset = header->len;
+    g_byte_array_free(header, TRUE);
+  }
+  else
   {
-    /* TODO: Does this also fclose our file? */
-    xmlOutputBufferClose(buffer);
-    priv->file = NULL;
+    buffer = xmlOutputBufferCreateFile(priv->file, NULL);
+    if(buffer == NULL)
+    {
+      fclose(priv->file);
+      priv->file = NULL;
 
-    xmlerror = xmlGetLastError();
+      xmlerror = xmlGetLastError();
 
-    g_set_error_literal(
-      error,
-      libxml2_writer_error_quark,
-      xmlerror->code,
-      xmlerror->message
-    );
+      g_set_error_literal(
+        error,
+        libxml2_writer_error_quark,
+        xmlerror->code,
+        xmlerror->message
+      );
 
-    return FALSE;
+      return FALSE;
+    }
+
+    priv->writer = xmlNewTextWriter(buffer);
+    if(priv->writer == NULL)
+    {
+      /* TODO: Does this also fclose our file? */
+      xmlOutputBufferClose(buffer);
+      priv->file = NULL;
+
+      xmlerror = xmlGetLastError();
+
+      g_set_error_literal(
+        error,
+        libxml2_writer_error_quark,
+        xmlerror->code,
+        xmlerror->message
+      );
+
+      return FALSE;
+    }
+
+    xmlTextWriterSetIndent(priv->writer, 1);
   }
 
-  xmlTextWriterSetIndent(priv->writer, 1);
+  g_assert(priv->filename == NULL);
+  priv->filename = g_strdup(filename);
 
   switch(status)
   {
@@ -642,8 +1133,6 @@ inf_adopted_session_record_start_recording(InfAdoptedSessionRecord* record,
     break;
   }
 
-  g_assert(priv->filename == NULL);
-  priv->filename = g_strdup(filename);
   g_object_notify(G_OBJECT(record), "filename");
   return TRUE;
 }
@@ -679,7 +1168,7 @@ inf_adopted_session_record_stop_recording(InfAdoptedSessionRecord* record,
 
   priv = INF_ADOPTED_SESSION_RECORD_PRIVATE(record);
 
-  g_return_val_if_fail(priv->writer != NULL, FALSE);
+  g_return_val_if_fail(priv->file != NULL, FALSE);
 
   inf_signal_handlers_disconnect_by_func(
     G_OBJECT(priv->session),
@@ -714,28 +1203,37 @@ inf_adopted_session_record_stop_recording(InfAdoptedSessionRecord* record,
     );
   }
 
-  result = xmlTextWriterWriteString(priv->writer, (const xmlChar*)"\n");
-  if(result < 0) inf_adopted_session_record_handle_xml_error(record);
-
-  result = xmlTextWriterEndDocument(priv->writer);
-  if(result < 0)
+  if(priv->binary == TRUE)
+  {
+    result = 0;
+    if(!inf_adopted_session_record_finish_binary(record, error))
+      result = -1;
+  }
+  else
   {
-    xmlerror = xmlGetLastError();
+    result = xmlTextWriterWriteString(priv->writer, (const xmlChar*)"\n");
+    if(result < 0) inf_adopted_session_record_handle_xml_error(record);
 
-    g_set_error_literal(
-      error,
-      libxml2_writer_error_quark,
-      xmlerror->code,
-      xmlerror->message
-    );
+    result = xmlTextWriterEndDocument(priv->writer);
+    if(result < 0)
+    {
+      xmlerror = xmlGetLastError();
 
-    return FALSE;
-  }
+      g_set_error_literal(
+        error,
+        libxml2_writer_error_quark,
+        xmlerror->code,
+        xmlerror->message
+      );
 
-  /* TODO: Does this fclose our file? */
-  xmlFreeTextWriter(priv->writer);
-  priv->writer = NULL;
-  priv->file = NULL;
+      return FALSE;
+    }
+
+    /* TODO: Does this fclose our file? */
+    xmlFreeTextWriter(priv->writer);
+    priv->writer = NULL;
+    priv->file = NULL;
+  }
 
   g_free(priv->filename);
   priv->filename = NULL;
@@ -765,7 +1263,7 @@ gboolean
 inf_adopted_session_record_is_recording(InfAdoptedSessionRecord* record)
 {
   g_return_val_if_fail(INF_ADOPTED_IS_SESSION_RECORD(record), FALSE);
-  return INF_ADOPTED_SESSION_RECORD_PRIVATE(record)->writer != NULL;
+  return INF_ADOPTED_SESSION_RECORD_PRIVATE(record)->file != NULL;
 }
 
 /* vim:set et sw=2 ts=2: */
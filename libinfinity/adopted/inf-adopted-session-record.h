@@ -33,9 +33,28 @@ G_BEGIN_DECLS
 #define INF_ADOPTED_IS_SESSION_RECORD_CLASS(klass)      (G_TYPE_CHECK_CLASS_TYPE((klass), INF_ADOPTED_TYPE_SESSION_RECORD))
 #define INF_ADOPTED_SESSION_RECORD_GET_CLASS(obj)       (G_TYPE_INSTANCE_GET_CLASS((obj), INF_ADOPTED_TYPE_SESSION_RECORD, InfAdoptedSessionRecordClass))
 
+#define INF_ADOPTED_TYPE_SESSION_RECORD_FORMAT          (inf_adopted_session_record_format_get_type())
+
 typedef struct _InfAdoptedSessionRecord InfAdoptedSessionRecord;
 typedef struct _InfAdoptedSessionRecordClass InfAdoptedSessionRecordClass;
 
+/**
+ * InfAdoptedSessionRecordFormat:
+ * @INF_ADOPTED_SESSION_RECORD_FORMAT_XML: The record is written as an XML
+ * document. This format can be inspected and edited easily.
+ * @INF_ADOPTED_SESSION_RECORD_FORMAT_BINARY: The record is written in a
+ * compact binary format which contains periodic checkpoints of the session
+ * state. Such records are faster to replay, and
+ * inf_adopted_session_replay_seek() can start replaying them from the
+ * nearest checkpoint.
+ *
+ * The file format in which #InfAdoptedSessionRecord writes a record.
+ */
+typedef enum _InfAdoptedSessionRecordFormat {
+  INF_ADOPTED_SESSION_RECORD_FORMAT_XML,
+  INF_ADOPTED_SESSION_RECORD_FORMAT_BINARY
+} InfAdoptedSessionRecordFormat;
+
 /**
  * InfAdoptedSessionRecordClass:
  *
@@ -57,6 +76,9 @@ struct _InfAdoptedSessionRecord {
   GObject parent;
 };
 
+GType
+inf_adopted_session_record_format_get_type(void) G_GNUC_CONST;
+
 GType
 inf_adopted_session_record_get_type(void);
 
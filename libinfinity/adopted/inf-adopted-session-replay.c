@@ -33,9 +33,15 @@
  * Use inf_adopted_session_replay_set_record() to specify the recording to
  * replay, and then use inf_adopted_session_replay_get_session() to obtain
  * the replayed session.
+ *
+ * Both the XML and the binary record formats are supported. Binary records
+ * contain checkpoints of the session state, which allow
+ * inf_adopted_session_replay_seek() to start replaying from the checkpoint
+ * closest to the requested position instead of from the beginning.
  */
 
 #include <libinfinity/adopted/inf-adopted-session-replay.h>
+#include <libinfinity/adopted/inf-adopted-session-record-private.h>
 #include <libinfinity/common/inf-simulated-connection.h>
 #include <libinfinity/common/inf-standalone-io.h>
 #include <libinfinity/common/inf-xml-util.h>
@@ -53,12 +59,41 @@
 #define XML_READER_TYPE_SIGNIFICANT_WHITESPACE 14
 #define XML_READER_TYPE_END_ELEMENT 15
 
+/* Maximum nesting depth of XML nodes in binary records */
+static const guint INF_ADOPTED_SESSION_REPLAY_MAX_DEPTH = 256;
+
+typedef struct _InfAdoptedSessionReplayCheckpoint
+  InfAdoptedSessionReplayCheckpoint;
+struct _InfAdoptedSessionReplayCheckpoint {
+  guint64 n_requests;
+  gsize offset;
+};
+
+typedef struct _InfAdoptedSessionReplayReader InfAdoptedSessionReplayReader;
+struct _InfAdoptedSessionReplayReader {
+  const guint8* data;
+  gsize size;
+  gsize pos;
+};
+
 typedef struct _InfAdoptedSessionReplayPrivate InfAdoptedSessionReplayPrivate;
 struct _InfAdoptedSessionReplayPrivate {
   gchar* filename;
+  const InfcNotePlugin* plugin;
   xmlTextReaderPtr reader;
   GError* error;
 
+  /* Binary format only. size is the end of the record data, excluding
+   * the index. */
+  GMappedFile* mapped;
+  const guint8* data;
+  gsize size;
+  gsize offset;
+  GArray* checkpoints;
+
+  /* Number of requests played so far */
+  guint n_requests;
+
   InfCommunicationManager* publisher_manager;
   InfCommunicationHostedGroup* publisher_group;
   InfSimulatedConnection* publisher_conn;
@@ -237,30 +272,320 @@ inf_adopted_session_replay_skip_whitespace_required(xmlTextReaderPtr reader,
   return TRUE;
 }
 
+static gboolean
+inf_adopted_session_replay_read_uint(InfAdoptedSessionReplayReader* reader,
+                                     guint n_bytes,
+                                     guint64* value)
+{
+  guint i;
+
+  if(reader->size - reader->pos < n_bytes)
+    return FALSE;
+
+  *value = 0;
+  for(i = 0; i < n_bytes; ++i)
+    *value |= (guint64)reader->data[reader->pos + i] << (8 * i);
+
+  reader->pos += n_bytes;
+  return TRUE;
+}
+
+static xmlChar*
+inf_adopted_session_replay_read_string(InfAdoptedSessionReplayReader* reader,
+                                       guint n_length_bytes)
+{
+  guint64 len;
+  xmlChar* str;
+
+  if(!inf_adopted_session_replay_read_uint(reader, n_length_bytes, &len))
+    return NULL;
+  if(len > G_MAXINT || reader->size - reader->pos < len)
+    return NULL;
+
+  str = xmlStrndup(reader->data + reader->pos, (int)len);
+  reader->pos += len;
+  return str;
+}
+
+static xmlNodePtr
+inf_adopted_session_replay_decode_node(InfAdoptedSessionReplayReader* reader,
+                                       guint depth)
+{
+  guint64 kind;
+  guint64 n;
+  guint64 i;
+  xmlChar* name;
+  xmlChar* value;
+  xmlNodePtr xml;
+  xmlNodePtr child;
+  gboolean result;
+
+  if(depth > INF_ADOPTED_SESSION_REPLAY_MAX_DEPTH)
+    return NULL;
+
+  if(!inf_adopted_session_replay_read_uint(reader, 1, &kind))
+    return NULL;
+  if(kind != INF_ADOPTED_SESSION_RECORD_BINARY_NODE_ELEMENT)
+    return NULL;
+
+  name = inf_adopted_session_replay_read_string(reader, 2);
+  if(name == NULL)
+    return NULL;
+
+  xml = xmlNewNode(NULL, name);
+  xmlFree(name);
+
+  result = inf_adopted_session_replay_read_uint(reader, 2, &n);
+  for(i = 0; result == TRUE && i < n; ++i)
+  {
+    name = inf_adopted_session_replay_read_string(reader, 2);
+    value = NULL;
+    if(name != NULL)
+      value = inf_adopted_session_replay_read_string(reader, 4);
+
+    if(value != NULL)
+      xmlNewProp(xml, name, value);
+    else
+      result = FALSE;
+
+    if(name != NULL) xmlFree(name);
+    if(value != NULL) xmlFree(value);
+  }
+
+  if(result == TRUE)
+    result = inf_adopted_session_replay_read_uint(reader, 4, &n);
+
+  for(i = 0; result == TRUE && i < n; ++i)
+  {
+    if(reader->pos < reader->size &&
+       reader->data[reader->pos] ==
+       INF_ADOPTED_SESSION_RECORD_BINARY_NODE_TEXT)
+    {
+      ++reader->pos;
+      value = inf_adopted_session_replay_read_string(reader, 4);
+      if(value != NULL)
+      {
+        xmlAddChild(xml, xmlNewText(value));
+        xmlFree(value);
+      }
+      else
+      {
+        result = FALSE;
+      }
+    }
+    else
+    {
+      child = inf_adopted_session_replay_decode_node(reader, depth + 1);
+      if(child != NULL)
+        xmlAddChild(xml, child);
+      else
+        result = FALSE;
+    }
+  }
+
+  if(result == FALSE)
+  {
+    xmlFreeNode(xml);
+    return NULL;
+  }
+
+  return xml;
+}
+
+/* Reads the record at *offset and advances offset behind it. Returns FALSE
+ * if there is no complete record at offset. */
+static gboolean
+inf_adopted_session_replay_next_record(const guint8* data,
+                                       gsize size,
+                                       gsize* offset,
+                                       guint* type,
+                                       InfAdoptedSessionReplayReader* payload)
+{
+  InfAdoptedSessionReplayReader header;
+  guint64 value;
+  guint64 len;
+
+  header.data = data;
+  header.size = size;
+  header.pos = *offset;
+
+  if(!inf_adopted_session_replay_read_uint(&header, 4, &value))
+    return FALSE;
+  if(!inf_adopted_session_replay_read_uint(&header, 4, &len))
+    return FALSE;
+  if(size - header.pos < len)
+    return FALSE;
+
+  *type = (guint)value;
+  payload->data = data + header.pos;
+  payload->size = len;
+  payload->pos = 0;
+
+  *offset = header.pos + len;
+  return TRUE;
+}
+
 static void
-inf_adopted_session_replay_clear(InfAdoptedSessionReplay* replay)
+inf_adopted_session_replay_set_bad_format(GError** error)
 {
-  InfAdoptedSessionReplayPrivate* priv;
-  priv = INF_ADOPTED_SESSION_REPLAY_PRIVATE(replay);
+  g_set_error_literal(
+    error,
+    session_replay_error_quark,
+    INF_ADOPTED_SESSION_REPLAY_ERROR_BAD_FORMAT,
+    _("Invalid record in binary recording")
+  );
+}
 
-  g_object_freeze_notify(G_OBJECT(replay));
+/* Checks the header of a binary record and finds the checkpoints in it */
+static gboolean
+inf_adopted_session_replay_load_binary(GMappedFile* mapped,
+                                       gsize* end,
+                                       GArray** checkpoints,
+                                       GError** error)
+{
+  InfAdoptedSessionReplayReader reader;
+  InfAdoptedSessionReplayReader payload;
+  InfAdoptedSessionReplayCheckpoint checkpoint;
+  const guint8* data;
+  gsize size;
+  gsize offset;
+  gsize record_offset;
+  guint64 value;
+  guint64 n;
+  guint64 i;
+  guint type;
+  gboolean has_index;
+
+  data = (const guint8*)g_mapped_file_get_contents(mapped);
+  size = g_mapped_file_get_length(mapped);
+
+  reader.data = data;
+  reader.size = size;
+  reader.pos = INF_ADOPTED_SESSION_RECORD_BINARY_MAGIC_SIZE;
+
+  if(!inf_adopted_session_replay_read_uint(&reader, 4, &value) ||
+     value != INF_ADOPTED_SESSION_RECORD_BINARY_VERSION)
+  {
+    g_set_error_literal(
+      error,
+      session_replay_error_quark,
+      INF_ADOPTED_SESSION_REPLAY_ERROR_BAD_FORMAT,
+      _("Unsupported version of the binary recording")
+    );
 
-  if(priv->filename != NULL)
+    return FALSE;
+  }
+
+  *checkpoints = g_array_new(
+    FALSE,
+    FALSE,
+    sizeof(InfAdoptedSessionReplayCheckpoint)
+  );
+
+  /* Use the index at the end of the file if there is one */
+  has_index = FALSE;
+  if(size >= INF_ADOPTED_SESSION_RECORD_BINARY_HEADER_SIZE +
+             INF_ADOPTED_SESSION_RECORD_BINARY_FOOTER_SIZE &&
+     memcmp(
+       data + size - INF_ADOPTED_SESSION_RECORD_BINARY_MAGIC_SIZE,
+       INF_ADOPTED_SESSION_RECORD_BINARY_INDEX_MAGIC,
+       INF_ADOPTED_SESSION_RECORD_BINARY_MAGIC_SIZE) == 0)
   {
-    g_free(priv->filename);
-    priv->filename = NULL;
+    reader.pos = size - INF_ADOPTED_SESSION_RECORD_BINARY_FOOTER_SIZE;
+    inf_adopted_session_replay_read_uint(&reader, 8, &value);
+
+    offset = value;
+    if(value >= INF_ADOPTED_SESSION_RECORD_BINARY_HEADER_SIZE &&
+       value < size - INF_ADOPTED_SESSION_RECORD_BINARY_FOOTER_SIZE &&
+       inf_adopted_session_replay_next_record(
+         data,
+         size - INF_ADOPTED_SESSION_RECORD_BINARY_FOOTER_SIZE,
+         &offset,
+         &type,
+         &payload) &&
+       type == INF_ADOPTED_SESSION_RECORD_BINARY_INDEX &&
+       inf_adopted_session_replay_read_uint(&payload, 4, &n))
+    {
+      has_index = TRUE;
+      for(i = 0; has_index == TRUE && i < n; ++i)
+      {
+        if(inf_adopted_session_replay_read_uint(&payload, 8, &value))
+        {
+          checkpoint.n_requests = value;
+          if(inf_adopted_session_replay_read_uint(&payload, 8, &value) &&
+             value < offset)
+          {
+            checkpoint.offset = value;
+            g_array_append_val(*checkpoints, checkpoint);
+          }
+          else
+          {
+            has_index = FALSE;
+          }
+        }
+        else
+        {
+          has_index = FALSE;
+        }
+      }
 
-    g_object_notify(G_OBJECT(replay), "filename");
+      if(has_index == TRUE)
+      {
+        reader.pos = size - INF_ADOPTED_SESSION_RECORD_BINARY_FOOTER_SIZE;
+        inf_adopted_session_replay_read_uint(&reader, 8, &value);
+        *end = value;
+        return TRUE;
+      }
+
+      g_array_set_size(*checkpoints, 0);
+    }
   }
 
-  if(priv->reader != NULL)
+  /* No valid index, for example because the recording was not stopped
+   * properly. Scan the file for checkpoints, up to the last complete
+   * record. */
+  offset = INF_ADOPTED_SESSION_RECORD_BINARY_HEADER_SIZE;
+  *end = offset;
+
+  for(;;)
   {
-    if(xmlTextReaderClose(priv->reader) == -1)
-      g_warning("Failed to close XML reader: %s", xmlGetLastError()->message);
-    xmlFreeTextReader(priv->reader);
-    priv->reader = NULL;
+    record_offset = offset;
+    if(!inf_adopted_session_replay_next_record(data, size, &offset, &type,
+                                               &payload))
+    {
+      break;
+    }
+
+    if(type == INF_ADOPTED_SESSION_RECORD_BINARY_INDEX)
+      break;
+
+    if(type == INF_ADOPTED_SESSION_RECORD_BINARY_CHECKPOINT)
+    {
+      if(!inf_adopted_session_replay_read_uint(&payload, 8, &value))
+      {
+        g_array_free(*checkpoints, TRUE);
+        *checkpoints = NULL;
+        inf_adopted_session_replay_set_bad_format(error);
+        return FALSE;
+      }
+
+      checkpoint.n_requests = value;
+      checkpoint.offset = record_offset;
+      g_array_append_val(*checkpoints, checkpoint);
+    }
+
+    *end = offset;
   }
 
+  return TRUE;
+}
+
+static void
+inf_adopted_session_replay_clear_session(InfAdoptedSessionReplay* replay)
+{
+  InfAdoptedSessionReplayPrivate* priv;
+  priv = INF_ADOPTED_SESSION_REPLAY_PRIVATE(replay);
+
   g_assert(priv->error == NULL);
 
   if(priv->publisher_group != NULL)
@@ -307,6 +632,52 @@ inf_adopted_session_replay_clear(InfAdoptedSessionReplay* replay)
     g_object_notify(G_OBJECT(replay), "session");
   }
 
+  priv->n_requests = 0;
+}
+
+static void
+inf_adopted_session_replay_clear(InfAdoptedSessionReplay* replay)
+{
+  InfAdoptedSessionReplayPrivate* priv;
+  priv = INF_ADOPTED_SESSION_REPLAY_PRIVATE(replay);
+
+  g_object_freeze_notify(G_OBJECT(replay));
+
+  if(priv->filename != NULL)
+  {
+    g_free(priv->filename);
+    priv->filename = NULL;
+
+    g_object_notify(G_OBJECT(replay), "filename");
+  }
+
+  if(priv->reader != NULL)
+  {
+    if(xmlTextReaderClose(priv->reader) == -1)
+      g_warning("Failed to close XML reader: %s", xmlGetLastError()->message);
+    xmlFreeTextReader(priv->reader);
+    priv->reader = NULL;
+  }
+
+  if(priv->mapped != NULL)
+  {
+    g_mapped_file_unref(priv->mapped);
+    priv->mapped = NULL;
+    priv->data = NULL;
+    priv->size = 0;
+    priv->offset = 0;
+  }
+
+  if(priv->checkpoints != NULL)
+  {
+    g_array_free(priv->checkpoints, TRUE);
+    priv->checkpoints = NULL;
+  }
+
+  priv->plugin = NULL;
+
+  inf_adopted_session_replay_clear_session(replay);
+
   g_object_thaw_notify(G_OBJECT(replay));
 }
 
@@ -327,62 +698,121 @@ inf_adopted_session_replay_synchronization_failed_cb(InfSession* session,
 }
 
 static gboolean
-inf_adopted_session_replay_play_initial(InfAdoptedSessionReplay* replay,
-                                        const InfcNotePlugin* plugin,
-                                        GError** error)
+inf_adopted_session_replay_play_sync_message(InfAdoptedSessionReplay* replay,
+                                             xmlNodePtr cur,
+                                             GError** error)
 {
   InfAdoptedSessionReplayPrivate* priv;
-  xmlTextReaderPtr reader;
-  xmlNodePtr cur;
-  const xmlChar* name;
-  xmlChar* value;
-  gulong handler;
-
   priv = INF_ADOPTED_SESSION_REPLAY_PRIVATE(replay);
-  reader = priv->reader;
 
-  /* Advance to root node */
-  if(xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT)
-    if(!inf_adopted_session_replay_advance_required(reader, error))
+  switch(inf_session_get_status(INF_SESSION(priv->session)))
+  {
+  case INF_SESSION_SYNCHRONIZING:
+    inf_communication_group_send_message(
+      INF_COMMUNICATION_GROUP(priv->publisher_group),
+      INF_XML_CONNECTION(priv->publisher_conn),
+      xmlCopyNode(cur, 1)
+    );
+
+    /* TODO: Check whether this caused an error. Maybe there should be an
+     * error signal for InfCommunicationGroup, delegating
+     * inf_net_object_received's error. */
+    inf_simulated_connection_flush(priv->publisher_conn);
+
+    /* error can be set if the synchronization failed */
+    if(priv->error != NULL)
+    {
+      g_propagate_error(error, priv->error);
+      priv->error = NULL;
       return FALSE;
+    }
 
-  name = xmlTextReaderConstName(reader);
-  if(strcmp((const char*)name, "infinote-adopted-session-record") != 0)
-  {
+    return TRUE;
+  case INF_SESSION_RUNNING:
     g_set_error_literal(
       error,
       session_replay_error_quark,
-      INF_ADOPTED_SESSION_REPLAY_ERROR_BAD_DOCUMENT,
-      _("Document is not a session recording")
+      INF_ADOPTED_SESSION_REPLAY_ERROR_BAD_FORMAT,
+      _("Session switched to running without having finished playing "
+        "the initial")
     );
 
+    return FALSE;
+  case INF_SESSION_CLOSED:
+  case INF_SESSION_PRESYNC:
+  default:
+    g_assert_not_reached();
     return FALSE;
   }
+}
 
-  value = xmlTextReaderGetAttribute(reader, (const xmlChar*)"session-type");
-  if(value && strcmp((const char*)name, plugin->note_type) != 0)
-  {
-    xmlFree(value);
+static gboolean
+inf_adopted_session_replay_check_synchronized(InfAdoptedSessionReplay* replay,
+                                              GError** error)
+{
+  InfAdoptedSessionReplayPrivate* priv;
+  priv = INF_ADOPTED_SESSION_REPLAY_PRIVATE(replay);
 
+  if(inf_session_get_status(INF_SESSION(priv->session)) ==
+     INF_SESSION_SYNCHRONIZING)
+  {
     g_set_error_literal(
       error,
       session_replay_error_quark,
-      INF_ADOPTED_SESSION_REPLAY_ERROR_BAD_SESSION_TYPE,
-      _("Session type of the recording does not match")
+      INF_ADOPTED_SESSION_REPLAY_ERROR_BAD_FORMAT,
+      _("Session is still in synchronizing state after having "
+        "played the initial")
     );
 
     return FALSE;
   }
 
-  if(value) xmlFree(value);
+  return TRUE;
+}
+
+/* Plays the INITIAL or CHECKPOINT record at offset of a binary recording.
+ * n_requests is the number of requests preceding that record. */
+static gboolean
+inf_adopted_session_replay_play_binary_initial(
+  InfAdoptedSessionReplay* replay,
+  gsize offset,
+  guint n_requests,
+  GError** error)
+{
+  InfAdoptedSessionReplayPrivate* priv;
+  InfAdoptedSessionReplayReader payload;
+  xmlNodePtr xml;
+  xmlNodePtr cur;
+  guint64 value;
+  guint type;
+  gulong handler;
+  gboolean result;
+
+  priv = INF_ADOPTED_SESSION_REPLAY_PRIVATE(replay);
+  priv->offset = offset;
+
+  if(!inf_adopted_session_replay_next_record(priv->data, priv->size,
+                                             &priv->offset, &type, &payload))
+  {
+    g_set_error_literal(
+      error,
+      session_replay_error_quark,
+      INF_ADOPTED_SESSION_REPLAY_ERROR_UNEXPECTED_EOF,
+      _("Unexpected end of recording")
+    );
 
-  if(!inf_adopted_session_replay_advance_required(reader, error))
-    return FALSE;
-  if(!inf_adopted_session_replay_skip_whitespace_required(reader, error))
     return FALSE;
+  }
 
-  name = xmlTextReaderConstName(reader);
-  if(strcmp((const char*)name, "initial") != 0)
+  if(type == INF_ADOPTED_SESSION_RECORD_BINARY_CHECKPOINT)
+  {
+    if(!inf_adopted_session_replay_read_uint(&payload, 8, &value))
+    {
+      inf_adopted_session_replay_set_bad_format(error);
+      return FALSE;
+    }
+  }
+  else if(type != INF_ADOPTED_SESSION_RECORD_BINARY_INITIAL)
   {
     g_set_error_literal(
       error,
@@ -394,10 +824,13 @@ inf_adopted_session_replay_play_initial(InfAdoptedSessionReplay* replay,
     return FALSE;
   }
 
-  if(!inf_adopted_session_replay_advance_required(reader, error))
-    return FALSE;
-  if(!inf_adopted_session_replay_skip_whitespace_required(reader, error))
+  xml = inf_adopted_session_replay_decode_node(&payload, 0);
+  if(xml == NULL || strcmp((const char*)xml->name, "initial") != 0)
+  {
+    if(xml != NULL) xmlFreeNode(xml);
+    inf_adopted_session_replay_set_bad_format(error);
     return FALSE;
+  }
 
   handler = g_signal_connect(
     priv->session,
@@ -406,102 +839,148 @@ inf_adopted_session_replay_play_initial(InfAdoptedSessionReplay* replay,
     replay
   );
 
-  while(xmlTextReaderNodeType(reader) == XML_READER_TYPE_ELEMENT)
-  {
-    switch(inf_session_get_status(INF_SESSION(priv->session)))
-    {
-    case INF_SESSION_CLOSED:
-      g_assert_not_reached();
-      g_signal_handler_disconnect(priv->session, handler);
-      return FALSE;
-    case INF_SESSION_SYNCHRONIZING:
-      cur = inf_adopted_session_replay_read_current(reader, error);
-      if(!cur)
-      {
-        g_signal_handler_disconnect(priv->session, handler);
-        return FALSE;
-      }
+  result = TRUE;
+  for(cur = xml->children; result == TRUE && cur != NULL; cur = cur->next)
+    if(cur->type == XML_ELEMENT_NODE)
+      result = inf_adopted_session_replay_play_sync_message(replay, cur, error);
 
-      inf_communication_group_send_message(
-        INF_COMMUNICATION_GROUP(priv->publisher_group),
-        INF_XML_CONNECTION(priv->publisher_conn),
-        xmlCopyNode(cur, 1)
-      );
+  g_signal_handler_disconnect(priv->session, handler);
+  xmlFreeNode(xml);
 
-      /* TODO: Check whether this caused an error. Maybe there should be an
-       * error signal for InfCommunicationGroup, delegating
-       * inf_net_object_received's error. */
-      inf_simulated_connection_flush(priv->publisher_conn);
+  if(result == FALSE)
+    return FALSE;
+  if(!inf_adopted_session_replay_check_synchronized(replay, error))
+    return FALSE;
 
-      /* error can be set if the synchronization failed */
-      if(priv->error != NULL)
-      {
-        g_signal_handler_disconnect(priv->session, handler);
-        g_propagate_error(error, priv->error);
-        priv->error = NULL;
-        return FALSE;
-      }
+  priv->n_requests = n_requests;
+  return TRUE;
+}
 
-      if(!inf_adopted_session_replay_advance_subtree_required(reader, error))
-      {
-        g_signal_handler_disconnect(priv->session, handler);
-        return FALSE;
-      }
+static gboolean
+inf_adopted_session_replay_play_initial(InfAdoptedSessionReplay* replay,
+                                        const InfcNotePlugin* plugin,
+                                        GError** error)
+{
+  InfAdoptedSessionReplayPrivate* priv;
+  xmlTextReaderPtr reader;
+  xmlNodePtr cur;
+  const xmlChar* name;
+  xmlChar* value;
+  gulong handler;
 
-      if(!inf_adopted_session_replay_skip_whitespace_required(reader, error))
-      {
-        g_signal_handler_disconnect(priv->session, handler);
-        return FALSE;
-      }
+  priv = INF_ADOPTED_SESSION_REPLAY_PRIVATE(replay);
+  reader = priv->reader;
 
-      break;
-    case INF_SESSION_RUNNING:
-      g_signal_handler_disconnect(priv->session, handler);
+  /* Advance to root node */
+  if(xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT)
+    if(!inf_adopted_session_replay_advance_required(reader, error))
+      return FALSE;
 
-      g_set_error_literal(
-        error,
-        session_replay_error_quark,
-        INF_ADOPTED_SESSION_REPLAY_ERROR_BAD_FORMAT,
-        _("Session switched to running without having finished playing "
-          "the initial")
-      );
+  name = xmlTextReaderConstName(reader);
+  if(strcmp((const char*)name, "infinote-adopted-session-record") != 0)
+  {
+    g_set_error_literal(
+      error,
+      session_replay_error_quark,
+      INF_ADOPTED_SESSION_REPLAY_ERROR_BAD_DOCUMENT,
+      _("Document is not a session recording")
+    );
 
-      return FALSE;
-    case INF_SESSION_PRESYNC:
-    default:
-      g_assert_not_reached();
-      break;
-    }
+    return FALSE;
   }
 
-  g_signal_handler_disconnect(priv->session, handler);
+  value = xmlTextReaderGetAttribute(reader, (const xmlChar*)"session-type");
+  if(value && strcmp((const char*)name, plugin->note_type) != 0)
+  {
+    xmlFree(value);
 
-  if(xmlTextReaderNodeType(reader) != XML_READER_TYPE_END_ELEMENT)
+    g_set_error_literal(
+      error,
+      session_replay_error_quark,
+      INF_ADOPTED_SESSION_REPLAY_ERROR_BAD_SESSION_TYPE,
+      _("Session type of the recording does not match")
+    );
+
+    return FALSE;
+  }
+
+  if(value) xmlFree(value);
+
+  if(!inf_adopted_session_replay_advance_required(reader, error))
+    return FALSE;
+  if(!inf_adopted_session_replay_skip_whitespace_required(reader, error))
+    return FALSE;
+
+  name = xmlTextReaderConstName(reader);
+  if(strcmp((const char*)name, "initial") != 0)
   {
     g_set_error_literal(
       error,
       session_replay_error_quark,
       INF_ADOPTED_SESSION_REPLAY_ERROR_BAD_FORMAT,
-      _("Superfluous XML in initial session section")
+      _("Initial session state missing in recording")
     );
 
     return FALSE;
   }
 
-  if(inf_session_get_status(INF_SESSION(priv->session)) ==
-     INF_SESSION_SYNCHRONIZING)
+  if(!inf_adopted_session_replay_advance_required(reader, error))
+    return FALSE;
+  if(!inf_adopted_session_replay_skip_whitespace_required(reader, error))
+    return FALSE;
+
+  handler = g_signal_connect(
+    priv->session,
+    "synchronization-failed",
+    G_CALLBACK(inf_adopted_session_replay_synchronization_failed_cb),
+    replay
+  );
+
+  while(xmlTextReaderNodeType(reader) == XML_READER_TYPE_ELEMENT)
+  {
+    cur = inf_adopted_session_replay_read_current(reader, error);
+    if(!cur)
+    {
+      g_signal_handler_disconnect(priv->session, handler);
+      return FALSE;
+    }
+
+    if(!inf_adopted_session_replay_play_sync_message(replay, cur, error))
+    {
+      g_signal_handler_disconnect(priv->session, handler);
+      return FALSE;
+    }
+
+    if(!inf_adopted_session_replay_advance_subtree_required(reader, error))
+    {
+      g_signal_handler_disconnect(priv->session, handler);
+      return FALSE;
+    }
+
+    if(!inf_adopted_session_replay_skip_whitespace_required(reader, error))
+    {
+      g_signal_handler_disconnect(priv->session, handler);
+      return FALSE;
+    }
+  }
+
+  g_signal_handler_disconnect(priv->session, handler);
+
+  if(xmlTextReaderNodeType(reader) != XML_READER_TYPE_END_ELEMENT)
   {
     g_set_error_literal(
       error,
       session_replay_error_quark,
       INF_ADOPTED_SESSION_REPLAY_ERROR_BAD_FORMAT,
-      _("Session is still in synchronizing state after having "
-        "played the initial")
+      _("Superfluous XML in initial session section")
     );
 
     return FALSE;
   }
 
+  if(!inf_adopted_session_replay_check_synchronized(replay, error))
+    return FALSE;
+
   /* Jump over end element */
   if(!inf_adopted_session_replay_advance_required(reader, error))
     return FALSE;
@@ -513,6 +992,276 @@ inf_adopted_session_replay_play_initial(InfAdoptedSessionReplay* replay,
   return TRUE;
 }
 
+static void
+inf_adopted_session_replay_setup_session(InfAdoptedSessionReplay* replay)
+{
+  InfAdoptedSessionReplayPrivate* priv;
+  InfIo* io;
+
+  priv = INF_ADOPTED_SESSION_REPLAY_PRIVATE(replay);
+  g_assert(priv->session == NULL);
+  g_assert(priv->plugin != NULL);
+
+  priv->publisher_conn = inf_simulated_connection_new();
+  priv->client_conn = inf_simulated_connection_new();
+  inf_simulated_connection_connect(priv->publisher_conn, priv->client_conn);
+
+  inf_simulated_connection_set_mode(
+    priv->publisher_conn,
+    INF_SIMULATED_CONNECTION_DELAYED
+  );
+
+  inf_simulated_connection_set_mode(
+    priv->client_conn,
+    INF_SIMULATED_CONNECTION_DELAYED
+  );
+
+  priv->publisher_manager = inf_communication_manager_new();
+  priv->publisher_group = inf_communication_manager_open_group(
+    priv->publisher_manager,
+    "InfAdoptedSessionReplay",
+    NULL
+  );
+  inf_communication_hosted_group_add_member(
+    priv->publisher_group,
+    INF_XML_CONNECTION(priv->publisher_conn)
+  );
+
+  priv->client_manager = inf_communication_manager_new();
+  priv->client_group = inf_communication_manager_join_group(
+    priv->client_manager,
+    "InfAdoptedSessionReplay",
+    INF_XML_CONNECTION(priv->client_conn),
+    "central"
+  );
+
+  /* This is not used anyway, but it needs to be present: */
+  io = INF_IO(inf_standalone_io_new());
+
+  priv->session = INF_ADOPTED_SESSION(
+    priv->plugin->session_new(
+      io,
+      priv->client_manager,
+      INF_SESSION_SYNCHRONIZING,
+      INF_COMMUNICATION_GROUP(priv->client_group),
+      INF_XML_CONNECTION(priv->client_conn),
+      NULL,
+      priv->plugin->user_data
+    )
+  );
+
+  g_object_unref(io);
+
+  inf_communication_group_set_target(
+    INF_COMMUNICATION_GROUP(priv->client_group),
+    INF_COMMUNICATION_OBJECT(priv->session)
+  );
+
+  inf_simulated_connection_flush(priv->publisher_conn);
+  inf_simulated_connection_flush(priv->client_conn);
+}
+
+/* Replaces the session by one synchronized from the INITIAL or CHECKPOINT
+ * record at offset of a binary recording */
+static gboolean
+inf_adopted_session_replay_restart(InfAdoptedSessionReplay* replay,
+                                   gsize offset,
+                                   guint n_requests,
+                                   GError** error)
+{
+  gboolean result;
+
+  g_object_freeze_notify(G_OBJECT(replay));
+
+  inf_adopted_session_replay_clear_session(replay);
+  inf_adopted_session_replay_setup_session(replay);
+
+  result = inf_adopted_session_replay_play_binary_initial(
+    replay,
+    offset,
+    n_requests,
+    error
+  );
+
+  if(!result)
+    inf_adopted_session_replay_clear(replay);
+  else
+    g_object_notify(G_OBJECT(replay), "session");
+
+  g_object_thaw_notify(G_OBJECT(replay));
+  return result;
+}
+
+/* Plays a request or user join from the requests section of a recording */
+static gboolean
+inf_adopted_session_replay_play_node(InfAdoptedSessionReplay* replay,
+                                     xmlNodePtr cur,
+                                     GError** error)
+{
+  InfAdoptedSessionReplayPrivate* priv;
+
+  guint id;
+  InfUser* user;
+
+  InfSessionClass* session_class;
+  GArray* user_props;
+  GParameter* param;
+  gboolean result;
+  guint i;
+
+  priv = INF_ADOPTED_SESSION_REPLAY_PRIVATE(replay);
+
+  if(strcmp((const char*)cur->name, "request") == 0)
+  {
+    /* TODO: Add user join/leaves to record.
+     * Until that is done, make users available when they issue a request. */
+    if(!inf_xml_util_get_attribute_uint_required(cur, "user", &id, error))
+      return FALSE;
+
+    user = inf_user_table_lookup_user_by_id(
+      inf_session_get_user_table(INF_SESSION(priv->session)),
+      id
+    );
+
+    if(!user)
+    {
+      g_set_error(
+        error,
+        session_replay_error_quark,
+        INF_ADOPTED_SESSION_REPLAY_ERROR_BAD_FORMAT,
+        _("No such user with ID \"%u\""),
+        id
+      );
+
+      return FALSE;
+    }
+
+    if(inf_user_get_status(user) == INF_USER_UNAVAILABLE)
+    {
+      g_object_set(
+        G_OBJECT(user),
+        "status", INF_USER_ACTIVE,
+        "connection", priv->client_conn,
+        NULL
+      );
+    }
+
+    inf_communication_group_send_group_message(
+      INF_COMMUNICATION_GROUP(priv->publisher_group),
+      xmlCopyNode(cur, 1)
+    );
+
+    /* TODO: Check whether this caused an error. Maybe there should be an
+     * error signal for InfCommunicationGroup, delegating
+     * inf_net_object_received's error. */
+    inf_simulated_connection_flush(priv->publisher_conn);
+
+    ++priv->n_requests;
+  }
+  else if(strcmp((const char*)cur->name, "user") == 0)
+  {
+    /* User join */
+    session_class = INF_SESSION_GET_CLASS(priv->session);
+    user_props = session_class->get_xml_user_props(
+      INF_SESSION(priv->session),
+      INF_XML_CONNECTION(priv->publisher_conn),
+      cur
+    );
+
+    param = inf_session_get_user_property(user_props, "connection");
+    if(!G_IS_VALUE(&param->value))
+    {
+      g_value_init(&param->value, INF_TYPE_XML_CONNECTION);
+      g_value_set_object(&param->value, G_OBJECT(priv->client_conn));
+    }
+
+    result = session_class->validate_user_props(
+      INF_SESSION(priv->session),
+      (const GParameter*)user_props->data,
+      user_props->len,
+      NULL,
+      error
+    );
+
+    user = NULL;
+    if(result == TRUE)
+    {
+      user = inf_session_add_user(
+        INF_SESSION(priv->session),
+        (const GParameter*)user_props->data,
+        user_props->len
+      );
+    }
+
+    for(i = 0; i < user_props->len; ++i)
+      g_value_unset(&g_array_index(user_props, GParameter, i).value);
+    g_array_free(user_props, TRUE);
+
+    if(user == NULL) return FALSE;
+  }
+  else
+  {
+    g_set_error(
+      error,
+      session_replay_error_quark,
+      INF_ADOPTED_SESSION_REPLAY_ERROR_BAD_FORMAT,
+      _("Unexpected node \"%s\" in requests section"),
+      (const gchar*)cur->name
+    );
+
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+inf_adopted_session_replay_play_next_binary(InfAdoptedSessionReplay* replay,
+                                            GError** error)
+{
+  InfAdoptedSessionReplayPrivate* priv;
+  InfAdoptedSessionReplayReader payload;
+  xmlNodePtr xml;
+  guint type;
+  gboolean result;
+
+  priv = INF_ADOPTED_SESSION_REPLAY_PRIVATE(replay);
+
+  for(;;)
+  {
+    /* Incomplete records at the end are ignored; maybe the writer crashed
+     * and could not finish the record properly. */
+    if(!inf_adopted_session_replay_next_record(priv->data, priv->size,
+                                               &priv->offset, &type,
+                                               &payload))
+    {
+      return FALSE;
+    }
+
+    switch(type)
+    {
+    case INF_ADOPTED_SESSION_RECORD_BINARY_CHECKPOINT:
+      /* Checkpoints only matter when seeking */
+      break;
+    case INF_ADOPTED_SESSION_RECORD_BINARY_REQUEST:
+    case INF_ADOPTED_SESSION_RECORD_BINARY_USER:
+      xml = inf_adopted_session_replay_decode_node(&payload, 0);
+      if(xml == NULL)
+      {
+        inf_adopted_session_replay_set_bad_format(error);
+        return FALSE;
+      }
+
+      result = inf_adopted_session_replay_play_node(replay, xml, error);
+      xmlFreeNode(xml);
+      return result;
+    default:
+      inf_adopted_session_replay_set_bad_format(error);
+      return FALSE;
+    }
+  }
+}
+
 /*
  * GObject overrides.
  */
@@ -524,9 +1273,17 @@ inf_adopted_session_replay_init(InfAdoptedSessionReplay* replay)
   priv = INF_ADOPTED_SESSION_REPLAY_PRIVATE(replay);
 
   priv->filename = NULL;
+  priv->plugin = NULL;
   priv->reader = NULL;
   priv->error = NULL;
 
+  priv->mapped = NULL;
+  priv->data = NULL;
+  priv->size = 0;
+  priv->offset = 0;
+  priv->checkpoints = NULL;
+  priv->n_requests = 0;
+
   priv->publisher_manager = NULL;
   priv->publisher_group = NULL;
   priv->publisher_conn = NULL;
@@ -690,8 +1447,9 @@ inf_adopted_session_replay_new(void)
  * @error: Location to store error information, if any.
  *
  * Set the record file for @replay to play. It should have been created with
- * #InfAdoptedSessionRecord. @plugin should match the type of the recorded
- * session. If an error occurs, the function returns %FALSE and @error is set.
+ * #InfAdoptedSessionRecord, in either the XML or the binary format. @plugin
+ * should match the type of the recorded session. If an error occurs, the
+ * function returns %FALSE and @error is set.
  *
  * Returns: %TRUE on success, or %FALSE if the record file could not be set.
  */
@@ -703,7 +1461,9 @@ inf_adopted_session_replay_set_record(InfAdoptedSessionReplay* replay,
 {
   InfAdoptedSessionReplayPrivate* priv;
   xmlTextReaderPtr reader;
-  InfIo* io;
+  GMappedFile* mapped;
+  GArray* checkpoints;
+  gsize end;
   gboolean result;
   xmlErrorPtr xml_error;
 
@@ -714,24 +1474,55 @@ inf_adopted_session_replay_set_record(InfAdoptedSessionReplay* replay,
 
   priv = INF_ADOPTED_SESSION_REPLAY_PRIVATE(replay);
 
-  reader = xmlReaderForFile(
-    filename,
-    NULL,
-    XML_PARSE_NOERROR | XML_PARSE_NOWARNING
-  );
+  reader = NULL;
+  checkpoints = NULL;
+  end = 0;
+
+  /* Binary records are recognized by their magic, anything else is read
+   * as XML. */
+  mapped = g_mapped_file_new(filename, FALSE, NULL);
+  if(mapped != NULL &&
+     (g_mapped_file_get_length(mapped) <
+      INF_ADOPTED_SESSION_RECORD_BINARY_HEADER_SIZE ||
+      memcmp(
+        g_mapped_file_get_contents(mapped),
+        INF_ADOPTED_SESSION_RECORD_BINARY_MAGIC,
+        INF_ADOPTED_SESSION_RECORD_BINARY_MAGIC_SIZE) != 0))
+  {
+    g_mapped_file_unref(mapped);
+    mapped = NULL;
+  }
 
-  if(!reader)
+  if(mapped != NULL)
+  {
+    if(!inf_adopted_session_replay_load_binary(mapped, &end, &checkpoints,
+                                               error))
+    {
+      g_mapped_file_unref(mapped);
+      return FALSE;
+    }
+  }
+  else
   {
-    xml_error = xmlGetLastError();
-
-    g_set_error_literal(
-      error,
-      session_replay_error_quark,
-      INF_ADOPTED_SESSION_REPLAY_ERROR_BAD_FILE,
-      xml_error->message
+    reader = xmlReaderForFile(
+      filename,
+      NULL,
+      XML_PARSE_NOERROR | XML_PARSE_NOWARNING
     );
 
-    return FALSE;
+    if(!reader)
+    {
+      xml_error = xmlGetLastError();
+
+      g_set_error_literal(
+        error,
+        session_replay_error_quark,
+        INF_ADOPTED_SESSION_REPLAY_ERROR_BAD_FILE,
+        xml_error->message
+      );
+
+      return FALSE;
+    }
   }
 
   /* TODO: Keep current staet if playing the initial fails */
@@ -741,76 +1532,41 @@ inf_adopted_session_replay_set_record(InfAdoptedSessionReplay* replay,
   inf_adopted_session_replay_clear(replay);
 
   priv->filename = g_strdup(filename);
+  priv->plugin = plugin;
   priv->reader = reader;
 
-  priv->publisher_conn = inf_simulated_connection_new();
-  priv->client_conn = inf_simulated_connection_new();
-  inf_simulated_connection_connect(priv->publisher_conn, priv->client_conn);
-
-  inf_simulated_connection_set_mode(
-    priv->publisher_conn,
-    INF_SIMULATED_CONNECTION_DELAYED
-  );
-
-  inf_simulated_connection_set_mode(
-    priv->client_conn,
-    INF_SIMULATED_CONNECTION_DELAYED
-  );
-
-  priv->publisher_manager = inf_communication_manager_new();
-  priv->publisher_group = inf_communication_manager_open_group(
-    priv->publisher_manager,
-    "InfAdoptedSessionReplay",
-    NULL
-  );
-  inf_communication_hosted_group_add_member(
-    priv->publisher_group,
-    INF_XML_CONNECTION(priv->publisher_conn)
-  );
-
-  priv->client_manager = inf_communication_manager_new();
-  priv->client_group = inf_communication_manager_join_group(
-    priv->client_manager,
-    "InfAdoptedSessionReplay",
-    INF_XML_CONNECTION(priv->client_conn),
-    "central"
-  );
-
-  /* This is not used anyway, but it needs to be present: */
-  io = INF_IO(inf_standalone_io_new());
-
-  priv->session = INF_ADOPTED_SESSION(
-    plugin->session_new(
-      io,
-      priv->client_manager,
-      INF_SESSION_SYNCHRONIZING,
-      INF_COMMUNICATION_GROUP(priv->client_group),
-      INF_XML_CONNECTION(priv->client_conn),
-      NULL,
-      plugin->user_data
-    )
-  );
-
-  g_object_unref(io);
+  if(mapped != NULL)
+  {
+    priv->mapped = mapped;
+    priv->data = (const guint8*)g_mapped_file_get_contents(mapped);
+    priv->size = end;
+    priv->checkpoints = checkpoints;
+  }
 
-  inf_communication_group_set_target(
-    INF_COMMUNICATION_GROUP(priv->client_group),
-    INF_COMMUNICATION_OBJECT(priv->session)
-  );
+  inf_adopted_session_replay_setup_session(replay);
 
-  inf_simulated_connection_flush(priv->publisher_conn);
-  inf_simulated_connection_flush(priv->client_conn);
+  if(mapped != NULL)
+  {
+    result = inf_adopted_session_replay_play_binary_initial(
+      replay,
+      INF_ADOPTED_SESSION_RECORD_BINARY_HEADER_SIZE,
+      0,
+      error
+    );
+  }
+  else
+  {
+    result = inf_adopted_session_replay_play_initial(replay, plugin, error);
+  }
 
-  if(!inf_adopted_session_replay_play_initial(replay, plugin, error))
+  if(!result)
   {
     inf_adopted_session_replay_clear(replay);
-    result = FALSE;
   }
   else
   {
     g_object_notify(G_OBJECT(replay), "filename");
     g_object_notify(G_OBJECT(replay), "session");
-    result = TRUE;
   }
 
   g_object_thaw_notify(G_OBJECT(replay));
@@ -825,6 +1581,9 @@ inf_adopted_session_replay_set_record(InfAdoptedSessionReplay* replay,
  * Returns the played back session, or %NULL if
  * inf_adopted_session_replay_set_record() was not yet called.
  *
+ * Note that inf_adopted_session_replay_seek() can replace the session by a
+ * new one.
+ *
  * Returns: (transfer none): A #InfAdoptedSessionReplay, or %NULL.
  */
 InfAdoptedSession*
@@ -862,19 +1621,14 @@ inf_adopted_session_replay_play_next(InfAdoptedSessionReplay* replay,
   int type;
   xmlNodePtr cur;
 
-  guint id;
-  InfUser* user;
-
-  InfSessionClass* session_class;
-  GArray* user_props;
-  GParameter* param;
-  gboolean result;
-  guint i;
-
   g_return_val_if_fail(INF_ADOPTED_IS_SESSION_REPLAY(replay), FALSE);
   g_return_val_if_fail(error == NULL || *error == NULL, FALSE);
 
   priv = INF_ADOPTED_SESSION_REPLAY_PRIVATE(replay);
+
+  if(priv->mapped != NULL)
+    return inf_adopted_session_replay_play_next_binary(replay, error);
+
   reader = priv->reader;
 
   type = xmlTextReaderNodeType(reader);
@@ -898,103 +1652,8 @@ inf_adopted_session_replay_play_next(InfAdoptedSessionReplay* replay,
   cur = inf_adopted_session_replay_read_current(reader, error);
   if(cur == NULL) return FALSE;
 
-  if(strcmp((const char*)cur->name, "request") == 0)
-  {
-    /* TODO: Add user join/leaves to record.
-     * Until that is done, make users available when they issue a request. */
-    if(!inf_xml_util_get_attribute_uint_required(cur, "user", &id, error))
-      return FALSE;
-
-    user = inf_user_table_lookup_user_by_id(
-      inf_session_get_user_table(INF_SESSION(priv->session)),
-      id
-    );
-
-    if(!user)
-    {
-      g_set_error(
-        error,
-        session_replay_error_quark,
-        INF_ADOPTED_SESSION_REPLAY_ERROR_BAD_FORMAT,
-        _("No such user with ID \"%u\""),
-        id
-      );
-
-      return FALSE;
-    }
-
-    if(inf_user_get_status(user) == INF_USER_UNAVAILABLE)
-    {
-      g_object_set(
-        G_OBJECT(user),
-        "status", INF_USER_ACTIVE,
-        "connection", priv->client_conn,
-        NULL
-      );
-    }
-
-    inf_communication_group_send_group_message(
-      INF_COMMUNICATION_GROUP(priv->publisher_group),
-      xmlCopyNode(cur, 1)
-    );
-
-    /* TODO: Check whether this caused an error. Maybe there should be an
-     * error signal for InfCommunicationGroup, delegating
-     * inf_net_object_received's error. */
-    inf_simulated_connection_flush(priv->publisher_conn);
-  }
-  else if(strcmp((const char*)cur->name, "user") == 0)
-  {
-    /* User join */
-    session_class = INF_SESSION_GET_CLASS(priv->session);
-    user_props = session_class->get_xml_user_props(
-      INF_SESSION(priv->session),
-      INF_XML_CONNECTION(priv->publisher_conn),
-      cur
-    );
-
-    param = inf_session_get_user_property(user_props, "connection");
-    if(!G_IS_VALUE(&param->value))
-    {
-      g_value_init(&param->value, INF_TYPE_XML_CONNECTION);
-      g_value_set_object(&param->value, G_OBJECT(priv->client_conn));
-    }
-
-    result = session_class->validate_user_props(
-      INF_SESSION(priv->session),
-      (const GParameter*)user_props->data,
-      user_props->len,
-      NULL,
-      error
-    );
-
-    if(result == TRUE)
-    {
-      user = inf_session_add_user(
-        INF_SESSION(priv->session),
-        (const GParameter*)user_props->data,
-        user_props->len
-      );
-    }
-
-    for(i = 0; i < user_props->len; ++i)
-      g_value_unset(&g_array_index(user_props, GParameter, i).value);
-    g_array_free(user_props, TRUE);
-
-    if(user == NULL) return FALSE;
-  }
-  else
-  {
-    g_set_error(
-      error,
-      session_replay_error_quark,
-      INF_ADOPTED_SESSION_REPLAY_ERROR_BAD_FORMAT,
-      _("Unexpected node \"%s\" in requests section"),
-      id
-    );
-
+  if(!inf_adopted_session_replay_play_node(replay, cur, error))
     return FALSE;
-  }
 
   if(!inf_adopted_session_replay_advance_subtree_required(reader, error))
     return FALSE;
@@ -1047,4 +1706,137 @@ inf_adopted_session_replay_play_to_end(InfAdoptedSessionReplay* replay,
   return TRUE;
 }
 
+/**
+ * inf_adopted_session_replay_get_position:
+ * @replay: A #InfAdoptedSessionReplay.
+ *
+ * Returns the number of requests from the recording that have been played
+ * so far.
+ *
+ * Returns: The number of played requests.
+ */
+guint
+inf_adopted_session_replay_get_position(InfAdoptedSessionReplay* replay)
+{
+  g_return_val_if_fail(INF_ADOPTED_IS_SESSION_REPLAY(replay), 0);
+  return INF_ADOPTED_SESSION_REPLAY_PRIVATE(replay)->n_requests;
+}
+
+/**
+ * inf_adopted_session_replay_seek:
+ * @replay: A #InfAdoptedSessionReplay.
+ * @position: The number of requests that should have been played.
+ * @error: Location to store error information, if any.
+ *
+ * Brings the replayed session to the state after the first @position
+ * requests of the recording have been played. If the recording contains
+ * fewer requests, the whole recording is played.
+ *
+ * For binary recordings, the session is restored from the closest
+ * checkpoint before @position if that is closer than the current position,
+ * and only the requests after that checkpoint are played. For XML
+ * recordings, seeking backwards plays the recording from the beginning.
+ *
+ * When the replay starts from a checkpoint or from the beginning, the
+ * session is replaced by a new one, so signal handlers connected to the
+ * previous session need to be connected again. The
+ * #InfAdoptedSessionReplay:session property is notified in that case.
+ *
+ * If an error occurs, the function returns %FALSE and @error is set.
+ *
+ * Returns: %TRUE on success, or %FALSE if an error occurs.
+ */
+gboolean
+inf_adopted_session_replay_seek(InfAdoptedSessionReplay* replay,
+                                guint position,
+                                GError** error)
+{
+  InfAdoptedSessionReplayPrivate* priv;
+  InfAdoptedSessionReplayCheckpoint* checkpoint;
+  InfAdoptedSessionReplayCheckpoint* best;
+  GError* local_error;
+  gchar* filename;
+  gboolean result;
+  guint i;
+
+  g_return_val_if_fail(INF_ADOPTED_IS_SESSION_REPLAY(replay), FALSE);
+  g_return_val_if_fail(error == NULL || *error == NULL, FALSE);
+
+  priv = INF_ADOPTED_SESSION_REPLAY_PRIVATE(replay);
+  g_return_val_if_fail(priv->session != NULL, FALSE);
+
+  if(priv->mapped != NULL)
+  {
+    best = NULL;
+    for(i = 0; i < priv->checkpoints->len; ++i)
+    {
+      checkpoint = &g_array_index(
+        priv->checkpoints,
+        InfAdoptedSessionReplayCheckpoint,
+        i
+      );
+
+      if(checkpoint->n_requests <= position &&
+         (best == NULL || checkpoint->n_requests > best->n_requests))
+      {
+        best = checkpoint;
+      }
+    }
+
+    if(best != NULL &&
+       (position < priv->n_requests || best->n_requests > priv->n_requests))
+    {
+      result = inf_adopted_session_replay_restart(
+        replay,
+        best->offset,
+        best->n_requests,
+        error
+      );
+
+      if(!result) return FALSE;
+    }
+    else if(position < priv->n_requests)
+    {
+      result = inf_adopted_session_replay_restart(
+        replay,
+        INF_ADOPTED_SESSION_RECORD_BINARY_HEADER_SIZE,
+        0,
+        error
+      );
+
+      if(!result) return FALSE;
+    }
+  }
+  else if(position < priv->n_requests)
+  {
+    filename = g_strdup(priv->filename);
+    result = inf_adopted_session_replay_set_record(
+      replay,
+      filename,
+      priv->plugin,
+      error
+    );
+    g_free(filename);
+
+    if(!result) return FALSE;
+  }
+
+  local_error = NULL;
+  while(priv->n_requests < position)
+  {
+    if(!inf_adopted_session_replay_play_next(replay, &local_error))
+    {
+      if(local_error != NULL)
+      {
+        g_propagate_error(error, local_error);
+        return FALSE;
+      }
+
+      break;
+    }
+  }
+
+  return TRUE;
+}
+
 /* vim:set et sw=2 ts=2: */
@@ -110,6 +110,14 @@ gboolean
 inf_adopted_session_replay_play_to_end(InfAdoptedSessionReplay* replay,
                                        GError** error);
 
+guint
+inf_adopted_session_replay_get_position(InfAdoptedSessionReplay* replay);
+
+gboolean
+inf_adopted_session_replay_seek(InfAdoptedSessionReplay* replay,
+                                guint position,
+                                GError** error);
+
 G_END_DECLS
 
 #endif /* __INF_ADOPTED_SESSION_REPLAY_H__ */
@@ -39,6 +39,7 @@
 
 #include <libinfinity/adopted/inf-adopted-session.h>
 #include <libinfinity/adopted/inf-adopted-no-operation.h>
+#include <libinfinity/communication/inf-communication-hosted-group.h>
 #include <libinfinity/common/inf-xml-util.h>
 #include <libinfinity/common/inf-error.h>
 #include <libinfinity/inf-i18n.h>
@@ -61,6 +62,21 @@ struct _InfAdoptedSessionLocalUser {
   time_t noop_time; /* TODO: should be monotonic time */
 };
 
+/* A request that does not affect the buffer, held back before forwarding it
+ * to a connection. base is the user's vector as last seen by the connection,
+ * which the request's time is written as a diff to. */
+typedef struct _InfAdoptedSessionCoalesced InfAdoptedSessionCoalesced;
+struct _InfAdoptedSessionCoalesced {
+  InfAdoptedRequest* request;
+  InfAdoptedStateVector* base;
+};
+
+typedef struct _InfAdoptedSessionRelay InfAdoptedSessionRelay;
+struct _InfAdoptedSessionRelay {
+  InfXmlConnection* connection;
+  GSList* coalesced; /* at most one InfAdoptedSessionCoalesced per user */
+};
+
 typedef struct _InfAdoptedSessionPrivate InfAdoptedSessionPrivate;
 struct _InfAdoptedSessionPrivate {
   InfIo* io;
@@ -75,6 +91,12 @@ struct _InfAdoptedSessionPrivate {
   InfAdoptedSessionLocalUser* next_noop_user;
   /* Buffer for requests that are not ready to be executed yet */
   GPtrArray* request_buffer;
+
+  /* Coalescing of forwarded requests that do not affect the buffer */
+  guint coalesce_interval;
+  InfCommunicationGroup* coalesce_group;
+  GSList* relays;
+  InfIoTimeout* coalesce_timeout;
 };
 
 enum {
@@ -84,6 +106,9 @@ enum {
   PROP_IO,
   PROP_MAX_TOTAL_LOG_SIZE,
 
+  /* read/write */
+  PROP_COALESCE_INTERVAL,
+
   /* read only */
   PROP_ALGORITHM
 };
@@ -263,6 +288,13 @@ inf_adopted_session_noop_timeout_func(gpointer user_data)
   priv->noop_timeout = NULL;
   g_assert(priv->next_noop_user != NULL);
 
+  /* Sending the noop flushes held back modifications, so they need to be
+   * generated before the noop is. If this sent a request of the user, it
+   * made the noop unnecessary, and the timer has been rescheduled. */
+  inf_session_flush(INF_SESSION(session));
+  if(priv->noop_timeout != NULL || priv->next_noop_user == NULL)
+    return;
+
   op = INF_ADOPTED_OPERATION(inf_adopted_no_operation_new());
 
   request = inf_adopted_algorithm_generate_request(
@@ -382,6 +414,343 @@ inf_adopted_session_stop_noop_timer(InfAdoptedSession* session,
   }
 }
 
+/*
+ * Request coalescing.
+ */
+
+static void
+inf_adopted_session_coalesced_free(InfAdoptedSessionCoalesced* coalesced)
+{
+  g_object_unref(coalesced->request);
+  inf_adopted_state_vector_free(coalesced->base);
+  g_slice_free(InfAdoptedSessionCoalesced, coalesced);
+}
+
+static void
+inf_adopted_session_relay_free(InfAdoptedSessionRelay* relay)
+{
+  GSList* item;
+
+  for(item = relay->coalesced; item != NULL; item = g_slist_next(item))
+    inf_adopted_session_coalesced_free(item->data);
+
+  g_slist_free(relay->coalesced);
+  g_object_unref(relay->connection);
+  g_slice_free(InfAdoptedSessionRelay, relay);
+}
+
+/* Sends all held back requests to their connections. This needs to be called
+ * before anything else is sent to the subscription group, so that the
+ * requests are received in the same order relative to requests affecting the
+ * buffer, and their positions are still valid when they arrive. */
+static void
+inf_adopted_session_flush_coalesced(InfAdoptedSession* session)
+{
+  InfAdoptedSessionPrivate* priv;
+  InfAdoptedSessionClass* session_class;
+  InfCommunicationGroup* group;
+  InfAdoptedSessionRelay* relay;
+  InfAdoptedSessionCoalesced* coalesced;
+  GSList* relays;
+  GSList* item;
+  GSList* coalesced_item;
+  xmlNodePtr xml;
+
+  priv = INF_ADOPTED_SESSION_PRIVATE(session);
+  session_class = INF_ADOPTED_SESSION_GET_CLASS(session);
+
+  if(priv->coalesce_timeout != NULL)
+  {
+    inf_io_remove_timeout(priv->io, priv->coalesce_timeout);
+    priv->coalesce_timeout = NULL;
+  }
+
+  if(priv->coalesce_group == NULL)
+    return;
+
+  /* Take all held back requests first, since sending can cause connections
+   * to leave the group, which removes their relay. */
+  relays = NULL;
+  for(item = priv->relays; item != NULL; item = g_slist_next(item))
+  {
+    relay = (InfAdoptedSessionRelay*)item->data;
+    if(relay->coalesced != NULL)
+    {
+      relays = g_slist_prepend(
+        relays,
+        g_slice_dup(InfAdoptedSessionRelay, relay)
+      );
+
+      g_object_ref(relay->connection);
+      relay->coalesced = NULL;
+    }
+  }
+
+  group = priv->coalesce_group;
+  g_object_ref(group);
+
+  for(item = relays; item != NULL; item = g_slist_next(item))
+  {
+    relay = (InfAdoptedSessionRelay*)item->data;
+    relay->coalesced = g_slist_reverse(relay->coalesced);
+
+    for(coalesced_item = relay->coalesced;
+        coalesced_item != NULL;
+        coalesced_item = g_slist_next(coalesced_item))
+    {
+      coalesced = (InfAdoptedSessionCoalesced*)coalesced_item->data;
+      if(!inf_communication_group_is_member(group, relay->connection))
+        break;
+
+      xml = xmlNewNode(NULL, (const xmlChar*)"request");
+
+      session_class->request_to_xml(
+        session,
+        xml,
+        coalesced->request,
+        coalesced->base,
+        FALSE
+      );
+
+      inf_communication_group_send_message(group, relay->connection, xml);
+    }
+
+    inf_adopted_session_relay_free(relay);
+  }
+
+  g_slist_free(relays);
+  g_object_unref(group);
+}
+
+static void
+inf_adopted_session_coalesce_timeout_func(gpointer user_data)
+{
+  InfAdoptedSession* session;
+  InfAdoptedSessionPrivate* priv;
+
+  session = INF_ADOPTED_SESSION(user_data);
+  priv = INF_ADOPTED_SESSION_PRIVATE(session);
+  priv->coalesce_timeout = NULL;
+
+  inf_adopted_session_flush_coalesced(session);
+}
+
+/* Holds back request for all subscribed connections except the one it was
+ * received from, replacing a request of the same user that is still held
+ * back. base is the user's vector before request was received. */
+static void
+inf_adopted_session_coalesce_request(InfAdoptedSession* session,
+                                     InfXmlConnection* connection,
+                                     InfAdoptedRequest* request,
+                                     InfAdoptedStateVector* base)
+{
+  InfAdoptedSessionPrivate* priv;
+  InfAdoptedSessionRelay* relay;
+  InfAdoptedSessionCoalesced* coalesced;
+  GSList* item;
+  GSList* coalesced_item;
+  guint user_id;
+
+  priv = INF_ADOPTED_SESSION_PRIVATE(session);
+  user_id = inf_adopted_request_get_user_id(request);
+
+  for(item = priv->relays; item != NULL; item = g_slist_next(item))
+  {
+    relay = (InfAdoptedSessionRelay*)item->data;
+    if(relay->connection == connection)
+      continue;
+
+    for(coalesced_item = relay->coalesced;
+        coalesced_item != NULL;
+        coalesced_item = g_slist_next(coalesced_item))
+    {
+      coalesced = (InfAdoptedSessionCoalesced*)coalesced_item->data;
+      if(inf_adopted_request_get_user_id(coalesced->request) == user_id)
+        break;
+    }
+
+    if(coalesced_item != NULL)
+    {
+      /* The connection has not yet seen the previous request, so its
+       * base remains valid. */
+      g_object_unref(coalesced->request);
+      coalesced->request = request;
+      g_object_ref(request);
+    }
+    else
+    {
+      coalesced = g_slice_new(InfAdoptedSessionCoalesced);
+      coalesced->request = request;
+      coalesced->base = inf_adopted_state_vector_copy(base);
+
+      g_object_ref(request);
+      relay->coalesced = g_slist_prepend(relay->coalesced, coalesced);
+    }
+  }
+
+  if(priv->coalesce_timeout == NULL)
+  {
+    priv->coalesce_timeout = inf_io_add_timeout(
+      priv->io,
+      priv->coalesce_interval,
+      inf_adopted_session_coalesce_timeout_func,
+      session,
+      NULL
+    );
+  }
+}
+
+static void
+inf_adopted_session_coalesce_member_added_cb(InfCommunicationGroup* group,
+                                             InfXmlConnection* connection,
+                                             gpointer user_data)
+{
+  InfAdoptedSessionPrivate* priv;
+  InfAdoptedSessionRelay* relay;
+
+  priv = INF_ADOPTED_SESSION_PRIVATE(user_data);
+
+  relay = g_slice_new(InfAdoptedSessionRelay);
+  relay->connection = connection;
+  relay->coalesced = NULL;
+  g_object_ref(connection);
+
+  priv->relays = g_slist_prepend(priv->relays, relay);
+}
+
+static void
+inf_adopted_session_coalesce_member_removed_cb(InfCommunicationGroup* group,
+                                               InfXmlConnection* connection,
+                                               gpointer user_data)
+{
+  InfAdoptedSessionPrivate* priv;
+  InfAdoptedSessionRelay* relay;
+  GSList* item;
+
+  priv = INF_ADOPTED_SESSION_PRIVATE(user_data);
+
+  for(item = priv->relays; item != NULL; item = g_slist_next(item))
+  {
+    relay = (InfAdoptedSessionRelay*)item->data;
+    if(relay->connection == connection)
+    {
+      priv->relays = g_slist_delete_link(priv->relays, item);
+      inf_adopted_session_relay_free(relay);
+      break;
+    }
+  }
+}
+
+/* Only the host of the subscription group forwards requests, so this is
+ * where they are coalesced. */
+static void
+inf_adopted_session_set_coalesce_group(InfAdoptedSession* session,
+                                       InfCommunicationGroup* group)
+{
+  InfAdoptedSessionPrivate* priv;
+  priv = INF_ADOPTED_SESSION_PRIVATE(session);
+
+  if(group != NULL && !INF_COMMUNICATION_IS_HOSTED_GROUP(group))
+    group = NULL;
+
+  if(priv->coalesce_group != NULL)
+  {
+    inf_signal_handlers_disconnect_by_func(
+      G_OBJECT(priv->coalesce_group),
+      G_CALLBACK(inf_adopted_session_coalesce_member_added_cb),
+      session
+    );
+
+    inf_signal_handlers_disconnect_by_func(
+      G_OBJECT(priv->coalesce_group),
+      G_CALLBACK(inf_adopted_session_coalesce_member_removed_cb),
+      session
+    );
+
+    g_slist_free_full(
+      priv->relays,
+      (GDestroyNotify)inf_adopted_session_relay_free
+    );
+
+    priv->relays = NULL;
+    g_object_unref(priv->coalesce_group);
+  }
+
+  if(priv->coalesce_timeout != NULL)
+  {
+    inf_io_remove_timeout(priv->io, priv->coalesce_timeout);
+    priv->coalesce_timeout = NULL;
+  }
+
+  priv->coalesce_group = group;
+
+  if(group != NULL)
+  {
+    g_object_ref(group);
+
+    g_signal_connect(
+      G_OBJECT(group),
+      "member-added",
+      G_CALLBACK(inf_adopted_session_coalesce_member_added_cb),
+      session
+    );
+
+    g_signal_connect(
+      G_OBJECT(group),
+      "member-removed",
+      G_CALLBACK(inf_adopted_session_coalesce_member_removed_cb),
+      session
+    );
+  }
+}
+
+static void
+inf_adopted_session_notify_subscription_group_cb(GObject* object,
+                                                 GParamSpec* pspec,
+                                                 gpointer user_data)
+{
+  inf_adopted_session_set_coalesce_group(
+    INF_ADOPTED_SESSION(object),
+    inf_session_get_subscription_group(INF_SESSION(object))
+  );
+}
+
+static void
+inf_adopted_session_remove_available_user_cb(InfUserTable* user_table,
+                                             InfUser* user,
+                                             gpointer user_data)
+{
+  InfAdoptedSessionPrivate* priv;
+  InfAdoptedSessionRelay* relay;
+  InfAdoptedSessionCoalesced* coalesced;
+  GSList* item;
+  GSList* coalesced_item;
+
+  priv = INF_ADOPTED_SESSION_PRIVATE(user_data);
+
+  /* The user might rejoin with a different vector, so the base of held back
+   * requests would no longer be valid. */
+  for(item = priv->relays; item != NULL; item = g_slist_next(item))
+  {
+    relay = (InfAdoptedSessionRelay*)item->data;
+
+    for(coalesced_item = relay->coalesced;
+        coalesced_item != NULL;
+        coalesced_item = g_slist_next(coalesced_item))
+    {
+      coalesced = (InfAdoptedSessionCoalesced*)coalesced_item->data;
+      if(inf_adopted_request_get_user_id(coalesced->request) ==
+         inf_user_get_id(user))
+      {
+        relay->coalesced =
+          g_slist_delete_link(relay->coalesced, coalesced_item);
+        inf_adopted_session_coalesced_free(coalesced);
+        break;
+      }
+    }
+  }
+}
+
 /* Breadcasts a request N times - makes only sense for undo and redo requests,
  * so that's the only thing we offer API for. */
 static void
@@ -401,6 +770,8 @@ inf_adopted_session_broadcast_n_requests(InfAdoptedSession* session,
   session_class = INF_ADOPTED_SESSION_GET_CLASS(session);
   g_assert(session_class->request_to_xml != NULL);
 
+  inf_adopted_session_flush_coalesced(session);
+
   user_table = inf_session_get_user_table(INF_SESSION(session));
   user_id = inf_adopted_request_get_user_id(request);
   user = inf_user_table_lookup_user_by_id(user_table, user_id);
@@ -804,6 +1175,11 @@ inf_adopted_session_init(InfAdoptedSession* session)
   priv->noop_timeout = NULL;
   priv->next_noop_user = NULL;
   priv->request_buffer = NULL;
+
+  priv->coalesce_interval = 0;
+  priv->coalesce_group = NULL;
+  priv->relays = NULL;
+  priv->coalesce_timeout = NULL;
 }
 
 static void
@@ -838,6 +1214,25 @@ inf_adopted_session_constructed(GObject* object)
     session
   );
 
+  g_signal_connect(
+    G_OBJECT(user_table),
+    "remove-available-user",
+    G_CALLBACK(inf_adopted_session_remove_available_user_cb),
+    session
+  );
+
+  g_signal_connect(
+    G_OBJECT(session),
+    "notify::subscription-group",
+    G_CALLBACK(inf_adopted_session_notify_subscription_group_cb),
+    session
+  );
+
+  inf_adopted_session_set_coalesce_group(
+    session,
+    inf_session_get_subscription_group(INF_SESSION(session))
+  );
+
   switch(status)
   {
   case INF_SESSION_PRESYNC:
@@ -891,6 +1286,12 @@ inf_adopted_session_dispose(GObject* object)
     session
   );
 
+  inf_signal_handlers_disconnect_by_func(
+    G_OBJECT(user_table),
+    G_CALLBACK(inf_adopted_session_remove_available_user_cb),
+    session
+  );
+
   if(priv->noop_timeout != NULL)
   {
     inf_io_remove_timeout(priv->io, priv->noop_timeout);
@@ -901,6 +1302,14 @@ inf_adopted_session_dispose(GObject* object)
    * free the local users. */
   G_OBJECT_CLASS(inf_adopted_session_parent_class)->dispose(object);
 
+  inf_signal_handlers_disconnect_by_func(
+    G_OBJECT(session),
+    G_CALLBACK(inf_adopted_session_notify_subscription_group_cb),
+    session
+  );
+
+  inf_adopted_session_set_coalesce_group(session, NULL);
+
   g_assert(priv->local_users == NULL);
 
   if(priv->request_buffer != NULL)
@@ -966,6 +1375,11 @@ inf_adopted_session_set_property(GObject* object,
   case PROP_MAX_TOTAL_LOG_SIZE:
     priv->max_total_log_size = g_value_get_uint(value);
     break;
+  case PROP_COALESCE_INTERVAL:
+    priv->coalesce_interval = g_value_get_uint(value);
+    if(priv->coalesce_interval == 0)
+      inf_adopted_session_flush_coalesced(session);
+    break;
   case PROP_ALGORITHM:
     /* read only */
   default:
@@ -994,6 +1408,9 @@ inf_adopted_session_get_property(GObject* object,
   case PROP_MAX_TOTAL_LOG_SIZE:
     g_value_set_uint(value, priv->max_total_log_size);
     break;
+  case PROP_COALESCE_INTERVAL:
+    g_value_set_uint(value, priv->coalesce_interval);
+    break;
   case PROP_ALGORITHM:
     g_value_set_object(value, G_OBJECT(priv->algorithm));
     break;
@@ -1134,6 +1551,7 @@ inf_adopted_session_process_xml_run(InfSession* session,
 
   InfAdoptedStateVector* user_vector;
   InfAdoptedStateVector* request_vector;
+  InfAdoptedStateVector* base_vector;
 
   gboolean has_num;
   gboolean process_request;
@@ -1149,6 +1567,10 @@ inf_adopted_session_process_xml_run(InfSession* session,
 
   priv = INF_ADOPTED_SESSION_PRIVATE(session);
 
+  /* Incoming requests are transformed against local ones, so these need to
+   * be known to the algorithm first. */
+  inf_session_flush(session);
+
   if(strcmp((const char*)xml->name, "request") == 0)
   {
     session_class = INF_ADOPTED_SESSION_GET_CLASS(session);
@@ -1233,11 +1655,25 @@ inf_adopted_session_process_xml_run(InfSession* session,
       return INF_COMMUNICATION_SCOPE_PTP;
     }
 
+    /* Remember the previous user vector in case the request is held back,
+     * since other connections decode the request relative to it. */
+    base_vector = NULL;
+    if(priv->coalesce_interval > 0 && priv->coalesce_group != NULL &&
+       num == 1 && !inf_adopted_request_affects_buffer(request))
+    {
+      base_vector = inf_adopted_state_vector_copy(user_vector);
+    }
+
     /* Update the user vector to the state of the request. */
     user_vector = inf_adopted_state_vector_copy(request_vector);
     /* Note that this function takes ownership of user_vector */
     inf_adopted_user_set_vector(INF_ADOPTED_USER(user), user_vector);
 
+    /* Requests that became ready by this one are executed in the same
+     * batch, so that undo state and notifications are updated only once
+     * when catching up with many requests. */
+    inf_adopted_algorithm_begin_batch(priv->algorithm);
+
     /* Apply the request more than once if num >= 2 is given. This is mostly
      * used for multiple undos and redos, but is in general allowed for any
      * request. */
@@ -1288,6 +1724,24 @@ inf_adopted_session_process_xml_run(InfSession* session,
         break;
     }
 
+    if(base_vector != NULL && i == num)
+    {
+      /* The request is forwarded when the coalesce timeout elapses, or
+       * before anything else is sent to the group. */
+      inf_adopted_session_coalesce_request(
+        INF_ADOPTED_SESSION(session),
+        connection,
+        request,
+        base_vector
+      );
+    }
+    else
+    {
+      /* Held back requests need to arrive before this one, so that their
+       * positions refer to the same state of the buffer. */
+      inf_adopted_session_flush_coalesced(INF_ADOPTED_SESSION(session));
+    }
+
     g_object_unref(request);
 
     /* The processed request(s) might have caused some of the buffered
@@ -1299,18 +1753,31 @@ inf_adopted_session_process_xml_run(InfSession* session,
       );
     }
 
+    inf_adopted_algorithm_end_batch(priv->algorithm);
+
     /* Cleanup requests that are no longer used after
      * having processed everything */
     inf_adopted_algorithm_cleanup(
       inf_adopted_session_get_algorithm(INF_ADOPTED_SESSION(session))
     );
 
+    if(base_vector != NULL)
+    {
+      inf_adopted_state_vector_free(base_vector);
+      if(i == num)
+        return INF_COMMUNICATION_SCOPE_PTP;
+    }
+
     /* Requests can always be forwarded since user is given. Explicitly allow
      * forwarding if the request could not be applied... maybe others are more
      * lucky? In the worst case it will just fail for them as well. */
     return INF_COMMUNICATION_SCOPE_GROUP;
   }
 
+  /* Keep held back requests in order with other forwarded messages, such
+   * as user joins and leaves. */
+  inf_adopted_session_flush_coalesced(INF_ADOPTED_SESSION(session));
+
   parent_class = INF_SESSION_CLASS(inf_adopted_session_parent_class);
   return parent_class->process_xml_run(session, connection, xml, error);
 }
@@ -1462,9 +1929,45 @@ inf_adopted_session_close(InfSession* session)
   g_slist_free(priv->local_users);
   priv->local_users = NULL;
 
+  /* Held back requests are not delivered anymore */
+  inf_adopted_session_set_coalesce_group(INF_ADOPTED_SESSION(session), NULL);
+
   INF_SESSION_CLASS(inf_adopted_session_parent_class)->close(session);
 }
 
+static gsize
+inf_adopted_session_get_memory_usage(InfSession* session)
+{
+  InfAdoptedSessionPrivate* priv;
+  InfSessionClass* parent_class;
+  gsize usage;
+
+  priv = INF_ADOPTED_SESSION_PRIVATE(session);
+  parent_class = INF_SESSION_CLASS(inf_adopted_session_parent_class);
+
+  usage = parent_class->get_memory_usage(session);
+  if(priv->algorithm != NULL)
+    usage += inf_adopted_algorithm_get_memory_usage(priv->algorithm);
+
+  return usage;
+}
+
+static void
+inf_adopted_session_trim(InfSession* session)
+{
+  InfAdoptedSessionPrivate* priv;
+  priv = INF_ADOPTED_SESSION_PRIVATE(session);
+
+  if(priv->algorithm != NULL)
+    inf_adopted_algorithm_trim(priv->algorithm);
+}
+
+static void
+inf_adopted_session_flush(InfSession* session)
+{
+  inf_adopted_session_flush_coalesced(INF_ADOPTED_SESSION(session));
+}
+
 static void
 inf_adopted_session_synchronization_complete_foreach_user_func(InfUser* user,
                                                                gpointer data)
@@ -1554,6 +2057,9 @@ inf_adopted_session_class_init(InfAdoptedSessionClass* adopted_session_class)
   session_class->set_xml_user_props = inf_adopted_session_set_xml_user_props;
   session_class->validate_user_props =
     inf_adopted_session_validate_user_props;
+  session_class->get_memory_usage = inf_adopted_session_get_memory_usage;
+  session_class->trim = inf_adopted_session_trim;
+  session_class->flush = inf_adopted_session_flush;
 
   session_class->close = inf_adopted_session_close;
   
@@ -1623,6 +2129,32 @@ inf_adopted_session_class_init(InfAdoptedSessionClass* adopted_session_class)
     )
   );
 
+  /**
+   * InfAdoptedSession:coalesce-interval:
+   *
+   * Time, in milliseconds, for which the host of a session holds back
+   * requests that do not affect the buffer, such as caret and selection
+   * changes, before forwarding them to other subscribed connections. If
+   * another such request of the same user arrives in the meanwhile, only
+   * the latest one is forwarded. Requests that affect the buffer cause held
+   * back requests to be forwarded first, so that positions remain valid.
+   * 0 means that all requests are forwarded immediately.
+   */
+  g_object_class_install_property(
+    object_class,
+    PROP_COALESCE_INTERVAL,
+    g_param_spec_uint(
+      "coalesce-interval",
+      "Coalesce interval",
+      "Time in milliseconds for which requests that do not affect the "
+      "buffer are held back before being forwarded",
+      0,
+      G_MAXUINT,
+      0,
+      G_PARAM_READWRITE
+    )
+  );
+
   g_object_class_install_property(
     object_class,
     PROP_ALGORITHM,
@@ -1720,6 +2252,9 @@ inf_adopted_session_undo(InfAdoptedSession* session,
 
   priv = INF_ADOPTED_SESSION_PRIVATE(session);
 
+  /* Held back modifications need to be known before they can be undone */
+  inf_session_flush(INF_SESSION(session));
+
   first_request = NULL;
   for(i = 0; i < n; ++i)
   {
@@ -1777,6 +2312,7 @@ inf_adopted_session_redo(InfAdoptedSession* session,
   g_return_if_fail(n >= 1);
 
   priv = INF_ADOPTED_SESSION_PRIVATE(session);
+  inf_session_flush(INF_SESSION(session));
 
   first_request = NULL;
   for(i = 0; i < n; ++i)
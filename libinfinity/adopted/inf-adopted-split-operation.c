@@ -26,7 +26,8 @@
  * #InfAdoptedSplitOperation is a wrapper around that two
  * #InfAdoptedOperation<!-- -->s. This is normally not required directly but
  * may be a result of some transformation. It can also be used to atomically
- * perform multiple operations at once.
+ * perform multiple operations at once, see
+ * inf_adopted_split_operation_new_multiple().
  *
  * If A denotes the first operation of the split operation and B denotes
  * the second operation, the split operation applies first A and then B to
@@ -103,6 +104,45 @@ inf_adopted_split_operation_unsplit_impl(InfAdoptedSplitOperation* operation,
   }
 }
 
+/* Wraps the given operations into a tree of split operations. The tree is
+ * kept balanced, so that transforming against it, which recurses into both
+ * halves of each split operation, only recurses logarithmically deep in the
+ * number of operations. */
+static InfAdoptedOperation*
+inf_adopted_split_operation_new_tree(InfAdoptedOperation* const* operations,
+                                     guint n_operations)
+{
+  InfAdoptedOperation* first;
+  InfAdoptedOperation* second;
+  InfAdoptedOperation* result;
+
+  g_assert(n_operations > 0);
+
+  if(n_operations == 1)
+  {
+    g_object_ref(operations[0]);
+    return operations[0];
+  }
+
+  first = inf_adopted_split_operation_new_tree(
+    operations,
+    n_operations / 2
+  );
+
+  second = inf_adopted_split_operation_new_tree(
+    operations + n_operations / 2,
+    n_operations - n_operations / 2
+  );
+
+  result = INF_ADOPTED_OPERATION(
+    inf_adopted_split_operation_new(first, second)
+  );
+
+  g_object_unref(first);
+  g_object_unref(second);
+  return result;
+}
+
 static void
 inf_adopted_split_operation_init(InfAdoptedSplitOperation* operation)
 {
@@ -568,6 +608,42 @@ inf_adopted_split_operation_new(InfAdoptedOperation* first,
   return INF_ADOPTED_SPLIT_OPERATION(object);
 }
 
+/**
+ * inf_adopted_split_operation_new_multiple: (constructor)
+ * @operations: (array length=n_operations): The #InfAdoptedOperation<!-- -->s
+ * to be wrapped.
+ * @n_operations: The number of operations in @operations, at least 2.
+ *
+ * Creates a new #InfAdoptedSplitOperation which performs all of the given
+ * operations atomically, in the given order. Each operation is expected to
+ * be relative to the document with all previous operations in @operations
+ * applied. This can be used to make a change at many places of the document
+ * at once, such as a search and replace, with a single request that is
+ * transformed as one unit and undone in a single step.
+ *
+ * This is equivalent to nesting calls to inf_adopted_split_operation_new(),
+ * but the resulting split operations are arranged such that transformation
+ * does not recurse more deeply than necessary.
+ *
+ * Returns: (transfer full): A new #InfAdoptedSplitOperation.
+ **/
+InfAdoptedSplitOperation*
+inf_adopted_split_operation_new_multiple(InfAdoptedOperation* const* operations,
+                                         guint n_operations)
+{
+  guint i;
+
+  g_return_val_if_fail(operations != NULL, NULL);
+  g_return_val_if_fail(n_operations >= 2, NULL);
+
+  for(i = 0; i < n_operations; ++i)
+    g_return_val_if_fail(INF_ADOPTED_IS_OPERATION(operations[i]), NULL);
+
+  return INF_ADOPTED_SPLIT_OPERATION(
+    inf_adopted_split_operation_new_tree(operations, n_operations)
+  );
+}
+
 /**
  * inf_adopted_split_operation_unsplit:
  * @operation: A #InfAdoptedSplitOperation.
@@ -64,6 +64,10 @@ InfAdoptedSplitOperation*
 inf_adopted_split_operation_new(InfAdoptedOperation* first,
                                 InfAdoptedOperation* second);
 
+InfAdoptedSplitOperation*
+inf_adopted_split_operation_new_multiple(InfAdoptedOperation* const* operations,
+                                         guint n_operations);
+
 GSList*
 inf_adopted_split_operation_unsplit(InfAdoptedSplitOperation* operation);
 
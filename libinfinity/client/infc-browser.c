@@ -43,6 +43,7 @@
 #include <libinfinity/inf-i18n.h>
 #include <libinfinity/inf-signals.h>
 
+#include <stdlib.h>
 #include <string.h>
 
 /* Some Windows header #defines error for no good */
@@ -4058,6 +4059,107 @@ infc_browser_handle_add_acl_account(InfcBrowser* browser,
   return TRUE;
 }
 
+static gboolean
+infc_browser_handle_query_acl_account_range(InfcBrowser* browser,
+                                            InfXmlConnection* connection,
+                                            xmlNodePtr xml,
+                                            GError** error)
+{
+  InfcBrowserPrivate* priv;
+  InfcRequest* request;
+  xmlNodePtr child;
+  xmlChar* next_attr;
+  InfAclAccountId next;
+
+  GArray* result;
+  InfAclAccount* account;
+  InfAclAccount* existing_account;
+
+  priv = INFC_BROWSER_PRIVATE(browser);
+
+  request = infc_request_manager_get_request_by_xml_required(
+    priv->request_manager,
+    "query-acl-account-range",
+    xml,
+    error
+  );
+
+  if(request == NULL) return FALSE;
+
+  next = 0;
+  next_attr = inf_xml_util_get_attribute(xml, "next");
+  if(next_attr != NULL)
+  {
+    next = inf_acl_account_id_from_string((const gchar*)next_attr);
+    xmlFree(next_attr);
+  }
+
+  /* Note that the result array does not own the account names, they are
+   * owned by our account cache. */
+  result = g_array_new(FALSE, FALSE, sizeof(InfAclAccount));
+  for(child = xml->children; child != NULL; child = child->next)
+  {
+    if(child->type != XML_ELEMENT_NODE) continue;
+    if(strcmp((const gchar*)child->name, "account") != 0) continue;
+
+    account = inf_acl_account_from_xml(child, error);
+    if(account == NULL)
+    {
+      g_array_free(result, TRUE);
+      return FALSE;
+    }
+
+    existing_account = g_hash_table_lookup(
+      priv->accounts,
+      INF_ACL_ACCOUNT_ID_TO_POINTER(account->id)
+    );
+
+    if(existing_account != NULL)
+    {
+      /* Update account name, if it has changed */
+      if(strcmp(existing_account->name, account->name) != 0)
+      {
+        g_free(existing_account->name);
+        existing_account->name = g_strdup(account->name);
+      }
+
+      inf_acl_account_free(account);
+    }
+    else
+    {
+      g_hash_table_insert(
+        priv->accounts,
+        INF_ACL_ACCOUNT_ID_TO_POINTER(account->id),
+        account
+      );
+
+      inf_browser_acl_account_added(
+        INF_BROWSER(browser),
+        account,
+        INF_REQUEST(request)
+      );
+
+      existing_account = account;
+    }
+
+    g_array_append_val(result, *existing_account);
+  }
+
+  infc_request_manager_finish_request(
+    priv->request_manager,
+    request,
+    inf_request_result_make_query_acl_account_range(
+      INF_BROWSER(browser),
+      (InfAclAccount*)result->data,
+      result->len,
+      next
+    )
+  );
+
+  g_array_free(result, TRUE);
+  return TRUE;
+}
+
 static gboolean
 infc_browser_handle_lookup_acl_accounts(InfcBrowser* browser,
                                         InfXmlConnection* connection,
@@ -5139,6 +5241,15 @@ infc_browser_communication_object_received(InfCommunicationObject* object,
       &local_error
     );
   }
+  else if(strcmp((const gchar*)node->name, "query-acl-account-range") == 0)
+  {
+    infc_browser_handle_query_acl_account_range(
+      browser,
+      connection,
+      node,
+      &local_error
+    );
+  }
   else if(strcmp((const gchar*)node->name, "lookup-acl-accounts") == 0)
   {
     infc_browser_handle_lookup_acl_accounts(
@@ -6301,6 +6412,121 @@ infc_browser_browser_get_acl_local_account(InfBrowser* infbrowser)
   return priv->local_account;
 }
 
+static int
+infc_browser_account_compare_func(gconstpointer first,
+                                  gconstpointer second)
+{
+  return inf_acl_account_id_compare(
+    ((const InfAclAccount*)first)->id,
+    ((const InfAclAccount*)second)->id
+  );
+}
+
+static InfRequest*
+infc_browser_browser_query_acl_account_range(InfBrowser* infbrowser,
+                                             const gchar* prefix,
+                                             InfAclAccountId after,
+                                             guint max,
+                                             InfRequestFunc func,
+                                             gpointer user_data)
+{
+  InfcBrowser* browser;
+  InfcBrowserPrivate* priv;
+  InfcRequest* request;
+  xmlNodePtr xml;
+
+  InfAclAccount* accounts;
+  guint n_accounts;
+  gsize prefix_len;
+  InfAclAccountId next;
+  guint i;
+  guint n;
+
+  browser = INFC_BROWSER(infbrowser);
+  priv = INFC_BROWSER_PRIVATE(browser);
+
+  g_return_val_if_fail(priv->status == INF_BROWSER_OPEN, NULL);
+
+  request = infc_request_manager_add_request(
+    priv->request_manager,
+    INFC_TYPE_REQUEST,
+    "query-acl-account-range",
+    G_CALLBACK(func),
+    user_data,
+    NULL
+  );
+
+  inf_browser_begin_request(infbrowser, NULL, INF_REQUEST(request));
+
+  if(priv->account_list_status != INFC_BROWSER_ACCOUNT_LIST_NOTIFICATIONS)
+  {
+    xml = infc_browser_request_to_xml(request);
+
+    if(prefix != NULL && *prefix != '\0')
+      inf_xml_util_set_attribute(xml, "prefix", prefix);
+    if(after != 0)
+    {
+      inf_xml_util_set_attribute(
+        xml,
+        "after",
+        inf_acl_account_id_to_string(after)
+      );
+    }
+
+    inf_xml_util_set_attribute_uint(xml, "max", max);
+
+    inf_communication_group_send_message(
+      INF_COMMUNICATION_GROUP(priv->group),
+      priv->connection,
+      xml
+    );
+
+    return INF_REQUEST(request);
+  }
+
+  /* Our cache is up to date, i.e. serve from cache */
+  accounts = infc_browser_make_acl_account_list(browser, &n_accounts);
+
+  prefix_len = (prefix != NULL) ? strlen(prefix) : 0;
+  n = 0;
+  for(i = 0; i < n_accounts; ++i)
+  {
+    if(inf_acl_account_id_compare(accounts[i].id, after) <= 0)
+      continue;
+    if(prefix_len > 0 &&
+       (accounts[i].name == NULL ||
+        strncmp(accounts[i].name, prefix, prefix_len) != 0))
+    {
+      continue;
+    }
+
+    accounts[n++] = accounts[i];
+  }
+
+  qsort(accounts, n, sizeof(InfAclAccount), infc_browser_account_compare_func);
+
+  next = 0;
+  if(n > max)
+  {
+    n = max;
+    next = accounts[max - 1].id;
+  }
+
+  infc_request_manager_finish_request(
+    priv->request_manager,
+    request,
+    inf_request_result_make_query_acl_account_range(
+      infbrowser,
+      accounts,
+      n,
+      next
+    )
+  );
+
+  g_free(accounts);
+  return NULL;
+}
+
 static InfRequest*
 infc_browser_browser_lookup_acl_accounts(InfBrowser* infbrowser,
                                          const InfAclAccountId* ids,
@@ -6918,6 +7144,8 @@ infc_browser_browser_iface_init(InfBrowserInterface* iface)
   iface->get_acl_default_account = infc_browser_browser_get_acl_default_account;
   iface->get_acl_local_account = infc_browser_browser_get_acl_local_account;
   iface->query_acl_account_list = infc_browser_browser_query_acl_account_list;
+  iface->query_acl_account_range =
+    infc_browser_browser_query_acl_account_range;
   iface->lookup_acl_accounts = infc_browser_browser_lookup_acl_accounts;
   iface->lookup_acl_account_by_name =
     infc_browser_browser_lookup_acl_account_by_name;
@@ -211,6 +211,31 @@ inf_acl_account_id_from_string(const gchar* id)
   return g_quark_from_string(id);
 }
 
+/**
+ * inf_acl_account_id_compare:
+ * @first: A #InfAclAccountId.
+ * @second: Another #InfAclAccountId.
+ *
+ * Compares two account IDs by their string representation. This defines a
+ * total order on account IDs which does not depend on the order in which
+ * the IDs have been created, and can therefore be used to communicate a
+ * position in a sorted list of accounts between different hosts. The ID 0
+ * sorts before any other ID.
+ *
+ * Returns: A negative value if @first sorts before @second, zero if they
+ * are equal, or a positive value if @first sorts after @second.
+ */
+gint
+inf_acl_account_id_compare(InfAclAccountId first,
+                           InfAclAccountId second)
+{
+  if(first == second) return 0;
+  if(first == 0) return -1;
+  if(second == 0) return 1;
+
+  return strcmp(g_quark_to_string(first), g_quark_to_string(second));
+}
+
 /**
  * inf_acl_account_new:
  * @id: The unique ID of the new account.
@@ -204,6 +204,10 @@ inf_acl_account_id_to_string(InfAclAccountId account);
 InfAclAccountId
 inf_acl_account_id_from_string(const gchar* id);
 
+gint
+inf_acl_account_id_compare(InfAclAccountId first,
+                           InfAclAccountId second);
+
 InfAclAccount*
 inf_acl_account_new(InfAclAccountId id,
                     const gchar* name);
@@ -1196,6 +1196,68 @@ inf_browser_query_acl_account_list(InfBrowser* browser,
   return iface->query_acl_account_list(browser, func, user_data);
 }
 
+/**
+ * inf_browser_query_acl_account_range:
+ * @browser: A #InfBrowser.
+ * @prefix: (allow-none): Only list accounts whose name starts with this
+ * string, or %NULL.
+ * @after: Only list accounts whose ID sorts after this ID, or 0 to start at
+ * the beginning of the list.
+ * @max: The maximum number of accounts to return. The browser may return
+ * fewer accounts than this even if more are available.
+ * @func: (scope async): The function to be called when the request finishes,
+ * or %NULL.
+ * @user_data: Additional data to pass to @func.
+ *
+ * Queries a part of the list of accounts in @browser. This is a variant of
+ * inf_browser_query_acl_account_list() which does not require the full
+ * account list to be transferred at once, and should be preferred when the
+ * number of accounts can be large.
+ *
+ * The accounts in the request result are ordered as defined by
+ * inf_acl_account_id_compare(). If the result does not contain all matching
+ * accounts, then the ID of the account at which to continue is part of the
+ * request result, and can be passed as @after to a subsequent call of this
+ * function to obtain the next chunk. Otherwise, it is 0.
+ *
+ * Unlike inf_browser_query_acl_account_list(), this function does not
+ * enable notification of added and removed accounts.
+ *
+ * The request might either finish during the call to this function, in which
+ * case @func will be called and %NULL being returned. If the request does not
+ * finish within the function call, a #InfRequest object is returned, where
+ * @func has been installed for the #InfRequest::finished signal, so that it
+ * is called as soon as the request finishes.
+ *
+ * Returns: (transfer none) (allow-none): A #InfRequest that can be used to
+ * be notified when the request finishes, or %NULL.
+ */
+InfRequest*
+inf_browser_query_acl_account_range(InfBrowser* browser,
+                                    const gchar* prefix,
+                                    InfAclAccountId after,
+                                    guint max,
+                                    InfRequestFunc func,
+                                    gpointer user_data)
+{
+  InfBrowserInterface* iface;
+
+  g_return_val_if_fail(INF_IS_BROWSER(browser), NULL);
+  g_return_val_if_fail(max > 0, NULL);
+
+  iface = INF_BROWSER_GET_IFACE(browser);
+  g_return_val_if_fail(iface->query_acl_account_range != NULL, NULL);
+
+  return iface->query_acl_account_range(
+    browser,
+    prefix,
+    after,
+    max,
+    func,
+    user_data
+  );
+}
+
 /**
  * inf_browser_lookup_acl_accounts:
  * @browser: A #InfBrowser.
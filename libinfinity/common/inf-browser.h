@@ -125,6 +125,8 @@ typedef enum _InfBrowserStatus {
  * or is otherwise available.
  * @get_acl: Virtual function for obtaining the full ACL for a node.
  * @set_acl: Virtual function for changing the ACL for one node.
+ * @query_acl_account_range: Virtual function for querying a bounded,
+ * filtered part of the list of accounts.
  *
  * Signals and virtual functions for the #InfBrowser interface.
  */
@@ -282,6 +284,15 @@ struct _InfBrowserInterface {
                          const InfAclSheetSet* sheet_set,
                          InfRequestFunc func,
                          gpointer user_data);
+
+  /* New entries are added at the end so that the layout of the structure
+   * stays compatible. */
+  InfRequest* (*query_acl_account_range)(InfBrowser* browser,
+                                         const gchar* prefix,
+                                         InfAclAccountId after,
+                                         guint max,
+                                         InfRequestFunc func,
+                                         gpointer user_data);
 };
 
 GType
@@ -402,6 +413,14 @@ inf_browser_query_acl_account_list(InfBrowser* browser,
                                    InfRequestFunc func,
                                    gpointer user_data);
 
+InfRequest*
+inf_browser_query_acl_account_range(InfBrowser* browser,
+                                    const gchar* prefix,
+                                    InfAclAccountId after,
+                                    guint max,
+                                    InfRequestFunc func,
+                                    gpointer user_data);
+
 InfRequest*
 inf_browser_lookup_acl_accounts(InfBrowser* browser,
                                 const InfAclAccountId* ids,
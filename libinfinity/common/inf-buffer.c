@@ -111,4 +111,29 @@ inf_buffer_set_modified(InfBuffer* buffer,
   }
 }
 
+/**
+ * inf_buffer_get_memory_usage:
+ * @buffer: A #InfBuffer.
+ *
+ * Returns an estimate of the amount of memory, in bytes, that the content
+ * of @buffer occupies. The value is approximate and is meant to be used to
+ * decide which sessions to unload when the server runs short of memory. If
+ * the buffer implementation does not provide an estimate, 0 is returned.
+ *
+ * Returns: The approximate memory usage of @buffer, in bytes.
+ */
+gsize
+inf_buffer_get_memory_usage(InfBuffer* buffer)
+{
+  InfBufferInterface* iface;
+
+  g_return_val_if_fail(INF_IS_BUFFER(buffer), 0);
+
+  iface = INF_BUFFER_GET_IFACE(buffer);
+  if(iface->get_memory_usage == NULL)
+    return 0;
+
+  return iface->get_memory_usage(buffer);
+}
+
 /* vim:set et sw=2 ts=2: */
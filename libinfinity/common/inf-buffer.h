@@ -37,6 +37,9 @@ typedef struct _InfBufferInterface InfBufferInterface;
  * @get_modified: Returns whether the buffer has been modified since the last
  * call to @set_modified set modified flag to %FALSE.
  * @set_modified: Set the current modified state of the buffer.
+ * @get_memory_usage: Returns an estimate of the number of bytes the buffer
+ * content occupies in memory, or 0 if the buffer cannot tell. This function
+ * is optional.
  *
  * The virtual methods of #InfBuffer.
  */
@@ -49,6 +52,8 @@ struct _InfBufferInterface {
 
   void (*set_modified)(InfBuffer* buffer,
                        gboolean modified);
+
+  gsize (*get_memory_usage)(InfBuffer* buffer);
 };
 
 /**
@@ -68,6 +73,9 @@ void
 inf_buffer_set_modified(InfBuffer* buffer,
                         gboolean modified);
 
+gsize
+inf_buffer_get_memory_usage(InfBuffer* buffer);
+
 G_END_DECLS
 
 #endif /* __INF_BUFFER_H__ */
@@ -27,17 +27,40 @@
  *
  * This is a thin wrapper class for #gnutls_certificate_credentials_t. It
  * provides reference counting and a boxed GType for it.
+ *
+ * In addition, it holds the state that is needed to resume TLS sessions
+ * without a full handshake: on the server side, the key with which session
+ * tickets are encrypted, and on the client side, the most recent session of
+ * each host. #InfXmppConnection makes use of this automatically, so all
+ * connections sharing the same credentials can resume each other's
+ * sessions.
  **/
 
 #include <libinfinity/common/inf-certificate-credentials.h>
+#include <libinfinity/common/inf-error.h>
+
+#include <string.h>
 
 G_DEFINE_BOXED_TYPE(InfCertificateCredentials, inf_certificate_credentials, inf_certificate_credentials_ref, inf_certificate_credentials_unref)
 
 struct _InfCertificateCredentials {
   guint ref_count;
   gnutls_certificate_credentials_t creds;
+
+  gnutls_datum_t ticket_key;
+  GHashTable* sessions; /* hostname -> gnutls_datum_t* */
 };
 
+static void
+inf_certificate_credentials_free_datum(gpointer data)
+{
+  gnutls_datum_t* datum;
+  datum = (gnutls_datum_t*)data;
+
+  gnutls_free(datum->data);
+  g_slice_free(gnutls_datum_t, datum);
+}
+
 /**
  * inf_certificate_credentials_new:
  *
@@ -57,6 +80,16 @@ inf_certificate_credentials_new(void)
   creds->ref_count = 1;
   gnutls_certificate_allocate_credentials(&creds->creds);
 
+  creds->ticket_key.data = NULL;
+  creds->ticket_key.size = 0;
+
+  creds->sessions = g_hash_table_new_full(
+    g_str_hash,
+    g_str_equal,
+    g_free,
+    inf_certificate_credentials_free_datum
+  );
+
   return creds;
 }
 
@@ -89,6 +122,13 @@ inf_certificate_credentials_unref(InfCertificateCredentials* creds)
   g_return_if_fail(creds != NULL);
   if(!--creds->ref_count)
   {
+    if(creds->ticket_key.data != NULL)
+    {
+      memset(creds->ticket_key.data, 0, creds->ticket_key.size);
+      gnutls_free(creds->ticket_key.data);
+    }
+
+    g_hash_table_destroy(creds->sessions);
     gnutls_certificate_free_credentials(creds->creds);
     g_slice_free(InfCertificateCredentials, creds);
   }
@@ -110,4 +150,187 @@ inf_certificate_credentials_get(InfCertificateCredentials* creds)
   return creds->creds;
 }
 
+/**
+ * inf_certificate_credentials_rotate_session_ticket_key:
+ * @creds: A #InfCertificateCredentials.
+ * @error: Location to store error information, if any, or %NULL.
+ *
+ * Generates a new random key with which the server encrypts TLS session
+ * tickets, and replaces the previous one, if any. Server-side connections
+ * that use @creds and that are created afterwards hand out session tickets
+ * to clients, which allows clients to resume their session later without a
+ * full handshake.
+ *
+ * Tickets that were issued with the previous key can no longer be used, so
+ * rotating the key regularly limits the time during which a compromised
+ * ticket key allows to decrypt recorded traffic, at the cost of a full
+ * handshake for clients that reconnect after the rotation.
+ *
+ * Returns: %TRUE on success, or %FALSE if the key could not be generated.
+ */
+gboolean
+inf_certificate_credentials_rotate_session_ticket_key(
+  InfCertificateCredentials* creds,
+  GError** error)
+{
+  gnutls_datum_t key;
+  int res;
+
+  g_return_val_if_fail(creds != NULL, FALSE);
+  g_return_val_if_fail(error == NULL || *error == NULL, FALSE);
+
+  res = gnutls_session_ticket_key_generate(&key);
+  if(res != GNUTLS_E_SUCCESS)
+  {
+    inf_gnutls_set_error(error, res);
+    return FALSE;
+  }
+
+  /* gnutls copies the key into each session, so existing sessions are not
+   * affected by this. */
+  inf_certificate_credentials_clear_session_ticket_key(creds);
+  creds->ticket_key = key;
+  return TRUE;
+}
+
+/**
+ * inf_certificate_credentials_clear_session_ticket_key:
+ * @creds: A #InfCertificateCredentials.
+ *
+ * Removes the session ticket key of @creds, so that server-side connections
+ * created afterwards do no longer hand out session tickets.
+ */
+void
+inf_certificate_credentials_clear_session_ticket_key(
+  InfCertificateCredentials* creds)
+{
+  g_return_if_fail(creds != NULL);
+
+  if(creds->ticket_key.data != NULL)
+  {
+    memset(creds->ticket_key.data, 0, creds->ticket_key.size);
+    gnutls_free(creds->ticket_key.data);
+
+    creds->ticket_key.data = NULL;
+    creds->ticket_key.size = 0;
+  }
+}
+
+/**
+ * inf_certificate_credentials_get_session_ticket_key:
+ * @creds: A #InfCertificateCredentials.
+ *
+ * Returns the key with which session tickets are encrypted, as set by
+ * inf_certificate_credentials_rotate_session_ticket_key(), or %NULL if
+ * session tickets are not enabled for @creds.
+ *
+ * Returns: (transfer none) (allow-none): The session ticket key, or %NULL.
+ */
+const gnutls_datum_t*
+inf_certificate_credentials_get_session_ticket_key(
+  InfCertificateCredentials* creds)
+{
+  g_return_val_if_fail(creds != NULL, NULL);
+
+  if(creds->ticket_key.data == NULL)
+    return NULL;
+
+  return &creds->ticket_key;
+}
+
+/**
+ * inf_certificate_credentials_store_session:
+ * @creds: A #InfCertificateCredentials.
+ * @hostname: The name of the host @session is connected to.
+ * @session: A client-side #gnutls_session_t whose handshake has finished.
+ *
+ * Remembers the parameters of @session, so that a later connection to
+ * @hostname can resume it with inf_certificate_credentials_restore_session().
+ * A previously stored session for @hostname is replaced. If @session cannot
+ * be resumed, then nothing is stored.
+ */
+void
+inf_certificate_credentials_store_session(InfCertificateCredentials* creds,
+                                          const gchar* hostname,
+                                          gnutls_session_t session)
+{
+  gnutls_datum_t* datum;
+  int res;
+
+  g_return_if_fail(creds != NULL);
+  g_return_if_fail(hostname != NULL);
+  g_return_if_fail(session != NULL);
+
+  datum = g_slice_new(gnutls_datum_t);
+  res = gnutls_session_get_data2(session, datum);
+
+  if(res != GNUTLS_E_SUCCESS || datum->size == 0)
+  {
+    if(res == GNUTLS_E_SUCCESS)
+      gnutls_free(datum->data);
+    g_slice_free(gnutls_datum_t, datum);
+    return;
+  }
+
+  g_hash_table_insert(creds->sessions, g_strdup(hostname), datum);
+}
+
+/**
+ * inf_certificate_credentials_restore_session:
+ * @creds: A #InfCertificateCredentials.
+ * @hostname: The name of the host @session is going to connect to.
+ * @session: A client-side #gnutls_session_t before its handshake.
+ *
+ * If a session to @hostname has been stored with
+ * inf_certificate_credentials_store_session(), then this function sets up
+ * @session to resume it. The server can still decide to perform a full
+ * handshake, for example if it has rotated its session ticket key.
+ *
+ * Returns: Whether a stored session for @hostname was found.
+ */
+gboolean
+inf_certificate_credentials_restore_session(InfCertificateCredentials* creds,
+                                            const gchar* hostname,
+                                            gnutls_session_t session)
+{
+  gnutls_datum_t* datum;
+  int res;
+
+  g_return_val_if_fail(creds != NULL, FALSE);
+  g_return_val_if_fail(hostname != NULL, FALSE);
+  g_return_val_if_fail(session != NULL, FALSE);
+
+  datum = g_hash_table_lookup(creds->sessions, hostname);
+  if(datum == NULL)
+    return FALSE;
+
+  res = gnutls_session_set_data(session, datum->data, datum->size);
+  if(res != GNUTLS_E_SUCCESS)
+  {
+    /* The stored data is unusable, so do not try again */
+    g_hash_table_remove(creds->sessions, hostname);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/**
+ * inf_certificate_credentials_forget_session:
+ * @creds: A #InfCertificateCredentials.
+ * @hostname: A host name.
+ *
+ * Removes the stored session for @hostname, if any, so that the next
+ * connection to @hostname performs a full handshake.
+ */
+void
+inf_certificate_credentials_forget_session(InfCertificateCredentials* creds,
+                                           const gchar* hostname)
+{
+  g_return_if_fail(creds != NULL);
+  g_return_if_fail(hostname != NULL);
+
+  g_hash_table_remove(creds->sessions, hostname);
+}
+
 /* vim:set et sw=2 ts=2: */
@@ -52,6 +52,33 @@ inf_certificate_credentials_unref(InfCertificateCredentials* creds);
 gnutls_certificate_credentials_t
 inf_certificate_credentials_get(InfCertificateCredentials* creds);
 
+gboolean
+inf_certificate_credentials_rotate_session_ticket_key(
+  InfCertificateCredentials* creds,
+  GError** error);
+
+void
+inf_certificate_credentials_clear_session_ticket_key(
+  InfCertificateCredentials* creds);
+
+const gnutls_datum_t*
+inf_certificate_credentials_get_session_ticket_key(
+  InfCertificateCredentials* creds);
+
+void
+inf_certificate_credentials_store_session(InfCertificateCredentials* creds,
+                                          const gchar* hostname,
+                                          gnutls_session_t session);
+
+gboolean
+inf_certificate_credentials_restore_session(InfCertificateCredentials* creds,
+                                            const gchar* hostname,
+                                            gnutls_session_t session);
+
+void
+inf_certificate_credentials_forget_session(InfCertificateCredentials* creds,
+                                           const gchar* hostname);
+
 G_END_DECLS
 
 #endif /* __INF_CERTIFICATE_CREDENTIALS_H__ */
@@ -447,6 +447,28 @@ inf_chat_buffer_buffer_set_modified(InfBuffer* buffer,
   }
 }
 
+static gsize
+inf_chat_buffer_buffer_get_memory_usage(InfBuffer* buffer)
+{
+  InfChatBufferPrivate* priv;
+  gsize usage;
+  guint i;
+
+  priv = INF_CHAT_BUFFER_PRIVATE(buffer);
+  usage = sizeof(InfChatBuffer) +
+    priv->alloc_messages * sizeof(InfChatBufferMessage);
+
+  for(i = 0; i < priv->num_messages; ++i)
+  {
+    usage += inf_chat_buffer_get_message(
+      INF_CHAT_BUFFER(buffer),
+      i
+    )->length;
+  }
+
+  return usage;
+}
+
 /*
  * GType registration
  */
@@ -504,6 +526,7 @@ inf_chat_buffer_buffer_iface_init(InfBufferInterface* iface)
 {
   iface->get_modified = inf_chat_buffer_buffer_get_modified;
   iface->set_modified = inf_chat_buffer_buffer_set_modified;
+  iface->get_memory_usage = inf_chat_buffer_buffer_get_memory_usage;
 }
 
 /*
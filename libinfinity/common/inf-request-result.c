@@ -598,6 +598,87 @@ inf_request_result_get_query_acl_account_list(const InfRequestResult* result,
     *does_notifications = data->does_notifications;
 }
 
+typedef struct _InfRequestResultQueryAclAccountRange
+  InfRequestResultQueryAclAccountRange;
+struct _InfRequestResultQueryAclAccountRange {
+  InfBrowser* browser;
+  const InfAclAccount* accounts;
+  guint n_accounts;
+  InfAclAccountId next;
+};
+
+/**
+ * inf_request_result_make_query_acl_account_range:
+ * @browser: A #InfBrowser.
+ * @accounts: (array length=n_accounts): The list of accounts.
+ * @n_accounts: The number of items in the account list.
+ * @next: The ID of the last account in @accounts if there are more accounts
+ * to be queried, or 0.
+ *
+ * Creates a new #InfRequestResult for a "query-acl-account-range" request,
+ * see inf_browser_query_acl_account_range(). The #InfRequestResult object is
+ * only valid as long as the caller maintains a reference to @browser.
+ *
+ * Returns: (transfer full): A new #InfRequestResult. Free with
+ * inf_request_result_free().
+ */
+InfRequestResult*
+inf_request_result_make_query_acl_account_range(InfBrowser* browser,
+                                                const InfAclAccount* accounts,
+                                                guint n_accounts,
+                                                InfAclAccountId next)
+{
+  InfRequestResultQueryAclAccountRange* data;
+
+  g_return_val_if_fail(INF_IS_BROWSER(browser), NULL);
+
+  data = g_malloc(sizeof(InfRequestResultQueryAclAccountRange));
+
+  data->browser = browser;
+  data->accounts = accounts;
+  data->n_accounts = n_accounts;
+  data->next = next;
+
+  return inf_request_result_new(data, sizeof(*data));
+}
+
+/**
+ * inf_request_result_get_query_acl_account_range:
+ * @result: A #InfRequestResult:
+ * @browser: (out) (transfer none) (allow-none): Output value of the browser
+ * that made the request, or %NULL.
+ * @accounts: (out) (array length=n_accounts) (transfer none) (allow-none):
+ * Output value for the list of accounts, or %NULL.
+ * @n_accounts: (out) (transfer none) (allow-none): Output value for the size
+ * of the account list, or %NULL.
+ * @next: (out) (allow-none): Output value for the account ID at which to
+ * continue the query, or %NULL. This is 0 if there are no more accounts.
+ *
+ * Decomposes @result into its components. The object must have been created
+ * with inf_request_result_make_query_acl_account_range().
+ */
+void
+inf_request_result_get_query_acl_account_range(const InfRequestResult* result,
+                                               InfBrowser** browser,
+                                               const InfAclAccount** accounts,
+                                               guint* n_accounts,
+                                               InfAclAccountId* next)
+{
+  const InfRequestResultQueryAclAccountRange* data;
+
+  g_return_if_fail(result != NULL);
+  g_return_if_fail(
+    result->len == sizeof(InfRequestResultQueryAclAccountRange)
+  );
+
+  data = (const InfRequestResultQueryAclAccountRange*)result->data;
+
+  if(browser != NULL) *browser = data->browser;
+  if(accounts != NULL) *accounts = data->accounts;
+  if(n_accounts != NULL) *n_accounts = data->n_accounts;
+  if(next != NULL) *next = data->next;
+}
+
 typedef struct _InfRequestResultLookupAclAccounts
   InfRequestResultLookupAclAccounts;
 struct _InfRequestResultLookupAclAccounts {
@@ -118,6 +118,19 @@ inf_request_result_get_query_acl_account_list(const InfRequestResult* result,
                                               guint* n_accounts,
                                               gboolean* does_notifications);
 
+InfRequestResult*
+inf_request_result_make_query_acl_account_range(InfBrowser* browser,
+                                                const InfAclAccount* accounts,
+                                                guint n_accounts,
+                                                InfAclAccountId next);
+
+void
+inf_request_result_get_query_acl_account_range(const InfRequestResult* result,
+                                               InfBrowser** browser,
+                                               const InfAclAccount** accounts,
+                                               guint* n_accounts,
+                                               InfAclAccountId* next);
+
 InfRequestResult*
 inf_request_result_make_lookup_acl_accounts(InfBrowser* browser,
                                             const InfAclAccount* accounts,
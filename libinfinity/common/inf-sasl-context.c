@@ -31,12 +31,19 @@
  * function sets the requested property before returning, which makes it hard
  * to give control back to a main loop while waiting for user input.
  *
- * This wrapper makes sure the callback is called in another thread so that it
- * can block without affecting the rest of the program.
+ * This wrapper makes sure the SASL processing happens in another thread so
+ * that it can block without affecting the rest of the program.
  * Use inf_sasl_context_session_feed() as a replacement for gsasl_step64().
  * Instead of returning the result data directly, the function calls a
  * callback once all properties requested have been provided.
  *
+ * The processing is done by a small pool of worker threads shared by all
+ * sessions of a context, so that many concurrent authentications do not
+ * require as many threads. The number of workers and the number of
+ * sessions waiting for a worker can be limited with
+ * inf_sasl_context_set_worker_limits(). When the limit of waiting sessions
+ * is reached, new sessions are refused until the backlog has been processed.
+ *
  * All threading internals are hidden by the wrapper, so all callbacks are
  * issued in the user thread. However, it requires an #InfIo object to
  * dispatch messages to it. Also, all #InfSaslContext functions are fully
@@ -46,6 +53,7 @@
 #include <libinfinity/common/inf-sasl-context.h>
 #include <libinfinity/common/inf-standalone-io.h>
 #include <libinfinity/common/inf-error.h>
+#include <libinfinity/inf-i18n.h>
 
 #include <string.h>
 
@@ -55,7 +63,6 @@ typedef enum _InfSaslContextMessageType {
   /* main -> session */
   INF_SASL_CONTEXT_MESSAGE_TERMINATE,
   INF_SASL_CONTEXT_MESSAGE_CONTINUE,
-  INF_SASL_CONTEXT_MESSAGE_STEP,
 
   /* session -> main */
   INF_SASL_CONTEXT_MESSAGE_QUERY, /* invoke callback to query a property */
@@ -71,6 +78,9 @@ typedef enum _InfSaslContextSessionStatus {
 struct _InfSaslContextSession {
   InfSaslContext* context;
   Gsasl_session* session;
+  /* protects session, so that the sessions of a context can be stepped
+   * concurrently. It is never held together with the context mutex. */
+  GMutex mutex;
   gpointer session_data;
   InfIo* main_io;
   GAsyncQueue* session_queue;
@@ -80,13 +90,25 @@ struct _InfSaslContextSession {
    * need the mutex for this if InfIo would allow to set the
    * InfIoDispatch pointer before executing the dispatch. */
   InfIoDispatch* dispatch;
-  GThread* thread;
   /* This flag tells whether we are currently processing user data in the
    * helper thread. It is meant as a simple indicator in the main thread
    * whether more data can be given to the context or not. */
   gboolean stepping;
-
-  /* used in session thread only */
+  /* Whether a worker thread is currently running gsasl_step64() for this
+   * session, protected by context mutex */
+  gboolean active;
+  /* Set when the session was stopped while a worker was processing it. The
+   * worker frees the session then, protected by context mutex */
+  gboolean detached;
+
+  /* function to call in the main thread when the current step has
+   * finished, protected by context mutex */
+  InfSaslContextSessionResultFunc result_func;
+  gpointer result_user_data;
+  GDestroyNotify result_notify;
+
+  /* set by the main thread before the session is queued for a worker, and
+   * used by the worker thread only afterwards */
   gchar* step64;
   InfSaslContextSessionFeedFunc feed_func;
   gpointer feed_user_data;
@@ -105,12 +127,6 @@ struct _InfSaslContextMessage {
       int retval;
     } cont;
 
-    struct {
-      gchar* data;
-      InfSaslContextSessionFeedFunc func;
-      gpointer user_data;
-    } step;
-
     struct {
       Gsasl_property prop;
     } query;
@@ -130,14 +146,31 @@ struct _InfSaslContext {
   gint ref_count;
 
   GSList* sessions;
+  guint n_sessions;
 
   InfSaslContextCallbackFunc callback;
   gpointer callback_user_data;
   GDestroyNotify callback_notify;
+  /* Whether to call the callback in the worker thread instead of the
+   * main thread */
+  gboolean callback_blocking;
 
-  /* protects the session list, the callback function and access to the
-   * Gsasl object. */
+  /* protects the session list, the callback function, the worker pool,
+   * the session state shared with the main thread and access to the Gsasl
+   * object. The Gsasl sessions are protected by their own mutex. */
   GMutex mutex;
+
+  /* Sessions that were fed data and wait for a worker */
+  GQueue pending;
+  GSList* workers;
+  guint n_workers;
+  guint n_idle_workers;
+  guint max_workers;
+  guint max_pending;
+  gboolean shutdown;
+
+  /* Signalled when a session is queued, or when the pool shuts down */
+  GCond worker_cond;
 };
 
 /*
@@ -166,22 +199,6 @@ inf_sasl_context_message_continue(InfSaslContextSession* session,
   return message;
 }
 
-static InfSaslContextMessage*
-inf_sasl_context_message_step(InfSaslContextSession* session,
-                              const char* data,
-                              InfSaslContextSessionFeedFunc func,
-                              gpointer user_data)
-{
-  InfSaslContextMessage* message;
-  message = g_slice_new(InfSaslContextMessage);
-  message->type = INF_SASL_CONTEXT_MESSAGE_STEP;
-  message->session = session;
-  message->shared.step.data = data ? g_strdup(data) : NULL;
-  message->shared.step.func = func;
-  message->shared.step.user_data = user_data;
-  return message;
-}
-
 static InfSaslContextMessage*
 inf_sasl_context_message_query(InfSaslContextSession* session,
                                Gsasl_property prop)
@@ -224,9 +241,6 @@ inf_sasl_context_message_free(gpointer message_)
   case INF_SASL_CONTEXT_MESSAGE_CONTINUE:
     /* nothing to do */
     break;
-  case INF_SASL_CONTEXT_MESSAGE_STEP:
-    g_free(message->shared.step.data);
-    break;
   case INF_SASL_CONTEXT_MESSAGE_QUERY:
     /* nothing to do */
     break;
@@ -243,7 +257,7 @@ inf_sasl_context_message_free(gpointer message_)
 }
 
 /*
- * Session thread and gsasl callback
+ * Worker threads and gsasl callback
  */
 
 static void
@@ -252,6 +266,9 @@ inf_sasl_context_session_message_func(gpointer user_data)
   InfSaslContextMessage* message;
   InfSaslContextCallbackFunc func;
   gpointer func_user_data;
+  InfSaslContextSessionResultFunc result_func;
+  gpointer result_user_data;
+  GDestroyNotify result_notify;
   gboolean needs_more;
   GError* error;
 
@@ -260,26 +277,14 @@ inf_sasl_context_session_message_func(gpointer user_data)
   switch(message->type)
   {
   case INF_SASL_CONTEXT_MESSAGE_TERMINATE:
-    /* session thread */
+    /* worker thread */
     message->session->status = INF_SASL_CONTEXT_SESSION_TERMINATE;
     break;
   case INF_SASL_CONTEXT_MESSAGE_CONTINUE:
-    /* session thread */
+    /* worker thread */
     g_assert(message->session->status == INF_SASL_CONTEXT_SESSION_INNER);
     message->session->retval = message->shared.cont.retval;
     break;
-  case INF_SASL_CONTEXT_MESSAGE_STEP:
-    /* session thread */
-    g_assert(message->session->status == INF_SASL_CONTEXT_SESSION_OUTER);
-    g_assert(message->shared.step.func != NULL);
-
-    message->session->step64 = message->shared.step.data;
-    message->session->feed_func = message->shared.step.func;
-    message->session->feed_user_data = message->shared.step.user_data;
-    message->shared.step.data = NULL; /* prevent deletion */
-
-    message->session->status = INF_SASL_CONTEXT_SESSION_INNER;
-    break;
   case INF_SASL_CONTEXT_MESSAGE_QUERY:
     /* main thread */
     g_mutex_lock(&message->session->context->mutex);
@@ -303,8 +308,29 @@ inf_sasl_context_session_message_func(gpointer user_data)
     g_mutex_lock(&message->session->context->mutex);
     g_assert(message->session->dispatch != NULL);
     message->session->dispatch = NULL;
+
+    result_func = message->session->result_func;
+    result_user_data = message->session->result_user_data;
+    result_notify = message->session->result_notify;
+    message->session->result_func = NULL;
+    message->session->result_user_data = NULL;
+    message->session->result_notify = NULL;
     g_mutex_unlock(&message->session->context->mutex);
 
+    /* Apply what the callback found out before reporting the result of the
+     * step, so that it is available to the feed function. */
+    if(result_func != NULL)
+    {
+      result_func(
+        message->session,
+        message->session->session_data,
+        result_user_data
+      );
+    }
+
+    if(result_notify != NULL)
+      result_notify(result_user_data);
+
     switch(message->shared.stepped.retval)
     {
     case GSASL_OK:
@@ -348,28 +374,54 @@ inf_sasl_context_gsasl_callback(Gsasl* gsasl,
 {
   InfSaslContextSession* session;
   InfSaslContextMessage* message;
+  InfSaslContextCallbackFunc func;
+  gpointer func_user_data;
+  int retval;
 
   session = (InfSaslContextSession*)gsasl_session_hook_get(gsasl_session);
 
+  /* gsasl_step64() calls this with the session mutex being held. Release it
+   * while the property is queried, since the callback sets the property
+   * with inf_sasl_context_session_set_property(). */
+  g_mutex_unlock(&session->mutex);
+  g_mutex_lock(&session->context->mutex);
+
   /* if the status is TERMINATE then get out of the inner loop by
    * returning from all SASL callbacks immediately. */
-  if(session->status == INF_SASL_CONTEXT_SESSION_TERMINATE)
+  if(session->status == INF_SASL_CONTEXT_SESSION_TERMINATE ||
+     session->detached)
+  {
+    g_mutex_unlock(&session->context->mutex);
+    g_mutex_lock(&session->mutex);
     return GSASL_NO_CALLBACK;
+  }
 
   g_assert(session->status == INF_SASL_CONTEXT_SESSION_INNER);
-  
-  /* query the property from the main thread */
-  g_assert(session->dispatch == NULL);
-  session->dispatch = inf_io_add_dispatch(
-    INF_IO(session->main_io),
-    inf_sasl_context_session_message_func,
-    inf_sasl_context_message_query(session, prop),
-    inf_sasl_context_message_free
-  );
+  session->retval = G_MAXINT;
 
-  g_mutex_unlock(&session->context->mutex);
+  if(session->context->callback_blocking)
+  {
+    /* query the property directly in this worker thread */
+    func = session->context->callback;
+    func_user_data = session->context->callback_user_data;
+    g_mutex_unlock(&session->context->mutex);
+
+    func(session, prop, session->session_data, func_user_data);
+  }
+  else
+  {
+    /* query the property from the main thread */
+    g_assert(session->dispatch == NULL);
+    session->dispatch = inf_io_add_dispatch(
+      INF_IO(session->main_io),
+      inf_sasl_context_session_message_func,
+      inf_sasl_context_message_query(session, prop),
+      inf_sasl_context_message_free
+    );
+
+    g_mutex_unlock(&session->context->mutex);
+  }
 
-  session->retval = G_MAXINT;
   while(session->status == INF_SASL_CONTEXT_SESSION_INNER &&
         session->retval == G_MAXINT)
   {
@@ -382,99 +434,142 @@ inf_sasl_context_gsasl_callback(Gsasl* gsasl,
 
   /* return on terminate */
   if(session->status == INF_SASL_CONTEXT_SESSION_TERMINATE)
-    return GSASL_NO_CALLBACK;
+  {
+    retval = GSASL_NO_CALLBACK;
+  }
+  else
+  {
+    g_assert(session->dispatch == NULL);
+    retval = session->retval;
+  }
 
-  g_assert(session->dispatch == NULL);
-  return session->retval;
+  g_mutex_unlock(&session->context->mutex);
+  g_mutex_lock(&session->mutex);
+  return retval;
 }
 
-static void*
-inf_sasl_context_thread_func(gpointer data)
+/* Runs gsasl_step64() for the data fed to session. This is called in a
+ * worker thread with the context mutex being held. The context mutex is
+ * released while the step runs, so that other sessions can be processed
+ * by other workers in the meanwhile. */
+static void
+inf_sasl_context_session_step(InfSaslContextSession* session)
 {
-  InfSaslContextSession* session;
-  InfSaslContextMessage* message;
-
-  session = (InfSaslContextSession*)data;
-
   int retval;
   char* output;
   InfSaslContextSessionFeedFunc feed_func;
   gpointer feed_user_data;
 
-  /* Wait for something to do */
-  while(session->status != INF_SASL_CONTEXT_SESSION_TERMINATE)
+  g_assert(session->status == INF_SASL_CONTEXT_SESSION_INNER);
+  g_assert(session->dispatch == NULL);
+
+  g_mutex_unlock(&session->context->mutex);
+  g_mutex_lock(&session->mutex);
+
+  /* This might call the gsasl callback once or more in which we wait
+   * for input from the main thread. */
+  retval = gsasl_step64(
+    session->session,
+    session->step64,
+    &output
+  );
+
+  g_mutex_unlock(&session->mutex);
+  g_mutex_lock(&session->context->mutex);
+
+  g_free(session->step64);
+  session->step64 = NULL;
+
+  if(retval != GSASL_OK && retval != GSASL_NEEDS_MORE)
+    output = NULL;
+
+  /* Only process the result when we were not requested to terminate
+   * within the gsasl callback, or while the step was running. */
+  if(session->status != INF_SASL_CONTEXT_SESSION_TERMINATE &&
+     !session->detached)
   {
-    switch(session->status)
-    {
-    case INF_SASL_CONTEXT_SESSION_OUTER:
-      message = g_async_queue_pop(session->session_queue);
-      inf_sasl_context_session_message_func(message);
-      inf_sasl_context_message_free(message);
-      break;
-    case INF_SASL_CONTEXT_SESSION_INNER:
-      g_mutex_lock(&session->context->mutex);
+    feed_func = session->feed_func;
+    feed_user_data = session->feed_user_data;
+    session->feed_func = NULL; /* clear, so that feed can be called again */
+
+    session->status = INF_SASL_CONTEXT_SESSION_OUTER;
+
+    g_assert(session->dispatch == NULL);
+
+    session->dispatch = inf_io_add_dispatch(
+      INF_IO(session->main_io),
+      inf_sasl_context_session_message_func,
+      inf_sasl_context_message_stepped(
+        session,
+        output,
+        retval,
+        feed_func,
+        feed_user_data
+      ),
+      inf_sasl_context_message_free
+    );
+  }
+  else
+  {
+    session->feed_func = NULL;
+    if(output) gsasl_free(output);
+  }
+}
 
-      g_assert(session->dispatch == NULL);
+/* Frees a session which is no longer in the context's session list. This is
+ * called with the context mutex being held. */
+static void
+inf_sasl_context_session_free(InfSaslContextSession* session)
+{
+  gsasl_finish(session->session);
 
-      /* This might call the gsasl callback once or more in which we wait
-       * for input from the main thread. */
-      retval = gsasl_step64(
-        session->session,
-        session->step64,
-        &output
-      );
+  /* This also frees a continue or terminate message that was not
+   * processed by a worker thread. */
+  g_async_queue_unref(session->session_queue);
 
-      g_mutex_unlock(&session->context->mutex);
+  g_object_unref(session->main_io);
 
-      g_free(session->step64);
-      session->step64 = NULL;
+  if(session->result_notify != NULL)
+    session->result_notify(session->result_user_data);
 
-      if(retval != GSASL_OK && retval != GSASL_NEEDS_MORE)
-        output = NULL;
+  g_free(session->step64);
+  g_mutex_clear(&session->mutex);
+  g_slice_free(InfSaslContextSession, session);
+}
 
-      /* Only process the result when we were not requested to terminate
-       * within the gsasl callback. */
-      if(session->status != INF_SASL_CONTEXT_SESSION_TERMINATE)
-      {
-        feed_func = session->feed_func;
-        feed_user_data = session->feed_user_data;
-        session->feed_func = NULL; /* clear, so that feed can be called again */
-
-        session->status = INF_SASL_CONTEXT_SESSION_OUTER;
-
-        g_mutex_lock(&session->context->mutex);
-
-        g_assert(session->dispatch == NULL);
-
-        session->dispatch = inf_io_add_dispatch(
-          INF_IO(session->main_io),
-          inf_sasl_context_session_message_func,
-          inf_sasl_context_message_stepped(
-            session,
-            output,
-            retval,
-            feed_func,
-            feed_user_data
-          ),
-          inf_sasl_context_message_free
-        );
-
-        g_mutex_unlock(&session->context->mutex);
-      }
-      else
-      {
-        session->feed_func = NULL;
-        if(output) gsasl_free(output);
-      }
+static void*
+inf_sasl_context_worker_func(gpointer data)
+{
+  InfSaslContext* context;
+  InfSaslContextSession* session;
 
-      break;
-    case INF_SASL_CONTEXT_SESSION_TERMINATE:
-    default:
-      g_assert_not_reached();
-      break;
+  context = (InfSaslContext*)data;
+
+  g_mutex_lock(&context->mutex);
+
+  while(!context->shutdown)
+  {
+    session = g_queue_pop_head(&context->pending);
+    if(session == NULL)
+    {
+      /* Wait for something to do */
+      ++context->n_idle_workers;
+      g_cond_wait(&context->worker_cond, &context->mutex);
+      --context->n_idle_workers;
+    }
+    else
+    {
+      session->active = TRUE;
+      inf_sasl_context_session_step(session);
+      session->active = FALSE;
+
+      /* The session was stopped while we were processing it */
+      if(session->detached)
+        inf_sasl_context_session_free(session);
     }
   }
 
+  g_mutex_unlock(&context->mutex);
   return NULL;
 }
 
@@ -490,18 +585,72 @@ inf_sasl_context_start_session(InfSaslContext* context,
                                GError** error)
 {
   InfSaslContextSession* session;
+  GThread* thread;
+  GError* local_error;
+
+  /* Refuse new sessions while the workers are busy with a backlog, so that
+   * the sessions already running can complete. */
+  if(context->max_pending > 0 &&
+     g_queue_get_length(&context->pending) >= context->max_pending)
+  {
+    g_set_error_literal(
+      error,
+      inf_authentication_detail_error_quark(),
+      INF_AUTHENTICATION_DETAIL_ERROR_TRY_AGAIN,
+      _("Too many authentications are in progress, try again later")
+    );
+
+    return NULL;
+  }
+
+  /* Start another worker unless there are enough for all sessions */
+  if(context->n_workers < context->max_workers &&
+     context->n_workers <= context->n_sessions)
+  {
+    local_error = NULL;
+
+    thread = g_thread_try_new(
+      "InfSaslContext",
+      inf_sasl_context_worker_func,
+      context,
+      &local_error
+    );
+
+    if(thread == NULL)
+    {
+      /* We can do with the existing workers, if any */
+      if(context->n_workers == 0)
+      {
+        g_propagate_error(error, local_error);
+        return NULL;
+      }
+
+      g_error_free(local_error);
+    }
+    else
+    {
+      context->workers = g_slist_prepend(context->workers, thread);
+      ++context->n_workers;
+    }
+  }
+
   session = g_slice_new(InfSaslContextSession);
 
   session->context = context;
   session->session = gsasl_session;
+  g_mutex_init(&session->mutex);
   session->session_data = session_data;
   session->main_io = io;
   g_object_ref(session->main_io);
   session->session_queue =
     g_async_queue_new_full(inf_sasl_context_message_free);
   session->dispatch = NULL;
-  session->thread = NULL;
   session->stepping = FALSE;
+  session->active = FALSE;
+  session->detached = FALSE;
+  session->result_func = NULL;
+  session->result_user_data = NULL;
+  session->result_notify = NULL;
 
   session->status = INF_SASL_CONTEXT_SESSION_OUTER;
   session->step64 = NULL;
@@ -510,24 +659,9 @@ inf_sasl_context_start_session(InfSaslContext* context,
   /*session->feed_user_data = NULL;*/
 
   context->sessions = g_slist_prepend(context->sessions, session);
+  ++context->n_sessions;
   gsasl_session_hook_set(gsasl_session, session);
 
-  session->thread = g_thread_try_new(
-    "InfSaslContext",
-    inf_sasl_context_thread_func,
-    session,
-    error
-  );
-
-  if(session->thread == NULL)
-  {
-    context->sessions = g_slist_remove(context->sessions, session);
-    g_async_queue_unref(session->session_queue);
-    g_object_unref(session->main_io);
-    g_slice_free(InfSaslContextSession, session);
-    return NULL;
-  }
-
   return session;
 }
 
@@ -566,16 +700,28 @@ inf_sasl_context_new(GError** error)
   sasl->gsasl = gsasl;
   sasl->ref_count = 1;
   sasl->sessions = NULL;
+  sasl->n_sessions = 0;
 
   sasl->callback = NULL;
   sasl->callback_user_data = NULL;
   sasl->callback_notify = NULL;
+  sasl->callback_blocking = FALSE;
 
   gsasl_callback_set(gsasl, inf_sasl_context_gsasl_callback);
   gsasl_callback_hook_set(gsasl, sasl);
 
   g_mutex_init(&sasl->mutex);
 
+  g_queue_init(&sasl->pending);
+  sasl->workers = NULL;
+  sasl->n_workers = 0;
+  sasl->n_idle_workers = 0;
+  sasl->max_workers = 8;
+  sasl->max_pending = 256;
+  sasl->shutdown = FALSE;
+
+  g_cond_init(&sasl->worker_cond);
+
   return sasl;
 }
 
@@ -615,7 +761,7 @@ inf_sasl_context_unref(InfSaslContext* context)
   {
     /* Note that we don't need to lock the mutex here since if nobody has a
      * reference anymore then they cannot access the session list concurrently
-     * anyway. Also, the session threads do not access the list at all. */
+     * anyway. Also, the worker threads do not access the list at all. */
     while(context->sessions != NULL)
     {
       inf_sasl_context_stop_session(
@@ -624,10 +770,25 @@ inf_sasl_context_unref(InfSaslContext* context)
       );
     }
 
-    /* Again we don't need to lock the mutex for this since all session
+    /* Workers might still be finishing sessions that were stopped while
+     * being processed. They free them before they exit. */
+    g_mutex_lock(&context->mutex);
+    context->shutdown = TRUE;
+    g_cond_broadcast(&context->worker_cond);
+    g_mutex_unlock(&context->mutex);
+
+    while(context->workers != NULL)
+    {
+      g_thread_join((GThread*)context->workers->data);
+      context->workers =
+        g_slist_delete_link(context->workers, context->workers);
+    }
+
+    /* Again we don't need to lock the mutex for this since all worker
      * threads have been stopped at this point. */
     gsasl_done(context->gsasl);
     g_mutex_clear(&context->mutex);
+    g_cond_clear(&context->worker_cond);
 
     if(context->callback_notify != NULL)
       context->callback_notify(context->callback_user_data);
@@ -670,6 +831,79 @@ inf_sasl_context_set_callback(InfSaslContext* context,
   context->callback = callback;
   context->callback_user_data = user_data;
   context->callback_notify = notify;
+  context->callback_blocking = FALSE;
+  g_mutex_unlock(&context->mutex);
+}
+
+/**
+ * inf_sasl_context_set_blocking_callback:
+ * @context: A #InfSaslContext.
+ * @callback: A function to call to query properties for authentication.
+ * @user_data: Additional context to pass to @callback.
+ * @notify: Function called to destroy @user_data once it is no longer needed,
+ * or %NULL.
+ *
+ * Sets the callback to call when, during authentication, a certain property
+ * needs to be provided, like inf_sasl_context_set_callback(). However,
+ * @callback is not called in the thread of the session's #InfIo but
+ * directly in the worker thread processing the session. This is meant for
+ * callbacks that need to perform blocking operations, such as checking a
+ * password with PAM, which should not stall the main loop.
+ *
+ * @callback must be thread-safe, since it can be called for several
+ * sessions concurrently. While it runs, it occupies a worker thread, so it
+ * should call inf_sasl_context_session_continue() before returning, or
+ * shortly afterwards. Other sessions keep being processed by the remaining
+ * worker threads in the meanwhile, since each session is stepped under its
+ * own lock.
+ */
+void
+inf_sasl_context_set_blocking_callback(InfSaslContext* context,
+                                       InfSaslContextCallbackFunc callback,
+                                       gpointer user_data,
+                                       GDestroyNotify notify)
+{
+  g_return_if_fail(context != NULL);
+
+  g_mutex_lock(&context->mutex);
+  if(context->callback_notify != NULL)
+    context->callback_notify(context->callback_user_data);
+  context->callback = callback;
+  context->callback_user_data = user_data;
+  context->callback_notify = notify;
+  context->callback_blocking = TRUE;
+  g_mutex_unlock(&context->mutex);
+}
+
+/**
+ * inf_sasl_context_set_worker_limits:
+ * @context: A #InfSaslContext.
+ * @max_workers: The maximum number of worker threads.
+ * @max_pending: The maximum number of sessions waiting for a worker, or 0
+ * for no limit.
+ *
+ * Limits the number of threads which @context uses to process SASL sessions,
+ * and the number of sessions that can wait for one of these threads. If
+ * @max_pending sessions are waiting, inf_sasl_context_server_start_session()
+ * and inf_sasl_context_client_start_session() fail with
+ * %INF_AUTHENTICATION_DETAIL_ERROR_TRY_AGAIN until the backlog has been
+ * processed. By default, at most 8 workers and 256 waiting sessions are
+ * allowed.
+ *
+ * Worker threads which are already running are not stopped if @max_workers
+ * is lower than the current number of workers.
+ */
+void
+inf_sasl_context_set_worker_limits(InfSaslContext* context,
+                                   guint max_workers,
+                                   guint max_pending)
+{
+  g_return_if_fail(context != NULL);
+  g_return_if_fail(max_workers > 0);
+
+  g_mutex_lock(&context->mutex);
+  context->max_workers = max_workers;
+  context->max_pending = max_pending;
   g_mutex_unlock(&context->mutex);
 }
 
@@ -961,7 +1195,12 @@ inf_sasl_context_server_supports_mechanism(InfSaslContext* context,
  * to cancel an authentication session, or to free it after it finished
  * (either successfully or not).
  *
- * @session should no longer be used after this function was called.
+ * @session should no longer be used after this function was called. If a
+ * worker thread is currently processing @session, for example because a
+ * blocking callback set with inf_sasl_context_set_blocking_callback() is
+ * running, then this function does not wait for it. The session is freed
+ * by the worker thread as soon as it has finished, and no more callbacks
+ * are made in the main thread for it.
  */
 void
 inf_sasl_context_stop_session(InfSaslContext* context,
@@ -973,33 +1212,36 @@ inf_sasl_context_stop_session(InfSaslContext* context,
   g_mutex_lock(&context->mutex);
   g_return_if_fail(g_slist_find(context->sessions, session) != NULL);
   g_return_if_fail(session->context == context);
-  g_mutex_unlock(&context->mutex);
 
-  /* Tell client thread to terminate */
-  g_async_queue_push(
-    session->session_queue,
-    inf_sasl_context_message_terminate(session)
-  );
-
-  g_thread_join(session->thread);
-
-  g_mutex_lock(&context->mutex);
   if(session->dispatch != NULL)
+  {
     inf_io_remove_dispatch(session->main_io, session->dispatch);
+    session->dispatch = NULL;
+  }
 
   context->sessions = g_slist_remove(context->sessions, session);
-  gsasl_finish(session->session);
-  g_mutex_unlock(&context->mutex);
+  --context->n_sessions;
 
-  /* Note that this assertion should hold because us pushing the terminate
-   * message into the end of the queue, and all other queued messages will
-   * have been processed before. */
-  g_async_queue_unref(session->session_queue);
-
-  g_object_unref(session->main_io);
+  if(session->active)
+  {
+    /* Tell the worker thread to stop processing the session. It might be
+     * blocked in the callback for a while, so do not wait for it but let it
+     * free the session when it is done. */
+    session->detached = TRUE;
+
+    g_async_queue_push(
+      session->session_queue,
+      inf_sasl_context_message_terminate(session)
+    );
+  }
+  else
+  {
+    /* If the session waits for a worker, then it is simply not processed */
+    g_queue_remove(&context->pending, session);
+    inf_sasl_context_session_free(session);
+  }
 
-  g_free(session->step64);
-  g_slice_free(InfSaslContextSession, session);
+  g_mutex_unlock(&context->mutex);
 }
 
 /**
@@ -1024,9 +1266,9 @@ inf_sasl_context_session_get_property(InfSaslContextSession* session,
 
   /* TODO: We should g_strdup the return value for thread safety reasons */
 
-  g_mutex_lock(&session->context->mutex);
+  g_mutex_lock(&session->mutex);
   property = gsasl_property_fast(session->session, prop);
-  g_mutex_unlock(&session->context->mutex);
+  g_mutex_unlock(&session->mutex);
 
   return property;
 }
@@ -1046,9 +1288,9 @@ inf_sasl_context_session_set_property(InfSaslContextSession* session,
 {
   g_return_if_fail(session != NULL);
 
-  g_mutex_lock(&session->context->mutex);
+  g_mutex_lock(&session->mutex);
   gsasl_property_set(session->session, prop, value);
-  g_mutex_unlock(&session->context->mutex);
+  g_mutex_unlock(&session->mutex);
 }
 
 /**
@@ -1076,6 +1318,51 @@ inf_sasl_context_session_continue(InfSaslContextSession* session,
   );
 }
 
+/**
+ * inf_sasl_context_session_set_result:
+ * @session: A #InfSaslContextSession.
+ * @func: (scope async): The function to call in the main thread.
+ * @user_data: Additional data to pass to @func.
+ * @notify: Function called to destroy @user_data once it is no longer
+ * needed, or %NULL.
+ *
+ * Schedules @func to be called in the thread of the session's #InfIo when
+ * the current step of @session has finished, right before the
+ * #InfSaslContextSessionFeedFunc is called. This allows a blocking callback
+ * set with inf_sasl_context_set_blocking_callback(), which runs in a worker
+ * thread, to pass the outcome of its checks to the main thread, where it is
+ * safe to access the session data. If the session is stopped before the
+ * step finishes, then @func is not called. In either case @notify is called
+ * on @user_data afterwards, possibly from a worker thread.
+ *
+ * A function that was set previously for the same step is replaced.
+ *
+ * This function is thread-safe.
+ */
+void
+inf_sasl_context_session_set_result(InfSaslContextSession* session,
+                                    InfSaslContextSessionResultFunc func,
+                                    gpointer user_data,
+                                    GDestroyNotify notify)
+{
+  GDestroyNotify old_notify;
+  gpointer old_user_data;
+
+  g_return_if_fail(session != NULL);
+
+  g_mutex_lock(&session->context->mutex);
+  old_notify = session->result_notify;
+  old_user_data = session->result_user_data;
+
+  session->result_func = func;
+  session->result_user_data = user_data;
+  session->result_notify = notify;
+  g_mutex_unlock(&session->context->mutex);
+
+  if(old_notify != NULL)
+    old_notify(old_user_data);
+}
+
 /**
  * inf_sasl_context_session_feed:
  * @session: A #InfSaslContextSession.
@@ -1105,10 +1392,17 @@ inf_sasl_context_session_feed(InfSaslContextSession* session,
 
   session->stepping = TRUE;
 
-  g_async_queue_push(
-    session->session_queue,
-    inf_sasl_context_message_step(session, data, func, user_data)
-  );
+  g_mutex_lock(&session->context->mutex);
+  g_assert(session->status == INF_SASL_CONTEXT_SESSION_OUTER);
+
+  session->step64 = data ? g_strdup(data) : NULL;
+  session->feed_func = func;
+  session->feed_user_data = user_data;
+  session->status = INF_SASL_CONTEXT_SESSION_INNER;
+
+  g_queue_push_tail(&session->context->pending, session);
+  g_cond_signal(&session->context->worker_cond);
+  g_mutex_unlock(&session->context->mutex);
 }
 
 /**
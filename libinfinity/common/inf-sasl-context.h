@@ -96,6 +96,22 @@ typedef void(*InfSaslContextSessionFeedFunc)(InfSaslContextSession* session,
                                              const GError* error,
                                              gpointer user_data);
 
+/**
+ * InfSaslContextSessionResultFunc:
+ * @session: A #InfSaslContextSession.
+ * @session_data: The session data specified when the session was started.
+ * @user_data: The user data specified in
+ * inf_sasl_context_session_set_result().
+ *
+ * This function is called in the thread of the session's #InfIo after a
+ * step of @session has finished, if it was scheduled with
+ * inf_sasl_context_session_set_result(). It is called before the
+ * #InfSaslContextSessionFeedFunc for that step.
+ */
+typedef void(*InfSaslContextSessionResultFunc)(InfSaslContextSession* session,
+                                               gpointer session_data,
+                                               gpointer user_data);
+
 GType
 inf_sasl_context_get_type(void) G_GNUC_CONST;
 
@@ -114,6 +130,17 @@ inf_sasl_context_set_callback(InfSaslContext* context,
                               gpointer user_data,
                               GDestroyNotify notify);
 
+void
+inf_sasl_context_set_blocking_callback(InfSaslContext* context,
+                                       InfSaslContextCallbackFunc callback,
+                                       gpointer user_data,
+                                       GDestroyNotify notify);
+
+void
+inf_sasl_context_set_worker_limits(InfSaslContext* context,
+                                   guint max_workers,
+                                   guint max_pending);
+
 InfSaslContextSession*
 inf_sasl_context_client_start_session(InfSaslContext* context,
                                       InfIo* io,
@@ -165,6 +192,12 @@ void
 inf_sasl_context_session_continue(InfSaslContextSession* session,
                                   int retval);
 
+void
+inf_sasl_context_session_set_result(InfSaslContextSession* session,
+                                    InfSaslContextSessionResultFunc func,
+                                    gpointer user_data,
+                                    GDestroyNotify notify);
+
 void
 inf_sasl_context_session_feed(InfSaslContextSession* session,
                               const char* data,
@@ -60,6 +60,7 @@
 #include <libinfinity/common/inf-buffer.h>
 #include <libinfinity/common/inf-xml-util.h>
 #include <libinfinity/common/inf-error.h>
+#include <libinfinity/common/inf-trace.h>
 #include <libinfinity/communication/inf-communication-object.h>
 #include <libinfinity/inf-i18n.h>
 #include <libinfinity/inf-signals.h>
@@ -103,6 +104,8 @@ struct _InfSessionSync {
   guint messages_total;
   guint messages_sent;
   InfSessionSyncStatus status;
+
+  INF_TRACE_DECLARE(begin_time);
 };
 
 typedef struct _InfSessionPrivate InfSessionPrivate;
@@ -115,6 +118,8 @@ struct _InfSessionPrivate {
   /* Group of subscribed connections */
   InfCommunicationGroup* subscription_group;
 
+  InfSessionStatistics statistics;
+
   union {
     /* INF_SESSION_PRESYNC */
     struct {
@@ -459,6 +464,8 @@ inf_session_init(InfSession* session)
   priv->status = INF_SESSION_RUNNING;
 
   priv->shared.run.syncs = NULL;
+
+  memset(&priv->statistics, 0, sizeof(InfSessionStatistics));
 }
 
 static void
@@ -1152,6 +1159,18 @@ inf_session_validate_user_props_impl(InfSession* session,
   return TRUE;
 }
 
+static gsize
+inf_session_get_memory_usage_impl(InfSession* session)
+{
+  InfSessionPrivate* priv;
+  priv = INF_SESSION_PRIVATE(session);
+
+  if(priv->buffer == NULL)
+    return 0;
+
+  return inf_buffer_get_memory_usage(priv->buffer);
+}
+
 /*
  * InfCommunicationObject implementation.
  */
@@ -1446,10 +1465,13 @@ inf_session_communication_object_received(InfCommunicationObject* comm_object,
   InfCommunicationScope scope;
   GError* local_error;
   const gchar* local_message;
+  guint64 begin;
 
   session = INF_SESSION(comm_object);
   priv = INF_SESSION_PRIVATE(session);
 
+  ++priv->statistics.n_messages_received;
+
   switch(priv->status)
   {
   case INF_SESSION_PRESYNC:
@@ -1558,6 +1580,9 @@ inf_session_communication_object_received(InfCommunicationObject* comm_object,
               sync->status == INF_SESSION_SYNC_AWAITING_ACK)
       {
         /* Got ack we were waiting for */
+        INF_TRACE_END(INF_TRACE_SYNC_DURATION, sync->begin_time);
+        INF_TRACE_VALUE(INF_TRACE_SYNC_MESSAGES, sync->messages_total);
+
         g_signal_emit(
           G_OBJECT(comm_object),
           session_signals[SYNCHRONIZATION_COMPLETE],
@@ -1593,6 +1618,8 @@ inf_session_communication_object_received(InfCommunicationObject* comm_object,
       g_assert(session_class->process_xml_run != NULL);
 
       local_error = NULL;
+      begin = inf_trace_now();
+
       scope = session_class->process_xml_run(
         session,
         connection,
@@ -1600,6 +1627,12 @@ inf_session_communication_object_received(InfCommunicationObject* comm_object,
         &local_error
       );
 
+      /* This includes the transformation of requests and the messages
+       * sent in response, so all of it is accounted to this session. */
+      priv->statistics.processing_time += inf_trace_now() - begin;
+      if(scope == INF_COMMUNICATION_SCOPE_GROUP)
+        ++priv->statistics.n_messages_relayed;
+
       if(local_error != NULL)
       {
         /* At this point we don't really know what's wrong with the session,
@@ -1726,6 +1759,7 @@ inf_session_synchronization_begin_handler(InfSession* session,
   sync->messages_sent = 0;
   sync->messages_total = 2; /* including sync-begin and sync-end */
   sync->status = INF_SESSION_SYNC_IN_PROGRESS;
+  INF_TRACE_BEGIN(sync->begin_time);
 
   g_object_ref(G_OBJECT(connection));
   priv->shared.run.syncs = g_slist_prepend(priv->shared.run.syncs, sync);
@@ -1888,6 +1922,9 @@ inf_session_class_init(InfSessionClass* session_class)
   session_class->validate_user_props = inf_session_validate_user_props_impl;
 
   session_class->user_new = NULL;
+  session_class->get_memory_usage = inf_session_get_memory_usage_impl;
+  session_class->trim = NULL;
+  session_class->flush = NULL;
 
   session_class->close = inf_session_close_handler;
   session_class->error = NULL;
@@ -2277,13 +2314,26 @@ inf_session_user_to_xml(InfSession* session,
  * @session: A #InfSession.
  *
  * Closes a running session. When a session is closed, it unrefs all
- * connections and no longer handles requests.
+ * connections and no longer handles requests. Modifications that have been
+ * held back by the session are sent to the subscription group before, see
+ * inf_session_flush().
  */
 void
 inf_session_close(InfSession* session)
 {
+  InfSessionPrivate* priv;
+
   g_return_if_fail(INF_IS_SESSION(session));
   g_return_if_fail(inf_session_get_status(session) != INF_SESSION_CLOSED);
+
+  priv = INF_SESSION_PRIVATE(session);
+
+  /* This needs to happen before the signal emission, since the session
+   * proxies unsubscribe all connections in their signal handlers, which run
+   * before the default handler. */
+  if(priv->status == INF_SESSION_RUNNING && priv->subscription_group != NULL)
+    inf_session_flush(session);
+
   g_signal_emit(G_OBJECT(session), session_signals[CLOSE], 0);
 }
 
@@ -2347,6 +2397,93 @@ inf_session_get_status(InfSession* session)
   return INF_SESSION_PRIVATE(session)->status;
 }
 
+/**
+ * inf_session_get_memory_usage:
+ * @session: A #InfSession.
+ *
+ * Returns an estimate of the number of bytes @session occupies in memory,
+ * including its buffer and any session-specific state such as the request
+ * history. The estimate is approximate; it is meant to compare sessions
+ * against each other and against a memory budget.
+ *
+ * Return Value: The approximate memory usage of @session, in bytes.
+ **/
+gsize
+inf_session_get_memory_usage(InfSession* session)
+{
+  InfSessionClass* session_class;
+
+  g_return_val_if_fail(INF_IS_SESSION(session), 0);
+
+  session_class = INF_SESSION_GET_CLASS(session);
+  if(session_class->get_memory_usage == NULL)
+    return 0;
+
+  return session_class->get_memory_usage(session);
+}
+
+/**
+ * inf_session_trim:
+ * @session: A #InfSession.
+ *
+ * Asks @session to release memory that is not strictly required, for
+ * example cached data that can be recomputed on demand. The content of the
+ * session and its observable behaviour are not changed.
+ **/
+void
+inf_session_trim(InfSession* session)
+{
+  InfSessionClass* session_class;
+
+  g_return_if_fail(INF_IS_SESSION(session));
+
+  session_class = INF_SESSION_GET_CLASS(session);
+  if(session_class->trim != NULL)
+    session_class->trim(session);
+}
+
+/**
+ * inf_session_flush:
+ * @session: A #InfSession.
+ *
+ * Sends all modifications of @session that have been held back to be
+ * combined with later ones, for example adjacent keystrokes of a local user,
+ * or caret updates which the host relays to the other subscriptions.
+ * This is called automatically before the session processes incoming
+ * messages or sends other messages, so usually there is no need to call it
+ * explicitly.
+ **/
+void
+inf_session_flush(InfSession* session)
+{
+  InfSessionClass* session_class;
+
+  g_return_if_fail(INF_IS_SESSION(session));
+
+  session_class = INF_SESSION_GET_CLASS(session);
+  if(session_class->flush != NULL)
+    session_class->flush(session);
+}
+
+/**
+ * inf_session_get_statistics:
+ * @session: A #InfSession.
+ * @statistics: (out): Location to store the statistics.
+ *
+ * Fills @statistics with counters of the work @session has done since it
+ * was created. A server can compare the counters of its sessions over time
+ * to find out which documents cause most of its load.
+ **/
+void
+inf_session_get_statistics(InfSession* session,
+                           InfSessionStatistics* statistics)
+{
+  g_return_if_fail(INF_IS_SESSION(session));
+  g_return_if_fail(statistics != NULL);
+
+  *statistics = INF_SESSION_PRIVATE(session)->statistics;
+}
+
 /**
  * inf_session_add_user:
  * @session: A #InfSession.
@@ -2435,6 +2572,10 @@ inf_session_set_user_status(InfSession* session,
 
   if(inf_user_get_status(user) != status)
   {
+    /* Modifications that were held back need to be sent while the user is
+     * still available. */
+    inf_session_flush(session);
+
     xml = xmlNewNode(NULL, (const xmlChar*)"user-status-change");
     inf_xml_util_set_attribute_uint(xml, "id", inf_user_get_id(user));
 
@@ -2861,6 +3002,10 @@ inf_session_set_subscription_group(InfSession* session,
  * Sends a XML message to the all members of @session's subscription group.
  * This function can only be called if the subscription group is non-%NULL. It
  * takes ownership of @xml.
+ *
+ * Modifications that have been held back by the session are sent before
+ * @xml, see inf_session_flush(), so that all members receive them in the
+ * order in which they were made.
  **/
 void
 inf_session_send_to_subscriptions(InfSession* session,
@@ -2874,6 +3019,9 @@ inf_session_send_to_subscriptions(InfSession* session,
   priv = INF_SESSION_PRIVATE(session);
   g_return_if_fail(priv->subscription_group != NULL);
 
+  inf_session_flush(session);
+
+  ++priv->statistics.n_messages_sent;
   inf_communication_group_send_group_message(priv->subscription_group, xml);
 }
 
@@ -147,6 +147,30 @@ typedef enum _InfSessionSyncError {
   INF_SESSION_SYNC_ERROR_FAILED
 } InfSessionSyncError;
 
+/**
+ * InfSessionStatistics:
+ * @processing_time: Time, in nanoseconds, spent processing messages received
+ * while the session is running. This includes the transformation of
+ * requests and the messages sent in response.
+ * @n_messages_received: The number of messages received from any
+ * connection, including synchronization messages.
+ * @n_messages_relayed: The number of received messages that were designated
+ * for all group members, and are therefore relayed to all other
+ * subscribed connections by a publisher.
+ * @n_messages_sent: The number of messages sent with
+ * inf_session_send_to_subscriptions().
+ *
+ * Counters of the work done by a #InfSession, see
+ * inf_session_get_statistics().
+ */
+typedef struct _InfSessionStatistics InfSessionStatistics;
+struct _InfSessionStatistics {
+  guint64 processing_time;
+  guint64 n_messages_received;
+  guint64 n_messages_relayed;
+  guint64 n_messages_sent;
+};
+
 /**
  * InfSessionClass:
  * @to_xml_sync: Virtual function that saves the session within a XML
@@ -188,6 +212,14 @@ typedef enum _InfSessionSyncError {
  * #InfSession::synchronization-failed signal. If the session itself got
  * synchronized (and did not synchronize another session), then the default
  * handler changes status to %INF_SESSION_CLOSED.
+ * @get_memory_usage: Virtual function that returns an estimate of the memory
+ * occupied by the session, in bytes. The default implementation returns the
+ * memory usage of the session's buffer.
+ * @trim: Virtual function that releases memory which is not strictly
+ * required to keep the session running, such as caches. It may be %NULL.
+ * @flush: Virtual function that sends modifications which the session held
+ * back to combine them with later ones, including those it relays for
+ * others. It may be %NULL.
  *
  * This structure contains the virtual functions and default signal handlers
  * of #InfSession.
@@ -254,6 +286,14 @@ struct _InfSessionClass {
   void(*synchronization_failed)(InfSession* session,
                                 InfXmlConnection* connection,
                                 const GError* error);
+
+  /* Virtual table, continued. New entries are added at the end so that the
+   * layout of the structure stays compatible. */
+  gsize(*get_memory_usage)(InfSession* session);
+
+  void(*trim)(InfSession* session);
+
+  void(*flush)(InfSession* session);
 };
 
 /**
@@ -304,6 +344,19 @@ inf_session_get_user_table(InfSession* session);
 InfSessionStatus
 inf_session_get_status(InfSession* session);
 
+gsize
+inf_session_get_memory_usage(InfSession* session);
+
+void
+inf_session_trim(InfSession* session);
+
+void
+inf_session_flush(InfSession* session);
+
+void
+inf_session_get_statistics(InfSession* session,
+                           InfSessionStatistics* statistics);
+
 G_GNUC_BEGIN_IGNORE_DEPRECATIONS
 InfUser*
 inf_session_add_user(InfSession* session,
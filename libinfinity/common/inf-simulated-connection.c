@@ -64,6 +64,9 @@ struct _InfSimulatedConnectionPrivate {
 
   xmlNodePtr queue;
   xmlNodePtr queue_last_item;
+
+  gboolean detects_congestion;
+  gboolean congested;
 };
 
 enum {
@@ -80,7 +83,9 @@ enum {
   PROP_LOCAL_ID,
   PROP_REMOTE_ID,
   PROP_LOCAL_CERTIFICATE,
-  PROP_REMOTE_CERTIFICATE
+  PROP_REMOTE_CERTIFICATE,
+  PROP_CONGESTED,
+  PROP_DETECTS_CONGESTION
 };
 
 #define INF_SIMULATED_CONNECTION_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE((obj), INF_TYPE_SIMULATED_CONNECTION, InfSimulatedConnectionPrivate))
@@ -187,6 +192,9 @@ inf_simulated_connection_init(InfSimulatedConnection* connection)
 
   priv->target = NULL;
   priv->mode = INF_SIMULATED_CONNECTION_IMMEDIATE;
+
+  priv->detects_congestion = FALSE;
+  priv->congested = FALSE;
 }
 
 static void
@@ -294,6 +302,12 @@ inf_simulated_connection_get_property(GObject* object,
   case PROP_REMOTE_CERTIFICATE:
     g_value_set_boxed(value, NULL);
     break;
+  case PROP_CONGESTED:
+    g_value_set_boolean(value, priv->congested);
+    break;
+  case PROP_DETECTS_CONGESTION:
+    g_value_set_boolean(value, priv->detects_congestion);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
@@ -447,6 +461,14 @@ inf_simulated_connection_class_init(
     PROP_REMOTE_CERTIFICATE,
     "remote-certificate"
   );
+
+  g_object_class_override_property(object_class, PROP_CONGESTED, "congested");
+
+  g_object_class_override_property(
+    object_class,
+    PROP_DETECTS_CONGESTION,
+    "detects-congestion"
+  );
 }
 
 static void
@@ -612,4 +634,67 @@ inf_simulated_connection_flush(InfSimulatedConnection* connection)
   priv->queue_last_item = NULL;
 }
 
+/**
+ * inf_simulated_connection_set_detects_congestion:
+ * @connection: A #InfSimulatedConnection.
+ * @detects_congestion: Whether @connection should detect congestion.
+ *
+ * Sets whether @connection behaves like a connection with a limit on its
+ * send queue, see #InfXmlConnection:detects-congestion. Whether it is
+ * actually congested is controlled with
+ * inf_simulated_connection_set_congested(). If @detects_congestion is
+ * %FALSE, the connection is no longer congested.
+ */
+void
+inf_simulated_connection_set_detects_congestion(
+  InfSimulatedConnection* connection,
+  gboolean detects_congestion)
+{
+  InfSimulatedConnectionPrivate* priv;
+
+  g_return_if_fail(INF_IS_SIMULATED_CONNECTION(connection));
+  priv = INF_SIMULATED_CONNECTION_PRIVATE(connection);
+
+  if(priv->detects_congestion != detects_congestion)
+  {
+    g_object_freeze_notify(G_OBJECT(connection));
+
+    if(detects_congestion == FALSE)
+      inf_simulated_connection_set_congested(connection, FALSE);
+
+    priv->detects_congestion = detects_congestion;
+    g_object_notify(G_OBJECT(connection), "detects-congestion");
+
+    g_object_thaw_notify(G_OBJECT(connection));
+  }
+}
+
+/**
+ * inf_simulated_connection_set_congested:
+ * @connection: A #InfSimulatedConnection.
+ * @congested: Whether @connection is congested.
+ *
+ * Simulates the remote site not keeping up with reading the data sent to
+ * it, or catching up again, by setting #InfXmlConnection:congested. This
+ * does not affect the delivery of messages. @connection must detect
+ * congestion, see inf_simulated_connection_set_detects_congestion(), to
+ * become congested.
+ */
+void
+inf_simulated_connection_set_congested(InfSimulatedConnection* connection,
+                                       gboolean congested)
+{
+  InfSimulatedConnectionPrivate* priv;
+
+  g_return_if_fail(INF_IS_SIMULATED_CONNECTION(connection));
+  priv = INF_SIMULATED_CONNECTION_PRIVATE(connection);
+  g_return_if_fail(priv->detects_congestion == TRUE || congested == FALSE);
+
+  if(priv->congested != congested)
+  {
+    priv->congested = congested;
+    g_object_notify(G_OBJECT(connection), "congested");
+  }
+}
+
 /* vim:set et sw=2 ts=2: */
@@ -103,6 +103,15 @@ inf_simulated_connection_set_mode(InfSimulatedConnection* connection,
 void
 inf_simulated_connection_flush(InfSimulatedConnection* connection);
 
+void
+inf_simulated_connection_set_detects_congestion(
+  InfSimulatedConnection* connection,
+  gboolean detects_congestion);
+
+void
+inf_simulated_connection_set_congested(InfSimulatedConnection* connection,
+                                       gboolean congested);
+
 G_END_DECLS
 
 #endif /* __INF_SIMULATED_CONNECTION_H__ */
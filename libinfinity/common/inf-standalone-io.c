@@ -37,10 +37,24 @@
  * instead which implements the #InfIo interface. For the GTK+ toolkit, there
  * is #InfGtkIo in the libinfgtk library, to integrate with the Glib main
  * loop.
+ *
+ * Since all callbacks run on the same thread, a single slow callback delays
+ * all other events. To find such callbacks, a
+ * #InfStandaloneIo:stall-threshold can be set. Callbacks running longer
+ * than that emit the #InfStandaloneIo::stall signal, and the slowest of
+ * them are kept for inspection with inf_standalone_io_get_stalls().
  */
 
+#include "config.h"
+
+#ifdef HAVE_DLADDR
+/* For dladdr() and Dl_info. _GNU_SOURCE is defined in config.h. */
+# include <dlfcn.h>
+#endif
+
 #include <libinfinity/common/inf-standalone-io.h>
 #include <libinfinity/common/inf-io.h>
+#include <libinfinity/inf-define-enum.h>
 
 /* TODO: Modularize the FD handling, then add epoll support */
 
@@ -76,6 +90,31 @@ static const InfStandaloneIoPollTimeout INF_STANDALONE_IO_POLL_INFINITE = -1;
   (poll(events, (nfds_t)num_events, timeout))
 #endif
 
+/* Number of slowest callbacks that are remembered */
+#define INF_STANDALONE_IO_MAX_STALLS 16
+
+static const GEnumValue inf_standalone_io_callback_type_values[] = {
+  {
+    INF_STANDALONE_IO_CALLBACK_WATCH,
+    "INF_STANDALONE_IO_CALLBACK_WATCH",
+    "watch"
+  }, {
+    INF_STANDALONE_IO_CALLBACK_TIMEOUT,
+    "INF_STANDALONE_IO_CALLBACK_TIMEOUT",
+    "timeout"
+  }, {
+    INF_STANDALONE_IO_CALLBACK_DISPATCH,
+    "INF_STANDALONE_IO_CALLBACK_DISPATCH",
+    "dispatch"
+  }, {
+    0,
+    NULL,
+    NULL
+  }
+};
+
+INF_DEFINE_ENUM_TYPE(InfStandaloneIoCallbackType, inf_standalone_io_callback_type, inf_standalone_io_callback_type_values)
+
 struct _InfIoWatch {
   /* TODO: Do we actually need this? We can access the event by
    * priv->events[watchindex+1]. */
@@ -126,6 +165,24 @@ struct _InfStandaloneIoPrivate {
 
   gboolean polling;
   gboolean loop_running;
+
+  /* Stall detection. The stalls array is sorted by duration, longest
+   * first. */
+  guint stall_threshold;
+  InfStandaloneIoStall stalls[INF_STANDALONE_IO_MAX_STALLS];
+  guint n_stalls;
+};
+
+enum {
+  PROP_0,
+
+  PROP_STALL_THRESHOLD
+};
+
+enum {
+  STALL,
+
+  LAST_SIGNAL
 };
 
 #ifdef G_OS_WIN32
@@ -155,6 +212,8 @@ G_DEFINE_TYPE_WITH_CODE(InfStandaloneIo, inf_standalone_io, G_TYPE_OBJECT,
   G_ADD_PRIVATE(InfStandaloneIo)
   G_IMPLEMENT_INTERFACE(INF_TYPE_IO, inf_standalone_io_io_iface_init))
 
+static guint standalone_io_signals[LAST_SIGNAL];
+
 static guint
 inf_standalone_io_timeval_diff(GTimeVal* first,
                                GTimeVal* second)
@@ -168,6 +227,69 @@ inf_standalone_io_timeval_diff(GTimeVal* first,
          (first->tv_usec+500)/1000 - (second->tv_usec+500)/1000;
 }
 
+/* Call this only with the mutex locked */
+static void
+inf_standalone_io_record_stall(InfStandaloneIo* io,
+                               const InfStandaloneIoStall* stall)
+{
+  InfStandaloneIoPrivate* priv;
+  guint i;
+
+  priv = INF_STANDALONE_IO_PRIVATE(io);
+
+  if(priv->n_stalls == INF_STANDALONE_IO_MAX_STALLS &&
+     priv->stalls[priv->n_stalls - 1].duration >= stall->duration)
+  {
+    return;
+  }
+
+  if(priv->n_stalls < INF_STANDALONE_IO_MAX_STALLS)
+    ++priv->n_stalls;
+
+  /* Insertion sort; move shorter stalls one place back */
+  for(i = priv->n_stalls - 1;
+      i > 0 && priv->stalls[i - 1].duration < stall->duration;
+      --i)
+  {
+    priv->stalls[i] = priv->stalls[i - 1];
+  }
+
+  priv->stalls[i] = *stall;
+}
+
+/* Call this without the mutex locked, right after a callback returned
+ * which was started at begin. */
+static void
+inf_standalone_io_check_stall(InfStandaloneIo* io,
+                              guint threshold,
+                              gint64 begin,
+                              InfStandaloneIoCallbackType type,
+                              gpointer func,
+                              gpointer user_data)
+{
+  InfStandaloneIoPrivate* priv;
+  InfStandaloneIoStall stall;
+  gint64 end;
+
+  end = g_get_monotonic_time();
+  if(end - begin < (gint64)threshold * 1000)
+    return;
+
+  priv = INF_STANDALONE_IO_PRIVATE(io);
+
+  stall.type = type;
+  stall.func = func;
+  stall.user_data = user_data;
+  stall.duration = end - begin;
+  stall.time = g_get_real_time();
+
+  g_mutex_lock(&priv->mutex);
+  inf_standalone_io_record_stall(io, &stall);
+  g_mutex_unlock(&priv->mutex);
+
+  g_signal_emit(G_OBJECT(io), standalone_io_signals[STALL], 0, &stall);
+}
+
 /* Run one iteration of the main loop. Call this only with the mutex locked
  * and a local reference added to io. */
 static void
@@ -185,6 +307,8 @@ inf_standalone_io_iteration_impl(InfStandaloneIo* io,
   InfIoTimeout* cur_timeout;
   InfIoDispatch* dispatch;
   guint elapsed;
+  guint threshold;
+  gint64 begin;
 
 #ifdef G_OS_WIN32
   gchar* error_message;
@@ -238,6 +362,10 @@ inf_standalone_io_iteration_impl(InfStandaloneIo* io,
   g_mutex_lock(&priv->mutex);
   priv->polling = FALSE;
 
+  /* Callbacks are only timed if stall detection is enabled */
+  threshold = priv->stall_threshold;
+  begin = 0;
+
 #ifdef G_OS_WIN32
   switch(result)
   {
@@ -274,7 +402,21 @@ inf_standalone_io_iteration_impl(InfStandaloneIo* io,
         priv->timeouts = g_list_delete_link(priv->timeouts, item);
         g_mutex_unlock(&priv->mutex);
 
+        if(threshold > 0) begin = g_get_monotonic_time();
         cur_timeout->func(cur_timeout->user_data);
+
+        if(threshold > 0)
+        {
+          inf_standalone_io_check_stall(
+            io,
+            threshold,
+            begin,
+            INF_STANDALONE_IO_CALLBACK_TIMEOUT,
+            cur_timeout->func,
+            cur_timeout->user_data
+          );
+        }
+
         if(cur_timeout->notify)
           cur_timeout->notify(cur_timeout->user_data);
         g_slice_free(InfIoTimeout, cur_timeout);
@@ -326,8 +468,21 @@ inf_standalone_io_iteration_impl(InfStandaloneIo* io,
       watch->executing = TRUE;
       g_mutex_unlock(&priv->mutex);
 
+      if(threshold > 0) begin = g_get_monotonic_time();
       watch->func(watch->socket, events, watch->user_data);
 
+      if(threshold > 0)
+      {
+        inf_standalone_io_check_stall(
+          io,
+          threshold,
+          begin,
+          INF_STANDALONE_IO_CALLBACK_WATCH,
+          watch->func,
+          watch->user_data
+        );
+      }
+
       g_mutex_lock(&priv->mutex);
       watch->executing = FALSE;
       if(watch->disposed == TRUE)
@@ -410,8 +565,21 @@ inf_standalone_io_iteration_impl(InfStandaloneIo* io,
             watch->executing = TRUE;
             g_mutex_unlock(&priv->mutex);
 
+            if(threshold > 0) begin = g_get_monotonic_time();
             watch->func(watch->socket, events, watch->user_data);
 
+            if(threshold > 0)
+            {
+              inf_standalone_io_check_stall(
+                io,
+                threshold,
+                begin,
+                INF_STANDALONE_IO_CALLBACK_WATCH,
+                watch->func,
+                watch->user_data
+              );
+            }
+
             g_mutex_lock(&priv->mutex);
             watch->executing = FALSE;
             if(watch->disposed == TRUE)
@@ -437,7 +605,21 @@ inf_standalone_io_iteration_impl(InfStandaloneIo* io,
     priv->dispatchs = g_list_delete_link(priv->dispatchs, priv->dispatchs);
     g_mutex_unlock(&priv->mutex);
 
+    if(threshold > 0) begin = g_get_monotonic_time();
     dispatch->func(dispatch->user_data);
+
+    if(threshold > 0)
+    {
+      inf_standalone_io_check_stall(
+        io,
+        threshold,
+        begin,
+        INF_STANDALONE_IO_CALLBACK_DISPATCH,
+        dispatch->func,
+        dispatch->user_data
+      );
+    }
+
     if(dispatch->notify)
       dispatch->notify(dispatch->user_data);
     g_slice_free(InfIoDispatch, dispatch);
@@ -497,6 +679,9 @@ inf_standalone_io_init(InfStandaloneIo* io)
 
   priv->polling = FALSE;
   priv->loop_running = FALSE;
+
+  priv->stall_threshold = 0;
+  priv->n_stalls = 0;
 }
 
 static void
@@ -1056,6 +1241,56 @@ inf_standalone_io_io_remove_dispatch(InfIo* io,
   }
 }
 
+static void
+inf_standalone_io_set_property(GObject* object,
+                               guint prop_id,
+                               const GValue* value,
+                               GParamSpec* pspec)
+{
+  InfStandaloneIo* io;
+  InfStandaloneIoPrivate* priv;
+
+  io = INF_STANDALONE_IO(object);
+  priv = INF_STANDALONE_IO_PRIVATE(io);
+
+  switch(prop_id)
+  {
+  case PROP_STALL_THRESHOLD:
+    g_mutex_lock(&priv->mutex);
+    priv->stall_threshold = g_value_get_uint(value);
+    g_mutex_unlock(&priv->mutex);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    break;
+  }
+}
+
+static void
+inf_standalone_io_get_property(GObject* object,
+                               guint prop_id,
+                               GValue* value,
+                               GParamSpec* pspec)
+{
+  InfStandaloneIo* io;
+  InfStandaloneIoPrivate* priv;
+
+  io = INF_STANDALONE_IO(object);
+  priv = INF_STANDALONE_IO_PRIVATE(io);
+
+  switch(prop_id)
+  {
+  case PROP_STALL_THRESHOLD:
+    g_mutex_lock(&priv->mutex);
+    g_value_set_uint(value, priv->stall_threshold);
+    g_mutex_unlock(&priv->mutex);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    break;
+  }
+}
+
 static void
 inf_standalone_io_class_init(InfStandaloneIoClass* io_class)
 {
@@ -1063,6 +1298,46 @@ inf_standalone_io_class_init(InfStandaloneIoClass* io_class)
   object_class = G_OBJECT_CLASS(io_class);
 
   object_class->finalize = inf_standalone_io_finalize;
+  object_class->set_property = inf_standalone_io_set_property;
+  object_class->get_property = inf_standalone_io_get_property;
+
+  io_class->stall = NULL;
+
+  g_object_class_install_property(
+    object_class,
+    PROP_STALL_THRESHOLD,
+    g_param_spec_uint(
+      "stall-threshold",
+      "Stall threshold",
+      "Runtime in milliseconds above which a callback is considered to "
+      "stall the main loop, or 0 to disable stall detection",
+      0,
+      G_MAXUINT,
+      0,
+      G_PARAM_READWRITE
+    )
+  );
+
+  /**
+   * InfStandaloneIo::stall:
+   * @io: The #InfStandaloneIo emitting the signal.
+   * @stall: A #InfStandaloneIoStall describing the slow callback.
+   *
+   * This signal is emitted after a watch, timeout or dispatch callback has
+   * run for longer than #InfStandaloneIo:stall-threshold. It is emitted in
+   * the thread running the main loop, and only if the threshold is not 0.
+   */
+  standalone_io_signals[STALL] = g_signal_new(
+    "stall",
+    G_OBJECT_CLASS_TYPE(object_class),
+    G_SIGNAL_RUN_LAST,
+    G_STRUCT_OFFSET(InfStandaloneIoClass, stall),
+    NULL, NULL,
+    g_cclosure_marshal_VOID__POINTER,
+    G_TYPE_NONE,
+    1,
+    G_TYPE_POINTER /* const InfStandaloneIoStall* */
+  );
 }
 
 static void
@@ -1236,4 +1511,108 @@ inf_standalone_io_loop_running(InfStandaloneIo* io)
   return running;
 }
 
+/**
+ * inf_standalone_io_get_stalls:
+ * @io: A #InfStandaloneIo.
+ * @n_stalls: (out): Location to store the number of returned stalls.
+ *
+ * Returns the callbacks with the longest runtime above
+ * #InfStandaloneIo:stall-threshold since @io was created or
+ * inf_standalone_io_clear_stalls() was last called. At most 16 callbacks are
+ * remembered. They are sorted by their runtime, longest first.
+ *
+ * Returns: (transfer full) (array length=n_stalls) (allow-none): A newly
+ * allocated array of #InfStandaloneIoStall, or %NULL if there were no
+ * stalls. Free with g_free() when no longer needed.
+ **/
+InfStandaloneIoStall*
+inf_standalone_io_get_stalls(InfStandaloneIo* io,
+                             guint* n_stalls)
+{
+  InfStandaloneIoPrivate* priv;
+  InfStandaloneIoStall* stalls;
+
+  g_return_val_if_fail(INF_IS_STANDALONE_IO(io), NULL);
+  g_return_val_if_fail(n_stalls != NULL, NULL);
+
+  priv = INF_STANDALONE_IO_PRIVATE(io);
+
+  g_mutex_lock(&priv->mutex);
+
+  *n_stalls = priv->n_stalls;
+  stalls = NULL;
+  if(priv->n_stalls > 0)
+  {
+    stalls = g_memdup(
+      priv->stalls,
+      sizeof(InfStandaloneIoStall) * priv->n_stalls
+    );
+  }
+
+  g_mutex_unlock(&priv->mutex);
+  return stalls;
+}
+
+/**
+ * inf_standalone_io_clear_stalls:
+ * @io: A #InfStandaloneIo.
+ *
+ * Forgets all stalls recorded so far, so that inf_standalone_io_get_stalls()
+ * only returns stalls that occur after this call.
+ **/
+void
+inf_standalone_io_clear_stalls(InfStandaloneIo* io)
+{
+  InfStandaloneIoPrivate* priv;
+
+  g_return_if_fail(INF_IS_STANDALONE_IO(io));
+  priv = INF_STANDALONE_IO_PRIVATE(io);
+
+  g_mutex_lock(&priv->mutex);
+  priv->n_stalls = 0;
+  g_mutex_unlock(&priv->mutex);
+}
+
+/**
+ * inf_standalone_io_stall_get_function_name:
+ * @stall: A #InfStandaloneIoStall.
+ *
+ * Returns a human-readable name for the callback function of @stall. If the
+ * platform allows looking up symbols by address, this is the name of the
+ * function and the shared object it is defined in. Otherwise, or if the
+ * function is not exported, it is the address of the function.
+ *
+ * Returns: (transfer full): A newly allocated string. Free with g_free()
+ * when no longer needed.
+ **/
+gchar*
+inf_standalone_io_stall_get_function_name(const InfStandaloneIoStall* stall)
+{
+#ifdef HAVE_DLADDR
+  Dl_info info;
+#endif
+
+  g_return_val_if_fail(stall != NULL, NULL);
+
+#ifdef HAVE_DLADDR
+  /* Static functions have no entry in the dynamic symbol table, in which
+   * case dladdr() reports the closest preceding exported symbol. Only use
+   * the symbol name if it matches exactly, otherwise report the offset
+   * into the shared object, which can be resolved with addr2line(1). */
+  if(dladdr(stall->func, &info) != 0 && info.dli_fname != NULL)
+  {
+    if(info.dli_sname != NULL && info.dli_saddr == stall->func)
+      return g_strdup_printf("%s (%s)", info.dli_sname, info.dli_fname);
+
+    return g_strdup_printf(
+      "%s+0x%lx",
+      info.dli_fname,
+      (unsigned long)((const char*)stall->func - (const char*)info.dli_fbase)
+    );
+  }
+#endif
+
+  return g_strdup_printf("%p", stall->func);
+}
+
 /* vim:set et sw=2 ts=2: */
@@ -31,17 +31,62 @@ G_BEGIN_DECLS
 #define INF_IS_STANDALONE_IO_CLASS(klass)      (G_TYPE_CHECK_CLASS_TYPE((klass), INF_TYPE_STANDALONE_IO))
 #define INF_STANDALONE_IO_GET_CLASS(obj)       (G_TYPE_INSTANCE_GET_CLASS((obj), INF_TYPE_STANDALONE_IO, InfStandaloneIoClass))
 
+#define INF_TYPE_STANDALONE_IO_CALLBACK_TYPE   (inf_standalone_io_callback_type_get_type())
+
 typedef struct _InfStandaloneIo InfStandaloneIo;
 typedef struct _InfStandaloneIoClass InfStandaloneIoClass;
 
+/**
+ * InfStandaloneIoCallbackType:
+ * @INF_STANDALONE_IO_CALLBACK_WATCH: The callback of a #InfIoWatch.
+ * @INF_STANDALONE_IO_CALLBACK_TIMEOUT: The callback of a #InfIoTimeout.
+ * @INF_STANDALONE_IO_CALLBACK_DISPATCH: The callback of a #InfIoDispatch.
+ *
+ * The kind of callback that a #InfStandaloneIoStall refers to.
+ */
+typedef enum _InfStandaloneIoCallbackType {
+  INF_STANDALONE_IO_CALLBACK_WATCH,
+  INF_STANDALONE_IO_CALLBACK_TIMEOUT,
+  INF_STANDALONE_IO_CALLBACK_DISPATCH
+} InfStandaloneIoCallbackType;
+
+/**
+ * InfStandaloneIoStall:
+ * @type: The kind of callback that took long to run.
+ * @func: The callback function.
+ * @user_data: The user data passed to the callback.
+ * @duration: The time the callback took to run, in microseconds.
+ * @time: The wall-clock time at which the callback returned, as returned by
+ * g_get_real_time().
+ *
+ * Describes a callback of a #InfStandaloneIo whose runtime exceeded the
+ * #InfStandaloneIo:stall-threshold.
+ */
+typedef struct _InfStandaloneIoStall InfStandaloneIoStall;
+struct _InfStandaloneIoStall {
+  InfStandaloneIoCallbackType type;
+  gpointer func;
+  gpointer user_data;
+  guint64 duration;
+  gint64 time;
+};
+
 /**
  * InfStandaloneIoClass:
+ * @stall: Default signal handler for the #InfStandaloneIo::stall signal.
  *
- * This structure does not contain any public fields.
+ * This structure contains the default signal handlers of the
+ * #InfStandaloneIo class.
  */
 struct _InfStandaloneIoClass {
   /*< private >*/
   GObjectClass parent_class;
+
+  /*< public >*/
+
+  /* Signals */
+  void (*stall)(InfStandaloneIo* io,
+                const InfStandaloneIoStall* stall);
 };
 
 /**
@@ -55,6 +100,9 @@ struct _InfStandaloneIo {
   GObject parent;
 };
 
+GType
+inf_standalone_io_callback_type_get_type(void) G_GNUC_CONST;
+
 GType
 inf_standalone_io_get_type(void) G_GNUC_CONST;
 
@@ -77,6 +125,16 @@ inf_standalone_io_loop_quit(InfStandaloneIo* io);
 gboolean
 inf_standalone_io_loop_running(InfStandaloneIo* io);
 
+InfStandaloneIoStall*
+inf_standalone_io_get_stalls(InfStandaloneIo* io,
+                             guint* n_stalls);
+
+void
+inf_standalone_io_clear_stalls(InfStandaloneIo* io);
+
+gchar*
+inf_standalone_io_stall_get_function_name(const InfStandaloneIoStall* stall);
+
 G_END_DECLS
 
 #endif /* __INF_STANDALONE_IO_H__ */
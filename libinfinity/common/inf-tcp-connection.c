@@ -110,6 +110,10 @@ struct _InfTcpConnectionPrivate {
   gsize front_pos;
   gsize back_pos;
   gsize alloc;
+
+  guint high_watermark;
+  guint low_watermark;
+  gboolean congested;
 };
 
 enum {
@@ -127,7 +131,11 @@ enum {
   PROP_LOCAL_PORT,
 
   PROP_DEVICE_INDEX,
-  PROP_DEVICE_NAME
+  PROP_DEVICE_NAME,
+
+  PROP_SEND_QUEUE_HIGH_WATERMARK,
+  PROP_SEND_QUEUE_LOW_WATERMARK,
+  PROP_CONGESTED
 };
 
 enum {
@@ -223,7 +231,9 @@ inf_tcp_connection_configure_socket(InfNativeSocket socket,
     return FALSE;
   }
 
-  if(fcntl(socket, F_SETFL, result | O_NONBLOCK) == -1)
+  /* Sockets accepted with accept4() are already non-blocking */
+  if((result & O_NONBLOCK) == 0 &&
+     fcntl(socket, F_SETFL, result | O_NONBLOCK) == -1)
   {
     errcode = INF_NATIVE_SOCKET_LAST_ERROR;
     inf_native_socket_make_error(errcode, error);
@@ -269,6 +279,36 @@ inf_tcp_connection_system_error(InfTcpConnection* connection,
   g_error_free(error);
 }
 
+/* Sets the congested flag when the send queue has grown beyond the high
+ * watermark, and clears it again once it has been drained below the low
+ * watermark. */
+static void
+inf_tcp_connection_update_congested(InfTcpConnection* connection)
+{
+  InfTcpConnectionPrivate* priv;
+  gsize length;
+
+  priv = INF_TCP_CONNECTION_PRIVATE(connection);
+  length = priv->front_pos - priv->back_pos;
+
+  if(priv->congested == FALSE)
+  {
+    if(priv->high_watermark > 0 && length > priv->high_watermark)
+    {
+      priv->congested = TRUE;
+      g_object_notify(G_OBJECT(connection), "congested");
+    }
+  }
+  else
+  {
+    if(priv->high_watermark == 0 || length <= priv->low_watermark)
+    {
+      priv->congested = FALSE;
+      g_object_notify(G_OBJECT(connection), "congested");
+    }
+  }
+}
+
 static void
 inf_tcp_connection_io(InfNativeSocket* socket,
                       InfIoEvent events,
@@ -729,6 +769,8 @@ inf_tcp_connection_io_outgoing(InfTcpConnection* connection)
         inf_io_update_watch(priv->io, priv->watch, priv->events);
       }
 
+      inf_tcp_connection_update_congested(connection);
+
       g_signal_emit(
         G_OBJECT(connection),
         tcp_connection_signals[SENT],
@@ -914,6 +956,10 @@ inf_tcp_connection_init(InfTcpConnection* connection)
   priv->front_pos = 0;
   priv->back_pos = 0;
   priv->alloc = 1024;
+
+  priv->high_watermark = 0;
+  priv->low_watermark = 0;
+  priv->congested = FALSE;
 }
 
 static void
@@ -1045,6 +1091,16 @@ inf_tcp_connection_set_property(GObject* object,
     }
 #endif
     break;
+  case PROP_SEND_QUEUE_HIGH_WATERMARK:
+    priv->high_watermark = g_value_get_uint(value);
+    if(priv->status == INF_TCP_CONNECTION_CONNECTED)
+      inf_tcp_connection_update_congested(connection);
+    break;
+  case PROP_SEND_QUEUE_LOW_WATERMARK:
+    priv->low_watermark = g_value_get_uint(value);
+    if(priv->status == INF_TCP_CONNECTION_CONNECTED)
+      inf_tcp_connection_update_congested(connection);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
@@ -1158,6 +1214,15 @@ inf_tcp_connection_get_property(GObject* object,
     }
 #endif
     break;
+  case PROP_SEND_QUEUE_HIGH_WATERMARK:
+    g_value_set_uint(value, priv->high_watermark);
+    break;
+  case PROP_SEND_QUEUE_LOW_WATERMARK:
+    g_value_set_uint(value, priv->low_watermark);
+    break;
+  case PROP_CONGESTED:
+    g_value_set_boolean(value, priv->congested);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
@@ -1331,6 +1396,67 @@ inf_tcp_connection_class_init(InfTcpConnectionClass* tcp_connection_class)
     )
   );
 
+  /**
+   * InfTcpConnection:send-queue-high-watermark:
+   *
+   * When more than this many bytes are waiting in the send queue, because
+   * the remote site does not read fast enough, the connection is considered
+   * congested. 0 means the connection never becomes congested.
+   */
+  g_object_class_install_property(
+    object_class,
+    PROP_SEND_QUEUE_HIGH_WATERMARK,
+    g_param_spec_uint(
+      "send-queue-high-watermark",
+      "Send queue high watermark",
+      "Number of queued bytes above which the connection is congested",
+      0,
+      G_MAXUINT,
+      0,
+      G_PARAM_READWRITE
+    )
+  );
+
+  /**
+   * InfTcpConnection:send-queue-low-watermark:
+   *
+   * A congested connection is no longer considered congested as soon as no
+   * more than this many bytes are waiting in the send queue.
+   */
+  g_object_class_install_property(
+    object_class,
+    PROP_SEND_QUEUE_LOW_WATERMARK,
+    g_param_spec_uint(
+      "send-queue-low-watermark",
+      "Send queue low watermark",
+      "Number of queued bytes at which congestion ends",
+      0,
+      G_MAXUINT,
+      0,
+      G_PARAM_READWRITE
+    )
+  );
+
+  /**
+   * InfTcpConnection:congested:
+   *
+   * Whether the send queue has grown above
+   * #InfTcpConnection:send-queue-high-watermark and has not yet been drained
+   * to #InfTcpConnection:send-queue-low-watermark. Upper layers can watch
+   * this property to stop producing data for a slow consumer.
+   */
+  g_object_class_install_property(
+    object_class,
+    PROP_CONGESTED,
+    g_param_spec_boolean(
+      "congested",
+      "Congested",
+      "Whether the remote site does not keep up reading sent data",
+      FALSE,
+      G_PARAM_READABLE
+    )
+  );
+
   /**
    * InfTcpConnection::sent:
    * @connection: The #InfTcpConnection through which the data has been sent.
@@ -1591,6 +1717,12 @@ inf_tcp_connection_close(InfTcpConnection* connection)
   priv->front_pos = 0;
   priv->back_pos = 0;
 
+  if(priv->congested == TRUE)
+  {
+    priv->congested = FALSE;
+    g_object_notify(G_OBJECT(connection), "congested");
+  }
+
   priv->status = INF_TCP_CONNECTION_CLOSED;
   g_object_notify(G_OBJECT(connection), "status");
 }
@@ -1692,6 +1824,8 @@ inf_tcp_connection_send(InfTcpConnection* connection,
       priv->events |= INF_IO_OUTGOING;
       inf_io_update_watch(priv->io, priv->watch, priv->events);
     }
+
+    inf_tcp_connection_update_congested(connection);
   }
 
   if(sent_len > 0)
@@ -1741,6 +1875,42 @@ inf_tcp_connection_get_remote_port(InfTcpConnection* connection)
   return INF_TCP_CONNECTION_PRIVATE(connection)->remote_port;
 }
 
+/**
+ * inf_tcp_connection_get_send_queue_length:
+ * @connection: A #InfTcpConnection.
+ *
+ * Returns the number of bytes that have been passed to
+ * inf_tcp_connection_send() but could not yet be handed to the kernel.
+ *
+ * Returns: The number of bytes waiting in the send queue.
+ **/
+gsize
+inf_tcp_connection_get_send_queue_length(InfTcpConnection* connection)
+{
+  InfTcpConnectionPrivate* priv;
+
+  g_return_val_if_fail(INF_IS_TCP_CONNECTION(connection), 0);
+
+  priv = INF_TCP_CONNECTION_PRIVATE(connection);
+  return priv->front_pos - priv->back_pos;
+}
+
+/**
+ * inf_tcp_connection_get_congested:
+ * @connection: A #InfTcpConnection.
+ *
+ * Returns whether @connection is currently congested, see
+ * #InfTcpConnection:congested.
+ *
+ * Returns: %TRUE if @connection is congested, or %FALSE otherwise.
+ **/
+gboolean
+inf_tcp_connection_get_congested(InfTcpConnection* connection)
+{
+  g_return_val_if_fail(INF_IS_TCP_CONNECTION(connection), FALSE);
+  return INF_TCP_CONNECTION_PRIVATE(connection)->congested;
+}
+
 /**
  * inf_tcp_connection_set_keepalive:
  * @connection: A #InfTcpConnection.
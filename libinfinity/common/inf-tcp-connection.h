@@ -137,6 +137,12 @@ inf_tcp_connection_get_remote_address(InfTcpConnection* connection);
 guint
 inf_tcp_connection_get_remote_port(InfTcpConnection* connection);
 
+gsize
+inf_tcp_connection_get_send_queue_length(InfTcpConnection* connection);
+
+gboolean
+inf_tcp_connection_get_congested(InfTcpConnection* connection);
+
 gboolean
 inf_tcp_connection_set_keepalive(InfTcpConnection* connection,
                                  const InfKeepalive* keepalive,
@@ -0,0 +1,351 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/**
+ * SECTION:inf-trace
+ * @title: Tracing
+ * @short_description: Latency histograms of internal code paths
+ * @include: libinfinity/common/inf-trace.h
+ * @stability: Unstable
+ *
+ * When libinfinity is configured with --enable-tracing, it records values
+ * such as execution times at a number of places in its hot paths, which are
+ * listed in #InfTraceProbe. Values are collected in a logarithmic histogram
+ * per probe and per thread, so that recording a value does not need any
+ * locking. inf_trace_get_histogram() sums up the histograms of all threads.
+ *
+ * Without tracing support, the probes compile to nothing, and all
+ * histograms stay empty. inf_trace_is_enabled() tells whether tracing
+ * support is available.
+ */
+
+#include <libinfinity/common/inf-trace.h>
+#include <libinfinity/inf-define-enum.h>
+
+#include <string.h>
+
+#ifndef G_OS_WIN32
+# include <time.h>
+#endif
+
+typedef struct _InfTraceThread InfTraceThread;
+struct _InfTraceThread {
+  InfTraceHistogram histograms[INF_TRACE_N_PROBES];
+};
+
+static const GEnumValue inf_trace_probe_values[] = {
+  {
+    INF_TRACE_XMPP_RECEIVE,
+    "INF_TRACE_XMPP_RECEIVE",
+    "xmpp-receive"
+  }, {
+    INF_TRACE_ALGORITHM_EXECUTE,
+    "INF_TRACE_ALGORITHM_EXECUTE",
+    "algorithm-execute"
+  }, {
+    INF_TRACE_ALGORITHM_TRANSFORMATIONS,
+    "INF_TRACE_ALGORITHM_TRANSFORMATIONS",
+    "algorithm-transformations"
+  }, {
+    INF_TRACE_REGISTRY_QUEUE_DEPTH,
+    "INF_TRACE_REGISTRY_QUEUE_DEPTH",
+    "registry-queue-depth"
+  }, {
+    INF_TRACE_STORAGE_READ,
+    "INF_TRACE_STORAGE_READ",
+    "storage-read"
+  }, {
+    INF_TRACE_STORAGE_WRITE,
+    "INF_TRACE_STORAGE_WRITE",
+    "storage-write"
+  }, {
+    INF_TRACE_SYNC_DURATION,
+    "INF_TRACE_SYNC_DURATION",
+    "sync-duration"
+  }, {
+    INF_TRACE_SYNC_MESSAGES,
+    "INF_TRACE_SYNC_MESSAGES",
+    "sync-messages"
+  }, {
+    0,
+    NULL,
+    NULL
+  }
+};
+
+INF_DEFINE_ENUM_TYPE(InfTraceProbe, inf_trace_probe, inf_trace_probe_values)
+
+static void
+inf_trace_thread_free(gpointer data);
+
+static GMutex inf_trace_mutex;
+static GSList* inf_trace_threads;
+/* Values recorded by threads that have exited */
+static InfTraceHistogram inf_trace_retired[INF_TRACE_N_PROBES];
+static GPrivate inf_trace_thread = G_PRIVATE_INIT(inf_trace_thread_free);
+
+static void
+inf_trace_histogram_merge(InfTraceHistogram* target,
+                          const InfTraceHistogram* source)
+{
+  guint i;
+
+  target->count += source->count;
+  target->sum += source->sum;
+  if(source->max > target->max)
+    target->max = source->max;
+
+  for(i = 0; i < INF_TRACE_N_BUCKETS; ++i)
+    target->buckets[i] += source->buckets[i];
+}
+
+static void
+inf_trace_thread_free(gpointer data)
+{
+  InfTraceThread* thread;
+  guint i;
+
+  thread = (InfTraceThread*)data;
+
+  g_mutex_lock(&inf_trace_mutex);
+  for(i = 0; i < INF_TRACE_N_PROBES; ++i)
+    inf_trace_histogram_merge(&inf_trace_retired[i], &thread->histograms[i]);
+  inf_trace_threads = g_slist_remove(inf_trace_threads, thread);
+  g_mutex_unlock(&inf_trace_mutex);
+
+  g_free(thread);
+}
+
+/**
+ * inf_trace_is_enabled:
+ *
+ * Returns whether libinfinity has been built with tracing support. If not,
+ * no values are recorded by libinfinity itself.
+ *
+ * Returns: Whether tracing support is available.
+ */
+gboolean
+inf_trace_is_enabled(void)
+{
+#ifdef LIBINFINITY_HAVE_TRACING
+  return TRUE;
+#else
+  return FALSE;
+#endif
+}
+
+/**
+ * inf_trace_probe_get_name:
+ * @probe: A #InfTraceProbe.
+ *
+ * Returns a short name for @probe, such as "algorithm-execute", which can be
+ * used to identify it in logs or metrics.
+ *
+ * Returns: A static string.
+ */
+const gchar*
+inf_trace_probe_get_name(InfTraceProbe probe)
+{
+  g_return_val_if_fail(probe < INF_TRACE_N_PROBES, NULL);
+  return inf_trace_probe_values[probe].value_nick;
+}
+
+/**
+ * inf_trace_probe_get_unit:
+ * @probe: A #InfTraceProbe.
+ *
+ * Returns the unit of the values recorded for @probe, which is either "ns"
+ * for times in nanoseconds or "count" for plain numbers.
+ *
+ * Returns: A static string.
+ */
+const gchar*
+inf_trace_probe_get_unit(InfTraceProbe probe)
+{
+  g_return_val_if_fail(probe < INF_TRACE_N_PROBES, NULL);
+
+  switch(probe)
+  {
+  case INF_TRACE_ALGORITHM_TRANSFORMATIONS:
+  case INF_TRACE_REGISTRY_QUEUE_DEPTH:
+  case INF_TRACE_SYNC_MESSAGES:
+    return "count";
+  default:
+    return "ns";
+  }
+}
+
+/**
+ * inf_trace_now:
+ *
+ * Returns the current time of a monotonic clock in nanoseconds. The clock
+ * has no defined starting point, so only differences between two values are
+ * meaningful.
+ *
+ * Returns: The current time in nanoseconds.
+ */
+guint64
+inf_trace_now(void)
+{
+#ifdef G_OS_WIN32
+  return (guint64)g_get_monotonic_time() * 1000;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (guint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+/**
+ * inf_trace_record:
+ * @probe: The #InfTraceProbe to record a value for.
+ * @value: The value to record.
+ *
+ * Adds @value to the histogram of @probe for the calling thread. This
+ * function does not need to take a lock except for the first call in a
+ * thread. Usually this is not called directly but via INF_TRACE_END() or
+ * INF_TRACE_VALUE().
+ */
+void
+inf_trace_record(InfTraceProbe probe,
+                 guint64 value)
+{
+  InfTraceThread* thread;
+  InfTraceHistogram* histogram;
+  guint bucket;
+
+  g_return_if_fail(probe < INF_TRACE_N_PROBES);
+
+  thread = g_private_get(&inf_trace_thread);
+  if(thread == NULL)
+  {
+    thread = g_new0(InfTraceThread, 1);
+    g_private_set(&inf_trace_thread, thread);
+
+    g_mutex_lock(&inf_trace_mutex);
+    inf_trace_threads = g_slist_prepend(inf_trace_threads, thread);
+    g_mutex_unlock(&inf_trace_mutex);
+  }
+
+  histogram = &thread->histograms[probe];
+  ++histogram->count;
+  histogram->sum += value;
+  if(value > histogram->max)
+    histogram->max = value;
+
+  /* The bucket index is the number of significant bits */
+  for(bucket = 0; value != 0 && bucket < INF_TRACE_N_BUCKETS - 1; ++bucket)
+    value >>= 1;
+  ++histogram->buckets[bucket];
+}
+
+/**
+ * inf_trace_get_histogram:
+ * @probe: A #InfTraceProbe.
+ * @histogram: (out caller-allocates): Location to store the histogram.
+ *
+ * Sums up the values recorded for @probe in all threads since startup or
+ * the last call to inf_trace_reset(). Values that are recorded by other
+ * threads concurrently might or might not be included.
+ */
+void
+inf_trace_get_histogram(InfTraceProbe probe,
+                        InfTraceHistogram* histogram)
+{
+  InfTraceThread* thread;
+  GSList* item;
+
+  g_return_if_fail(probe < INF_TRACE_N_PROBES);
+  g_return_if_fail(histogram != NULL);
+
+  g_mutex_lock(&inf_trace_mutex);
+
+  *histogram = inf_trace_retired[probe];
+  for(item = inf_trace_threads; item != NULL; item = item->next)
+  {
+    thread = (InfTraceThread*)item->data;
+    inf_trace_histogram_merge(histogram, &thread->histograms[probe]);
+  }
+
+  g_mutex_unlock(&inf_trace_mutex);
+}
+
+/**
+ * inf_trace_histogram_get_percentile:
+ * @histogram: A #InfTraceHistogram.
+ * @percentile: A value between 0.0 and 1.0.
+ *
+ * Estimates the value below which the given fraction of the values in
+ * @histogram lies. Since the histogram only records the magnitude of
+ * values, the result is the upper bound of the bucket containing the
+ * percentile, but never more than the largest recorded value.
+ *
+ * Returns: The estimated percentile, or 0 if @histogram is empty.
+ */
+guint64
+inf_trace_histogram_get_percentile(const InfTraceHistogram* histogram,
+                                   gdouble percentile)
+{
+  guint64 rank;
+  guint64 seen;
+  guint64 bound;
+  guint i;
+
+  g_return_val_if_fail(histogram != NULL, 0);
+
+  if(histogram->count == 0) return 0;
+
+  rank = (guint64)(percentile * histogram->count);
+  if(rank >= histogram->count) rank = histogram->count - 1;
+
+  seen = 0;
+  for(i = 0; i < INF_TRACE_N_BUCKETS - 1; ++i)
+  {
+    seen += histogram->buckets[i];
+    if(seen > rank) break;
+  }
+
+  bound = (G_GUINT64_CONSTANT(1) << i) - 1;
+  return MIN(bound, histogram->max);
+}
+
+/**
+ * inf_trace_reset:
+ *
+ * Discards all values recorded so far.
+ */
+void
+inf_trace_reset(void)
+{
+  InfTraceThread* thread;
+  GSList* item;
+
+  g_mutex_lock(&inf_trace_mutex);
+
+  memset(inf_trace_retired, 0, sizeof(inf_trace_retired));
+  for(item = inf_trace_threads; item != NULL; item = item->next)
+  {
+    thread = (InfTraceThread*)item->data;
+    memset(thread->histograms, 0, sizeof(thread->histograms));
+  }
+
+  g_mutex_unlock(&inf_trace_mutex);
+}
+
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,175 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef __INF_TRACE_H__
+#define __INF_TRACE_H__
+
+#include <libinfinity/inf-config.h> /* For LIBINFINITY_HAVE_TRACING */
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define INF_TYPE_TRACE_PROBE (inf_trace_probe_get_type())
+
+/**
+ * INF_TRACE_N_BUCKETS:
+ *
+ * The number of buckets in a #InfTraceHistogram.
+ */
+#define INF_TRACE_N_BUCKETS 64
+
+/**
+ * InfTraceProbe:
+ * @INF_TRACE_XMPP_RECEIVE: Time in nanoseconds to decode and parse data
+ * received by a #InfXmppConnection, including the processing of the parsed
+ * messages.
+ * @INF_TRACE_ALGORITHM_EXECUTE: Time in nanoseconds to execute a request
+ * with inf_adopted_algorithm_execute_request().
+ * @INF_TRACE_ALGORITHM_TRANSFORMATIONS: Number of transformations needed to
+ * execute a request.
+ * @INF_TRACE_REGISTRY_QUEUE_DEPTH: Number of messages queued for a
+ * connection when inf_communication_registry_send() is called.
+ * @INF_TRACE_STORAGE_READ: Time in nanoseconds to read a document from
+ * storage.
+ * @INF_TRACE_STORAGE_WRITE: Time in nanoseconds to write a document to
+ * storage.
+ * @INF_TRACE_SYNC_DURATION: Time in nanoseconds between the start of a
+ * synchronization to another host and its acknowledgement.
+ * @INF_TRACE_SYNC_MESSAGES: Number of messages sent for a synchronization
+ * to another host.
+ * @INF_TRACE_N_PROBES: The number of probes.
+ *
+ * The measurement points at which libinfinity records values when it was
+ * built with tracing support.
+ */
+typedef enum _InfTraceProbe {
+  INF_TRACE_XMPP_RECEIVE,
+  INF_TRACE_ALGORITHM_EXECUTE,
+  INF_TRACE_ALGORITHM_TRANSFORMATIONS,
+  INF_TRACE_REGISTRY_QUEUE_DEPTH,
+  INF_TRACE_STORAGE_READ,
+  INF_TRACE_STORAGE_WRITE,
+  INF_TRACE_SYNC_DURATION,
+  INF_TRACE_SYNC_MESSAGES,
+
+  INF_TRACE_N_PROBES
+} InfTraceProbe;
+
+/**
+ * InfTraceHistogram:
+ * @count: The number of recorded values.
+ * @sum: The sum of all recorded values.
+ * @max: The largest recorded value.
+ * @buckets: The number of recorded values by magnitude. Bucket 0 counts the
+ * value 0, and bucket @i counts values from 2^(@i - 1) up to 2^@i - 1. The
+ * last bucket also counts all larger values.
+ *
+ * Aggregated values of a #InfTraceProbe.
+ */
+typedef struct _InfTraceHistogram InfTraceHistogram;
+struct _InfTraceHistogram {
+  guint64 count;
+  guint64 sum;
+  guint64 max;
+  guint64 buckets[INF_TRACE_N_BUCKETS];
+};
+
+/**
+ * INF_TRACE_DECLARE:
+ * @var: Name of the variable to declare.
+ *
+ * Declares a variable holding the start time of a measurement. If
+ * libinfinity is built without tracing support, this variable is unused.
+ */
+
+/**
+ * INF_TRACE_BEGIN:
+ * @var: A variable declared with INF_TRACE_DECLARE().
+ *
+ * Starts a time measurement. If libinfinity is built without tracing
+ * support, this does nothing.
+ */
+
+/**
+ * INF_TRACE_END:
+ * @probe: The #InfTraceProbe to record the measurement for.
+ * @var: A variable passed to INF_TRACE_BEGIN() before.
+ *
+ * Records the time elapsed since INF_TRACE_BEGIN() was called with @var.
+ * If libinfinity is built without tracing support, this does nothing.
+ */
+
+/**
+ * INF_TRACE_VALUE:
+ * @probe: The #InfTraceProbe to record the value for.
+ * @value: The value to record.
+ *
+ * Records @value for @probe. If libinfinity is built without tracing
+ * support, @value is not evaluated.
+ */
+#ifdef LIBINFINITY_HAVE_TRACING
+# define INF_TRACE_DECLARE(var) guint64 var
+# define INF_TRACE_BEGIN(var) ((var) = inf_trace_now())
+# define INF_TRACE_END(probe, var) \
+  inf_trace_record((probe), inf_trace_now() - (var))
+# define INF_TRACE_VALUE(probe, value) \
+  inf_trace_record((probe), (guint64)(value))
+#else
+# define INF_TRACE_DECLARE(var) G_GNUC_UNUSED guint64 var
+# define INF_TRACE_BEGIN(var) G_STMT_START { } G_STMT_END
+# define INF_TRACE_END(probe, var) G_STMT_START { } G_STMT_END
+# define INF_TRACE_VALUE(probe, value) G_STMT_START { } G_STMT_END
+#endif
+
+GType
+inf_trace_probe_get_type(void) G_GNUC_CONST;
+
+gboolean
+inf_trace_is_enabled(void);
+
+const gchar*
+inf_trace_probe_get_name(InfTraceProbe probe);
+
+const gchar*
+inf_trace_probe_get_unit(InfTraceProbe probe);
+
+guint64
+inf_trace_now(void);
+
+void
+inf_trace_record(InfTraceProbe probe,
+                 guint64 value);
+
+void
+inf_trace_get_histogram(InfTraceProbe probe,
+                        InfTraceHistogram* histogram);
+
+guint64
+inf_trace_histogram_get_percentile(const InfTraceHistogram* histogram,
+                                   gdouble percentile);
+
+void
+inf_trace_reset(void);
+
+G_END_DECLS
+
+#endif /* __INF_TRACE_H__ */
+
+/* vim:set et sw=2 ts=2: */
@@ -222,6 +222,43 @@ inf_xml_connection_default_init(InfXmlConnectionInterface* iface)
       G_PARAM_READABLE
     )
   );
+
+  /**
+   * InfXmlConnection:congested:
+   *
+   * Whether the remote site does not keep up with reading the data sent to
+   * it, so that outgoing data piles up locally. Upper layers should avoid
+   * sending more data than necessary while a connection is congested, and
+   * may decide to stop serving it altogether.
+   */
+  g_object_interface_install_property(
+    iface,
+    g_param_spec_boolean(
+      "congested",
+      "Congested",
+      "Whether outgoing data is piling up on the connection",
+      FALSE,
+      G_PARAM_READABLE
+    )
+  );
+
+  /**
+   * InfXmlConnection:detects-congestion:
+   *
+   * Whether the connection limits the amount of data it buffers locally,
+   * and reports #InfXmlConnection:congested when the limit is exceeded.
+   * Connections that do not detect congestion never become congested.
+   */
+  g_object_interface_install_property(
+    iface,
+    g_param_spec_boolean(
+      "detects-congestion",
+      "Detects congestion",
+      "Whether the connection can become congested",
+      FALSE,
+      G_PARAM_READABLE
+    )
+  );
 }
 
 /**
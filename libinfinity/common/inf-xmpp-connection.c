@@ -40,6 +40,7 @@
 #include <libinfinity/common/inf-xml-util.h>
 #include <libinfinity/common/inf-ip-address.h>
 #include <libinfinity/common/inf-error.h>
+#include <libinfinity/common/inf-trace.h>
 
 #include <libinfinity/inf-i18n.h>
 #include <libinfinity/inf-signals.h>
@@ -198,6 +199,14 @@ struct _InfXmppConnectionPrivate {
   gchar* sasl_remote_mechanisms;
 
   GError* sasl_error;
+
+  /* Stream error to answer the initial <stream:stream> with, see
+   * inf_xmpp_connection_reject(). */
+  gboolean reject;
+  InfXmppConnectionStreamError reject_code;
+  gchar* reject_message;
+
+  InfXmppConnectionStatistics statistics;
 };
 
 enum {
@@ -221,7 +230,9 @@ enum {
   PROP_LOCAL_ID,
   PROP_REMOTE_ID,
   PROP_LOCAL_CERTIFICATE,
-  PROP_REMOTE_CERTIFICATE
+  PROP_REMOTE_CERTIFICATE,
+  PROP_CONGESTED,
+  PROP_DETECTS_CONGESTION
 };
 
 #define INF_XMPP_CONNECTION_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE((obj), INF_TYPE_XMPP_CONNECTION, InfXmppConnectionPrivate))
@@ -610,6 +621,27 @@ inf_xmpp_connection_pop_message(InfXmppConnection* connection)
   g_slice_free(InfXmppConnectionMessage, message);
 }
 
+/* Remembers the TLS session of a client-side connection in the
+ * credentials, so that the next connection to the same host can resume it
+ * without a full handshake. */
+static void
+inf_xmpp_connection_tls_store_session(InfXmppConnection* xmpp)
+{
+  InfXmppConnectionPrivate* priv;
+  priv = INF_XMPP_CONNECTION_PRIVATE(xmpp);
+
+  if(priv->site == INF_XMPP_CONNECTION_CLIENT &&
+     priv->remote_hostname != NULL && priv->creds != NULL &&
+     priv->session != NULL && priv->status != INF_XMPP_CONNECTION_HANDSHAKING)
+  {
+    inf_certificate_credentials_store_session(
+      priv->creds,
+      priv->remote_hostname,
+      priv->session
+    );
+  }
+}
+
 /* Note that this function does not change the state of xmpp, so it might
  * rest in a state where it expects to actually have the resources available
  * that are cleared here. Be sure to adjust state after having called
@@ -657,6 +689,11 @@ inf_xmpp_connection_clear(InfXmppConnection* xmpp)
 
   if(priv->session != NULL)
   {
+    /* With TLS 1.3, the server sends the session ticket only after the
+     * handshake, so store the session again now that we have probably
+     * received it. */
+    inf_xmpp_connection_tls_store_session(xmpp);
+
     gnutls_deinit(priv->session);
     priv->session = NULL;
 
@@ -1285,6 +1322,8 @@ inf_xmpp_connection_tls_handshake(InfXmppConnection* xmpp)
     priv->status = INF_XMPP_CONNECTION_CONNECTED;
     g_object_notify(G_OBJECT(xmpp), "tls-enabled");
 
+    inf_xmpp_connection_tls_store_session(xmpp);
+
     error = NULL;
 
     /* Extract own certificate */
@@ -1357,6 +1396,17 @@ inf_xmpp_connection_tls_handshake(InfXmppConnection* xmpp)
     inf_xml_connection_error(INF_XML_CONNECTION(xmpp), error);
     g_error_free(error);
 
+    /* Do not try to resume the session next time, in case the stored
+     * session caused the handshake to fail. */
+    if(priv->site == INF_XMPP_CONNECTION_CLIENT &&
+       priv->remote_hostname != NULL)
+    {
+      inf_certificate_credentials_forget_session(
+        priv->creds,
+        priv->remote_hostname
+      );
+    }
+
     gnutls_deinit(priv->session);
     priv->session = NULL;
 
@@ -1389,6 +1439,7 @@ static void
 inf_xmpp_connection_tls_init(InfXmppConnection* xmpp)
 {
   InfXmppConnectionPrivate* priv;
+  const gnutls_datum_t* ticket_key;
 
   priv = INF_XMPP_CONNECTION_PRIVATE(xmpp);
   g_assert(priv->session == NULL);
@@ -1410,10 +1461,27 @@ inf_xmpp_connection_tls_init(InfXmppConnection* xmpp)
   {
   case INF_XMPP_CONNECTION_CLIENT:
     gnutls_init(&priv->session, GNUTLS_CLIENT);
+
+    /* Try to resume a previous session with the same host, which saves
+     * the certificate exchange and key agreement of a full handshake. */
+    if(priv->remote_hostname != NULL)
+    {
+      inf_certificate_credentials_restore_session(
+        priv->creds,
+        priv->remote_hostname,
+        priv->session
+      );
+    }
+
     break;
   case INF_XMPP_CONNECTION_SERVER:
     gnutls_init(&priv->session, GNUTLS_SERVER);
 
+    ticket_key =
+      inf_certificate_credentials_get_session_ticket_key(priv->creds);
+    if(ticket_key != NULL)
+      gnutls_session_ticket_enable_server(priv->session, ticket_key);
+
     /* If the user wants to check the client's certificate, then require
      * that the client sends one. */
     if(priv->certificate_callback != NULL)
@@ -1557,8 +1625,9 @@ inf_xmpp_connection_sasl_error(InfXmppConnection* xmpp,
 
   if(priv->site == INF_XMPP_CONNECTION_SERVER)
   {
-    /* Find matching auth error code to send to client */
-    switch(error->code)
+    /* Find matching auth error code to send to client. Errors from other
+     * domains, such as a busy SASL context, are temporary failures. */
+    switch(error->domain == inf_gsasl_error_quark() ? error->code : -1)
     {
     case GSASL_UNKNOWN_MECHANISM:
     case GSASL_MECHANISM_PARSE_ERROR:
@@ -1575,6 +1644,13 @@ inf_xmpp_connection_sasl_error(InfXmppConnection* xmpp,
       break;
     }
 
+    /* Let the client know why authentication failed */
+    if(error->domain == inf_authentication_detail_error_quark() &&
+       priv->sasl_error == NULL)
+    {
+      priv->sasl_error = g_error_copy(error);
+    }
+
     inf_xmpp_connection_send_auth_error(xmpp, auth_code);
 
     /* Reset state to INITIATED so that the client can retry */
@@ -2069,6 +2145,44 @@ inf_xmpp_connection_process_connected(InfXmppConnection* xmpp,
   }
 }
 
+/* Answers the initial <stream:stream> of a rejected client with our own
+ * <stream:stream>, followed by the stream error that was passed to
+ * inf_xmpp_connection_reject(), without offering any stream features. */
+static void
+inf_xmpp_connection_process_rejected(InfXmppConnection* xmpp)
+{
+  static const gchar xmpp_connection_initial_request[] =
+    "<stream:stream xmlns:stream=\"http://etherx.jabber.org/streams\" "
+    "xmlns=\"jabber:client\" version=\"1.0\" from=\"%s\">";
+
+  InfXmppConnectionPrivate* priv;
+  gchar* reply;
+
+  priv = INF_XMPP_CONNECTION_PRIVATE(xmpp);
+  g_assert(priv->site == INF_XMPP_CONNECTION_SERVER);
+  g_assert(priv->reject == TRUE);
+
+  reply = g_strdup_printf(
+    xmpp_connection_initial_request,
+    priv->local_hostname
+  );
+
+  inf_xmpp_connection_send_chars(xmpp, reply, strlen(reply));
+  g_free(reply);
+
+  /* Sending might have failed */
+  if(priv->status == INF_XMPP_CONNECTION_CLOSED)
+    return;
+
+  priv->status = INF_XMPP_CONNECTION_INITIATED;
+
+  inf_xmpp_connection_terminate_error(
+    xmpp,
+    priv->reject_code,
+    priv->reject_message
+  );
+}
+
 static void
 inf_xmpp_connection_process_initiated(InfXmppConnection* xmpp,
                                       xmlNodePtr xml)
@@ -2703,6 +2817,7 @@ inf_xmpp_connection_process_end_element(InfXmppConnection* xmpp,
         inf_xmpp_connection_process_authentication(xmpp, priv->root);
         break;
       case INF_XMPP_CONNECTION_READY:
+        ++priv->statistics.n_messages_received;
         inf_xml_connection_received(INF_XML_CONNECTION(xmpp), priv->root);
         break;
       case INF_XMPP_CONNECTION_CLOSING_STREAM:
@@ -2766,7 +2881,10 @@ inf_xmpp_connection_sax_start_element(void* context,
     else
     {
       /* Got <stream:stream> from client, send response */
-      inf_xmpp_connection_process_connected(xmpp, attrs);
+      if(priv->reject)
+        inf_xmpp_connection_process_rejected(xmpp);
+      else
+        inf_xmpp_connection_process_connected(xmpp, attrs);
     }
 
     break;
@@ -3132,6 +3250,7 @@ inf_xmpp_connection_sent_cb(InfTcpConnection* tcp,
   g_object_ref(G_OBJECT(xmpp));
 
   priv->position -= len;
+  priv->statistics.n_bytes_sent += len;
   if(priv->messages != NULL)
   {
     have_sent = priv->messages->sent;
@@ -3184,15 +3303,18 @@ inf_xmpp_connection_received_cb(InfTcpConnection* tcp,
   ssize_t res;
   GError* error;
   gboolean receiving;
+  INF_TRACE_DECLARE(trace_start);
 
   xmpp = INF_XMPP_CONNECTION(user_data);
   priv = INF_XMPP_CONNECTION_PRIVATE(xmpp);
+  priv->statistics.n_bytes_received += len;
 
   /* We just keep the connection open to send a final gnutls bye and
    * </stream:stream> in this state, any input gets discarded. */
   if(priv->status == INF_XMPP_CONNECTION_CLOSING_GNUTLS)
     return;
 
+  INF_TRACE_BEGIN(trace_start);
   g_object_ref(xmpp);
 
   g_assert(priv->parsing == 0);
@@ -3316,6 +3438,7 @@ inf_xmpp_connection_received_cb(InfTcpConnection* tcp,
   }
 
   g_object_unref(xmpp);
+  INF_TRACE_END(INF_TRACE_XMPP_RECEIVE, trace_start);
 }
 
 static void
@@ -3328,6 +3451,22 @@ inf_xmpp_connection_error_cb(InfTcpConnection* tcp,
   inf_xml_connection_error(INF_XML_CONNECTION(user_data), error);
 }
 
+static void
+inf_xmpp_connection_notify_congested_cb(InfTcpConnection* tcp,
+                                        GParamSpec* pspec,
+                                        gpointer user_data)
+{
+  g_object_notify(G_OBJECT(user_data), "congested");
+}
+
+static void
+inf_xmpp_connection_notify_high_watermark_cb(InfTcpConnection* tcp,
+                                             GParamSpec* pspec,
+                                             gpointer user_data)
+{
+  g_object_notify(G_OBJECT(user_data), "detects-congestion");
+}
+
 static void
 inf_xmpp_connection_notify_status_cb(InfTcpConnection* tcp,
                                      GParamSpec* pspec,
@@ -3464,6 +3603,18 @@ inf_xmpp_connection_set_tcp(InfXmppConnection* xmpp,
       xmpp
     );
 
+    inf_signal_handlers_disconnect_by_func(
+      G_OBJECT(priv->tcp),
+      G_CALLBACK(inf_xmpp_connection_notify_congested_cb),
+      xmpp
+    );
+
+    inf_signal_handlers_disconnect_by_func(
+      G_OBJECT(priv->tcp),
+      G_CALLBACK(inf_xmpp_connection_notify_high_watermark_cb),
+      xmpp
+    );
+
     g_object_unref(G_OBJECT(priv->tcp));
   }
 
@@ -3501,6 +3652,20 @@ inf_xmpp_connection_set_tcp(InfXmppConnection* xmpp,
       xmpp
     );
 
+    g_signal_connect(
+      G_OBJECT(tcp),
+      "notify::congested",
+      G_CALLBACK(inf_xmpp_connection_notify_congested_cb),
+      xmpp
+    );
+
+    g_signal_connect(
+      G_OBJECT(tcp),
+      "notify::send-queue-high-watermark",
+      G_CALLBACK(inf_xmpp_connection_notify_high_watermark_cb),
+      xmpp
+    );
+
     g_object_get(G_OBJECT(tcp), "status", &tcp_status, NULL);
 
     switch(tcp_status)
@@ -3631,6 +3796,15 @@ inf_xmpp_connection_init(InfXmppConnection* connection)
   priv->sasl_local_mechanisms = NULL;
   priv->sasl_remote_mechanisms = NULL;
   priv->sasl_error = NULL;
+
+  priv->reject = FALSE;
+  priv->reject_code = INF_XMPP_CONNECTION_STREAM_ERROR_FAILED;
+  priv->reject_message = NULL;
+
+  priv->statistics.n_messages_sent = 0;
+  priv->statistics.n_messages_received = 0;
+  priv->statistics.n_bytes_sent = 0;
+  priv->statistics.n_bytes_received = 0;
 }
 
 static void
@@ -3728,6 +3902,7 @@ inf_xmpp_connection_finalize(GObject* object)
   g_free(priv->remote_hostname);
   g_free(priv->sasl_local_mechanisms);
   g_free(priv->sasl_remote_mechanisms);
+  g_free(priv->reject_message);
 
   if(priv->certificate_callback_notify != NULL)
     priv->certificate_callback_notify(priv->certificate_callback_user_data);
@@ -3842,6 +4017,7 @@ inf_xmpp_connection_get_property(GObject* object,
   InfXmppConnectionPrivate* priv;
   InfIpAddress* addr;
   guint port;
+  guint high_watermark;
   gchar* id;
 
   xmpp = INF_XMPP_CONNECTION(object);
@@ -3910,6 +4086,25 @@ inf_xmpp_connection_get_property(GObject* object,
   case PROP_REMOTE_CERTIFICATE:
     g_value_set_boxed(value, priv->peer_cert);
     break;
+  case PROP_CONGESTED:
+    if(priv->tcp != NULL)
+      g_value_set_boolean(value, inf_tcp_connection_get_congested(priv->tcp));
+    else
+      g_value_set_boolean(value, FALSE);
+    break;
+  case PROP_DETECTS_CONGESTION:
+    high_watermark = 0;
+    if(priv->tcp != NULL)
+    {
+      g_object_get(
+        G_OBJECT(priv->tcp),
+        "send-queue-high-watermark", &high_watermark,
+        NULL
+      );
+    }
+
+    g_value_set_boolean(value, high_watermark > 0);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
@@ -3924,6 +4119,7 @@ static void
 inf_xmpp_connection_xml_connection_send_sent(InfXmppConnection* xmpp,
                                              gpointer xml)
 {
+  ++INF_XMPP_CONNECTION_PRIVATE(xmpp)->statistics.n_messages_sent;
   inf_xml_connection_sent(INF_XML_CONNECTION(xmpp), (xmlNodePtr)xml);
 }
 
@@ -4194,6 +4390,14 @@ inf_xmpp_connection_class_init(InfXmppConnectionClass* xmpp_class)
     PROP_REMOTE_CERTIFICATE,
     "remote-certificate"
   );
+
+  g_object_class_override_property(object_class, PROP_CONGESTED, "congested");
+
+  g_object_class_override_property(
+    object_class,
+    PROP_DETECTS_CONGESTION,
+    "detects-congestion"
+  );
 }
 
 static void
@@ -4842,6 +5046,94 @@ inf_xmpp_connection_get_sasl_error(InfXmppConnection* xmpp)
   return priv->sasl_error;
 }
 
+/**
+ * inf_xmpp_connection_reject:
+ * @xmpp: A #InfXmppConnection in server mode.
+ * @code: The stream error to send to the client.
+ * @message: (allow-none): A human-readable description of the error, or
+ * %NULL.
+ *
+ * Refuses the client at the other end of @xmpp with a stream error. This is
+ * meant to be called on a freshly accepted connection, for example when the
+ * server is too busy to serve another client. In that case the client's
+ * initial stream header is answered with the stream error @code instead of
+ * the stream features, so that no TLS handshake or SASL authentication
+ * takes place, and the connection is closed afterwards.
+ *
+ * If the stream has already been negotiated, the stream error is sent
+ * immediately. If a TLS handshake is in progress, the connection is closed
+ * without sending a stream error, since it cannot be sent during the
+ * handshake.
+ */
+void
+inf_xmpp_connection_reject(InfXmppConnection* xmpp,
+                           InfXmppConnectionStreamError code,
+                           const gchar* message)
+{
+  InfXmppConnectionPrivate* priv;
+
+  g_return_if_fail(INF_IS_XMPP_CONNECTION(xmpp));
+
+  priv = INF_XMPP_CONNECTION_PRIVATE(xmpp);
+
+  g_return_if_fail(priv->site == INF_XMPP_CONNECTION_SERVER);
+  g_return_if_fail(priv->status != INF_XMPP_CONNECTION_CLOSING_STREAM &&
+                   priv->status != INF_XMPP_CONNECTION_CLOSING_GNUTLS &&
+                   priv->status != INF_XMPP_CONNECTION_CLOSED);
+
+  switch(priv->status)
+  {
+  case INF_XMPP_CONNECTION_CONNECTING:
+  case INF_XMPP_CONNECTION_CONNECTED:
+  case INF_XMPP_CONNECTION_AUTH_CONNECTED:
+    /* Wait for the client's <stream:stream>, to send the error in a
+     * well-formed stream. */
+    g_free(priv->reject_message);
+    priv->reject = TRUE;
+    priv->reject_code = code;
+    priv->reject_message = g_strdup(message);
+    break;
+  case INF_XMPP_CONNECTION_HANDSHAKING:
+  case INF_XMPP_CONNECTION_ENCRYPTION_REQUESTED:
+    inf_xml_connection_close(INF_XML_CONNECTION(xmpp));
+    break;
+  case INF_XMPP_CONNECTION_INITIATED:
+  case INF_XMPP_CONNECTION_AUTH_INITIATED:
+  case INF_XMPP_CONNECTION_AUTHENTICATING:
+  case INF_XMPP_CONNECTION_READY:
+    inf_xmpp_connection_terminate_error(xmpp, code, message);
+    break;
+  case INF_XMPP_CONNECTION_AWAITING_FEATURES:
+  case INF_XMPP_CONNECTION_AUTH_AWAITING_FEATURES:
+    /* Client only */
+  case INF_XMPP_CONNECTION_CLOSING_STREAM:
+  case INF_XMPP_CONNECTION_CLOSING_GNUTLS:
+  case INF_XMPP_CONNECTION_CLOSED:
+  default:
+    g_assert_not_reached();
+    break;
+  }
+}
+
+/**
+ * inf_xmpp_connection_get_statistics:
+ * @xmpp: A #InfXmppConnection.
+ * @statistics: (out): Location to store the statistics.
+ *
+ * Fills @statistics with the traffic counters of @xmpp since it was
+ * created. Only messages exchanged after stream negotiation are counted as
+ * messages, but all traffic is counted in bytes.
+ */
+void
+inf_xmpp_connection_get_statistics(InfXmppConnection* xmpp,
+                                   InfXmppConnectionStatistics* statistics)
+{
+  g_return_if_fail(INF_IS_XMPP_CONNECTION(xmpp));
+  g_return_if_fail(statistics != NULL);
+
+  *statistics = INF_XMPP_CONNECTION_PRIVATE(xmpp)->statistics;
+}
+
 /**
  * inf_xmpp_connection_error_quark:
  *
@@ -266,6 +266,26 @@ typedef enum _InfXmppConnectionAuthError {
   INF_XMPP_CONNECTION_AUTH_ERROR_FAILED
 } InfXmppConnectionAuthError;
 
+/**
+ * InfXmppConnectionStatistics:
+ * @n_messages_sent: The number of XML messages that have been sent.
+ * @n_messages_received: The number of XML messages that have been received.
+ * @n_bytes_sent: The number of bytes that have been sent over the
+ * underlying #InfTcpConnection, including XMPP and TLS overhead.
+ * @n_bytes_received: The number of bytes that have been received over the
+ * underlying #InfTcpConnection, including XMPP and TLS overhead.
+ *
+ * Traffic counters of a #InfXmppConnection, see
+ * inf_xmpp_connection_get_statistics().
+ */
+typedef struct _InfXmppConnectionStatistics InfXmppConnectionStatistics;
+struct _InfXmppConnectionStatistics {
+  guint64 n_messages_sent;
+  guint64 n_messages_received;
+  guint64 n_bytes_sent;
+  guint64 n_bytes_received;
+};
+
 /**
  * InfXmppConnectionClass:
  *
@@ -380,6 +400,15 @@ inf_xmpp_connection_set_sasl_error(InfXmppConnection* xmpp,
 const GError*
 inf_xmpp_connection_get_sasl_error(InfXmppConnection* xmpp);
 
+void
+inf_xmpp_connection_reject(InfXmppConnection* xmpp,
+                           InfXmppConnectionStreamError code,
+                           const gchar* message);
+
+void
+inf_xmpp_connection_get_statistics(InfXmppConnection* xmpp,
+                                   InfXmppConnectionStatistics* statistics);
+
 G_END_DECLS
 
 #endif /* __INF_XMPP_CONNECTION_H__ */
@@ -39,6 +39,7 @@
 #include <libinfinity/communication/inf-communication-registry.h>
 #include <libinfinity/communication/inf-communication-group-private.h>
 #include <libinfinity/common/inf-xml-util.h>
+#include <libinfinity/common/inf-trace.h>
 #include <libinfinity/inf-signals.h>
 
 #include <string.h>
@@ -64,6 +65,7 @@ struct _InfCommunicationRegistryEntry {
 
   /* Queue of messages to send */
   guint inner_count;
+  guint queue_count; /* # messages between queue_begin and queue_end */
   xmlNodePtr queue_begin;
   xmlNodePtr queue_end;
 
@@ -97,6 +99,14 @@ G_DEFINE_TYPE_WITH_CODE(InfCommunicationRegistry, inf_communication_registry, G_
 /* Maximum number of messages enqueued at the same time */
 static const guint INF_COMMUNICATION_REGISTRY_INNER_QUEUE_LIMIT = 5;
 
+/* Number of messages held back for a single connection above which they are
+ * handed to the connection anyway, if the connection detects congestion.
+ * This keeps the backlog for a connection whose remote site does not read
+ * visible in the connection's send queue, so that it can report congestion.
+ * Connections without a send queue limit keep the backlog here, where it
+ * can still be cancelled. */
+static const guint INF_COMMUNICATION_REGISTRY_OUTER_QUEUE_LIMIT = 64;
+
 static void
 inf_communication_registry_send_real(InfCommunicationRegistryEntry* entry,
                                      guint num_messages)
@@ -125,6 +135,7 @@ inf_communication_registry_send_real(InfCommunicationRegistryEntry* entry,
   {
     entry->queue_begin = entry->queue_begin->next;
     if(entry->queue_begin == NULL) entry->queue_end = NULL;
+    -- entry->queue_count;
     ++ entry->inner_count;
 
     xmlUnlinkNode(xml);
@@ -856,6 +867,7 @@ inf_communication_registry_register(InfCommunicationRegistry* registry,
     entry->method = method;
 
     entry->inner_count = 0;
+    entry->queue_count = 0;
     entry->queue_begin = NULL;
     entry->queue_end = NULL;
 
@@ -894,7 +906,6 @@ inf_communication_registry_unregister(InfCommunicationRegistry* registry,
   InfCommunicationRegistryKey key;
   InfCommunicationRegistryEntry* entry;
   InfXmlConnectionStatus status;
-  xmlNodePtr xml;
 
   g_return_if_fail(INF_COMMUNICATION_IS_REGISTRY(registry));
   g_return_if_fail(INF_COMMUNICATION_IS_GROUP(group));
@@ -919,9 +930,7 @@ inf_communication_registry_unregister(InfCommunicationRegistry* registry,
     /* The entry has still messages to send, so don't remove it right now
      * but wait until all scheduled messages have been sent. */
     entry->registered = FALSE;
-    entry->activation_count = entry->inner_count;
-    for(xml = entry->queue_begin; xml != NULL; xml = xml->next)
-      ++ entry->activation_count;
+    entry->activation_count = entry->inner_count + entry->queue_count;
     g_assert(entry->activation_count > 0);
 
     /* Keep an additional reference on the connection as the connection will
@@ -989,6 +998,13 @@ inf_communication_registry_is_registered(InfCommunicationRegistry* registry,
  * called when sending the message can no longer be cancelled via
  * inf_communication_registry_cancel_messages().
  *
+ * Only a few messages are passed to @connection at a time, the others are
+ * held back until these have been sent. If @connection detects congestion
+ * (see #InfXmlConnection:detects-congestion) and does not manage to send
+ * them, the held back messages are passed to it as well once many of them
+ * have piled up, so that @connection can notice the backlog. Those messages
+ * can then no longer be cancelled.
+ *
  * This function takes ownership of @xml.
  */
 void
@@ -1000,6 +1016,7 @@ inf_communication_registry_send(InfCommunicationRegistry* registry,
   InfCommunicationRegistryPrivate* priv;
   InfCommunicationRegistryKey key;
   InfCommunicationRegistryEntry* entry;
+  gboolean detects_congestion;
 
   g_return_if_fail(INF_COMMUNICATION_IS_REGISTRY(registry));
   g_return_if_fail(INF_COMMUNICATION_IS_GROUP(group));
@@ -1015,6 +1032,11 @@ inf_communication_registry_send(InfCommunicationRegistry* registry,
   entry = g_hash_table_lookup(priv->entries, &key);
   g_assert(entry != NULL && entry->registered == TRUE);
 
+  INF_TRACE_VALUE(
+    INF_TRACE_REGISTRY_QUEUE_DEPTH,
+    entry->inner_count + entry->queue_count
+  );
+
   xmlUnlinkNode(xml);
   if(entry->queue_end == NULL)
   {
@@ -1027,8 +1049,12 @@ inf_communication_registry_send(InfCommunicationRegistry* registry,
     entry->queue_end = xml;
   }
 
+  ++ entry->queue_count;
+
   /* If there is something in the inner queue, don't send directly but wait
-   * until the message has been sent, for better packing. */
+   * until the message has been sent, for better packing. If the inner queue
+   * does not drain, pass all held back messages at once to connections
+   * that can report congestion. */
   if(entry->inner_count == 0)
   {
     inf_communication_registry_send_real(
@@ -1036,6 +1062,17 @@ inf_communication_registry_send(InfCommunicationRegistry* registry,
       INF_COMMUNICATION_REGISTRY_INNER_QUEUE_LIMIT - entry->inner_count
     );
   }
+  else if(entry->queue_count >= INF_COMMUNICATION_REGISTRY_OUTER_QUEUE_LIMIT)
+  {
+    g_object_get(
+      G_OBJECT(connection),
+      "detects-congestion", &detects_congestion,
+      NULL
+    );
+
+    if(detects_congestion == TRUE)
+      inf_communication_registry_send_real(entry, entry->queue_count);
+  }
 
   g_free(key.publisher_id);
 }
@@ -1047,7 +1084,10 @@ inf_communication_registry_send(InfCommunicationRegistry* registry,
  * @connection: A registered #InfXmlConnection.
  *
  * Stops all messages scheduled to be sent to @connection in @group from being
- * sent.
+ * sent. Messages that have already been passed to @connection, i.e. for
+ * which inf_communication_method_enqueued() has been called, are not
+ * affected and will still be sent. See inf_communication_registry_send()
+ * for when this happens.
  */
 void
 inf_communication_registry_cancel_messages(InfCommunicationRegistry* registry,
@@ -1075,6 +1115,7 @@ inf_communication_registry_cancel_messages(InfCommunicationRegistry* registry,
   xmlFreeNodeList(entry->queue_begin);
   entry->queue_begin = NULL;
   entry->queue_end = NULL;
+  entry->queue_count = 0;
 
   g_free(key.publisher_id);
 }
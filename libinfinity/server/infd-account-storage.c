@@ -56,6 +56,9 @@
 #include <libinfinity/inf-define-enum.h>
 #include <libinfinity/inf-i18n.h>
 
+#include <stdlib.h>
+#include <string.h>
+
 static const GFlagsValue infd_account_storage_support_values[] = {
   {
     INFD_ACCOUNT_STORAGE_SUPPORT_NOTIFICATION,
@@ -108,6 +111,16 @@ enum {
 
 static guint account_storage_signals[LAST_SIGNAL];
 
+static int
+infd_account_storage_account_compare_func(gconstpointer first,
+                                          gconstpointer second)
+{
+  return inf_acl_account_id_compare(
+    ((const InfAclAccount*)first)->id,
+    ((const InfAclAccount*)second)->id
+  );
+}
+
 static void
 infd_account_storage_default_init(InfdAccountStorageInterface* iface)
 {
@@ -339,6 +352,120 @@ infd_account_storage_list_accounts(InfdAccountStorage* storage,
   return iface->list_accounts(storage, n_accounts, error);
 }
 
+/**
+ * infd_account_storage_list_accounts_range:
+ * @storage: A #InfdAccountStorage.
+ * @prefix: (allow-none): Only list accounts whose name starts with this
+ * string, or %NULL.
+ * @after: Only list accounts whose ID sorts after this ID, or 0.
+ * @max: The maximum number of accounts to return, or 0 for no limit.
+ * @n_accounts: (out): An output parameter holding the number of returned
+ * accounts.
+ * @error: Location to store error information, if any, or %NULL.
+ *
+ * Returns a subset of the accounts in @storage. The result is sorted
+ * according to inf_acl_account_id_compare(), and only contains accounts
+ * whose ID sorts strictly after @after. This allows to traverse the full
+ * account list in chunks of at most @max accounts, by passing the ID of the
+ * last account of the previous chunk as @after for the next call. If @prefix
+ * is given, accounts whose name does not start with @prefix are skipped.
+ *
+ * If the backend does not implement
+ * #InfdAccountStorageInterface.list_accounts_range, the result is computed
+ * from the full account list. Otherwise, the backend is expected to do this
+ * without materializing all accounts, which makes this function suitable
+ * for account storages with a very large number of accounts. The return
+ * value semantics are the same as for infd_account_storage_list_accounts().
+ *
+ * Note that this function might not be supported by the backend. See
+ * infd_account_storage_get_support().
+ *
+ * Returns: (array length=n_accounts) (allow-none) (transfer full): An array
+ * of #InfAclAccount structures with length @n_accounts, or %NULL if
+ * @n_accounts is 0 or @error is set. Free with
+ * inf_acl_account_array_free().
+ */
+InfAclAccount*
+infd_account_storage_list_accounts_range(InfdAccountStorage* storage,
+                                         const gchar* prefix,
+                                         InfAclAccountId after,
+                                         guint max,
+                                         guint* n_accounts,
+                                         GError** error)
+{
+  InfdAccountStorageInterface* iface;
+  InfAclAccount* accounts;
+  guint n_all;
+  gsize prefix_len;
+  guint i;
+  guint n;
+
+  g_return_val_if_fail(INFD_IS_ACCOUNT_STORAGE(storage), NULL);
+  g_return_val_if_fail(n_accounts != NULL, NULL);
+  g_return_val_if_fail(error == NULL || *error == NULL, NULL);
+
+  iface = INFD_ACCOUNT_STORAGE_GET_IFACE(storage);
+  if(iface->list_accounts_range != NULL)
+  {
+    return iface->list_accounts_range(
+      storage,
+      prefix,
+      after,
+      max,
+      n_accounts,
+      error
+    );
+  }
+
+  accounts = infd_account_storage_list_accounts(storage, &n_all, error);
+  if(accounts == NULL)
+  {
+    *n_accounts = 0;
+    return NULL;
+  }
+
+  /* Filter in place, then sort what remains */
+  prefix_len = (prefix != NULL) ? strlen(prefix) : 0;
+  n = 0;
+  for(i = 0; i < n_all; ++i)
+  {
+    if(inf_acl_account_id_compare(accounts[i].id, after) <= 0 ||
+       (prefix_len > 0 &&
+        (accounts[i].name == NULL ||
+         strncmp(accounts[i].name, prefix, prefix_len) != 0)))
+    {
+      g_free(accounts[i].name);
+    }
+    else
+    {
+      accounts[n++] = accounts[i];
+    }
+  }
+
+  qsort(
+    accounts,
+    n,
+    sizeof(InfAclAccount),
+    infd_account_storage_account_compare_func
+  );
+
+  if(max > 0 && n > max)
+  {
+    for(i = max; i < n; ++i)
+      g_free(accounts[i].name);
+    n = max;
+  }
+
+  *n_accounts = n;
+  if(n == 0)
+  {
+    g_free(accounts);
+    return NULL;
+  }
+
+  return accounts;
+}
+
 /**
  * infd_account_storage_add_account:
  * @storage: A #InfdAccountStorage.
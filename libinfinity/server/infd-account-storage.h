@@ -103,6 +103,9 @@ typedef enum _InfdAccountStorageSupport {
  * #InfdAccountStorage::account-added signal.
  * @account_removed: Default signal handler for the
  * #InfdAccountStorage::account-removed signal.
+ * @list_accounts_range: Virtual function to obtain a sorted, filtered and
+ * bounded subset of the available accounts. Can be %NULL, in which case
+ * the result is computed from @list_accounts.
  *
  * The virtual methods and default signal handlers of #InfdAccountStorage.
  * Implementing these allows an infinote server to set a specific source of
@@ -167,6 +170,15 @@ struct _InfdAccountStorageInterface {
 
   void (*account_removed)(InfdAccountStorage* storage,
                           const InfAclAccount* account);
+
+  /* Virtual functions, continued. New entries are added at the end so that
+   * the layout of the structure stays compatible. */
+  InfAclAccount* (*list_accounts_range)(InfdAccountStorage* storage,
+                                        const gchar* prefix,
+                                        InfAclAccountId after,
+                                        guint max,
+                                        guint* n_accounts,
+                                        GError** error);
 };
 
 GType
@@ -199,6 +211,14 @@ infd_account_storage_list_accounts(InfdAccountStorage* storage,
                                    guint* n_accounts,
                                    GError** error);
 
+InfAclAccount*
+infd_account_storage_list_accounts_range(InfdAccountStorage* storage,
+                                         const gchar* prefix,
+                                         InfAclAccountId after,
+                                         guint max,
+                                         guint* n_accounts,
+                                         GError** error);
+
 InfAclAccountId
 infd_account_storage_add_account(InfdAccountStorage* storage,
                                  const gchar* name,
@@ -0,0 +1,794 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/**
+ * SECTION:infd-admission-control
+ * @title: InfdAdmissionControl
+ * @short_description: Limits the load caused by incoming connections
+ * @include: libinfinity/server/infd-admission-control.h
+ * @see_also: #InfdXmppServer
+ * @stability: Unstable
+ *
+ * #InfdAdmissionControl decides whether a new incoming connection is served
+ * or not. It limits the total number of connections, the number of
+ * connections that are performing the TLS handshake or SASL authentication
+ * at the same time, and the rate at which a single address can open new
+ * connections, using a token bucket per address. Each limit can be disabled
+ * by setting it to 0, which is the default.
+ *
+ * Rejected connections are not just dropped, but receive a stream error so
+ * that the client can tell the user why the connection failed. If the
+ * client does not send its stream header within
+ * #InfdAdmissionControl:reject-timeout, so that the stream error cannot be
+ * sent, then the connection is closed. Since the
+ * expensive parts of establishing a connection are skipped for them, this
+ * keeps the server responsive for existing connections while it is under
+ * heavy load.
+ *
+ * The same #InfdAdmissionControl can be shared between several
+ * #InfdXmppServer<!-- -->s, for example for IPv4 and IPv6, in which case
+ * the limits apply to the sum of their connections.
+ */
+
+#include <libinfinity/server/infd-admission-control.h>
+#include <libinfinity/common/inf-tcp-connection.h>
+#include <libinfinity/common/inf-io.h>
+#include <libinfinity/inf-signals.h>
+#include <libinfinity/inf-i18n.h>
+
+/* Maximum number of rejected connections that are kept open until the
+ * stream error has been sent. Further connections are closed right away. */
+#define INFD_ADMISSION_CONTROL_MAX_REJECTED 256
+
+/* Interval in which token buckets that are full again are removed, in
+ * microseconds. */
+#define INFD_ADMISSION_CONTROL_PRUNE_INTERVAL (60 * G_USEC_PER_SEC)
+
+typedef struct _InfdAdmissionControlBucket InfdAdmissionControlBucket;
+struct _InfdAdmissionControlBucket {
+  gdouble tokens;
+  gint64 updated;
+};
+
+typedef struct _InfdAdmissionControlRejected InfdAdmissionControlRejected;
+struct _InfdAdmissionControlRejected {
+  InfXmppConnection* connection;
+  InfIo* io;
+  InfIoTimeout* timeout;
+};
+
+typedef struct _InfdAdmissionControlPrivate InfdAdmissionControlPrivate;
+struct _InfdAdmissionControlPrivate {
+  guint max_connections;
+  guint max_handshakes;
+  guint connection_rate;
+  guint connection_burst;
+  guint reject_timeout;
+
+  /* connection -> whether it is still being opened, each holding a
+   * reference */
+  GHashTable* connections;
+  /* connection -> InfdAdmissionControlRejected, for connections which are
+   * sent a stream error */
+  GHashTable* rejected;
+
+  /* address -> InfdAdmissionControlBucket */
+  GHashTable* buckets;
+  gint64 last_prune;
+
+  InfdAdmissionControlStatistics statistics;
+};
+
+enum {
+  PROP_0,
+
+  PROP_MAX_CONNECTIONS,
+  PROP_MAX_HANDSHAKES,
+  PROP_CONNECTION_RATE,
+  PROP_CONNECTION_BURST,
+  PROP_REJECT_TIMEOUT
+};
+
+#define INFD_ADMISSION_CONTROL_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE((obj), INFD_TYPE_ADMISSION_CONTROL, InfdAdmissionControlPrivate))
+
+G_DEFINE_TYPE_WITH_CODE(InfdAdmissionControl, infd_admission_control, G_TYPE_OBJECT,
+  G_ADD_PRIVATE(InfdAdmissionControl))
+
+/* Refills the bucket according to the time passed since its last update */
+static void
+infd_admission_control_bucket_refill(InfdAdmissionControl* control,
+                                     InfdAdmissionControlBucket* bucket,
+                                     gint64 now)
+{
+  InfdAdmissionControlPrivate* priv;
+  priv = INFD_ADMISSION_CONTROL_PRIVATE(control);
+
+  /* connection_rate is in connections per minute */
+  bucket->tokens += (gdouble)(now - bucket->updated) *
+    priv->connection_rate / (60.0 * G_USEC_PER_SEC);
+
+  if(bucket->tokens > priv->connection_burst)
+    bucket->tokens = priv->connection_burst;
+
+  bucket->updated = now;
+}
+
+static gboolean
+infd_admission_control_prune_func(gpointer key,
+                                  gpointer value,
+                                  gpointer user_data)
+{
+  InfdAdmissionControl* control;
+  InfdAdmissionControlPrivate* priv;
+  InfdAdmissionControlBucket* bucket;
+
+  control = INFD_ADMISSION_CONTROL(user_data);
+  priv = INFD_ADMISSION_CONTROL_PRIVATE(control);
+  bucket = (InfdAdmissionControlBucket*)value;
+
+  infd_admission_control_bucket_refill(
+    control,
+    bucket,
+    priv->last_prune
+  );
+
+  /* A full bucket is equivalent to no bucket at all */
+  return bucket->tokens >= priv->connection_burst;
+}
+
+/* Takes a token from the bucket of the given address. Returns FALSE if the
+ * address has exceeded its connection rate. */
+static gboolean
+infd_admission_control_take_token(InfdAdmissionControl* control,
+                                  const InfIpAddress* address)
+{
+  InfdAdmissionControlPrivate* priv;
+  InfdAdmissionControlBucket* bucket;
+  gchar* address_str;
+  gint64 now;
+
+  priv = INFD_ADMISSION_CONTROL_PRIVATE(control);
+  if(priv->connection_rate == 0) return TRUE;
+
+  now = g_get_monotonic_time();
+  if(now - priv->last_prune >= INFD_ADMISSION_CONTROL_PRUNE_INTERVAL)
+  {
+    priv->last_prune = now;
+
+    g_hash_table_foreach_remove(
+      priv->buckets,
+      infd_admission_control_prune_func,
+      control
+    );
+  }
+
+  address_str = inf_ip_address_to_string(address);
+  bucket = g_hash_table_lookup(priv->buckets, address_str);
+
+  if(bucket == NULL)
+  {
+    bucket = g_slice_new(InfdAdmissionControlBucket);
+    bucket->tokens = priv->connection_burst;
+    bucket->updated = now;
+
+    g_hash_table_insert(priv->buckets, address_str, bucket);
+  }
+  else
+  {
+    g_free(address_str);
+    infd_admission_control_bucket_refill(control, bucket, now);
+  }
+
+  if(bucket->tokens < 1.0)
+    return FALSE;
+
+  bucket->tokens -= 1.0;
+  return TRUE;
+}
+
+static void
+infd_admission_control_bucket_free(gpointer bucket)
+{
+  g_slice_free(InfdAdmissionControlBucket, bucket);
+}
+
+static void
+infd_admission_control_rejected_free(gpointer data)
+{
+  InfdAdmissionControlRejected* rejected;
+  rejected = (InfdAdmissionControlRejected*)data;
+
+  if(rejected->timeout != NULL)
+    inf_io_remove_timeout(rejected->io, rejected->timeout);
+
+  g_object_unref(rejected->io);
+  g_object_unref(rejected->connection);
+  g_slice_free(InfdAdmissionControlRejected, rejected);
+}
+
+static void
+infd_admission_control_reject_timeout_func(gpointer user_data)
+{
+  InfdAdmissionControlRejected* rejected;
+  rejected = (InfdAdmissionControlRejected*)user_data;
+  rejected->timeout = NULL;
+
+  /* The client did not send a stream header in time, so that we could not
+   * send the stream error. The connection is removed from the rejected
+   * table once it has been closed. */
+  inf_xml_connection_close(INF_XML_CONNECTION(rejected->connection));
+}
+
+static void
+infd_admission_control_remove_connection(InfdAdmissionControl* control,
+                                         InfXmppConnection* connection);
+
+static void
+infd_admission_control_notify_status_cb(GObject* object,
+                                        GParamSpec* pspec,
+                                        gpointer user_data)
+{
+  InfdAdmissionControl* control;
+  InfdAdmissionControlPrivate* priv;
+  InfXmlConnectionStatus status;
+  gpointer handshaking;
+
+  control = INFD_ADMISSION_CONTROL(user_data);
+  priv = INFD_ADMISSION_CONTROL_PRIVATE(control);
+
+  g_object_get(object, "status", &status, NULL);
+
+  switch(status)
+  {
+  case INF_XML_CONNECTION_OPEN:
+    handshaking = g_hash_table_lookup(priv->connections, object);
+    if(GPOINTER_TO_INT(handshaking) == TRUE)
+    {
+      g_hash_table_insert(
+        priv->connections,
+        object,
+        GINT_TO_POINTER(FALSE)
+      );
+
+      --priv->statistics.n_handshakes;
+    }
+
+    break;
+  case INF_XML_CONNECTION_CLOSING:
+  case INF_XML_CONNECTION_CLOSED:
+    infd_admission_control_remove_connection(
+      control,
+      INF_XMPP_CONNECTION(object)
+    );
+
+    break;
+  case INF_XML_CONNECTION_OPENING:
+    break;
+  default:
+    g_assert_not_reached();
+    break;
+  }
+}
+
+static void
+infd_admission_control_rejected_notify_status_cb(GObject* object,
+                                                 GParamSpec* pspec,
+                                                 gpointer user_data)
+{
+  InfdAdmissionControl* control;
+  InfdAdmissionControlPrivate* priv;
+  InfXmlConnectionStatus status;
+
+  control = INFD_ADMISSION_CONTROL(user_data);
+  priv = INFD_ADMISSION_CONTROL_PRIVATE(control);
+
+  /* Keep the connection alive until the stream error has been sent */
+  g_object_get(object, "status", &status, NULL);
+  if(status == INF_XML_CONNECTION_CLOSED)
+  {
+    inf_signal_handlers_disconnect_by_func(
+      object,
+      G_CALLBACK(infd_admission_control_rejected_notify_status_cb),
+      control
+    );
+
+    g_hash_table_remove(priv->rejected, object);
+  }
+}
+
+static void
+infd_admission_control_remove_connection(InfdAdmissionControl* control,
+                                         InfXmppConnection* connection)
+{
+  InfdAdmissionControlPrivate* priv;
+  gpointer handshaking;
+
+  priv = INFD_ADMISSION_CONTROL_PRIVATE(control);
+  handshaking = g_hash_table_lookup(priv->connections, connection);
+
+  if(GPOINTER_TO_INT(handshaking) == TRUE)
+    --priv->statistics.n_handshakes;
+  --priv->statistics.n_connections;
+
+  inf_signal_handlers_disconnect_by_func(
+    G_OBJECT(connection),
+    G_CALLBACK(infd_admission_control_notify_status_cb),
+    control
+  );
+
+  g_hash_table_remove(priv->connections, connection);
+  g_object_unref(connection);
+}
+
+static void
+infd_admission_control_reject(InfdAdmissionControl* control,
+                              InfXmppConnection* connection,
+                              InfXmppConnectionStreamError code,
+                              const gchar* message)
+{
+  InfdAdmissionControlPrivate* priv;
+  InfdAdmissionControlRejected* rejected;
+  InfTcpConnection* tcp;
+  InfXmlConnectionStatus status;
+
+  priv = INFD_ADMISSION_CONTROL_PRIVATE(control);
+
+  /* Nothing to do if the remote host has disconnected already */
+  g_object_get(G_OBJECT(connection), "status", &status, NULL);
+  if(status == INF_XML_CONNECTION_CLOSING ||
+     status == INF_XML_CONNECTION_CLOSED)
+  {
+    return;
+  }
+
+  if(g_hash_table_size(priv->rejected) >= INFD_ADMISSION_CONTROL_MAX_REJECTED)
+  {
+    /* Don't let rejected connections pile up if clients do not even
+     * send a stream header. */
+    inf_xml_connection_close(INF_XML_CONNECTION(connection));
+    return;
+  }
+
+  rejected = g_slice_new(InfdAdmissionControlRejected);
+  rejected->connection = connection;
+  g_object_ref(connection);
+
+  g_object_get(G_OBJECT(connection), "tcp-connection", &tcp, NULL);
+  g_object_get(G_OBJECT(tcp), "io", &rejected->io, NULL);
+  g_object_unref(tcp);
+
+  rejected->timeout = inf_io_add_timeout(
+    rejected->io,
+    priv->reject_timeout,
+    infd_admission_control_reject_timeout_func,
+    rejected,
+    NULL
+  );
+
+  g_hash_table_insert(priv->rejected, connection, rejected);
+
+  g_signal_connect(
+    G_OBJECT(connection),
+    "notify::status",
+    G_CALLBACK(infd_admission_control_rejected_notify_status_cb),
+    control
+  );
+
+  inf_xmpp_connection_reject(connection, code, message);
+}
+
+static void
+infd_admission_control_init(InfdAdmissionControl* control)
+{
+  InfdAdmissionControlPrivate* priv;
+  priv = INFD_ADMISSION_CONTROL_PRIVATE(control);
+
+  priv->max_connections = 0;
+  priv->max_handshakes = 0;
+  priv->connection_rate = 0;
+  priv->connection_burst = 10;
+  priv->reject_timeout = 10000;
+
+  priv->connections = g_hash_table_new(NULL, NULL);
+
+  priv->rejected = g_hash_table_new_full(
+    NULL,
+    NULL,
+    NULL,
+    infd_admission_control_rejected_free
+  );
+
+  priv->buckets = g_hash_table_new_full(
+    g_str_hash,
+    g_str_equal,
+    g_free,
+    infd_admission_control_bucket_free
+  );
+
+  priv->last_prune = g_get_monotonic_time();
+
+  priv->statistics.n_connections = 0;
+  priv->statistics.n_handshakes = 0;
+  priv->statistics.n_admitted = 0;
+  priv->statistics.n_rejected_connections = 0;
+  priv->statistics.n_rejected_handshakes = 0;
+  priv->statistics.n_rejected_rate = 0;
+}
+
+static void
+infd_admission_control_dispose(GObject* object)
+{
+  InfdAdmissionControl* control;
+  InfdAdmissionControlPrivate* priv;
+  GHashTableIter iter;
+  gpointer connection;
+
+  control = INFD_ADMISSION_CONTROL(object);
+  priv = INFD_ADMISSION_CONTROL_PRIVATE(control);
+
+  g_hash_table_iter_init(&iter, priv->connections);
+  while(g_hash_table_iter_next(&iter, &connection, NULL))
+  {
+    inf_signal_handlers_disconnect_by_func(
+      G_OBJECT(connection),
+      G_CALLBACK(infd_admission_control_notify_status_cb),
+      control
+    );
+
+    g_object_unref(connection);
+  }
+
+  g_hash_table_iter_init(&iter, priv->rejected);
+  while(g_hash_table_iter_next(&iter, &connection, NULL))
+  {
+    inf_signal_handlers_disconnect_by_func(
+      G_OBJECT(connection),
+      G_CALLBACK(infd_admission_control_rejected_notify_status_cb),
+      control
+    );
+  }
+
+  g_hash_table_remove_all(priv->connections);
+  g_hash_table_remove_all(priv->rejected);
+
+  priv->statistics.n_connections = 0;
+  priv->statistics.n_handshakes = 0;
+
+  G_OBJECT_CLASS(infd_admission_control_parent_class)->dispose(object);
+}
+
+static void
+infd_admission_control_finalize(GObject* object)
+{
+  InfdAdmissionControlPrivate* priv;
+  priv = INFD_ADMISSION_CONTROL_PRIVATE(object);
+
+  g_hash_table_destroy(priv->connections);
+  g_hash_table_destroy(priv->rejected);
+  g_hash_table_destroy(priv->buckets);
+
+  G_OBJECT_CLASS(infd_admission_control_parent_class)->finalize(object);
+}
+
+static void
+infd_admission_control_set_property(GObject* object,
+                                    guint prop_id,
+                                    const GValue* value,
+                                    GParamSpec* pspec)
+{
+  InfdAdmissionControlPrivate* priv;
+  priv = INFD_ADMISSION_CONTROL_PRIVATE(object);
+
+  switch(prop_id)
+  {
+  case PROP_MAX_CONNECTIONS:
+    priv->max_connections = g_value_get_uint(value);
+    break;
+  case PROP_MAX_HANDSHAKES:
+    priv->max_handshakes = g_value_get_uint(value);
+    break;
+  case PROP_CONNECTION_RATE:
+    priv->connection_rate = g_value_get_uint(value);
+    /* The buckets were filled according to the old rate */
+    g_hash_table_remove_all(priv->buckets);
+    break;
+  case PROP_CONNECTION_BURST:
+    priv->connection_burst = g_value_get_uint(value);
+    g_hash_table_remove_all(priv->buckets);
+    break;
+  case PROP_REJECT_TIMEOUT:
+    priv->reject_timeout = g_value_get_uint(value);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    break;
+  }
+}
+
+static void
+infd_admission_control_get_property(GObject* object,
+                                    guint prop_id,
+                                    GValue* value,
+                                    GParamSpec* pspec)
+{
+  InfdAdmissionControlPrivate* priv;
+  priv = INFD_ADMISSION_CONTROL_PRIVATE(object);
+
+  switch(prop_id)
+  {
+  case PROP_MAX_CONNECTIONS:
+    g_value_set_uint(value, priv->max_connections);
+    break;
+  case PROP_MAX_HANDSHAKES:
+    g_value_set_uint(value, priv->max_handshakes);
+    break;
+  case PROP_CONNECTION_RATE:
+    g_value_set_uint(value, priv->connection_rate);
+    break;
+  case PROP_CONNECTION_BURST:
+    g_value_set_uint(value, priv->connection_burst);
+    break;
+  case PROP_REJECT_TIMEOUT:
+    g_value_set_uint(value, priv->reject_timeout);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    break;
+  }
+}
+
+static void
+infd_admission_control_class_init(InfdAdmissionControlClass* control_class)
+{
+  GObjectClass* object_class;
+  object_class = G_OBJECT_CLASS(control_class);
+
+  object_class->dispose = infd_admission_control_dispose;
+  object_class->finalize = infd_admission_control_finalize;
+  object_class->set_property = infd_admission_control_set_property;
+  object_class->get_property = infd_admission_control_get_property;
+
+  g_object_class_install_property(
+    object_class,
+    PROP_MAX_CONNECTIONS,
+    g_param_spec_uint(
+      "max-connections",
+      "Maximum connections",
+      "The maximum number of connections that are served at the same time, "
+      "or 0 for no limit",
+      0,
+      G_MAXUINT,
+      0,
+      G_PARAM_READWRITE
+    )
+  );
+
+  g_object_class_install_property(
+    object_class,
+    PROP_MAX_HANDSHAKES,
+    g_param_spec_uint(
+      "max-handshakes",
+      "Maximum handshakes",
+      "The maximum number of connections that perform the TLS handshake or "
+      "SASL authentication at the same time, or 0 for no limit",
+      0,
+      G_MAXUINT,
+      0,
+      G_PARAM_READWRITE
+    )
+  );
+
+  g_object_class_install_property(
+    object_class,
+    PROP_CONNECTION_RATE,
+    g_param_spec_uint(
+      "connection-rate",
+      "Connection rate",
+      "The number of new connections per minute that are accepted from a "
+      "single address, or 0 for no limit",
+      0,
+      G_MAXUINT,
+      0,
+      G_PARAM_READWRITE
+    )
+  );
+
+  g_object_class_install_property(
+    object_class,
+    PROP_CONNECTION_BURST,
+    g_param_spec_uint(
+      "connection-burst",
+      "Connection burst",
+      "The number of connections a single address can open at once before "
+      "the connection rate applies",
+      1,
+      G_MAXUINT,
+      10,
+      G_PARAM_READWRITE
+    )
+  );
+
+  g_object_class_install_property(
+    object_class,
+    PROP_REJECT_TIMEOUT,
+    g_param_spec_uint(
+      "reject-timeout",
+      "Reject timeout",
+      "Time in milliseconds after which a rejected connection is closed if "
+      "the stream error could not be sent to the client by then",
+      1,
+      G_MAXUINT,
+      10000,
+      G_PARAM_READWRITE
+    )
+  );
+}
+
+/**
+ * infd_admission_control_new: (constructor)
+ *
+ * Creates a new #InfdAdmissionControl. Initially, no limits are set, so that
+ * all connections are admitted. Use the #InfdAdmissionControl:max-connections,
+ * #InfdAdmissionControl:max-handshakes, #InfdAdmissionControl:connection-rate
+ * and #InfdAdmissionControl:connection-burst properties to configure them.
+ *
+ * Returns: (transfer full): A new #InfdAdmissionControl.
+ */
+InfdAdmissionControl*
+infd_admission_control_new(void)
+{
+  GObject* object;
+  object = g_object_new(INFD_TYPE_ADMISSION_CONTROL, NULL);
+  return INFD_ADMISSION_CONTROL(object);
+}
+
+/**
+ * infd_admission_control_admit:
+ * @control: A #InfdAdmissionControl.
+ * @connection: A newly accepted #InfXmppConnection in server mode.
+ * @address: The address of the remote host of @connection.
+ *
+ * Decides whether @connection is served. If this function returns %TRUE,
+ * then @connection is counted towards the limits of @control until it is
+ * closed. If it returns %FALSE, then @connection is rejected with a stream
+ * error, see inf_xmpp_connection_reject(), and should not be used any
+ * further. In that case @control keeps a reference on @connection until the
+ * stream error has been sent.
+ *
+ * Returns: Whether @connection has been admitted.
+ */
+gboolean
+infd_admission_control_admit(InfdAdmissionControl* control,
+                             InfXmppConnection* connection,
+                             const InfIpAddress* address)
+{
+  InfdAdmissionControlPrivate* priv;
+  InfXmlConnectionStatus status;
+
+  g_return_val_if_fail(INFD_IS_ADMISSION_CONTROL(control), FALSE);
+  g_return_val_if_fail(INF_IS_XMPP_CONNECTION(connection), FALSE);
+  g_return_val_if_fail(address != NULL, FALSE);
+
+  priv = INFD_ADMISSION_CONTROL_PRIVATE(control);
+  g_return_val_if_fail(
+    g_hash_table_lookup_extended(priv->connections, connection, NULL, NULL)
+      == FALSE,
+    FALSE
+  );
+
+  if(!infd_admission_control_take_token(control, address))
+  {
+    ++priv->statistics.n_rejected_rate;
+
+    infd_admission_control_reject(
+      control,
+      connection,
+      INF_XMPP_CONNECTION_STREAM_ERROR_POLICY_VIOLATION,
+      _("Too many connections from this address, try again later")
+    );
+
+    return FALSE;
+  }
+
+  if(priv->max_connections > 0 &&
+     priv->statistics.n_connections >= priv->max_connections)
+  {
+    ++priv->statistics.n_rejected_connections;
+
+    infd_admission_control_reject(
+      control,
+      connection,
+      INF_XMPP_CONNECTION_STREAM_ERROR_RESOURCE_CONSTRAINT,
+      _("The server has reached its maximum number of connections")
+    );
+
+    return FALSE;
+  }
+
+  g_object_get(G_OBJECT(connection), "status", &status, NULL);
+
+  if(status == INF_XML_CONNECTION_OPENING &&
+     priv->max_handshakes > 0 &&
+     priv->statistics.n_handshakes >= priv->max_handshakes)
+  {
+    ++priv->statistics.n_rejected_handshakes;
+
+    infd_admission_control_reject(
+      control,
+      connection,
+      INF_XMPP_CONNECTION_STREAM_ERROR_RESOURCE_CONSTRAINT,
+      _("The server is busy, try again later")
+    );
+
+    return FALSE;
+  }
+
+  /* The connection might already have been closed if the remote host
+   * disconnected right away */
+  if(status == INF_XML_CONNECTION_CLOSING ||
+     status == INF_XML_CONNECTION_CLOSED)
+  {
+    ++priv->statistics.n_admitted;
+    return TRUE;
+  }
+
+  g_hash_table_insert(
+    priv->connections,
+    connection,
+    GINT_TO_POINTER(status == INF_XML_CONNECTION_OPENING)
+  );
+
+  g_object_ref(connection);
+
+  g_signal_connect(
+    G_OBJECT(connection),
+    "notify::status",
+    G_CALLBACK(infd_admission_control_notify_status_cb),
+    control
+  );
+
+  if(status == INF_XML_CONNECTION_OPENING)
+    ++priv->statistics.n_handshakes;
+  ++priv->statistics.n_connections;
+  ++priv->statistics.n_admitted;
+
+  return TRUE;
+}
+
+/**
+ * infd_admission_control_get_statistics:
+ * @control: A #InfdAdmissionControl.
+ * @statistics: (out): Location to store the statistics.
+ *
+ * Fills @statistics with the current number of connections admitted by
+ * @control and the number of connections it has admitted and rejected since
+ * it was created.
+ */
+void
+infd_admission_control_get_statistics(
+  InfdAdmissionControl* control,
+  InfdAdmissionControlStatistics* statistics)
+{
+  g_return_if_fail(INFD_IS_ADMISSION_CONTROL(control));
+  g_return_if_fail(statistics != NULL);
+
+  *statistics = INFD_ADMISSION_CONTROL_PRIVATE(control)->statistics;
+}
+
+/* vim:set et sw=2 ts=2: */
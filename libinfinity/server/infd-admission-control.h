@@ -0,0 +1,108 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef __INFD_ADMISSION_CONTROL_H__
+#define __INFD_ADMISSION_CONTROL_H__
+
+#include <libinfinity/common/inf-xmpp-connection.h>
+#include <libinfinity/common/inf-ip-address.h>
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define INFD_TYPE_ADMISSION_CONTROL                 (infd_admission_control_get_type())
+#define INFD_ADMISSION_CONTROL(obj)                 (G_TYPE_CHECK_INSTANCE_CAST((obj), INFD_TYPE_ADMISSION_CONTROL, InfdAdmissionControl))
+#define INFD_ADMISSION_CONTROL_CLASS(klass)         (G_TYPE_CHECK_CLASS_CAST((klass), INFD_TYPE_ADMISSION_CONTROL, InfdAdmissionControlClass))
+#define INFD_IS_ADMISSION_CONTROL(obj)              (G_TYPE_CHECK_INSTANCE_TYPE((obj), INFD_TYPE_ADMISSION_CONTROL))
+#define INFD_IS_ADMISSION_CONTROL_CLASS(klass)      (G_TYPE_CHECK_CLASS_TYPE((klass), INFD_TYPE_ADMISSION_CONTROL))
+#define INFD_ADMISSION_CONTROL_GET_CLASS(obj)       (G_TYPE_INSTANCE_GET_CLASS((obj), INFD_TYPE_ADMISSION_CONTROL, InfdAdmissionControlClass))
+
+typedef struct _InfdAdmissionControl InfdAdmissionControl;
+typedef struct _InfdAdmissionControlClass InfdAdmissionControlClass;
+
+/**
+ * InfdAdmissionControlStatistics:
+ * @n_connections: The number of admitted connections that are currently
+ * open or being opened.
+ * @n_handshakes: The number of admitted connections that are currently
+ * performing the TLS handshake or SASL authentication.
+ * @n_admitted: The total number of connections that have been admitted.
+ * @n_rejected_connections: The total number of connections that have been
+ * rejected because the maximum number of connections was reached.
+ * @n_rejected_handshakes: The total number of connections that have been
+ * rejected because the maximum number of concurrent handshakes was reached.
+ * @n_rejected_rate: The total number of connections that have been rejected
+ * because their address exceeded the connection rate.
+ *
+ * Counters of a #InfdAdmissionControl, see
+ * infd_admission_control_get_statistics().
+ */
+typedef struct _InfdAdmissionControlStatistics InfdAdmissionControlStatistics;
+struct _InfdAdmissionControlStatistics {
+  guint n_connections;
+  guint n_handshakes;
+  guint64 n_admitted;
+  guint64 n_rejected_connections;
+  guint64 n_rejected_handshakes;
+  guint64 n_rejected_rate;
+};
+
+/**
+ * InfdAdmissionControlClass:
+ *
+ * This structure does not contain any public fields.
+ */
+struct _InfdAdmissionControlClass {
+  /*< private >*/
+  GObjectClass parent_class;
+};
+
+/**
+ * InfdAdmissionControl:
+ *
+ * #InfdAdmissionControl is an opaque data type. You should only access it
+ * via the public API functions.
+ */
+struct _InfdAdmissionControl {
+  /*< private >*/
+  GObject parent;
+};
+
+GType
+infd_admission_control_get_type(void) G_GNUC_CONST;
+
+InfdAdmissionControl*
+infd_admission_control_new(void);
+
+gboolean
+infd_admission_control_admit(InfdAdmissionControl* control,
+                             InfXmppConnection* connection,
+                             const InfIpAddress* address);
+
+void
+infd_admission_control_get_statistics(
+  InfdAdmissionControl* control,
+  InfdAdmissionControlStatistics* statistics);
+
+G_END_DECLS
+
+#endif /* __INFD_ADMISSION_CONTROL_H__ */
+
+/* vim:set et sw=2 ts=2: */
@@ -45,6 +45,7 @@
 #include <libinfinity/common/inf-protocol.h>
 #include <libinfinity/common/inf-xml-util.h>
 #include <libinfinity/common/inf-cert-util.h>
+#include <libinfinity/common/inf-trace.h>
 #include <libinfinity/communication/inf-communication-object.h>
 #include <libinfinity/inf-i18n.h>
 #include <libinfinity/inf-signals.h>
@@ -82,6 +83,9 @@ struct _InfdDirectoryNode {
       InfIoTimeout* save_timeout;
       /* Whether we hold a weak reference or a strong reference on session */
       gboolean weakref;
+      /* Monotonic time of the last idle state change of the session, used
+       * to find the least recently used sessions to evict */
+      gint64 last_active;
     } note;
 
     struct {
@@ -103,6 +107,12 @@ struct _InfdDirectoryNode {
   } shared;
 };
 
+typedef struct _InfdDirectorySessionUsage InfdDirectorySessionUsage;
+struct _InfdDirectorySessionUsage {
+  InfdDirectoryNode* node;
+  gsize usage;
+};
+
 typedef struct _InfdDirectorySessionSaveTimeoutData
   InfdDirectorySessionSaveTimeoutData;
 struct _InfdDirectorySessionSaveTimeoutData {
@@ -207,6 +217,13 @@ struct _InfdDirectoryPrivate {
   GSList* subscription_requests;
 
   InfdSessionProxy* chat_session;
+
+  /* Memory budget for loaded sessions in bytes, or 0 for no limit */
+  guint64 memory_budget;
+  InfIoTimeout* memory_timeout;
+  guint n_evicted_sessions;
+
+  gboolean drop_congested_subscribers;
 };
 
 enum {
@@ -220,6 +237,9 @@ enum {
   PROP_PRIVATE_KEY,
   PROP_CERTIFICATE,
 
+  PROP_MEMORY_BUDGET,
+  PROP_DROP_CONGESTED_SUBSCRIBERS,
+
   /* read only */
   PROP_CHAT_SESSION,
   PROP_STATUS
@@ -279,6 +299,15 @@ static GQuark infd_directory_node_id_quark;
 /* TODO: This should be a property: */
 static const guint INFD_DIRECTORY_SAVE_TIMEOUT = 60000;
 
+/* Maximum number of accounts sent in reply to a query-acl-account-range
+ * request. Clients asking for more get a shorter chunk and need to ask for
+ * the rest separately. */
+static const guint INFD_DIRECTORY_ACCOUNT_RANGE_MAX = 500;
+
+/* Interval in which memory usage of loaded sessions is checked against the
+ * memory budget, if one is set */
+static const guint INFD_DIRECTORY_MEMORY_CHECK_INTERVAL = 10000;
+
 static void infd_directory_communication_object_iface_init(InfCommunicationObjectInterface* iface);
 static void infd_directory_browser_iface_init(InfBrowserInterface* iface);
 G_DEFINE_TYPE_WITH_CODE(InfdDirectory, infd_directory, G_TYPE_OBJECT,
@@ -383,38 +412,93 @@ infd_directory_session_save_timeout_data_free(gpointer data)
   g_slice_free(InfdDirectorySessionSaveTimeoutData, data);
 }
 
-static void
-infd_directory_session_save_timeout_func(gpointer user_data)
+static InfSession*
+infd_directory_session_read(InfdDirectory* directory,
+                            const InfdNotePlugin* plugin,
+                            const gchar* path,
+                            GError** error)
+{
+  InfdDirectoryPrivate* priv;
+  InfSession* session;
+  INF_TRACE_DECLARE(trace_start);
+
+  priv = INFD_DIRECTORY_PRIVATE(directory);
+
+  INF_TRACE_BEGIN(trace_start);
+
+  session = plugin->session_read(
+    priv->storage,
+    priv->io,
+    priv->communication_manager,
+    path,
+    plugin->user_data,
+    error
+  );
+
+  INF_TRACE_END(INF_TRACE_STORAGE_READ, trace_start);
+  return session;
+}
+
+static gboolean
+infd_directory_session_write(InfdDirectory* directory,
+                             const InfdNotePlugin* plugin,
+                             InfSession* session,
+                             const gchar* path,
+                             GError** error)
+{
+  InfdDirectoryPrivate* priv;
+  gboolean result;
+  INF_TRACE_DECLARE(trace_start);
+
+  priv = INFD_DIRECTORY_PRIVATE(directory);
+
+  INF_TRACE_BEGIN(trace_start);
+
+  result = plugin->session_write(
+    priv->storage,
+    session,
+    path,
+    plugin->user_data,
+    error
+  );
+
+  INF_TRACE_END(INF_TRACE_STORAGE_WRITE, trace_start);
+  return result;
+}
+
+/* Writes the session of node into the storage and releases it from memory
+ * if that succeeds. If it fails, a warning is printed and the session is
+ * kept in memory. */
+static gboolean
+infd_directory_session_save_and_unlink(InfdDirectory* directory,
+                                       InfdDirectoryNode* node)
 {
-  InfdDirectorySessionSaveTimeoutData* timeout_data;
   InfdDirectoryPrivate* priv;
   GError* error;
   gchar* path;
   gboolean result;
   InfSession* session;
 
-  timeout_data = (InfdDirectorySessionSaveTimeoutData*)user_data;
-
-  g_assert(timeout_data->node->type == INFD_DIRECTORY_NODE_NOTE);
-  g_assert(timeout_data->node->shared.note.save_timeout != NULL);
-  priv = INFD_DIRECTORY_PRIVATE(timeout_data->directory);
+  g_assert(node->type == INFD_DIRECTORY_NODE_NOTE);
+  g_assert(node->shared.note.save_timeout == NULL);
+  priv = INFD_DIRECTORY_PRIVATE(directory);
   error = NULL;
 
-  infd_directory_node_get_path(timeout_data->node, &path, NULL);
+  infd_directory_node_get_path(node, &path, NULL);
 
   g_object_get(
-    G_OBJECT(timeout_data->node->shared.note.session),
+    G_OBJECT(node->shared.note.session),
     "session", &session,
     NULL
   );
 
   /* TODO: Only write if the buffer modified-flag is set */
 
-  result = timeout_data->node->shared.note.plugin->session_write(
-    priv->storage,
+  result = infd_directory_session_write(
+    directory,
+    node->shared.note.plugin,
     session,
     path,
-    timeout_data->node->shared.note.plugin->user_data,
     &error
   );
 
@@ -422,9 +506,6 @@ infd_directory_session_save_timeout_func(gpointer user_data)
 
   /* TODO: Unset modified flag of buffer if result == TRUE */
 
-  /* The timeout is removed automatically after it has elapsed */
-  timeout_data->node->shared.note.save_timeout = NULL;
-
   if(result == FALSE)
   {
     g_warning(
@@ -438,14 +519,29 @@ infd_directory_session_save_timeout_func(gpointer user_data)
   }
   else
   {
-    infd_directory_node_unlink_session(
-      timeout_data->directory,
-      timeout_data->node,
-      NULL
-    );
+    infd_directory_node_unlink_session(directory, node, NULL);
   }
 
   g_free(path);
+  return result;
+}
+
+static void
+infd_directory_session_save_timeout_func(gpointer user_data)
+{
+  InfdDirectorySessionSaveTimeoutData* timeout_data;
+  timeout_data = (InfdDirectorySessionSaveTimeoutData*)user_data;
+
+  g_assert(timeout_data->node->type == INFD_DIRECTORY_NODE_NOTE);
+  g_assert(timeout_data->node->shared.note.save_timeout != NULL);
+
+  /* The timeout is removed automatically after it has elapsed */
+  timeout_data->node->shared.note.save_timeout = NULL;
+
+  infd_directory_session_save_and_unlink(
+    timeout_data->directory,
+    timeout_data->node
+  );
 }
 
 static void
@@ -503,6 +599,8 @@ infd_directory_session_idle_notify_cb(GObject* object,
   node = g_hash_table_lookup(priv->nodes, node_id);
   g_assert(node != NULL);
 
+  node->shared.note.last_active = g_get_monotonic_time();
+
   /* Drop session from memory if it remains idle */
   if(infd_session_proxy_is_idle(INFD_SESSION_PROXY(object)))
   {
@@ -535,6 +633,253 @@ infd_directory_session_idle_notify_cb(GObject* object,
   }
 }
 
+/*
+ * Memory budget
+ */
+
+static gsize
+infd_directory_node_get_memory_usage(InfdDirectoryNode* node)
+{
+  InfSession* session;
+  gsize usage;
+
+  g_assert(node->type == INFD_DIRECTORY_NODE_NOTE);
+  g_assert(node->shared.note.session != NULL);
+
+  g_object_get(
+    G_OBJECT(node->shared.note.session),
+    "session", &session,
+    NULL
+  );
+
+  usage = inf_session_get_memory_usage(session);
+  g_object_unref(session);
+
+  return usage;
+}
+
+static void
+infd_directory_node_trim_session(InfdDirectoryNode* node)
+{
+  InfSession* session;
+
+  g_assert(node->type == INFD_DIRECTORY_NODE_NOTE);
+  g_assert(node->shared.note.session != NULL);
+
+  g_object_get(
+    G_OBJECT(node->shared.note.session),
+    "session", &session,
+    NULL
+  );
+
+  inf_session_trim(session);
+  g_object_unref(session);
+}
+
+static gint
+infd_directory_session_usage_compare_func(gconstpointer first,
+                                          gconstpointer second)
+{
+  const InfdDirectorySessionUsage* first_usage;
+  const InfdDirectorySessionUsage* second_usage;
+
+  first_usage = (const InfdDirectorySessionUsage*)first;
+  second_usage = (const InfdDirectorySessionUsage*)second;
+
+  if(first_usage->node->shared.note.last_active <
+     second_usage->node->shared.note.last_active)
+  {
+    return -1;
+  }
+  else if(first_usage->node->shared.note.last_active >
+          second_usage->node->shared.note.last_active)
+  {
+    return 1;
+  }
+
+  return 0;
+}
+
+/* Returns an array of InfdDirectorySessionUsage for all sessions that are
+ * currently kept in memory by the directory. */
+static GArray*
+infd_directory_get_session_usage(InfdDirectory* directory,
+                                 guint64* total)
+{
+  InfdDirectoryPrivate* priv;
+  GArray* sessions;
+  GHashTableIter iter;
+  gpointer value;
+  InfdDirectoryNode* node;
+  InfdDirectorySessionUsage entry;
+
+  priv = INFD_DIRECTORY_PRIVATE(directory);
+  sessions = g_array_new(FALSE, FALSE, sizeof(InfdDirectorySessionUsage));
+  *total = 0;
+
+  g_hash_table_iter_init(&iter, priv->nodes);
+  while(g_hash_table_iter_next(&iter, NULL, &value))
+  {
+    node = (InfdDirectoryNode*)value;
+    if(node->type == INFD_DIRECTORY_NODE_NOTE &&
+       node->shared.note.session != NULL &&
+       node->shared.note.weakref == FALSE)
+    {
+      entry.node = node;
+      entry.usage = infd_directory_node_get_memory_usage(node);
+      g_array_append_val(sessions, entry);
+
+      *total += entry.usage;
+    }
+  }
+
+  return sessions;
+}
+
+/* If the loaded sessions occupy more memory than the memory budget allows,
+ * then first drop caches of the sessions that are in use, and then unload
+ * idle sessions, least recently used first, until we are within budget. */
+static void
+infd_directory_enforce_memory_budget(InfdDirectory* directory)
+{
+  InfdDirectoryPrivate* priv;
+  GArray* sessions;
+  InfdDirectorySessionUsage* entry;
+  guint64 total;
+  guint i;
+
+  priv = INFD_DIRECTORY_PRIVATE(directory);
+  if(priv->memory_budget == 0)
+    return;
+
+  sessions = infd_directory_get_session_usage(directory, &total);
+
+  if(total > priv->memory_budget)
+  {
+    for(i = 0; i < sessions->len; ++i)
+    {
+      entry = &g_array_index(sessions, InfdDirectorySessionUsage, i);
+
+      /* Sessions with a save timeout are idle and are unloaded below */
+      if(entry->node->shared.note.save_timeout == NULL)
+      {
+        infd_directory_node_trim_session(entry->node);
+
+        total -= entry->usage;
+        entry->usage = infd_directory_node_get_memory_usage(entry->node);
+        total += entry->usage;
+      }
+    }
+  }
+
+  if(total > priv->memory_budget)
+  {
+    g_array_sort(sessions, infd_directory_session_usage_compare_func);
+
+    for(i = 0; i < sessions->len && total > priv->memory_budget; ++i)
+    {
+      entry = &g_array_index(sessions, InfdDirectorySessionUsage, i);
+      if(entry->node->shared.note.save_timeout == NULL)
+        continue;
+
+      inf_io_remove_timeout(priv->io, entry->node->shared.note.save_timeout);
+      entry->node->shared.note.save_timeout = NULL;
+
+      if(infd_directory_session_save_and_unlink(directory, entry->node))
+      {
+        total -= entry->usage;
+        ++priv->n_evicted_sessions;
+      }
+    }
+  }
+
+  g_array_free(sessions, TRUE);
+}
+
+static void
+infd_directory_memory_timeout_func(gpointer user_data)
+{
+  InfdDirectory* directory;
+  InfdDirectoryPrivate* priv;
+
+  directory = INFD_DIRECTORY(user_data);
+  priv = INFD_DIRECTORY_PRIVATE(directory);
+  priv->memory_timeout = NULL;
+
+  infd_directory_enforce_memory_budget(directory);
+
+  priv->memory_timeout = inf_io_add_timeout(
+    priv->io,
+    INFD_DIRECTORY_MEMORY_CHECK_INTERVAL,
+    infd_directory_memory_timeout_func,
+    directory,
+    NULL
+  );
+}
+
+static void
+infd_directory_set_memory_budget(InfdDirectory* directory,
+                                 guint64 budget)
+{
+  InfdDirectoryPrivate* priv;
+  priv = INFD_DIRECTORY_PRIVATE(directory);
+
+  priv->memory_budget = budget;
+
+  if(budget == 0 && priv->memory_timeout != NULL)
+  {
+    inf_io_remove_timeout(priv->io, priv->memory_timeout);
+    priv->memory_timeout = NULL;
+  }
+  else if(budget != 0 && priv->memory_timeout == NULL && priv->io != NULL)
+  {
+    priv->memory_timeout = inf_io_add_timeout(
+      priv->io,
+      INFD_DIRECTORY_MEMORY_CHECK_INTERVAL,
+      infd_directory_memory_timeout_func,
+      directory,
+      NULL
+    );
+  }
+}
+
+static void
+infd_directory_set_drop_congested_subscribers(InfdDirectory* directory,
+                                              gboolean drop)
+{
+  InfdDirectoryPrivate* priv;
+  GHashTableIter iter;
+  gpointer value;
+  InfdDirectoryNode* node;
+
+  priv = INFD_DIRECTORY_PRIVATE(directory);
+  priv->drop_congested_subscribers = drop;
+
+  g_hash_table_iter_init(&iter, priv->nodes);
+  while(g_hash_table_iter_next(&iter, NULL, &value))
+  {
+    node = (InfdDirectoryNode*)value;
+    if(node->type == INFD_DIRECTORY_NODE_NOTE &&
+       node->shared.note.session != NULL)
+    {
+      g_object_set(
+        G_OBJECT(node->shared.note.session),
+        "drop-congested", drop,
+        NULL
+      );
+    }
+  }
+
+  if(priv->chat_session != NULL)
+  {
+    g_object_set(
+      G_OBJECT(priv->chat_session),
+      "drop-congested", drop,
+      NULL
+    );
+  }
+}
+
 static gboolean
 infd_directory_session_reject_user_join_cb(InfdSessionProxy* proxy,
                                            InfXmlConnection* connection,
@@ -1831,6 +2176,7 @@ infd_directory_create_session_proxy_with_group(InfdDirectory* directory,
       "io", priv->io,
       "session", session,
       "subscription-group", g,
+      "drop-congested", priv->drop_congested_subscribers,
       NULL
     )
   );
@@ -1916,11 +2262,11 @@ infd_directory_session_proxy_ensure(InfdDirectory* directory,
     /* Save session initially */
     infd_directory_node_make_path(parent, name, &path, NULL);
 
-    ret = plugin->session_write(
-      priv->storage,
+    ret = infd_directory_session_write(
+      directory,
+      plugin,
       session,
       path,
-      plugin->user_data,
       error
     );
 
@@ -2061,11 +2407,11 @@ infd_directory_node_unlink_child_sessions(InfdDirectory* directory,
             NULL
           );
 
-          node->shared.note.plugin->session_write(
-            priv->storage,
+          infd_directory_session_write(
+            directory,
+            node->shared.note.plugin,
             session,
             path,
-            node->shared.note.plugin->user_data,
             &error
           );
 
@@ -2255,6 +2601,7 @@ infd_directory_node_new_note(InfdDirectory* directory,
   node->shared.note.plugin = plugin;
   node->shared.note.save_timeout = NULL;
   node->shared.note.weakref = FALSE;
+  node->shared.note.last_active = 0;
 
   return node;
 }
@@ -2722,6 +3069,118 @@ infd_directory_lookup_transient_account(InfdDirectory* directory,
   return NULL;
 }
 
+static int
+infd_directory_account_compare_func(gconstpointer first,
+                                    gconstpointer second)
+{
+  return inf_acl_account_id_compare(
+    ((const InfAclAccount*)first)->id,
+    ((const InfAclAccount*)second)->id
+  );
+}
+
+/* Returns at most max accounts from both the transient accounts and the
+ * account storage, ordered by inf_acl_account_id_compare(). next is set to
+ * the ID of the last returned account if there are more accounts, or to 0
+ * otherwise. The result needs to be freed with inf_acl_account_array_free. */
+static InfAclAccount*
+infd_directory_list_accounts_range(InfdDirectory* directory,
+                                   const gchar* prefix,
+                                   InfAclAccountId after,
+                                   guint max,
+                                   guint* n_accounts,
+                                   InfAclAccountId* next,
+                                   GError** error)
+{
+  InfdDirectoryPrivate* priv;
+  GArray* result;
+  InfAclAccount* accounts;
+  guint n_stored;
+  const InfAclAccount* transient;
+  InfAclAccount account;
+  gsize prefix_len;
+  GError* local_error;
+  guint i;
+
+  priv = INFD_DIRECTORY_PRIVATE(directory);
+  g_assert(max > 0);
+
+  accounts = NULL;
+  n_stored = 0;
+
+  if(priv->account_storage != NULL)
+  {
+    /* Ask for one more account than we need, so that we can tell whether
+     * there are more accounts after this chunk. */
+    local_error = NULL;
+
+    accounts = infd_account_storage_list_accounts_range(
+      priv->account_storage,
+      prefix,
+      after,
+      max + 1,
+      &n_stored,
+      &local_error
+    );
+
+    if(local_error != NULL)
+    {
+      g_propagate_error(error, local_error);
+      return NULL;
+    }
+  }
+
+  result = g_array_sized_new(
+    FALSE,
+    FALSE,
+    sizeof(InfAclAccount),
+    n_stored + priv->n_transient_accounts
+  );
+
+  /* The array takes ownership of the account names */
+  if(n_stored > 0)
+    g_array_append_vals(result, accounts, n_stored);
+  g_free(accounts);
+
+  prefix_len = (prefix != NULL) ? strlen(prefix) : 0;
+  for(i = 0; i < priv->n_transient_accounts; ++i)
+  {
+    transient = &priv->transient_accounts[i].account;
+    if(inf_acl_account_id_compare(transient->id, after) <= 0)
+      continue;
+    if(prefix_len > 0 &&
+       (transient->name == NULL ||
+        strncmp(transient->name, prefix, prefix_len) != 0))
+    {
+      continue;
+    }
+
+    account.id = transient->id;
+    account.name = g_strdup(transient->name);
+    g_array_append_val(result, account);
+  }
+
+  g_array_sort(result, infd_directory_account_compare_func);
+
+  *next = 0;
+  if(result->len > max)
+  {
+    for(i = max; i < result->len; ++i)
+      g_free(g_array_index(result, InfAclAccount, i).name);
+    g_array_set_size(result, max);
+    *next = g_array_index(result, InfAclAccount, max - 1).id;
+  }
+
+  *n_accounts = result->len;
+  if(result->len == 0)
+  {
+    g_array_free(result, TRUE);
+    return NULL;
+  }
+
+  return (InfAclAccount*)g_array_free(result, FALSE);
+}
+
 static InfAclAccount*
 infd_directory_lookup_account(InfdDirectory* directory,
                               InfAclAccountId account,
@@ -3710,11 +4169,11 @@ infd_directory_sync_in_synchronization_complete_cb(InfSession* session,
 
   if(priv->storage != NULL)
   {
-    ret = plugin->session_write(
-      priv->storage,
+    ret = infd_directory_session_write(
+      directory,
+      plugin,
       session,
       path,
-      plugin->user_data,
       &error
     );
   }
@@ -5082,12 +5541,10 @@ infd_directory_node_make_session(InfdDirectory* directory,
   g_assert(priv->storage != NULL);
 
   infd_directory_node_get_path(node, &path, NULL);
-  session = node->shared.note.plugin->session_read(
-    priv->storage,
-    priv->io,
-    priv->communication_manager,
+  session = infd_directory_session_read(
+    directory,
+    node->shared.note.plugin,
     path,
-    node->shared.note.plugin->user_data,
     error
   );
   g_free(path);
@@ -6245,11 +6702,11 @@ infd_directory_handle_save_session(InfdDirectory* directory,
 
   /* TODO: Make a request */
 
-  result = node->shared.note.plugin->session_write(
-    priv->storage,
+  result = infd_directory_session_write(
+    directory,
+    node->shared.note.plugin,
     session,
     path,
-    node->shared.note.plugin->user_data,
     error
   );
 
@@ -6727,6 +7184,122 @@ infd_directory_handle_query_acl_account_list(InfdDirectory* directory,
   return TRUE;
 }
 
+static gboolean
+infd_directory_handle_query_acl_account_range(InfdDirectory* directory,
+                                              InfXmlConnection* connection,
+                                              const xmlNodePtr xml,
+                                              GError** error)
+{
+  InfdDirectoryPrivate* priv;
+  InfdDirectoryNode* node;
+  InfAclMask perms;
+  GError* local_error;
+  gchar* seq;
+  xmlNodePtr reply_xml;
+  xmlNodePtr reply_child;
+
+  xmlChar* prefix;
+  xmlChar* after_attr;
+  InfAclAccountId after;
+  guint max;
+
+  InfAclAccount* accounts;
+  guint n_accounts;
+  InfAclAccountId next;
+  guint i;
+
+  priv = INFD_DIRECTORY_PRIVATE(directory);
+
+  node = priv->root;
+  inf_acl_mask_set1(&perms, INF_ACL_CAN_QUERY_ACCOUNT_LIST);
+  if(!infd_directory_check_auth(directory, node, connection, &perms, error))
+    return FALSE;
+
+  local_error = NULL;
+  if(!inf_xml_util_get_attribute_uint(xml, "max", &max, &local_error))
+  {
+    if(local_error != NULL)
+    {
+      g_propagate_error(error, local_error);
+      return FALSE;
+    }
+
+    max = INFD_DIRECTORY_ACCOUNT_RANGE_MAX;
+  }
+
+  if(max == 0 || max > INFD_DIRECTORY_ACCOUNT_RANGE_MAX)
+    max = INFD_DIRECTORY_ACCOUNT_RANGE_MAX;
+
+  after = 0;
+  after_attr = inf_xml_util_get_attribute(xml, "after");
+  if(after_attr != NULL)
+  {
+    after = inf_acl_account_id_from_string((const gchar*)after_attr);
+    xmlFree(after_attr);
+  }
+
+  if(!infd_directory_make_seq(directory, connection, xml, &seq, error))
+    return FALSE;
+
+  prefix = inf_xml_util_get_attribute(xml, "prefix");
+
+  accounts = infd_directory_list_accounts_range(
+    directory,
+    (const gchar*)prefix,
+    after,
+    max,
+    &n_accounts,
+    &next,
+    &local_error
+  );
+
+  if(prefix != NULL)
+    xmlFree(prefix);
+
+  if(local_error != NULL)
+  {
+    g_propagate_error(error, local_error);
+    g_free(seq);
+    return FALSE;
+  }
+
+  reply_xml = xmlNewNode(NULL, (const xmlChar*)"query-acl-account-range");
+  if(seq != NULL) inf_xml_util_set_attribute(reply_xml, "seq", seq);
+  g_free(seq);
+
+  if(next != 0)
+  {
+    inf_xml_util_set_attribute(
+      reply_xml,
+      "next",
+      inf_acl_account_id_to_string(next)
+    );
+  }
+
+  for(i = 0; i < n_accounts; ++i)
+  {
+    reply_child = xmlNewChild(
+      reply_xml,
+      NULL,
+      (const xmlChar*)"account",
+      NULL
+    );
+
+    inf_acl_account_to_xml(&accounts[i], reply_child);
+  }
+
+  if(accounts != NULL)
+    inf_acl_account_array_free(accounts, n_accounts);
+
+  inf_communication_group_send_message(
+    INF_COMMUNICATION_GROUP(priv->group),
+    connection,
+    reply_xml
+  );
+
+  return TRUE;
+}
+
 static gboolean
 infd_directory_handle_lookup_acl_accounts(InfdDirectory* directory,
                                           InfXmlConnection* connection,
@@ -6753,6 +7326,7 @@ infd_directory_handle_lookup_acl_accounts(InfdDirectory* directory,
   guint i;
 
   GArray* to_be_looked_up;
+  GHashTable* seen_ids;
   GError* local_error;
 
   priv = INFD_DIRECTORY_PRIVATE(directory);
@@ -6770,9 +7344,12 @@ infd_directory_handle_lookup_acl_accounts(InfdDirectory* directory,
   if(seq != NULL) inf_xml_util_set_attribute(reply_xml, "seq", seq);
   g_free(seq);
 
-  /* TODO: Try to avoid duplicates in the following */
+  /* Clients may ask for the same ID more than once, for example when
+   * looking up the accounts of many ACL sheets at once. Only look up and
+   * send each ID once. Duplicates by name are still possible. */
   default_id = inf_acl_account_id_from_string("default");
   to_be_looked_up = g_array_new(FALSE, FALSE, sizeof(InfAclAccountId));
+  seen_ids = g_hash_table_new(NULL, NULL);
   for(child = xml->children; child != NULL; child = child->next)
   {
     if(child->type != XML_ELEMENT_NODE) continue;
@@ -6786,8 +7363,11 @@ infd_directory_handle_lookup_acl_accounts(InfdDirectory* directory,
         content = (const gchar*)child->children->content;
       id = inf_acl_account_id_from_string(content);
 
-      if(id != 0 && id != default_id)
+      if(id != 0 && id != default_id &&
+         !g_hash_table_contains(seen_ids, INF_ACL_ACCOUNT_ID_TO_POINTER(id)))
       {
+        g_hash_table_add(seen_ids, INF_ACL_ACCOUNT_ID_TO_POINTER(id));
+
         transient = infd_directory_lookup_transient_account(directory, id);
         if(transient != NULL)
         {
@@ -6832,6 +7412,7 @@ infd_directory_handle_lookup_acl_accounts(InfdDirectory* directory,
           {
             xmlFreeNode(reply_xml);
             g_array_free(to_be_looked_up, TRUE);
+            g_hash_table_destroy(seen_ids);
             g_propagate_error(error, local_error);
             return FALSE;
           }
@@ -6885,6 +7466,7 @@ infd_directory_handle_lookup_acl_accounts(InfdDirectory* directory,
     {
       xmlFreeNode(reply_xml);
       g_array_free(to_be_looked_up, TRUE);
+      g_hash_table_destroy(seen_ids);
       g_propagate_error(error, local_error);
       return FALSE;
     }
@@ -6908,6 +7490,7 @@ infd_directory_handle_lookup_acl_accounts(InfdDirectory* directory,
   }
 
   g_array_free(to_be_looked_up, TRUE);
+  g_hash_table_destroy(seen_ids);
 
   inf_communication_group_send_message(
     INF_COMMUNICATION_GROUP(priv->group),
@@ -8563,6 +9146,12 @@ infd_directory_init(InfdDirectory* directory)
   priv->subscription_requests = NULL;
 
   priv->chat_session = NULL;
+
+  priv->memory_budget = 0;
+  priv->memory_timeout = NULL;
+  priv->n_evicted_sessions = 0;
+
+  priv->drop_congested_subscribers = FALSE;
 }
 
 static void
@@ -8669,6 +9258,12 @@ infd_directory_dispose(GObject* object)
   if(priv->chat_session != NULL)
     infd_directory_enable_chat(directory, FALSE);
 
+  if(priv->memory_timeout != NULL)
+  {
+    inf_io_remove_timeout(priv->io, priv->memory_timeout);
+    priv->memory_timeout = NULL;
+  }
+
   /* This frees the complete directory tree and saves sessions into the
    * storage. */
   infd_directory_node_unlink_child_sessions(
@@ -8783,6 +9378,16 @@ infd_directory_set_property(GObject* object,
     break;
   case PROP_CERTIFICATE:
     priv->certificate = (InfCertificateChain*)g_value_dup_boxed(value);
+    break;
+  case PROP_MEMORY_BUDGET:
+    infd_directory_set_memory_budget(directory, g_value_get_uint64(value));
+    break;
+  case PROP_DROP_CONGESTED_SUBSCRIBERS:
+    infd_directory_set_drop_congested_subscribers(
+      directory,
+      g_value_get_boolean(value)
+    );
+
     break;
   case PROP_CHAT_SESSION:
   case PROP_STATUS:
@@ -8825,6 +9430,12 @@ infd_directory_get_property(GObject* object,
   case PROP_CERTIFICATE:
     g_value_set_boxed(value, priv->certificate);
     break;
+  case PROP_MEMORY_BUDGET:
+    g_value_set_uint64(value, priv->memory_budget);
+    break;
+  case PROP_DROP_CONGESTED_SUBSCRIBERS:
+    g_value_set_boolean(value, priv->drop_congested_subscribers);
+    break;
   case PROP_CHAT_SESSION:
     g_value_set_object(value, G_OBJECT(priv->chat_session));
     break;
@@ -8937,6 +9548,15 @@ infd_directory_communication_object_received(InfCommunicationObject* object,
       &local_error
     );
   }
+  else if(strcmp((const char*)node->name, "query-acl-account-range") == 0)
+  {
+    infd_directory_handle_query_acl_account_range(
+      directory,
+      connection,
+      node,
+      &local_error
+    );
+  }
   else if(strcmp((const char*)node->name, "lookup-acl-accounts") == 0)
   {
     infd_directory_handle_lookup_acl_accounts(
@@ -9068,6 +9688,7 @@ infd_directory_browser_subscribe_session(InfBrowser* browser,
     }
 
     node->shared.note.weakref = FALSE;
+    node->shared.note.last_active = g_get_monotonic_time();
 
     g_object_set_qdata(
       G_OBJECT(proxy),
@@ -9954,6 +10575,78 @@ infd_directory_browser_query_acl_account_list(InfBrowser* browser,
   return NULL;
 }
 
+static InfRequest*
+infd_directory_browser_query_acl_account_range(InfBrowser* browser,
+                                               const gchar* prefix,
+                                               InfAclAccountId after,
+                                               guint max,
+                                               InfRequestFunc func,
+                                               gpointer user_data)
+{
+  InfdDirectory* directory;
+  InfRequest* request;
+  InfAclAccount* accounts;
+  guint n_accounts;
+  InfAclAccountId next;
+  GError* error;
+
+  directory = INFD_DIRECTORY(browser);
+
+  request = g_object_new(
+    INFD_TYPE_REQUEST,
+    "type", "query-acl-account-range",
+    "requestor", NULL,
+    NULL
+  );
+
+  if(func != NULL)
+  {
+    g_signal_connect_after(
+      G_OBJECT(request),
+      "finished",
+      G_CALLBACK(func),
+      user_data
+    );
+  }
+
+  inf_browser_begin_request(browser, NULL, INF_REQUEST(request));
+
+  error = NULL;
+  accounts = infd_directory_list_accounts_range(
+    directory,
+    prefix,
+    after,
+    max,
+    &n_accounts,
+    &next,
+    &error
+  );
+
+  if(error != NULL)
+  {
+    inf_request_fail(request, error);
+    g_error_free(error);
+  }
+  else
+  {
+    inf_request_finish(
+      request,
+      inf_request_result_make_query_acl_account_range(
+        browser,
+        accounts,
+        n_accounts,
+        next
+      )
+    );
+
+    if(accounts != NULL)
+      inf_acl_account_array_free(accounts, n_accounts);
+  }
+
+  g_object_unref(request);
+  return NULL;
+}
+
 static InfRequest*
 infd_directory_browser_lookup_acl_accounts(InfBrowser* browser,
                                            const InfAclAccountId* ids,
@@ -10587,6 +11280,34 @@ infd_directory_class_init(InfdDirectoryClass* directory_class)
     )
   );
 
+  g_object_class_install_property(
+    object_class,
+    PROP_MEMORY_BUDGET,
+    g_param_spec_uint64(
+      "memory-budget",
+      "Memory budget",
+      "Approximate number of bytes that loaded sessions may occupy before "
+      "idle sessions are unloaded, or 0 for no limit",
+      0,
+      G_MAXUINT64,
+      0,
+      G_PARAM_READWRITE
+    )
+  );
+
+  g_object_class_install_property(
+    object_class,
+    PROP_DROP_CONGESTED_SUBSCRIBERS,
+    g_param_spec_boolean(
+      "drop-congested-subscribers",
+      "Drop congested subscribers",
+      "Whether sessions unsubscribe connections that do not keep up with "
+      "reading, see InfdSessionProxy:drop-congested",
+      FALSE,
+      G_PARAM_READWRITE
+    )
+  );
+
   g_object_class_install_property(
     object_class,
     PROP_CHAT_SESSION,
@@ -10688,6 +11409,8 @@ infd_directory_browser_iface_init(InfBrowserInterface* iface)
   iface->get_acl_local_account = infd_directory_browser_get_acl_local_account;
   iface->query_acl_account_list =
     infd_directory_browser_query_acl_account_list;
+  iface->query_acl_account_range =
+    infd_directory_browser_query_acl_account_range;
   iface->lookup_acl_accounts = infd_directory_browser_lookup_acl_accounts;
   iface->lookup_acl_account_by_name =
     infd_directory_browser_lookup_acl_account_by_name;
@@ -11343,11 +12066,11 @@ infd_directory_iter_save_session(InfdDirectory* directory,
     NULL
   );
 
-  result = node->shared.note.plugin->session_write(
-    priv->storage,
+  result = infd_directory_session_write(
+    directory,
+    node->shared.note.plugin,
     session,
     path,
-    node->shared.note.plugin->user_data,
     error
   );
 
@@ -11415,6 +12138,7 @@ infd_directory_enable_chat(InfdDirectory* directory,
           "io", priv->io,
           "session", chat_session,
           "subscription-group", group,
+          "drop-congested", priv->drop_congested_subscribers,
           NULL
         )
       );
@@ -11481,6 +12205,47 @@ infd_directory_get_chat_session(InfdDirectory* directory)
   return INFD_DIRECTORY_PRIVATE(directory)->chat_session;
 }
 
+/**
+ * infd_directory_get_memory_usage:
+ * @directory: A #InfdDirectory.
+ *
+ * Returns an estimate of the number of bytes occupied by all sessions that
+ * @directory currently keeps in memory, as computed by
+ * inf_session_get_memory_usage(). This is the value that is compared against
+ * the #InfdDirectory:memory-budget property.
+ *
+ * Returns: The approximate memory usage of loaded sessions, in bytes.
+ */
+guint64
+infd_directory_get_memory_usage(InfdDirectory* directory)
+{
+  GArray* sessions;
+  guint64 total;
+
+  g_return_val_if_fail(INFD_IS_DIRECTORY(directory), 0);
+
+  sessions = infd_directory_get_session_usage(directory, &total);
+  g_array_free(sessions, TRUE);
+
+  return total;
+}
+
+/**
+ * infd_directory_get_n_evicted_sessions:
+ * @directory: A #InfdDirectory.
+ *
+ * Returns the number of idle sessions that have been unloaded from memory
+ * ahead of time because the #InfdDirectory:memory-budget was exceeded.
+ *
+ * Returns: The number of sessions evicted due to memory pressure.
+ */
+guint
+infd_directory_get_n_evicted_sessions(InfdDirectory* directory)
+{
+  g_return_val_if_fail(INFD_IS_DIRECTORY(directory), 0);
+  return INFD_DIRECTORY_PRIVATE(directory)->n_evicted_sessions;
+}
+
 /**
  * infd_directory_create_acl_account:
  * @directory: A #InfdDirectory.
@@ -156,6 +156,12 @@ infd_directory_enable_chat(InfdDirectory* directory,
 InfdSessionProxy*
 infd_directory_get_chat_session(InfdDirectory* directory);
 
+guint64
+infd_directory_get_memory_usage(InfdDirectory* directory);
+
+guint
+infd_directory_get_n_evicted_sessions(InfdDirectory* directory);
+
 InfAclAccountId
 infd_directory_create_acl_account(InfdDirectory* directory,
                                   const gchar* account_name,
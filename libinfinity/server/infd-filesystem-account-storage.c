@@ -33,6 +33,21 @@
  * accounts read from the file in memory. When you have more than a thousand
  * accounts or so you should start thinking of using a more sophisticated
  * account storage, for example a database backend.
+ *
+ * Passwords are stored as salted PBKDF2 hashes, with a configurable number
+ * of iterations. Accounts whose password was hashed with a different
+ * function or number of iterations are transparently re-hashed on the next
+ * successful login. Since verifying a password is deliberately expensive,
+ * successful logins are remembered for a short time, so that a client which
+ * reconnects right away does not need to be verified again.
+ *
+ * infd_account_storage_login_by_password() is thread-safe, but it hashes
+ * the password in the calling thread, so it blocks the main loop when called
+ * from there. Call it from a worker thread instead, for example from the
+ * blocking callback of a #InfSaslContext set with
+ * inf_sasl_context_set_blocking_callback(). All other functions must be
+ * called from the main thread, and they wait for password logins in other
+ * threads to finish accessing the accounts.
  **/
 
 #include <libinfinity/server/infd-filesystem-account-storage.h>
@@ -47,6 +62,22 @@
 
 #include <string.h>
 
+/* Length of password salts and hashes, in bytes */
+#define INFD_FILESYSTEM_ACCOUNT_STORAGE_HASH_LEN 32
+
+typedef gboolean(*InfdFilesystemAccountStorageKdfFunc)(const gchar* password,
+                                                       const gchar* salt,
+                                                       guint iterations,
+                                                       gchar* hash,
+                                                       GError** error);
+
+typedef struct _InfdFilesystemAccountStorageKdf
+  InfdFilesystemAccountStorageKdf;
+struct _InfdFilesystemAccountStorageKdf {
+  const gchar* name;
+  InfdFilesystemAccountStorageKdfFunc func;
+};
+
 typedef struct _InfdFilesystemAccountStorageAccountInfo
   InfdFilesystemAccountStorageAccountInfo;
 struct _InfdFilesystemAccountStorageAccountInfo {
@@ -56,10 +87,24 @@ struct _InfdFilesystemAccountStorageAccountInfo {
   guint n_certificates;
   gchar* password_salt;
   gchar* password_hash;
+  const InfdFilesystemAccountStorageKdf* password_kdf;
+  guint password_iterations;
+  /* The salt of the hash that was replaced when the password was re-hashed
+   * on login, or NULL if the password has not been re-hashed since it was
+   * last set. Not stored on disk. */
+  gchar* rehashed_salt;
   gint64 first_seen;
   gint64 last_seen;
 };
 
+typedef struct _InfdFilesystemAccountStorageCachedCredential
+  InfdFilesystemAccountStorageCachedCredential;
+struct _InfdFilesystemAccountStorageCachedCredential {
+  gchar salt[INFD_FILESYSTEM_ACCOUNT_STORAGE_HASH_LEN];
+  gchar digest[INFD_FILESYSTEM_ACCOUNT_STORAGE_HASH_LEN];
+  gint64 expiration;
+};
+
 typedef struct _InfdFilesystemAccountStoragePrivate InfdFilesystemAccountStoragePrivate;
 struct _InfdFilesystemAccountStoragePrivate {
   InfdFilesystemStorage* filesystem;
@@ -68,12 +113,35 @@ struct _InfdFilesystemAccountStoragePrivate {
   GHashTable* accounts_by_certificate; /* by certificate DN */
   GHashTable* accounts_by_name; /* by name */
   /* Note that we require names to be unique */
+
+  /* All accounts, ordered by inf_acl_account_id_compare(), for paged
+   * listing of the accounts. */
+  GSequence* accounts_sorted;
+
+  guint password_iterations;
+  guint credential_cache_timeout;
+
+  /* Successfully verified passwords, by account ID. The passwords are kept
+   * as a HMAC with a random key that is generated on first use. */
+  GHashTable* credential_cache;
+  gchar credential_cache_key[INFD_FILESYSTEM_ACCOUNT_STORAGE_HASH_LEN];
+  gboolean has_credential_cache_key;
+
+  /* Protects the account tables, the accounts and the credential cache.
+   * Password logins from other threads re-hash passwords, update the login
+   * times and write the accounts file, so every access takes the lock.
+   * The filesystem, the properties and the IDs and names of accounts are
+   * only changed by the main thread, which reads them without the lock,
+   * for example to emit the account-added and account-removed signals. */
+  GMutex mutex;
 };
 
 enum {
   PROP_0,
 
-  PROP_FILESYSTEM_STORAGE
+  PROP_FILESYSTEM_STORAGE,
+  PROP_PASSWORD_ITERATIONS,
+  PROP_CREDENTIAL_CACHE_TIMEOUT
 };
 
 #define INFD_FILESYSTEM_ACCOUNT_STORAGE_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE((obj), INFD_TYPE_FILESYSTEM_ACCOUNT_STORAGE, InfdFilesystemAccountStoragePrivate))
@@ -89,6 +157,138 @@ infd_filesystem_account_storage_error_quark(void)
   return g_quark_from_static_string("INFD_FILESYSTEM_ACCOUNT_STORAGE_ERROR");
 }
 
+static gboolean
+infd_filesystem_account_storage_kdf_sha256(const gchar* password,
+                                           const gchar* salt,
+                                           guint iterations,
+                                           gchar* hash,
+                                           GError** error)
+{
+  guint password_len;
+  gchar* salted_password;
+  int res;
+
+  /* This is the hash used by earlier versions. It is only kept to verify
+   * existing passwords, which are then re-hashed with PBKDF2. */
+  password_len = strlen(password);
+  salted_password = g_malloc(32 + password_len);
+
+  memcpy(salted_password, salt, 16);
+  memcpy(salted_password + 16, password, password_len);
+  memcpy(salted_password + 16 + password_len, salt + 16, 16);
+
+  res = gnutls_hash_fast(
+    GNUTLS_DIG_SHA256,
+    salted_password,
+    32 + password_len,
+    hash
+  );
+
+  g_free(salted_password);
+
+  if(res != GNUTLS_E_SUCCESS)
+  {
+    inf_gnutls_set_error(error, res);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+infd_filesystem_account_storage_kdf_pbkdf2_sha256(const gchar* password,
+                                                  const gchar* salt,
+                                                  guint iterations,
+                                                  gchar* hash,
+                                                  GError** error)
+{
+  gchar block[INFD_FILESYSTEM_ACCOUNT_STORAGE_HASH_LEN + 4];
+  gchar u[INFD_FILESYSTEM_ACCOUNT_STORAGE_HASH_LEN];
+  gnutls_hmac_hd_t hmac;
+  guint i;
+  guint j;
+  int res;
+
+  /* PBKDF2 as in RFC 2898 with HMAC-SHA256. Since the output has the size
+   * of one HMAC, only the first block needs to be computed. */
+  memcpy(block, salt, INFD_FILESYSTEM_ACCOUNT_STORAGE_HASH_LEN);
+  block[INFD_FILESYSTEM_ACCOUNT_STORAGE_HASH_LEN + 0] = 0;
+  block[INFD_FILESYSTEM_ACCOUNT_STORAGE_HASH_LEN + 1] = 0;
+  block[INFD_FILESYSTEM_ACCOUNT_STORAGE_HASH_LEN + 2] = 0;
+  block[INFD_FILESYSTEM_ACCOUNT_STORAGE_HASH_LEN + 3] = 1;
+
+  /* The HMAC is keyed with the password only once. gnutls_hmac_output()
+   * resets it to the keyed state, so that each iteration only hashes its
+   * input. */
+  res = gnutls_hmac_init(
+    &hmac,
+    GNUTLS_MAC_SHA256,
+    password,
+    strlen(password)
+  );
+
+  if(res != GNUTLS_E_SUCCESS)
+  {
+    inf_gnutls_set_error(error, res);
+    return FALSE;
+  }
+
+  res = gnutls_hmac(hmac, block, sizeof(block));
+  if(res == GNUTLS_E_SUCCESS)
+  {
+    gnutls_hmac_output(hmac, u);
+    memcpy(hash, u, INFD_FILESYSTEM_ACCOUNT_STORAGE_HASH_LEN);
+  }
+
+  for(i = 1; i < iterations && res == GNUTLS_E_SUCCESS; ++i)
+  {
+    res = gnutls_hmac(hmac, u, INFD_FILESYSTEM_ACCOUNT_STORAGE_HASH_LEN);
+    if(res != GNUTLS_E_SUCCESS)
+      break;
+
+    gnutls_hmac_output(hmac, u);
+
+    for(j = 0; j < INFD_FILESYSTEM_ACCOUNT_STORAGE_HASH_LEN; ++j)
+      hash[j] ^= u[j];
+  }
+
+  gnutls_hmac_deinit(hmac, NULL);
+
+  if(res != GNUTLS_E_SUCCESS)
+  {
+    inf_gnutls_set_error(error, res);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* The key derivation functions that can be used to hash passwords. The
+ * last one is used for new passwords. */
+static const InfdFilesystemAccountStorageKdf
+INFD_FILESYSTEM_ACCOUNT_STORAGE_KDFS[] = {
+  { "sha256", infd_filesystem_account_storage_kdf_sha256 },
+  { "pbkdf2-sha256", infd_filesystem_account_storage_kdf_pbkdf2_sha256 }
+};
+
+#define INFD_FILESYSTEM_ACCOUNT_STORAGE_KDF_LEGACY \
+  (&INFD_FILESYSTEM_ACCOUNT_STORAGE_KDFS[0])
+#define INFD_FILESYSTEM_ACCOUNT_STORAGE_KDF_DEFAULT \
+  (&INFD_FILESYSTEM_ACCOUNT_STORAGE_KDFS[ \
+    G_N_ELEMENTS(INFD_FILESYSTEM_ACCOUNT_STORAGE_KDFS) - 1])
+
+static const InfdFilesystemAccountStorageKdf*
+infd_filesystem_account_storage_lookup_kdf(const gchar* name)
+{
+  guint i;
+
+  for(i = 0; i < G_N_ELEMENTS(INFD_FILESYSTEM_ACCOUNT_STORAGE_KDFS); ++i)
+    if(strcmp(INFD_FILESYSTEM_ACCOUNT_STORAGE_KDFS[i].name, name) == 0)
+      return &INFD_FILESYSTEM_ACCOUNT_STORAGE_KDFS[i];
+
+  return NULL;
+}
+
 static void
 infd_filesystem_account_storage_account_info_free(gpointer ptr)
 {
@@ -104,6 +304,7 @@ infd_filesystem_account_storage_account_info_free(gpointer ptr)
 
   g_free(info->password_salt);
   g_free(info->password_hash);
+  g_free(info->rehashed_salt);
 
   g_slice_free(InfdFilesystemAccountStorageAccountInfo, info);
 }
@@ -126,6 +327,9 @@ infd_filesystem_account_storage_account_info_from_xml(xmlNodePtr xml,
 
   xmlChar* password_salt;
   xmlChar* password_hash;
+  xmlChar* password_kdf;
+  const InfdFilesystemAccountStorageKdf* kdf;
+  guint password_iterations;
   gnutls_datum_t datum;
   size_t hash_len;
   int res;
@@ -173,6 +377,60 @@ infd_filesystem_account_storage_account_info_from_xml(xmlNodePtr xml,
   account_id = inf_acl_account_id_from_string((const gchar*)id);
   xmlFree(id);
 
+  password_kdf = inf_xml_util_get_attribute(xml, "password-kdf");
+  if(password_kdf != NULL)
+  {
+    kdf = infd_filesystem_account_storage_lookup_kdf(
+      (const gchar*)password_kdf
+    );
+
+    if(kdf == NULL)
+    {
+      g_set_error(
+        error,
+        infd_filesystem_account_storage_error_quark(),
+        INFD_FILESYSTEM_ACCOUNT_STORAGE_ERROR_INVALID_FORMAT,
+        _("Unknown password hash function \"%s\""),
+        (const gchar*)password_kdf
+      );
+
+      xmlFree(password_kdf);
+      return NULL;
+    }
+
+    xmlFree(password_kdf);
+  }
+  else
+  {
+    kdf = INFD_FILESYSTEM_ACCOUNT_STORAGE_KDF_LEGACY;
+  }
+
+  password_iterations = 1;
+  inf_xml_util_get_attribute_uint(
+    xml,
+    "password-iterations",
+    &password_iterations,
+    &local_error
+  );
+
+  if(local_error != NULL)
+  {
+    g_propagate_error(error, local_error);
+    return NULL;
+  }
+
+  if(password_iterations == 0)
+  {
+    g_set_error_literal(
+      error,
+      infd_filesystem_account_storage_error_quark(),
+      INFD_FILESYSTEM_ACCOUNT_STORAGE_ERROR_INVALID_FORMAT,
+      _("The number of password hash iterations must not be zero")
+    );
+
+    return NULL;
+  }
+
   name = inf_xml_util_get_attribute_required(xml, "name", error);
   if(name == NULL) return NULL;
 
@@ -297,6 +555,9 @@ infd_filesystem_account_storage_account_info_from_xml(xmlNodePtr xml,
 
   info->password_salt = binary_salt;
   info->password_hash = binary_hash;
+  info->password_kdf = kdf;
+  info->password_iterations = password_iterations;
+  info->rehashed_salt = NULL;
 
   if(has_first_seen == TRUE)
     info->first_seen = first_seen * 1e6;
@@ -376,6 +637,21 @@ infd_filesystem_account_storage_account_info_to_xml(
     out[out_size] = '\0';
     inf_xml_util_set_attribute(xml, "password-hash", out);
     g_free(out);
+
+    if(info->password_kdf != INFD_FILESYSTEM_ACCOUNT_STORAGE_KDF_LEGACY)
+    {
+      inf_xml_util_set_attribute(
+        xml,
+        "password-kdf",
+        info->password_kdf->name
+      );
+
+      inf_xml_util_set_attribute_uint(
+        xml,
+        "password-iterations",
+        info->password_iterations
+      );
+    }
   }
 
   if(info->first_seen != 0)
@@ -431,41 +707,117 @@ infd_filesystem_account_storage_generate_salt(GError** error)
 }
 
 static gchar*
-infd_filesystem_account_storage_hash_password(const gchar* password,
-                                              const gchar* salt,
-                                              GError** error)
+infd_filesystem_account_storage_hash_password(
+  const gchar* password,
+  const gchar* salt,
+  const InfdFilesystemAccountStorageKdf* kdf,
+  guint iterations,
+  GError** error)
 {
-  guint password_len;
-  gchar* salted_password;
   gchar* hash;
+
+  hash = g_malloc(INFD_FILESYSTEM_ACCOUNT_STORAGE_HASH_LEN);
+  if(!kdf->func(password, salt, iterations, hash, error))
+  {
+    g_free(hash);
+    return NULL;
+  }
+
+  return hash;
+}
+
+/* Computes the digest under which a verified password is remembered in the
+ * credential cache. Returns FALSE if the cache cannot be used. */
+static gboolean
+infd_filesystem_account_storage_credential_digest(
+  InfdFilesystemAccountStorage* storage,
+  const gchar* password,
+  gchar* digest)
+{
+  InfdFilesystemAccountStoragePrivate* priv;
   int res;
 
-  password_len = strlen(password);
-  salted_password = g_malloc(32 + password_len);
+  priv = INFD_FILESYSTEM_ACCOUNT_STORAGE_PRIVATE(storage);
 
-  memcpy(salted_password, salt, 16);
-  memcpy(salted_password + 16, password, password_len);
-  memcpy(salted_password + 16 + password_len, salt + 16, 16);
+  if(priv->has_credential_cache_key == FALSE)
+  {
+    res = gnutls_rnd(
+      GNUTLS_RND_RANDOM,
+      priv->credential_cache_key,
+      INFD_FILESYSTEM_ACCOUNT_STORAGE_HASH_LEN
+    );
 
-  hash = g_malloc(gnutls_hash_get_len(GNUTLS_DIG_SHA256));
+    if(res != GNUTLS_E_SUCCESS)
+      return FALSE;
 
-  res = gnutls_hash_fast(
-    GNUTLS_DIG_SHA256,
-    salted_password,
-    32 + password_len,
-    hash
+    priv->has_credential_cache_key = TRUE;
+  }
+
+  res = gnutls_hmac_fast(
+    GNUTLS_MAC_SHA256,
+    priv->credential_cache_key,
+    INFD_FILESYSTEM_ACCOUNT_STORAGE_HASH_LEN,
+    password,
+    strlen(password),
+    digest
   );
 
-  g_free(salted_password);
+  return res == GNUTLS_E_SUCCESS;
+}
 
-  if(res != GNUTLS_E_SUCCESS)
+/* Timing-independent comparison of two hashes */
+static gboolean
+infd_filesystem_account_storage_hash_equal(const gchar* first,
+                                           const gchar* second)
+{
+  gchar cmp;
+  guint i;
+
+  cmp = 0;
+  for(i = 0; i < INFD_FILESYSTEM_ACCOUNT_STORAGE_HASH_LEN; ++i)
+    cmp |= (first[i] ^ second[i]);
+
+  return cmp == 0;
+}
+
+/* Must be called with the mutex held */
+static void
+infd_filesystem_account_storage_cache_credential(
+  InfdFilesystemAccountStorage* storage,
+  InfAclAccountId account,
+  const gchar* salt,
+  const gchar* digest)
+{
+  InfdFilesystemAccountStoragePrivate* priv;
+  InfdFilesystemAccountStorageCachedCredential* cached;
+  GHashTableIter iter;
+  gpointer value;
+  gint64 now;
+
+  priv = INFD_FILESYSTEM_ACCOUNT_STORAGE_PRIVATE(storage);
+  now = g_get_monotonic_time();
+
+  /* Drop expired entries, so that the cache does not grow with the number
+   * of accounts that ever logged in. */
+  g_hash_table_iter_init(&iter, priv->credential_cache);
+  while(g_hash_table_iter_next(&iter, NULL, &value))
   {
-    g_free(hash);
-    inf_gnutls_set_error(error, res);
-    return FALSE;
+    cached = (InfdFilesystemAccountStorageCachedCredential*)value;
+    if(cached->expiration <= now)
+      g_hash_table_iter_remove(&iter);
   }
 
-  return hash;
+  cached = g_new(InfdFilesystemAccountStorageCachedCredential, 1);
+  memcpy(cached->salt, salt, INFD_FILESYSTEM_ACCOUNT_STORAGE_HASH_LEN);
+  memcpy(cached->digest, digest, INFD_FILESYSTEM_ACCOUNT_STORAGE_HASH_LEN);
+  cached->expiration =
+    now + (gint64)priv->credential_cache_timeout * G_USEC_PER_SEC;
+
+  g_hash_table_insert(
+    priv->credential_cache,
+    INF_ACL_ACCOUNT_ID_TO_POINTER(account),
+    cached
+  );
 }
 
 static GHashTable*
@@ -555,11 +907,26 @@ infd_filesystem_account_storage_load_file(InfdFilesystemStorage* storage,
   return table;
 }
 
+static gint
+infd_filesystem_account_storage_account_info_compare_func(gconstpointer first,
+                                                          gconstpointer second,
+                                                          gpointer user_data)
+{
+  const InfdFilesystemAccountStorageAccountInfo* first_info;
+  const InfdFilesystemAccountStorageAccountInfo* second_info;
+
+  first_info = (const InfdFilesystemAccountStorageAccountInfo*)first;
+  second_info = (const InfdFilesystemAccountStorageAccountInfo*)second;
+
+  return inf_acl_account_id_compare(first_info->id, second_info->id);
+}
+
 /* Given an accounts table, this fills the reverse lookup tables */
 static gboolean
 infd_filesystem_account_storage_xref_account_table(GHashTable* accounts,
                                                    GHashTable* by_certificate,
                                                    GHashTable* by_name,
+                                                   GSequence* sorted,
                                                    GError** error)
 {
   GHashTableIter hash_iter;
@@ -615,6 +982,13 @@ infd_filesystem_account_storage_xref_account_table(GHashTable* accounts,
 
       g_hash_table_insert(by_certificate, info->certificates[i], info);
     }
+
+    g_sequence_insert_sorted(
+      sorted,
+      info,
+      infd_filesystem_account_storage_account_info_compare_func,
+      NULL
+    );
   }
 
   return TRUE;
@@ -672,10 +1046,12 @@ infd_filesystem_account_storage_set_filesystem_impl(
   GHashTable* old_accounts;
   GHashTable* old_accounts_by_name;
   GHashTable* old_accounts_by_certificate;
+  GSequence* old_accounts_sorted;
 
   GHashTable* new_accounts;
   GHashTable* new_accounts_by_name;
   GHashTable* new_accounts_by_certificate;
+  GSequence* new_accounts_sorted;
 
   GHashTableIter hash_iter;
   gpointer id_ptr;
@@ -692,22 +1068,27 @@ infd_filesystem_account_storage_set_filesystem_impl(
 
   new_accounts_by_certificate = g_hash_table_new(g_str_hash, g_str_equal);
   new_accounts_by_name = g_hash_table_new(g_str_hash, g_str_equal);
+  new_accounts_sorted = g_sequence_new(NULL);
 
   success = infd_filesystem_account_storage_xref_account_table(
     new_accounts,
     new_accounts_by_certificate,
     new_accounts_by_name,
+    new_accounts_sorted,
     error
   );
 
   if(success == FALSE)
   {
+    g_sequence_free(new_accounts_sorted);
     g_hash_table_destroy(new_accounts_by_certificate);
     g_hash_table_destroy(new_accounts_by_name);
     g_hash_table_destroy(new_accounts);
     return FALSE;
   }
 
+  g_mutex_lock(&priv->mutex);
+
   if(priv->filesystem != NULL)
     g_object_unref(priv->filesystem);
 
@@ -723,10 +1104,15 @@ infd_filesystem_account_storage_set_filesystem_impl(
   old_accounts = priv->accounts;
   old_accounts_by_name = priv->accounts_by_name;
   old_accounts_by_certificate = priv->accounts_by_certificate;
+  old_accounts_sorted = priv->accounts_sorted;
 
   priv->accounts = new_accounts;
   priv->accounts_by_name = new_accounts_by_name;
   priv->accounts_by_certificate = new_accounts_by_certificate;
+  priv->accounts_sorted = new_accounts_sorted;
+
+  g_hash_table_remove_all(priv->credential_cache);
+  g_mutex_unlock(&priv->mutex);
 
   /* Notify about changed accounts */
   g_hash_table_iter_init(&hash_iter, old_accounts);
@@ -763,6 +1149,7 @@ infd_filesystem_account_storage_set_filesystem_impl(
     }
   }
 
+  g_sequence_free(old_accounts_sorted);
   g_hash_table_destroy(old_accounts_by_certificate);
   g_hash_table_destroy(old_accounts_by_name);
   g_hash_table_destroy(old_accounts);
@@ -796,6 +1183,13 @@ infd_filesystem_account_storage_add_info(
       info
     );
   }
+
+  g_sequence_insert_sorted(
+    priv->accounts_sorted,
+    info,
+    infd_filesystem_account_storage_account_info_compare_func,
+    NULL
+  );
 }
 
 static void
@@ -804,10 +1198,21 @@ infd_filesystem_account_storage_remove_info(
   InfdFilesystemAccountStorageAccountInfo* info)
 {
   InfdFilesystemAccountStoragePrivate* priv;
+  GSequenceIter* iter;
   guint i;
 
   priv = INFD_FILESYSTEM_ACCOUNT_STORAGE_PRIVATE(storage);
 
+  iter = g_sequence_lookup(
+    priv->accounts_sorted,
+    info,
+    infd_filesystem_account_storage_account_info_compare_func,
+    NULL
+  );
+
+  g_assert(iter != NULL);
+  g_sequence_remove(iter);
+
   for(i = 0; i < info->n_certificates; ++i)
     g_hash_table_remove(priv->accounts_by_certificate, info->certificates[i]);
   g_hash_table_remove(priv->accounts_by_name, info->name);
@@ -838,6 +1243,17 @@ infd_filesystem_account_storage_init(InfdFilesystemAccountStorage* storage)
     g_str_hash,
     g_str_equal
   );
+
+  priv->accounts_sorted = g_sequence_new(NULL);
+
+  priv->password_iterations = 100000;
+  priv->credential_cache_timeout = 60;
+
+  priv->credential_cache =
+    g_hash_table_new_full(NULL, NULL, NULL, g_free);
+  priv->has_credential_cache_key = FALSE;
+
+  g_mutex_init(&priv->mutex);
 }
 
 static void
@@ -867,9 +1283,13 @@ infd_filesystem_account_storage_finalize(GObject* object)
   storage = INFD_FILESYSTEM_ACCOUNT_STORAGE(object);
   priv = INFD_FILESYSTEM_ACCOUNT_STORAGE_PRIVATE(storage);
 
+  g_sequence_free(priv->accounts_sorted);
   g_hash_table_destroy(priv->accounts_by_name);
   g_hash_table_destroy(priv->accounts_by_certificate);
   g_hash_table_destroy(priv->accounts);
+  g_hash_table_destroy(priv->credential_cache);
+
+  g_mutex_clear(&priv->mutex);
 
   G_OBJECT_CLASS(infd_filesystem_account_storage_parent_class)->finalize(object);
 }
@@ -908,6 +1328,18 @@ infd_filesystem_account_storage_set_property(GObject* object,
       g_error_free(error);
     }
 
+    break;
+  case PROP_PASSWORD_ITERATIONS:
+    g_mutex_lock(&priv->mutex);
+    priv->password_iterations = g_value_get_uint(value);
+    g_mutex_unlock(&priv->mutex);
+    break;
+  case PROP_CREDENTIAL_CACHE_TIMEOUT:
+    g_mutex_lock(&priv->mutex);
+    priv->credential_cache_timeout = g_value_get_uint(value);
+    if(priv->credential_cache_timeout == 0)
+      g_hash_table_remove_all(priv->credential_cache);
+    g_mutex_unlock(&priv->mutex);
     break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
@@ -932,6 +1364,12 @@ infd_filesystem_account_storage_get_property(GObject* object,
   case PROP_FILESYSTEM_STORAGE:
     g_value_set_object(value, G_OBJECT(priv->filesystem));
     break;
+  case PROP_PASSWORD_ITERATIONS:
+    g_value_set_uint(value, priv->password_iterations);
+    break;
+  case PROP_CREDENTIAL_CACHE_TIMEOUT:
+    g_value_set_uint(value, priv->credential_cache_timeout);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
@@ -973,6 +1411,7 @@ infd_filesystem_account_storage_lookup_accounts(InfdAccountStorage* s,
 
   result = g_malloc(sizeof(InfAclAccount) * n_accounts);
 
+  g_mutex_lock(&priv->mutex);
   for(i = 0; i < n_accounts; ++i)
   {
     info = g_hash_table_lookup(
@@ -992,6 +1431,7 @@ infd_filesystem_account_storage_lookup_accounts(InfdAccountStorage* s,
     }
   }
 
+  g_mutex_unlock(&priv->mutex);
   return result;
 }
 
@@ -1009,9 +1449,11 @@ infd_filesystem_account_storage_lookup_accounts_by_name(InfdAccountStorage* s,
   storage = INFD_FILESYSTEM_ACCOUNT_STORAGE(s);
   priv = INFD_FILESYSTEM_ACCOUNT_STORAGE_PRIVATE(storage);
 
+  g_mutex_lock(&priv->mutex);
   info = g_hash_table_lookup(priv->accounts_by_name, name);
   if(info == NULL)
   {
+    g_mutex_unlock(&priv->mutex);
     *n_accounts = 0;
     return NULL;
   }
@@ -1020,6 +1462,7 @@ infd_filesystem_account_storage_lookup_accounts_by_name(InfdAccountStorage* s,
   result = g_malloc(sizeof(InfAclAccount));
   result->id = info->id;
   result->name = g_strdup(info->name);
+  g_mutex_unlock(&priv->mutex);
   return result;
 }
 
@@ -1039,8 +1482,13 @@ infd_filesystem_account_storage_list_accounts(InfdAccountStorage* s,
   storage = INFD_FILESYSTEM_ACCOUNT_STORAGE(s);
   priv = INFD_FILESYSTEM_ACCOUNT_STORAGE_PRIVATE(storage);
 
+  g_mutex_lock(&priv->mutex);
   *n_accounts = g_hash_table_size(priv->accounts);
-  if(*n_accounts == 0) return NULL;
+  if(*n_accounts == 0)
+  {
+    g_mutex_unlock(&priv->mutex);
+    return NULL;
+  }
 
   result = g_malloc( (*n_accounts) * sizeof(InfAclAccount));
 
@@ -1054,10 +1502,100 @@ infd_filesystem_account_storage_list_accounts(InfdAccountStorage* s,
     ++index;
   }
 
+  g_mutex_unlock(&priv->mutex);
+
   g_assert(index == *n_accounts);
   return result;
 }
 
+static InfAclAccount*
+infd_filesystem_account_storage_list_accounts_range(InfdAccountStorage* s,
+                                                    const gchar* prefix,
+                                                    InfAclAccountId after,
+                                                    guint max,
+                                                    guint* n_accounts,
+                                                    GError** error)
+{
+  InfdFilesystemAccountStorage* storage;
+  InfdFilesystemAccountStoragePrivate* priv;
+  InfdFilesystemAccountStorageAccountInfo key;
+  InfdFilesystemAccountStorageAccountInfo* info;
+  GSequenceIter* iter;
+  GPtrArray* matches;
+  gsize prefix_len;
+  InfAclAccount* result;
+  guint i;
+
+  storage = INFD_FILESYSTEM_ACCOUNT_STORAGE(s);
+  priv = INFD_FILESYSTEM_ACCOUNT_STORAGE_PRIVATE(storage);
+
+  g_mutex_lock(&priv->mutex);
+
+  /* Seek to the first account after the cursor, so that fetching a chunk
+   * does not depend on the total number of accounts. */
+  if(after == 0)
+  {
+    iter = g_sequence_get_begin_iter(priv->accounts_sorted);
+  }
+  else
+  {
+    key.id = after;
+    iter = g_sequence_search(
+      priv->accounts_sorted,
+      &key,
+      infd_filesystem_account_storage_account_info_compare_func,
+      NULL
+    );
+
+    /* Skip the cursor itself if it is still present */
+    while(!g_sequence_iter_is_end(iter))
+    {
+      info = (InfdFilesystemAccountStorageAccountInfo*)g_sequence_get(iter);
+      if(inf_acl_account_id_compare(info->id, after) > 0) break;
+      iter = g_sequence_iter_next(iter);
+    }
+  }
+
+  /* Collect pointers to the matching entries only, so that we do not need
+   * to copy account names that are not part of the result. */
+  prefix_len = (prefix != NULL) ? strlen(prefix) : 0;
+  matches = g_ptr_array_new();
+
+  for(; !g_sequence_iter_is_end(iter); iter = g_sequence_iter_next(iter))
+  {
+    if(max > 0 && matches->len == max)
+      break;
+
+    info = (InfdFilesystemAccountStorageAccountInfo*)g_sequence_get(iter);
+    if(prefix_len > 0 &&
+       (info->name == NULL || strncmp(info->name, prefix, prefix_len) != 0))
+    {
+      continue;
+    }
+
+    g_ptr_array_add(matches, info);
+  }
+
+  *n_accounts = matches->len;
+
+  result = NULL;
+  if(*n_accounts > 0)
+  {
+    result = g_malloc( (*n_accounts) * sizeof(InfAclAccount));
+    for(i = 0; i < *n_accounts; ++i)
+    {
+      info = (InfdFilesystemAccountStorageAccountInfo*)matches->pdata[i];
+      result[i].id = info->id;
+      result[i].name = g_strdup(info->name);
+    }
+  }
+
+  g_mutex_unlock(&priv->mutex);
+
+  g_ptr_array_free(matches, TRUE);
+  return result;
+}
+
 static InfAclAccountId
 infd_filesystem_account_storage_add_account(InfdAccountStorage* s,
                                             const gchar* name,
@@ -1083,10 +1621,13 @@ infd_filesystem_account_storage_add_account(InfdAccountStorage* s,
   storage = INFD_FILESYSTEM_ACCOUNT_STORAGE(s);
   priv = INFD_FILESYSTEM_ACCOUNT_STORAGE_PRIVATE(storage);
 
-  /* Validity checks: */
+  /* Validity checks. The account tables are only changed by the main
+   * thread, so they still hold when the account is inserted below. */
+  g_mutex_lock(&priv->mutex);
   info = g_hash_table_lookup(priv->accounts_by_name, name);
   if(info != NULL)
   {
+    g_mutex_unlock(&priv->mutex);
     g_set_error(
       error,
       infd_filesystem_account_storage_error_quark(),
@@ -1100,6 +1641,7 @@ infd_filesystem_account_storage_add_account(InfdAccountStorage* s,
 
   if(strlen(name) > 48)
   {
+    g_mutex_unlock(&priv->mutex);
     g_set_error_literal(
       error,
       infd_filesystem_account_storage_error_quark(),
@@ -1126,6 +1668,7 @@ infd_filesystem_account_storage_add_account(InfdAccountStorage* s,
       );
 
       g_free(dn);
+      g_mutex_unlock(&priv->mutex);
       return 0;
     }
 
@@ -1148,12 +1691,15 @@ infd_filesystem_account_storage_add_account(InfdAccountStorage* s,
       );
 
       g_free(fingerprint);
+      g_mutex_unlock(&priv->mutex);
       return 0;
     }
 
     g_free(fingerprint);
   }
 
+  g_mutex_unlock(&priv->mutex);
+
   if(password != NULL)
   {
     password_salt = infd_filesystem_account_storage_generate_salt(error);
@@ -1162,6 +1708,8 @@ infd_filesystem_account_storage_add_account(InfdAccountStorage* s,
     password_hash = infd_filesystem_account_storage_hash_password(
       password,
       password_salt,
+      INFD_FILESYSTEM_ACCOUNT_STORAGE_KDF_DEFAULT,
+      priv->password_iterations,
       error
     );
 
@@ -1178,6 +1726,7 @@ infd_filesystem_account_storage_add_account(InfdAccountStorage* s,
   }
 
   /* Okay, create the account. First, choose an ID */
+  g_mutex_lock(&priv->mutex);
   for(i = 0; i < 10000; ++i)
   {
     id_str = g_strdup_printf("fs:user:%s:%x", name, g_random_int());
@@ -1190,6 +1739,7 @@ infd_filesystem_account_storage_add_account(InfdAccountStorage* s,
 
   if(id_str == NULL)
   {
+    g_mutex_unlock(&priv->mutex);
     g_set_error(
       error,
       infd_filesystem_account_storage_error_quark(),
@@ -1215,6 +1765,9 @@ infd_filesystem_account_storage_add_account(InfdAccountStorage* s,
     info->certificates[i] = inf_cert_util_get_dn(certs[i]);
   info->password_salt = password_salt;
   info->password_hash = password_hash;
+  info->password_kdf = INFD_FILESYSTEM_ACCOUNT_STORAGE_KDF_DEFAULT;
+  info->password_iterations = priv->password_iterations;
+  info->rehashed_salt = NULL;
   info->first_seen = 0;
   info->last_seen = 0;
 
@@ -1229,11 +1782,14 @@ infd_filesystem_account_storage_add_account(InfdAccountStorage* s,
   if(success == FALSE)
   {
     infd_filesystem_account_storage_remove_info(storage, info);
+    g_mutex_unlock(&priv->mutex);
+
     infd_filesystem_account_storage_account_info_free(info);
     return 0;
   }
 
-  return info->id;
+  g_mutex_unlock(&priv->mutex);
+  return id;
 }
 
 static gboolean
@@ -1250,6 +1806,8 @@ infd_filesystem_account_storage_remove_account(InfdAccountStorage* s,
   storage = INFD_FILESYSTEM_ACCOUNT_STORAGE(s);
   priv = INFD_FILESYSTEM_ACCOUNT_STORAGE_PRIVATE(storage);
 
+  g_mutex_lock(&priv->mutex);
+
   info = g_hash_table_lookup(
     priv->accounts,
     INF_ACL_ACCOUNT_ID_TO_POINTER(account)
@@ -1257,6 +1815,7 @@ infd_filesystem_account_storage_remove_account(InfdAccountStorage* s,
 
   if(info == NULL)
   {
+    g_mutex_unlock(&priv->mutex);
     g_set_error(
       error,
       infd_filesystem_account_storage_error_quark(),
@@ -1279,9 +1838,17 @@ infd_filesystem_account_storage_remove_account(InfdAccountStorage* s,
   if(success == FALSE)
   {
     infd_filesystem_account_storage_add_info(storage, info);
+    g_mutex_unlock(&priv->mutex);
     return FALSE;
   }
 
+  g_hash_table_remove(
+    priv->credential_cache,
+    INF_ACL_ACCOUNT_ID_TO_POINTER(account)
+  );
+
+  g_mutex_unlock(&priv->mutex);
+
   infd_filesystem_account_storage_account_info_free(info);
   return TRUE;
 }
@@ -1301,6 +1868,8 @@ infd_filesystem_account_storage_login_by_certificate(InfdAccountStorage* s,
   storage = INFD_FILESYSTEM_ACCOUNT_STORAGE(s);
   priv = INFD_FILESYSTEM_ACCOUNT_STORAGE_PRIVATE(storage);
 
+  g_mutex_lock(&priv->mutex);
+
   dn = inf_cert_util_get_dn(cert);
   info = g_hash_table_lookup(priv->accounts_by_certificate, dn);
   if(info == NULL)
@@ -1342,7 +1911,10 @@ infd_filesystem_account_storage_login_by_certificate(InfdAccountStorage* s,
   g_free(dn);
 
   if(info == NULL)
+  {
+    g_mutex_unlock(&priv->mutex);
     return 0;
+  }
 
   infd_filesystem_account_storage_account_info_update_time(info);
 
@@ -1354,6 +1926,7 @@ infd_filesystem_account_storage_login_by_certificate(InfdAccountStorage* s,
     NULL
   );
 
+  g_mutex_unlock(&priv->mutex);
   return info->id;
 }
 
@@ -1366,41 +1939,198 @@ infd_filesystem_account_storage_login_by_password(InfdAccountStorage* s,
   InfdFilesystemAccountStorage* storage;
   InfdFilesystemAccountStoragePrivate* priv;
   InfdFilesystemAccountStorageAccountInfo* info;
+  InfdFilesystemAccountStorageCachedCredential* cached;
+  const InfdFilesystemAccountStorageKdf* kdf;
+  guint iterations;
+  guint target_iterations;
+  InfAclAccountId id;
+
+  gchar salt[INFD_FILESYSTEM_ACCOUNT_STORAGE_HASH_LEN];
+  gchar expected[INFD_FILESYSTEM_ACCOUNT_STORAGE_HASH_LEN];
+  gchar digest[INFD_FILESYSTEM_ACCOUNT_STORAGE_HASH_LEN];
+  gboolean has_digest;
+  gboolean verified;
+
   gchar* hash;
-  gchar cmp;
-  guint i;
+  gchar* new_salt;
+  gchar* new_hash;
 
   storage = INFD_FILESYSTEM_ACCOUNT_STORAGE(s);
   priv = INFD_FILESYSTEM_ACCOUNT_STORAGE_PRIVATE(storage);
+
+  /* This function can be called from another thread, so copy what we need
+   * and release the lock while hashing the password. */
+  g_mutex_lock(&priv->mutex);
   info = g_hash_table_lookup(priv->accounts_by_name, username);
 
   if(info == NULL || info->password_hash == NULL ||
      info->password_salt == NULL)
   {
+    g_mutex_unlock(&priv->mutex);
     return 0;
   }
 
-  hash = infd_filesystem_account_storage_hash_password(
-    password,
+  id = info->id;
+  kdf = info->password_kdf;
+  iterations = info->password_iterations;
+  target_iterations = priv->password_iterations;
+  memcpy(
+    salt,
     info->password_salt,
-    error
+    INFD_FILESYSTEM_ACCOUNT_STORAGE_HASH_LEN
   );
 
-  if(hash == NULL)
-    return 0;
+  memcpy(
+    expected,
+    info->password_hash,
+    INFD_FILESYSTEM_ACCOUNT_STORAGE_HASH_LEN
+  );
 
-  /* length-independent string compare */
-  cmp = 0;
-  for(i = 0; i < gnutls_hash_get_len(GNUTLS_DIG_SHA256); ++i)
-    cmp |= (info->password_hash[i] ^ hash[i]);
-  g_free(hash);
+  has_digest = FALSE;
+  verified = FALSE;
+
+  if(priv->credential_cache_timeout > 0)
+  {
+    has_digest = infd_filesystem_account_storage_credential_digest(
+      storage,
+      password,
+      digest
+    );
+  }
+
+  if(has_digest == TRUE)
+  {
+    cached = g_hash_table_lookup(
+      priv->credential_cache,
+      INF_ACL_ACCOUNT_ID_TO_POINTER(id)
+    );
 
-  if(cmp != 0)
+    if(cached != NULL &&
+       cached->expiration > g_get_monotonic_time() &&
+       memcmp(cached->salt, salt,
+              INFD_FILESYSTEM_ACCOUNT_STORAGE_HASH_LEN) == 0)
+    {
+      verified = infd_filesystem_account_storage_hash_equal(
+        cached->digest,
+        digest
+      );
+    }
+  }
+
+  g_mutex_unlock(&priv->mutex);
+
+  if(verified == FALSE)
+  {
+    hash = infd_filesystem_account_storage_hash_password(
+      password,
+      salt,
+      kdf,
+      iterations,
+      error
+    );
+
+    if(hash == NULL)
+      return 0;
+
+    verified = infd_filesystem_account_storage_hash_equal(hash, expected);
+    g_free(hash);
+
+    if(verified == FALSE)
+      return 0;
+  }
+
+  /* Re-hash passwords that were stored with an outdated hash function or
+   * number of iterations, now that we know the password. If this fails, we
+   * keep the old hash, and try again on the next login. */
+  new_salt = NULL;
+  new_hash = NULL;
+
+  if(kdf != INFD_FILESYSTEM_ACCOUNT_STORAGE_KDF_DEFAULT ||
+     iterations != target_iterations)
+  {
+    new_salt = infd_filesystem_account_storage_generate_salt(NULL);
+    if(new_salt != NULL)
+    {
+      new_hash = infd_filesystem_account_storage_hash_password(
+        password,
+        new_salt,
+        INFD_FILESYSTEM_ACCOUNT_STORAGE_KDF_DEFAULT,
+        target_iterations,
+        NULL
+      );
+
+      if(new_hash == NULL)
+      {
+        g_free(new_salt);
+        new_salt = NULL;
+      }
+    }
+  }
+
+  g_mutex_lock(&priv->mutex);
+
+  /* The account might have been removed, or its password changed, while
+   * we were not holding the lock. */
+  info = g_hash_table_lookup(
+    priv->accounts,
+    INF_ACL_ACCOUNT_ID_TO_POINTER(id)
+  );
+
+  if(info == NULL || info->password_salt == NULL)
+  {
+    g_mutex_unlock(&priv->mutex);
+    g_free(new_salt);
+    g_free(new_hash);
     return 0;
+  }
+
+  if(memcmp(info->password_salt, salt,
+            INFD_FILESYSTEM_ACCOUNT_STORAGE_HASH_LEN) != 0)
+  {
+    /* If a concurrent login has only re-hashed the password that we
+     * verified, then it is still valid, and does not need to be re-hashed
+     * again. Otherwise, the password has been changed. */
+    if(info->rehashed_salt == NULL ||
+       memcmp(info->rehashed_salt, salt,
+              INFD_FILESYSTEM_ACCOUNT_STORAGE_HASH_LEN) != 0)
+    {
+      g_mutex_unlock(&priv->mutex);
+      g_free(new_salt);
+      g_free(new_hash);
+      return 0;
+    }
+
+    g_free(new_salt);
+    g_free(new_hash);
+    new_salt = NULL;
+    new_hash = NULL;
+  }
+
+  if(new_hash != NULL)
+  {
+    g_free(info->rehashed_salt);
+    g_free(info->password_hash);
+
+    info->rehashed_salt = info->password_salt;
+    info->password_salt = new_salt;
+    info->password_hash = new_hash;
+    info->password_kdf = INFD_FILESYSTEM_ACCOUNT_STORAGE_KDF_DEFAULT;
+    info->password_iterations = target_iterations;
+  }
+
+  if(has_digest == TRUE && priv->credential_cache_timeout > 0)
+  {
+    infd_filesystem_account_storage_cache_credential(
+      storage,
+      id,
+      info->password_salt,
+      digest
+    );
+  }
 
   infd_filesystem_account_storage_account_info_update_time(info);
 
-  /* Try to save the fingerprint/DN and time change to disk, but if it does
+  /* Try to save the new hash and time change to disk, but if it does
    * not work, that's okay for now, we still keep the login functional. */
   infd_filesystem_account_storage_store_file(
     priv->filesystem,
@@ -1408,7 +2138,8 @@ infd_filesystem_account_storage_login_by_password(InfdAccountStorage* s,
     NULL
   );
 
-  return info->id;
+  g_mutex_unlock(&priv->mutex);
+  return id;
 }
 
 static gboolean
@@ -1432,6 +2163,8 @@ infd_filesystem_account_storage_set_certificate(InfdAccountStorage* s,
   storage = INFD_FILESYSTEM_ACCOUNT_STORAGE(s);
   priv = INFD_FILESYSTEM_ACCOUNT_STORAGE_PRIVATE(storage);
 
+  g_mutex_lock(&priv->mutex);
+
   info = g_hash_table_lookup(
     priv->accounts,
     INF_ACL_ACCOUNT_ID_TO_POINTER(account)
@@ -1439,6 +2172,7 @@ infd_filesystem_account_storage_set_certificate(InfdAccountStorage* s,
 
   if(info == NULL)
   {
+    g_mutex_unlock(&priv->mutex);
     g_set_error(
       error,
       infd_filesystem_account_storage_error_quark(),
@@ -1466,6 +2200,7 @@ infd_filesystem_account_storage_set_certificate(InfdAccountStorage* s,
       );
 
       g_free(dn);
+      g_mutex_unlock(&priv->mutex);
       return FALSE;
     }
 
@@ -1508,6 +2243,7 @@ infd_filesystem_account_storage_set_certificate(InfdAccountStorage* s,
     info->certificates = old_certificates;
     info->n_certificates = old_n_certificates;
 
+    g_mutex_unlock(&priv->mutex);
     return FALSE;
   }
 
@@ -1528,6 +2264,7 @@ infd_filesystem_account_storage_set_certificate(InfdAccountStorage* s,
     );
   }
 
+  g_mutex_unlock(&priv->mutex);
   return TRUE;
 }
 
@@ -1544,26 +2281,15 @@ infd_filesystem_account_storage_set_password(InfdAccountStorage* s,
   gchar* password_salt;
   gchar* old_hash;
   gchar* old_salt;
+  const InfdFilesystemAccountStorageKdf* old_kdf;
+  guint old_iterations;
   gboolean success;
 
-  info = g_hash_table_lookup(
-    priv->accounts,
-    INF_ACL_ACCOUNT_ID_TO_POINTER(account)
-  );
-
-  if(info == NULL)
-  {
-    g_set_error(
-      error,
-      infd_filesystem_account_storage_error_quark(),
-      INFD_FILESYSTEM_ACCOUNT_STORAGE_ERROR_NO_SUCH_ACCOUNT,
-      _("There is no such account with ID \"%s\""),
-      inf_acl_account_id_to_string(account)
-    );
-
-    return FALSE;
-  }
+  storage = INFD_FILESYSTEM_ACCOUNT_STORAGE(s);
+  priv = INFD_FILESYSTEM_ACCOUNT_STORAGE_PRIVATE(storage);
 
+  /* Hash the new password before taking the lock, since this takes a
+   * while */
   if(password != NULL)
   {
     password_salt = infd_filesystem_account_storage_generate_salt(error);
@@ -1572,6 +2298,8 @@ infd_filesystem_account_storage_set_password(InfdAccountStorage* s,
     password_hash = infd_filesystem_account_storage_hash_password(
       password,
       password_salt,
+      INFD_FILESYSTEM_ACCOUNT_STORAGE_KDF_DEFAULT,
+      priv->password_iterations,
       error
     );
 
@@ -1587,10 +2315,38 @@ infd_filesystem_account_storage_set_password(InfdAccountStorage* s,
     password_hash = NULL;
   }
 
+  g_mutex_lock(&priv->mutex);
+
+  info = g_hash_table_lookup(
+    priv->accounts,
+    INF_ACL_ACCOUNT_ID_TO_POINTER(account)
+  );
+
+  if(info == NULL)
+  {
+    g_mutex_unlock(&priv->mutex);
+
+    g_set_error(
+      error,
+      infd_filesystem_account_storage_error_quark(),
+      INFD_FILESYSTEM_ACCOUNT_STORAGE_ERROR_NO_SUCH_ACCOUNT,
+      _("There is no such account with ID \"%s\""),
+      inf_acl_account_id_to_string(account)
+    );
+
+    g_free(password_hash);
+    g_free(password_salt);
+    return FALSE;
+  }
+
   old_hash = info->password_hash;
   old_salt = info->password_salt;
+  old_kdf = info->password_kdf;
+  old_iterations = info->password_iterations;
   info->password_hash = password_hash;
   info->password_salt = password_salt;
+  info->password_kdf = INFD_FILESYSTEM_ACCOUNT_STORAGE_KDF_DEFAULT;
+  info->password_iterations = priv->password_iterations;
 
   /* Try to write the updated password to disk */
 
@@ -1605,11 +2361,25 @@ infd_filesystem_account_storage_set_password(InfdAccountStorage* s,
     /* rollback */
     info->password_hash = old_hash;
     info->password_salt = old_salt;
+    info->password_kdf = old_kdf;
+    info->password_iterations = old_iterations;
+    g_mutex_unlock(&priv->mutex);
+
     g_free(password_hash);
     g_free(password_salt);
     return FALSE;
   }
 
+  g_hash_table_remove(
+    priv->credential_cache,
+    INF_ACL_ACCOUNT_ID_TO_POINTER(account)
+  );
+
+  g_free(info->rehashed_salt);
+  info->rehashed_salt = NULL;
+
+  g_mutex_unlock(&priv->mutex);
+
   g_free(old_hash);
   g_free(old_salt);
   return TRUE;
@@ -1638,6 +2408,35 @@ infd_filesystem_account_storage_class_init(
       G_PARAM_READWRITE
     )
   );
+
+  g_object_class_install_property(
+    object_class,
+    PROP_PASSWORD_ITERATIONS,
+    g_param_spec_uint(
+      "password-iterations",
+      "Password iterations",
+      "The number of PBKDF2 iterations with which to hash new passwords",
+      1,
+      G_MAXUINT,
+      100000,
+      G_PARAM_READWRITE
+    )
+  );
+
+  g_object_class_install_property(
+    object_class,
+    PROP_CREDENTIAL_CACHE_TIMEOUT,
+    g_param_spec_uint(
+      "credential-cache-timeout",
+      "Credential cache timeout",
+      "Time in seconds for which a successfully verified password is "
+      "remembered, or 0 to always verify passwords",
+      0,
+      G_MAXUINT,
+      60,
+      G_PARAM_READWRITE
+    )
+  );
 }
 
 static void
@@ -1649,6 +2448,8 @@ infd_filesystem_account_storage_account_storage_iface_init(
   iface->lookup_accounts_by_name =
     infd_filesystem_account_storage_lookup_accounts_by_name;
   iface->list_accounts = infd_filesystem_account_storage_list_accounts;
+  iface->list_accounts_range =
+    infd_filesystem_account_storage_list_accounts_range;
   iface->add_account = infd_filesystem_account_storage_add_account;
   iface->remove_account = infd_filesystem_account_storage_remove_account;
   iface->login_by_certificate =
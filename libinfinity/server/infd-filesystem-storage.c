@@ -56,6 +56,21 @@ enum {
 
 static GQuark infd_filesystem_storage_error_quark;
 
+#ifndef G_OS_WIN32
+/* Streams opened for writing write to a temporary file next to the target,
+ * which replaces the target when the stream is closed. This maps each such
+ * stream to its InfdFilesystemStorageTempFile. Streams can be closed from
+ * any thread, so access is protected by a lock. */
+typedef struct _InfdFilesystemStorageTempFile InfdFilesystemStorageTempFile;
+struct _InfdFilesystemStorageTempFile {
+  gchar* temp_path;
+  gchar* path;
+};
+
+static GHashTable* infd_filesystem_storage_temp_files;
+G_LOCK_DEFINE_STATIC(infd_filesystem_storage_temp_files);
+#endif
+
 static void infd_filesystem_storage_storage_iface_init(InfdStorageInterface* iface);
 G_DEFINE_TYPE_WITH_CODE(InfdFilesystemStorage, infd_filesystem_storage, G_TYPE_OBJECT,
   G_ADD_PRIVATE(InfdFilesystemStorage)
@@ -196,20 +211,83 @@ infd_filesystem_storage_open_impl(InfdFilesystemStorage* storage,
   int save_errno;
 #ifndef G_OS_WIN32
   int fd;
-  int open_mode;
+  gchar* temp_path;
+  InfdFilesystemStorageTempFile* temp_file;
 #endif
 
 #ifdef G_OS_WIN32
   res = g_fopen(path, mode);
 #else
-  if(strcmp(mode, "r") == 0) open_mode = O_RDONLY;
-  else if(strcmp(mode, "w") == 0) open_mode = O_CREAT | O_WRONLY | O_TRUNC;
-  else g_assert_not_reached();
-  fd = open(path, O_NOFOLLOW | open_mode, 0644);
+  temp_path = NULL;
+
+  if(strcmp(mode, "r") == 0)
+  {
+    fd = open(path, O_NOFOLLOW | O_RDONLY);
+  }
+  else if(strcmp(mode, "a") == 0)
+  {
+    fd = open(path, O_NOFOLLOW | O_CREAT | O_WRONLY | O_APPEND, 0644);
+  }
+  else if(strcmp(mode, "w") == 0)
+  {
+    /* Write into a temporary file in the same directory, and only replace
+     * the existing file by it when the stream is closed. Readers, including
+     * those which have the previous version memory-mapped, never see a
+     * partially written file, and the previous version survives a crash
+     * while writing. mkstemp() creates a new file, so it cannot follow a
+     * symlink either. The suffix keeps the temporary file out of directory
+     * listings, which only show files whose last extension starts with
+     * "Inf". */
+    temp_path = g_strconcat(path, ".tmp-XXXXXX", NULL);
+    fd = g_mkstemp_full(temp_path, O_WRONLY, 0644);
+  }
+  else
+  {
+    g_assert_not_reached();
+    fd = -1;
+  }
+
   if(fd == -1)
+  {
     res = NULL;
+  }
   else
+  {
     res = fdopen(fd, mode);
+    if(res == NULL)
+    {
+      save_errno = errno;
+      close(fd);
+      errno = save_errno;
+    }
+  }
+
+  if(temp_path != NULL)
+  {
+    if(res == NULL)
+    {
+      save_errno = errno;
+      if(fd != -1) g_unlink(temp_path);
+      g_free(temp_path);
+      errno = save_errno;
+    }
+    else
+    {
+      temp_file = g_slice_new(InfdFilesystemStorageTempFile);
+      temp_file->temp_path = temp_path;
+      temp_file->path = g_strdup(path);
+
+      G_LOCK(infd_filesystem_storage_temp_files);
+      if(infd_filesystem_storage_temp_files == NULL)
+      {
+        infd_filesystem_storage_temp_files =
+          g_hash_table_new(NULL, NULL);
+      }
+
+      g_hash_table_insert(infd_filesystem_storage_temp_files, res, temp_file);
+      G_UNLOCK(infd_filesystem_storage_temp_files);
+    }
+  }
 #endif
   save_errno = errno;
 
@@ -222,6 +300,78 @@ infd_filesystem_storage_open_impl(InfdFilesystemStorage* storage,
   return res;
 }
 
+/* Closes a stream opened with infd_filesystem_storage_open_impl(). If it
+ * was opened with mode "w", then the temporary file it has been written to
+ * replaces the target file, unless commit is FALSE or writing failed, in
+ * which case the temporary file is removed and the target file is left
+ * alone. Returns 0 on success, or EOF with errno set on error. */
+static int
+infd_filesystem_storage_close_impl(FILE* file,
+                                   gboolean commit)
+{
+#ifndef G_OS_WIN32
+  InfdFilesystemStorageTempFile* temp_file;
+  int save_errno;
+  int res;
+
+  temp_file = NULL;
+
+  G_LOCK(infd_filesystem_storage_temp_files);
+  if(infd_filesystem_storage_temp_files != NULL)
+  {
+    temp_file = g_hash_table_lookup(infd_filesystem_storage_temp_files, file);
+    if(temp_file != NULL)
+      g_hash_table_remove(infd_filesystem_storage_temp_files, file);
+  }
+  G_UNLOCK(infd_filesystem_storage_temp_files);
+
+  if(temp_file == NULL)
+    return fclose(file);
+
+  /* Make sure the new content is on disk before it replaces the old file,
+   * so that a crash cannot leave an empty file behind. */
+  res = 0;
+  if(commit == FALSE)
+  {
+    fclose(file);
+  }
+  else if(ferror(file))
+  {
+    res = EOF;
+    save_errno = EIO;
+    fclose(file);
+  }
+  else if(fflush(file) != 0 || fsync(fileno(file)) == -1)
+  {
+    res = EOF;
+    save_errno = errno;
+    fclose(file);
+  }
+  else if(fclose(file) != 0)
+  {
+    res = EOF;
+    save_errno = errno;
+  }
+  else if(rename(temp_file->temp_path, temp_file->path) == -1)
+  {
+    res = EOF;
+    save_errno = errno;
+  }
+
+  if(commit == FALSE || res != 0)
+    g_unlink(temp_file->temp_path);
+  if(res != 0)
+    errno = save_errno;
+
+  g_free(temp_file->temp_path);
+  g_free(temp_file->path);
+  g_slice_free(InfdFilesystemStorageTempFile, temp_file);
+  return res;
+#else
+  return fclose(file);
+#endif
+}
+
 xmlDocPtr
 infd_filesystem_storage_read_xml_file_impl(InfdFilesystemStorage* storage,
                                            const gchar* path,
@@ -315,8 +465,7 @@ infd_filesystem_storage_write_xml_file_impl(InfdFilesystemStorage* storage,
   if(xmlDocFormatDump(file, doc, 1) == -1)
   {
     xmlerror = xmlGetLastError();
-    fclose(file);
-    /* TODO: unlink? */
+    infd_filesystem_storage_close_impl(file, FALSE);
 
     g_set_error_literal(
       error,
@@ -328,7 +477,7 @@ infd_filesystem_storage_write_xml_file_impl(InfdFilesystemStorage* storage,
     return FALSE;
   }
 
-  if(fclose(file) != 0)
+  if(infd_filesystem_storage_close_impl(file, TRUE) != 0)
   {
     save_errno = errno;
     infd_filesystem_storage_system_error(save_errno, error);
@@ -918,13 +1067,19 @@ infd_filesystem_storage_get_path(InfdFilesystemStorage* storage,
  * @storage: A #InfdFilesystemStorage.
  * @identifier: The type of node to open.
  * @path: The path to open, in UTF-8.
- * @mode: Either "r" for reading or "w" for writing.
+ * @mode: Either "r" for reading, "w" for writing or "a" for appending.
  * @full_path: (out) (type filename) (transfer full): Return location
  * of the full filename, or %NULL.
  * @error: Location to store error information, if any.
  *
  * Opens a file in the given path within the storage's root directory. If
  * the file exists already, and @mode is set to "w", the file is overwritten.
+ * On systems that support it, the data is written to a temporary file in
+ * the same directory, which atomically replaces the existing file when the
+ * stream is closed with infd_filesystem_storage_stream_close(). Until then,
+ * and if writing fails, the previous version of the file stays in place,
+ * and memory mappings of it stay valid. With @mode set to "a", data is
+ * appended to the file directly, creating it if it does not exist.
  *
  * If @full_path is not %NULL, then it will be set to a newly allocated
  * string which contains the full name of the opened file, in the Glib file
@@ -1090,17 +1245,19 @@ infd_filesystem_storage_write_xml_file(InfdFilesystemStorage* storage,
  * infd_filesystem_storage_stream_close:
  * @file: A #FILE opened with infd_filesystem_storage_open().
  *
- * This is a thin wrapper around fclose(). Use this function instead of
- * fclose() if you have opened the file with infd_filesystem_storage_open(),
- * to make sure that the same C runtime is closing the file that has opened
- * it.
+ * Closes a stream opened with infd_filesystem_storage_open(). Use this
+ * function instead of fclose(), to make sure that the same C runtime is
+ * closing the file that has opened it. If the file was opened with mode
+ * "w", then this also replaces the target file with the data written. If
+ * an error occurred while writing to @file, the target file is left
+ * untouched and this function fails.
  *
- * Returns: The return value of fclose().
+ * Returns: 0 on success, or EOF on error, with errno set.
  */
 int
 infd_filesystem_storage_stream_close(FILE* file)
 {
-  return fclose(file);
+  return infd_filesystem_storage_close_impl(file, TRUE);
 }
 
 /**
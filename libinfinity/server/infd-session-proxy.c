@@ -53,10 +53,14 @@
 
 typedef struct _InfdSessionProxySubscription InfdSessionProxySubscription;
 struct _InfdSessionProxySubscription {
+  InfdSessionProxy* proxy;
   InfXmlConnection* connection;
   guint seq_id;
 
   GSList* users; /* Available users joined via this connection */
+
+  /* Scheduled removal of the subscription due to congestion */
+  InfIoDispatch* drop_dispatch;
 };
 
 typedef struct _InfdSessionProxyPrivate InfdSessionProxyPrivate;
@@ -72,6 +76,8 @@ struct _InfdSessionProxyPrivate {
   GSList* local_users;
   /* Whether there are any subscriptions / synchronizations */
   gboolean idle;
+
+  gboolean drop_congested;
 };
 
 enum {
@@ -82,6 +88,9 @@ enum {
   PROP_SESSION,
   PROP_SUBSCRIPTION_GROUP,
 
+  /* read/write */
+  PROP_DROP_CONGESTED,
+
   /* read/only */
   PROP_IDLE
 };
@@ -110,15 +119,18 @@ G_DEFINE_TYPE_WITH_CODE(InfdSessionProxy, infd_session_proxy, G_TYPE_OBJECT,
  */
 
 static InfdSessionProxySubscription*
-infd_session_proxy_subscription_new(InfXmlConnection* connection,
+infd_session_proxy_subscription_new(InfdSessionProxy* proxy,
+                                    InfXmlConnection* connection,
                                     guint seq_id)
 {
   InfdSessionProxySubscription* subscription;
   subscription = g_slice_new(InfdSessionProxySubscription);
 
+  subscription->proxy = proxy;
   subscription->connection = connection;
   subscription->seq_id = seq_id;
   subscription->users = NULL;
+  subscription->drop_dispatch = NULL;
 
   g_object_ref(G_OBJECT(connection));
   return subscription;
@@ -127,6 +139,8 @@ infd_session_proxy_subscription_new(InfXmlConnection* connection,
 static void
 infd_session_proxy_subscription_free(InfdSessionProxySubscription* subscr)
 {
+  g_assert(subscr->drop_dispatch == NULL);
+
   g_object_unref(G_OBJECT(subscr->connection));
   g_slist_free(subscr->users);
   g_slice_free(InfdSessionProxySubscription, subscr);
@@ -742,6 +756,73 @@ infd_session_proxy_session_close_cb(InfSession* session,
   priv->subscription_group = NULL;
 }
 
+static void
+infd_session_proxy_drop_congested_func(gpointer user_data)
+{
+  InfdSessionProxySubscription* subscr;
+  InfdSessionProxy* proxy;
+  InfdSessionProxyPrivate* priv;
+  InfXmlConnection* connection;
+
+  subscr = (InfdSessionProxySubscription*)user_data;
+  subscr->drop_dispatch = NULL;
+
+  proxy = subscr->proxy;
+  priv = INFD_SESSION_PROXY_PRIVATE(proxy);
+  connection = subscr->connection;
+
+  if(inf_session_get_status(priv->session) != INF_SESSION_RUNNING)
+    return;
+
+  /* Whatever has not yet been passed to the connection would only arrive
+   * after everything already waiting for it, so throw it away. The client
+   * gets a fresh copy of the session when it subscribes again. */
+  inf_communication_group_cancel_messages(
+    INF_COMMUNICATION_GROUP(priv->subscription_group),
+    connection
+  );
+
+  infd_session_proxy_unsubscribe(proxy, connection);
+}
+
+static void
+infd_session_proxy_connection_notify_congested_cb(GObject* object,
+                                                  GParamSpec* pspec,
+                                                  gpointer user_data)
+{
+  InfdSessionProxySubscription* subscr;
+  InfdSessionProxyPrivate* priv;
+  gboolean congested;
+
+  subscr = (InfdSessionProxySubscription*)user_data;
+  priv = INFD_SESSION_PROXY_PRIVATE(subscr->proxy);
+
+  g_object_get(object, "congested", &congested, NULL);
+
+  /* Do not unsubscribe right away, since we might be called from within
+   * inf_xml_connection_send(). */
+  if(congested == TRUE)
+  {
+    if(priv->drop_congested == TRUE && subscr->drop_dispatch == NULL)
+    {
+      subscr->drop_dispatch = inf_io_add_dispatch(
+        priv->io,
+        infd_session_proxy_drop_congested_func,
+        subscr,
+        NULL
+      );
+    }
+  }
+  else
+  {
+    if(subscr->drop_dispatch != NULL)
+    {
+      inf_io_remove_dispatch(priv->io, subscr->drop_dispatch);
+      subscr->drop_dispatch = NULL;
+    }
+  }
+}
+
 /*
  * GObject overrides.
  */
@@ -758,6 +839,7 @@ infd_session_proxy_init(InfdSessionProxy* session_proxy)
   priv->user_id_counter = 1;
   priv->local_users = NULL;
   priv->idle = TRUE;
+  priv->drop_congested = FALSE;
 }
 
 static void
@@ -965,6 +1047,9 @@ infd_session_proxy_set_property(GObject* object,
       proxy
     );
 
+    break;
+  case PROP_DROP_CONGESTED:
+    priv->drop_congested = g_value_get_boolean(value);
     break;
   case PROP_IDLE:
     /* read/only */
@@ -997,6 +1082,9 @@ infd_session_proxy_get_property(GObject* object,
   case PROP_SUBSCRIPTION_GROUP:
     g_value_set_object(value, priv->subscription_group);
     break;
+  case PROP_DROP_CONGESTED:
+    g_value_set_boolean(value, priv->drop_congested);
+    break;
   case PROP_IDLE:
     g_value_set_boolean(value, priv->idle);
     break;
@@ -1021,9 +1109,17 @@ infd_session_proxy_add_subscription(InfdSessionProxy* proxy,
   priv = INFD_SESSION_PROXY_PRIVATE(proxy);
   g_assert(infd_session_proxy_find_subscription(proxy, connection) == NULL);
 
-  subscription = infd_session_proxy_subscription_new(connection, seq_id);
+  subscription =
+    infd_session_proxy_subscription_new(proxy, connection, seq_id);
   priv->subscriptions = g_slist_prepend(priv->subscriptions, subscription);
 
+  g_signal_connect(
+    G_OBJECT(connection),
+    "notify::congested",
+    G_CALLBACK(infd_session_proxy_connection_notify_congested_cb),
+    subscription
+  );
+
   if(priv->idle == TRUE)
   {
     priv->idle = FALSE;
@@ -1057,6 +1153,18 @@ infd_session_proxy_remove_subscription(InfdSessionProxy* proxy,
     );
   }
 
+  inf_signal_handlers_disconnect_by_func(
+    G_OBJECT(connection),
+    G_CALLBACK(infd_session_proxy_connection_notify_congested_cb),
+    subscr
+  );
+
+  if(subscr->drop_dispatch != NULL)
+  {
+    inf_io_remove_dispatch(priv->io, subscr->drop_dispatch);
+    subscr->drop_dispatch = NULL;
+  }
+
   priv->subscriptions = g_slist_remove(priv->subscriptions, subscr);
   infd_session_proxy_subscription_free(subscr);
 
@@ -1401,6 +1509,28 @@ infd_session_proxy_class_init(InfdSessionProxyClass* proxy_class)
     )
   );
 
+  /**
+   * InfdSessionProxy:drop-congested:
+   *
+   * If this is set, then connections that do not keep up with reading the
+   * session's traffic, as reported by #InfXmlConnection:congested, are
+   * unsubscribed from the session instead of queueing ever more messages for
+   * them. Messages that have not yet been passed to the connection are
+   * discarded. The client is notified that its subscription ended, and it
+   * can subscribe again to obtain the current state of the session.
+   */
+  g_object_class_install_property(
+    object_class,
+    PROP_DROP_CONGESTED,
+    g_param_spec_boolean(
+      "drop-congested",
+      "Drop congested",
+      "Whether to unsubscribe connections that become congested",
+      FALSE,
+      G_PARAM_READWRITE
+    )
+  );
+
   g_object_class_install_property(
     object_class,
     PROP_IDLE,
@@ -1574,6 +1704,12 @@ infd_session_proxy_subscribe_to(InfdSessionProxy* proxy,
     (synchronize == FALSE)
   );
 
+  /* Send held back modifications before the new connection joins the
+   * group, so that they are contained in the synchronized state instead of
+   * reaching the connection before synchronization begins. */
+  if(inf_session_get_status(priv->session) == INF_SESSION_RUNNING)
+    inf_session_flush(priv->session);
+
   /* Note we can't do this in the default signal handler since it doesn't
    * know the parent group. TODO: We can, meanwhile. */
   inf_communication_hosted_group_add_member(
@@ -17,13 +17,14 @@
  * MA 02110-1301, USA.
  */
 
+#include <config.h>
+
 #include <libinfinity/server/infd-tcp-server.h>
 #include <libinfinity/common/inf-tcp-connection-private.h>
 #include <libinfinity/common/inf-ip-address.h>
 #include <libinfinity/common/inf-io.h>
 #include <libinfinity/common/inf-native-socket.h>
 #include <libinfinity/inf-define-enum.h>
-#include <config.h>
 
 #ifndef G_OS_WIN32
 # include <sys/types.h>
@@ -39,6 +40,11 @@
 # include <ws2tcpip.h>
 #endif
 
+/* Maximum number of connections accepted in one main loop iteration. If
+ * more connections are pending, the watch fires again right away, but other
+ * events get a chance to be processed in between. */
+#define INFD_TCP_SERVER_ACCEPT_BATCH 64
+
 static const GEnumValue infd_tcp_server_status_values[] = {
   {
     INFD_TCP_SERVER_CLOSED,
@@ -67,6 +73,12 @@ struct _InfdTcpServerPrivate {
   guint local_port;
 
   InfKeepalive keepalive;
+
+  guint backlog;
+  gboolean reuse_port;
+
+  guint send_queue_high_watermark;
+  guint send_queue_low_watermark;
 };
 
 enum {
@@ -79,7 +91,13 @@ enum {
   PROP_LOCAL_ADDRESS,
   PROP_LOCAL_PORT,
 
-  PROP_KEEPALIVE
+  PROP_KEEPALIVE,
+
+  PROP_BACKLOG,
+  PROP_REUSE_PORT,
+
+  PROP_SEND_QUEUE_HIGH_WATERMARK,
+  PROP_SEND_QUEUE_LOW_WATERMARK
 };
 
 enum {
@@ -175,6 +193,7 @@ infd_tcp_server_io(InfNativeSocket* socket,
 
   InfIpAddress* address;
   guint port;
+  guint n_accepted;
 
   server = INFD_TCP_SERVER(user_data);
   priv = INFD_TCP_SERVER_PRIVATE(server);
@@ -193,6 +212,8 @@ infd_tcp_server_io(InfNativeSocket* socket,
   }
   else if(events & INF_IO_INCOMING)
   {
+    n_accepted = 0;
+
     do
     {
       /* Note that we do not do anything with native_addr and len. This is
@@ -206,7 +227,17 @@ infd_tcp_server_io(InfNativeSocket* socket,
       errno = 0;
 #endif
       len = sizeof(native_addr);
+#ifdef HAVE_ACCEPT4
+      /* Saves the fcntl() calls to make the new socket non-blocking */
+      new_socket = accept4(
+        priv->socket,
+        &native_addr.in_generic,
+        &len,
+        SOCK_NONBLOCK | SOCK_CLOEXEC
+      );
+#else
       new_socket = accept(priv->socket, &native_addr.in_generic, &len);
+#endif
       errcode = INF_NATIVE_SOCKET_LAST_ERROR;
 
       if(new_socket == INVALID_SOCKET &&
@@ -217,6 +248,8 @@ infd_tcp_server_io(InfNativeSocket* socket,
       }
       else if(new_socket != INVALID_SOCKET)
       {
+        ++n_accepted;
+
         switch(native_addr.in_generic.sa_family)
         {
         case AF_INET:
@@ -246,6 +279,13 @@ infd_tcp_server_io(InfNativeSocket* socket,
 
         if(connection != NULL)
         {
+          g_object_set(
+            G_OBJECT(connection),
+            "send-queue-high-watermark", priv->send_queue_high_watermark,
+            "send-queue-low-watermark", priv->send_queue_low_watermark,
+            NULL
+          );
+
           g_signal_emit(
             G_OBJECT(server),
             tcp_server_signals[NEW_CONNECTION],
@@ -271,7 +311,8 @@ infd_tcp_server_io(InfNativeSocket* socket,
     } while( (new_socket != INVALID_SOCKET ||
               (new_socket == INVALID_SOCKET &&
                errcode == INF_NATIVE_SOCKET_EINTR)) &&
-             (priv->socket != INVALID_SOCKET));
+             (priv->socket != INVALID_SOCKET) &&
+             (n_accepted < INFD_TCP_SERVER_ACCEPT_BATCH));
   }
 
   g_object_unref(G_OBJECT(server));
@@ -292,6 +333,12 @@ infd_tcp_server_init(InfdTcpServer* server)
   priv->local_port = 0;
 
   priv->keepalive.mask = 0;
+
+  priv->backlog = 128;
+  priv->reuse_port = FALSE;
+
+  priv->send_queue_high_watermark = 0;
+  priv->send_queue_low_watermark = 0;
 }
 
 static void
@@ -363,6 +410,19 @@ infd_tcp_server_set_property(GObject* object,
     g_assert(g_value_get_boxed(value) != NULL);
     priv->keepalive = *(const InfKeepalive*)g_value_get_boxed(value);
     break;
+  case PROP_BACKLOG:
+    priv->backlog = g_value_get_uint(value);
+    break;
+  case PROP_REUSE_PORT:
+    g_return_if_fail(priv->status == INFD_TCP_SERVER_CLOSED);
+    priv->reuse_port = g_value_get_boolean(value);
+    break;
+  case PROP_SEND_QUEUE_HIGH_WATERMARK:
+    priv->send_queue_high_watermark = g_value_get_uint(value);
+    break;
+  case PROP_SEND_QUEUE_LOW_WATERMARK:
+    priv->send_queue_low_watermark = g_value_get_uint(value);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
@@ -398,6 +458,18 @@ infd_tcp_server_get_property(GObject* object,
   case PROP_KEEPALIVE:
     g_value_set_boxed(value, &priv->keepalive);
     break;
+  case PROP_BACKLOG:
+    g_value_set_uint(value, priv->backlog);
+    break;
+  case PROP_REUSE_PORT:
+    g_value_set_boolean(value, priv->reuse_port);
+    break;
+  case PROP_SEND_QUEUE_HIGH_WATERMARK:
+    g_value_set_uint(value, priv->send_queue_high_watermark);
+    break;
+  case PROP_SEND_QUEUE_LOW_WATERMARK:
+    g_value_set_uint(value, priv->send_queue_low_watermark);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
@@ -508,6 +580,64 @@ infd_tcp_server_class_init(InfdTcpServerClass* tcp_server_class)
     )
   );
 
+  g_object_class_install_property(
+    object_class,
+    PROP_BACKLOG,
+    g_param_spec_uint(
+      "backlog",
+      "Backlog",
+      "Maximum number of pending connections that have not yet been "
+      "accepted. Takes effect when the server is opened",
+      1,
+      G_MAXINT,
+      128,
+      G_PARAM_READWRITE
+    )
+  );
+
+  g_object_class_install_property(
+    object_class,
+    PROP_REUSE_PORT,
+    g_param_spec_boolean(
+      "reuse-port",
+      "Reuse port",
+      "Whether to allow other sockets to bind to the same address and port, "
+      "so that incoming connections are distributed among them. Only "
+      "supported on some platforms",
+      FALSE,
+      G_PARAM_READWRITE
+    )
+  );
+
+  g_object_class_install_property(
+    object_class,
+    PROP_SEND_QUEUE_HIGH_WATERMARK,
+    g_param_spec_uint(
+      "send-queue-high-watermark",
+      "Send queue high watermark",
+      "The send queue high watermark for accepted connections, or 0 if "
+      "they should never become congested",
+      0,
+      G_MAXUINT,
+      0,
+      G_PARAM_READWRITE
+    )
+  );
+
+  g_object_class_install_property(
+    object_class,
+    PROP_SEND_QUEUE_LOW_WATERMARK,
+    g_param_spec_uint(
+      "send-queue-low-watermark",
+      "Send queue low watermark",
+      "The send queue low watermark for accepted connections",
+      0,
+      G_MAXUINT,
+      0,
+      G_PARAM_READWRITE
+    )
+  );
+
   tcp_server_signals[NEW_CONNECTION] = g_signal_new(
     "new-connection",
     G_OBJECT_CLASS_TYPE(object_class),
@@ -563,7 +693,8 @@ infd_tcp_server_bind(InfdTcpServer* server,
   struct sockaddr* addr;
   socklen_t addrlen;
 
-#if !defined(G_OS_WIN32) && defined(HAVE_SO_REUSEADDR)
+#if !defined(G_OS_WIN32) && \
+    (defined(HAVE_SO_REUSEADDR) || defined(HAVE_SO_REUSEPORT))
   int value;
 #endif
 
@@ -643,6 +774,36 @@ infd_tcp_server_bind(InfdTcpServer* server,
   }
 #endif
 
+  if(priv->reuse_port == TRUE)
+  {
+#if !defined(G_OS_WIN32) && defined(HAVE_SO_REUSEPORT)
+    /* Allows several processes or threads to each have their own listening
+     * socket on the same port, with the kernel balancing connections among
+     * them. */
+    value = 1;
+
+    if(setsockopt(priv->socket, SOL_SOCKET, SO_REUSEPORT, &value,
+        sizeof(int)) == -1)
+    {
+      inf_native_socket_make_error(INF_NATIVE_SOCKET_LAST_ERROR, error);
+
+      closesocket(priv->socket);
+      priv->socket = INVALID_SOCKET;
+      return FALSE;
+    }
+#else
+# ifdef G_OS_WIN32
+    inf_native_socket_make_error(WSAEOPNOTSUPP, error);
+# else
+    inf_native_socket_make_error(EOPNOTSUPP, error);
+# endif
+
+    closesocket(priv->socket);
+    priv->socket = INVALID_SOCKET;
+    return FALSE;
+#endif
+  }
+
   if(bind(priv->socket, addr, addrlen) == -1)
   {
     inf_native_socket_make_error(INF_NATIVE_SOCKET_LAST_ERROR, error);
@@ -769,7 +930,7 @@ infd_tcp_server_open(InfdTcpServer* server,
   }
 #endif
 
-  if(listen(priv->socket, 5) == -1)
+  if(listen(priv->socket, priv->backlog) == -1)
   {
     inf_native_socket_make_error(INF_NATIVE_SOCKET_LAST_ERROR, error);
     if(!was_bound)
@@ -20,6 +20,7 @@
 #include <libinfinity/server/infd-xmpp-server.h>
 #include <libinfinity/server/infd-tcp-server.h>
 #include <libinfinity/server/infd-xml-server.h>
+#include <libinfinity/server/infd-admission-control.h>
 #include <libinfinity/common/inf-xmpp-connection.h>
 #include <libinfinity/inf-signals.h>
 
@@ -47,6 +48,8 @@ struct _InfdXmppServerPrivate {
   InfSaslContext* sasl_context;
   InfSaslContext* sasl_own_context;
   gchar* sasl_mechanisms;
+
+  InfdAdmissionControl* admission_control;
 };
 
 enum {
@@ -61,6 +64,8 @@ enum {
 
   PROP_SECURITY_POLICY,
 
+  PROP_ADMISSION_CONTROL,
+
   /* Overridden from XML server */
   PROP_STATUS
 };
@@ -98,7 +103,6 @@ infd_xmpp_server_new_connection_cb(InfdTcpServer* tcp_server,
    * here. */
   g_object_get(G_OBJECT(tcp_connection), "remote-address", &addr, NULL);
   addr_str = inf_ip_address_to_string(addr);
-  inf_ip_address_free(addr);
 
   xmpp_connection = inf_xmpp_connection_new(
     tcp_connection,
@@ -113,6 +117,21 @@ infd_xmpp_server_new_connection_cb(InfdTcpServer* tcp_server,
 
   g_free(addr_str);
 
+  /* Rejected connections are kept by the admission control until the
+   * client has been told, but they are not made available to the
+   * server's users. */
+  if(priv->admission_control != NULL &&
+     !infd_admission_control_admit(priv->admission_control,
+                                   xmpp_connection,
+                                   addr))
+  {
+    inf_ip_address_free(addr);
+    g_object_unref(xmpp_connection);
+    return;
+  }
+
+  inf_ip_address_free(addr);
+
   /* We could, alternatively, keep the connection around until authentication
    * has completed and emit the new_connection signal after that, to guarantee
    * that the connection is open when new_connection is emitted. */
@@ -358,6 +377,8 @@ infd_xmpp_server_init(InfdXmppServer* xmpp)
   priv->sasl_context = NULL;
   priv->sasl_own_context = NULL;
   priv->sasl_mechanisms = NULL;
+
+  priv->admission_control = NULL;
 }
 
 static void
@@ -392,6 +413,12 @@ infd_xmpp_server_dispose(GObject* object)
     priv->tls_creds = NULL;
   }
 
+  if(priv->admission_control != NULL)
+  {
+    g_object_unref(priv->admission_control);
+    priv->admission_control = NULL;
+  }
+
   G_OBJECT_CLASS(infd_xmpp_server_parent_class)->dispose(object);
 }
 
@@ -462,6 +489,11 @@ infd_xmpp_server_set_property(GObject* object,
   case PROP_SECURITY_POLICY:
     infd_xmpp_server_set_security_policy(xmpp, g_value_get_enum(value));
     break;
+  case PROP_ADMISSION_CONTROL:
+    if(priv->admission_control != NULL)
+      g_object_unref(priv->admission_control);
+    priv->admission_control = INFD_ADMISSION_CONTROL(g_value_dup_object(value));
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
@@ -515,6 +547,9 @@ infd_xmpp_server_get_property(GObject* object,
   case PROP_SECURITY_POLICY:
     g_value_set_enum(value, priv->security_policy);
     break;
+  case PROP_ADMISSION_CONTROL:
+    g_value_set_object(value, priv->admission_control);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
@@ -628,6 +663,18 @@ infd_xmpp_server_class_init(InfdXmppServerClass* xmpp_class)
     )
   );
 
+  g_object_class_install_property(
+    object_class,
+    PROP_ADMISSION_CONTROL,
+    g_param_spec_object(
+      "admission-control",
+      "Admission control",
+      "Decides which new connections are served, or NULL to serve all",
+      INFD_TYPE_ADMISSION_CONTROL,
+      G_PARAM_READWRITE
+    )
+  );
+
   g_object_class_override_property(object_class, PROP_STATUS, "status");
 
   xmpp_server_signals[ERROR] = g_signal_new(
@@ -81,6 +81,9 @@ struct _InfTextChunkSegment {
   gchar* text;
   gsize length; /* in bytes */
   guint offset; /* absolute to chunk begin in characters, sort criteria */
+  /* If non-NULL, text points into this memory and is not owned by the
+   * segment. It needs to be copied before it can be modified. */
+  GBytes* backing;
 };
 
 /*
@@ -159,10 +162,74 @@ const InfTextChunkPath INF_TEXT_CHUNK_PATH_ICONV = {
 static void
 inf_text_chunk_segment_free(InfTextChunkSegment* segment)
 {
-  g_free(segment->text);
+  if(segment->backing != NULL)
+    g_bytes_unref(segment->backing);
+  else
+    g_free(segment->text);
+
   g_slice_free(InfTextChunkSegment, segment);
 }
 
+/* Sets the text of dest to length bytes of the text of src, starting at
+ * index. If src references shared memory, then dest references the same
+ * memory instead of making a copy. */
+static void
+inf_text_chunk_segment_set_text_from(InfTextChunkSegment* dest,
+                                     const InfTextChunkSegment* src,
+                                     gsize index,
+                                     gsize length)
+{
+  if(src->backing != NULL)
+  {
+    dest->text = src->text + index;
+    dest->backing = g_bytes_ref(src->backing);
+  }
+  else
+  {
+    dest->text = g_memdup(src->text + index, length);
+    dest->backing = NULL;
+  }
+}
+
+/* Sets the text of segment to the given text. If backing is non-NULL, then
+ * text points into backing and the segment references it. Otherwise, the
+ * text is copied. */
+static void
+inf_text_chunk_segment_set_text(InfTextChunkSegment* segment,
+                                gconstpointer text,
+                                gsize bytes,
+                                GBytes* backing)
+{
+  if(backing != NULL)
+  {
+    segment->text = (gchar*)text;
+    segment->backing = g_bytes_ref(backing);
+  }
+  else
+  {
+    segment->text = g_memdup(text, bytes);
+    segment->backing = NULL;
+  }
+}
+
+/* Makes sure the text of segment is owned by the segment, so that it can be
+ * modified in place. */
+static void
+inf_text_chunk_segment_make_writable(InfTextChunkSegment* segment)
+{
+  GBytes* backing;
+
+  if(segment->backing != NULL)
+  {
+    backing = segment->backing;
+
+    segment->text = g_memdup(segment->text, segment->length);
+    segment->backing = NULL;
+
+    g_bytes_unref(backing);
+  }
+}
+
 static int
 inf_text_chunk_segment_cmp(gconstpointer first,
                            gconstpointer second,
@@ -415,9 +482,14 @@ inf_text_chunk_copy(InfTextChunk* self)
       iter = g_sequence_iter_next(iter))
   {
     InfTextChunkSegment* segment = g_sequence_get(iter);
-    InfTextChunkSegment* new_segment = g_slice_new(InfTextChunkSegment);
+    InfTextChunkSegment* new_segment = g_slice_new0(InfTextChunkSegment);
     new_segment->author = segment->author;
-    new_segment->text = g_memdup(segment->text, segment->length);
+    inf_text_chunk_segment_set_text_from(
+      new_segment,
+      segment,
+      0,
+      segment->length
+    );
     new_segment->length = segment->length;
     new_segment->offset = segment->offset;
     g_sequence_append(new_chunk->segments, new_segment);
@@ -475,6 +547,40 @@ inf_text_chunk_get_length(InfTextChunk* self)
   return self->length;
 }
 
+/**
+ * inf_text_chunk_get_memory_usage:
+ * @self: A #InfTextChunk.
+ *
+ * Returns an estimate of the number of bytes @self occupies in memory. This
+ * includes the text of all segments as well as the bookkeeping overhead for
+ * each segment, which dominates for documents edited by many authors.
+ *
+ * Returns: The approximate memory usage of @self, in bytes.
+ **/
+gsize
+inf_text_chunk_get_memory_usage(InfTextChunk* self)
+{
+  GSequenceIter* iter;
+  InfTextChunkSegment* segment;
+  gsize usage;
+
+  g_return_val_if_fail(self != NULL, 0);
+
+  usage = sizeof(InfTextChunk);
+  for(iter = g_sequence_get_begin_iter(self->segments);
+      !g_sequence_iter_is_end(iter);
+      iter = g_sequence_iter_next(iter))
+  {
+    segment = (InfTextChunkSegment*)g_sequence_get(iter);
+
+    /* The GSequence node is roughly five pointers wide */
+    usage += sizeof(InfTextChunkSegment) + 5 * sizeof(gpointer);
+    usage += segment->length;
+  }
+
+  return usage;
+}
+
 /**
  * inf_text_chunk_substring:
  * @self: A #InfTextChunk.
@@ -523,11 +629,13 @@ inf_text_chunk_substring(InfTextChunk* self,
 
     while(begin_iter != end_iter)
     {
-      new_segment = g_slice_new(InfTextChunkSegment);
+      new_segment = g_slice_new0(InfTextChunkSegment);
       new_segment->author = segment->author;
 
-      new_segment->text = g_memdup(
-        segment->text + begin_index,
+      inf_text_chunk_segment_set_text_from(
+        new_segment,
+        segment,
+        begin_index,
         segment->length - begin_index
       );
       
@@ -549,10 +657,12 @@ inf_text_chunk_substring(InfTextChunk* self,
     }
 
     /* Don't forget last segment */
-    new_segment = g_slice_new(InfTextChunkSegment);
+    new_segment = g_slice_new0(InfTextChunkSegment);
     new_segment->author = segment->author;
-    new_segment->text = g_memdup(
-      segment->text + begin_index,
+    inf_text_chunk_segment_set_text_from(
+      new_segment,
+      segment,
+      begin_index,
       end_index - begin_index
     );
     
@@ -580,35 +690,22 @@ inf_text_chunk_substring(InfTextChunk* self,
   return result;
 }
 
-/**
- * inf_text_chunk_insert_text:
- * @self: A #InfTextChunk.
- * @offset: Character offset at which to insert text
- * @text (type const guint8*) (array length=bytes) (transfer none): Text
- * to insert.
- * @length: Number of characters contained in @text.
- * @bytes: Number of bytes of @text.
- * @author: User that wrote @text.
- *
- * Inserts text written by @author into @self. @text is expected to be in
- * the chunk's encoding.
- **/
-void
-inf_text_chunk_insert_text(InfTextChunk* self,
-                           guint offset,
-                           gconstpointer text,
-                           gsize bytes,
-                           guint length,
-                           guint author)
+/* Inserts text into self. If backing is non-NULL, then text points into
+ * backing, and a new segment references it instead of copying the text. */
+static void
+inf_text_chunk_insert_text_impl(InfTextChunk* self,
+                                guint offset,
+                                gconstpointer text,
+                                gsize bytes,
+                                guint length,
+                                guint author,
+                                GBytes* backing)
 {
   GSequenceIter* iter;
   gsize offset_index;
   InfTextChunkSegment* segment;
   InfTextChunkSegment* new_segment;
 
-  g_return_if_fail(self != NULL);
-  g_return_if_fail(offset <= self->length);
-
   if(self->length > 0)
   {
     iter = inf_text_chunk_get_segment(self, offset, &offset_index);
@@ -630,10 +727,12 @@ inf_text_chunk_insert_text(InfTextChunk* self,
       /* No luck, split if necessary */
       if(offset_index > 0 && offset_index < segment->length)
       {
-        new_segment = g_slice_new(InfTextChunkSegment);
+        new_segment = g_slice_new0(InfTextChunkSegment);
         new_segment->author = segment->author;
-        new_segment->text = g_memdup(
-          segment->text + offset_index,
+        inf_text_chunk_segment_set_text_from(
+          new_segment,
+          segment,
+          offset_index,
           segment->length - offset_index
         );
 
@@ -653,9 +752,9 @@ inf_text_chunk_insert_text(InfTextChunk* self,
         iter = g_sequence_iter_next(iter);
       }
 
-      new_segment = g_slice_new(InfTextChunkSegment);
+      new_segment = g_slice_new0(InfTextChunkSegment);
       new_segment->author = author;
-      new_segment->text = g_memdup(text, bytes);
+      inf_text_chunk_segment_set_text(new_segment, text, bytes, backing);
       new_segment->length = bytes;
       new_segment->offset = offset;
       g_sequence_insert_before(iter, new_segment);
@@ -663,6 +762,7 @@ inf_text_chunk_insert_text(InfTextChunk* self,
     else
     {
       /* TODO: g_malloc + g_free + 2*memcpy? */
+      inf_text_chunk_segment_make_writable(segment);
       segment->text = g_realloc(segment->text, segment->length + bytes);
       if(offset_index < segment->length)
       {
@@ -690,9 +790,9 @@ inf_text_chunk_insert_text(InfTextChunk* self,
   }
   else
   {
-    new_segment = g_slice_new(InfTextChunkSegment);
+    new_segment = g_slice_new0(InfTextChunkSegment);
     new_segment->author = author;
-    new_segment->text = g_memdup(text, bytes);
+    inf_text_chunk_segment_set_text(new_segment, text, bytes, backing);
     new_segment->length = bytes;
     new_segment->offset = 0;
 
@@ -705,6 +805,89 @@ inf_text_chunk_insert_text(InfTextChunk* self,
 #endif
 }
 
+/**
+ * inf_text_chunk_insert_text:
+ * @self: A #InfTextChunk.
+ * @offset: Character offset at which to insert text
+ * @text (type const guint8*) (array length=bytes) (transfer none): Text
+ * to insert.
+ * @length: Number of characters contained in @text.
+ * @bytes: Number of bytes of @text.
+ * @author: User that wrote @text.
+ *
+ * Inserts text written by @author into @self. @text is expected to be in
+ * the chunk's encoding.
+ **/
+void
+inf_text_chunk_insert_text(InfTextChunk* self,
+                           guint offset,
+                           gconstpointer text,
+                           gsize bytes,
+                           guint length,
+                           guint author)
+{
+  g_return_if_fail(self != NULL);
+  g_return_if_fail(offset <= self->length);
+
+  inf_text_chunk_insert_text_impl(
+    self,
+    offset,
+    text,
+    bytes,
+    length,
+    author,
+    NULL
+  );
+}
+
+/**
+ * inf_text_chunk_insert_bytes:
+ * @self: A #InfTextChunk.
+ * @offset: Character offset at which to insert text.
+ * @bytes: (transfer none): The text to insert, in the chunk's encoding.
+ * @length: Number of characters contained in @bytes.
+ * @author: User that wrote the text.
+ *
+ * Inserts the text contained in @bytes, written by @author, into @self. This
+ * function behaves like inf_text_chunk_insert_text(), but if the text does
+ * not need to be merged with an adjacent segment, @self keeps a reference
+ * on @bytes and uses its memory directly instead of copying the text. The
+ * text is only copied when the segment is modified later. Copies and
+ * substrings of @self share the memory as well.
+ *
+ * This allows to build large chunks from memory-mapped files without
+ * copying the content. The memory of @bytes must not be modified while it
+ * is in use by the chunk.
+ **/
+void
+inf_text_chunk_insert_bytes(InfTextChunk* self,
+                            guint offset,
+                            GBytes* bytes,
+                            guint length,
+                            guint author)
+{
+  gconstpointer data;
+  gsize size;
+
+  g_return_if_fail(self != NULL);
+  g_return_if_fail(offset <= self->length);
+  g_return_if_fail(bytes != NULL);
+
+  data = g_bytes_get_data(bytes, &size);
+  if(size == 0)
+    return;
+
+  inf_text_chunk_insert_text_impl(
+    self,
+    offset,
+    data,
+    size,
+    length,
+    author,
+    bytes
+  );
+}
+
 /**
  * inf_text_chunk_insert_chunk:
  * @self: A #InfTextChunk.
@@ -745,13 +928,14 @@ inf_text_chunk_insert_chunk(InfTextChunk* self,
     {
       segment = g_sequence_get(g_sequence_get_begin_iter(text->segments));
 
-      inf_text_chunk_insert_text(
+      inf_text_chunk_insert_text_impl(
         self,
         offset,
         segment->text,
         segment->length,
         text->length,
-        segment->author
+        segment->author,
+        segment->backing
       );
     }
     else
@@ -797,6 +981,7 @@ inf_text_chunk_insert_chunk(InfTextChunk* self,
         if(first_merge->author == first->author && offset > 0)
         {
           /* Can merge first segment */
+          inf_text_chunk_segment_make_writable(first_merge);
           first_merge->length += first->length;
 
           first_merge->text = g_realloc(
@@ -817,6 +1002,7 @@ inf_text_chunk_insert_chunk(InfTextChunk* self,
         if(last_merge->author == last->author && offset < self->length)
         {
           /* Can merge last segment */
+          inf_text_chunk_segment_make_writable(last_merge);
           last_merge->length += last->length;
           last_merge->text = g_realloc(last_merge->text, last_merge->length);
 
@@ -854,7 +1040,7 @@ inf_text_chunk_insert_chunk(InfTextChunk* self,
       {
         /* Insert within a segment, split segment */
 
-        new_segment = g_slice_new(InfTextChunkSegment);
+        new_segment = g_slice_new0(InfTextChunkSegment);
         new_segment->author = last_merge->author;
 
         if(last_merge->author == last->author)
@@ -903,6 +1089,7 @@ inf_text_chunk_insert_chunk(InfTextChunk* self,
         if(first_merge->author == first->author)
         {
           /* Merge into first */
+          inf_text_chunk_segment_make_writable(first_merge);
           if(first_merge->length < offset_index + first->length)
           {
             first_merge->text = g_realloc(
@@ -937,10 +1124,15 @@ inf_text_chunk_insert_chunk(InfTextChunk* self,
           text_iter = g_sequence_iter_next(text_iter))
       {
         segment = g_sequence_get(text_iter);
-        new_segment = g_slice_new(InfTextChunkSegment);
+        new_segment = g_slice_new0(InfTextChunkSegment);
 
         new_segment->author = segment->author;
-        new_segment->text = g_memdup(segment->text, segment->length);
+        inf_text_chunk_segment_set_text_from(
+          new_segment,
+          segment,
+          0,
+          segment->length
+        );
         new_segment->length = segment->length;
         new_segment->offset = offset + segment->offset;
         g_sequence_insert_before(iter, new_segment);
@@ -964,10 +1156,15 @@ inf_text_chunk_insert_chunk(InfTextChunk* self,
         text_iter = g_sequence_iter_next(text_iter))
     {
       segment = (InfTextChunkSegment*)g_sequence_get(text_iter);
-      new_segment = g_slice_new(InfTextChunkSegment);
+      new_segment = g_slice_new0(InfTextChunkSegment);
 
       new_segment->author = segment->author;
-      new_segment->text = g_memdup(segment->text, segment->length);
+      inf_text_chunk_segment_set_text_from(
+        new_segment,
+        segment,
+        0,
+        segment->length
+      );
       new_segment->length = segment->length;
       new_segment->offset = segment->offset;
 
@@ -1030,6 +1227,7 @@ inf_text_chunk_erase(InfTextChunk* self,
         if(first == last)
         {
           /* Remove within a segment */
+          inf_text_chunk_segment_make_writable(first);
           g_memmove(
             first->text + first_index,
             first->text + last_index,
@@ -1041,6 +1239,7 @@ inf_text_chunk_erase(InfTextChunk* self,
         }
         else
         {
+          inf_text_chunk_segment_make_writable(first);
           if(first->length < first_index + last->length - last_index)
           {
             first->text = g_realloc(
@@ -1074,11 +1273,19 @@ inf_text_chunk_erase(InfTextChunk* self,
 
         if(last_index > 0)
         {
-          g_memmove(
-            last->text,
-            last->text + last_index,
-            last->length - last_index
-          );
+          if(last->backing != NULL)
+          {
+            /* Shared memory: just move the start of the segment */
+            last->text += last_index;
+          }
+          else
+          {
+            g_memmove(
+              last->text,
+              last->text + last_index,
+              last->length - last_index
+            );
+          }
         }
 
         last->length -= last_index;
@@ -1108,11 +1315,19 @@ inf_text_chunk_erase(InfTextChunk* self,
         /* Erase from beginning */
         if(last_index > 0)
         {
-          g_memmove(
-            last->text,
-            last->text + last_index,
-            last->length - last_index
-          );
+          if(last->backing != NULL)
+          {
+            /* Shared memory: just move the start of the segment */
+            last->text += last_index;
+          }
+          else
+          {
+            g_memmove(
+              last->text,
+              last->text + last_index,
+              last->length - last_index
+            );
+          }
 
           last->length -= last_index;
           last->offset = 0;
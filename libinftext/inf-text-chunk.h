@@ -83,6 +83,9 @@ inf_text_chunk_get_encoding(InfTextChunk* self);
 guint
 inf_text_chunk_get_length(InfTextChunk* self);
 
+gsize
+inf_text_chunk_get_memory_usage(InfTextChunk* self);
+
 InfTextChunk*
 inf_text_chunk_substring(InfTextChunk* self,
                          guint begin,
@@ -96,6 +99,13 @@ inf_text_chunk_insert_text(InfTextChunk* self,
                            guint length,
                            guint author);
 
+void
+inf_text_chunk_insert_bytes(InfTextChunk* self,
+                            guint offset,
+                            GBytes* bytes,
+                            guint length,
+                            guint author);
+
 void
 inf_text_chunk_insert_chunk(InfTextChunk* self,
                             guint offset,
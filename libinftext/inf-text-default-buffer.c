@@ -157,6 +157,16 @@ inf_text_default_buffer_buffer_set_modified(InfBuffer* buffer,
   }
 }
 
+static gsize
+inf_text_default_buffer_buffer_get_memory_usage(InfBuffer* buffer)
+{
+  InfTextDefaultBufferPrivate* priv;
+  priv = INF_TEXT_DEFAULT_BUFFER_PRIVATE(buffer);
+
+  return sizeof(InfTextDefaultBuffer) +
+    inf_text_chunk_get_memory_usage(priv->chunk);
+}
+
 static const gchar*
 inf_text_default_buffer_buffer_get_encoding(InfTextBuffer* buffer)
 {
@@ -355,6 +365,7 @@ inf_text_default_buffer_buffer_iface_init(InfBufferInterface* iface)
 {
   iface->get_modified = inf_text_default_buffer_buffer_get_modified;
   iface->set_modified = inf_text_default_buffer_buffer_set_modified;
+  iface->get_memory_usage = inf_text_default_buffer_buffer_get_memory_usage;
 }
 
 static void
@@ -29,20 +29,70 @@
  * The functions in this section are utility functions that can be used when
  * implementing a #InfdNotePlugin to handle #InfTextSession<!-- -->s. These
  * functions implement reading and writing the content of an #InfTextSession
- * to an XML file in the storage.
+ * to a file in the storage.
+ *
+ * Two file formats are supported. The default is an XML format. The compact
+ * format, written by inf_text_filesystem_format_write_compact(), is a binary
+ * format that stores the text of the document contiguously, followed by a
+ * table of segments with their authors and the user table. When a file in
+ * compact format is read, it is memory-mapped, and the buffer references
+ * the mapped text directly instead of copying it. Text is only copied for
+ * the parts of the document that are being edited. This makes loading large
+ * documents fast and keeps memory usage low. inf_text_filesystem_format_read()
+ * detects the format of a file automatically.
  */
 
 #include <libinftext/inf-text-filesystem-format.h>
 #include <libinfinity/common/inf-xml-util.h>
 #include <libinfinity/inf-i18n.h>
+#include <libinfinity/inf-config.h> /* LIBINFINITY_HAVE_ZSTD */
+
+#ifdef LIBINFINITY_HAVE_ZSTD
+# include <zstd.h>
+#endif
 
 #include <string.h>
+#include <errno.h>
 
 typedef struct _InfTextFilesystemFormatWriteData {
   xmlNodePtr root;
   GHashTable* encountered_authors;
 } InfTextFilesystemFormatWriteData;
 
+typedef struct _InfTextFilesystemFormatCompactWriteData {
+  GByteArray* users;
+  GHashTable* encountered_authors;
+  guint n_users;
+} InfTextFilesystemFormatCompactWriteData;
+
+/* Cursor into the memory of a file in compact format. All accessors check
+ * that the data to be read lies within the file. */
+typedef struct _InfTextFilesystemFormatCompactReader {
+  const guchar* data;
+  gsize size;
+  gsize pos;
+} InfTextFilesystemFormatCompactReader;
+
+/* The compact format starts with a fixed header consisting of the magic
+ * bytes, a 32 bit version number and 32 bit flags, followed by the text of
+ * all segments. Behind the text there is the segment table, with 32 bit
+ * author ID, 32 bit number of characters and 64 bit number of bytes for
+ * each segment, and then the user table, with 32 bit ID, 32 bit name length,
+ * the 64 bit IEEE 754 representation of the hue, and the name for each
+ * user. The file ends with a footer containing the 64 bit length of the
+ * text, and the 32 bit number of segments and users. All integers are
+ * stored in little endian byte order. If the compression flag is set, the
+ * text is stored as a single zstd frame, and the length in the footer is
+ * the length of the compressed frame. */
+static const gchar INF_TEXT_FILESYSTEM_FORMAT_COMPACT_MAGIC[8] =
+  { '\211', 'I', 'n', 'f', 'T', 'e', 'x', 't' };
+static const guint32 INF_TEXT_FILESYSTEM_FORMAT_COMPACT_VERSION = 1;
+static const guint32 INF_TEXT_FILESYSTEM_FORMAT_COMPACT_FLAG_ZSTD = 1 << 0;
+static const int INF_TEXT_FILESYSTEM_FORMAT_COMPACT_ZSTD_LEVEL = 3;
+static const gsize INF_TEXT_FILESYSTEM_FORMAT_COMPACT_HEADER_SIZE = 16;
+static const gsize INF_TEXT_FILESYSTEM_FORMAT_COMPACT_FOOTER_SIZE = 16;
+static const gsize INF_TEXT_FILESYSTEM_FORMAT_COMPACT_SEGMENT_SIZE = 16;
+
 static GQuark
 inf_text_filesystem_format_error_quark()
 {
@@ -69,6 +119,56 @@ inf_text_filesystem_format_read_close_func(void* context)
   return infd_filesystem_storage_stream_close((FILE*)context);
 }
 
+static gboolean
+inf_text_filesystem_format_add_user(InfUserTable* user_table,
+                                    guint id,
+                                    const gchar* name,
+                                    gdouble hue,
+                                    GError** error)
+{
+  InfUser* user;
+
+  if(inf_user_table_lookup_user_by_id(user_table, id) != NULL)
+  {
+    g_set_error(
+      error,
+      inf_text_filesystem_format_error_quark(),
+      INF_TEXT_FILESYSTEM_FORMAT_ERROR_USER_EXISTS,
+      _("User with ID %u exists already"),
+      id
+    );
+
+    return FALSE;
+  }
+
+  if(inf_user_table_lookup_user_by_name(user_table, name))
+  {
+    g_set_error(
+      error,
+      inf_text_filesystem_format_error_quark(),
+      INF_TEXT_FILESYSTEM_FORMAT_ERROR_USER_EXISTS,
+      _("User with name \"%s\" exists already"),
+      name
+    );
+
+    return FALSE;
+  }
+
+  user = INF_USER(
+    g_object_new(
+      INF_TEXT_TYPE_USER,
+      "id", id,
+      "name", name,
+      "hue", hue,
+      NULL
+    )
+  );
+
+  inf_user_table_add_user(user_table, user);
+  g_object_unref(user);
+  return TRUE;
+}
+
 static gboolean
 inf_text_filesystem_format_read_user(InfUserTable* user_table,
                                      xmlNodePtr node,
@@ -78,7 +178,6 @@ inf_text_filesystem_format_read_user(InfUserTable* user_table,
   gdouble hue;
   xmlChar* name;
   gboolean result;
-  InfUser* user;
 
   if(!inf_xml_util_get_attribute_uint_required(node, "id", &id, error))
     return FALSE;
@@ -90,49 +189,13 @@ inf_text_filesystem_format_read_user(InfUserTable* user_table,
   if(name == NULL)
     return FALSE;
 
-  if(inf_user_table_lookup_user_by_id(user_table, id) != NULL)
-  {
-    g_set_error(
-      error,
-      inf_text_filesystem_format_error_quark(),
-      INF_TEXT_FILESYSTEM_FORMAT_ERROR_USER_EXISTS,
-      _("User with ID %u exists already"),
-      id
-    );
-
-    result = FALSE;
-  }
-  else
-  {
-    if(inf_user_table_lookup_user_by_name(user_table, (const gchar*)name))
-    {
-      g_set_error(
-        error,
-        inf_text_filesystem_format_error_quark(),
-        INF_TEXT_FILESYSTEM_FORMAT_ERROR_USER_EXISTS,
-        _("User with name \"%s\" exists already"),
-        (const gchar*)name
-      );
-
-      result = FALSE;
-    }
-    else
-    {
-      user = INF_USER(
-        g_object_new(
-          INF_TEXT_TYPE_USER,
-          "id", id,
-          "name", name,
-          "hue", hue,
-          NULL
-        )
-      );
-
-      inf_user_table_add_user(user_table, user);
-      g_object_unref(user);
-      result = TRUE;
-    }
-  }
+  result = inf_text_filesystem_format_add_user(
+    user_table,
+    id,
+    (const gchar*)name,
+    hue,
+    error
+  );
 
   xmlFree(name);
   return result;
@@ -281,6 +344,596 @@ inf_text_filesystem_format_write_foreach_user_func(InfUser* user,
   }
 }
 
+static gboolean
+inf_text_filesystem_format_compact_read_uint32(
+  InfTextFilesystemFormatCompactReader* reader,
+  guint32* value)
+{
+  guint32 le;
+
+  if(reader->size - reader->pos < sizeof(le))
+    return FALSE;
+
+  memcpy(&le, reader->data + reader->pos, sizeof(le));
+  reader->pos += sizeof(le);
+
+  *value = GUINT32_FROM_LE(le);
+  return TRUE;
+}
+
+static gboolean
+inf_text_filesystem_format_compact_read_uint64(
+  InfTextFilesystemFormatCompactReader* reader,
+  guint64* value)
+{
+  guint64 le;
+
+  if(reader->size - reader->pos < sizeof(le))
+    return FALSE;
+
+  memcpy(&le, reader->data + reader->pos, sizeof(le));
+  reader->pos += sizeof(le);
+
+  *value = GUINT64_FROM_LE(le);
+  return TRUE;
+}
+
+static gboolean
+inf_text_filesystem_format_compact_read_data(
+  InfTextFilesystemFormatCompactReader* reader,
+  gsize len,
+  const guchar** data)
+{
+  if(reader->size - reader->pos < len)
+    return FALSE;
+
+  *data = reader->data + reader->pos;
+  reader->pos += len;
+  return TRUE;
+}
+
+static void
+inf_text_filesystem_format_compact_set_invalid_error(GError** error)
+{
+  g_set_error_literal(
+    error,
+    inf_text_filesystem_format_error_quark(),
+    INF_TEXT_FILESYSTEM_FORMAT_ERROR_INVALID_FORMAT,
+    _("The file is truncated or corrupted")
+  );
+}
+
+static gboolean
+inf_text_filesystem_format_compact_read_users(
+  InfTextFilesystemFormatCompactReader* reader,
+  guint32 n_users,
+  InfUserTable* user_table,
+  GError** error)
+{
+  guint32 i;
+  guint32 id;
+  guint32 name_len;
+  guint64 hue_bits;
+  gdouble hue;
+  const guchar* name_data;
+  gchar* name;
+  gboolean result;
+
+  for(i = 0; i < n_users; ++i)
+  {
+    if(!inf_text_filesystem_format_compact_read_uint32(reader, &id) ||
+       !inf_text_filesystem_format_compact_read_uint32(reader, &name_len) ||
+       !inf_text_filesystem_format_compact_read_uint64(reader, &hue_bits) ||
+       !inf_text_filesystem_format_compact_read_data(reader, name_len,
+                                                     &name_data))
+    {
+      inf_text_filesystem_format_compact_set_invalid_error(error);
+      return FALSE;
+    }
+
+    if(!g_utf8_validate((const gchar*)name_data, name_len, NULL))
+    {
+      inf_text_filesystem_format_compact_set_invalid_error(error);
+      return FALSE;
+    }
+
+    memcpy(&hue, &hue_bits, sizeof(hue));
+
+    name = g_strndup((const gchar*)name_data, name_len);
+
+    result = inf_text_filesystem_format_add_user(
+      user_table,
+      id,
+      name,
+      hue,
+      error
+    );
+
+    g_free(name);
+    if(result == FALSE)
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+inf_text_filesystem_format_compact_read_buffer(
+  InfTextFilesystemFormatCompactReader* reader,
+  GBytes* text_bytes,
+  guint32 n_segments,
+  InfUserTable* user_table,
+  InfTextBuffer* buffer,
+  GError** error)
+{
+  InfTextChunk* chunk;
+  GBytes* segment_bytes;
+  InfUser* user;
+  gboolean is_utf8;
+  const gchar* text_data;
+  gsize text_offset;
+  gsize text_end;
+  const gchar* text;
+
+  guint32 i;
+  guint32 author;
+  guint32 chars;
+  guint64 segment_size;
+
+  gchar* converted;
+  gsize converted_bytes;
+
+  is_utf8 = TRUE;
+  if(strcmp(inf_text_buffer_get_encoding(buffer), "UTF-8") != 0)
+    is_utf8 = FALSE;
+
+  /* For UTF-8 buffers, the text is collected in a chunk that references the
+   * file content, and then inserted into the buffer as a whole, so that the
+   * buffer can share the memory. */
+  chunk = NULL;
+  if(is_utf8)
+    chunk = inf_text_chunk_new("UTF-8");
+
+  text_data = g_bytes_get_data(text_bytes, &text_end);
+  text_offset = 0;
+
+  for(i = 0; i < n_segments; ++i)
+  {
+    if(!inf_text_filesystem_format_compact_read_uint32(reader, &author) ||
+       !inf_text_filesystem_format_compact_read_uint32(reader, &chars) ||
+       !inf_text_filesystem_format_compact_read_uint64(reader, &segment_size) ||
+       segment_size > text_end - text_offset)
+    {
+      inf_text_filesystem_format_compact_set_invalid_error(error);
+      if(chunk != NULL) inf_text_chunk_free(chunk);
+      return FALSE;
+    }
+
+    user = NULL;
+    if(author != 0)
+    {
+      user = inf_user_table_lookup_user_by_id(user_table, author);
+      if(user == NULL)
+      {
+        g_set_error(
+          error,
+          inf_text_filesystem_format_error_quark(),
+          INF_TEXT_FILESYSTEM_FORMAT_ERROR_NO_SUCH_USER,
+          _("User with ID \"%u\" does not exist"),
+          author
+        );
+
+        if(chunk != NULL) inf_text_chunk_free(chunk);
+        return FALSE;
+      }
+    }
+
+    text = text_data + text_offset;
+    if(!g_utf8_validate(text, segment_size, NULL) ||
+       g_utf8_strlen(text, segment_size) != (glong)chars)
+    {
+      inf_text_filesystem_format_compact_set_invalid_error(error);
+      if(chunk != NULL) inf_text_chunk_free(chunk);
+      return FALSE;
+    }
+
+    if(segment_size > 0)
+    {
+      if(is_utf8)
+      {
+        segment_bytes = g_bytes_new_from_bytes(
+          text_bytes,
+          text_offset,
+          segment_size
+        );
+
+        inf_text_chunk_insert_bytes(
+          chunk,
+          inf_text_chunk_get_length(chunk),
+          segment_bytes,
+          chars,
+          author
+        );
+
+        g_bytes_unref(segment_bytes);
+      }
+      else
+      {
+        /* Convert from UTF-8 to buffer encoding */
+        converted = g_convert(
+          text,
+          segment_size,
+          inf_text_buffer_get_encoding(buffer),
+          "UTF-8",
+          NULL,
+          &converted_bytes,
+          error
+        );
+
+        if(converted == NULL)
+          return FALSE;
+
+        inf_text_buffer_insert_text(
+          buffer,
+          inf_text_buffer_get_length(buffer),
+          converted,
+          converted_bytes,
+          chars,
+          user
+        );
+
+        g_free(converted);
+      }
+    }
+
+    text_offset += segment_size;
+  }
+
+  if(text_offset != text_end)
+  {
+    inf_text_filesystem_format_compact_set_invalid_error(error);
+    if(chunk != NULL) inf_text_chunk_free(chunk);
+    return FALSE;
+  }
+
+  if(chunk != NULL)
+  {
+    if(inf_text_chunk_get_length(chunk) > 0)
+      inf_text_buffer_insert_chunk(buffer, 0, chunk, NULL);
+    inf_text_chunk_free(chunk);
+  }
+
+  return TRUE;
+}
+
+static void
+inf_text_filesystem_format_compact_set_unsupported_error(GError** error)
+{
+  g_set_error_literal(
+    error,
+    inf_text_filesystem_format_error_quark(),
+    INF_TEXT_FILESYSTEM_FORMAT_ERROR_COMPRESSION_UNSUPPORTED,
+    _("Compression support is not available")
+  );
+}
+
+static GBytes*
+inf_text_filesystem_format_compact_decompress(const guchar* data,
+                                              gsize size,
+                                              GError** error)
+{
+#ifdef LIBINFINITY_HAVE_ZSTD
+  unsigned long long content_size;
+  gpointer text;
+  size_t result;
+
+  content_size = ZSTD_getFrameContentSize(data, size);
+  if(content_size == ZSTD_CONTENTSIZE_UNKNOWN ||
+     content_size == ZSTD_CONTENTSIZE_ERROR ||
+     content_size > G_MAXSIZE)
+  {
+    inf_text_filesystem_format_compact_set_invalid_error(error);
+    return NULL;
+  }
+
+  if(content_size == 0)
+    return g_bytes_new(NULL, 0);
+
+  /* The size comes from the file, so do not abort if it is too large */
+  text = g_try_malloc(content_size);
+  if(text == NULL)
+  {
+    g_set_error_literal(
+      error,
+      G_FILE_ERROR,
+      G_FILE_ERROR_NOMEM,
+      g_strerror(ENOMEM)
+    );
+
+    return NULL;
+  }
+
+  result = ZSTD_decompress(text, content_size, data, size);
+  if(ZSTD_isError(result) || result != content_size)
+  {
+    g_free(text);
+    inf_text_filesystem_format_compact_set_invalid_error(error);
+    return NULL;
+  }
+
+  return g_bytes_new_take(text, content_size);
+#else
+  inf_text_filesystem_format_compact_set_unsupported_error(error);
+  return NULL;
+#endif
+}
+
+static gboolean
+inf_text_filesystem_format_read_compact(GBytes* bytes,
+                                        InfUserTable* user_table,
+                                        InfTextBuffer* buffer,
+                                        GError** error)
+{
+  InfTextFilesystemFormatCompactReader reader;
+  guint32 version;
+  guint32 flags;
+  guint64 text_size;
+  guint32 n_segments;
+  guint32 n_users;
+  gsize tables_end;
+  gsize available;
+  GBytes* text_bytes;
+  gboolean result;
+
+  reader.data = g_bytes_get_data(bytes, &reader.size);
+  reader.pos = sizeof(INF_TEXT_FILESYSTEM_FORMAT_COMPACT_MAGIC);
+
+  if(reader.size < INF_TEXT_FILESYSTEM_FORMAT_COMPACT_HEADER_SIZE +
+                   INF_TEXT_FILESYSTEM_FORMAT_COMPACT_FOOTER_SIZE)
+  {
+    inf_text_filesystem_format_compact_set_invalid_error(error);
+    return FALSE;
+  }
+
+  inf_text_filesystem_format_compact_read_uint32(&reader, &version);
+  inf_text_filesystem_format_compact_read_uint32(&reader, &flags);
+
+  if(version != INF_TEXT_FILESYSTEM_FORMAT_COMPACT_VERSION ||
+     (flags & ~INF_TEXT_FILESYSTEM_FORMAT_COMPACT_FLAG_ZSTD) != 0)
+  {
+    g_set_error(
+      error,
+      inf_text_filesystem_format_error_quark(),
+      INF_TEXT_FILESYSTEM_FORMAT_ERROR_UNSUPPORTED_VERSION,
+      _("Version %u of the compact format is not supported"),
+      (guint)version
+    );
+
+    return FALSE;
+  }
+
+  tables_end = reader.size - INF_TEXT_FILESYSTEM_FORMAT_COMPACT_FOOTER_SIZE;
+  reader.pos = tables_end;
+
+  inf_text_filesystem_format_compact_read_uint64(&reader, &text_size);
+  inf_text_filesystem_format_compact_read_uint32(&reader, &n_segments);
+  inf_text_filesystem_format_compact_read_uint32(&reader, &n_users);
+
+  /* Make sure the text and the segment table fit into the file before
+   * doing any arithmetic with the sizes from the footer. */
+  available = tables_end - INF_TEXT_FILESYSTEM_FORMAT_COMPACT_HEADER_SIZE;
+  if(text_size > available ||
+     (guint64)n_segments * INF_TEXT_FILESYSTEM_FORMAT_COMPACT_SEGMENT_SIZE >
+     available - text_size)
+  {
+    inf_text_filesystem_format_compact_set_invalid_error(error);
+    return FALSE;
+  }
+
+  /* Read the user table first, so that segment authors can be looked up */
+  reader.size = tables_end;
+  reader.pos = INF_TEXT_FILESYSTEM_FORMAT_COMPACT_HEADER_SIZE + text_size +
+    n_segments * INF_TEXT_FILESYSTEM_FORMAT_COMPACT_SEGMENT_SIZE;
+
+  if(!inf_text_filesystem_format_compact_read_users(&reader, n_users,
+                                                    user_table, error))
+  {
+    return FALSE;
+  }
+
+  if(reader.pos != reader.size)
+  {
+    inf_text_filesystem_format_compact_set_invalid_error(error);
+    return FALSE;
+  }
+
+  if(flags & INF_TEXT_FILESYSTEM_FORMAT_COMPACT_FLAG_ZSTD)
+  {
+    text_bytes = inf_text_filesystem_format_compact_decompress(
+      reader.data + INF_TEXT_FILESYSTEM_FORMAT_COMPACT_HEADER_SIZE,
+      text_size,
+      error
+    );
+
+    if(text_bytes == NULL)
+      return FALSE;
+  }
+  else
+  {
+    text_bytes = g_bytes_new_from_bytes(
+      bytes,
+      INF_TEXT_FILESYSTEM_FORMAT_COMPACT_HEADER_SIZE,
+      text_size
+    );
+  }
+
+  reader.pos = INF_TEXT_FILESYSTEM_FORMAT_COMPACT_HEADER_SIZE + text_size;
+
+  result = inf_text_filesystem_format_compact_read_buffer(
+    &reader,
+    text_bytes,
+    n_segments,
+    user_table,
+    buffer,
+    error
+  );
+
+  g_bytes_unref(text_bytes);
+  return result;
+}
+
+static GBytes*
+inf_text_filesystem_format_map_file(const gchar* full_path,
+                                    GError** error)
+{
+#ifdef G_OS_WIN32
+  gchar* contents;
+  gsize length;
+
+  /* A mapped file cannot be replaced on Windows, so read the whole file
+   * into memory instead. */
+  if(!g_file_get_contents(full_path, &contents, &length, error))
+    return NULL;
+
+  return g_bytes_new_take(contents, length);
+#else
+  GMappedFile* mapped_file;
+  GBytes* bytes;
+
+  mapped_file = g_mapped_file_new(full_path, FALSE, error);
+  if(mapped_file == NULL)
+    return NULL;
+
+  bytes = g_mapped_file_get_bytes(mapped_file);
+  g_mapped_file_unref(mapped_file);
+  return bytes;
+#endif
+}
+
+static void
+inf_text_filesystem_format_compact_append_uint32(GByteArray* array,
+                                                 guint32 value)
+{
+  guint32 le;
+  le = GUINT32_TO_LE(value);
+  g_byte_array_append(array, (const guint8*)&le, sizeof(le));
+}
+
+static void
+inf_text_filesystem_format_compact_append_uint64(GByteArray* array,
+                                                 guint64 value)
+{
+  guint64 le;
+  le = GUINT64_TO_LE(value);
+  g_byte_array_append(array, (const guint8*)&le, sizeof(le));
+}
+
+static void
+inf_text_filesystem_format_write_compact_foreach_user_func(InfUser* user,
+                                                           gpointer user_data)
+{
+  InfTextFilesystemFormatCompactWriteData* data;
+  gpointer user_id;
+  const gchar* name;
+  gdouble hue;
+  guint64 hue_bits;
+
+  data = (InfTextFilesystemFormatCompactWriteData*)user_data;
+  user_id = GUINT_TO_POINTER(inf_user_get_id(user));
+
+  if(g_hash_table_lookup(data->encountered_authors, user_id) != NULL)
+  {
+    name = inf_user_get_name(user);
+    hue = inf_text_user_get_hue(INF_TEXT_USER(user));
+    memcpy(&hue_bits, &hue, sizeof(hue_bits));
+
+    inf_text_filesystem_format_compact_append_uint32(
+      data->users,
+      inf_user_get_id(user)
+    );
+
+    inf_text_filesystem_format_compact_append_uint32(
+      data->users,
+      strlen(name)
+    );
+
+    inf_text_filesystem_format_compact_append_uint64(data->users, hue_bits);
+    g_byte_array_append(data->users, (const guint8*)name, strlen(name));
+    ++data->n_users;
+  }
+}
+
+static gpointer
+inf_text_filesystem_format_compact_compress(GByteArray* text,
+                                            gsize* compressed_size,
+                                            GError** error)
+{
+#ifdef LIBINFINITY_HAVE_ZSTD
+  gpointer compressed;
+  size_t bound;
+  size_t result;
+
+  bound = ZSTD_compressBound(text->len);
+  compressed = g_malloc(bound);
+
+  result = ZSTD_compress(
+    compressed,
+    bound,
+    text->data,
+    text->len,
+    INF_TEXT_FILESYSTEM_FORMAT_COMPACT_ZSTD_LEVEL
+  );
+
+  if(ZSTD_isError(result))
+  {
+    g_set_error(
+      error,
+      inf_text_filesystem_format_error_quark(),
+      INF_TEXT_FILESYSTEM_FORMAT_ERROR_COMPRESSION_UNSUPPORTED,
+      _("Failed to compress text: %s"),
+      ZSTD_getErrorName(result)
+    );
+
+    g_free(compressed);
+    return NULL;
+  }
+
+  *compressed_size = result;
+  return compressed;
+#else
+  inf_text_filesystem_format_compact_set_unsupported_error(error);
+  return NULL;
+#endif
+}
+
+static gboolean
+inf_text_filesystem_format_compact_write(FILE* stream,
+                                         gconstpointer data,
+                                         gsize len,
+                                         GError** error)
+{
+  int code;
+
+  if(len == 0)
+    return TRUE;
+
+  if(infd_filesystem_storage_stream_write(stream, data, len) != len)
+  {
+    code = errno;
+
+    g_set_error_literal(
+      error,
+      G_FILE_ERROR,
+      g_file_error_from_errno(code),
+      g_strerror(code)
+    );
+
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
 /**
  * inf_text_filesystem_format_read:
  * @storage: A #InfdFilesystemStorage.
@@ -290,7 +943,11 @@ inf_text_filesystem_format_write_foreach_user_func(InfUser* user,
  * @error: Location to store error information, if any, or %NULL.
  *
  * Reads a text session from @path in @storage. The file is expected to have
- * been saved with inf_text_filesystem_format_write() before. The @user_table
+ * been saved with inf_text_filesystem_format_write() or
+ * inf_text_filesystem_format_write_compact() before. The format of the file
+ * is detected automatically. Files in compact format are memory-mapped, and
+ * the text is not copied into @buffer if @buffer is a #InfTextDefaultBuffer
+ * with UTF-8 encoding. The @user_table
  * parameter should be an empty user table that will be used for the session,
  * and the @buffer parameter should be an empty #InfTextBuffer, and the
  * document will be written into this buffer. If the function succeeds, the
@@ -317,12 +974,53 @@ inf_text_filesystem_format_read(InfdFilesystemStorage* storage,
   xmlNodePtr child;
   gboolean result;
 
+  GBytes* bytes;
+  gconstpointer data;
+  gsize size;
+
   g_return_val_if_fail(INFD_IS_FILESYSTEM_STORAGE(storage), FALSE);
   g_return_val_if_fail(path != NULL, FALSE);
   g_return_val_if_fail(INF_TEXT_IS_BUFFER(buffer), FALSE);
   g_return_val_if_fail(error == NULL || *error == NULL, FALSE);
   g_return_val_if_fail(inf_text_buffer_get_length(buffer) == 0, FALSE);
 
+  full_path = infd_filesystem_storage_get_path(
+    INFD_FILESYSTEM_STORAGE(storage),
+    "InfText",
+    path,
+    error
+  );
+
+  if(full_path == NULL)
+    return FALSE;
+
+  bytes = inf_text_filesystem_format_map_file(full_path, error);
+  g_free(full_path);
+
+  if(bytes == NULL)
+    return FALSE;
+
+  data = g_bytes_get_data(bytes, &size);
+  if(size >= sizeof(INF_TEXT_FILESYSTEM_FORMAT_COMPACT_MAGIC) &&
+     memcmp(data, INF_TEXT_FILESYSTEM_FORMAT_COMPACT_MAGIC,
+            sizeof(INF_TEXT_FILESYSTEM_FORMAT_COMPACT_MAGIC)) == 0)
+  {
+    result = inf_text_filesystem_format_read_compact(
+      bytes,
+      user_table,
+      buffer,
+      error
+    );
+
+    if(result == FALSE)
+      g_prefix_error(error, _("Error processing file \"%s\": "), path);
+
+    g_bytes_unref(bytes);
+    return result;
+  }
+
+  g_bytes_unref(bytes);
+
   /* TODO: Use a SAX parser for better performance */
   full_path = NULL;
   stream = infd_filesystem_storage_open(
@@ -598,4 +1296,309 @@ inf_text_filesystem_format_write(InfdFilesystemStorage* storage,
   return TRUE;
 }
 
+/**
+ * inf_text_filesystem_format_supports_compression:
+ *
+ * Returns whether libinftext was built with support for compressed files
+ * in the compact format. If this returns %FALSE, then
+ * inf_text_filesystem_format_write_compact() fails when compression is
+ * requested, and inf_text_filesystem_format_read() fails for compressed
+ * files.
+ *
+ * Returns: %TRUE if compression is supported, or %FALSE otherwise.
+ */
+gboolean
+inf_text_filesystem_format_supports_compression(void)
+{
+#ifdef LIBINFINITY_HAVE_ZSTD
+  return TRUE;
+#else
+  return FALSE;
+#endif
+}
+
+/**
+ * inf_text_filesystem_format_write_compact:
+ * @storage: A #InfdFilesystemStorage.
+ * @path: Storage path where to write the session to.
+ * @user_table: The #InfUserTable to write.
+ * @buffer: The #InfTextBuffer to write.
+ * @compress: Whether to compress the text of the document.
+ * @error: Location to store error information, if any, or %NULL.
+ *
+ * Writes the given user table and buffer into the filesystem storage at
+ * @path, in the compact binary format. This format is faster to read and
+ * write than the XML format written by inf_text_filesystem_format_write(),
+ * and it allows inf_text_filesystem_format_read() to load the document
+ * without copying its text.
+ *
+ * If @compress is %TRUE, the text is compressed with zstd. This reduces the
+ * file size considerably, but the text needs to be decompressed into
+ * memory when the file is read. Compression is only available if
+ * inf_text_filesystem_format_supports_compression() returns %TRUE.
+ *
+ * If the function fails, %FALSE is returned and @error is set.
+ *
+ * Returns: %TRUE on success or %FALSE on error.
+ */
+gboolean
+inf_text_filesystem_format_write_compact(InfdFilesystemStorage* storage,
+                                         const gchar* path,
+                                         InfUserTable* user_table,
+                                         InfTextBuffer* buffer,
+                                         gboolean compress,
+                                         GError** error)
+{
+  InfTextBufferIter* iter;
+  GByteArray* header;
+  GByteArray* segments;
+  GByteArray* text;
+
+  guint author;
+  gchar* content;
+  gsize bytes;
+  guint chars;
+  gchar* converted;
+  gsize converted_bytes;
+  gpointer compressed;
+  gsize compressed_bytes;
+
+  FILE* stream;
+  gboolean is_utf8;
+  gboolean result;
+  guint64 text_size;
+  guint n_segments;
+  int code;
+
+  InfTextFilesystemFormatCompactWriteData data;
+
+  g_return_val_if_fail(INFD_IS_FILESYSTEM_STORAGE(storage), FALSE);
+  g_return_val_if_fail(path != NULL, FALSE);
+  g_return_val_if_fail(INF_IS_USER_TABLE(user_table), FALSE);
+  g_return_val_if_fail(INF_TEXT_IS_BUFFER(buffer), FALSE);
+  g_return_val_if_fail(error == NULL || *error == NULL, FALSE);
+
+  /* Fail before the existing file is replaced */
+  if(compress && !inf_text_filesystem_format_supports_compression())
+  {
+    inf_text_filesystem_format_compact_set_unsupported_error(error);
+    return FALSE;
+  }
+
+  is_utf8 = TRUE;
+  if(strcmp(inf_text_buffer_get_encoding(buffer), "UTF-8") != 0)
+    is_utf8 = FALSE;
+
+  stream = infd_filesystem_storage_open(
+    INFD_FILESYSTEM_STORAGE(storage),
+    "InfText",
+    path,
+    "w",
+    NULL,
+    error
+  );
+
+  if(stream == NULL)
+    return FALSE;
+
+  header = g_byte_array_new();
+  g_byte_array_append(
+    header,
+    (const guint8*)INF_TEXT_FILESYSTEM_FORMAT_COMPACT_MAGIC,
+    sizeof(INF_TEXT_FILESYSTEM_FORMAT_COMPACT_MAGIC)
+  );
+
+  inf_text_filesystem_format_compact_append_uint32(
+    header,
+    INF_TEXT_FILESYSTEM_FORMAT_COMPACT_VERSION
+  );
+
+  inf_text_filesystem_format_compact_append_uint32(
+    header,
+    compress ? INF_TEXT_FILESYSTEM_FORMAT_COMPACT_FLAG_ZSTD : 0
+  );
+
+  result = inf_text_filesystem_format_compact_write(
+    stream,
+    header->data,
+    header->len,
+    error
+  );
+
+  g_byte_array_free(header, TRUE);
+
+  /* Without compression, the text of all segments is written directly to
+   * the file. With compression, it is collected in memory and compressed
+   * as a whole. The segment table is collected in memory and written
+   * afterwards in either case. */
+  text = NULL;
+  if(compress)
+    text = g_byte_array_new();
+
+  segments = g_byte_array_new();
+  data.users = g_byte_array_new();
+  data.encountered_authors = g_hash_table_new(NULL, NULL);
+  data.n_users = 0;
+  text_size = 0;
+  n_segments = 0;
+
+  iter = NULL;
+  if(result == TRUE)
+    iter = inf_text_buffer_create_begin_iter(buffer);
+
+  if(iter != NULL)
+  {
+    do
+    {
+      author = inf_text_buffer_iter_get_author(buffer, iter);
+      content = inf_text_buffer_iter_get_text(buffer, iter);
+      bytes = inf_text_buffer_iter_get_bytes(buffer, iter);
+      chars = inf_text_buffer_iter_get_length(buffer, iter);
+
+      /* TODO: Use g_hash_table_add with glib 2.32 */
+      g_hash_table_insert(
+        data.encountered_authors,
+        GUINT_TO_POINTER(author),
+        GUINT_TO_POINTER(author)
+      );
+
+      if(!is_utf8)
+      {
+        /* Convert from buffer encoding to UTF-8 for storage */
+        converted = g_convert(
+          content,
+          bytes,
+          "UTF-8",
+          inf_text_buffer_get_encoding(buffer),
+          NULL,
+          &converted_bytes,
+          error
+        );
+
+        g_free(content);
+
+        if(converted == NULL)
+        {
+          result = FALSE;
+          break;
+        }
+
+        content = converted;
+        bytes = converted_bytes;
+      }
+
+      if(text != NULL)
+      {
+        g_byte_array_append(text, (const guint8*)content, bytes);
+      }
+      else
+      {
+        result = inf_text_filesystem_format_compact_write(
+          stream,
+          content,
+          bytes,
+          error
+        );
+      }
+
+      g_free(content);
+      if(result == FALSE)
+        break;
+
+      inf_text_filesystem_format_compact_append_uint32(segments, author);
+      inf_text_filesystem_format_compact_append_uint32(segments, chars);
+      inf_text_filesystem_format_compact_append_uint64(segments, bytes);
+
+      text_size += bytes;
+      ++n_segments;
+    } while(inf_text_buffer_iter_next(buffer, iter));
+
+    inf_text_buffer_destroy_iter(buffer, iter);
+  }
+
+  if(result == TRUE && text != NULL)
+  {
+    compressed = inf_text_filesystem_format_compact_compress(
+      text,
+      &compressed_bytes,
+      error
+    );
+
+    if(compressed == NULL)
+    {
+      result = FALSE;
+    }
+    else
+    {
+      result = inf_text_filesystem_format_compact_write(
+        stream,
+        compressed,
+        compressed_bytes,
+        error
+      );
+
+      text_size = compressed_bytes;
+      g_free(compressed);
+    }
+  }
+
+  if(result == TRUE)
+  {
+    /* Only write users that have contributed to the document, as for the
+     * XML format. */
+    inf_user_table_foreach_user(
+      user_table,
+      inf_text_filesystem_format_write_compact_foreach_user_func,
+      &data
+    );
+
+    inf_text_filesystem_format_compact_append_uint64(data.users, text_size);
+    inf_text_filesystem_format_compact_append_uint32(data.users, n_segments);
+    inf_text_filesystem_format_compact_append_uint32(
+      data.users,
+      data.n_users
+    );
+
+    result = inf_text_filesystem_format_compact_write(
+      stream,
+      segments->data,
+      segments->len,
+      error
+    );
+  }
+
+  if(result == TRUE)
+  {
+    result = inf_text_filesystem_format_compact_write(
+      stream,
+      data.users->data,
+      data.users->len,
+      error
+    );
+  }
+
+  if(text != NULL)
+    g_byte_array_free(text, TRUE);
+
+  g_hash_table_destroy(data.encountered_authors);
+  g_byte_array_free(data.users, TRUE);
+  g_byte_array_free(segments, TRUE);
+
+  if(infd_filesystem_storage_stream_close(stream) != 0 && result == TRUE)
+  {
+    code = errno;
+
+    g_set_error_literal(
+      error,
+      G_FILE_ERROR,
+      g_file_error_from_errno(code),
+      g_strerror(code)
+    );
+
+    result = FALSE;
+  }
+
+  return result;
+}
+
 /* vim:set et sw=2 ts=2: */
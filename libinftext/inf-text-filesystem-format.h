@@ -35,6 +35,12 @@ G_BEGIN_DECLS
  * session contains users with duplicate ID or duplicate name.
  * @INF_TEXT_FILESYSTEM_FORMAT_ERROR_NO_SUCH_USER: A segment of the text
  * document is written by a user which does not exist.
+ * @INF_TEXT_FILESYSTEM_FORMAT_ERROR_INVALID_FORMAT: A file in compact format
+ * is truncated or otherwise corrupted.
+ * @INF_TEXT_FILESYSTEM_FORMAT_ERROR_UNSUPPORTED_VERSION: A file in compact
+ * format was written with a version of the format that is not supported.
+ * @INF_TEXT_FILESYSTEM_FORMAT_ERROR_COMPRESSION_UNSUPPORTED: A compressed
+ * file was to be read or written, but compression is not supported.
  *
  * Errors that can occur when reading a #InfTextSession from a
  * #InfdFilesystemStorage.
@@ -42,7 +48,10 @@ G_BEGIN_DECLS
 typedef enum _InfTextFilesystemFormatError {
   INF_TEXT_FILESYSTEM_FORMAT_ERROR_NOT_A_TEXT_SESSION,
   INF_TEXT_FILESYSTEM_FORMAT_ERROR_USER_EXISTS,
-  INF_TEXT_FILESYSTEM_FORMAT_ERROR_NO_SUCH_USER
+  INF_TEXT_FILESYSTEM_FORMAT_ERROR_NO_SUCH_USER,
+  INF_TEXT_FILESYSTEM_FORMAT_ERROR_INVALID_FORMAT,
+  INF_TEXT_FILESYSTEM_FORMAT_ERROR_UNSUPPORTED_VERSION,
+  INF_TEXT_FILESYSTEM_FORMAT_ERROR_COMPRESSION_UNSUPPORTED
 } InfTextFilesystemFormatError;
 
 gboolean
@@ -59,6 +68,17 @@ inf_text_filesystem_format_write(InfdFilesystemStorage* storage,
                                  InfTextBuffer* buffer,
                                  GError** error);
 
+gboolean
+inf_text_filesystem_format_supports_compression(void);
+
+gboolean
+inf_text_filesystem_format_write_compact(InfdFilesystemStorage* storage,
+                                         const gchar* path,
+                                         InfUserTable* user_table,
+                                         InfTextBuffer* buffer,
+                                         gboolean compress,
+                                         GError** error);
+
 G_END_DECLS
 
 #endif /* __INF_TEXT_FILESYSTEM_FORMAT_H__ */
@@ -0,0 +1,1058 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/**
+ * SECTION:inf-text-filesystem-journal
+ * @title: Append-only journal for text sessions
+ * @short_description: Incremental storage of changes to a text document
+ * @include: libinftext/inf-text-filesystem-journal.h
+ * @see_also: #InfdFilesystemStorage, inf_text_filesystem_format_write()
+ * @stability: Unstable
+ *
+ * An #InfTextFilesystemJournal records all changes made to a
+ * #InfTextBuffer in a journal file next to the document in a
+ * #InfdFilesystemStorage. Instead of rewriting the whole document after
+ * every change, only the changes are appended to the journal, and the
+ * document itself only needs to be written from time to time, after which
+ * the journal is reset with inf_text_filesystem_journal_reset().
+ *
+ * Records are collected in memory and written to disk in batches with
+ * inf_text_filesystem_journal_flush(), which also makes sure the data
+ * reaches the disk. When the document is loaded again, for example after
+ * a crash, inf_text_filesystem_journal_replay() applies the changes from
+ * the journal to the document read from the storage.
+ *
+ * The journal stores a digest of the document file it is based on, so
+ * that a journal is only replayed on top of the exact document version it
+ * was started for. A journal that is left over from an earlier version of
+ * the document is ignored.
+ */
+
+#include <libinftext/inf-text-filesystem-journal.h>
+#include <libinftext/inf-text-user.h>
+#include <libinfinity/inf-signals.h>
+#include <libinfinity/inf-i18n.h>
+
+#include <string.h>
+#include <errno.h>
+
+#ifndef G_OS_WIN32
+# include <unistd.h>
+#endif
+
+struct _InfTextFilesystemJournal {
+  InfdFilesystemStorage* storage;
+  gchar* path;
+  InfUserTable* user_table;
+  InfTextBuffer* buffer;
+
+  FILE* stream;
+  GByteArray* pending;
+  guint64 written;
+
+  /* Set when records could not be written. The journal file then no longer
+   * matches the document, and no further records are written until the
+   * document has been saved and the journal was reset. */
+  gboolean incomplete;
+
+  /* Authors for which a user record has been written since the last
+   * reset of the journal */
+  GHashTable* recorded_users;
+};
+
+typedef enum _InfTextFilesystemJournalRecordType {
+  INF_TEXT_FILESYSTEM_JOURNAL_RECORD_INSERT = 1,
+  INF_TEXT_FILESYSTEM_JOURNAL_RECORD_ERASE = 2,
+  INF_TEXT_FILESYSTEM_JOURNAL_RECORD_USER = 3
+} InfTextFilesystemJournalRecordType;
+
+typedef struct _InfTextFilesystemJournalReader {
+  const guchar* data;
+  gsize size;
+  gsize pos;
+} InfTextFilesystemJournalReader;
+
+/* The journal starts with a header consisting of the magic bytes, a 32 bit
+ * version number, 32 bits reserved for flags, and the MD5 digest of the
+ * document file the journal is based on. Each record starts with a one
+ * byte record type. Insertions store 32 bit position, author, number of
+ * characters and number of bytes, followed by the inserted text in UTF-8.
+ * Erasures store 32 bit position and number of characters. User records
+ * store the 32 bit user ID, the 64 bit IEEE 754 representation of the hue,
+ * the 32 bit length of the name and the name itself. All integers are
+ * stored in little endian byte order. */
+static const gchar INF_TEXT_FILESYSTEM_JOURNAL_MAGIC[8] =
+  { '\211', 'I', 'n', 'f', 'J', 'r', 'n', 'l' };
+static const guint32 INF_TEXT_FILESYSTEM_JOURNAL_VERSION = 1;
+static const gsize INF_TEXT_FILESYSTEM_JOURNAL_DIGEST_SIZE = 16;
+static const gsize INF_TEXT_FILESYSTEM_JOURNAL_HEADER_SIZE = 32;
+
+static GQuark
+inf_text_filesystem_journal_error_quark(void)
+{
+  return g_quark_from_static_string("INF_TEXT_FILESYSTEM_JOURNAL_ERROR");
+}
+
+static void
+inf_text_filesystem_journal_system_error(int code,
+                                         GError** error)
+{
+  g_set_error_literal(
+    error,
+    G_FILE_ERROR,
+    g_file_error_from_errno(code),
+    g_strerror(code)
+  );
+}
+
+static void
+inf_text_filesystem_journal_append_uint32(GByteArray* array,
+                                          guint32 value)
+{
+  guint32 le;
+  le = GUINT32_TO_LE(value);
+  g_byte_array_append(array, (const guint8*)&le, sizeof(le));
+}
+
+static void
+inf_text_filesystem_journal_append_uint64(GByteArray* array,
+                                          guint64 value)
+{
+  guint64 le;
+  le = GUINT64_TO_LE(value);
+  g_byte_array_append(array, (const guint8*)&le, sizeof(le));
+}
+
+static void
+inf_text_filesystem_journal_append_type(GByteArray* array,
+                                        InfTextFilesystemJournalRecordType t)
+{
+  guint8 type;
+  type = t;
+  g_byte_array_append(array, &type, 1);
+}
+
+static gboolean
+inf_text_filesystem_journal_read_uint8(InfTextFilesystemJournalReader* reader,
+                                       guint8* value)
+{
+  if(reader->size - reader->pos < 1)
+    return FALSE;
+
+  *value = reader->data[reader->pos];
+  ++reader->pos;
+  return TRUE;
+}
+
+static gboolean
+inf_text_filesystem_journal_read_uint32(InfTextFilesystemJournalReader* reader,
+                                        guint32* value)
+{
+  guint32 le;
+
+  if(reader->size - reader->pos < sizeof(le))
+    return FALSE;
+
+  memcpy(&le, reader->data + reader->pos, sizeof(le));
+  reader->pos += sizeof(le);
+
+  *value = GUINT32_FROM_LE(le);
+  return TRUE;
+}
+
+static gboolean
+inf_text_filesystem_journal_read_uint64(InfTextFilesystemJournalReader* reader,
+                                        guint64* value)
+{
+  guint64 le;
+
+  if(reader->size - reader->pos < sizeof(le))
+    return FALSE;
+
+  memcpy(&le, reader->data + reader->pos, sizeof(le));
+  reader->pos += sizeof(le);
+
+  *value = GUINT64_FROM_LE(le);
+  return TRUE;
+}
+
+static gboolean
+inf_text_filesystem_journal_read_data(InfTextFilesystemJournalReader* reader,
+                                      gsize len,
+                                      const guchar** data)
+{
+  if(reader->size - reader->pos < len)
+    return FALSE;
+
+  *data = reader->data + reader->pos;
+  reader->pos += len;
+  return TRUE;
+}
+
+/* Computes the digest of the document file at path. If the file does not
+ * exist, the digest is all zeros. */
+static gboolean
+inf_text_filesystem_journal_compute_digest(InfdFilesystemStorage* storage,
+                                           const gchar* path,
+                                           guint8* digest,
+                                           GError** error)
+{
+  gchar* full_path;
+  GMappedFile* mapped_file;
+  GChecksum* checksum;
+  GError* local_error;
+  gsize digest_len;
+
+  full_path = infd_filesystem_storage_get_path(
+    storage,
+    "InfText",
+    path,
+    error
+  );
+
+  if(full_path == NULL)
+    return FALSE;
+
+  local_error = NULL;
+  mapped_file = g_mapped_file_new(full_path, FALSE, &local_error);
+  g_free(full_path);
+
+  if(mapped_file == NULL)
+  {
+    if(local_error->domain == G_FILE_ERROR &&
+       local_error->code == G_FILE_ERROR_NOENT)
+    {
+      g_error_free(local_error);
+      memset(digest, 0, INF_TEXT_FILESYSTEM_JOURNAL_DIGEST_SIZE);
+      return TRUE;
+    }
+
+    g_propagate_error(error, local_error);
+    return FALSE;
+  }
+
+  checksum = g_checksum_new(G_CHECKSUM_MD5);
+  g_checksum_update(
+    checksum,
+    (const guchar*)g_mapped_file_get_contents(mapped_file),
+    (gssize)g_mapped_file_get_length(mapped_file)
+  );
+
+  digest_len = INF_TEXT_FILESYSTEM_JOURNAL_DIGEST_SIZE;
+  g_checksum_get_digest(checksum, digest, &digest_len);
+  g_assert(digest_len == INF_TEXT_FILESYSTEM_JOURNAL_DIGEST_SIZE);
+
+  g_checksum_free(checksum);
+  g_mapped_file_unref(mapped_file);
+  return TRUE;
+}
+
+static gboolean
+inf_text_filesystem_journal_open_stream(InfTextFilesystemJournal* journal,
+                                        GError** error)
+{
+  guint8 digest[16];
+  FILE* stream;
+  GByteArray* header;
+  gsize written;
+  int code;
+
+  g_assert(journal->stream == NULL);
+
+  if(!inf_text_filesystem_journal_compute_digest(journal->storage,
+                                                 journal->path,
+                                                 digest,
+                                                 error))
+  {
+    return FALSE;
+  }
+
+  /* Write the header to a new file which replaces the previous journal
+   * as a whole, so that a crash never leaves a journal behind that does
+   * not match the document. Records are then appended to it. */
+  stream = infd_filesystem_storage_open(
+    journal->storage,
+    "journal",
+    journal->path,
+    "w",
+    NULL,
+    error
+  );
+
+  if(stream == NULL)
+    return FALSE;
+
+  header = g_byte_array_new();
+  g_byte_array_append(
+    header,
+    (const guint8*)INF_TEXT_FILESYSTEM_JOURNAL_MAGIC,
+    sizeof(INF_TEXT_FILESYSTEM_JOURNAL_MAGIC)
+  );
+
+  inf_text_filesystem_journal_append_uint32(
+    header,
+    INF_TEXT_FILESYSTEM_JOURNAL_VERSION
+  );
+
+  inf_text_filesystem_journal_append_uint32(header, 0);
+  g_byte_array_append(header, digest, sizeof(digest));
+  g_assert(header->len == INF_TEXT_FILESYSTEM_JOURNAL_HEADER_SIZE);
+
+  written = infd_filesystem_storage_stream_write(
+    stream,
+    header->data,
+    header->len
+  );
+
+  g_byte_array_free(header, TRUE);
+
+  if(written != INF_TEXT_FILESYSTEM_JOURNAL_HEADER_SIZE)
+  {
+    code = errno;
+    infd_filesystem_storage_stream_close(stream);
+
+    inf_text_filesystem_journal_system_error(code, error);
+    return FALSE;
+  }
+
+  if(infd_filesystem_storage_stream_close(stream) != 0)
+  {
+    inf_text_filesystem_journal_system_error(errno, error);
+    return FALSE;
+  }
+
+  journal->stream = infd_filesystem_storage_open(
+    journal->storage,
+    "journal",
+    journal->path,
+    "a",
+    NULL,
+    error
+  );
+
+  if(journal->stream == NULL)
+    return FALSE;
+
+  journal->written = INF_TEXT_FILESYSTEM_JOURNAL_HEADER_SIZE;
+  g_byte_array_set_size(journal->pending, 0);
+  g_hash_table_remove_all(journal->recorded_users);
+  return TRUE;
+}
+
+static void
+inf_text_filesystem_journal_record_user(InfTextFilesystemJournal* journal,
+                                        guint author)
+{
+  InfUser* user;
+  const gchar* name;
+  gdouble hue;
+  guint64 hue_bits;
+
+  if(author == 0)
+    return;
+
+  if(g_hash_table_contains(journal->recorded_users,
+                           GUINT_TO_POINTER(author)))
+  {
+    return;
+  }
+
+  user = inf_user_table_lookup_user_by_id(journal->user_table, author);
+  if(user == NULL || !INF_TEXT_IS_USER(user))
+    return;
+
+  name = inf_user_get_name(user);
+  hue = inf_text_user_get_hue(INF_TEXT_USER(user));
+  memcpy(&hue_bits, &hue, sizeof(hue_bits));
+
+  inf_text_filesystem_journal_append_type(
+    journal->pending,
+    INF_TEXT_FILESYSTEM_JOURNAL_RECORD_USER
+  );
+
+  inf_text_filesystem_journal_append_uint32(journal->pending, author);
+  inf_text_filesystem_journal_append_uint64(journal->pending, hue_bits);
+  inf_text_filesystem_journal_append_uint32(journal->pending, strlen(name));
+  g_byte_array_append(journal->pending, (const guint8*)name, strlen(name));
+
+  g_hash_table_insert(
+    journal->recorded_users,
+    GUINT_TO_POINTER(author),
+    GUINT_TO_POINTER(author)
+  );
+}
+
+static void
+inf_text_filesystem_journal_text_inserted_cb(InfTextBuffer* buffer,
+                                             guint pos,
+                                             InfTextChunk* chunk,
+                                             InfUser* user,
+                                             gpointer user_data)
+{
+  InfTextFilesystemJournal* journal;
+  InfTextChunkIter iter;
+  gboolean has_segment;
+  guint author;
+  guint length;
+  gsize bytes;
+
+  journal = (InfTextFilesystemJournal*)user_data;
+  if(journal->incomplete == TRUE)
+    return;
+
+  has_segment = inf_text_chunk_iter_init_begin(chunk, &iter);
+  while(has_segment)
+  {
+    author = inf_text_chunk_iter_get_author(&iter);
+    length = inf_text_chunk_iter_get_length(&iter);
+    bytes = inf_text_chunk_iter_get_bytes(&iter);
+
+    inf_text_filesystem_journal_record_user(journal, author);
+
+    inf_text_filesystem_journal_append_type(
+      journal->pending,
+      INF_TEXT_FILESYSTEM_JOURNAL_RECORD_INSERT
+    );
+
+    inf_text_filesystem_journal_append_uint32(journal->pending, pos);
+    inf_text_filesystem_journal_append_uint32(journal->pending, author);
+    inf_text_filesystem_journal_append_uint32(journal->pending, length);
+    inf_text_filesystem_journal_append_uint32(journal->pending, bytes);
+
+    g_byte_array_append(
+      journal->pending,
+      inf_text_chunk_iter_get_text(&iter),
+      bytes
+    );
+
+    pos += length;
+    has_segment = inf_text_chunk_iter_next(&iter);
+  }
+}
+
+static void
+inf_text_filesystem_journal_text_erased_cb(InfTextBuffer* buffer,
+                                           guint pos,
+                                           InfTextChunk* chunk,
+                                           InfUser* user,
+                                           gpointer user_data)
+{
+  InfTextFilesystemJournal* journal;
+  journal = (InfTextFilesystemJournal*)user_data;
+
+  if(journal->incomplete == TRUE)
+    return;
+
+  inf_text_filesystem_journal_append_type(
+    journal->pending,
+    INF_TEXT_FILESYSTEM_JOURNAL_RECORD_ERASE
+  );
+
+  inf_text_filesystem_journal_append_uint32(journal->pending, pos);
+  inf_text_filesystem_journal_append_uint32(
+    journal->pending,
+    inf_text_chunk_get_length(chunk)
+  );
+}
+
+static void
+inf_text_filesystem_journal_set_invalid_error(gsize offset,
+                                              GError** error)
+{
+  g_set_error(
+    error,
+    inf_text_filesystem_journal_error_quark(),
+    INF_TEXT_FILESYSTEM_JOURNAL_ERROR_INVALID_RECORD,
+    _("Invalid journal record at offset %lu"),
+    (unsigned long)offset
+  );
+}
+
+static gboolean
+inf_text_filesystem_journal_replay_user(InfTextFilesystemJournalReader* r,
+                                        InfUserTable* user_table,
+                                        GError** error)
+{
+  guint32 id;
+  guint64 hue_bits;
+  guint32 name_len;
+  const guchar* name_data;
+  gdouble hue;
+  gchar* name;
+  InfUser* user;
+
+  if(!inf_text_filesystem_journal_read_uint32(r, &id) ||
+     !inf_text_filesystem_journal_read_uint64(r, &hue_bits) ||
+     !inf_text_filesystem_journal_read_uint32(r, &name_len) ||
+     !inf_text_filesystem_journal_read_data(r, name_len, &name_data))
+  {
+    /* Incomplete record at the end of the journal */
+    r->pos = r->size;
+    return TRUE;
+  }
+
+  if(id == 0 || !g_utf8_validate((const gchar*)name_data, name_len, NULL))
+  {
+    inf_text_filesystem_journal_set_invalid_error(r->pos, error);
+    return FALSE;
+  }
+
+  /* The user might be part of the document already */
+  if(inf_user_table_lookup_user_by_id(user_table, id) != NULL)
+    return TRUE;
+
+  name = g_strndup((const gchar*)name_data, name_len);
+  if(inf_user_table_lookup_user_by_name(user_table, name) != NULL)
+  {
+    g_free(name);
+    inf_text_filesystem_journal_set_invalid_error(r->pos, error);
+    return FALSE;
+  }
+
+  memcpy(&hue, &hue_bits, sizeof(hue));
+
+  user = INF_USER(
+    g_object_new(
+      INF_TEXT_TYPE_USER,
+      "id", id,
+      "name", name,
+      "hue", hue,
+      NULL
+    )
+  );
+
+  inf_user_table_add_user(user_table, user);
+  g_object_unref(user);
+  g_free(name);
+  return TRUE;
+}
+
+static gboolean
+inf_text_filesystem_journal_replay_insert(InfTextFilesystemJournalReader* r,
+                                          InfUserTable* user_table,
+                                          InfTextBuffer* buffer,
+                                          GError** error)
+{
+  guint32 pos;
+  guint32 author;
+  guint32 length;
+  guint32 bytes;
+  const guchar* text;
+  InfUser* user;
+
+  if(!inf_text_filesystem_journal_read_uint32(r, &pos) ||
+     !inf_text_filesystem_journal_read_uint32(r, &author) ||
+     !inf_text_filesystem_journal_read_uint32(r, &length) ||
+     !inf_text_filesystem_journal_read_uint32(r, &bytes) ||
+     !inf_text_filesystem_journal_read_data(r, bytes, &text))
+  {
+    r->pos = r->size;
+    return TRUE;
+  }
+
+  user = NULL;
+  if(author != 0)
+    user = inf_user_table_lookup_user_by_id(user_table, author);
+
+  if(pos > inf_text_buffer_get_length(buffer) ||
+     (author != 0 && user == NULL) ||
+     !g_utf8_validate((const gchar*)text, bytes, NULL) ||
+     g_utf8_strlen((const gchar*)text, bytes) != (glong)length)
+  {
+    inf_text_filesystem_journal_set_invalid_error(r->pos, error);
+    return FALSE;
+  }
+
+  if(length > 0)
+    inf_text_buffer_insert_text(buffer, pos, text, bytes, length, user);
+
+  return TRUE;
+}
+
+static gboolean
+inf_text_filesystem_journal_replay_erase(InfTextFilesystemJournalReader* r,
+                                         InfTextBuffer* buffer,
+                                         GError** error)
+{
+  guint32 pos;
+  guint32 length;
+
+  if(!inf_text_filesystem_journal_read_uint32(r, &pos) ||
+     !inf_text_filesystem_journal_read_uint32(r, &length))
+  {
+    r->pos = r->size;
+    return TRUE;
+  }
+
+  if(pos > inf_text_buffer_get_length(buffer) ||
+     length > inf_text_buffer_get_length(buffer) - pos)
+  {
+    inf_text_filesystem_journal_set_invalid_error(r->pos, error);
+    return FALSE;
+  }
+
+  if(length > 0)
+    inf_text_buffer_erase_text(buffer, pos, length, NULL);
+
+  return TRUE;
+}
+
+/**
+ * inf_text_filesystem_journal_new: (skip)
+ * @storage: A #InfdFilesystemStorage.
+ * @path: Storage path of the document to journal.
+ * @user_table: The user table of the document.
+ * @buffer: The buffer of the document. Its encoding must be UTF-8.
+ * @error: Location to store error information, if any, or %NULL.
+ *
+ * Starts a new journal for the document at @path in @storage. The
+ * document stored at @path must correspond to the current content of
+ * @buffer. Any existing journal for the document is discarded. From now
+ * on, all changes to @buffer are recorded in the journal.
+ *
+ * Returns: (transfer full): A new #InfTextFilesystemJournal, or %NULL on
+ * error. Free with inf_text_filesystem_journal_free().
+ */
+InfTextFilesystemJournal*
+inf_text_filesystem_journal_new(InfdFilesystemStorage* storage,
+                                const gchar* path,
+                                InfUserTable* user_table,
+                                InfTextBuffer* buffer,
+                                GError** error)
+{
+  InfTextFilesystemJournal* journal;
+
+  g_return_val_if_fail(INFD_IS_FILESYSTEM_STORAGE(storage), NULL);
+  g_return_val_if_fail(path != NULL, NULL);
+  g_return_val_if_fail(INF_IS_USER_TABLE(user_table), NULL);
+  g_return_val_if_fail(INF_TEXT_IS_BUFFER(buffer), NULL);
+  g_return_val_if_fail(error == NULL || *error == NULL, NULL);
+
+  g_return_val_if_fail(
+    strcmp(inf_text_buffer_get_encoding(buffer), "UTF-8") == 0,
+    NULL
+  );
+
+  journal = g_slice_new(InfTextFilesystemJournal);
+  journal->storage = storage;
+  journal->path = g_strdup(path);
+  journal->user_table = user_table;
+  journal->buffer = buffer;
+  journal->stream = NULL;
+  journal->pending = g_byte_array_new();
+  journal->written = 0;
+  journal->incomplete = FALSE;
+  journal->recorded_users = g_hash_table_new(NULL, NULL);
+
+  g_object_ref(storage);
+  g_object_ref(user_table);
+  g_object_ref(buffer);
+
+  if(!inf_text_filesystem_journal_open_stream(journal, error))
+  {
+    inf_text_filesystem_journal_free(journal);
+    return NULL;
+  }
+
+  g_signal_connect_after(
+    G_OBJECT(buffer),
+    "text-inserted",
+    G_CALLBACK(inf_text_filesystem_journal_text_inserted_cb),
+    journal
+  );
+
+  g_signal_connect_after(
+    G_OBJECT(buffer),
+    "text-erased",
+    G_CALLBACK(inf_text_filesystem_journal_text_erased_cb),
+    journal
+  );
+
+  return journal;
+}
+
+/**
+ * inf_text_filesystem_journal_free:
+ * @journal: A #InfTextFilesystemJournal.
+ *
+ * Stops recording changes and releases all resources of @journal. Pending
+ * records are written to the journal file before it is closed, but errors
+ * are ignored. Call inf_text_filesystem_journal_flush() before if you need
+ * to know whether all records were written.
+ */
+void
+inf_text_filesystem_journal_free(InfTextFilesystemJournal* journal)
+{
+  g_return_if_fail(journal != NULL);
+
+  inf_signal_handlers_disconnect_by_func(
+    G_OBJECT(journal->buffer),
+    G_CALLBACK(inf_text_filesystem_journal_text_inserted_cb),
+    journal
+  );
+
+  inf_signal_handlers_disconnect_by_func(
+    G_OBJECT(journal->buffer),
+    G_CALLBACK(inf_text_filesystem_journal_text_erased_cb),
+    journal
+  );
+
+  if(journal->stream != NULL)
+  {
+    inf_text_filesystem_journal_flush(journal, NULL);
+    infd_filesystem_storage_stream_close(journal->stream);
+  }
+
+  g_hash_table_destroy(journal->recorded_users);
+  g_byte_array_free(journal->pending, TRUE);
+
+  g_object_unref(journal->buffer);
+  g_object_unref(journal->user_table);
+  g_object_unref(journal->storage);
+  g_free(journal->path);
+
+  g_slice_free(InfTextFilesystemJournal, journal);
+}
+
+/**
+ * inf_text_filesystem_journal_flush:
+ * @journal: A #InfTextFilesystemJournal.
+ * @error: Location to store error information, if any, or %NULL.
+ *
+ * Writes all records collected since the last flush to the journal file,
+ * and waits until they have been written to disk. Changes to the document
+ * are only safe from a crash once they have been flushed, but since
+ * flushing is expensive, it should not be done after every change but in
+ * regular intervals.
+ *
+ * If the records cannot be written, it is unknown which part of them made
+ * it into the journal file, so they cannot simply be written again. In
+ * that case the journal stops recording changes, and this function fails
+ * with %INF_TEXT_FILESYSTEM_JOURNAL_ERROR_INCOMPLETE until the document
+ * has been saved and inf_text_filesystem_journal_reset() was called.
+ *
+ * Returns: %TRUE on success or %FALSE on error.
+ */
+gboolean
+inf_text_filesystem_journal_flush(InfTextFilesystemJournal* journal,
+                                  GError** error)
+{
+  gsize written;
+  int code;
+
+  g_return_val_if_fail(journal != NULL, FALSE);
+  g_return_val_if_fail(error == NULL || *error == NULL, FALSE);
+
+  if(journal->incomplete == TRUE)
+  {
+    g_set_error_literal(
+      error,
+      inf_text_filesystem_journal_error_quark(),
+      INF_TEXT_FILESYSTEM_JOURNAL_ERROR_INCOMPLETE,
+      _("The journal is incomplete since a previous write failed, the "
+        "document needs to be saved")
+    );
+
+    return FALSE;
+  }
+
+  /* The stream is only unset if a previous reset failed; try again */
+  if(journal->stream == NULL)
+    return inf_text_filesystem_journal_open_stream(journal, error);
+
+  if(journal->pending->len == 0)
+    return TRUE;
+
+  written = infd_filesystem_storage_stream_write(
+    journal->stream,
+    journal->pending->data,
+    journal->pending->len
+  );
+
+  code = 0;
+  if(written != journal->pending->len || fflush(journal->stream) != 0)
+    code = errno;
+#ifndef G_OS_WIN32
+  else if(fsync(fileno(journal->stream)) == -1)
+    code = errno;
+#endif
+
+  if(code != 0)
+  {
+    /* A prefix of the records might have reached the file. Writing all of
+     * them again would duplicate that prefix, so stop journaling instead.
+     * The records that did make it are a consistent prefix of the changes,
+     * and the file can still be replayed. */
+    infd_filesystem_storage_stream_close(journal->stream);
+    journal->stream = NULL;
+    journal->incomplete = TRUE;
+    g_byte_array_set_size(journal->pending, 0);
+
+    inf_text_filesystem_journal_system_error(code, error);
+    return FALSE;
+  }
+
+  journal->written += written;
+  g_byte_array_set_size(journal->pending, 0);
+  return TRUE;
+}
+
+/**
+ * inf_text_filesystem_journal_reset:
+ * @journal: A #InfTextFilesystemJournal.
+ * @error: Location to store error information, if any, or %NULL.
+ *
+ * Discards all records in @journal and starts a new, empty journal. This
+ * function should be called after the document has been written to the
+ * storage, because from then on the changes recorded so far are part of
+ * the stored document.
+ *
+ * Returns: %TRUE on success or %FALSE on error.
+ */
+gboolean
+inf_text_filesystem_journal_reset(InfTextFilesystemJournal* journal,
+                                  GError** error)
+{
+  g_return_val_if_fail(journal != NULL, FALSE);
+  g_return_val_if_fail(error == NULL || *error == NULL, FALSE);
+
+  if(journal->stream != NULL)
+  {
+    infd_filesystem_storage_stream_close(journal->stream);
+    journal->stream = NULL;
+  }
+
+  /* Everything recorded so far is part of the stored document now */
+  g_byte_array_set_size(journal->pending, 0);
+  journal->incomplete = FALSE;
+
+  return inf_text_filesystem_journal_open_stream(journal, error);
+}
+
+/**
+ * inf_text_filesystem_journal_get_size:
+ * @journal: A #InfTextFilesystemJournal.
+ *
+ * Returns the size of the journal in bytes, including records that have
+ * not yet been flushed. This can be used to decide when to write the full
+ * document and reset the journal.
+ *
+ * Returns: The size of the journal.
+ */
+guint64
+inf_text_filesystem_journal_get_size(InfTextFilesystemJournal* journal)
+{
+  g_return_val_if_fail(journal != NULL, 0);
+  return journal->written + journal->pending->len;
+}
+
+/**
+ * inf_text_filesystem_journal_replay:
+ * @storage: A #InfdFilesystemStorage.
+ * @path: Storage path of the document.
+ * @user_table: The user table read from the storage.
+ * @buffer: The buffer read from the storage.
+ * @n_records: (out) (allow-none): Location to store the number of applied
+ * records, or %NULL.
+ * @error: Location to store error information, if any, or %NULL.
+ *
+ * Applies the journal for the document at @path to @user_table and
+ * @buffer, which should have been read with
+ * inf_text_filesystem_format_read() before. If there is no journal, or if
+ * the journal was started for a different version of the document, then
+ * nothing is done. An incomplete record at the end of the journal, as it
+ * can be left behind by a crash, is ignored. Replay also stops at the
+ * first record that cannot be applied, such as garbage at the end of the
+ * file after a crash, since none of the following records can be
+ * interpreted reliably. A warning is emitted in that case, and the records
+ * before it remain applied.
+ *
+ * If records have been applied, the caller should write the document to
+ * the storage before starting a new journal with
+ * inf_text_filesystem_journal_new(), since that discards the records.
+ *
+ * Returns: %TRUE on success or %FALSE on error.
+ */
+gboolean
+inf_text_filesystem_journal_replay(InfdFilesystemStorage* storage,
+                                   const gchar* path,
+                                   InfUserTable* user_table,
+                                   InfTextBuffer* buffer,
+                                   guint* n_records,
+                                   GError** error)
+{
+  InfTextFilesystemJournalReader reader;
+  GMappedFile* mapped_file;
+  GError* local_error;
+  gchar* full_path;
+  guint8 digest[16];
+  guint32 version;
+  guint8 type;
+  gboolean result;
+  guint count;
+
+  g_return_val_if_fail(INFD_IS_FILESYSTEM_STORAGE(storage), FALSE);
+  g_return_val_if_fail(path != NULL, FALSE);
+  g_return_val_if_fail(INF_IS_USER_TABLE(user_table), FALSE);
+  g_return_val_if_fail(INF_TEXT_IS_BUFFER(buffer), FALSE);
+  g_return_val_if_fail(error == NULL || *error == NULL, FALSE);
+
+  g_return_val_if_fail(
+    strcmp(inf_text_buffer_get_encoding(buffer), "UTF-8") == 0,
+    FALSE
+  );
+
+  if(n_records != NULL)
+    *n_records = 0;
+
+  full_path = infd_filesystem_storage_get_path(
+    storage,
+    "journal",
+    path,
+    error
+  );
+
+  if(full_path == NULL)
+    return FALSE;
+
+  local_error = NULL;
+  mapped_file = g_mapped_file_new(full_path, FALSE, &local_error);
+  g_free(full_path);
+
+  if(mapped_file == NULL)
+  {
+    if(local_error->domain == G_FILE_ERROR &&
+       local_error->code == G_FILE_ERROR_NOENT)
+    {
+      g_error_free(local_error);
+      return TRUE;
+    }
+
+    g_propagate_error(error, local_error);
+    return FALSE;
+  }
+
+  reader.data = (const guchar*)g_mapped_file_get_contents(mapped_file);
+  reader.size = g_mapped_file_get_length(mapped_file);
+  reader.pos = sizeof(INF_TEXT_FILESYSTEM_JOURNAL_MAGIC);
+
+  /* A journal without a complete header was never used */
+  if(reader.size < INF_TEXT_FILESYSTEM_JOURNAL_HEADER_SIZE)
+  {
+    g_mapped_file_unref(mapped_file);
+    return TRUE;
+  }
+
+  inf_text_filesystem_journal_read_uint32(&reader, &version);
+
+  if(memcmp(reader.data, INF_TEXT_FILESYSTEM_JOURNAL_MAGIC,
+            sizeof(INF_TEXT_FILESYSTEM_JOURNAL_MAGIC)) != 0 ||
+     version != INF_TEXT_FILESYSTEM_JOURNAL_VERSION)
+  {
+    g_mapped_file_unref(mapped_file);
+    inf_text_filesystem_journal_set_invalid_error(0, error);
+    return FALSE;
+  }
+
+  if(!inf_text_filesystem_journal_compute_digest(storage, path, digest,
+                                                 error))
+  {
+    g_mapped_file_unref(mapped_file);
+    return FALSE;
+  }
+
+  /* Skip flags, and ignore journals for other versions of the document */
+  reader.pos += 4;
+  if(memcmp(reader.data + reader.pos, digest, sizeof(digest)) != 0)
+  {
+    g_mapped_file_unref(mapped_file);
+    return TRUE;
+  }
+
+  reader.pos = INF_TEXT_FILESYSTEM_JOURNAL_HEADER_SIZE;
+  local_error = NULL;
+  result = TRUE;
+  count = 0;
+
+  while(result == TRUE &&
+        inf_text_filesystem_journal_read_uint8(&reader, &type))
+  {
+    switch(type)
+    {
+    case INF_TEXT_FILESYSTEM_JOURNAL_RECORD_INSERT:
+      result = inf_text_filesystem_journal_replay_insert(
+        &reader,
+        user_table,
+        buffer,
+        &local_error
+      );
+
+      break;
+    case INF_TEXT_FILESYSTEM_JOURNAL_RECORD_ERASE:
+      result = inf_text_filesystem_journal_replay_erase(
+        &reader,
+        buffer,
+        &local_error
+      );
+
+      break;
+    case INF_TEXT_FILESYSTEM_JOURNAL_RECORD_USER:
+      result = inf_text_filesystem_journal_replay_user(
+        &reader,
+        user_table,
+        &local_error
+      );
+
+      break;
+    default:
+      inf_text_filesystem_journal_set_invalid_error(
+        reader.pos - 1,
+        &local_error
+      );
+
+      result = FALSE;
+      break;
+    }
+
+    if(result == TRUE)
+      ++count;
+  }
+
+  g_mapped_file_unref(mapped_file);
+
+  if(result == FALSE)
+  {
+    g_warning(
+      _("Ignoring the rest of the journal for document \"%s\" after %u "
+        "records: %s"),
+      path,
+      count,
+      local_error->message
+    );
+
+    g_error_free(local_error);
+  }
+
+  if(n_records != NULL)
+    *n_records = count;
+
+  return TRUE;
+}
+
+/* vim:set et sw=2 ts=2: */
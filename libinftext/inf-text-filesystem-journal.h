@@ -0,0 +1,87 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef __INF_TEXT_FILESYSTEM_JOURNAL_H__
+#define __INF_TEXT_FILESYSTEM_JOURNAL_H__
+
+#include <libinftext/inf-text-buffer.h>
+#include <libinfinity/common/inf-user-table.h>
+#include <libinfinity/server/infd-filesystem-storage.h>
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * InfTextFilesystemJournal:
+ *
+ * #InfTextFilesystemJournal is an opaque data type. You should only access
+ * it via the public API functions.
+ */
+typedef struct _InfTextFilesystemJournal InfTextFilesystemJournal;
+
+/**
+ * InfTextFilesystemJournalError:
+ * @INF_TEXT_FILESYSTEM_JOURNAL_ERROR_INVALID_RECORD: The journal contains a
+ * record that cannot be applied to the document.
+ * @INF_TEXT_FILESYSTEM_JOURNAL_ERROR_INCOMPLETE: Records could not be
+ * written to the journal before, and the document needs to be saved
+ * before the journal can be used again.
+ *
+ * Errors that can occur when writing or replaying a journal.
+ */
+typedef enum _InfTextFilesystemJournalError {
+  INF_TEXT_FILESYSTEM_JOURNAL_ERROR_INVALID_RECORD,
+  INF_TEXT_FILESYSTEM_JOURNAL_ERROR_INCOMPLETE
+} InfTextFilesystemJournalError;
+
+InfTextFilesystemJournal*
+inf_text_filesystem_journal_new(InfdFilesystemStorage* storage,
+                                const gchar* path,
+                                InfUserTable* user_table,
+                                InfTextBuffer* buffer,
+                                GError** error);
+
+void
+inf_text_filesystem_journal_free(InfTextFilesystemJournal* journal);
+
+gboolean
+inf_text_filesystem_journal_flush(InfTextFilesystemJournal* journal,
+                                  GError** error);
+
+gboolean
+inf_text_filesystem_journal_reset(InfTextFilesystemJournal* journal,
+                                  GError** error);
+
+guint64
+inf_text_filesystem_journal_get_size(InfTextFilesystemJournal* journal);
+
+gboolean
+inf_text_filesystem_journal_replay(InfdFilesystemStorage* storage,
+                                   const gchar* path,
+                                   InfUserTable* user_table,
+                                   InfTextBuffer* buffer,
+                                   guint* n_records,
+                                   GError** error);
+
+G_END_DECLS
+
+#endif /* __INF_TEXT_FILESYSTEM_JOURNAL_H__ */
+
+/* vim:set et sw=2 ts=2: */
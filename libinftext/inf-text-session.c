@@ -26,6 +26,7 @@
 #include <libinftext/inf-text-move-operation.h>
 #include <libinftext/inf-text-chunk.h>
 #include <libinftext/inf-text-user.h>
+#include <libinfinity/adopted/inf-adopted-split-operation.h>
 #include <libinfinity/adopted/inf-adopted-no-operation.h>
 #include <libinfinity/common/inf-xml-util.h>
 #include <libinfinity/common/inf-error.h>
@@ -36,9 +37,6 @@
 #include <string.h>
 #include <errno.h>
 
-/* TODO: Optionally broadcast operations delayed to merge adjacent operations
- * and send as a single request. */
-
 typedef struct _InfTextSessionLocalUser InfTextSessionLocalUser;
 struct _InfTextSessionLocalUser {
   InfTextSession* session;
@@ -51,12 +49,22 @@ typedef struct _InfTextSessionPrivate InfTextSessionPrivate;
 struct _InfTextSessionPrivate {
   guint caret_update_interval;
   GSList* local_users;
+
+  /* Adjacent local modifications that have not yet been turned into a
+   * request, see the merge-interval property. */
+  guint merge_interval;
+  InfTextUser* pending_user;
+  gboolean pending_insert;
+  guint pending_position;
+  InfTextChunk* pending_chunk;
+  InfIoTimeout* pending_timeout;
 };
 
 enum {
   PROP_0,
 
-  PROP_CARET_UPDATE_INTERVAL
+  PROP_CARET_UPDATE_INTERVAL,
+  PROP_MERGE_INTERVAL
 };
 
 typedef struct _InfTextSessionInsertForeachData
@@ -195,6 +203,221 @@ inf_text_session_find_local_user(InfTextSession* session,
   return NULL;
 }
 
+static void
+inf_text_session_clear_pending(InfTextSession* session)
+{
+  InfTextSessionPrivate* priv;
+  priv = INF_TEXT_SESSION_PRIVATE(session);
+
+  if(priv->pending_timeout != NULL)
+  {
+    inf_io_remove_timeout(
+      inf_adopted_session_get_io(INF_ADOPTED_SESSION(session)),
+      priv->pending_timeout
+    );
+
+    priv->pending_timeout = NULL;
+  }
+
+  if(priv->pending_chunk != NULL)
+  {
+    inf_text_chunk_free(priv->pending_chunk);
+    priv->pending_chunk = NULL;
+    priv->pending_user = NULL;
+  }
+}
+
+/* Turns the held back modification into a request, and executes and
+ * broadcasts it. Since nothing else has been executed by the algorithm in
+ * the meanwhile, the request is generated in the same state as the first of
+ * the merged modifications would have been. */
+static void
+inf_text_session_flush_pending(InfTextSession* session)
+{
+  InfTextSessionPrivate* priv;
+  InfAdoptedAlgorithm* algorithm;
+  InfAdoptedOperation* operation;
+  InfAdoptedRequest* request;
+
+  priv = INF_TEXT_SESSION_PRIVATE(session);
+  if(priv->pending_chunk == NULL)
+    return;
+
+  algorithm = inf_adopted_session_get_algorithm(INF_ADOPTED_SESSION(session));
+
+  if(priv->pending_insert)
+  {
+    operation = INF_ADOPTED_OPERATION(
+      inf_text_default_insert_operation_new(
+        priv->pending_position,
+        priv->pending_chunk
+      )
+    );
+  }
+  else
+  {
+    operation = INF_ADOPTED_OPERATION(
+      inf_text_default_delete_operation_new(
+        priv->pending_position,
+        priv->pending_chunk
+      )
+    );
+  }
+
+  request = inf_adopted_algorithm_generate_request(
+    algorithm,
+    INF_ADOPTED_REQUEST_DO,
+    INF_ADOPTED_USER(priv->pending_user),
+    operation
+  );
+
+  g_object_unref(operation);
+  inf_text_session_clear_pending(session);
+
+  /* This cannot fail since operation is not applied */
+  inf_adopted_algorithm_execute_request(algorithm, request, FALSE, NULL);
+
+  inf_adopted_session_broadcast_request(
+    INF_ADOPTED_SESSION(session),
+    request
+  );
+
+  g_object_unref(request);
+}
+
+/* Sends the held back modification if there is still someone to send it
+ * to, or drops it otherwise. */
+static void
+inf_text_session_release_pending(InfTextSession* session)
+{
+  InfSession* parent;
+  parent = INF_SESSION(session);
+
+  if(inf_session_get_status(parent) == INF_SESSION_RUNNING &&
+     inf_session_get_subscription_group(parent) != NULL)
+  {
+    inf_text_session_flush_pending(session);
+  }
+  else
+  {
+    inf_text_session_clear_pending(session);
+  }
+}
+
+static void
+inf_text_session_pending_timeout_func(gpointer user_data)
+{
+  InfTextSession* session;
+  InfTextSessionPrivate* priv;
+
+  session = INF_TEXT_SESSION(user_data);
+  priv = INF_TEXT_SESSION_PRIVATE(session);
+  priv->pending_timeout = NULL;
+
+  inf_text_session_flush_pending(session);
+}
+
+static void
+inf_text_session_begin_pending(InfTextSession* session,
+                               InfTextUser* user,
+                               gboolean insert,
+                               guint position,
+                               InfTextChunk* chunk)
+{
+  InfTextSessionPrivate* priv;
+  priv = INF_TEXT_SESSION_PRIVATE(session);
+
+  g_assert(priv->pending_chunk == NULL);
+
+  priv->pending_user = user;
+  priv->pending_insert = insert;
+  priv->pending_position = position;
+  priv->pending_chunk = inf_text_chunk_copy(chunk);
+
+  /* The timeout is not reset by further modifications, so that they are
+   * delayed by at most merge-interval. */
+  priv->pending_timeout = inf_io_add_timeout(
+    inf_adopted_session_get_io(INF_ADOPTED_SESSION(session)),
+    priv->merge_interval,
+    inf_text_session_pending_timeout_func,
+    session,
+    NULL
+  );
+}
+
+/* Holds back a local insertion, merging it with the held back one if it
+ * continues it directly. */
+static void
+inf_text_session_merge_insert(InfTextSession* session,
+                              InfTextUser* user,
+                              guint position,
+                              InfTextChunk* chunk)
+{
+  InfTextSessionPrivate* priv;
+  guint length;
+
+  priv = INF_TEXT_SESSION_PRIVATE(session);
+
+  if(priv->pending_chunk != NULL)
+  {
+    length = inf_text_chunk_get_length(priv->pending_chunk);
+
+    if(priv->pending_user == user && priv->pending_insert &&
+       position == priv->pending_position + length)
+    {
+      inf_text_chunk_insert_chunk(priv->pending_chunk, length, chunk);
+      return;
+    }
+
+    inf_text_session_flush_pending(session);
+  }
+
+  inf_text_session_begin_pending(session, user, TRUE, position, chunk);
+}
+
+/* Holds back a local deletion, merging it with the held back one if it is
+ * directly before (backspace) or at the same position (delete). */
+static void
+inf_text_session_merge_erase(InfTextSession* session,
+                             InfTextUser* user,
+                             guint position,
+                             InfTextChunk* chunk)
+{
+  InfTextSessionPrivate* priv;
+  guint length;
+
+  priv = INF_TEXT_SESSION_PRIVATE(session);
+
+  if(priv->pending_chunk != NULL)
+  {
+    length = inf_text_chunk_get_length(chunk);
+
+    if(priv->pending_user == user && !priv->pending_insert)
+    {
+      if(position == priv->pending_position)
+      {
+        inf_text_chunk_insert_chunk(
+          priv->pending_chunk,
+          inf_text_chunk_get_length(priv->pending_chunk),
+          chunk
+        );
+
+        return;
+      }
+      else if(position + length == priv->pending_position)
+      {
+        inf_text_chunk_insert_chunk(priv->pending_chunk, 0, chunk);
+        priv->pending_position = position;
+        return;
+      }
+    }
+
+    inf_text_session_flush_pending(session);
+  }
+
+  inf_text_session_begin_pending(session, user, FALSE, position, chunk);
+}
+
 static void
 inf_text_session_broadcast_caret_selection(InfTextSession* session,
                                            InfTextSessionLocalUser* local)
@@ -207,6 +430,10 @@ inf_text_session_broadcast_caret_selection(InfTextSession* session,
   int sel;
   guint end;
 
+  /* The caret position refers to the buffer including held back
+   * modifications. */
+  inf_text_session_flush_pending(session);
+
   algorithm = inf_adopted_session_get_algorithm(INF_ADOPTED_SESSION(session));
   position = inf_text_user_get_caret_position(local->user);
   sel = inf_text_user_get_selection_length(local->user);
@@ -375,6 +602,12 @@ inf_text_session_remove_local_user(InfTextSession* session,
     );
   }
 
+  /* Normally these have been sent before the user left. If the user is
+   * removed otherwise, for example because the connection was lost, they
+   * can no longer be sent. */
+  if(priv->pending_user == local->user)
+    inf_text_session_clear_pending(session);
+
   inf_signal_handlers_disconnect_by_func(
     G_OBJECT(local->user),
     G_CALLBACK(inf_text_session_selection_changed_cb),
@@ -548,7 +781,11 @@ inf_text_session_buffer_text_inserted_cb(InfTextBuffer* buffer,
   algorithm = inf_adopted_session_get_algorithm(INF_ADOPTED_SESSION(session));
   execute_request = inf_adopted_algorithm_get_execute_request(algorithm);
 
-  if(execute_request == NULL)
+  if(execute_request == NULL && priv->merge_interval > 0)
+  {
+    inf_text_session_merge_insert(session, INF_TEXT_USER(user), pos, chunk);
+  }
+  else if(execute_request == NULL)
   {
     operation = INF_ADOPTED_OPERATION(
       inf_text_default_insert_operation_new(pos, chunk)
@@ -626,7 +863,11 @@ inf_text_session_buffer_text_erased_cb(InfTextBuffer* buffer,
   algorithm = inf_adopted_session_get_algorithm(INF_ADOPTED_SESSION(session));
   execute_request = inf_adopted_algorithm_get_execute_request(algorithm);
 
-  if(execute_request == NULL)
+  if(execute_request == NULL && priv->merge_interval > 0)
+  {
+    inf_text_session_merge_erase(session, INF_TEXT_USER(user), pos, chunk);
+  }
+  else if(execute_request == NULL)
   {
     operation = INF_ADOPTED_OPERATION(
       inf_text_default_delete_operation_new(pos, chunk)
@@ -741,6 +982,13 @@ inf_text_session_init(InfTextSession* session)
   priv = INF_TEXT_SESSION_PRIVATE(session);
 
   priv->caret_update_interval = 500;
+
+  priv->merge_interval = 0;
+  priv->pending_user = NULL;
+  priv->pending_insert = FALSE;
+  priv->pending_position = 0;
+  priv->pending_chunk = NULL;
+  priv->pending_timeout = NULL;
 }
 
 static void
@@ -807,6 +1055,8 @@ inf_text_session_dispose(GObject* object)
   user_table = inf_session_get_user_table(INF_SESSION(session));
   algorithm = inf_adopted_session_get_algorithm(INF_ADOPTED_SESSION(session));
 
+  inf_text_session_release_pending(session);
+
   while(priv->local_users != NULL)
   {
     inf_text_session_remove_local_user(
@@ -871,6 +1121,11 @@ inf_text_session_set_property(GObject* object,
   case PROP_CARET_UPDATE_INTERVAL:
     priv->caret_update_interval = g_value_get_uint(value);
     break;
+  case PROP_MERGE_INTERVAL:
+    priv->merge_interval = g_value_get_uint(value);
+    if(priv->merge_interval == 0)
+      inf_text_session_flush_pending(session);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
@@ -894,6 +1149,9 @@ inf_text_session_get_property(GObject* object,
   case PROP_CARET_UPDATE_INTERVAL:
     g_value_set_uint(value, priv->caret_update_interval);
     break;
+  case PROP_MERGE_INTERVAL:
+    g_value_set_uint(value, priv->merge_interval);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
@@ -1315,16 +1573,35 @@ inf_text_session_synchronization_complete(InfSession* session,
     inf_text_session_init_text_handlers(INF_TEXT_SESSION(session));
 }
 
+static void
+inf_text_session_flush(InfSession* session)
+{
+  inf_text_session_flush_pending(INF_TEXT_SESSION(session));
+
+  INF_SESSION_CLASS(inf_text_session_parent_class)->flush(session);
+}
+
+static void
+inf_text_session_close(InfSession* session)
+{
+  /* inf_session_close() flushes held back modifications already, unless
+   * the session proxy has released the subscription group before, for
+   * example because the connection to the server was lost. */
+  inf_text_session_release_pending(INF_TEXT_SESSION(session));
+
+  INF_SESSION_CLASS(inf_text_session_parent_class)->close(session);
+}
+
 /*
  * InfAdoptedSession overrides
  */
 
-static void
-inf_text_session_request_to_xml(InfAdoptedSession* session,
-                                xmlNodePtr xml,
-                                InfAdoptedRequest* request,
-                                InfAdoptedStateVector* diff_vec,
-                                gboolean for_sync)
+/* Serializes a DO operation. Split operations are written as a list of the
+ * operations they contain, so that an operation modifying the document at
+ * many places at once is transmitted as a single request. */
+static xmlNodePtr
+inf_text_session_operation_to_xml(InfAdoptedOperation* operation,
+                                  gboolean for_sync)
 {
   InfTextChunk* chunk;
   InfTextChunkIter iter;
@@ -1341,143 +1618,187 @@ inf_text_session_request_to_xml(InfAdoptedSession* session,
   gsize total_bytes;
   gsize bytes_left;
 
-  InfAdoptedOperation* operation;
+  GSList* list;
+  GSList* item;
 
-  switch(inf_adopted_request_get_request_type(request))
+  if(INF_ADOPTED_IS_SPLIT_OPERATION(operation))
   {
-  case INF_ADOPTED_REQUEST_DO:
-    operation = inf_adopted_request_get_operation(request);
-    if(INF_TEXT_IS_INSERT_OPERATION(operation))
+    op_xml = xmlNewNode(NULL, (const xmlChar*)"split");
+
+    list = inf_adopted_split_operation_unsplit(
+      INF_ADOPTED_SPLIT_OPERATION(operation)
+    );
+
+    for(item = list; item != NULL; item = g_slist_next(item))
     {
-      op_xml = xmlNewNode(NULL, (const xmlChar*)"insert-caret");
+      /* Only text modifications can be part of a split operation */
+      g_assert(
+        INF_TEXT_IS_INSERT_OPERATION(item->data) ||
+        INF_TEXT_IS_DELETE_OPERATION(item->data)
+      );
 
-      inf_xml_util_set_attribute_uint(
+      xmlAddChild(
         op_xml,
-        "pos",
-        inf_text_insert_operation_get_position(
-          INF_TEXT_INSERT_OPERATION(operation)
+        inf_text_session_operation_to_xml(
+          INF_ADOPTED_OPERATION(item->data),
+          for_sync
         )
       );
+    }
 
-      /* Must be default insert operation so we get the inserted text */
-      g_assert(INF_TEXT_IS_DEFAULT_INSERT_OPERATION(operation));
+    g_slist_free(list);
+  }
+  else if(INF_TEXT_IS_INSERT_OPERATION(operation))
+  {
+    op_xml = xmlNewNode(NULL, (const xmlChar*)"insert-caret");
 
-      chunk = inf_text_default_insert_operation_get_chunk(
-        INF_TEXT_DEFAULT_INSERT_OPERATION(operation)
-      );
+    inf_xml_util_set_attribute_uint(
+      op_xml,
+      "pos",
+      inf_text_insert_operation_get_position(
+        INF_TEXT_INSERT_OPERATION(operation)
+      )
+    );
 
-      result = inf_text_chunk_iter_init_begin(chunk, &iter);
-      g_assert(result == TRUE);
-
-      utf8_text = g_convert(
-        inf_text_chunk_iter_get_text(&iter),
-        inf_text_chunk_iter_get_bytes(&iter),
-        "UTF-8",
-        inf_text_chunk_get_encoding(chunk),
-        &bytes_read,
-        &bytes_written,
-        NULL
-      );
+    /* Must be default insert operation so we get the inserted text */
+    g_assert(INF_TEXT_IS_DEFAULT_INSERT_OPERATION(operation));
 
-      /* Conversion to UTF-8 should always succeed */
-      g_assert(utf8_text != NULL);
-      g_assert(bytes_read == inf_text_chunk_iter_get_bytes(&iter));
+    chunk = inf_text_default_insert_operation_get_chunk(
+      INF_TEXT_DEFAULT_INSERT_OPERATION(operation)
+    );
 
-      inf_xml_util_add_child_text(op_xml, utf8_text, bytes_written);
-      g_free(utf8_text);
+    result = inf_text_chunk_iter_init_begin(chunk, &iter);
+    g_assert(result == TRUE);
 
-      /* We only allow a single segment because the whole inserted text must
-       * be written by a single user. */
-      g_assert(inf_text_chunk_iter_next(&iter) == FALSE);
-    }
-    else if(INF_TEXT_IS_DELETE_OPERATION(operation))
-    {
-      op_xml = xmlNewNode(NULL, (const xmlChar*)"delete-caret");
+    utf8_text = g_convert(
+      inf_text_chunk_iter_get_text(&iter),
+      inf_text_chunk_iter_get_bytes(&iter),
+      "UTF-8",
+      inf_text_chunk_get_encoding(chunk),
+      &bytes_read,
+      &bytes_written,
+      NULL
+    );
 
-      inf_xml_util_set_attribute_uint(
-        op_xml,
-        "pos",
-        inf_text_delete_operation_get_position(
-          INF_TEXT_DELETE_OPERATION(operation)
-        )
-      );
+    /* Conversion to UTF-8 should always succeed */
+    g_assert(utf8_text != NULL);
+    g_assert(bytes_read == inf_text_chunk_iter_get_bytes(&iter));
 
-      if(for_sync == TRUE)
-      {
-        /* Must be default delete operation so we get chunk */
-        g_assert(INF_TEXT_IS_DEFAULT_DELETE_OPERATION(operation));
+    inf_xml_util_add_child_text(op_xml, utf8_text, bytes_written);
+    g_free(utf8_text);
 
-        chunk = inf_text_default_delete_operation_get_chunk(
-          INF_TEXT_DEFAULT_DELETE_OPERATION(operation)
-        );
+    /* We only allow a single segment because the whole inserted text must
+     * be written by a single user. */
+    g_assert(inf_text_chunk_iter_next(&iter) == FALSE);
+  }
+  else if(INF_TEXT_IS_DELETE_OPERATION(operation))
+  {
+    op_xml = xmlNewNode(NULL, (const xmlChar*)"delete-caret");
 
-        /* Need to transmit all deleted data */
-        cd = g_iconv_open("UTF-8", inf_text_chunk_get_encoding(chunk));
-        result = inf_text_chunk_iter_init_begin(chunk, &iter);
+    inf_xml_util_set_attribute_uint(
+      op_xml,
+      "pos",
+      inf_text_delete_operation_get_position(
+        INF_TEXT_DELETE_OPERATION(operation)
+      )
+    );
 
-        while(result == TRUE)
-        {
-          text = inf_text_chunk_iter_get_text(&iter);
-          total_bytes = inf_text_chunk_iter_get_bytes(&iter);
-          bytes_left = total_bytes;
-          child = xmlNewChild(op_xml, NULL, (const xmlChar*)"segment", NULL);
+    if(for_sync == TRUE)
+    {
+      /* Must be default delete operation so we get chunk */
+      g_assert(INF_TEXT_IS_DEFAULT_DELETE_OPERATION(operation));
 
-          while(bytes_left > 0)
-          {
-            inf_text_session_segment_to_xml(
-              &cd,
-              child,
-              text + total_bytes - bytes_left,
-              &bytes_left,
-              inf_text_chunk_iter_get_author(&iter)
-            );
-          }
+      chunk = inf_text_default_delete_operation_get_chunk(
+        INF_TEXT_DEFAULT_DELETE_OPERATION(operation)
+      );
 
-          result = inf_text_chunk_iter_next(&iter);
-        }
+      /* Need to transmit all deleted data */
+      cd = g_iconv_open("UTF-8", inf_text_chunk_get_encoding(chunk));
+      result = inf_text_chunk_iter_init_begin(chunk, &iter);
 
-        g_iconv_close(cd);
-      }
-      else
+      while(result == TRUE)
       {
-        /* Just transmit position and length, the other site generates a
-         * InfTextRemoteDeleteOperation from that and is able to restore the
-         * deleted text for potential Undo. */
-        inf_xml_util_set_attribute_uint(
-          op_xml,
-          "len",
-          inf_text_delete_operation_get_length(
-            INF_TEXT_DELETE_OPERATION(operation)
-          )
-        );
+        text = inf_text_chunk_iter_get_text(&iter);
+        total_bytes = inf_text_chunk_iter_get_bytes(&iter);
+        bytes_left = total_bytes;
+        child = xmlNewChild(op_xml, NULL, (const xmlChar*)"segment", NULL);
+
+        while(bytes_left > 0)
+        {
+          inf_text_session_segment_to_xml(
+            &cd,
+            child,
+            text + total_bytes - bytes_left,
+            &bytes_left,
+            inf_text_chunk_iter_get_author(&iter)
+          );
+        }
+
+        result = inf_text_chunk_iter_next(&iter);
       }
+
+      g_iconv_close(cd);
     }
-    else if(for_sync == FALSE && INF_TEXT_IS_MOVE_OPERATION(operation))
+    else
     {
-      op_xml = xmlNewNode(NULL, (const xmlChar*)"move");
-
+      /* Just transmit position and length, the other site generates a
+       * InfTextRemoteDeleteOperation from that and is able to restore the
+       * deleted text for potential Undo. */
       inf_xml_util_set_attribute_uint(
         op_xml,
-        "caret",
-        inf_text_move_operation_get_position(
-          INF_TEXT_MOVE_OPERATION(operation)
+        "len",
+        inf_text_delete_operation_get_length(
+          INF_TEXT_DELETE_OPERATION(operation)
         )
       );
-
-      inf_xml_util_set_attribute_int(
-        op_xml,
-        "selection",
-        inf_text_move_operation_get_length(INF_TEXT_MOVE_OPERATION(operation))
-      );
-    }
-    else if(for_sync == FALSE && INF_ADOPTED_IS_NO_OPERATION(operation))
-    {
-      op_xml = xmlNewNode(NULL, (const xmlChar*)"no-op");
-    }
-    else
-    {
-      g_assert_not_reached();
     }
+  }
+  else if(for_sync == FALSE && INF_TEXT_IS_MOVE_OPERATION(operation))
+  {
+    op_xml = xmlNewNode(NULL, (const xmlChar*)"move");
+
+    inf_xml_util_set_attribute_uint(
+      op_xml,
+      "caret",
+      inf_text_move_operation_get_position(
+        INF_TEXT_MOVE_OPERATION(operation)
+      )
+    );
+
+    inf_xml_util_set_attribute_int(
+      op_xml,
+      "selection",
+      inf_text_move_operation_get_length(INF_TEXT_MOVE_OPERATION(operation))
+    );
+  }
+  else if(for_sync == FALSE && INF_ADOPTED_IS_NO_OPERATION(operation))
+  {
+    op_xml = xmlNewNode(NULL, (const xmlChar*)"no-op");
+  }
+  else
+  {
+    g_assert_not_reached();
+  }
+
+  return op_xml;
+}
+
+static void
+inf_text_session_request_to_xml(InfAdoptedSession* session,
+                                xmlNodePtr xml,
+                                InfAdoptedRequest* request,
+                                InfAdoptedStateVector* diff_vec,
+                                gboolean for_sync)
+{
+  xmlNodePtr op_xml;
+
+  switch(inf_adopted_request_get_request_type(request))
+  {
+  case INF_ADOPTED_REQUEST_DO:
+    op_xml = inf_text_session_operation_to_xml(
+      inf_adopted_request_get_operation(request),
+      for_sync
+    );
 
     break;
   case INF_ADOPTED_REQUEST_UNDO:
@@ -1502,21 +1823,99 @@ inf_text_session_request_to_xml(InfAdoptedSession* session,
   );
 }
 
-static InfAdoptedRequest*
-inf_text_session_xml_to_request(InfAdoptedSession* session,
-                                xmlNodePtr xml,
-                                InfAdoptedStateVector* diff_vec,
-                                gboolean for_sync,
-                                GError** error)
+static InfAdoptedOperation*
+inf_text_session_operation_from_xml(InfTextBuffer* buffer,
+                                    xmlNodePtr op_xml,
+                                    guint user_id,
+                                    gboolean for_sync,
+                                    GError** error);
+
+/* Parses the operations of a split operation, see
+ * inf_text_session_operation_to_xml(). */
+static InfAdoptedOperation*
+inf_text_session_split_operation_from_xml(InfTextBuffer* buffer,
+                                          xmlNodePtr op_xml,
+                                          guint user_id,
+                                          gboolean for_sync,
+                                          GError** error)
 {
-  InfTextBuffer* buffer;
-  InfAdoptedUser* user;
-  guint user_id;
-  InfAdoptedStateVector* vector;
-  xmlNodePtr op_xml;
+  GPtrArray* operations;
   InfAdoptedOperation* operation;
-  InfAdoptedRequestType type;
-  InfAdoptedRequest* request;
+  xmlNodePtr child;
+
+  operations = g_ptr_array_new_with_free_func(g_object_unref);
+
+  for(child = op_xml->children; child != NULL; child = child->next)
+  {
+    if(child->type != XML_ELEMENT_NODE)
+      continue;
+
+    operation = inf_text_session_operation_from_xml(
+      buffer,
+      child,
+      user_id,
+      for_sync,
+      error
+    );
+
+    if(operation == NULL)
+    {
+      g_ptr_array_free(operations, TRUE);
+      return NULL;
+    }
+
+    g_ptr_array_add(operations, operation);
+
+    if(!INF_TEXT_IS_INSERT_OPERATION(operation) &&
+       !INF_TEXT_IS_DELETE_OPERATION(operation) &&
+       !INF_ADOPTED_IS_SPLIT_OPERATION(operation))
+    {
+      g_set_error(
+        error,
+        inf_request_error_quark(),
+        INF_REQUEST_ERROR_FAILED,
+        _("Operation \"%s\" cannot be part of a split operation"),
+        (const gchar*)child->name
+      );
+
+      g_ptr_array_free(operations, TRUE);
+      return NULL;
+    }
+  }
+
+  if(operations->len < 2)
+  {
+    g_set_error_literal(
+      error,
+      inf_request_error_quark(),
+      INF_REQUEST_ERROR_FAILED,
+      _("Split operation does not contain at least two operations")
+    );
+
+    g_ptr_array_free(operations, TRUE);
+    return NULL;
+  }
+
+  operation = INF_ADOPTED_OPERATION(
+    inf_adopted_split_operation_new_multiple(
+      (InfAdoptedOperation* const*)operations->pdata,
+      operations->len
+    )
+  );
+
+  g_ptr_array_free(operations, TRUE);
+  return operation;
+}
+
+static InfAdoptedOperation*
+inf_text_session_operation_from_xml(InfTextBuffer* buffer,
+                                    xmlNodePtr op_xml,
+                                    guint user_id,
+                                    gboolean for_sync,
+                                    GError** error)
+{
+  InfAdoptedOperation* operation;
+  gboolean cmp;
 
   guint pos;
   gchar* text;
@@ -1530,36 +1929,18 @@ inf_text_session_xml_to_request(InfAdoptedSession* session,
   xmlNodePtr child;
   GIConv cd;
   guint author;
-  gboolean cmp;
 
   gint selection;
 
-  buffer = INF_TEXT_BUFFER(inf_session_get_buffer(INF_SESSION(session)));
-
-  cmp = inf_adopted_session_read_request_info(
-    session,
-    xml,
-    diff_vec,
-    &user,
-    &vector,
-    &op_xml,
-    error
-  );
-
-  if(cmp == FALSE) return FALSE;
-  user_id = (user == NULL) ? 0 : inf_user_get_id(INF_USER(user));
-
   if(strcmp((const char*)op_xml->name, "insert") == 0 ||
      strcmp((const char*)op_xml->name, "insert-caret") == 0)
   {
-    type = INF_ADOPTED_REQUEST_DO;
-
     if(!inf_xml_util_get_attribute_uint_required(op_xml, "pos", &pos, error))
-      goto fail;
+      return NULL;
 
     utf8_text = inf_xml_util_get_child_text(op_xml, &in_bytes, &length, error);
     if(!utf8_text)
-      goto fail;
+      return NULL;
 
     text = g_convert(
       utf8_text,
@@ -1572,7 +1953,7 @@ inf_text_session_xml_to_request(InfAdoptedSession* session,
     );
 
     g_free(utf8_text);
-    if(text == NULL) goto fail;
+    if(text == NULL) return NULL;
 
     chunk = inf_text_chunk_new(inf_text_buffer_get_encoding(buffer));
     inf_text_chunk_insert_text(chunk, 0, text, bytes, length, user_id);
@@ -1587,10 +1968,8 @@ inf_text_session_xml_to_request(InfAdoptedSession* session,
   else if(strcmp((const char*)op_xml->name, "delete") == 0 ||
           strcmp((const char*)op_xml->name, "delete-caret") == 0)
   {
-    type = INF_ADOPTED_REQUEST_DO;
-
     if(!inf_xml_util_get_attribute_uint_required(op_xml, "pos", &pos, error))
-      goto fail;
+      return NULL;
 
     if(for_sync == TRUE)
     {
@@ -1615,7 +1994,7 @@ inf_text_session_xml_to_request(InfAdoptedSession* session,
           {
             inf_text_chunk_free(chunk);
             g_iconv_close(cd);
-            goto fail;
+            return NULL;
           }
           else
           {
@@ -1654,7 +2033,7 @@ inf_text_session_xml_to_request(InfAdoptedSession* session,
         error
       );
 
-      if(cmp == FALSE) goto fail;
+      if(cmp == FALSE) return NULL;
 
       operation = INF_ADOPTED_OPERATION(
         inf_text_remote_delete_operation_new(pos, length)
@@ -1663,8 +2042,6 @@ inf_text_session_xml_to_request(InfAdoptedSession* session,
   }
   else if(strcmp((const char*)op_xml->name, "move") == 0)
   {
-    type = INF_ADOPTED_REQUEST_DO;
-
     cmp = inf_xml_util_get_attribute_uint_required(
       op_xml,
       "caret",
@@ -1672,7 +2049,7 @@ inf_text_session_xml_to_request(InfAdoptedSession* session,
       error
     );
 
-    if(cmp == FALSE) goto fail;
+    if(cmp == FALSE) return NULL;
 
     cmp = inf_xml_util_get_attribute_int_required(
       op_xml,
@@ -1681,7 +2058,7 @@ inf_text_session_xml_to_request(InfAdoptedSession* session,
       error
     );
 
-    if(cmp == FALSE) goto fail;
+    if(cmp == FALSE) return NULL;
 
     operation = INF_ADOPTED_OPERATION(
       inf_text_move_operation_new(pos, selection)
@@ -1689,11 +2066,68 @@ inf_text_session_xml_to_request(InfAdoptedSession* session,
   }
   else if(strcmp((const char*)op_xml->name, "no-op") == 0)
   {
-    type = INF_ADOPTED_REQUEST_DO;
     operation = INF_ADOPTED_OPERATION(inf_adopted_no_operation_new());
   }
-  else if(strcmp((const char*)op_xml->name, "undo") == 0 ||
-          strcmp((const char*)op_xml->name, "undo-caret") == 0)
+  else if(strcmp((const char*)op_xml->name, "split") == 0)
+  {
+    operation = inf_text_session_split_operation_from_xml(
+      buffer,
+      op_xml,
+      user_id,
+      for_sync,
+      error
+    );
+  }
+  else
+  {
+    g_set_error(
+      error,
+      inf_request_error_quark(),
+      INF_REQUEST_ERROR_FAILED,
+      _("Unknown operation \"%s\""),
+      (const gchar*)op_xml->name
+    );
+
+    return NULL;
+  }
+
+  return operation;
+}
+
+static InfAdoptedRequest*
+inf_text_session_xml_to_request(InfAdoptedSession* session,
+                                xmlNodePtr xml,
+                                InfAdoptedStateVector* diff_vec,
+                                gboolean for_sync,
+                                GError** error)
+{
+  InfTextBuffer* buffer;
+  InfAdoptedUser* user;
+  guint user_id;
+  InfAdoptedStateVector* vector;
+  xmlNodePtr op_xml;
+  InfAdoptedOperation* operation;
+  InfAdoptedRequestType type;
+  InfAdoptedRequest* request;
+  gboolean cmp;
+
+  buffer = INF_TEXT_BUFFER(inf_session_get_buffer(INF_SESSION(session)));
+
+  cmp = inf_adopted_session_read_request_info(
+    session,
+    xml,
+    diff_vec,
+    &user,
+    &vector,
+    &op_xml,
+    error
+  );
+
+  if(cmp == FALSE) return FALSE;
+  user_id = (user == NULL) ? 0 : inf_user_get_id(INF_USER(user));
+
+  if(strcmp((const char*)op_xml->name, "undo") == 0 ||
+     strcmp((const char*)op_xml->name, "undo-caret") == 0)
   {
     type = INF_ADOPTED_REQUEST_UNDO;
   }
@@ -1704,8 +2138,17 @@ inf_text_session_xml_to_request(InfAdoptedSession* session,
   }
   else
   {
-    /* TODO: Error */
-    goto fail;
+    type = INF_ADOPTED_REQUEST_DO;
+
+    operation = inf_text_session_operation_from_xml(
+      buffer,
+      op_xml,
+      user_id,
+      for_sync,
+      error
+    );
+
+    if(operation == NULL) goto fail;
   }
 
   switch(type)
@@ -1775,6 +2218,8 @@ inf_text_session_class_init(InfTextSessionClass* text_session_class)
   session_class->set_xml_user_props = inf_text_session_set_xml_user_props;
   session_class->validate_user_props = inf_text_session_validate_user_props;
   session_class->user_new = inf_text_session_user_new;
+  session_class->flush = inf_text_session_flush;
+  session_class->close = inf_text_session_close;
   session_class->synchronization_complete =
     inf_text_session_synchronization_complete;
 
@@ -1798,6 +2243,34 @@ inf_text_session_class_init(InfTextSessionClass* text_session_class)
       G_PARAM_READWRITE | G_PARAM_CONSTRUCT
     )
   );
+
+  /**
+   * InfTextSession:merge-interval:
+   *
+   * Time, in milliseconds, for which text inserted or erased by a local
+   * user is held back before it is sent to other users. Adjacent
+   * insertions or deletions made by the same user within this time are
+   * combined into a single request, which reduces the number of requests
+   * that need to be transformed and kept in the request log on all sites,
+   * at the cost of a slightly larger latency. Held back modifications are
+   * sent before any other request is made or received, and they are only
+   * available for undo after having been sent. 0 means that every
+   * modification is sent immediately.
+   */
+  g_object_class_install_property(
+    object_class,
+    PROP_MERGE_INTERVAL,
+    g_param_spec_uint(
+      "merge-interval",
+      "Merge interval",
+      "Time in milliseconds for which local modifications are held back to "
+      "be merged with adjacent ones",
+      0,
+      G_MAXUINT,
+      0,
+      G_PARAM_READWRITE
+    )
+  );
 }
 
 /*
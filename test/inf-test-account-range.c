@@ -0,0 +1,412 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Tests paged and prefix-filtered account listing of InfdDirectory with an
+ * InfdFilesystemAccountStorage */
+
+#include <libinfinity/server/infd-directory.h>
+#include <libinfinity/server/infd-filesystem-storage.h>
+#include <libinfinity/server/infd-filesystem-account-storage.h>
+#include <libinfinity/common/inf-standalone-io.h>
+#include <libinfinity/common/inf-request-result.h>
+#include <libinfinity/common/inf-init.h>
+
+#include <glib/gstdio.h>
+#include <string.h>
+#include <stdio.h>
+
+typedef struct _InfTestAccountRangeChunk InfTestAccountRangeChunk;
+struct _InfTestAccountRangeChunk {
+  InfAclAccount* accounts;
+  guint n_accounts;
+  InfAclAccountId next;
+  gboolean succeeded;
+};
+
+static void
+inf_test_account_range_finished_cb(InfRequest* request,
+                                   const InfRequestResult* result,
+                                   const GError* error,
+                                   gpointer user_data)
+{
+  InfTestAccountRangeChunk* chunk;
+  const InfAclAccount* accounts;
+  guint i;
+
+  chunk = (InfTestAccountRangeChunk*)user_data;
+
+  if(error != NULL)
+  {
+    fprintf(stderr, "Query failed: %s\n", error->message);
+    return;
+  }
+
+  inf_request_result_get_query_acl_account_range(
+    result,
+    NULL,
+    &accounts,
+    &chunk->n_accounts,
+    &chunk->next
+  );
+
+  chunk->accounts = g_malloc(sizeof(InfAclAccount) * chunk->n_accounts);
+  for(i = 0; i < chunk->n_accounts; ++i)
+  {
+    chunk->accounts[i].id = accounts[i].id;
+    chunk->accounts[i].name = g_strdup(accounts[i].name);
+  }
+
+  chunk->succeeded = TRUE;
+}
+
+static void
+inf_test_account_range_chunk_clear(InfTestAccountRangeChunk* chunk)
+{
+  if(chunk->accounts != NULL)
+    inf_acl_account_array_free(chunk->accounts, chunk->n_accounts);
+  chunk->accounts = NULL;
+}
+
+/* Queries one chunk of accounts and checks its consistency with the
+ * cursor and the requested chunk size. */
+static gboolean
+inf_test_account_range_query(InfdDirectory* directory,
+                             const gchar* prefix,
+                             InfAclAccountId after,
+                             guint max,
+                             InfTestAccountRangeChunk* chunk)
+{
+  guint i;
+
+  chunk->accounts = NULL;
+  chunk->n_accounts = 0;
+  chunk->next = 0;
+  chunk->succeeded = FALSE;
+
+  inf_browser_query_acl_account_range(
+    INF_BROWSER(directory),
+    prefix,
+    after,
+    max,
+    inf_test_account_range_finished_cb,
+    chunk
+  );
+
+  /* The server-side directory answers synchronously */
+  if(chunk->succeeded == FALSE)
+    return FALSE;
+
+  if(chunk->n_accounts > max)
+  {
+    fprintf(stderr, "Chunk has %u accounts, max is %u\n",
+            chunk->n_accounts, max);
+    return FALSE;
+  }
+
+  if(chunk->next != 0 &&
+     (chunk->n_accounts != max ||
+      chunk->next != chunk->accounts[chunk->n_accounts - 1].id))
+  {
+    fprintf(stderr, "Cursor does not point to the end of a full chunk\n");
+    return FALSE;
+  }
+
+  for(i = 0; i < chunk->n_accounts; ++i)
+  {
+    if(inf_acl_account_id_compare(chunk->accounts[i].id, after) <= 0 ||
+       (i > 0 &&
+        inf_acl_account_id_compare(chunk->accounts[i - 1].id,
+                                   chunk->accounts[i].id) >= 0))
+    {
+      fprintf(stderr, "Accounts are not ordered after the cursor\n");
+      return FALSE;
+    }
+
+    if(prefix != NULL &&
+       (chunk->accounts[i].name == NULL ||
+        !g_str_has_prefix(chunk->accounts[i].name, prefix)))
+    {
+      fprintf(stderr, "Account \"%s\" does not match prefix \"%s\"\n",
+              chunk->accounts[i].name, prefix);
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+/* Walks through all accounts matching prefix in chunks of size max, and
+ * returns the number of accounts seen, or -1 on error. */
+static gint
+inf_test_account_range_walk(InfdDirectory* directory,
+                            const gchar* prefix,
+                            guint max)
+{
+  InfTestAccountRangeChunk chunk;
+  InfAclAccountId after;
+  guint total;
+
+  after = 0;
+  total = 0;
+
+  do
+  {
+    if(!inf_test_account_range_query(directory, prefix, after, max, &chunk))
+      return -1;
+
+    total += chunk.n_accounts;
+    after = chunk.next;
+    inf_test_account_range_chunk_clear(&chunk);
+  } while(after != 0);
+
+  return total;
+}
+
+static gboolean
+inf_test_account_range_add(InfdAccountStorage* storage,
+                           const gchar* name,
+                           guint n)
+{
+  GError* error;
+  gchar* account_name;
+  guint i;
+
+  error = NULL;
+  for(i = 0; i < n; ++i)
+  {
+    account_name = g_strdup_printf("%s%u", name, i);
+
+    infd_account_storage_add_account(
+      storage,
+      account_name,
+      NULL,
+      0,
+      NULL,
+      &error
+    );
+
+    g_free(account_name);
+
+    if(error != NULL)
+    {
+      fprintf(stderr, "Failed to add account: %s\n", error->message);
+      g_error_free(error);
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+static gboolean
+inf_test_account_range_run(InfdDirectory* directory,
+                           InfdAccountStorage* account_storage)
+{
+  InfTestAccountRangeChunk chunk;
+  InfAclAccountId cursor;
+  GError* error;
+  gint total;
+  gint n;
+
+  if(!inf_test_account_range_add(account_storage, "alice", 10) ||
+     !inf_test_account_range_add(account_storage, "bob", 5))
+  {
+    return FALSE;
+  }
+
+  /* Without a prefix, transient accounts such as the default account are
+   * listed as well, so all chunk sizes need to agree on the total. */
+  total = inf_test_account_range_walk(directory, NULL, 1000);
+  if(total < 15)
+  {
+    fprintf(stderr, "Expected at least 15 accounts, got %d\n", total);
+    return FALSE;
+  }
+
+  n = inf_test_account_range_walk(directory, NULL, 4);
+  if(n != total)
+  {
+    fprintf(stderr, "Paged walk returned %d of %d accounts\n", n, total);
+    return FALSE;
+  }
+
+  n = inf_test_account_range_walk(directory, NULL, 1);
+  if(n != total)
+  {
+    fprintf(stderr, "Paged walk returned %d of %d accounts\n", n, total);
+    return FALSE;
+  }
+
+  n = inf_test_account_range_walk(directory, "alice", 3);
+  if(n != 10)
+  {
+    fprintf(stderr, "Expected 10 accounts for \"alice\", got %d\n", n);
+    return FALSE;
+  }
+
+  n = inf_test_account_range_walk(directory, "bob", 2);
+  if(n != 5)
+  {
+    fprintf(stderr, "Expected 5 accounts for \"bob\", got %d\n", n);
+    return FALSE;
+  }
+
+  n = inf_test_account_range_walk(directory, "carol", 2);
+  if(n != 0)
+  {
+    fprintf(stderr, "Expected no accounts for \"carol\", got %d\n", n);
+    return FALSE;
+  }
+
+  /* A chunk that exactly covers the remaining accounts has no cursor */
+  if(!inf_test_account_range_query(directory, "bob", 0, 5, &chunk))
+    return FALSE;
+  inf_test_account_range_chunk_clear(&chunk);
+  if(chunk.n_accounts != 5 || chunk.next != 0)
+  {
+    fprintf(stderr, "Unexpected cursor after the last chunk\n");
+    return FALSE;
+  }
+
+  /* Continue after a cursor whose account has been removed in between */
+  if(!inf_test_account_range_query(directory, "bob", 0, 2, &chunk))
+    return FALSE;
+  cursor = chunk.next;
+  inf_test_account_range_chunk_clear(&chunk);
+
+  error = NULL;
+  if(!infd_account_storage_remove_account(account_storage, cursor, &error))
+  {
+    fprintf(stderr, "Failed to remove account: %s\n", error->message);
+    g_error_free(error);
+    return FALSE;
+  }
+
+  if(!inf_test_account_range_query(directory, "bob", cursor, 10, &chunk))
+    return FALSE;
+  inf_test_account_range_chunk_clear(&chunk);
+  if(chunk.n_accounts != 3 || chunk.next != 0)
+  {
+    fprintf(stderr, "Expected 3 accounts after removed cursor, got %u\n",
+            chunk.n_accounts);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+int
+main(int argc, char* argv[])
+{
+  InfStandaloneIo* io;
+  InfCommunicationManager* manager;
+  InfdFilesystemStorage* storage;
+  InfdFilesystemAccountStorage* account_storage;
+  InfdDirectory* directory;
+  GError* error;
+  gchar* root_directory;
+  gboolean result;
+  GDir* dir;
+  const gchar* entry;
+  gchar* entry_path;
+
+  error = NULL;
+  if(!inf_init(&error))
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return -1;
+  }
+
+  root_directory = g_dir_make_tmp("inf-test-account-range-XXXXXX", &error);
+  if(root_directory == NULL)
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return -1;
+  }
+
+  storage = infd_filesystem_storage_new(root_directory);
+  account_storage = infd_filesystem_account_storage_new();
+
+  result = infd_filesystem_account_storage_set_filesystem(
+    account_storage,
+    storage,
+    &error
+  );
+
+  if(result == FALSE)
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+  }
+
+  io = inf_standalone_io_new();
+  manager = inf_communication_manager_new();
+
+  directory = infd_directory_new(
+    INF_IO(io),
+    INFD_STORAGE(storage),
+    manager
+  );
+
+  infd_directory_set_account_storage(
+    directory,
+    INFD_ACCOUNT_STORAGE(account_storage)
+  );
+
+  if(result == TRUE)
+  {
+    result = inf_test_account_range_run(
+      directory,
+      INFD_ACCOUNT_STORAGE(account_storage)
+    );
+  }
+
+  g_object_unref(directory);
+  g_object_unref(manager);
+  g_object_unref(io);
+  g_object_unref(account_storage);
+  g_object_unref(storage);
+
+  dir = g_dir_open(root_directory, 0, NULL);
+  if(dir != NULL)
+  {
+    while((entry = g_dir_read_name(dir)) != NULL)
+    {
+      entry_path = g_build_filename(root_directory, entry, NULL);
+      g_unlink(entry_path);
+      g_free(entry_path);
+    }
+
+    g_dir_close(dir);
+  }
+
+  g_rmdir(root_directory);
+  g_free(root_directory);
+
+  inf_deinit();
+
+  if(result == FALSE)
+    return -1;
+
+  return 0;
+}
+
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,441 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Tests the connection limits of InfdAdmissionControl. The clients connect
+ * to a server on the loopback interface but never send a stream header, so
+ * that admitted connections stay in the handshake, and rejected connections
+ * need to be closed by the reject timeout. */
+
+#include <libinfinity/server/infd-admission-control.h>
+#include <libinfinity/server/infd-xmpp-server.h>
+#include <libinfinity/server/infd-tcp-server.h>
+#include <libinfinity/common/inf-tcp-connection.h>
+#include <libinfinity/common/inf-standalone-io.h>
+#include <libinfinity/common/inf-init.h>
+
+#include <stdio.h>
+
+/* Time to wait for something to happen before the test fails, in
+ * microseconds */
+#define INF_TEST_ADMISSION_CONTROL_TIMEOUT (5 * G_USEC_PER_SEC)
+
+typedef struct _InfTestAdmissionControl InfTestAdmissionControl;
+struct _InfTestAdmissionControl {
+  InfStandaloneIo* io;
+  InfIpAddress* address;
+  guint port;
+  InfdXmppServer* server;
+  InfdAdmissionControl* control;
+  GSList* clients;
+};
+
+typedef gboolean(*InfTestAdmissionControlCondition)(
+  InfTestAdmissionControl* test,
+  gpointer user_data);
+
+static guint64
+inf_test_admission_control_n_decided(InfTestAdmissionControl* test)
+{
+  InfdAdmissionControlStatistics statistics;
+  infd_admission_control_get_statistics(test->control, &statistics);
+
+  return statistics.n_admitted +
+    statistics.n_rejected_connections +
+    statistics.n_rejected_handshakes +
+    statistics.n_rejected_rate;
+}
+
+static gboolean
+inf_test_admission_control_decided(InfTestAdmissionControl* test,
+                                   gpointer user_data)
+{
+  return inf_test_admission_control_n_decided(test) >=
+    *(guint64*)user_data;
+}
+
+static gboolean
+inf_test_admission_control_client_closed(InfTestAdmissionControl* test,
+                                         gpointer user_data)
+{
+  InfTcpConnectionStatus status;
+  g_object_get(G_OBJECT(user_data), "status", &status, NULL);
+  return status == INF_TCP_CONNECTION_CLOSED;
+}
+
+static gboolean
+inf_test_admission_control_n_connections(InfTestAdmissionControl* test,
+                                         gpointer user_data)
+{
+  InfdAdmissionControlStatistics statistics;
+  infd_admission_control_get_statistics(test->control, &statistics);
+  return statistics.n_connections == GPOINTER_TO_UINT(user_data);
+}
+
+/* Runs the main loop until condition is met. Returns FALSE if it is not met
+ * in time. */
+static gboolean
+inf_test_admission_control_wait(InfTestAdmissionControl* test,
+                                InfTestAdmissionControlCondition condition,
+                                gpointer user_data)
+{
+  gint64 deadline;
+  deadline = g_get_monotonic_time() + INF_TEST_ADMISSION_CONTROL_TIMEOUT;
+
+  while(!condition(test, user_data))
+  {
+    if(g_get_monotonic_time() >= deadline)
+      return FALSE;
+
+    inf_standalone_io_iteration_timeout(test->io, 10);
+  }
+
+  return TRUE;
+}
+
+/* Runs the main loop for the given number of milliseconds */
+static void
+inf_test_admission_control_sleep(InfTestAdmissionControl* test,
+                                 guint msecs)
+{
+  gint64 deadline;
+  deadline = g_get_monotonic_time() + msecs * 1000;
+
+  while(g_get_monotonic_time() < deadline)
+    inf_standalone_io_iteration_timeout(test->io, 10);
+}
+
+/* Opens a new client connection, and waits until the server has decided
+ * whether to admit it. */
+static InfTcpConnection*
+inf_test_admission_control_connect(InfTestAdmissionControl* test)
+{
+  InfTcpConnection* client;
+  GError* error;
+  guint64 n_decided;
+
+  n_decided = inf_test_admission_control_n_decided(test) + 1;
+
+  error = NULL;
+  client = inf_tcp_connection_new_and_open(
+    INF_IO(test->io),
+    test->address,
+    test->port,
+    &error
+  );
+
+  if(client == NULL)
+  {
+    fprintf(stderr, "Failed to connect: %s\n", error->message);
+    g_error_free(error);
+    return NULL;
+  }
+
+  test->clients = g_slist_prepend(test->clients, client);
+
+  if(!inf_test_admission_control_wait(
+       test, inf_test_admission_control_decided, &n_decided))
+  {
+    fprintf(stderr, "Connection was neither admitted nor rejected\n");
+    return NULL;
+  }
+
+  return client;
+}
+
+/* Closes the given client, and waits until the server has noticed */
+static gboolean
+inf_test_admission_control_disconnect(InfTestAdmissionControl* test,
+                                      InfTcpConnection* client)
+{
+  InfdAdmissionControlStatistics statistics;
+  InfTcpConnectionStatus status;
+
+  infd_admission_control_get_statistics(test->control, &statistics);
+
+  g_object_get(G_OBJECT(client), "status", &status, NULL);
+  if(status != INF_TCP_CONNECTION_CLOSED)
+    inf_tcp_connection_close(client);
+
+  test->clients = g_slist_remove(test->clients, client);
+  g_object_unref(client);
+
+  if(!inf_test_admission_control_wait(
+       test,
+       inf_test_admission_control_n_connections,
+       GUINT_TO_POINTER(statistics.n_connections - 1)))
+  {
+    fprintf(stderr, "Server did not notice the closed connection\n");
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Checks that a rejected client is disconnected by the server */
+static gboolean
+inf_test_admission_control_check_rejected(InfTestAdmissionControl* test,
+                                          InfTcpConnection* client)
+{
+  if(!inf_test_admission_control_wait(
+       test, inf_test_admission_control_client_closed, client))
+  {
+    fprintf(stderr, "Rejected connection was not closed\n");
+    return FALSE;
+  }
+
+  test->clients = g_slist_remove(test->clients, client);
+  g_object_unref(client);
+  return TRUE;
+}
+
+/* Disconnects all clients and installs a new admission control with the
+ * given limits */
+static gboolean
+inf_test_admission_control_reset(InfTestAdmissionControl* test,
+                                 guint max_connections,
+                                 guint max_handshakes,
+                                 guint connection_rate,
+                                 guint connection_burst)
+{
+  while(test->clients != NULL)
+  {
+    if(!inf_test_admission_control_disconnect(test, test->clients->data))
+      return FALSE;
+  }
+
+  if(test->control != NULL)
+    g_object_unref(test->control);
+
+  test->control = INFD_ADMISSION_CONTROL(
+    g_object_new(
+      INFD_TYPE_ADMISSION_CONTROL,
+      "max-connections", max_connections,
+      "max-handshakes", max_handshakes,
+      "connection-rate", connection_rate,
+      "connection-burst", connection_burst,
+      "reject-timeout", 100,
+      NULL
+    )
+  );
+
+  g_object_set(
+    G_OBJECT(test->server),
+    "admission-control", test->control,
+    NULL
+  );
+
+  return TRUE;
+}
+
+static gboolean
+inf_test_admission_control_check(InfTestAdmissionControl* test,
+                                 guint n_connections,
+                                 guint64 n_admitted,
+                                 guint64 n_rejected_connections,
+                                 guint64 n_rejected_handshakes,
+                                 guint64 n_rejected_rate)
+{
+  InfdAdmissionControlStatistics statistics;
+  infd_admission_control_get_statistics(test->control, &statistics);
+
+  if(statistics.n_connections != n_connections ||
+     statistics.n_admitted != n_admitted ||
+     statistics.n_rejected_connections != n_rejected_connections ||
+     statistics.n_rejected_handshakes != n_rejected_handshakes ||
+     statistics.n_rejected_rate != n_rejected_rate)
+  {
+    fprintf(
+      stderr,
+      "Unexpected statistics: %u connections, %" G_GUINT64_FORMAT " "
+      "admitted, %" G_GUINT64_FORMAT "/%" G_GUINT64_FORMAT "/"
+      "%" G_GUINT64_FORMAT " rejected for connections/handshakes/rate\n",
+      statistics.n_connections,
+      statistics.n_admitted,
+      statistics.n_rejected_connections,
+      statistics.n_rejected_handshakes,
+      statistics.n_rejected_rate
+    );
+
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+inf_test_admission_control_max_connections(InfTestAdmissionControl* test)
+{
+  InfTcpConnection* first;
+  InfTcpConnection* rejected;
+
+  if(!inf_test_admission_control_reset(test, 2, 0, 0, 10))
+    return FALSE;
+
+  first = inf_test_admission_control_connect(test);
+  if(first == NULL) return FALSE;
+  if(inf_test_admission_control_connect(test) == NULL) return FALSE;
+  rejected = inf_test_admission_control_connect(test);
+  if(rejected == NULL) return FALSE;
+
+  if(!inf_test_admission_control_check(test, 2, 2, 1, 0, 0))
+    return FALSE;
+  if(!inf_test_admission_control_check_rejected(test, rejected))
+    return FALSE;
+
+  /* Another client can connect once one has disconnected */
+  if(!inf_test_admission_control_disconnect(test, first))
+    return FALSE;
+  if(inf_test_admission_control_connect(test) == NULL)
+    return FALSE;
+
+  return inf_test_admission_control_check(test, 2, 3, 1, 0, 0);
+}
+
+static gboolean
+inf_test_admission_control_max_handshakes(InfTestAdmissionControl* test)
+{
+  InfTcpConnection* rejected;
+
+  if(!inf_test_admission_control_reset(test, 0, 2, 0, 10))
+    return FALSE;
+
+  /* None of the clients completes its handshake */
+  if(inf_test_admission_control_connect(test) == NULL) return FALSE;
+  if(inf_test_admission_control_connect(test) == NULL) return FALSE;
+  rejected = inf_test_admission_control_connect(test);
+  if(rejected == NULL) return FALSE;
+
+  if(!inf_test_admission_control_check(test, 2, 2, 0, 1, 0))
+    return FALSE;
+
+  return inf_test_admission_control_check_rejected(test, rejected);
+}
+
+static gboolean
+inf_test_admission_control_rate(InfTestAdmissionControl* test)
+{
+  InfTcpConnection* rejected;
+
+  /* One connection per second, after a burst of two */
+  if(!inf_test_admission_control_reset(test, 0, 0, 60, 2))
+    return FALSE;
+
+  if(inf_test_admission_control_connect(test) == NULL) return FALSE;
+  if(inf_test_admission_control_connect(test) == NULL) return FALSE;
+  rejected = inf_test_admission_control_connect(test);
+  if(rejected == NULL) return FALSE;
+
+  if(!inf_test_admission_control_check(test, 2, 2, 0, 0, 1))
+    return FALSE;
+  if(!inf_test_admission_control_check_rejected(test, rejected))
+    return FALSE;
+
+  /* After a second, there is a token for one more connection */
+  inf_test_admission_control_sleep(test, 1100);
+
+  if(inf_test_admission_control_connect(test) == NULL) return FALSE;
+  rejected = inf_test_admission_control_connect(test);
+  if(rejected == NULL) return FALSE;
+
+  if(!inf_test_admission_control_check(test, 3, 3, 0, 0, 2))
+    return FALSE;
+
+  return inf_test_admission_control_check_rejected(test, rejected);
+}
+
+int
+main(int argc, char* argv[])
+{
+  InfTestAdmissionControl test;
+  InfdTcpServer* tcp_server;
+  GError* error;
+  gboolean result;
+
+  error = NULL;
+  if(!inf_init(&error))
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return -1;
+  }
+
+  test.io = inf_standalone_io_new();
+  test.address = inf_ip_address_new_loopback4();
+  test.control = NULL;
+  test.clients = NULL;
+
+  tcp_server = g_object_new(
+    INFD_TYPE_TCP_SERVER,
+    "io", test.io,
+    "local-address", test.address,
+    "local-port", 0,
+    NULL
+  );
+
+  if(!infd_tcp_server_open(tcp_server, &error))
+  {
+    fprintf(stderr, "Could not open server: %s\n", error->message);
+    g_error_free(error);
+
+    g_object_unref(tcp_server);
+    inf_ip_address_free(test.address);
+    g_object_unref(test.io);
+    inf_deinit();
+    return -1;
+  }
+
+  g_object_get(G_OBJECT(tcp_server), "local-port", &test.port, NULL);
+
+  test.server = infd_xmpp_server_new(
+    tcp_server,
+    INF_XMPP_CONNECTION_SECURITY_ONLY_UNSECURED,
+    NULL,
+    NULL,
+    NULL
+  );
+
+  result = inf_test_admission_control_max_connections(&test) &&
+    inf_test_admission_control_max_handshakes(&test) &&
+    inf_test_admission_control_rate(&test);
+
+  while(test.clients != NULL)
+  {
+    g_object_unref(test.clients->data);
+    test.clients = g_slist_delete_link(test.clients, test.clients);
+  }
+
+  infd_xml_server_close(INFD_XML_SERVER(test.server));
+  g_object_unref(test.server);
+  g_object_unref(tcp_server);
+
+  if(test.control != NULL)
+    g_object_unref(test.control);
+
+  inf_ip_address_free(test.address);
+  g_object_unref(test.io);
+
+  inf_deinit();
+
+  if(result == FALSE)
+    return -1;
+
+  return 0;
+}
+
+/* vim:set et sw=2 ts=2: */
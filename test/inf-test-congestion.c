@@ -0,0 +1,534 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Tests the handling of slow consumers: the send queue watermarks of
+ * InfTcpConnection, the hand-over of held back messages by
+ * InfCommunicationRegistry to connections that detect congestion, and
+ * InfdSessionProxy:drop-congested. */
+
+#include <libinfinity/server/infd-session-proxy.h>
+#include <libinfinity/server/infd-tcp-server.h>
+#include <libinfinity/communication/inf-communication-manager.h>
+#include <libinfinity/common/inf-simulated-connection.h>
+#include <libinfinity/common/inf-tcp-connection.h>
+#include <libinfinity/common/inf-standalone-io.h>
+#include <libinfinity/common/inf-chat-session.h>
+#include <libinfinity/common/inf-chat-buffer.h>
+#include <libinfinity/common/inf-init.h>
+
+#include <string.h>
+#include <stdio.h>
+
+/* Time to wait for something to happen before the test fails, in
+ * microseconds */
+#define INF_TEST_CONGESTION_TIMEOUT (10 * G_USEC_PER_SEC)
+
+/* Watermarks for the TCP test, in bytes */
+#define INF_TEST_CONGESTION_HIGH_WATERMARK (256 * 1024)
+#define INF_TEST_CONGESTION_LOW_WATERMARK (64 * 1024)
+
+/* Amount of data sent at once, and in total at most, in the TCP test */
+#define INF_TEST_CONGESTION_CHUNK_SIZE (64 * 1024)
+#define INF_TEST_CONGESTION_MAX_SIZE (256 * 1024 * 1024)
+
+/* Number of messages sent to a group member in the registry test */
+#define INF_TEST_CONGESTION_N_MESSAGES 100
+
+static const gchar* const INF_TEST_CONGESTION_METHODS[] = {
+  "central",
+  NULL
+};
+
+typedef struct _InfTestCongestionTcp InfTestCongestionTcp;
+struct _InfTestCongestionTcp {
+  InfStandaloneIo* server_io;
+  InfStandaloneIo* client_io;
+  InfTcpConnection* accepted;
+  guint n_changes;
+};
+
+static void
+inf_test_congestion_new_connection_cb(InfdTcpServer* server,
+                                      InfTcpConnection* connection,
+                                      gpointer user_data)
+{
+  InfTestCongestionTcp* test;
+  test = (InfTestCongestionTcp*)user_data;
+
+  if(test->accepted == NULL)
+    test->accepted = g_object_ref(connection);
+}
+
+static void
+inf_test_congestion_notify_congested_cb(GObject* object,
+                                        GParamSpec* pspec,
+                                        gpointer user_data)
+{
+  InfTestCongestionTcp* test;
+  test = (InfTestCongestionTcp*)user_data;
+
+  ++test->n_changes;
+}
+
+static void
+inf_test_congestion_count_received_cb(InfXmlConnection* connection,
+                                      xmlNodePtr xml,
+                                      gpointer user_data)
+{
+  xmlNodePtr child;
+
+  for(child = xml->children; child != NULL; child = child->next)
+    if(strcmp((const char*)child->name, "test-message") == 0)
+      ++*(guint*)user_data;
+}
+
+/* Runs both main loops once. The client only reads data while its main
+ * loop is running. */
+static void
+inf_test_congestion_tcp_iteration(InfTestCongestionTcp* test)
+{
+  inf_standalone_io_iteration_timeout(test->server_io, 0);
+  inf_standalone_io_iteration_timeout(test->client_io, 10);
+}
+
+static gboolean
+inf_test_congestion_tcp_run(InfTestCongestionTcp* test,
+                            InfTcpConnection* client)
+{
+  InfTcpConnectionStatus status;
+  guint high_watermark;
+  guint low_watermark;
+  gchar* chunk;
+  gsize total;
+  gint64 deadline;
+
+  deadline = g_get_monotonic_time() + INF_TEST_CONGESTION_TIMEOUT;
+  do
+  {
+    if(g_get_monotonic_time() >= deadline)
+    {
+      fprintf(stderr, "Client connection was not established\n");
+      return FALSE;
+    }
+
+    inf_test_congestion_tcp_iteration(test);
+    g_object_get(G_OBJECT(client), "status", &status, NULL);
+  } while(test->accepted == NULL || status != INF_TCP_CONNECTION_CONNECTED);
+
+  g_object_get(
+    G_OBJECT(test->accepted),
+    "send-queue-high-watermark", &high_watermark,
+    "send-queue-low-watermark", &low_watermark,
+    NULL
+  );
+
+  if(high_watermark != INF_TEST_CONGESTION_HIGH_WATERMARK ||
+     low_watermark != INF_TEST_CONGESTION_LOW_WATERMARK)
+  {
+    fprintf(stderr, "Server did not apply the watermarks\n");
+    return FALSE;
+  }
+
+  if(inf_tcp_connection_get_congested(test->accepted))
+  {
+    fprintf(stderr, "New connection is congested\n");
+    return FALSE;
+  }
+
+  g_signal_connect(
+    G_OBJECT(test->accepted),
+    "notify::congested",
+    G_CALLBACK(inf_test_congestion_notify_congested_cb),
+    test
+  );
+
+  /* The client does not read, so that the data piles up in the kernel's
+   * socket buffers first, and then in the server's send queue. */
+  chunk = g_malloc0(INF_TEST_CONGESTION_CHUNK_SIZE);
+  for(total = 0; total < INF_TEST_CONGESTION_MAX_SIZE &&
+                 !inf_tcp_connection_get_congested(test->accepted);
+      total += INF_TEST_CONGESTION_CHUNK_SIZE)
+  {
+    inf_tcp_connection_send(
+      test->accepted,
+      chunk,
+      INF_TEST_CONGESTION_CHUNK_SIZE
+    );
+
+    inf_standalone_io_iteration_timeout(test->server_io, 0);
+  }
+
+  g_free(chunk);
+
+  if(!inf_tcp_connection_get_congested(test->accepted) ||
+     test->n_changes != 1)
+  {
+    fprintf(stderr, "Connection did not become congested\n");
+    return FALSE;
+  }
+
+  if(inf_tcp_connection_get_send_queue_length(test->accepted) <=
+     INF_TEST_CONGESTION_HIGH_WATERMARK)
+  {
+    fprintf(stderr, "Connection is congested below the high watermark\n");
+    return FALSE;
+  }
+
+  /* Let the client read until the send queue has drained to the low
+   * watermark */
+  deadline = g_get_monotonic_time() + INF_TEST_CONGESTION_TIMEOUT;
+  while(inf_tcp_connection_get_congested(test->accepted))
+  {
+    if(g_get_monotonic_time() >= deadline)
+    {
+      fprintf(stderr, "Congestion was not cleared\n");
+      return FALSE;
+    }
+
+    inf_test_congestion_tcp_iteration(test);
+  }
+
+  if(test->n_changes != 2)
+  {
+    fprintf(stderr, "Unexpected number of congestion changes\n");
+    return FALSE;
+  }
+
+  if(inf_tcp_connection_get_send_queue_length(test->accepted) >
+     INF_TEST_CONGESTION_LOW_WATERMARK)
+  {
+    fprintf(stderr, "Congestion cleared above the low watermark\n");
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+inf_test_congestion_tcp(void)
+{
+  InfTestCongestionTcp test;
+  InfIpAddress* address;
+  InfdTcpServer* server;
+  InfTcpConnection* client;
+  GError* error;
+  guint port;
+  gboolean result;
+
+  test.server_io = inf_standalone_io_new();
+  test.client_io = inf_standalone_io_new();
+  test.accepted = NULL;
+  test.n_changes = 0;
+
+  address = inf_ip_address_new_loopback4();
+
+  server = g_object_new(
+    INFD_TYPE_TCP_SERVER,
+    "io", test.server_io,
+    "local-address", address,
+    "local-port", 0,
+    "send-queue-high-watermark", INF_TEST_CONGESTION_HIGH_WATERMARK,
+    "send-queue-low-watermark", INF_TEST_CONGESTION_LOW_WATERMARK,
+    NULL
+  );
+
+  g_signal_connect(
+    G_OBJECT(server),
+    "new-connection",
+    G_CALLBACK(inf_test_congestion_new_connection_cb),
+    &test
+  );
+
+  error = NULL;
+  client = NULL;
+  result = infd_tcp_server_open(server, &error);
+
+  if(result == TRUE)
+  {
+    g_object_get(G_OBJECT(server), "local-port", &port, NULL);
+
+    client = inf_tcp_connection_new_and_open(
+      INF_IO(test.client_io),
+      address,
+      port,
+      &error
+    );
+
+    result = (client != NULL);
+  }
+
+  if(result == FALSE)
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+  }
+  else
+  {
+    result = inf_test_congestion_tcp_run(&test, client);
+  }
+
+  if(test.accepted != NULL)
+  {
+    inf_tcp_connection_close(test.accepted);
+    g_object_unref(test.accepted);
+  }
+
+  if(client != NULL)
+  {
+    inf_tcp_connection_close(client);
+    g_object_unref(client);
+  }
+
+  infd_tcp_server_close(server);
+  g_object_unref(server);
+  inf_ip_address_free(address);
+  g_object_unref(test.client_io);
+  g_object_unref(test.server_io);
+
+  return result;
+}
+
+/* Sends many messages to a connection that does not send them, cancels
+ * them, and checks how many of them arrive after all. */
+static gboolean
+inf_test_congestion_registry(InfCommunicationManager* manager,
+                             gboolean detects_congestion,
+                             guint expected)
+{
+  InfSimulatedConnection* server;
+  InfSimulatedConnection* client;
+  InfCommunicationHostedGroup* group;
+  xmlNodePtr xml;
+  guint received;
+  guint i;
+
+  server = inf_simulated_connection_new();
+  client = inf_simulated_connection_new();
+  inf_simulated_connection_connect(server, client);
+  inf_simulated_connection_set_mode(server, INF_SIMULATED_CONNECTION_DELAYED);
+  inf_simulated_connection_set_detects_congestion(server, detects_congestion);
+
+  received = 0;
+  g_signal_connect(
+    G_OBJECT(client),
+    "received",
+    G_CALLBACK(inf_test_congestion_count_received_cb),
+    &received
+  );
+
+  group = inf_communication_manager_open_group(
+    manager,
+    "InfTestCongestion",
+    INF_TEST_CONGESTION_METHODS
+  );
+
+  inf_communication_hosted_group_add_member(
+    group,
+    INF_XML_CONNECTION(server)
+  );
+
+  for(i = 0; i < INF_TEST_CONGESTION_N_MESSAGES; ++i)
+  {
+    xml = xmlNewNode(NULL, (const xmlChar*)"test-message");
+
+    inf_communication_group_send_message(
+      INF_COMMUNICATION_GROUP(group),
+      INF_XML_CONNECTION(server),
+      xml
+    );
+  }
+
+  inf_communication_group_cancel_messages(
+    INF_COMMUNICATION_GROUP(group),
+    INF_XML_CONNECTION(server)
+  );
+
+  inf_simulated_connection_flush(server);
+
+  inf_communication_hosted_group_remove_member(
+    group,
+    INF_XML_CONNECTION(server)
+  );
+
+  g_object_unref(group);
+  inf_xml_connection_close(INF_XML_CONNECTION(server));
+  g_object_unref(client);
+  g_object_unref(server);
+
+  if(received != expected)
+  {
+    fprintf(
+      stderr,
+      "%u of %u messages arrived after cancellation, expected %u\n",
+      received,
+      INF_TEST_CONGESTION_N_MESSAGES,
+      expected
+    );
+
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Subscribes a connection to a session, and lets it become congested. If
+ * clear is TRUE, the congestion is cleared again before the main loop
+ * runs. */
+static gboolean
+inf_test_congestion_drop(InfCommunicationManager* manager,
+                         gboolean drop_congested,
+                         gboolean clear,
+                         gboolean expect_subscribed)
+{
+  InfStandaloneIo* io;
+  InfSimulatedConnection* server;
+  InfSimulatedConnection* client;
+  InfCommunicationHostedGroup* group;
+  InfChatBuffer* buffer;
+  InfChatSession* session;
+  InfdSessionProxy* proxy;
+  gboolean subscribed;
+  gboolean member;
+
+  io = inf_standalone_io_new();
+
+  server = inf_simulated_connection_new();
+  client = inf_simulated_connection_new();
+  inf_simulated_connection_connect(server, client);
+  inf_simulated_connection_set_mode(server, INF_SIMULATED_CONNECTION_DELAYED);
+  inf_simulated_connection_set_detects_congestion(server, TRUE);
+
+  buffer = inf_chat_buffer_new(16);
+  session = inf_chat_session_new(
+    manager,
+    buffer,
+    INF_SESSION_RUNNING,
+    NULL,
+    NULL
+  );
+  g_object_unref(buffer);
+
+  group = inf_communication_manager_open_group(
+    manager,
+    "InfTestCongestionSession",
+    INF_TEST_CONGESTION_METHODS
+  );
+
+  proxy = INFD_SESSION_PROXY(
+    g_object_new(
+      INFD_TYPE_SESSION_PROXY,
+      "io", io,
+      "session", session,
+      "subscription-group", group,
+      "drop-congested", drop_congested,
+      NULL
+    )
+  );
+
+  inf_communication_group_set_target(
+    INF_COMMUNICATION_GROUP(group),
+    INF_COMMUNICATION_OBJECT(proxy)
+  );
+
+  infd_session_proxy_subscribe_to(
+    proxy,
+    INF_XML_CONNECTION(server),
+    1,
+    FALSE
+  );
+
+  inf_simulated_connection_set_congested(server, TRUE);
+  if(clear == TRUE)
+    inf_simulated_connection_set_congested(server, FALSE);
+
+  /* The subscription is dropped from a dispatch handler */
+  inf_standalone_io_iteration_timeout(io, 0);
+
+  subscribed = infd_session_proxy_is_subscribed(
+    proxy,
+    INF_XML_CONNECTION(server)
+  );
+
+  member = inf_communication_group_is_member(
+    INF_COMMUNICATION_GROUP(group),
+    INF_XML_CONNECTION(server)
+  );
+
+  g_object_unref(proxy);
+  g_object_unref(group);
+  g_object_unref(session);
+
+  inf_xml_connection_close(INF_XML_CONNECTION(server));
+  g_object_unref(client);
+  g_object_unref(server);
+  g_object_unref(io);
+
+  if(subscribed != expect_subscribed || member != expect_subscribed)
+  {
+    fprintf(
+      stderr,
+      "Congested connection is %ssubscribed, but expected %ssubscribed\n",
+      subscribed ? "" : "not ",
+      expect_subscribed ? "" : "not "
+    );
+
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+int
+main(int argc, char* argv[])
+{
+  InfCommunicationManager* manager;
+  GError* error;
+  gboolean result;
+
+  error = NULL;
+  if(!inf_init(&error))
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return -1;
+  }
+
+  manager = inf_communication_manager_new();
+
+  /* Without congestion detection, all held back messages can be cancelled,
+   * only the first one has already been passed to the connection. With it,
+   * the held back messages are passed on as well once 64 of them have piled
+   * up. */
+  result = inf_test_congestion_registry(manager, FALSE, 1) &&
+    inf_test_congestion_registry(manager, TRUE, 65) &&
+    inf_test_congestion_drop(manager, TRUE, FALSE, FALSE) &&
+    inf_test_congestion_drop(manager, TRUE, TRUE, TRUE) &&
+    inf_test_congestion_drop(manager, FALSE, FALSE, TRUE) &&
+    inf_test_congestion_tcp();
+
+  g_object_unref(manager);
+  inf_deinit();
+
+  if(result == FALSE)
+    return -1;
+
+  return 0;
+}
+
+/* vim:set et sw=2 ts=2: */
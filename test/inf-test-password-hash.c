@@ -0,0 +1,305 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Checks the PBKDF2-HMAC-SHA256 password hashes of
+ * InfdFilesystemAccountStorage against known test vectors, and that
+ * passwords keep working after they have been re-hashed on login. */
+
+#include <libinfinity/server/infd-filesystem-storage.h>
+#include <libinfinity/server/infd-filesystem-account-storage.h>
+#include <libinfinity/common/inf-xml-util.h>
+#include <libinfinity/common/inf-init.h>
+
+#include <glib/gstdio.h>
+#include <string.h>
+#include <stdio.h>
+
+typedef struct _InfTestPasswordHashVector InfTestPasswordHashVector;
+struct _InfTestPasswordHashVector {
+  const gchar* password;
+  guint iterations;
+  const gchar* hash;
+};
+
+/* The salt is "saltSALTsaltSALTsaltSALTsaltSALT" for all vectors, since the
+ * storage uses salts of the size of the hash. The hashes have been computed
+ * with an independent PBKDF2-HMAC-SHA256 implementation, which reproduces
+ * the vectors from RFC 7914, section 11. */
+static const gchar INF_TEST_PASSWORD_HASH_SALT[] =
+  "73616c7453414c5473616c7453414c5473616c7453414c5473616c7453414c54";
+
+static const InfTestPasswordHashVector INF_TEST_PASSWORD_HASH_VECTORS[] = {
+  {
+    "password",
+    1,
+    "a9a3982f90f9a5fe5917c2301eb75292d1b1f24f6e0a2f0e8d3fdc46bd0f96ea"
+  }, {
+    "password",
+    2,
+    "10149b45ba472aa5e5a46e146bcd5e2c48dda2a7501d5442b0cd9d7b6a83967b"
+  }, {
+    "password",
+    4096,
+    "fe9f0c28d88ea8f1ef31b47740308ea3465f680e646216c850cb3dbfa8fbbeaf"
+  }, {
+    "passwordPASSWORDpassword",
+    4096,
+    "1c17fbba0726de612cd5b679961ff5bc64472d112e7c604faabd94c20919773e"
+  }
+};
+
+/* Password hashes of new accounts use this number of iterations, so that
+ * the accounts with other numbers of iterations are re-hashed on login */
+#define INF_TEST_PASSWORD_HASH_ITERATIONS 4096
+
+static gboolean
+inf_test_password_hash_write_accounts(InfdFilesystemStorage* storage,
+                                      GError** error)
+{
+  xmlNodePtr root;
+  xmlNodePtr child;
+  xmlDocPtr doc;
+  gchar* name;
+  gboolean result;
+  guint i;
+
+  root = xmlNewNode(NULL, (const xmlChar*)"inf-acl-account-list");
+
+  for(i = 0; i < G_N_ELEMENTS(INF_TEST_PASSWORD_HASH_VECTORS); ++i)
+  {
+    name = g_strdup_printf("vector%u", i);
+    child = xmlNewChild(root, NULL, (const xmlChar*)"account", NULL);
+    inf_xml_util_set_attribute(child, "id", name);
+    inf_xml_util_set_attribute(child, "name", name);
+    g_free(name);
+
+    inf_xml_util_set_attribute(
+      child,
+      "password-salt",
+      INF_TEST_PASSWORD_HASH_SALT
+    );
+
+    inf_xml_util_set_attribute(
+      child,
+      "password-hash",
+      INF_TEST_PASSWORD_HASH_VECTORS[i].hash
+    );
+
+    inf_xml_util_set_attribute(child, "password-kdf", "pbkdf2-sha256");
+
+    inf_xml_util_set_attribute_uint(
+      child,
+      "password-iterations",
+      INF_TEST_PASSWORD_HASH_VECTORS[i].iterations
+    );
+  }
+
+  doc = xmlNewDoc((const xmlChar*)"1.0");
+  xmlDocSetRootElement(doc, root);
+
+  result = infd_filesystem_storage_write_xml_file(
+    storage,
+    "xml",
+    "accounts",
+    doc,
+    error
+  );
+
+  xmlFreeDoc(doc);
+  return result;
+}
+
+static gboolean
+inf_test_password_hash_login(InfdAccountStorage* storage,
+                             guint index,
+                             const gchar* password,
+                             gboolean expected)
+{
+  InfAclAccountId account;
+  GError* error;
+  gchar* name;
+
+  name = g_strdup_printf("vector%u", index);
+
+  error = NULL;
+  account = infd_account_storage_login_by_password(
+    storage,
+    name,
+    password,
+    &error
+  );
+
+  if(error != NULL)
+  {
+    fprintf(stderr, "Login of %s failed: %s\n", name, error->message);
+    g_error_free(error);
+    g_free(name);
+    return FALSE;
+  }
+
+  if( (account != 0) != expected)
+  {
+    fprintf(
+      stderr,
+      "Login of %s with password \"%s\" %s unexpectedly\n",
+      name,
+      password,
+      account != 0 ? "succeeded" : "failed"
+    );
+
+    g_free(name);
+    return FALSE;
+  }
+
+  if(account != 0 && account != inf_acl_account_id_from_string(name))
+  {
+    fprintf(stderr, "Login of %s returned a different account\n", name);
+    g_free(name);
+    return FALSE;
+  }
+
+  g_free(name);
+  return TRUE;
+}
+
+static gboolean
+inf_test_password_hash_run(InfdFilesystemAccountStorage* account_storage)
+{
+  InfdAccountStorage* storage;
+  guint i;
+
+  storage = INFD_ACCOUNT_STORAGE(account_storage);
+
+  for(i = 0; i < G_N_ELEMENTS(INF_TEST_PASSWORD_HASH_VECTORS); ++i)
+  {
+    if(!inf_test_password_hash_login(storage, i, "Password", FALSE))
+      return FALSE;
+    if(!inf_test_password_hash_login(storage, i, "", FALSE))
+      return FALSE;
+
+    /* The first login checks the hash from the vector, and re-hashes the
+     * password if it uses a different number of iterations. The second
+     * login checks the new hash. */
+    if(!inf_test_password_hash_login(
+         storage, i, INF_TEST_PASSWORD_HASH_VECTORS[i].password, TRUE))
+    {
+      return FALSE;
+    }
+
+    if(!inf_test_password_hash_login(
+         storage, i, INF_TEST_PASSWORD_HASH_VECTORS[i].password, TRUE))
+    {
+      return FALSE;
+    }
+
+    if(!inf_test_password_hash_login(storage, i, "Password", FALSE))
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+int
+main(int argc, char* argv[])
+{
+  InfdFilesystemStorage* storage;
+  InfdFilesystemAccountStorage* account_storage;
+  GError* error;
+  gchar* root_directory;
+  gboolean result;
+  GDir* dir;
+  const gchar* entry;
+  gchar* entry_path;
+
+  error = NULL;
+  if(!inf_init(&error))
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return -1;
+  }
+
+  root_directory = g_dir_make_tmp("inf-test-password-hash-XXXXXX", &error);
+  if(root_directory == NULL)
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return -1;
+  }
+
+  storage = infd_filesystem_storage_new(root_directory);
+
+  /* Disable the credential cache so that every login checks the hash */
+  account_storage = INFD_FILESYSTEM_ACCOUNT_STORAGE(
+    g_object_new(
+      INFD_TYPE_FILESYSTEM_ACCOUNT_STORAGE,
+      "password-iterations", INF_TEST_PASSWORD_HASH_ITERATIONS,
+      "credential-cache-timeout", 0,
+      NULL
+    )
+  );
+
+  result = inf_test_password_hash_write_accounts(storage, &error);
+  if(result == TRUE)
+  {
+    result = infd_filesystem_account_storage_set_filesystem(
+      account_storage,
+      storage,
+      &error
+    );
+  }
+
+  if(result == FALSE)
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+  }
+  else
+  {
+    result = inf_test_password_hash_run(account_storage);
+  }
+
+  g_object_unref(account_storage);
+  g_object_unref(storage);
+
+  dir = g_dir_open(root_directory, 0, NULL);
+  if(dir != NULL)
+  {
+    while((entry = g_dir_read_name(dir)) != NULL)
+    {
+      entry_path = g_build_filename(root_directory, entry, NULL);
+      g_unlink(entry_path);
+      g_free(entry_path);
+    }
+
+    g_dir_close(dir);
+  }
+
+  g_rmdir(root_directory);
+  g_free(root_directory);
+
+  inf_deinit();
+
+  if(result == FALSE)
+    return -1;
+
+  return 0;
+}
+
+/* vim:set et sw=2 ts=2: */
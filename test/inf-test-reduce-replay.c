@@ -17,10 +17,17 @@
  * MA 02110-1301, USA.
  */
 
-/* Cuts away front and back of a replay, so that it still fails. It's very
- * primitive, and more sophisticated methods can still be implemented. */
-
-/* TODO: Break as soon as either (stderr) output or exit status changes */
+/* Reduces a failing session record to a smaller record that still fails in
+ * the same way, i.e. with the same exit status and the same last line of
+ * error output. By default, user joins and then single requests are removed
+ * with the ddmin delta debugging algorithm. The vector times of the
+ * remaining requests are renumbered, so that the reduced record stays
+ * causally consistent. Candidate records are replayed with
+ * inf-test-text-replay in parallel worker processes.
+ *
+ * With --linear, front and back of the record are cut away one request at a
+ * time instead, which keeps the exact request vectors, but requires one
+ * replay per request. */
 
 #include "util/inf-test-util.h"
 
@@ -33,13 +40,78 @@
 
 #include <glib/gstdio.h>
 
-#ifndef G_OS_WIN32
-# include <sys/wait.h>
-#endif
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <string.h>
+#include <stdlib.h>
+#include <errno.h>
 
 static const gchar REPLAY[] = ".libs/inf-test-text-replay";
 
+typedef enum _InfTestReduceReplayOutcome {
+  /* The replay succeeds */
+  INF_TEST_REDUCE_REPLAY_PASS,
+  /* The replay fails in the same way as the original record */
+  INF_TEST_REDUCE_REPLAY_FAIL,
+  /* The replay fails differently, or the record is not valid */
+  INF_TEST_REDUCE_REPLAY_OTHER
+} InfTestReduceReplayOutcome;
+
+typedef struct _InfTestReduceReplayItem InfTestReduceReplayItem;
+struct _InfTestReduceReplayItem {
+  xmlNodePtr xml;
+  guint user_id;
+  gboolean join;
+  /* Absolute vector time of the request, or of the user join */
+  InfAdoptedStateVector* time;
+};
+
+typedef struct _InfTestReduceReplayUser InfTestReduceReplayUser;
+struct _InfTestReduceReplayUser {
+  /* Item index of the user join, or -1 for users in the initial */
+  gint join;
+  /* Vector time of users in the initial, NULL for joined users */
+  InfAdoptedStateVector* initial;
+  /* Own vector component of the user's first request */
+  guint first;
+  guint n_requests;
+  /* map[k] is the number of kept requests among the first k */
+  guint* map;
+};
+
+typedef struct _InfTestReduceReplayCandidate InfTestReduceReplayCandidate;
+struct _InfTestReduceReplayCandidate {
+  xmlDocPtr doc;
+  gchar* filename;
+  gchar* output;
+  pid_t pid;
+  InfTestReduceReplayOutcome outcome;
+};
+
+typedef struct _InfTestReduceReplay InfTestReduceReplay;
+struct _InfTestReduceReplay {
+  guint jobs;
+  gchar* tmpdir;
+  InfTestReduceReplayCandidate* candidates;
+  gchar* signature;
+  guint n_runs;
+
+  /* The record without requests and user joins */
+  xmlDocPtr skeleton;
+  GArray* items;
+  GHashTable* users;
+  /* Items that are part of the currently smallest failing record */
+  gboolean* base;
+};
+
+typedef struct _InfTestReduceReplayRemapData InfTestReduceReplayRemapData;
+struct _InfTestReduceReplayRemapData {
+  InfTestReduceReplay* reducer;
+  InfAdoptedStateVector* result;
+};
+
 typedef struct _InfTestReduceReplayValidateUserData
   InfTestReduceReplayValidateUserData;
 struct _InfTestReduceReplayValidateUserData {
@@ -373,64 +445,201 @@ inf_test_reduce_replay_validate_test(xmlDocPtr doc,
   return TRUE;
 }
 
-static gboolean
-inf_test_reduce_replay_run_test(xmlDocPtr doc)
+/*
+ * Running candidates
+ */
+
+/* The last line of output, with numbers collapsed, so that it does not
+ * depend on file names, process IDs or vector times. */
+static gchar*
+inf_test_reduce_replay_signature(int status,
+                                 const gchar* output)
 {
-  GError* error;
-  gchar* cmd;
-  gchar* stdout_buf;
-  gchar* stderr_buf;
-  int ret;
+  GString* signature;
+  gchar* contents;
+  const gchar* line;
+  const gchar* p;
+
+  signature = g_string_new(NULL);
+  if(WIFSIGNALED(status))
+    g_string_printf(signature, "signal %d", WTERMSIG(status));
+  else
+    g_string_printf(signature, "exit %d", WEXITSTATUS(status));
 
-  xmlSaveFile("test.xml", doc);
-  /*cmd = g_strdup_printf("(%s %s 2>&1) > /dev/null", REPLAY, "test.xml");*/
-  cmd = g_strdup_printf("%s %s", REPLAY, "test.xml");
+  if(g_file_get_contents(output, &contents, NULL, NULL))
+  {
+    g_strchomp(contents);
+    line = strrchr(contents, '\n');
+    line = (line != NULL) ? line + 1 : contents;
 
-  /* make it die on algorithm errors */
-  g_setenv("G_DEBUG", "fatal-warnings", TRUE);
+    g_string_append(signature, ": ");
+    for(p = line; *p != '\0'; ++p)
+    {
+      if(!g_ascii_isdigit(*p))
+        g_string_append_c(signature, *p);
+      else if(signature->str[signature->len - 1] != '#')
+        g_string_append_c(signature, '#');
+    }
 
-  error = NULL;
-  if(!g_spawn_command_line_sync(cmd, &stdout_buf, &stderr_buf, &ret, &error))
+    g_free(contents);
+  }
+
+  return g_string_free(signature, FALSE);
+}
+
+static void
+inf_test_reduce_replay_start_candidate(InfTestReduceReplayCandidate* cand)
+{
+  int fd;
+
+  cand->pid = -1;
+  if(xmlSaveFile(cand->filename, cand->doc) == -1)
   {
-    g_unlink("test.xml");
-    g_free(cmd);
-    fprintf(stderr, "Failed to run test: %s\n", error->message);
-    g_error_free(error);
-    return FALSE;
+    fprintf(stderr, "Failed to write \"%s\"\n", cand->filename);
+    cand->outcome = INF_TEST_REDUCE_REPLAY_OTHER;
+    return;
   }
 
-  /* Reset, so that we don't die ourselves */
-  g_setenv("G_DEBUG", "", TRUE);
+  fflush(stdout);
+  fflush(stderr);
+
+  cand->pid = fork();
+  if(cand->pid == 0)
+  {
+    fd = open("/dev/null", O_WRONLY);
+    if(fd != -1)
+    {
+      dup2(fd, STDOUT_FILENO);
+      close(fd);
+    }
 
-  /* These are just dummy variables to suppress the console output */
-  g_free(stdout_buf);
-  g_free(stderr_buf);
+    fd = open(cand->output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd != -1)
+    {
+      dup2(fd, STDERR_FILENO);
+      close(fd);
+    }
+
+    /* make it die on algorithm errors */
+    setenv("G_DEBUG", "fatal-warnings", 1);
 
-  /*g_unlink("test.xml");*/
+    execl(REPLAY, REPLAY, cand->filename, (char*)NULL);
+    _exit(127);
+  }
 
-#ifndef G_OS_WIN32
-  if(WIFSIGNALED(ret) &&
-     (WTERMSIG(ret) == SIGABRT ||
-      WTERMSIG(ret) == SIGSEGV ||
-      WTERMSIG(ret) == SIGTRAP))
+  if(cand->pid == -1)
   {
-    return FALSE;
+    fprintf(stderr, "Failed to run test: %s\n", g_strerror(errno));
+    cand->outcome = INF_TEST_REDUCE_REPLAY_OTHER;
   }
-  else if(WIFEXITED(ret))
+}
+
+static void
+inf_test_reduce_replay_finish_candidate(InfTestReduceReplay* reducer,
+                                        InfTestReduceReplayCandidate* cand,
+                                        int status)
+{
+  gchar* signature;
+
+  cand->pid = -1;
+  if(WIFEXITED(status) && WEXITSTATUS(status) == 0)
   {
-    if(WEXITSTATUS(ret))
-      return FALSE;
-    else
-      return TRUE;
+    cand->outcome = INF_TEST_REDUCE_REPLAY_PASS;
+    return;
+  }
+
+  signature = inf_test_reduce_replay_signature(status, cand->output);
+
+  /* The first failure defines what counts as the same failure */
+  if(reducer->signature == NULL)
+  {
+    reducer->signature = signature;
+    cand->outcome = INF_TEST_REDUCE_REPLAY_FAIL;
   }
   else
-#endif
   {
-    /* what happen? */
-    g_assert_not_reached();
+    if(strcmp(signature, reducer->signature) == 0)
+      cand->outcome = INF_TEST_REDUCE_REPLAY_FAIL;
+    else
+      cand->outcome = INF_TEST_REDUCE_REPLAY_OTHER;
+
+    g_free(signature);
+  }
+}
+
+/* Replays the documents of the first n candidates concurrently. Candidates
+ * without document are invalid records and are not run. */
+static void
+inf_test_reduce_replay_run_candidates(InfTestReduceReplay* reducer,
+                                      guint n)
+{
+  InfTestReduceReplayCandidate* cand;
+  guint running;
+  pid_t pid;
+  int status;
+  guint i;
+
+  g_assert(n <= reducer->jobs);
+
+  running = 0;
+  for(i = 0; i < n; ++i)
+  {
+    cand = &reducer->candidates[i];
+    cand->pid = -1;
+
+    if(cand->doc == NULL)
+    {
+      cand->outcome = INF_TEST_REDUCE_REPLAY_OTHER;
+    }
+    else
+    {
+      inf_test_reduce_replay_start_candidate(cand);
+      if(cand->pid > 0)
+      {
+        ++running;
+        ++reducer->n_runs;
+      }
+    }
+  }
+
+  while(running > 0)
+  {
+    pid = waitpid(-1, &status, 0);
+    if(pid == -1)
+    {
+      if(errno == EINTR) continue;
+
+      fprintf(stderr, "waitpid: %s\n", g_strerror(errno));
+      for(i = 0; i < n; ++i)
+        if(reducer->candidates[i].pid > 0)
+          reducer->candidates[i].outcome = INF_TEST_REDUCE_REPLAY_OTHER;
+      break;
+    }
+
+    for(i = 0; i < n; ++i)
+    {
+      cand = &reducer->candidates[i];
+      if(cand->pid == pid)
+      {
+        inf_test_reduce_replay_finish_candidate(reducer, cand, status);
+        --running;
+        break;
+      }
+    }
   }
 }
 
+static InfTestReduceReplayOutcome
+inf_test_reduce_replay_run_test(InfTestReduceReplay* reducer,
+                                xmlDocPtr doc)
+{
+  reducer->candidates[0].doc = doc;
+  inf_test_reduce_replay_run_candidates(reducer, 1);
+  reducer->candidates[0].doc = NULL;
+
+  return reducer->candidates[0].outcome;
+}
+
 static void
 inf_test_reduce_replay_remove_sync_requests(xmlNodePtr initial)
 {
@@ -469,9 +678,10 @@ inf_test_reduce_replay_remove_sync_requests(xmlNodePtr initial)
 }
 
 static gboolean
-inf_test_reduce_replay_reduce(xmlDocPtr doc,
-                              const char* filename,
-                              guint skip)
+inf_test_reduce_replay_reduce_linear(InfTestReduceReplay* reducer,
+                                     xmlDocPtr doc,
+                                     const char* filename,
+                                     guint skip)
 {
   InfAdoptedSessionReplay* local_replay;
   InfAdoptedSession* session;
@@ -490,7 +700,8 @@ inf_test_reduce_replay_reduce(xmlDocPtr doc,
 
   error = NULL;
   root = xmlDocGetRootElement(doc);
-  if(inf_test_reduce_replay_run_test(doc) == TRUE)
+  if(inf_test_reduce_replay_run_test(reducer, doc) !=
+     INF_TEST_REDUCE_REPLAY_FAIL)
   {
     fprintf(stderr, "Test does not initially fail\n");
     return FALSE;
@@ -514,7 +725,8 @@ inf_test_reduce_replay_reduce(xmlDocPtr doc,
   inf_test_reduce_replay_remove_sync_requests(initial);
 
   root = xmlDocGetRootElement(doc);
-  if(inf_test_reduce_replay_run_test(doc) == TRUE)
+  if(inf_test_reduce_replay_run_test(reducer, doc) !=
+     INF_TEST_REDUCE_REPLAY_FAIL)
   {
     fprintf(stderr, "Test does not fail without sync-requests anymore\n");
     return FALSE;
@@ -596,7 +808,8 @@ inf_test_reduce_replay_reduce(xmlDocPtr doc,
             /* Simply continue */
             fprintf(stderr, "SKIP\n");
           }
-          else if(inf_test_reduce_replay_run_test(doc))
+          else if(inf_test_reduce_replay_run_test(reducer, doc) !=
+                  INF_TEST_REDUCE_REPLAY_FAIL)
           {
             fprintf(stderr, "OK!\n");
             result = TRUE;
@@ -680,7 +893,8 @@ inf_test_reduce_replay_reduce(xmlDocPtr doc,
           /* Simply continue */
           fprintf(stderr, "SKIP\n");
         }
-        else if(inf_test_reduce_replay_run_test(back_doc))
+        else if(inf_test_reduce_replay_run_test(reducer, back_doc) !=
+                INF_TEST_REDUCE_REPLAY_FAIL)
         {
           fprintf(stderr, "OK!\n");
           result = TRUE;
@@ -714,12 +928,704 @@ inf_test_reduce_replay_reduce(xmlDocPtr doc,
   return result;
 }
 
+/*
+ * Delta debugging
+ */
+
+static void
+inf_test_reduce_replay_user_free(gpointer data)
+{
+  InfTestReduceReplayUser* user;
+  user = (InfTestReduceReplayUser*)data;
+
+  if(user->initial != NULL)
+    inf_adopted_state_vector_free(user->initial);
+  g_free(user->map);
+  g_slice_free(InfTestReduceReplayUser, user);
+}
+
+/* The XML node can either be a <user> or a <sync-user> element. A user
+ * that joins again keeps the join item of its first join. */
+static InfTestReduceReplayUser*
+inf_test_reduce_replay_add_user(InfTestReduceReplay* reducer,
+                                GHashTable* times,
+                                xmlNodePtr xml,
+                                gint join,
+                                guint* user_id,
+                                GError** error)
+{
+  InfTestReduceReplayUser* user;
+  InfAdoptedStateVector* time;
+  xmlChar* time_str;
+
+  if(!inf_xml_util_get_attribute_uint_required(xml, "id", user_id, error))
+    return NULL;
+
+  time_str = inf_xml_util_get_attribute_required(xml, "time", error);
+  if(time_str == NULL) return NULL;
+
+  time = inf_adopted_state_vector_from_string((const char*)time_str, error);
+  xmlFree(time_str);
+
+  if(time == NULL) return NULL;
+
+  user = g_hash_table_lookup(reducer->users, GUINT_TO_POINTER(*user_id));
+  if(user == NULL)
+  {
+    user = g_slice_new(InfTestReduceReplayUser);
+    user->join = join;
+    user->initial = NULL;
+    user->first = 0;
+    user->n_requests = 0;
+    user->map = NULL;
+
+    if(join < 0)
+      user->initial = inf_adopted_state_vector_copy(time);
+
+    g_hash_table_insert(reducer->users, GUINT_TO_POINTER(*user_id), user);
+  }
+
+  g_hash_table_insert(times, GUINT_TO_POINTER(*user_id), time);
+  return user;
+}
+
+/* Reads the requests and user joins of doc, with their absolute vector
+ * times, and creates the skeleton that candidate records are built on. */
+static gboolean
+inf_test_reduce_replay_load(InfTestReduceReplay* reducer,
+                            xmlDocPtr doc,
+                            GError** error)
+{
+  InfTestReduceReplayItem item;
+  InfTestReduceReplayUser* user;
+  InfAdoptedStateVector* running;
+  GHashTable* times;
+  GHashTableIter iter;
+  xmlNodePtr initial;
+  xmlNodePtr cur;
+  xmlNodePtr next;
+  xmlChar* time_str;
+  guint user_id;
+
+  initial = inf_test_reduce_replay_find_node(xmlDocGetRootElement(doc),
+                                             "initial");
+  g_assert(initial != NULL);
+
+  times = g_hash_table_new_full(
+    NULL,
+    NULL,
+    NULL,
+    (GDestroyNotify)inf_adopted_state_vector_free
+  );
+
+  for(cur = inf_test_reduce_replay_first_node(initial->children);
+      cur != NULL;
+      cur = inf_test_reduce_replay_next_node(cur))
+  {
+    if(strcmp((const char*)cur->name, "sync-user") == 0)
+    {
+      user = inf_test_reduce_replay_add_user(
+        reducer,
+        times,
+        cur,
+        -1,
+        &user_id,
+        error
+      );
+
+      if(user == NULL)
+      {
+        g_hash_table_unref(times);
+        return FALSE;
+      }
+    }
+  }
+
+  for(cur = inf_test_reduce_replay_next_node(initial);
+      cur != NULL;
+      cur = inf_test_reduce_replay_next_node(cur))
+  {
+    item.xml = cur;
+
+    if(strcmp((const char*)cur->name, "user") == 0)
+    {
+      user = inf_test_reduce_replay_add_user(
+        reducer,
+        times,
+        cur,
+        reducer->items->len,
+        &item.user_id,
+        error
+      );
+
+      if(user == NULL)
+      {
+        g_hash_table_unref(times);
+        return FALSE;
+      }
+
+      item.join = TRUE;
+      item.time = inf_adopted_state_vector_copy(
+        g_hash_table_lookup(times, GUINT_TO_POINTER(item.user_id))
+      );
+
+      g_array_append_val(reducer->items, item);
+    }
+    else if(strcmp((const char*)cur->name, "request") == 0)
+    {
+      if(!inf_xml_util_get_attribute_uint_required(cur, "user", &user_id,
+                                                   error))
+      {
+        g_hash_table_unref(times);
+        return FALSE;
+      }
+
+      user = g_hash_table_lookup(reducer->users, GUINT_TO_POINTER(user_id));
+      running = g_hash_table_lookup(times, GUINT_TO_POINTER(user_id));
+      g_assert(user != NULL && running != NULL);
+
+      time_str = inf_xml_util_get_attribute_required(cur, "time", error);
+      if(time_str == NULL)
+      {
+        g_hash_table_unref(times);
+        return FALSE;
+      }
+
+      item.user_id = user_id;
+      item.join = FALSE;
+      item.time = inf_adopted_state_vector_from_string_diff(
+        (const char*)time_str,
+        running,
+        error
+      );
+
+      xmlFree(time_str);
+
+      if(item.time == NULL)
+      {
+        g_hash_table_unref(times);
+        return FALSE;
+      }
+
+      if(user->n_requests == 0)
+        user->first = inf_adopted_state_vector_get(item.time, user_id);
+      ++user->n_requests;
+
+      running = inf_adopted_state_vector_copy(item.time);
+      inf_adopted_state_vector_add(running, user_id, 1);
+      g_hash_table_insert(times, GUINT_TO_POINTER(user_id), running);
+
+      g_array_append_val(reducer->items, item);
+    }
+  }
+
+  g_hash_table_unref(times);
+
+  g_hash_table_iter_init(&iter, reducer->users);
+  while(g_hash_table_iter_next(&iter, NULL, (gpointer*)&user))
+    user->map = g_new0(guint, user->n_requests + 1);
+
+  /* The skeleton is the record up to and including the initial */
+  reducer->skeleton = xmlCopyDoc(doc, 1);
+  initial = inf_test_reduce_replay_find_node(
+    xmlDocGetRootElement(reducer->skeleton),
+    "initial"
+  );
+
+  for(cur = initial->next; cur != NULL; cur = next)
+  {
+    next = cur->next;
+    xmlUnlinkNode(cur);
+    xmlFreeNode(cur);
+  }
+
+  return TRUE;
+}
+
+static void
+inf_test_reduce_replay_remap_foreach_func(guint id,
+                                          guint value,
+                                          gpointer user_data)
+{
+  InfTestReduceReplayRemapData* data;
+  InfTestReduceReplayUser* user;
+  guint k;
+
+  data = (InfTestReduceReplayRemapData*)user_data;
+  user = g_hash_table_lookup(data->reducer->users, GUINT_TO_POINTER(id));
+
+  /* Requests of the user up to value are kept only partly, so count only
+   * the kept ones. Values before the first request refer to requests that
+   * are part of the initial, which are never removed. */
+  if(user != NULL && user->n_requests > 0 && value > user->first)
+  {
+    k = MIN(value - user->first, user->n_requests);
+    value = user->first + user->map[k] + (value - user->first - k);
+  }
+
+  inf_adopted_state_vector_set(data->result, id, value);
+}
+
+static InfAdoptedStateVector*
+inf_test_reduce_replay_remap(InfTestReduceReplay* reducer,
+                             const InfAdoptedStateVector* time)
+{
+  InfTestReduceReplayRemapData data;
+
+  data.reducer = reducer;
+  data.result = inf_adopted_state_vector_new();
+
+  inf_adopted_state_vector_foreach(
+    time,
+    inf_test_reduce_replay_remap_foreach_func,
+    &data
+  );
+
+  return data.result;
+}
+
+/* Builds a record containing the items for which keep is set, with vector
+ * times renumbered to account for the removed requests. Returns NULL if
+ * the resulting record is not valid, for example because it contains an
+ * undo request without the request it undoes. */
+static xmlDocPtr
+inf_test_reduce_replay_build(InfTestReduceReplay* reducer,
+                             const gboolean* keep)
+{
+  InfTestReduceReplayItem* item;
+  InfTestReduceReplayUser* user;
+  InfAdoptedStateVector* time;
+  InfAdoptedStateVector* running;
+  GHashTable* times;
+  GHashTableIter iter;
+  gpointer user_id;
+  xmlDocPtr doc;
+  xmlNodePtr root;
+  xmlNodePtr xml;
+  gchar* time_str;
+  GError* error;
+  guint k;
+  guint i;
+
+  for(i = 0; i < reducer->items->len; ++i)
+  {
+    item = &g_array_index(reducer->items, InfTestReduceReplayItem, i);
+    if(!item->join)
+    {
+      user = g_hash_table_lookup(
+        reducer->users,
+        GUINT_TO_POINTER(item->user_id)
+      );
+
+      k = inf_adopted_state_vector_get(item->time, item->user_id);
+      k -= user->first;
+      user->map[k + 1] = user->map[k] + (keep[i] ? 1 : 0);
+    }
+  }
+
+  times = g_hash_table_new_full(
+    NULL,
+    NULL,
+    NULL,
+    (GDestroyNotify)inf_adopted_state_vector_free
+  );
+
+  g_hash_table_iter_init(&iter, reducer->users);
+  while(g_hash_table_iter_next(&iter, &user_id, (gpointer*)&user))
+  {
+    if(user->initial != NULL)
+    {
+      g_hash_table_insert(
+        times,
+        user_id,
+        inf_adopted_state_vector_copy(user->initial)
+      );
+    }
+  }
+
+  doc = xmlCopyDoc(reducer->skeleton, 1);
+  root = xmlDocGetRootElement(doc);
+
+  for(i = 0; i < reducer->items->len; ++i)
+  {
+    if(!keep[i]) continue;
+
+    item = &g_array_index(reducer->items, InfTestReduceReplayItem, i);
+    time = inf_test_reduce_replay_remap(reducer, item->time);
+
+    if(item->join)
+    {
+      time_str = inf_adopted_state_vector_to_string(time);
+    }
+    else
+    {
+      running = g_hash_table_lookup(times, GUINT_TO_POINTER(item->user_id));
+      g_assert(running != NULL);
+
+      time_str = inf_adopted_state_vector_to_string_diff(time, running);
+      inf_adopted_state_vector_add(time, item->user_id, 1);
+    }
+
+    g_hash_table_insert(times, GUINT_TO_POINTER(item->user_id), time);
+
+    xml = xmlCopyNode(item->xml, 1);
+    inf_xml_util_set_attribute(xml, "time", time_str);
+    g_free(time_str);
+
+    xmlAddChild(root, xml);
+  }
+
+  g_hash_table_unref(times);
+
+  error = NULL;
+  if(!inf_test_reduce_replay_validate_test(doc, &error))
+  {
+    g_error_free(error);
+    xmlFreeDoc(doc);
+    return NULL;
+  }
+
+  return doc;
+}
+
+/* Computes which items to keep if only the given units are kept out of the
+ * units that are currently reduced. If units are user joins, then removing
+ * a join also removes all requests of that user. */
+static gboolean*
+inf_test_reduce_replay_make_keep(InfTestReduceReplay* reducer,
+                                 GArray* units,
+                                 gboolean users)
+{
+  InfTestReduceReplayItem* item;
+  InfTestReduceReplayUser* user;
+  gboolean* selected;
+  gboolean* keep;
+  guint i;
+
+  selected = g_new0(gboolean, reducer->items->len);
+  for(i = 0; i < units->len; ++i)
+    selected[g_array_index(units, guint, i)] = TRUE;
+
+  keep = g_new(gboolean, reducer->items->len);
+  for(i = 0; i < reducer->items->len; ++i)
+  {
+    item = &g_array_index(reducer->items, InfTestReduceReplayItem, i);
+
+    if(!reducer->base[i])
+    {
+      keep[i] = FALSE;
+    }
+    else if(users)
+    {
+      if(item->join)
+      {
+        keep[i] = selected[i];
+      }
+      else
+      {
+        user = g_hash_table_lookup(
+          reducer->users,
+          GUINT_TO_POINTER(item->user_id)
+        );
+
+        keep[i] = user->join < 0 || selected[user->join];
+      }
+    }
+    else
+    {
+      keep[i] = item->join || selected[i];
+    }
+  }
+
+  g_free(selected);
+  return keep;
+}
+
+/* Returns the index-th subset of units split into n chunks if index < n,
+ * or the complement of the (index - n)-th subset otherwise. */
+static GArray*
+inf_test_reduce_replay_split(GArray* units,
+                             guint n,
+                             guint index)
+{
+  GArray* result;
+  guint chunk;
+  guint begin;
+  guint end;
+  guint i;
+
+  chunk = index % n;
+  begin = (guint64)chunk * units->len / n;
+  end = (guint64)(chunk + 1) * units->len / n;
+
+  result = g_array_new(FALSE, FALSE, sizeof(guint));
+  for(i = 0; i < units->len; ++i)
+  {
+    if((index < n) == (i >= begin && i < end))
+      g_array_append_val(result, g_array_index(units, guint, i));
+  }
+
+  return result;
+}
+
+/* Finds a 1-minimal subset of units for which the record still fails, with
+ * the ddmin algorithm. Subsets and complements of one granularity are
+ * tested in batches of parallel replays, and the first failing one in
+ * batch order is taken, so that the result does not depend on timing. */
+static GArray*
+inf_test_reduce_replay_ddmin(InfTestReduceReplay* reducer,
+                             GArray* units,
+                             gboolean users)
+{
+  GArray* selection;
+  gboolean* keep;
+  guint n;
+  guint n_candidates;
+  guint begin;
+  guint batch;
+  gint found;
+  guint i;
+
+  n = 2;
+  while(units->len >= 2)
+  {
+    fprintf(
+      stderr,
+      "%u %s left, granularity %u, %u replays so far\n",
+      units->len,
+      users ? "user joins" : "requests",
+      n,
+      reducer->n_runs
+    );
+
+    /* For n = 2 the complements are the subsets */
+    n_candidates = (n == 2) ? 2 : 2 * n;
+    found = -1;
+
+    for(begin = 0; begin < n_candidates && found < 0; begin += batch)
+    {
+      batch = MIN(reducer->jobs, n_candidates - begin);
+      for(i = 0; i < batch; ++i)
+      {
+        selection = inf_test_reduce_replay_split(units, n, begin + i);
+        keep = inf_test_reduce_replay_make_keep(reducer, selection, users);
+        reducer->candidates[i].doc = inf_test_reduce_replay_build(reducer,
+                                                                  keep);
+        g_free(keep);
+        g_array_free(selection, TRUE);
+      }
+
+      inf_test_reduce_replay_run_candidates(reducer, batch);
+
+      for(i = 0; i < batch; ++i)
+      {
+        if(found < 0 &&
+           reducer->candidates[i].outcome == INF_TEST_REDUCE_REPLAY_FAIL)
+        {
+          found = begin + i;
+        }
+
+        if(reducer->candidates[i].doc != NULL)
+          xmlFreeDoc(reducer->candidates[i].doc);
+        reducer->candidates[i].doc = NULL;
+      }
+    }
+
+    if(found >= 0)
+    {
+      selection = inf_test_reduce_replay_split(units, n, found);
+      g_array_free(units, TRUE);
+      units = selection;
+
+      if((guint)found < n)
+        n = 2;
+      else
+        n = MAX(n - 1, 2);
+    }
+    else if(n < units->len)
+    {
+      n = MIN(2 * n, units->len);
+    }
+    else
+    {
+      break;
+    }
+  }
+
+  return units;
+}
+
+static void
+inf_test_reduce_replay_ddmin_phase(InfTestReduceReplay* reducer,
+                                   gboolean users)
+{
+  InfTestReduceReplayItem* item;
+  GArray* units;
+  gboolean* keep;
+  guint i;
+
+  units = g_array_new(FALSE, FALSE, sizeof(guint));
+  for(i = 0; i < reducer->items->len; ++i)
+  {
+    item = &g_array_index(reducer->items, InfTestReduceReplayItem, i);
+    if(reducer->base[i] && item->join == users)
+      g_array_append_val(units, i);
+  }
+
+  units = inf_test_reduce_replay_ddmin(reducer, units, users);
+
+  keep = inf_test_reduce_replay_make_keep(reducer, units, users);
+  g_free(reducer->base);
+  reducer->base = keep;
+
+  g_array_free(units, TRUE);
+}
+
+static gboolean
+inf_test_reduce_replay_reduce_ddmin(InfTestReduceReplay* reducer,
+                                    xmlDocPtr doc)
+{
+  InfTestReduceReplayItem* item;
+  xmlNodePtr initial;
+  xmlDocPtr result;
+  GError* error;
+  guint n_requests;
+  guint n_joins;
+  guint i;
+
+  if(inf_test_reduce_replay_run_test(reducer, doc) !=
+     INF_TEST_REDUCE_REPLAY_FAIL)
+  {
+    fprintf(stderr, "Test does not initially fail\n");
+    return FALSE;
+  }
+
+  fprintf(stderr, "Failure: %s\n", reducer->signature);
+
+  error = NULL;
+  if(!inf_test_reduce_replay_validate_test(doc, &error))
+  {
+    fprintf(stderr, "Test does not initially validate: %s\n", error->message);
+    g_error_free(error);
+    return FALSE;
+  }
+
+  initial = inf_test_reduce_replay_find_node(xmlDocGetRootElement(doc),
+                                             "initial");
+  if(!initial)
+  {
+    fprintf(stderr, "Test has no initial\n");
+    return FALSE;
+  }
+
+  /* Remove all sync-requests. We require test to work without for now. */
+  inf_test_reduce_replay_remove_sync_requests(initial);
+
+  if(!inf_test_reduce_replay_load(reducer, doc, &error))
+  {
+    fprintf(stderr, "Failed to read requests: %s\n", error->message);
+    g_error_free(error);
+    return FALSE;
+  }
+
+  reducer->base = g_new(gboolean, reducer->items->len);
+  for(i = 0; i < reducer->items->len; ++i)
+    reducer->base[i] = TRUE;
+
+  /* Make sure the rewritten record fails in the same way */
+  result = inf_test_reduce_replay_build(reducer, reducer->base);
+  if(result == NULL ||
+     inf_test_reduce_replay_run_test(reducer, result) !=
+     INF_TEST_REDUCE_REPLAY_FAIL)
+  {
+    fprintf(stderr, "Test does not fail without sync-requests anymore\n");
+    if(result != NULL) xmlFreeDoc(result);
+    return FALSE;
+  }
+
+  xmlFreeDoc(result);
+
+  inf_test_reduce_replay_ddmin_phase(reducer, TRUE);
+  inf_test_reduce_replay_ddmin_phase(reducer, FALSE);
+
+  result = inf_test_reduce_replay_build(reducer, reducer->base);
+  g_assert(result != NULL);
+
+  n_requests = 0;
+  n_joins = 0;
+  for(i = 0; i < reducer->items->len; ++i)
+  {
+    item = &g_array_index(reducer->items, InfTestReduceReplayItem, i);
+    if(reducer->base[i])
+    {
+      if(item->join) ++n_joins;
+      else ++n_requests;
+    }
+  }
+
+  fprintf(
+    stderr,
+    "Reduced to %u requests and %u user joins in %u replays\n",
+    n_requests,
+    n_joins,
+    reducer->n_runs
+  );
+
+  xmlSaveFile("last_fail.record.xml", result);
+  printf("Last failing record in last_fail.record.xml\n");
+  xmlFreeDoc(result);
+  return TRUE;
+}
+
 int main(int argc, char* argv[])
 {
+  GOptionContext* context;
+  InfTestReduceReplay reducer;
+  InfTestReduceReplayItem* item;
   GError* error = NULL;
   xmlDocPtr doc;
   gboolean ret;
-  guint skip;
+  gboolean linear;
+  gint jobs;
+  gint skip;
+  gchar* path;
+  guint i;
+
+  GOptionEntry entries[] = {
+    { "jobs", 'j', 0,
+      G_OPTION_ARG_INT, NULL,
+      "Number of replays to run in parallel, defaults to the number of "
+      "CPUs", "N" },
+    { "linear", 'l', 0,
+      G_OPTION_ARG_NONE, NULL,
+      "Cut away front and back of the record one request at a time "
+      "instead of using delta debugging", NULL },
+    { "skip", 's', 0,
+      G_OPTION_ARG_INT, NULL,
+      "Only run every N-th test in linear mode", "N" },
+    { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL }
+  };
+
+  jobs = 0;
+  linear = FALSE;
+  skip = 1;
+
+  entries[0].arg_data = &jobs;
+  entries[1].arg_data = &linear;
+  entries[2].arg_data = &skip;
+
+  context = g_option_context_new("<record-file> [<skip>]");
+  g_option_context_add_main_entries(context, entries, NULL);
+
+  if(!g_option_context_parse(context, &argc, &argv, &error))
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    g_option_context_free(context);
+    return -1;
+  }
+
+  g_option_context_free(context);
 
   if(!inf_init(&error))
   {
@@ -747,10 +1653,82 @@ int main(int argc, char* argv[])
     return -1;
   }
 
-  skip = 1;
-  if(argc > 2) skip = strtol(argv[2], NULL, 10);
+  /* A skip value given as second argument selects the linear reduction,
+   * as before delta debugging was available. */
+  if(argc > 2)
+  {
+    skip = strtol(argv[2], NULL, 10);
+    linear = TRUE;
+  }
+
+  if(skip < 1) skip = 1;
+  if(jobs <= 0) jobs = g_get_num_processors();
+
+  reducer.tmpdir = g_dir_make_tmp("inf-test-reduce-replay-XXXXXX", &error);
+  if(reducer.tmpdir == NULL)
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    xmlFreeDoc(doc);
+    return -1;
+  }
+
+  reducer.jobs = jobs;
+  reducer.candidates = g_new0(InfTestReduceReplayCandidate, jobs);
+  for(i = 0; i < reducer.jobs; ++i)
+  {
+    path = g_strdup_printf("candidate-%u.record.xml", i);
+    reducer.candidates[i].filename =
+      g_build_filename(reducer.tmpdir, path, NULL);
+    g_free(path);
+
+    path = g_strdup_printf("candidate-%u.out", i);
+    reducer.candidates[i].output =
+      g_build_filename(reducer.tmpdir, path, NULL);
+    g_free(path);
+  }
+
+  reducer.signature = NULL;
+  reducer.n_runs = 0;
+  reducer.skeleton = NULL;
+  reducer.items = g_array_new(FALSE, FALSE, sizeof(InfTestReduceReplayItem));
+  reducer.users = g_hash_table_new_full(
+    NULL,
+    NULL,
+    NULL,
+    inf_test_reduce_replay_user_free
+  );
+  reducer.base = NULL;
+
+  if(linear)
+    ret = inf_test_reduce_replay_reduce_linear(&reducer, doc, argv[1], skip);
+  else
+    ret = inf_test_reduce_replay_reduce_ddmin(&reducer, doc);
+
+  for(i = 0; i < reducer.jobs; ++i)
+  {
+    g_unlink(reducer.candidates[i].filename);
+    g_unlink(reducer.candidates[i].output);
+    g_free(reducer.candidates[i].filename);
+    g_free(reducer.candidates[i].output);
+  }
+
+  g_rmdir(reducer.tmpdir);
+  g_free(reducer.tmpdir);
+  g_free(reducer.candidates);
+  g_free(reducer.signature);
+
+  for(i = 0; i < reducer.items->len; ++i)
+  {
+    item = &g_array_index(reducer.items, InfTestReduceReplayItem, i);
+    inf_adopted_state_vector_free(item->time);
+  }
 
-  ret = inf_test_reduce_replay_reduce(doc, argv[1], skip);
+  g_array_free(reducer.items, TRUE);
+  g_hash_table_unref(reducer.users);
+  g_free(reducer.base);
+  if(reducer.skeleton != NULL)
+    xmlFreeDoc(reducer.skeleton);
 
   xmlFreeDoc(doc);
   return ret ? 0 : -1;
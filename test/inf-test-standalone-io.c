@@ -0,0 +1,130 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Tests the stall detection of InfStandaloneIo */
+
+#include <libinfinity/common/inf-standalone-io.h>
+#include <libinfinity/common/inf-io.h>
+
+#include <stdio.h>
+
+static void
+inf_test_standalone_io_fast_cb(gpointer user_data)
+{
+}
+
+static void
+inf_test_standalone_io_slow_cb(gpointer user_data)
+{
+  g_usleep(GPOINTER_TO_UINT(user_data) * 1000);
+}
+
+static void
+inf_test_standalone_io_stall_cb(InfStandaloneIo* io,
+                                const InfStandaloneIoStall* stall,
+                                gpointer user_data)
+{
+  ++*(guint*)user_data;
+}
+
+/* Runs the given timeout callback to completion */
+static void
+inf_test_standalone_io_run(InfStandaloneIo* io,
+                           InfIoTimeoutFunc func,
+                           guint msecs)
+{
+  inf_io_add_timeout(INF_IO(io), 0, func, GUINT_TO_POINTER(msecs), NULL);
+  inf_standalone_io_iteration(io);
+}
+
+int main()
+{
+  InfStandaloneIo* io;
+  InfStandaloneIoStall* stalls;
+  guint n_stalls;
+  guint n_signals;
+  gchar* name;
+
+  io = inf_standalone_io_new();
+  n_signals = 0;
+
+  g_signal_connect(
+    G_OBJECT(io),
+    "stall",
+    G_CALLBACK(inf_test_standalone_io_stall_cb),
+    &n_signals
+  );
+
+  /* Stall detection is disabled by default */
+  inf_test_standalone_io_run(io, inf_test_standalone_io_slow_cb, 20);
+  stalls = inf_standalone_io_get_stalls(io, &n_stalls);
+  if(n_stalls != 0 || stalls != NULL || n_signals != 0)
+  {
+    fprintf(stderr, "Stall recorded without threshold\n");
+    return 1;
+  }
+
+  g_object_set(G_OBJECT(io), "stall-threshold", 10, NULL);
+
+  inf_test_standalone_io_run(io, inf_test_standalone_io_fast_cb, 0);
+  inf_test_standalone_io_run(io, inf_test_standalone_io_slow_cb, 20);
+  inf_test_standalone_io_run(io, inf_test_standalone_io_slow_cb, 40);
+
+  stalls = inf_standalone_io_get_stalls(io, &n_stalls);
+  if(n_stalls != 2 || n_signals != 2)
+  {
+    fprintf(stderr, "Expected 2 stalls, got %u\n", n_stalls);
+    return 1;
+  }
+
+  /* The longest stall comes first */
+  if(stalls[0].duration < 40000 || stalls[1].duration < 20000 ||
+     stalls[0].duration < stalls[1].duration)
+  {
+    fprintf(stderr, "Stalls not sorted by duration\n");
+    return 1;
+  }
+
+  if(stalls[0].type != INF_STANDALONE_IO_CALLBACK_TIMEOUT ||
+     stalls[0].func != (gpointer)inf_test_standalone_io_slow_cb ||
+     stalls[0].user_data != GUINT_TO_POINTER(40))
+  {
+    fprintf(stderr, "Wrong callback recorded for stall\n");
+    return 1;
+  }
+
+  name = inf_standalone_io_stall_get_function_name(&stalls[0]);
+  printf("Longest stall: %" G_GUINT64_FORMAT " us in %s\n",
+         stalls[0].duration, name);
+  g_free(name);
+  g_free(stalls);
+
+  inf_standalone_io_clear_stalls(io);
+  stalls = inf_standalone_io_get_stalls(io, &n_stalls);
+  if(n_stalls != 0 || stalls != NULL)
+  {
+    fprintf(stderr, "Stalls not cleared\n");
+    return 1;
+  }
+
+  g_object_unref(io);
+  return 0;
+}
+
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,306 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Tests that Undo and Redo requests of a local user within a batch of
+ * InfAdoptedAlgorithm are validated against the requests executed before
+ * them in the same batch. */
+
+#include <libinftext/inf-text-default-buffer.h>
+#include <libinftext/inf-text-default-insert-operation.h>
+#include <libinftext/inf-text-user.h>
+#include <libinfinity/adopted/inf-adopted-algorithm.h>
+#include <libinfinity/common/inf-user-table.h>
+#include <libinfinity/common/inf-init.h>
+
+#include <string.h>
+#include <stdio.h>
+
+/* Executes a request, and checks that it is rejected with expected_error,
+ * or that it succeeds if expected_error is NULL */
+static gboolean
+inf_test_text_batch_execute(InfAdoptedAlgorithm* algorithm,
+                            InfAdoptedUser* user,
+                            InfAdoptedRequestType type,
+                            InfAdoptedOperation* operation,
+                            const InfAdoptedAlgorithmError* expected_error)
+{
+  InfAdoptedRequest* request;
+  GError* error;
+  gboolean result;
+
+  request = inf_adopted_algorithm_generate_request(
+    algorithm,
+    type,
+    user,
+    operation
+  );
+
+  error = NULL;
+  inf_adopted_algorithm_execute_request(algorithm, request, TRUE, &error);
+  g_object_unref(request);
+
+  result = TRUE;
+  if(error != NULL)
+  {
+    if(expected_error == NULL || error->code != *expected_error)
+    {
+      fprintf(stderr, "Request failed: %s\n", error->message);
+      result = FALSE;
+    }
+
+    g_error_free(error);
+  }
+  else if(expected_error != NULL)
+  {
+    fprintf(stderr, "Request succeeded unexpectedly\n");
+    result = FALSE;
+  }
+
+  return result;
+}
+
+static gboolean
+inf_test_text_batch_insert(InfAdoptedAlgorithm* algorithm,
+                           InfAdoptedUser* user,
+                           guint pos,
+                           const gchar* text)
+{
+  InfTextChunk* chunk;
+  InfAdoptedOperation* operation;
+  gboolean result;
+
+  chunk = inf_text_chunk_new("UTF-8");
+  inf_text_chunk_insert_text(
+    chunk,
+    0,
+    text,
+    strlen(text),
+    strlen(text),
+    inf_user_get_id(INF_USER(user))
+  );
+
+  operation = INF_ADOPTED_OPERATION(
+    inf_text_default_insert_operation_new(pos, chunk)
+  );
+
+  inf_text_chunk_free(chunk);
+
+  result = inf_test_text_batch_execute(
+    algorithm,
+    user,
+    INF_ADOPTED_REQUEST_DO,
+    operation,
+    NULL
+  );
+
+  g_object_unref(operation);
+  return result;
+}
+
+static gboolean
+inf_test_text_batch_undo(InfAdoptedAlgorithm* algorithm,
+                         InfAdoptedUser* user,
+                         gboolean expected)
+{
+  InfAdoptedAlgorithmError error;
+  error = INF_ADOPTED_ALGORITHM_ERROR_NO_UNDO;
+
+  return inf_test_text_batch_execute(
+    algorithm,
+    user,
+    INF_ADOPTED_REQUEST_UNDO,
+    NULL,
+    expected ? NULL : &error
+  );
+}
+
+static gboolean
+inf_test_text_batch_redo(InfAdoptedAlgorithm* algorithm,
+                         InfAdoptedUser* user,
+                         gboolean expected)
+{
+  InfAdoptedAlgorithmError error;
+  error = INF_ADOPTED_ALGORITHM_ERROR_NO_REDO;
+
+  return inf_test_text_batch_execute(
+    algorithm,
+    user,
+    INF_ADOPTED_REQUEST_REDO,
+    NULL,
+    expected ? NULL : &error
+  );
+}
+
+static gboolean
+inf_test_text_batch_check(InfAdoptedAlgorithm* algorithm,
+                          InfAdoptedUser* user,
+                          InfTextBuffer* buffer,
+                          const gchar* text,
+                          gboolean can_undo,
+                          gboolean can_redo)
+{
+  InfTextChunk* chunk;
+  gchar* buffer_text;
+  gsize buffer_bytes;
+  gboolean result;
+
+  result = TRUE;
+
+  chunk = inf_text_buffer_get_slice(
+    buffer,
+    0,
+    inf_text_buffer_get_length(buffer)
+  );
+
+  buffer_text = inf_text_chunk_get_text(chunk, &buffer_bytes);
+
+  if(buffer_bytes != strlen(text) ||
+     strncmp(buffer_text, text, buffer_bytes) != 0)
+  {
+    fprintf(
+      stderr,
+      "Buffer is \"%.*s\", expected \"%s\"\n",
+      (int)buffer_bytes,
+      buffer_text,
+      text
+    );
+
+    result = FALSE;
+  }
+
+  g_free(buffer_text);
+  inf_text_chunk_free(chunk);
+
+  if(inf_adopted_algorithm_can_undo(algorithm, user) != can_undo)
+  {
+    fprintf(stderr, "can-undo is not %s\n", can_undo ? "TRUE" : "FALSE");
+    result = FALSE;
+  }
+
+  if(inf_adopted_algorithm_can_redo(algorithm, user) != can_redo)
+  {
+    fprintf(stderr, "can-redo is not %s\n", can_redo ? "TRUE" : "FALSE");
+    result = FALSE;
+  }
+
+  return result;
+}
+
+static gboolean
+inf_test_text_batch_run(InfAdoptedAlgorithm* algorithm,
+                        InfAdoptedUser* user,
+                        InfTextBuffer* buffer)
+{
+  gboolean result;
+
+  if(!inf_test_text_batch_check(algorithm, user, buffer, "abc", FALSE, FALSE))
+    return FALSE;
+
+  /* There is nothing to undo before the batch, but the insertion within
+   * the batch can be undone and redone within it. */
+  inf_adopted_algorithm_begin_batch(algorithm);
+
+  result = inf_test_text_batch_insert(algorithm, user, 0, "x");
+  if(result == TRUE)
+    result = inf_test_text_batch_undo(algorithm, user, TRUE);
+  if(result == TRUE)
+    result = inf_test_text_batch_redo(algorithm, user, TRUE);
+  if(result == TRUE)
+    result = inf_test_text_batch_redo(algorithm, user, FALSE);
+
+  inf_adopted_algorithm_end_batch(algorithm);
+
+  if(result == FALSE)
+    return FALSE;
+
+  if(!inf_test_text_batch_check(algorithm, user, buffer, "xabc", TRUE, FALSE))
+    return FALSE;
+
+  /* Undo is possible before the batch, but not anymore once the only
+   * request has been undone within it. */
+  inf_adopted_algorithm_begin_batch(algorithm);
+
+  result = inf_test_text_batch_undo(algorithm, user, TRUE);
+  if(result == TRUE)
+    result = inf_test_text_batch_undo(algorithm, user, FALSE);
+
+  inf_adopted_algorithm_end_batch(algorithm);
+
+  if(result == FALSE)
+    return FALSE;
+
+  if(!inf_test_text_batch_check(algorithm, user, buffer, "abc", FALSE, TRUE))
+    return FALSE;
+
+  return TRUE;
+}
+
+int
+main(int argc, char* argv[])
+{
+  InfTextBuffer* buffer;
+  InfUserTable* user_table;
+  InfTextUser* user;
+  InfAdoptedAlgorithm* algorithm;
+  GError* error;
+  gboolean result;
+
+  error = NULL;
+  if(!inf_init(&error))
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return -1;
+  }
+
+  buffer = INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
+  inf_text_buffer_insert_text(buffer, 0, "abc", 3, 3, NULL);
+
+  user = INF_TEXT_USER(
+    g_object_new(
+      INF_TEXT_TYPE_USER,
+      "id", 1,
+      "name", "Local",
+      "status", INF_USER_ACTIVE,
+      "flags", INF_USER_LOCAL,
+      NULL
+    )
+  );
+
+  user_table = inf_user_table_new();
+  inf_user_table_add_user(user_table, INF_USER(user));
+
+  algorithm = inf_adopted_algorithm_new(user_table, INF_BUFFER(buffer));
+
+  result = inf_test_text_batch_run(algorithm, INF_ADOPTED_USER(user), buffer);
+
+  g_object_unref(algorithm);
+  g_object_unref(user_table);
+  g_object_unref(user);
+  g_object_unref(buffer);
+
+  inf_deinit();
+
+  if(result == FALSE)
+    return -1;
+
+  return 0;
+}
+
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,667 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Benchmarks InfAdoptedAlgorithm with a synthetic concurrent workload.
+ * Every user has its own site with its own buffer and algorithm, which
+ * generates requests from its own state. A site only sees the requests of
+ * other users once it lags more than a given number of requests behind, so
+ * that the concurrency depth of the workload can be controlled. All
+ * requests are executed by a central server algorithm, in the same way
+ * as infinoted does, and only that server is measured. The same seed
+ * always produces the same workload, so results can be compared against a
+ * fixed baseline. */
+
+#include <libinftext/inf-text-default-buffer.h>
+#include <libinftext/inf-text-default-insert-operation.h>
+#include <libinftext/inf-text-default-delete-operation.h>
+#include <libinftext/inf-text-user.h>
+#include <libinfinity/adopted/inf-adopted-algorithm.h>
+#include <libinfinity/common/inf-init.h>
+
+#include <sys/resource.h>
+#include <string.h>
+#include <stdio.h>
+
+#ifdef __GLIBC__
+/* Count heap allocations of the whole process, including those made by
+ * GLib and libinfinity, by interposing the glibc allocator. */
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t n, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+
+static guint64 inf_test_text_benchmark_n_allocations;
+
+void*
+malloc(size_t size)
+{
+  __sync_fetch_and_add(&inf_test_text_benchmark_n_allocations, 1);
+  return __libc_malloc(size);
+}
+
+void*
+calloc(size_t n,
+       size_t size)
+{
+  __sync_fetch_and_add(&inf_test_text_benchmark_n_allocations, 1);
+  return __libc_calloc(n, size);
+}
+
+void*
+realloc(void* ptr,
+        size_t size)
+{
+  __sync_fetch_and_add(&inf_test_text_benchmark_n_allocations, 1);
+  return __libc_realloc(ptr, size);
+}
+
+#define INF_TEST_TEXT_BENCHMARK_N_ALLOCATIONS() \
+  (inf_test_text_benchmark_n_allocations)
+#else
+#define INF_TEST_TEXT_BENCHMARK_N_ALLOCATIONS() (0)
+#endif
+
+typedef struct _InfTestTextBenchmarkSite InfTestTextBenchmarkSite;
+struct _InfTestTextBenchmarkSite {
+  InfUserTable* user_table;
+  InfTextBuffer* buffer;
+  InfAdoptedAlgorithm* algorithm;
+  /* The user generating requests at this site, NULL for the server */
+  InfAdoptedUser* local;
+  /* Index of the next request in the server log to execute */
+  guint next;
+};
+
+typedef struct _InfTestTextBenchmark InfTestTextBenchmark;
+struct _InfTestTextBenchmark {
+  gint n_users;
+  gint n_requests;
+  gint concurrency;
+  gint document_size;
+  gint max_log_size;
+  gint insert_ratio;
+  gint delete_ratio;
+  gint undo_ratio;
+  gint seed;
+  gboolean json;
+
+  GRand* rand;
+  InfTestTextBenchmarkSite server;
+  InfTestTextBenchmarkSite* sites;
+  /* All requests, in the order in which the server executed them */
+  GPtrArray* log;
+
+  gint64 server_time;
+  guint64 server_allocations;
+};
+
+static InfTextChunk*
+inf_test_text_benchmark_random_text(InfTestTextBenchmark* benchmark,
+                                    guint length,
+                                    guint author)
+{
+  InfTextChunk* chunk;
+  gchar* text;
+  guint i;
+
+  text = g_malloc(length);
+  for(i = 0; i < length; ++i)
+  {
+    if(i % 8 == 7)
+      text[i] = ' ';
+    else
+      text[i] = 'a' + g_rand_int_range(benchmark->rand, 0, 26);
+  }
+
+  chunk = inf_text_chunk_new("UTF-8");
+  inf_text_chunk_insert_text(chunk, 0, text, length, length, author);
+  g_free(text);
+
+  return chunk;
+}
+
+static void
+inf_test_text_benchmark_site_init(InfTestTextBenchmark* benchmark,
+                                  InfTestTextBenchmarkSite* site,
+                                  guint local_id,
+                                  InfTextChunk* initial)
+{
+  InfUser* user;
+  gchar* name;
+  gint i;
+
+  site->user_table = inf_user_table_new();
+  site->buffer = INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
+  site->local = NULL;
+  site->next = 0;
+
+  inf_text_buffer_insert_chunk(site->buffer, 0, initial, NULL);
+
+  for(i = 1; i <= benchmark->n_users; ++i)
+  {
+    name = g_strdup_printf("User_%d", i);
+
+    user = INF_USER(
+      g_object_new(
+        INF_TEXT_TYPE_USER,
+        "id", i,
+        "name", name,
+        "status", INF_USER_ACTIVE,
+        "flags", (guint)i == local_id ? INF_USER_LOCAL : 0,
+        NULL
+      )
+    );
+
+    g_free(name);
+    inf_user_table_add_user(site->user_table, user);
+
+    if((guint)i == local_id)
+      site->local = INF_ADOPTED_USER(user);
+
+    g_object_unref(user);
+  }
+
+  site->algorithm = inf_adopted_algorithm_new_full(
+    site->user_table,
+    INF_BUFFER(site->buffer),
+    benchmark->max_log_size
+  );
+}
+
+static void
+inf_test_text_benchmark_site_finalize(InfTestTextBenchmarkSite* site)
+{
+  g_object_unref(site->algorithm);
+  g_object_unref(site->buffer);
+  g_object_unref(site->user_table);
+}
+
+/* Executes a request that was generated at another site */
+static gboolean
+inf_test_text_benchmark_site_execute(InfTestTextBenchmarkSite* site,
+                                     InfAdoptedRequest* request,
+                                     GError** error)
+{
+  InfUser* user;
+
+  user = inf_user_table_lookup_user_by_id(
+    site->user_table,
+    inf_adopted_request_get_user_id(request)
+  );
+
+  /* The user has processed everything the request is based on */
+  inf_adopted_user_set_vector(
+    INF_ADOPTED_USER(user),
+    inf_adopted_state_vector_copy(inf_adopted_request_get_vector(request))
+  );
+
+  return inf_adopted_algorithm_execute_request(
+    site->algorithm,
+    request,
+    TRUE,
+    error
+  );
+}
+
+/* Executes requests of other users from the server log until at most
+ * max_lag requests remain unseen. */
+static gboolean
+inf_test_text_benchmark_site_deliver(InfTestTextBenchmark* benchmark,
+                                     InfTestTextBenchmarkSite* site,
+                                     guint max_lag,
+                                     GError** error)
+{
+  InfAdoptedRequest* request;
+
+  while(benchmark->log->len - site->next > max_lag)
+  {
+    request = g_ptr_array_index(benchmark->log, site->next);
+    ++site->next;
+
+    if(inf_adopted_request_get_user_id(request) ==
+       inf_user_get_id(INF_USER(site->local)))
+    {
+      continue;
+    }
+
+    if(!inf_test_text_benchmark_site_execute(site, request, error))
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+static InfAdoptedRequest*
+inf_test_text_benchmark_site_generate(InfTestTextBenchmark* benchmark,
+                                      InfTestTextBenchmarkSite* site,
+                                      GError** error)
+{
+  InfAdoptedOperation* operation;
+  InfAdoptedRequest* request;
+  InfTextChunk* chunk;
+  guint user_id;
+  guint length;
+  guint pos;
+  guint len;
+  gint kind;
+
+  user_id = inf_user_get_id(INF_USER(site->local));
+  length = inf_text_buffer_get_length(site->buffer);
+  kind = g_rand_int_range(benchmark->rand, 0, 100);
+  request = NULL;
+
+  if(kind >= benchmark->insert_ratio + benchmark->delete_ratio &&
+     kind < benchmark->insert_ratio + benchmark->delete_ratio +
+            benchmark->undo_ratio)
+  {
+    if(inf_adopted_algorithm_can_undo(site->algorithm, site->local))
+    {
+      request = inf_adopted_algorithm_generate_request(
+        site->algorithm,
+        INF_ADOPTED_REQUEST_UNDO,
+        site->local,
+        NULL
+      );
+    }
+  }
+  else if(kind >= benchmark->insert_ratio + benchmark->delete_ratio +
+                  benchmark->undo_ratio)
+  {
+    if(inf_adopted_algorithm_can_redo(site->algorithm, site->local))
+    {
+      request = inf_adopted_algorithm_generate_request(
+        site->algorithm,
+        INF_ADOPTED_REQUEST_REDO,
+        site->local,
+        NULL
+      );
+    }
+  }
+
+  if(request == NULL)
+  {
+    if(length > 0 && kind >= benchmark->insert_ratio &&
+       kind < benchmark->insert_ratio + benchmark->delete_ratio)
+    {
+      pos = g_rand_int_range(benchmark->rand, 0, length);
+      len = g_rand_int_range(benchmark->rand, 1, MIN(length - pos, 8) + 1);
+      chunk = inf_text_buffer_get_slice(site->buffer, pos, len);
+      operation = INF_ADOPTED_OPERATION(
+        inf_text_default_delete_operation_new(pos, chunk)
+      );
+    }
+    else
+    {
+      pos = g_rand_int_range(benchmark->rand, 0, length + 1);
+      len = g_rand_int_range(benchmark->rand, 1, 9);
+      chunk = inf_test_text_benchmark_random_text(benchmark, len, user_id);
+      operation = INF_ADOPTED_OPERATION(
+        inf_text_default_insert_operation_new(pos, chunk)
+      );
+    }
+
+    inf_text_chunk_free(chunk);
+
+    request = inf_adopted_algorithm_generate_request(
+      site->algorithm,
+      INF_ADOPTED_REQUEST_DO,
+      site->local,
+      operation
+    );
+
+    g_object_unref(operation);
+  }
+
+  if(!inf_adopted_algorithm_execute_request(site->algorithm, request, TRUE,
+                                            error))
+  {
+    g_object_unref(request);
+    return NULL;
+  }
+
+  return request;
+}
+
+static gboolean
+inf_test_text_benchmark_run(InfTestTextBenchmark* benchmark,
+                            GError** error)
+{
+  InfTestTextBenchmarkSite* site;
+  InfAdoptedRequest* request;
+  guint64 allocations;
+  gint64 start;
+  gint i;
+
+  for(i = 0; i < benchmark->n_requests; ++i)
+  {
+    site = &benchmark->sites[
+      g_rand_int_range(benchmark->rand, 0, benchmark->n_users)
+    ];
+
+    if(!inf_test_text_benchmark_site_deliver(benchmark, site,
+                                             benchmark->concurrency, error))
+    {
+      return FALSE;
+    }
+
+    request = inf_test_text_benchmark_site_generate(benchmark, site, error);
+    if(request == NULL) return FALSE;
+
+    g_ptr_array_add(benchmark->log, request);
+
+    allocations = INF_TEST_TEXT_BENCHMARK_N_ALLOCATIONS();
+    start = g_get_monotonic_time();
+
+    if(!inf_test_text_benchmark_site_execute(&benchmark->server, request,
+                                             error))
+    {
+      return FALSE;
+    }
+
+    benchmark->server_time += g_get_monotonic_time() - start;
+    benchmark->server_allocations +=
+      INF_TEST_TEXT_BENCHMARK_N_ALLOCATIONS() - allocations;
+  }
+
+  return TRUE;
+}
+
+/* Brings all sites to the final state and checks that they converged */
+static gboolean
+inf_test_text_benchmark_verify(InfTestTextBenchmark* benchmark,
+                               GError** error)
+{
+  InfTextChunk* expected;
+  InfTextChunk* chunk;
+  gboolean result;
+  gint i;
+
+  expected = inf_text_buffer_get_slice(
+    benchmark->server.buffer,
+    0,
+    inf_text_buffer_get_length(benchmark->server.buffer)
+  );
+
+  result = TRUE;
+  for(i = 0; i < benchmark->n_users && result == TRUE; ++i)
+  {
+    if(!inf_test_text_benchmark_site_deliver(benchmark, &benchmark->sites[i],
+                                             0, error))
+    {
+      result = FALSE;
+      break;
+    }
+
+    chunk = inf_text_buffer_get_slice(
+      benchmark->sites[i].buffer,
+      0,
+      inf_text_buffer_get_length(benchmark->sites[i].buffer)
+    );
+
+    if(!inf_text_chunk_equal(chunk, expected))
+    {
+      g_set_error(
+        error,
+        g_quark_from_static_string("INF_TEST_TEXT_BENCHMARK_ERROR"),
+        0,
+        "Buffer of user %d does not match the server's buffer",
+        i + 1
+      );
+
+      result = FALSE;
+    }
+
+    inf_text_chunk_free(chunk);
+  }
+
+  inf_text_chunk_free(expected);
+  return result;
+}
+
+static void
+inf_test_text_benchmark_report(InfTestTextBenchmark* benchmark)
+{
+  InfAdoptedAlgorithmStatistics stats;
+  struct rusage usage;
+  gdouble seconds;
+  gdouble hit_rate;
+
+  inf_adopted_algorithm_get_statistics(benchmark->server.algorithm, &stats);
+  getrusage(RUSAGE_SELF, &usage);
+
+  seconds = benchmark->server_time / 1e6;
+  hit_rate = 0.0;
+  if(stats.n_cache_lookups > 0)
+    hit_rate = (gdouble)stats.n_cache_hits / stats.n_cache_lookups;
+
+  if(benchmark->json)
+  {
+    printf(
+      "{ \"users\": %d, \"requests\": %d, \"concurrency\": %d, "
+      "\"document_size\": %d, \"seed\": %d,\n"
+      "  \"seconds\": %.6f, \"requests_per_second\": %.1f,\n"
+      "  \"transformations\": %" G_GUINT64_FORMAT ", "
+      "\"transformations_per_second\": %.1f,\n"
+      "  \"folds\": %" G_GUINT64_FORMAT ", "
+      "\"mirrors\": %" G_GUINT64_FORMAT ",\n"
+      "  \"cache_lookups\": %" G_GUINT64_FORMAT ", "
+      "\"cache_hit_rate\": %.4f,\n"
+      "  \"allocations\": %" G_GUINT64_FORMAT ", "
+      "\"peak_rss_kib\": %ld }\n",
+      benchmark->n_users,
+      benchmark->n_requests,
+      benchmark->concurrency,
+      benchmark->document_size,
+      benchmark->seed,
+      seconds,
+      seconds > 0.0 ? stats.n_executed / seconds : 0.0,
+      stats.n_transformations,
+      seconds > 0.0 ? stats.n_transformations / seconds : 0.0,
+      stats.n_folds,
+      stats.n_mirrors,
+      stats.n_cache_lookups,
+      hit_rate,
+      benchmark->server_allocations,
+      usage.ru_maxrss
+    );
+  }
+  else
+  {
+    printf(
+      "%d users, %d requests, concurrency %d, document size %d, seed %d\n",
+      benchmark->n_users,
+      benchmark->n_requests,
+      benchmark->concurrency,
+      benchmark->document_size,
+      benchmark->seed
+    );
+
+    printf(
+      "Executed %" G_GUINT64_FORMAT " requests in %.3f s "
+      "(%.0f requests/s)\n",
+      stats.n_executed,
+      seconds,
+      seconds > 0.0 ? stats.n_executed / seconds : 0.0
+    );
+
+    printf(
+      "Transformations: %" G_GUINT64_FORMAT " (%.0f/s), "
+      "folds: %" G_GUINT64_FORMAT ", mirrors: %" G_GUINT64_FORMAT "\n",
+      stats.n_transformations,
+      seconds > 0.0 ? stats.n_transformations / seconds : 0.0,
+      stats.n_folds,
+      stats.n_mirrors
+    );
+
+    printf(
+      "Cache lookups: %" G_GUINT64_FORMAT ", hit rate %.1f%%\n",
+      stats.n_cache_lookups,
+      hit_rate * 100.0
+    );
+
+#ifdef __GLIBC__
+    printf(
+      "Allocations: %" G_GUINT64_FORMAT " (%.1f per request)\n",
+      benchmark->server_allocations,
+      stats.n_executed > 0 ?
+        (gdouble)benchmark->server_allocations / stats.n_executed : 0.0
+    );
+#endif
+
+    printf("Peak RSS: %ld KiB\n", usage.ru_maxrss);
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  InfTestTextBenchmark benchmark;
+  GOptionContext* context;
+  InfTextChunk* initial;
+  GError* error;
+  int ret;
+  gint i;
+
+  GOptionEntry entries[] = {
+    { "users", 'u', 0, G_OPTION_ARG_INT, NULL,
+      "Number of concurrently editing users, defaults to 4", "N" },
+    { "requests", 'n', 0, G_OPTION_ARG_INT, NULL,
+      "Total number of requests, defaults to 10000", "N" },
+    { "concurrency", 'c', 0, G_OPTION_ARG_INT, NULL,
+      "Number of requests a user may lag behind, defaults to 4", "N" },
+    { "document-size", 'd', 0, G_OPTION_ARG_INT, NULL,
+      "Initial document size in characters, defaults to 10000", "N" },
+    { "max-total-log-size", 'l', 0, G_OPTION_ARG_INT, NULL,
+      "Maximum request log size of the algorithms, defaults to 2048", "N" },
+    { "insert", 'i', 0, G_OPTION_ARG_INT, NULL,
+      "Percentage of insert requests, defaults to 60", "PERCENT" },
+    { "delete", 'r', 0, G_OPTION_ARG_INT, NULL,
+      "Percentage of delete requests, defaults to 30", "PERCENT" },
+    { "undo", 'z', 0, G_OPTION_ARG_INT, NULL,
+      "Percentage of undo requests, defaults to 7. The remaining requests "
+      "are redo requests.", "PERCENT" },
+    { "seed", 's', 0, G_OPTION_ARG_INT, NULL,
+      "Random seed of the workload, defaults to 1", "SEED" },
+    { "json", 'j', 0, G_OPTION_ARG_NONE, NULL,
+      "Print the results as JSON", NULL },
+    { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL }
+  };
+
+  benchmark.n_users = 4;
+  benchmark.n_requests = 10000;
+  benchmark.concurrency = 4;
+  benchmark.document_size = 10000;
+  benchmark.max_log_size = 2048;
+  benchmark.insert_ratio = 60;
+  benchmark.delete_ratio = 30;
+  benchmark.undo_ratio = 7;
+  benchmark.seed = 1;
+  benchmark.json = FALSE;
+
+  entries[0].arg_data = &benchmark.n_users;
+  entries[1].arg_data = &benchmark.n_requests;
+  entries[2].arg_data = &benchmark.concurrency;
+  entries[3].arg_data = &benchmark.document_size;
+  entries[4].arg_data = &benchmark.max_log_size;
+  entries[5].arg_data = &benchmark.insert_ratio;
+  entries[6].arg_data = &benchmark.delete_ratio;
+  entries[7].arg_data = &benchmark.undo_ratio;
+  entries[8].arg_data = &benchmark.seed;
+  entries[9].arg_data = &benchmark.json;
+
+  error = NULL;
+  context = g_option_context_new("- benchmark InfAdoptedAlgorithm");
+  g_option_context_add_main_entries(context, entries, NULL);
+
+  if(!g_option_context_parse(context, &argc, &argv, &error))
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    g_option_context_free(context);
+    return -1;
+  }
+
+  g_option_context_free(context);
+
+  if(benchmark.n_users < 1 || benchmark.n_requests < 0 ||
+     benchmark.concurrency < 0 || benchmark.document_size < 0 ||
+     benchmark.max_log_size < 0 || benchmark.insert_ratio < 0 ||
+     benchmark.delete_ratio < 0 || benchmark.undo_ratio < 0 ||
+     benchmark.insert_ratio + benchmark.delete_ratio +
+     benchmark.undo_ratio > 100)
+  {
+    fprintf(stderr, "Invalid benchmark parameters\n");
+    return -1;
+  }
+
+  if(!inf_init(&error))
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return -1;
+  }
+
+  benchmark.rand = g_rand_new_with_seed(benchmark.seed);
+  benchmark.log = g_ptr_array_new_with_free_func(g_object_unref);
+  benchmark.server_time = 0;
+  benchmark.server_allocations = 0;
+
+  initial = inf_test_text_benchmark_random_text(
+    &benchmark,
+    benchmark.document_size,
+    0
+  );
+
+  inf_test_text_benchmark_site_init(&benchmark, &benchmark.server, 0, initial);
+  benchmark.sites = g_new(InfTestTextBenchmarkSite, benchmark.n_users);
+  for(i = 0; i < benchmark.n_users; ++i)
+  {
+    inf_test_text_benchmark_site_init(
+      &benchmark,
+      &benchmark.sites[i],
+      i + 1,
+      initial
+    );
+  }
+
+  inf_text_chunk_free(initial);
+
+  ret = 0;
+  if(!inf_test_text_benchmark_run(&benchmark, &error) ||
+     !inf_test_text_benchmark_verify(&benchmark, &error))
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    ret = -1;
+  }
+  else
+  {
+    inf_test_text_benchmark_report(&benchmark);
+  }
+
+  for(i = 0; i < benchmark.n_users; ++i)
+    inf_test_text_benchmark_site_finalize(&benchmark.sites[i]);
+  inf_test_text_benchmark_site_finalize(&benchmark.server);
+  g_free(benchmark.sites);
+
+  g_ptr_array_free(benchmark.log, TRUE);
+  g_rand_free(benchmark.rand);
+
+  return ret;
+}
+
+/* vim:set et sw=2 ts=2: */
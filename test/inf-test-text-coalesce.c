@@ -0,0 +1,534 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Tests InfAdoptedSession:coalesce-interval. A host session relays the
+ * requests of a writer to an observer. Caret updates of the writer are only
+ * relayed once per interval, or before the next request that affects the
+ * buffer or any other message sent to the subscriptions, and the observer
+ * needs to end up in the same state as the host. */
+
+#include <libinftext/inf-text-session.h>
+#include <libinftext/inf-text-default-buffer.h>
+#include <libinftext/inf-text-user.h>
+#include <libinfinity/communication/inf-communication-manager.h>
+#include <libinfinity/common/inf-simulated-connection.h>
+#include <libinfinity/common/inf-standalone-io.h>
+#include <libinfinity/common/inf-user-table.h>
+#include <libinfinity/common/inf-xml-util.h>
+#include <libinfinity/common/inf-init.h>
+
+#include <string.h>
+#include <stdio.h>
+
+/* Coalesce interval of the host, in milliseconds */
+#define INF_TEST_TEXT_COALESCE_INTERVAL 100
+
+/* Time to wait for the coalesce timeout before the test fails, in
+ * microseconds */
+#define INF_TEST_TEXT_COALESCE_TIMEOUT (5 * G_USEC_PER_SEC)
+
+static const gchar* const INF_TEST_TEXT_COALESCE_METHODS[] = {
+  "central",
+  NULL
+};
+
+typedef struct _InfTestTextCoalesce InfTestTextCoalesce;
+struct _InfTestTextCoalesce {
+  InfStandaloneIo* io;
+
+  InfSimulatedConnection* host_writer;
+  InfSimulatedConnection* writer;
+  InfSimulatedConnection* host_observer;
+  InfSimulatedConnection* observer;
+
+  InfCommunicationManager* host_manager;
+  InfCommunicationManager* writer_manager;
+  InfCommunicationManager* observer_manager;
+
+  InfCommunicationHostedGroup* host_group;
+  InfCommunicationJoinedGroup* writer_group;
+  InfCommunicationJoinedGroup* observer_group;
+
+  InfTextSession* host_session;
+  InfTextSession* observer_session;
+
+  /* Requests and user status changes relayed to the observer, one word
+   * per message */
+  GString* relayed;
+  guint n_errors;
+};
+
+static void
+inf_test_text_coalesce_received_cb(InfXmlConnection* connection,
+                                   xmlNodePtr xml,
+                                   gpointer user_data)
+{
+  InfTestTextCoalesce* test;
+  xmlNodePtr request;
+  xmlNodePtr op;
+  xmlChar* caret;
+
+  test = (InfTestTextCoalesce*)user_data;
+
+  for(request = xml->children; request != NULL; request = request->next)
+  {
+    if(request->type != XML_ELEMENT_NODE) continue;
+
+    if(strcmp((const char*)request->name, "user-status-change") == 0)
+    {
+      g_string_append(test->relayed, "user-status-change ");
+      continue;
+    }
+
+    if(strcmp((const char*)request->name, "request") != 0) continue;
+
+    for(op = request->children; op != NULL; op = op->next)
+      if(op->type == XML_ELEMENT_NODE)
+        break;
+
+    if(op == NULL) continue;
+
+    if(strcmp((const char*)op->name, "move") == 0)
+    {
+      caret = xmlGetProp(op, (const xmlChar*)"caret");
+      g_string_append_printf(test->relayed, "move:%s ", (const char*)caret);
+      xmlFree(caret);
+    }
+    else
+    {
+      g_string_append_printf(test->relayed, "%s ", (const char*)op->name);
+    }
+  }
+}
+
+static void
+inf_test_text_coalesce_error_cb(InfSession* session,
+                                InfXmlConnection* connection,
+                                xmlNodePtr xml,
+                                const GError* error,
+                                gpointer user_data)
+{
+  InfTestTextCoalesce* test;
+  test = (InfTestTextCoalesce*)user_data;
+
+  fprintf(stderr, "Session error: %s\n", error->message);
+  ++test->n_errors;
+}
+
+static InfTextSession*
+inf_test_text_coalesce_session_new(InfTestTextCoalesce* test,
+                                   InfCommunicationManager* manager,
+                                   InfSimulatedConnection* writer)
+{
+  InfTextBuffer* buffer;
+  InfUserTable* user_table;
+  InfTextUser* user;
+  InfTextSession* session;
+
+  buffer = INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
+  inf_text_buffer_insert_text(buffer, 0, "abc", 3, 3, NULL);
+
+  user = INF_TEXT_USER(
+    g_object_new(
+      INF_TEXT_TYPE_USER,
+      "id", 1,
+      "name", "Writer",
+      "status", INF_USER_ACTIVE,
+      "flags", 0,
+      "connection", writer,
+      NULL
+    )
+  );
+
+  user_table = inf_user_table_new();
+  inf_user_table_add_user(user_table, INF_USER(user));
+  g_object_unref(user);
+
+  session = inf_text_session_new_with_user_table(
+    manager,
+    buffer,
+    INF_IO(test->io),
+    user_table,
+    INF_SESSION_RUNNING,
+    NULL,
+    NULL
+  );
+
+  g_object_unref(user_table);
+  g_object_unref(buffer);
+
+  g_signal_connect(
+    G_OBJECT(session),
+    "error",
+    G_CALLBACK(inf_test_text_coalesce_error_cb),
+    test
+  );
+
+  return session;
+}
+
+static void
+inf_test_text_coalesce_send(InfTestTextCoalesce* test,
+                            const gchar* op_name,
+                            const gchar* attribute,
+                            guint value,
+                            const gchar* text)
+{
+  xmlNodePtr xml;
+  xmlNodePtr op;
+
+  xml = xmlNewNode(NULL, (const xmlChar*)"request");
+  inf_xml_util_set_attribute(xml, "time", "");
+  inf_xml_util_set_attribute_uint(xml, "user", 1);
+
+  op = xmlNewChild(xml, NULL, (const xmlChar*)op_name, (const xmlChar*)text);
+  inf_xml_util_set_attribute_uint(op, attribute, value);
+  if(strcmp(op_name, "move") == 0)
+    inf_xml_util_set_attribute_int(op, "selection", 0);
+
+  inf_communication_group_send_message(
+    INF_COMMUNICATION_GROUP(test->writer_group),
+    INF_XML_CONNECTION(test->writer),
+    xml
+  );
+}
+
+/* Sends a message to all subscriptions of the host, which does not change
+ * the status of the writer */
+static void
+inf_test_text_coalesce_send_status(InfTestTextCoalesce* test)
+{
+  xmlNodePtr xml;
+
+  xml = xmlNewNode(NULL, (const xmlChar*)"user-status-change");
+  inf_xml_util_set_attribute_uint(xml, "id", 1);
+  inf_xml_util_set_attribute(xml, "status", "active");
+
+  inf_session_send_to_subscriptions(INF_SESSION(test->host_session), xml);
+}
+
+static InfTextUser*
+inf_test_text_coalesce_get_writer(InfTextSession* session)
+{
+  return INF_TEXT_USER(
+    inf_user_table_lookup_user_by_id(
+      inf_session_get_user_table(INF_SESSION(session)),
+      1
+    )
+  );
+}
+
+static InfTextChunk*
+inf_test_text_coalesce_get_text(InfTextSession* session)
+{
+  InfTextBuffer* buffer;
+  buffer = INF_TEXT_BUFFER(inf_session_get_buffer(INF_SESSION(session)));
+
+  return inf_text_buffer_get_slice(
+    buffer,
+    0,
+    inf_text_buffer_get_length(buffer)
+  );
+}
+
+/* Checks the requests relayed so far, and that the observer has the same
+ * state as the host. */
+static gboolean
+inf_test_text_coalesce_check(InfTestTextCoalesce* test,
+                             const gchar* relayed,
+                             guint caret)
+{
+  InfTextChunk* host_chunk;
+  InfTextChunk* observer_chunk;
+  gchar* host_text;
+  gchar* observer_text;
+  gsize host_bytes;
+  gsize observer_bytes;
+  guint host_caret;
+  guint observer_caret;
+  gboolean result;
+
+  result = TRUE;
+
+  if(strcmp(test->relayed->str, relayed) != 0)
+  {
+    fprintf(
+      stderr,
+      "Relayed \"%s\", expected \"%s\"\n",
+      test->relayed->str,
+      relayed
+    );
+
+    result = FALSE;
+  }
+
+  host_caret = inf_text_user_get_caret_position(
+    inf_test_text_coalesce_get_writer(test->host_session)
+  );
+
+  observer_caret = inf_text_user_get_caret_position(
+    inf_test_text_coalesce_get_writer(test->observer_session)
+  );
+
+  if(observer_caret != caret)
+  {
+    fprintf(
+      stderr,
+      "Caret is at %u for the observer and %u for the host, expected %u\n",
+      observer_caret,
+      host_caret,
+      caret
+    );
+
+    result = FALSE;
+  }
+
+  host_chunk = inf_test_text_coalesce_get_text(test->host_session);
+  observer_chunk = inf_test_text_coalesce_get_text(test->observer_session);
+
+  if(!inf_text_chunk_equal(host_chunk, observer_chunk))
+  {
+    host_text = inf_text_chunk_get_text(host_chunk, &host_bytes);
+    observer_text = inf_text_chunk_get_text(observer_chunk, &observer_bytes);
+
+    fprintf(
+      stderr,
+      "Buffer is \"%.*s\" for the observer, but \"%.*s\" for the host\n",
+      (int)observer_bytes,
+      observer_text,
+      (int)host_bytes,
+      host_text
+    );
+
+    g_free(host_text);
+    g_free(observer_text);
+    result = FALSE;
+  }
+
+  inf_text_chunk_free(host_chunk);
+  inf_text_chunk_free(observer_chunk);
+
+  if(test->n_errors > 0)
+    result = FALSE;
+
+  return result;
+}
+
+static gboolean
+inf_test_text_coalesce_run(InfTestTextCoalesce* test)
+{
+  gint64 deadline;
+  gsize length;
+
+  /* Caret updates are held back for the observer */
+  inf_test_text_coalesce_send(test, "move", "caret", 1, NULL);
+  inf_test_text_coalesce_send(test, "move", "caret", 2, NULL);
+  inf_test_text_coalesce_send(test, "move", "caret", 3, NULL);
+
+  if(!inf_test_text_coalesce_check(test, "", 0))
+    return FALSE;
+
+  /* The latest one is relayed right before the next request that affects
+   * the buffer, which moves the caret further. */
+  inf_test_text_coalesce_send(test, "insert", "pos", 0, "x");
+
+  if(!inf_test_text_coalesce_check(test, "move:3 insert ", 4))
+    return FALSE;
+
+  /* Without another request, the latest update is relayed once the
+   * interval has elapsed */
+  inf_test_text_coalesce_send(test, "move", "caret", 2, NULL);
+  inf_test_text_coalesce_send(test, "move", "caret", 1, NULL);
+
+  if(!inf_test_text_coalesce_check(test, "move:3 insert ", 4))
+    return FALSE;
+
+  length = test->relayed->len;
+  deadline = g_get_monotonic_time() + INF_TEST_TEXT_COALESCE_TIMEOUT;
+  while(test->relayed->len == length)
+  {
+    if(g_get_monotonic_time() >= deadline)
+    {
+      fprintf(stderr, "Held back caret update was not relayed\n");
+      return FALSE;
+    }
+
+    inf_standalone_io_iteration_timeout(test->io, 10);
+  }
+
+  if(!inf_test_text_coalesce_check(test, "move:3 insert move:1 ", 1))
+    return FALSE;
+
+  /* A held back update is also relayed before messages that the host sends
+   * to all subscriptions itself */
+  inf_test_text_coalesce_send(test, "move", "caret", 2, NULL);
+
+  if(!inf_test_text_coalesce_check(test, "move:3 insert move:1 ", 1))
+    return FALSE;
+
+  inf_test_text_coalesce_send_status(test);
+
+  return inf_test_text_coalesce_check(
+    test,
+    "move:3 insert move:1 move:2 user-status-change ",
+    2
+  );
+}
+
+int
+main(int argc, char* argv[])
+{
+  InfTestTextCoalesce test;
+  GError* error;
+  gboolean result;
+
+  error = NULL;
+  if(!inf_init(&error))
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return -1;
+  }
+
+  test.io = inf_standalone_io_new();
+  test.relayed = g_string_new(NULL);
+  test.n_errors = 0;
+
+  test.host_writer = inf_simulated_connection_new();
+  test.writer = inf_simulated_connection_new();
+  inf_simulated_connection_connect(test.host_writer, test.writer);
+
+  test.host_observer = inf_simulated_connection_new();
+  test.observer = inf_simulated_connection_new();
+  inf_simulated_connection_connect(test.host_observer, test.observer);
+
+  g_signal_connect(
+    G_OBJECT(test.observer),
+    "received",
+    G_CALLBACK(inf_test_text_coalesce_received_cb),
+    &test
+  );
+
+  test.host_manager = inf_communication_manager_new();
+  test.writer_manager = inf_communication_manager_new();
+  test.observer_manager = inf_communication_manager_new();
+
+  test.host_session = inf_test_text_coalesce_session_new(
+    &test,
+    test.host_manager,
+    test.host_writer
+  );
+
+  test.observer_session = inf_test_text_coalesce_session_new(
+    &test,
+    test.observer_manager,
+    test.observer
+  );
+
+  g_object_set(
+    G_OBJECT(test.host_session),
+    "coalesce-interval", INF_TEST_TEXT_COALESCE_INTERVAL,
+    NULL
+  );
+
+  test.host_group = inf_communication_manager_open_group(
+    test.host_manager,
+    "InfText",
+    INF_TEST_TEXT_COALESCE_METHODS
+  );
+
+  inf_communication_group_set_target(
+    INF_COMMUNICATION_GROUP(test.host_group),
+    INF_COMMUNICATION_OBJECT(test.host_session)
+  );
+
+  inf_session_set_subscription_group(
+    INF_SESSION(test.host_session),
+    INF_COMMUNICATION_GROUP(test.host_group)
+  );
+
+  inf_communication_hosted_group_add_member(
+    test.host_group,
+    INF_XML_CONNECTION(test.host_writer)
+  );
+
+  inf_communication_hosted_group_add_member(
+    test.host_group,
+    INF_XML_CONNECTION(test.host_observer)
+  );
+
+  test.writer_group = inf_communication_manager_join_group(
+    test.writer_manager,
+    "InfText",
+    INF_XML_CONNECTION(test.writer),
+    "central"
+  );
+
+  test.observer_group = inf_communication_manager_join_group(
+    test.observer_manager,
+    "InfText",
+    INF_XML_CONNECTION(test.observer),
+    "central"
+  );
+
+  inf_communication_group_set_target(
+    INF_COMMUNICATION_GROUP(test.observer_group),
+    INF_COMMUNICATION_OBJECT(test.observer_session)
+  );
+
+  inf_session_set_subscription_group(
+    INF_SESSION(test.observer_session),
+    INF_COMMUNICATION_GROUP(test.observer_group)
+  );
+
+  result = inf_test_text_coalesce_run(&test);
+
+  inf_session_set_subscription_group(INF_SESSION(test.host_session), NULL);
+  inf_session_set_subscription_group(INF_SESSION(test.observer_session), NULL);
+
+  g_object_unref(test.observer_group);
+  g_object_unref(test.writer_group);
+  g_object_unref(test.host_group);
+
+  g_object_unref(test.observer_session);
+  g_object_unref(test.host_session);
+
+  g_object_unref(test.observer_manager);
+  g_object_unref(test.writer_manager);
+  g_object_unref(test.host_manager);
+
+  inf_xml_connection_close(INF_XML_CONNECTION(test.host_observer));
+  inf_xml_connection_close(INF_XML_CONNECTION(test.host_writer));
+  g_object_unref(test.observer);
+  g_object_unref(test.host_observer);
+  g_object_unref(test.writer);
+  g_object_unref(test.host_writer);
+
+  g_string_free(test.relayed, TRUE);
+  g_object_unref(test.io);
+
+  inf_deinit();
+
+  if(result == FALSE)
+    return -1;
+
+  return 0;
+}
+
+/* vim:set et sw=2 ts=2: */
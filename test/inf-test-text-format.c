@@ -0,0 +1,726 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Round-trip tests for the XML and the compact text document formats, and
+ * for replaying the document journal */
+
+#include <libinftext/inf-text-filesystem-format.h>
+#include <libinftext/inf-text-filesystem-journal.h>
+#include <libinftext/inf-text-default-buffer.h>
+#include <libinftext/inf-text-user.h>
+
+#include <libinfinity/server/infd-filesystem-storage.h>
+#include <libinfinity/common/inf-init.h>
+
+#include <glib/gstdio.h>
+#include <string.h>
+#include <stdio.h>
+
+typedef gboolean(*InfTestTextFormatWriteFunc)(InfdFilesystemStorage*,
+                                              const gchar*,
+                                              InfUserTable*,
+                                              InfTextBuffer*,
+                                              GError**);
+
+typedef struct _InfTestTextFormatDocument InfTestTextFormatDocument;
+struct _InfTestTextFormatDocument {
+  InfUserTable* user_table;
+  InfTextBuffer* buffer;
+};
+
+static gboolean
+inf_test_text_format_write_xml(InfdFilesystemStorage* storage,
+                               const gchar* path,
+                               InfUserTable* user_table,
+                               InfTextBuffer* buffer,
+                               GError** error)
+{
+  return inf_text_filesystem_format_write(
+    storage,
+    path,
+    user_table,
+    buffer,
+    error
+  );
+}
+
+static gboolean
+inf_test_text_format_write_compact(InfdFilesystemStorage* storage,
+                                   const gchar* path,
+                                   InfUserTable* user_table,
+                                   InfTextBuffer* buffer,
+                                   GError** error)
+{
+  return inf_text_filesystem_format_write_compact(
+    storage,
+    path,
+    user_table,
+    buffer,
+    FALSE,
+    error
+  );
+}
+
+static gboolean
+inf_test_text_format_write_compressed(InfdFilesystemStorage* storage,
+                                      const gchar* path,
+                                      InfUserTable* user_table,
+                                      InfTextBuffer* buffer,
+                                      GError** error)
+{
+  return inf_text_filesystem_format_write_compact(
+    storage,
+    path,
+    user_table,
+    buffer,
+    TRUE,
+    error
+  );
+}
+
+static void
+inf_test_text_format_add_user(InfUserTable* user_table,
+                              guint id,
+                              const gchar* name,
+                              gdouble hue)
+{
+  InfUser* user;
+
+  user = INF_USER(
+    g_object_new(
+      INF_TEXT_TYPE_USER,
+      "id", id,
+      "name", name,
+      "hue", hue,
+      NULL
+    )
+  );
+
+  inf_user_table_add_user(user_table, user);
+  g_object_unref(user);
+}
+
+static void
+inf_test_text_format_insert(InfTestTextFormatDocument* document,
+                            const gchar* text,
+                            guint author)
+{
+  InfUser* user;
+
+  user = NULL;
+  if(author != 0)
+    user = inf_user_table_lookup_user_by_id(document->user_table, author);
+
+  inf_text_buffer_insert_text(
+    document->buffer,
+    inf_text_buffer_get_length(document->buffer),
+    text,
+    strlen(text),
+    g_utf8_strlen(text, -1),
+    user
+  );
+}
+
+static void
+inf_test_text_format_document_init(InfTestTextFormatDocument* document)
+{
+  document->user_table = inf_user_table_new();
+  document->buffer = INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
+}
+
+static void
+inf_test_text_format_document_clear(InfTestTextFormatDocument* document)
+{
+  g_object_unref(document->user_table);
+  g_object_unref(document->buffer);
+}
+
+static gboolean
+inf_test_text_format_compare_buffers(InfTextBuffer* first,
+                                     InfTextBuffer* second)
+{
+  InfTextChunk* chunk1;
+  InfTextChunk* chunk2;
+  InfTextChunkIter iter1;
+  InfTextChunkIter iter2;
+  gboolean has1;
+  gboolean has2;
+  gboolean result;
+
+  chunk1 = inf_text_buffer_get_slice(
+    first,
+    0,
+    inf_text_buffer_get_length(first)
+  );
+
+  chunk2 = inf_text_buffer_get_slice(
+    second,
+    0,
+    inf_text_buffer_get_length(second)
+  );
+
+  has1 = inf_text_chunk_iter_init_begin(chunk1, &iter1);
+  has2 = inf_text_chunk_iter_init_begin(chunk2, &iter2);
+  result = TRUE;
+
+  while(has1 && has2)
+  {
+    if(inf_text_chunk_iter_get_author(&iter1) !=
+       inf_text_chunk_iter_get_author(&iter2) ||
+       inf_text_chunk_iter_get_length(&iter1) !=
+       inf_text_chunk_iter_get_length(&iter2) ||
+       inf_text_chunk_iter_get_bytes(&iter1) !=
+       inf_text_chunk_iter_get_bytes(&iter2) ||
+       memcmp(inf_text_chunk_iter_get_text(&iter1),
+              inf_text_chunk_iter_get_text(&iter2),
+              inf_text_chunk_iter_get_bytes(&iter1)) != 0)
+    {
+      result = FALSE;
+      break;
+    }
+
+    has1 = inf_text_chunk_iter_next(&iter1);
+    has2 = inf_text_chunk_iter_next(&iter2);
+  }
+
+  if(has1 != has2)
+    result = FALSE;
+
+  inf_text_chunk_free(chunk1);
+  inf_text_chunk_free(chunk2);
+  return result;
+}
+
+static void
+inf_test_text_format_compare_users_func(InfUser* user,
+                                        gpointer user_data)
+{
+  gpointer* data;
+  InfUserTable* other_table;
+  InfUser* other;
+
+  data = (gpointer*)user_data;
+  other_table = INF_USER_TABLE(data[0]);
+
+  other = inf_user_table_lookup_user_by_id(
+    other_table,
+    inf_user_get_id(user)
+  );
+
+  if(other == NULL ||
+     strcmp(inf_user_get_name(user), inf_user_get_name(other)) != 0 ||
+     inf_text_user_get_hue(INF_TEXT_USER(user)) !=
+     inf_text_user_get_hue(INF_TEXT_USER(other)))
+  {
+    data[1] = GINT_TO_POINTER(FALSE);
+  }
+}
+
+static gboolean
+inf_test_text_format_compare_users(InfUserTable* first,
+                                   InfUserTable* second)
+{
+  gpointer data[2];
+
+  data[0] = second;
+  data[1] = GINT_TO_POINTER(TRUE);
+  inf_user_table_foreach_user(
+    first,
+    inf_test_text_format_compare_users_func,
+    data
+  );
+
+  if(GPOINTER_TO_INT(data[1]) == FALSE)
+    return FALSE;
+
+  data[0] = first;
+  inf_user_table_foreach_user(
+    second,
+    inf_test_text_format_compare_users_func,
+    data
+  );
+
+  return GPOINTER_TO_INT(data[1]);
+}
+
+static gboolean
+inf_test_text_format_roundtrip(InfdFilesystemStorage* storage,
+                               const gchar* name,
+                               InfTestTextFormatWriteFunc write_func,
+                               InfTestTextFormatDocument* original,
+                               InfTestTextFormatDocument* result)
+{
+  GError* error;
+
+  error = NULL;
+  if(!write_func(storage, name, original->user_table, original->buffer,
+                 &error))
+  {
+    printf("%s: Failed to write: %s\n", name, error->message);
+    g_error_free(error);
+    return FALSE;
+  }
+
+  inf_test_text_format_document_init(result);
+
+  if(!inf_text_filesystem_format_read(storage, name, result->user_table,
+                                      result->buffer, &error))
+  {
+    printf("%s: Failed to read: %s\n", name, error->message);
+    g_error_free(error);
+    return FALSE;
+  }
+
+  if(!inf_test_text_format_compare_buffers(original->buffer, result->buffer))
+  {
+    printf("%s: Buffer content differs after round trip\n", name);
+    return FALSE;
+  }
+
+  if(!inf_test_text_format_compare_users(original->user_table,
+                                         result->user_table))
+  {
+    printf("%s: User table differs after round trip\n", name);
+    return FALSE;
+  }
+
+  printf("%s: OK\n", name);
+  return TRUE;
+}
+
+static gboolean
+inf_test_text_format_corrupted(InfdFilesystemStorage* storage,
+                               const gchar* name,
+                               gsize truncate_by)
+{
+  InfTestTextFormatDocument document;
+  GError* error;
+  gchar* full_path;
+  gchar* contents;
+  gsize length;
+  gboolean result;
+
+  error = NULL;
+  full_path = infd_filesystem_storage_get_path(
+    storage,
+    "InfText",
+    name,
+    &error
+  );
+
+  g_assert(full_path != NULL);
+
+  if(!g_file_get_contents(full_path, &contents, &length, &error))
+  {
+    printf("%s: Failed to read file: %s\n", name, error->message);
+    g_error_free(error);
+    g_free(full_path);
+    return FALSE;
+  }
+
+  g_assert(length >= truncate_by);
+  result = g_file_set_contents(
+    full_path,
+    contents,
+    length - truncate_by,
+    &error
+  );
+
+  g_free(contents);
+  g_free(full_path);
+  g_assert(result == TRUE);
+
+  inf_test_text_format_document_init(&document);
+
+  result = inf_text_filesystem_format_read(
+    storage,
+    name,
+    document.user_table,
+    document.buffer,
+    &error
+  );
+
+  inf_test_text_format_document_clear(&document);
+
+  if(result == TRUE)
+  {
+    printf("%s: Truncated file was read successfully\n", name);
+    return FALSE;
+  }
+
+  g_error_free(error);
+  printf("%s: OK\n", name);
+  return TRUE;
+}
+
+static gboolean
+inf_test_text_format_journal(InfdFilesystemStorage* storage,
+                             const gchar* name)
+{
+  InfTestTextFormatDocument original;
+  InfTestTextFormatDocument replayed;
+  InfTextFilesystemJournal* journal;
+  GError* error;
+  guint n_records;
+  gboolean result;
+  FILE* stream;
+  guint8 garbage[16];
+
+  inf_test_text_format_document_init(&original);
+  inf_test_text_format_add_user(original.user_table, 1, "Alice", 0.25);
+  inf_test_text_format_insert(&original, "Hello, world\n", 1);
+
+  error = NULL;
+  result = inf_text_filesystem_format_write_compact(
+    storage,
+    name,
+    original.user_table,
+    original.buffer,
+    FALSE,
+    &error
+  );
+
+  journal = NULL;
+  if(result == TRUE)
+  {
+    journal = inf_text_filesystem_journal_new(
+      storage,
+      name,
+      original.user_table,
+      original.buffer,
+      &error
+    );
+
+    if(journal == NULL)
+      result = FALSE;
+  }
+
+  if(result == FALSE)
+  {
+    printf("%s: Failed to start journal: %s\n", name, error->message);
+    g_error_free(error);
+    inf_test_text_format_document_clear(&original);
+    return FALSE;
+  }
+
+  /* Changes after the snapshot, including a user that only appears in the
+   * journal */
+  inf_test_text_format_add_user(original.user_table, 2, "Bob", 0.5);
+  inf_text_buffer_erase_text(original.buffer, 5, 7, NULL);
+  inf_test_text_format_insert(&original, "wörld ☃", 2);
+  inf_test_text_format_insert(&original, "!", 1);
+
+  result = inf_text_filesystem_journal_flush(journal, &error);
+  inf_text_filesystem_journal_free(journal);
+
+  /* A zero-filled tail, as it can be left behind by a crash, must not
+   * prevent the records before it from being replayed. */
+  if(result == TRUE)
+  {
+    stream = infd_filesystem_storage_open(
+      storage,
+      "journal",
+      name,
+      "a",
+      NULL,
+      &error
+    );
+
+    if(stream == NULL)
+    {
+      result = FALSE;
+    }
+    else
+    {
+      memset(garbage, 0, sizeof(garbage));
+      infd_filesystem_storage_stream_write(stream, garbage, sizeof(garbage));
+      infd_filesystem_storage_stream_close(stream);
+    }
+  }
+
+  inf_test_text_format_document_init(&replayed);
+
+  if(result == TRUE)
+  {
+    result = inf_text_filesystem_format_read(
+      storage,
+      name,
+      replayed.user_table,
+      replayed.buffer,
+      &error
+    );
+  }
+
+  if(result == TRUE)
+  {
+    result = inf_text_filesystem_journal_replay(
+      storage,
+      name,
+      replayed.user_table,
+      replayed.buffer,
+      &n_records,
+      &error
+    );
+  }
+
+  if(result == FALSE)
+  {
+    printf("%s: Failed to replay journal: %s\n", name, error->message);
+    g_error_free(error);
+  }
+  else if(n_records == 0)
+  {
+    printf("%s: No journal records replayed\n", name);
+    result = FALSE;
+  }
+  else if(!inf_test_text_format_compare_buffers(original.buffer,
+                                                replayed.buffer))
+  {
+    printf("%s: Buffer content differs after replay\n", name);
+    result = FALSE;
+  }
+  else if(!inf_test_text_format_compare_users(original.user_table,
+                                              replayed.user_table))
+  {
+    printf("%s: User table differs after replay\n", name);
+    result = FALSE;
+  }
+
+  /* Once a new snapshot is written, the journal must not be applied on
+   * top of it again. */
+  if(result == TRUE)
+  {
+    result = inf_text_filesystem_format_write_compact(
+      storage,
+      name,
+      replayed.user_table,
+      replayed.buffer,
+      FALSE,
+      &error
+    );
+
+    if(result == TRUE)
+    {
+      result = inf_text_filesystem_journal_replay(
+        storage,
+        name,
+        replayed.user_table,
+        replayed.buffer,
+        &n_records,
+        &error
+      );
+    }
+
+    if(result == FALSE)
+    {
+      printf("%s: Failed to replay journal: %s\n", name, error->message);
+      g_error_free(error);
+    }
+    else if(n_records != 0)
+    {
+      printf("%s: Stale journal was replayed\n", name);
+      result = FALSE;
+    }
+  }
+
+  inf_test_text_format_document_clear(&original);
+  inf_test_text_format_document_clear(&replayed);
+
+  if(result == TRUE)
+    printf("%s: OK\n", name);
+  return result;
+}
+
+int
+main(int argc,
+     char* argv[])
+{
+  InfdFilesystemStorage* storage;
+  InfTestTextFormatDocument original;
+  InfTestTextFormatDocument from_xml;
+  InfTestTextFormatDocument from_compact;
+  InfTestTextFormatDocument from_compressed;
+  InfTestTextFormatDocument reread;
+  InfTestTextFormatDocument empty;
+  InfTestTextFormatDocument from_empty;
+  GError* error;
+  gchar* root_directory;
+  gboolean result;
+  GDir* dir;
+  const gchar* entry;
+  gchar* entry_path;
+
+  error = NULL;
+  if(!inf_init(&error))
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return -1;
+  }
+
+  root_directory = g_dir_make_tmp("inf-test-text-format-XXXXXX", &error);
+  if(root_directory == NULL)
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return -1;
+  }
+
+  storage = infd_filesystem_storage_new(root_directory);
+
+  inf_test_text_format_document_init(&original);
+  inf_test_text_format_add_user(original.user_table, 1, "Alice", 0.25);
+  inf_test_text_format_add_user(original.user_table, 2, "Bö<b>", 0.75);
+
+  inf_test_text_format_insert(&original, "Hello, ", 1);
+  inf_test_text_format_insert(&original, "wörld & <friends>\n", 2);
+  inf_test_text_format_insert(&original, "anonymous\n", 0);
+  inf_test_text_format_insert(&original, "ünïcödé ☃\n", 1);
+
+  from_xml.user_table = NULL;
+  from_compact.user_table = NULL;
+  from_compressed.user_table = NULL;
+  reread.user_table = NULL;
+  from_empty.user_table = NULL;
+
+  result = inf_test_text_format_roundtrip(
+    storage,
+    "xml",
+    inf_test_text_format_write_xml,
+    &original,
+    &from_xml
+  );
+
+  /* Convert the document read from XML to the compact format */
+  if(result == TRUE)
+  {
+    result = inf_test_text_format_roundtrip(
+      storage,
+      "compact",
+      inf_test_text_format_write_compact,
+      &from_xml,
+      &from_compact
+    );
+  }
+
+  /* Convert back to XML from the memory-mapped document */
+  if(result == TRUE)
+  {
+    result = inf_test_text_format_roundtrip(
+      storage,
+      "compact-to-xml",
+      inf_test_text_format_write_xml,
+      &from_compact,
+      &reread
+    );
+
+    if(reread.user_table != NULL)
+      inf_test_text_format_document_clear(&reread);
+    reread.user_table = NULL;
+  }
+
+  /* Modify the memory-mapped document and overwrite the file it was read
+   * from while the buffer still references the previous file content. */
+  if(result == TRUE)
+  {
+    inf_text_buffer_erase_text(from_compact.buffer, 2, 5, NULL);
+    inf_test_text_format_insert(&from_compact, "appended", 2);
+
+    result = inf_test_text_format_roundtrip(
+      storage,
+      "compact",
+      inf_test_text_format_write_compact,
+      &from_compact,
+      &reread
+    );
+
+    if(reread.user_table != NULL)
+      inf_test_text_format_document_clear(&reread);
+    reread.user_table = NULL;
+  }
+
+  if(result == TRUE && inf_text_filesystem_format_supports_compression())
+  {
+    result = inf_test_text_format_roundtrip(
+      storage,
+      "compressed",
+      inf_test_text_format_write_compressed,
+      &from_xml,
+      &from_compressed
+    );
+  }
+
+  if(result == TRUE)
+  {
+    inf_test_text_format_document_init(&empty);
+
+    result = inf_test_text_format_roundtrip(
+      storage,
+      "empty",
+      inf_test_text_format_write_compact,
+      &empty,
+      &from_empty
+    );
+
+    inf_test_text_format_document_clear(&empty);
+    if(from_empty.user_table != NULL)
+      inf_test_text_format_document_clear(&from_empty);
+  }
+
+  if(result == TRUE)
+    result = inf_test_text_format_corrupted(storage, "compact", 1);
+
+  if(result == TRUE)
+    result = inf_test_text_format_journal(storage, "journal");
+
+  inf_test_text_format_document_clear(&original);
+  if(from_xml.user_table != NULL)
+    inf_test_text_format_document_clear(&from_xml);
+  if(from_compact.user_table != NULL)
+    inf_test_text_format_document_clear(&from_compact);
+  if(from_compressed.user_table != NULL)
+    inf_test_text_format_document_clear(&from_compressed);
+
+  g_object_unref(storage);
+
+  dir = g_dir_open(root_directory, 0, NULL);
+  if(dir != NULL)
+  {
+    while((entry = g_dir_read_name(dir)) != NULL)
+    {
+      entry_path = g_build_filename(root_directory, entry, NULL);
+      g_unlink(entry_path);
+      g_free(entry_path);
+    }
+
+    g_dir_close(dir);
+  }
+
+  g_rmdir(root_directory);
+  g_free(root_directory);
+
+  inf_deinit();
+
+  if(result == FALSE)
+    return -1;
+
+  return 0;
+}
+
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,997 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Puts load on a running infinoted by simulating many clients within one
+ * process. Each client has its own XMPP connection, subscribes to one of the
+ * given documents, joins a user and then types, erases and moves its caret
+ * at a random rate. Since all clients share the same clock, the end-to-end
+ * latency of a request is measured from its execution at the client that
+ * generated it to its execution at every other client subscribed to the
+ * same document. */
+
+#include <libinftext/inf-text-default-buffer.h>
+#include <libinftext/inf-text-session.h>
+#include <libinftext/inf-text-buffer.h>
+#include <libinftext/inf-text-user.h>
+
+#include <libinfinity/client/infc-note-plugin.h>
+#include <libinfinity/client/infc-browser.h>
+
+#include <libinfinity/adopted/inf-adopted-session.h>
+#include <libinfinity/adopted/inf-adopted-algorithm.h>
+
+#include <libinfinity/common/inf-standalone-io.h>
+#include <libinfinity/common/inf-request-result.h>
+#include <libinfinity/common/inf-xmpp-connection.h>
+#include <libinfinity/common/inf-tcp-connection.h>
+#include <libinfinity/common/inf-ip-address.h>
+#include <libinfinity/common/inf-browser.h>
+#include <libinfinity/common/inf-session-proxy.h>
+#include <libinfinity/common/inf-protocol.h>
+#include <libinfinity/common/inf-init.h>
+
+#include <sys/resource.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+typedef struct _InfTestTextLoad InfTestTextLoad;
+
+typedef struct _InfTestTextLoadDocument InfTestTextLoadDocument;
+struct _InfTestTextLoadDocument {
+  gchar* name;
+  /* Execution time at the originating client, indexed by the user ID and
+   * the user's component of the request's state vector */
+  GHashTable* sent;
+};
+
+typedef struct _InfTestTextLoadClient InfTestTextLoadClient;
+struct _InfTestTextLoadClient {
+  InfTestTextLoad* load;
+  gchar* name;
+  InfTestTextLoadDocument* document;
+
+  InfXmppConnection* conn;
+  InfBrowser* browser;
+  InfSessionProxy* proxy;
+  InfSession* session;
+  InfTextUser* user;
+  InfTextBuffer* buffer;
+
+  gint64 subscribe_time;
+  InfIoTimeout* timeout;
+};
+
+struct _InfTestTextLoad {
+  InfStandaloneIo* io;
+
+  gchar* host;
+  gint port;
+  gint n_clients;
+  gdouble rate;
+  gint caret_ratio;
+  gint erase_ratio;
+  gint duration;
+  gint ramp_up;
+  gint server_pid;
+  gboolean unsecured;
+  gboolean json;
+
+  GPtrArray* documents;
+  GPtrArray* clients;
+
+  guint n_joined;
+  guint n_failed;
+  guint64 n_sent;
+  /* Latencies and synchronization times in microseconds */
+  GArray* latencies;
+  GArray* sync_times;
+
+  gint64 start_time;
+  gdouble start_cpu;
+};
+
+static InfSession*
+inf_test_text_load_session_new(InfIo* io,
+                               InfCommunicationManager* manager,
+                               InfSessionStatus status,
+                               InfCommunicationGroup* sync_group,
+                               InfXmlConnection* sync_connection,
+                               const gchar* path,
+                               gpointer user_data)
+{
+  InfTextDefaultBuffer* buffer;
+  InfTextSession* session;
+
+  buffer = inf_text_default_buffer_new("UTF-8");
+  session = inf_text_session_new(
+    manager,
+    INF_TEXT_BUFFER(buffer),
+    io,
+    status,
+    sync_group,
+    sync_connection
+  );
+  g_object_unref(buffer);
+
+  return INF_SESSION(session);
+}
+
+static const InfcNotePlugin INF_TEST_TEXT_LOAD_TEXT_PLUGIN = {
+  NULL, "InfText", inf_test_text_load_session_new
+};
+
+/* Returns the CPU time in seconds the process with the given ID has used so
+ * far, or a negative value if it is not available. */
+static gdouble
+inf_test_text_load_get_cpu_time(gint pid)
+{
+  gchar* filename;
+  gchar* contents;
+  gchar* pos;
+  unsigned long utime;
+  unsigned long stime;
+  int n;
+
+  if(pid <= 0) return -1.0;
+
+  filename = g_strdup_printf("/proc/%d/stat", pid);
+  if(!g_file_get_contents(filename, &contents, NULL, NULL))
+  {
+    g_free(filename);
+    return -1.0;
+  }
+
+  g_free(filename);
+
+  /* Skip the command name, which may contain spaces, and the 11 fields
+   * following it to get to utime and stime. */
+  n = 0;
+  pos = strrchr(contents, ')');
+  if(pos != NULL)
+  {
+    n = sscanf(
+      pos + 1,
+      " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+      &utime,
+      &stime
+    );
+  }
+
+  g_free(contents);
+  if(n != 2) return -1.0;
+
+  return (gdouble)(utime + stime) / sysconf(_SC_CLK_TCK);
+}
+
+static guint32
+inf_test_text_load_percentile(GArray* values,
+                              gdouble percentile)
+{
+  guint index;
+
+  if(values->len == 0) return 0;
+
+  index = (guint)(percentile * values->len);
+  if(index >= values->len) index = values->len - 1;
+  return g_array_index(values, guint32, index);
+}
+
+static gint
+inf_test_text_load_compare_func(gconstpointer first,
+                                gconstpointer second)
+{
+  guint32 a;
+  guint32 b;
+
+  a = *(const guint32*)first;
+  b = *(const guint32*)second;
+  return (a > b) - (a < b);
+}
+
+static void
+inf_test_text_load_client_failed(InfTestTextLoadClient* client,
+                                 const gchar* what,
+                                 const GError* error)
+{
+  fprintf(
+    stderr,
+    "Client %s: %s%s%s\n",
+    client->name,
+    what,
+    error != NULL ? ": " : "",
+    error != NULL ? error->message : ""
+  );
+
+  ++client->load->n_failed;
+  if(client->conn != NULL)
+    inf_xml_connection_close(INF_XML_CONNECTION(client->conn));
+}
+
+static void
+inf_test_text_load_client_schedule_next(InfTestTextLoadClient* client);
+
+static void
+inf_test_text_load_client_next_cb(gpointer user_data)
+{
+  InfTestTextLoadClient* client;
+  guint length;
+  guint caret;
+  gint action;
+  gchar c;
+
+  client = (InfTestTextLoadClient*)user_data;
+  client->timeout = NULL;
+
+  length = inf_text_buffer_get_length(client->buffer);
+  caret = MIN(inf_text_user_get_caret_position(client->user), length);
+  action = g_random_int_range(0, 100);
+
+  if(action < client->load->caret_ratio)
+  {
+    inf_text_user_set_selection(
+      client->user,
+      g_random_int_range(0, length + 1),
+      0,
+      TRUE
+    );
+  }
+  else if(action < client->load->caret_ratio + client->load->erase_ratio &&
+          caret > 0)
+  {
+    inf_text_buffer_erase_text(
+      client->buffer,
+      caret - 1,
+      1,
+      INF_USER(client->user)
+    );
+  }
+  else
+  {
+    if(g_random_int_range(0, 8) == 0)
+      c = ' ';
+    else
+      c = 'a' + g_random_int_range(0, 26);
+
+    inf_text_buffer_insert_text(
+      client->buffer,
+      caret,
+      &c,
+      1,
+      1,
+      INF_USER(client->user)
+    );
+  }
+
+  inf_test_text_load_client_schedule_next(client);
+}
+
+static void
+inf_test_text_load_client_schedule_next(InfTestTextLoadClient* client)
+{
+  gdouble delay;
+
+  /* Uniformly distributed pauses around the average rate */
+  delay = g_random_double_range(0.0, 2000.0 / client->load->rate);
+
+  client->timeout = inf_io_add_timeout(
+    INF_IO(client->load->io),
+    (guint)MAX(delay, 1.0),
+    inf_test_text_load_client_next_cb,
+    client,
+    NULL
+  );
+}
+
+static void
+inf_test_text_load_begin_execute_request_cb(InfAdoptedAlgorithm* algorithm,
+                                            InfAdoptedUser* user,
+                                            InfAdoptedRequest* request,
+                                            gpointer user_data)
+{
+  InfTestTextLoadClient* client;
+  guint user_id;
+  guint64 key;
+  gint64* time;
+  guint32 latency;
+
+  client = (InfTestTextLoadClient*)user_data;
+  user_id = inf_adopted_request_get_user_id(request);
+
+  key = ((guint64)user_id << 32) |
+    inf_adopted_state_vector_get(
+      inf_adopted_request_get_vector(request),
+      user_id
+    );
+
+  if(INF_USER(user) == INF_USER(client->user))
+  {
+    time = g_new(gint64, 2);
+    time[0] = key;
+    time[1] = g_get_monotonic_time();
+    g_hash_table_replace(client->document->sent, &time[0], time);
+    ++client->load->n_sent;
+  }
+  else
+  {
+    time = g_hash_table_lookup(client->document->sent, &key);
+
+    /* Requests issued before we subscribed are not measured */
+    if(time != NULL)
+    {
+      latency = (guint32)MIN(g_get_monotonic_time() - time[1], G_MAXUINT32);
+      g_array_append_val(client->load->latencies, latency);
+    }
+  }
+}
+
+static void
+inf_test_text_load_user_join_cb(InfRequest* request,
+                                const InfRequestResult* result,
+                                const GError* error,
+                                gpointer user_data)
+{
+  InfTestTextLoadClient* client;
+  InfUser* user;
+
+  client = (InfTestTextLoadClient*)user_data;
+
+  if(error != NULL)
+  {
+    inf_test_text_load_client_failed(client, "User join failed", error);
+    return;
+  }
+
+  inf_request_result_get_join_user(result, NULL, &user);
+  client->user = INF_TEXT_USER(user);
+  g_object_ref(client->user);
+
+  client->buffer = INF_TEXT_BUFFER(inf_session_get_buffer(client->session));
+  g_object_ref(client->buffer);
+
+  g_signal_connect(
+    G_OBJECT(
+      inf_adopted_session_get_algorithm(
+        INF_ADOPTED_SESSION(client->session)
+      )
+    ),
+    "begin-execute-request",
+    G_CALLBACK(inf_test_text_load_begin_execute_request_cb),
+    client
+  );
+
+  ++client->load->n_joined;
+  inf_test_text_load_client_schedule_next(client);
+}
+
+static void
+inf_test_text_load_session_running(InfTestTextLoadClient* client)
+{
+  guint32 sync_time;
+
+  sync_time = (guint32)MIN(
+    g_get_monotonic_time() - client->subscribe_time,
+    G_MAXUINT32
+  );
+
+  g_array_append_val(client->load->sync_times, sync_time);
+
+  inf_text_session_join_user(
+    client->proxy,
+    client->name,
+    INF_USER_ACTIVE,
+    g_random_double(),
+    0,
+    0,
+    inf_test_text_load_user_join_cb,
+    client
+  );
+}
+
+static void
+inf_test_text_load_session_notify_status_cb(GObject* object,
+                                            GParamSpec* pspec,
+                                            gpointer user_data)
+{
+  InfTestTextLoadClient* client;
+  client = (InfTestTextLoadClient*)user_data;
+
+  switch(inf_session_get_status(client->session))
+  {
+  case INF_SESSION_RUNNING:
+    if(client->user == NULL)
+      inf_test_text_load_session_running(client);
+    break;
+  case INF_SESSION_CLOSED:
+    inf_test_text_load_client_failed(client, "Session closed", NULL);
+    break;
+  default:
+    break;
+  }
+}
+
+static void
+inf_test_text_load_subscribe_cb(InfRequest* request,
+                                const InfRequestResult* result,
+                                const GError* error,
+                                gpointer user_data)
+{
+  InfTestTextLoadClient* client;
+  client = (InfTestTextLoadClient*)user_data;
+
+  if(error != NULL)
+  {
+    inf_test_text_load_client_failed(client, "Subscription failed", error);
+    return;
+  }
+
+  inf_request_result_get_subscribe_session(
+    result,
+    NULL,
+    NULL,
+    &client->proxy
+  );
+
+  g_object_ref(client->proxy);
+  g_object_get(client->proxy, "session", &client->session, NULL);
+
+  g_signal_connect(
+    G_OBJECT(client->session),
+    "notify::status",
+    G_CALLBACK(inf_test_text_load_session_notify_status_cb),
+    client
+  );
+
+  if(inf_session_get_status(client->session) == INF_SESSION_RUNNING)
+    inf_test_text_load_session_running(client);
+}
+
+static void
+inf_test_text_load_explore_cb(InfRequest* request,
+                              const InfRequestResult* result,
+                              const GError* error,
+                              gpointer user_data)
+{
+  InfTestTextLoadClient* client;
+  InfBrowserIter iter;
+  gboolean have_iter;
+
+  client = (InfTestTextLoadClient*)user_data;
+
+  if(error != NULL)
+  {
+    inf_test_text_load_client_failed(client, "Exploration failed", error);
+    return;
+  }
+
+  inf_browser_get_root(client->browser, &iter);
+  for(have_iter = inf_browser_get_child(client->browser, &iter);
+      have_iter == TRUE;
+      have_iter = inf_browser_get_next(client->browser, &iter))
+  {
+    if(strcmp(inf_browser_get_node_name(client->browser, &iter),
+              client->document->name) == 0)
+    {
+      client->subscribe_time = g_get_monotonic_time();
+
+      inf_browser_subscribe(
+        client->browser,
+        &iter,
+        inf_test_text_load_subscribe_cb,
+        client
+      );
+
+      return;
+    }
+  }
+
+  inf_test_text_load_client_failed(client, "Document does not exist", NULL);
+}
+
+static void
+inf_test_text_load_browser_notify_status_cb(GObject* object,
+                                            GParamSpec* pspec,
+                                            gpointer user_data)
+{
+  InfTestTextLoadClient* client;
+  InfBrowserStatus status;
+  InfBrowserIter iter;
+
+  client = (InfTestTextLoadClient*)user_data;
+  g_object_get(G_OBJECT(client->browser), "status", &status, NULL);
+
+  switch(status)
+  {
+  case INF_BROWSER_OPEN:
+    inf_browser_get_root(client->browser, &iter);
+
+    inf_browser_explore(
+      client->browser,
+      &iter,
+      inf_test_text_load_explore_cb,
+      client
+    );
+
+    break;
+  case INF_BROWSER_CLOSED:
+    if(client->timeout != NULL)
+    {
+      inf_io_remove_timeout(INF_IO(client->load->io), client->timeout);
+      client->timeout = NULL;
+    }
+
+    break;
+  default:
+    break;
+  }
+}
+
+static void
+inf_test_text_load_client_connect_cb(gpointer user_data)
+{
+  InfTestTextLoadClient* client;
+  InfTestTextLoad* load;
+  InfIpAddress* addr;
+  InfTcpConnection* tcp;
+  InfCommunicationManager* manager;
+  GError* error;
+
+  client = (InfTestTextLoadClient*)user_data;
+  load = client->load;
+  client->timeout = NULL;
+
+  addr = inf_ip_address_new_from_string(load->host);
+  if(addr == NULL)
+  {
+    inf_test_text_load_client_failed(client, "Invalid host address", NULL);
+    return;
+  }
+
+  tcp = inf_tcp_connection_new(INF_IO(load->io), addr, load->port);
+  inf_ip_address_free(addr);
+
+  client->conn = inf_xmpp_connection_new(
+    tcp,
+    INF_XMPP_CONNECTION_CLIENT,
+    NULL,
+    load->host,
+    load->unsecured ? INF_XMPP_CONNECTION_SECURITY_ONLY_UNSECURED :
+                      INF_XMPP_CONNECTION_SECURITY_BOTH_PREFER_TLS,
+    NULL,
+    NULL,
+    NULL
+  );
+
+  g_object_unref(tcp);
+
+  manager = inf_communication_manager_new();
+  client->browser = INF_BROWSER(
+    infc_browser_new(
+      INF_IO(load->io),
+      manager,
+      INF_XML_CONNECTION(client->conn)
+    )
+  );
+  g_object_unref(manager);
+
+  infc_browser_add_plugin(
+    INFC_BROWSER(client->browser),
+    &INF_TEST_TEXT_LOAD_TEXT_PLUGIN
+  );
+
+  g_signal_connect_after(
+    G_OBJECT(client->browser),
+    "notify::status",
+    G_CALLBACK(inf_test_text_load_browser_notify_status_cb),
+    client
+  );
+
+  error = NULL;
+  if(!inf_xml_connection_open(INF_XML_CONNECTION(client->conn), &error))
+  {
+    inf_test_text_load_client_failed(client, "Failed to connect", error);
+    g_error_free(error);
+  }
+}
+
+static void
+inf_test_text_load_client_free(gpointer data)
+{
+  InfTestTextLoadClient* client;
+  client = (InfTestTextLoadClient*)data;
+
+  if(client->timeout != NULL)
+    inf_io_remove_timeout(INF_IO(client->load->io), client->timeout);
+
+  if(client->session != NULL)
+  {
+    g_signal_handlers_disconnect_by_func(
+      G_OBJECT(client->session),
+      G_CALLBACK(inf_test_text_load_session_notify_status_cb),
+      client
+    );
+
+    g_signal_handlers_disconnect_by_func(
+      G_OBJECT(
+        inf_adopted_session_get_algorithm(
+          INF_ADOPTED_SESSION(client->session)
+        )
+      ),
+      G_CALLBACK(inf_test_text_load_begin_execute_request_cb),
+      client
+    );
+
+    g_object_unref(client->session);
+  }
+
+  if(client->browser != NULL)
+  {
+    g_signal_handlers_disconnect_by_func(
+      G_OBJECT(client->browser),
+      G_CALLBACK(inf_test_text_load_browser_notify_status_cb),
+      client
+    );
+  }
+
+  if(client->buffer != NULL) g_object_unref(client->buffer);
+  if(client->user != NULL) g_object_unref(client->user);
+  if(client->proxy != NULL) g_object_unref(client->proxy);
+  if(client->browser != NULL) g_object_unref(client->browser);
+  if(client->conn != NULL) g_object_unref(client->conn);
+
+  g_free(client->name);
+  g_slice_free(InfTestTextLoadClient, client);
+}
+
+static void
+inf_test_text_load_document_free(gpointer data)
+{
+  InfTestTextLoadDocument* document;
+  document = (InfTestTextLoadDocument*)data;
+
+  g_hash_table_destroy(document->sent);
+  g_free(document->name);
+  g_slice_free(InfTestTextLoadDocument, document);
+}
+
+static void
+inf_test_text_load_stop_cb(gpointer user_data)
+{
+  InfTestTextLoad* load;
+  load = (InfTestTextLoad*)user_data;
+
+  inf_standalone_io_loop_quit(load->io);
+}
+
+static void
+inf_test_text_load_report(InfTestTextLoad* load)
+{
+  gdouble seconds;
+  gdouble cpu;
+  gdouble cpu_per_op;
+  guint buckets[16];
+  guint32 bound;
+  guint i;
+  guint j;
+
+  seconds = (g_get_monotonic_time() - load->start_time) / 1e6;
+
+  cpu_per_op = -1.0;
+  cpu = inf_test_text_load_get_cpu_time(load->server_pid);
+  if(cpu >= 0.0 && load->start_cpu >= 0.0 && load->n_sent > 0)
+    cpu_per_op = (cpu - load->start_cpu) * 1e6 / load->n_sent;
+
+  g_array_sort(load->latencies, inf_test_text_load_compare_func);
+  g_array_sort(load->sync_times, inf_test_text_load_compare_func);
+
+  if(load->json)
+  {
+    printf(
+      "{ \"clients\": %d, \"joined\": %u, \"failed\": %u, "
+      "\"documents\": %u, \"seconds\": %.3f,\n"
+      "  \"requests\": %" G_GUINT64_FORMAT ", "
+      "\"requests_per_second\": %.1f, \"deliveries\": %u,\n"
+      "  \"latency_us\": { \"p50\": %u, \"p99\": %u, \"p999\": %u, "
+      "\"max\": %u },\n"
+      "  \"sync_time_us\": { \"p50\": %u, \"p99\": %u, \"max\": %u },\n"
+      "  \"server_cpu_us_per_request\": %.1f }\n",
+      load->n_clients,
+      load->n_joined,
+      load->n_failed,
+      load->documents->len,
+      seconds,
+      load->n_sent,
+      seconds > 0.0 ? load->n_sent / seconds : 0.0,
+      load->latencies->len,
+      inf_test_text_load_percentile(load->latencies, 0.5),
+      inf_test_text_load_percentile(load->latencies, 0.99),
+      inf_test_text_load_percentile(load->latencies, 0.999),
+      inf_test_text_load_percentile(load->latencies, 1.0),
+      inf_test_text_load_percentile(load->sync_times, 0.5),
+      inf_test_text_load_percentile(load->sync_times, 0.99),
+      inf_test_text_load_percentile(load->sync_times, 1.0),
+      cpu_per_op
+    );
+
+    return;
+  }
+
+  printf(
+    "%u of %d clients joined (%u failed) on %u documents in %.1f s\n",
+    load->n_joined,
+    load->n_clients,
+    load->n_failed,
+    load->documents->len,
+    seconds
+  );
+
+  printf(
+    "Requests: %" G_GUINT64_FORMAT " (%.1f/s), deliveries: %u\n",
+    load->n_sent,
+    seconds > 0.0 ? load->n_sent / seconds : 0.0,
+    load->latencies->len
+  );
+
+  printf(
+    "Latency: p50 %.2f ms, p99 %.2f ms, p999 %.2f ms, max %.2f ms\n",
+    inf_test_text_load_percentile(load->latencies, 0.5) / 1000.0,
+    inf_test_text_load_percentile(load->latencies, 0.99) / 1000.0,
+    inf_test_text_load_percentile(load->latencies, 0.999) / 1000.0,
+    inf_test_text_load_percentile(load->latencies, 1.0) / 1000.0
+  );
+
+  printf(
+    "Sync time: p50 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+    inf_test_text_load_percentile(load->sync_times, 0.5) / 1000.0,
+    inf_test_text_load_percentile(load->sync_times, 0.99) / 1000.0,
+    inf_test_text_load_percentile(load->sync_times, 1.0) / 1000.0
+  );
+
+  if(cpu_per_op >= 0.0)
+    printf("Server CPU: %.1f us per request\n", cpu_per_op);
+
+  /* Latency histogram with power-of-two buckets, starting at 1 ms */
+  memset(buckets, 0, sizeof(buckets));
+  for(i = 0; i < load->latencies->len; ++i)
+  {
+    bound = 1000;
+    for(j = 0; j < G_N_ELEMENTS(buckets) - 1; ++j, bound *= 2)
+      if(g_array_index(load->latencies, guint32, i) < bound)
+        break;
+    ++buckets[j];
+  }
+
+  bound = 1;
+  for(j = 0; j < G_N_ELEMENTS(buckets); ++j, bound *= 2)
+  {
+    if(buckets[j] == 0) continue;
+
+    if(j < G_N_ELEMENTS(buckets) - 1)
+      printf("  < %6u ms: %u\n", bound, buckets[j]);
+    else
+      printf("  >=%6u ms: %u\n", bound / 2, buckets[j]);
+  }
+}
+
+int
+main(int argc, char* argv[])
+{
+  InfTestTextLoad load;
+  InfTestTextLoadClient* client;
+  InfTestTextLoadDocument* document;
+  GOptionContext* context;
+  gchar* documents;
+  gchar** names;
+  struct rlimit limit;
+  GError* error;
+  gint i;
+
+  GOptionEntry entries[] = {
+    { "host", 'h', 0, G_OPTION_ARG_STRING, NULL,
+      "IP address of the server, defaults to 127.0.0.1", "ADDRESS" },
+    { "port", 'p', 0, G_OPTION_ARG_INT, NULL,
+      "Port of the server", "PORT" },
+    { "clients", 'c', 0, G_OPTION_ARG_INT, NULL,
+      "Number of simulated clients, defaults to 100", "N" },
+    { "documents", 'd', 0, G_OPTION_ARG_STRING, NULL,
+      "Comma-separated names of documents in the root folder to subscribe "
+      "to, clients are distributed evenly; defaults to \"test\"", "NAMES" },
+    { "rate", 'r', 0, G_OPTION_ARG_DOUBLE, NULL,
+      "Average number of requests per second and client, defaults to 5",
+      "RATE" },
+    { "caret", 0, 0, G_OPTION_ARG_INT, NULL,
+      "Percentage of caret movements, defaults to 20", "PERCENT" },
+    { "erase", 0, 0, G_OPTION_ARG_INT, NULL,
+      "Percentage of erased characters, defaults to 15", "PERCENT" },
+    { "duration", 't', 0, G_OPTION_ARG_INT, NULL,
+      "Number of seconds to run, defaults to 60", "SECONDS" },
+    { "ramp-up", 0, 0, G_OPTION_ARG_INT, NULL,
+      "Milliseconds between two client connections, defaults to 10", "MS" },
+    { "server-pid", 0, 0, G_OPTION_ARG_INT, NULL,
+      "Process ID of the server to measure its CPU time", "PID" },
+    { "unsecured", 0, 0, G_OPTION_ARG_NONE, NULL,
+      "Do not use TLS", NULL },
+    { "json", 'j', 0, G_OPTION_ARG_NONE, NULL,
+      "Print the results as JSON", NULL },
+    { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL }
+  };
+
+  load.host = NULL;
+  load.port = inf_protocol_get_default_port();
+  load.n_clients = 100;
+  load.rate = 5.0;
+  load.caret_ratio = 20;
+  load.erase_ratio = 15;
+  load.duration = 60;
+  load.ramp_up = 10;
+  load.server_pid = 0;
+  load.unsecured = FALSE;
+  load.json = FALSE;
+  documents = NULL;
+
+  entries[0].arg_data = &load.host;
+  entries[1].arg_data = &load.port;
+  entries[2].arg_data = &load.n_clients;
+  entries[3].arg_data = &documents;
+  entries[4].arg_data = &load.rate;
+  entries[5].arg_data = &load.caret_ratio;
+  entries[6].arg_data = &load.erase_ratio;
+  entries[7].arg_data = &load.duration;
+  entries[8].arg_data = &load.ramp_up;
+  entries[9].arg_data = &load.server_pid;
+  entries[10].arg_data = &load.unsecured;
+  entries[11].arg_data = &load.json;
+
+  error = NULL;
+  context = g_option_context_new("- simulate many infinote clients");
+  g_option_context_add_main_entries(context, entries, NULL);
+
+  if(!g_option_context_parse(context, &argc, &argv, &error))
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    g_option_context_free(context);
+    return -1;
+  }
+
+  g_option_context_free(context);
+
+  if(load.n_clients < 1 || load.rate <= 0.0 || load.duration < 0 ||
+     load.ramp_up < 0 || load.caret_ratio < 0 || load.erase_ratio < 0 ||
+     load.caret_ratio + load.erase_ratio > 100)
+  {
+    fprintf(stderr, "Invalid load parameters\n");
+    return -1;
+  }
+
+  if(!inf_init(&error))
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return -1;
+  }
+
+  /* Every client needs its own file descriptor */
+  if(getrlimit(RLIMIT_NOFILE, &limit) == 0 &&
+     limit.rlim_cur < limit.rlim_max)
+  {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+
+  if(load.host == NULL)
+    load.host = g_strdup("127.0.0.1");
+
+  load.documents = g_ptr_array_new_with_free_func(
+    inf_test_text_load_document_free
+  );
+
+  names = g_strsplit(documents != NULL ? documents : "test", ",", 0);
+  for(i = 0; names[i] != NULL; ++i)
+  {
+    if(*names[i] == '\0') continue;
+
+    document = g_slice_new(InfTestTextLoadDocument);
+    document->name = g_strdup(names[i]);
+    document->sent = g_hash_table_new_full(
+      g_int64_hash,
+      g_int64_equal,
+      NULL,
+      g_free
+    );
+
+    g_ptr_array_add(load.documents, document);
+  }
+
+  g_strfreev(names);
+  g_free(documents);
+
+  if(load.documents->len == 0)
+  {
+    fprintf(stderr, "No documents given\n");
+    g_ptr_array_free(load.documents, TRUE);
+    g_free(load.host);
+    return -1;
+  }
+
+  load.io = inf_standalone_io_new();
+  load.clients = g_ptr_array_new_with_free_func(
+    inf_test_text_load_client_free
+  );
+
+  load.n_joined = 0;
+  load.n_failed = 0;
+  load.n_sent = 0;
+  load.latencies = g_array_new(FALSE, FALSE, sizeof(guint32));
+  load.sync_times = g_array_new(FALSE, FALSE, sizeof(guint32));
+
+  for(i = 0; i < load.n_clients; ++i)
+  {
+    client = g_slice_new(InfTestTextLoadClient);
+    client->load = &load;
+    client->name = g_strdup_printf("Load%05d", i);
+    client->document = g_ptr_array_index(
+      load.documents,
+      i % load.documents->len
+    );
+
+    client->conn = NULL;
+    client->browser = NULL;
+    client->proxy = NULL;
+    client->session = NULL;
+    client->user = NULL;
+    client->buffer = NULL;
+    client->subscribe_time = 0;
+
+    client->timeout = inf_io_add_timeout(
+      INF_IO(load.io),
+      i * load.ramp_up,
+      inf_test_text_load_client_connect_cb,
+      client,
+      NULL
+    );
+
+    g_ptr_array_add(load.clients, client);
+  }
+
+  inf_io_add_timeout(
+    INF_IO(load.io),
+    load.duration * 1000,
+    inf_test_text_load_stop_cb,
+    &load,
+    NULL
+  );
+
+  load.start_time = g_get_monotonic_time();
+  load.start_cpu = inf_test_text_load_get_cpu_time(load.server_pid);
+
+  inf_standalone_io_loop(load.io);
+  inf_test_text_load_report(&load);
+
+  g_ptr_array_free(load.clients, TRUE);
+  g_ptr_array_free(load.documents, TRUE);
+  g_array_free(load.latencies, TRUE);
+  g_array_free(load.sync_times, TRUE);
+  g_object_unref(load.io);
+  g_free(load.host);
+  return 0;
+}
+
+/* vim:set et sw=2 ts=2: */
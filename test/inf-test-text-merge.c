@@ -0,0 +1,452 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Tests InfTextSession:merge-interval. Local insertions of a host session
+ * are held back and merged into a single request, which is sent to an
+ * observer before anything else the local user does, and when the session
+ * is closed. */
+
+#include <libinftext/inf-text-session.h>
+#include <libinftext/inf-text-default-buffer.h>
+#include <libinftext/inf-text-user.h>
+#include <libinfinity/communication/inf-communication-manager.h>
+#include <libinfinity/common/inf-simulated-connection.h>
+#include <libinfinity/common/inf-standalone-io.h>
+#include <libinfinity/common/inf-user-table.h>
+#include <libinfinity/common/inf-init.h>
+
+#include <string.h>
+#include <stdio.h>
+
+/* Large enough for the merge timeout to never elapse during the test, in
+ * milliseconds */
+#define INF_TEST_TEXT_MERGE_INTERVAL 60000
+
+static const gchar* const INF_TEST_TEXT_MERGE_METHODS[] = {
+  "central",
+  NULL
+};
+
+typedef struct _InfTestTextMerge InfTestTextMerge;
+struct _InfTestTextMerge {
+  InfStandaloneIo* io;
+
+  InfSimulatedConnection* host_observer;
+  InfSimulatedConnection* observer;
+
+  InfCommunicationManager* host_manager;
+  InfCommunicationManager* observer_manager;
+
+  InfCommunicationHostedGroup* host_group;
+  InfCommunicationJoinedGroup* observer_group;
+
+  InfTextSession* host_session;
+  InfTextSession* observer_session;
+
+  /* Requests sent to the observer, one word per request */
+  GString* sent;
+  guint n_errors;
+};
+
+static void
+inf_test_text_merge_received_cb(InfXmlConnection* connection,
+                                xmlNodePtr xml,
+                                gpointer user_data)
+{
+  InfTestTextMerge* test;
+  xmlNodePtr request;
+  xmlNodePtr op;
+  xmlChar* attribute;
+  xmlChar* content;
+
+  test = (InfTestTextMerge*)user_data;
+
+  for(request = xml->children; request != NULL; request = request->next)
+  {
+    if(request->type != XML_ELEMENT_NODE) continue;
+    if(strcmp((const char*)request->name, "request") != 0) continue;
+
+    for(op = request->children; op != NULL; op = op->next)
+      if(op->type == XML_ELEMENT_NODE)
+        break;
+
+    if(op == NULL) continue;
+
+    g_string_append(test->sent, (const char*)op->name);
+
+    attribute = xmlGetProp(op, (const xmlChar*)"pos");
+    if(attribute == NULL)
+      attribute = xmlGetProp(op, (const xmlChar*)"caret");
+
+    if(attribute != NULL)
+    {
+      g_string_append_printf(test->sent, ":%s", (const char*)attribute);
+      xmlFree(attribute);
+    }
+
+    content = xmlNodeGetContent(op);
+    if(content != NULL && *content != '\0')
+      g_string_append_printf(test->sent, ":%s", (const char*)content);
+    if(content != NULL)
+      xmlFree(content);
+
+    g_string_append_c(test->sent, ' ');
+  }
+}
+
+static void
+inf_test_text_merge_error_cb(InfSession* session,
+                             InfXmlConnection* connection,
+                             xmlNodePtr xml,
+                             const GError* error,
+                             gpointer user_data)
+{
+  InfTestTextMerge* test;
+  test = (InfTestTextMerge*)user_data;
+
+  fprintf(stderr, "Session error: %s\n", error->message);
+  ++test->n_errors;
+}
+
+static InfTextSession*
+inf_test_text_merge_session_new(InfTestTextMerge* test,
+                                InfCommunicationManager* manager,
+                                InfUserFlags flags,
+                                InfSimulatedConnection* connection)
+{
+  InfTextBuffer* buffer;
+  InfUserTable* user_table;
+  InfTextUser* user;
+  InfTextSession* session;
+
+  buffer = INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
+  inf_text_buffer_insert_text(buffer, 0, "abc", 3, 3, NULL);
+
+  user = INF_TEXT_USER(
+    g_object_new(
+      INF_TEXT_TYPE_USER,
+      "id", 1,
+      "name", "Writer",
+      "status", INF_USER_ACTIVE,
+      "flags", flags,
+      "connection", connection,
+      NULL
+    )
+  );
+
+  user_table = inf_user_table_new();
+  inf_user_table_add_user(user_table, INF_USER(user));
+  g_object_unref(user);
+
+  session = inf_text_session_new_with_user_table(
+    manager,
+    buffer,
+    INF_IO(test->io),
+    user_table,
+    INF_SESSION_RUNNING,
+    NULL,
+    NULL
+  );
+
+  g_object_unref(user_table);
+  g_object_unref(buffer);
+
+  g_signal_connect(
+    G_OBJECT(session),
+    "error",
+    G_CALLBACK(inf_test_text_merge_error_cb),
+    test
+  );
+
+  return session;
+}
+
+static InfTextUser*
+inf_test_text_merge_get_writer(InfTextSession* session)
+{
+  return INF_TEXT_USER(
+    inf_user_table_lookup_user_by_id(
+      inf_session_get_user_table(INF_SESSION(session)),
+      1
+    )
+  );
+}
+
+static void
+inf_test_text_merge_insert(InfTestTextMerge* test,
+                           guint pos,
+                           const gchar* text)
+{
+  inf_text_buffer_insert_text(
+    INF_TEXT_BUFFER(inf_session_get_buffer(INF_SESSION(test->host_session))),
+    pos,
+    text,
+    strlen(text),
+    strlen(text),
+    INF_USER(inf_test_text_merge_get_writer(test->host_session))
+  );
+}
+
+/* Checks the requests sent so far, and the buffer of the observer which
+ * only contains the modifications that have been sent. */
+static gboolean
+inf_test_text_merge_check(InfTestTextMerge* test,
+                          const gchar* sent,
+                          const gchar* text)
+{
+  InfTextBuffer* buffer;
+  InfTextChunk* chunk;
+  gchar* observer_text;
+  gsize observer_bytes;
+  gboolean result;
+
+  result = TRUE;
+
+  if(strcmp(test->sent->str, sent) != 0)
+  {
+    fprintf(
+      stderr,
+      "Sent \"%s\", expected \"%s\"\n",
+      test->sent->str,
+      sent
+    );
+
+    result = FALSE;
+  }
+
+  buffer = INF_TEXT_BUFFER(
+    inf_session_get_buffer(INF_SESSION(test->observer_session))
+  );
+
+  chunk = inf_text_buffer_get_slice(
+    buffer,
+    0,
+    inf_text_buffer_get_length(buffer)
+  );
+
+  observer_text = inf_text_chunk_get_text(chunk, &observer_bytes);
+
+  if(observer_bytes != strlen(text) ||
+     strncmp(observer_text, text, observer_bytes) != 0)
+  {
+    fprintf(
+      stderr,
+      "Buffer is \"%.*s\" for the observer, expected \"%s\"\n",
+      (int)observer_bytes,
+      observer_text,
+      text
+    );
+
+    result = FALSE;
+  }
+
+  g_free(observer_text);
+  inf_text_chunk_free(chunk);
+
+  if(test->n_errors > 0)
+    result = FALSE;
+
+  return result;
+}
+
+static gboolean
+inf_test_text_merge_run(InfTestTextMerge* test)
+{
+  InfTextUser* user;
+
+  user = inf_test_text_merge_get_writer(test->host_session);
+
+  /* Consecutive insertions are held back */
+  inf_test_text_merge_insert(test, 3, "x");
+  inf_test_text_merge_insert(test, 4, "y");
+  inf_test_text_merge_insert(test, 5, "z");
+
+  if(!inf_test_text_merge_check(test, "", "abc"))
+    return FALSE;
+
+  /* An insertion elsewhere sends them as a single request, and is held
+   * back itself */
+  inf_test_text_merge_insert(test, 0, "1");
+
+  if(!inf_test_text_merge_check(test, "insert-caret:3:xyz ", "abcxyz"))
+    return FALSE;
+
+  /* The caret position refers to the buffer including the held back
+   * insertion, so it is sent before the caret update */
+  inf_text_user_set_selection(user, 2, 0, TRUE);
+
+  if(!inf_test_text_merge_check(
+       test, "insert-caret:3:xyz insert-caret:0:1 move:2 ", "1abcxyz"))
+  {
+    return FALSE;
+  }
+
+  g_string_truncate(test->sent, 0);
+
+  /* The held back insertion is undone, not the one before */
+  inf_test_text_merge_insert(test, 2, "q");
+
+  inf_adopted_session_undo(
+    INF_ADOPTED_SESSION(test->host_session),
+    INF_ADOPTED_USER(user),
+    1
+  );
+
+  if(!inf_test_text_merge_check(
+       test, "insert-caret:2:q undo-caret ", "1abcxyz"))
+  {
+    return FALSE;
+  }
+
+  g_string_truncate(test->sent, 0);
+
+  /* Typing right before closing the session is not lost */
+  inf_test_text_merge_insert(test, 0, "w");
+  inf_session_close(INF_SESSION(test->host_session));
+
+  if(!inf_test_text_merge_check(test, "insert-caret:0:w ", "w1abcxyz"))
+    return FALSE;
+
+  return TRUE;
+}
+
+int
+main(int argc, char* argv[])
+{
+  InfTestTextMerge test;
+  GError* error;
+  gboolean result;
+
+  error = NULL;
+  if(!inf_init(&error))
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return -1;
+  }
+
+  test.io = inf_standalone_io_new();
+  test.sent = g_string_new(NULL);
+  test.n_errors = 0;
+
+  test.host_observer = inf_simulated_connection_new();
+  test.observer = inf_simulated_connection_new();
+  inf_simulated_connection_connect(test.host_observer, test.observer);
+
+  g_signal_connect(
+    G_OBJECT(test.observer),
+    "received",
+    G_CALLBACK(inf_test_text_merge_received_cb),
+    &test
+  );
+
+  test.host_manager = inf_communication_manager_new();
+  test.observer_manager = inf_communication_manager_new();
+
+  test.host_session = inf_test_text_merge_session_new(
+    &test,
+    test.host_manager,
+    INF_USER_LOCAL,
+    NULL
+  );
+
+  test.observer_session = inf_test_text_merge_session_new(
+    &test,
+    test.observer_manager,
+    0,
+    test.observer
+  );
+
+  /* Send caret updates right away, so that only the held back insertions
+   * delay them */
+  g_object_set(
+    G_OBJECT(test.host_session),
+    "merge-interval", INF_TEST_TEXT_MERGE_INTERVAL,
+    "caret-update-interval", 0,
+    NULL
+  );
+
+  test.host_group = inf_communication_manager_open_group(
+    test.host_manager,
+    "InfText",
+    INF_TEST_TEXT_MERGE_METHODS
+  );
+
+  inf_communication_group_set_target(
+    INF_COMMUNICATION_GROUP(test.host_group),
+    INF_COMMUNICATION_OBJECT(test.host_session)
+  );
+
+  inf_session_set_subscription_group(
+    INF_SESSION(test.host_session),
+    INF_COMMUNICATION_GROUP(test.host_group)
+  );
+
+  inf_communication_hosted_group_add_member(
+    test.host_group,
+    INF_XML_CONNECTION(test.host_observer)
+  );
+
+  test.observer_group = inf_communication_manager_join_group(
+    test.observer_manager,
+    "InfText",
+    INF_XML_CONNECTION(test.observer),
+    "central"
+  );
+
+  inf_communication_group_set_target(
+    INF_COMMUNICATION_GROUP(test.observer_group),
+    INF_COMMUNICATION_OBJECT(test.observer_session)
+  );
+
+  inf_session_set_subscription_group(
+    INF_SESSION(test.observer_session),
+    INF_COMMUNICATION_GROUP(test.observer_group)
+  );
+
+  result = inf_test_text_merge_run(&test);
+
+  inf_session_set_subscription_group(INF_SESSION(test.host_session), NULL);
+  inf_session_set_subscription_group(INF_SESSION(test.observer_session), NULL);
+
+  g_object_unref(test.observer_group);
+  g_object_unref(test.host_group);
+
+  g_object_unref(test.observer_session);
+  g_object_unref(test.host_session);
+
+  g_object_unref(test.observer_manager);
+  g_object_unref(test.host_manager);
+
+  inf_xml_connection_close(INF_XML_CONNECTION(test.host_observer));
+  g_object_unref(test.observer);
+  g_object_unref(test.host_observer);
+
+  g_string_free(test.sent, TRUE);
+  g_object_unref(test.io);
+
+  inf_deinit();
+
+  if(result == FALSE)
+    return -1;
+
+  return 0;
+}
+
+/* vim:set et sw=2 ts=2: */
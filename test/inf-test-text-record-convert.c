@@ -0,0 +1,260 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Converts a session record into the binary record format by replaying it
+ * and recording the replayed session again. Afterwards the converted record
+ * is verified by comparing the buffer contents of both records at a number
+ * of positions, which also exercises seeking via checkpoints. */
+
+#include <libinftext/inf-text-session.h>
+#include <libinftext/inf-text-default-buffer.h>
+#include <libinfinity/adopted/inf-adopted-session-replay.h>
+#include <libinfinity/adopted/inf-adopted-session-record.h>
+#include <libinfinity/common/inf-init.h>
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+static InfSession*
+inf_test_text_record_convert_session_new(InfIo* io,
+                                         InfCommunicationManager* manager,
+                                         InfSessionStatus status,
+                                         InfCommunicationGroup* sync_group,
+                                         InfXmlConnection* sync_connection,
+                                         const gchar* path,
+                                         gpointer user_data)
+{
+  InfTextDefaultBuffer* buffer;
+  InfTextSession* session;
+
+  buffer = inf_text_default_buffer_new("UTF-8");
+  session = inf_text_session_new(
+    manager,
+    INF_TEXT_BUFFER(buffer),
+    io,
+    status,
+    sync_group,
+    sync_connection
+  );
+  g_object_unref(buffer);
+
+  return INF_SESSION(session);
+}
+
+static const InfcNotePlugin INF_TEST_TEXT_RECORD_CONVERT_TEXT_PLUGIN = {
+  NULL, "InfText", inf_test_text_record_convert_session_new
+};
+
+static gchar*
+inf_test_text_record_convert_get_text(InfAdoptedSessionReplay* replay)
+{
+  InfAdoptedSession* session;
+  InfTextChunk* chunk;
+  gchar* text;
+  gsize bytes;
+  gchar* result;
+
+  session = inf_adopted_session_replay_get_session(replay);
+  chunk = inf_text_buffer_get_slice(
+    INF_TEXT_BUFFER(inf_session_get_buffer(INF_SESSION(session))),
+    0,
+    inf_text_buffer_get_length(
+      INF_TEXT_BUFFER(inf_session_get_buffer(INF_SESSION(session)))
+    )
+  );
+
+  text = inf_text_chunk_get_text(chunk, &bytes);
+  inf_text_chunk_free(chunk);
+
+  result = g_strndup(text, bytes);
+  g_free(text);
+  return result;
+}
+
+static gboolean
+inf_test_text_record_convert(const gchar* input,
+                             const gchar* output,
+                             guint checkpoint_interval,
+                             guint* n_requests,
+                             GError** error)
+{
+  InfAdoptedSessionReplay* replay;
+  InfAdoptedSessionRecord* record;
+  gboolean result;
+
+  replay = inf_adopted_session_replay_new();
+  result = inf_adopted_session_replay_set_record(
+    replay,
+    input,
+    &INF_TEST_TEXT_RECORD_CONVERT_TEXT_PLUGIN,
+    error
+  );
+
+  if(result == FALSE)
+  {
+    g_object_unref(replay);
+    return FALSE;
+  }
+
+  record = inf_adopted_session_record_new(
+    inf_adopted_session_replay_get_session(replay)
+  );
+
+  g_object_set(
+    G_OBJECT(record),
+    "format", INF_ADOPTED_SESSION_RECORD_FORMAT_BINARY,
+    "checkpoint-interval", checkpoint_interval,
+    NULL
+  );
+
+  result = inf_adopted_session_record_start_recording(record, output, error);
+  if(result == TRUE)
+  {
+    result = inf_adopted_session_replay_play_to_end(replay, error);
+
+    if(result == TRUE)
+      result = inf_adopted_session_record_stop_recording(record, error);
+    else
+      inf_adopted_session_record_stop_recording(record, NULL);
+  }
+
+  *n_requests = inf_adopted_session_replay_get_position(replay);
+
+  g_object_unref(record);
+  g_object_unref(replay);
+  return result;
+}
+
+static gboolean
+inf_test_text_record_convert_verify(const gchar* input,
+                                    const gchar* output,
+                                    guint n_requests,
+                                    GError** error)
+{
+  InfAdoptedSessionReplay* original;
+  InfAdoptedSessionReplay* converted;
+  gchar* original_text;
+  gchar* converted_text;
+  gboolean result;
+  guint step;
+  guint pos;
+
+  original = inf_adopted_session_replay_new();
+  converted = inf_adopted_session_replay_new();
+
+  result = inf_adopted_session_replay_set_record(
+    original,
+    input,
+    &INF_TEST_TEXT_RECORD_CONVERT_TEXT_PLUGIN,
+    error
+  );
+
+  if(result == TRUE)
+  {
+    result = inf_adopted_session_replay_set_record(
+      converted,
+      output,
+      &INF_TEST_TEXT_RECORD_CONVERT_TEXT_PLUGIN,
+      error
+    );
+  }
+
+  /* Compare the contents at ten positions, seeking the converted record
+   * backwards first so that its checkpoints are used. */
+  step = MAX(n_requests / 10, 1);
+  for(pos = 0; result == TRUE && pos <= n_requests; pos += step)
+  {
+    result = inf_adopted_session_replay_seek(original, pos, error);
+    if(result == FALSE) break;
+
+    result = inf_adopted_session_replay_seek(converted, n_requests, error);
+    if(result == FALSE) break;
+
+    result = inf_adopted_session_replay_seek(converted, pos, error);
+    if(result == FALSE) break;
+
+    original_text = inf_test_text_record_convert_get_text(original);
+    converted_text = inf_test_text_record_convert_get_text(converted);
+
+    if(strcmp(original_text, converted_text) != 0)
+    {
+      fprintf(stderr, "Content mismatch after %u requests\n", pos);
+      result = FALSE;
+    }
+
+    g_free(original_text);
+    g_free(converted_text);
+  }
+
+  g_object_unref(converted);
+  g_object_unref(original);
+  return result;
+}
+
+int main(int argc, char* argv[])
+{
+  GError* error;
+  guint checkpoint_interval;
+  guint n_requests;
+
+  if(argc < 3)
+  {
+    fprintf(
+      stderr,
+      "Usage: %s <input-record> <output-record> [checkpoint-interval]\n",
+      argv[0]
+    );
+
+    return -1;
+  }
+
+  checkpoint_interval = 1000;
+  if(argc > 3)
+    checkpoint_interval = strtoul(argv[3], NULL, 10);
+
+  error = NULL;
+  if(!inf_init(&error))
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return -1;
+  }
+
+  if(!inf_test_text_record_convert(argv[1], argv[2], checkpoint_interval,
+                                   &n_requests, &error))
+  {
+    fprintf(stderr, "%s\n", error != NULL ? error->message : "Failed");
+    if(error != NULL) g_error_free(error);
+    return -1;
+  }
+
+  if(!inf_test_text_record_convert_verify(argv[1], argv[2], n_requests,
+                                          &error))
+  {
+    fprintf(stderr, "%s\n", error != NULL ? error->message : "Failed");
+    if(error != NULL) g_error_free(error);
+    return -1;
+  }
+
+  printf("Converted %u requests\n", n_requests);
+  return 0;
+}
+
+/* vim:set et sw=2 ts=2: */
@@ -31,7 +31,14 @@
 #include <libinfinity/adopted/inf-adopted-no-operation.h>
 #include <libinfinity/common/inf-init.h>
 
+#ifndef G_OS_WIN32
+# include <sys/resource.h>
+# include <sys/wait.h>
+# include <unistd.h>
+#endif
+
 #include <string.h>
+#include <errno.h>
 
 typedef struct _InfTestTextReplayUndoGroupingInfo
   InfTestTextReplayUndoGroupingInfo;
@@ -336,16 +343,21 @@ inf_test_text_replay_play_user_table_foreach_func(InfUser* user,
 }
 
 /*
- * Entry point
+ * Replay
  */
 
-int main(int argc, char* argv[])
+/* Replays one record file and checks the buffer contents after every
+ * operation. Unless quiet is set, the progress and the final buffer are
+ * printed. */
+static gboolean
+inf_test_text_replay_file(const gchar* filename,
+                          gboolean quiet,
+                          guint* n_requests)
 {
   InfAdoptedSessionReplay* replay;
   InfAdoptedSession* session;
   GError* error;
-  int i;
-  int ret;
+  gboolean result;
 
   GString* content;
   InfBuffer* buffer;
@@ -353,117 +365,498 @@ int main(int argc, char* argv[])
   InfTestTextReplayUndoGroupingInfo data;
   GSList* item;
 
-  if(argc < 2)
+  if(!quiet)
   {
-    fprintf(stderr, "Usage: %s <record-file1> <record-file2> ...\n", argv[0]);
-    return -1;
+    fprintf(stderr, "%s... ", filename);
+    fflush(stderr);
   }
 
   error = NULL;
-  if(!inf_init(&error))
+  result = TRUE;
+  *n_requests = 0;
+
+  replay = inf_adopted_session_replay_new();
+  inf_adopted_session_replay_set_record(
+    replay,
+    filename,
+    &INF_TEST_TEXT_REPLAY_TEXT_PLUGIN,
+    &error
+  );
+
+  if(error != NULL)
   {
+    if(quiet) fprintf(stderr, "%s: ", filename);
     fprintf(stderr, "%s\n", error->message);
     g_error_free(error);
-    return -1;
-  }
+    error = NULL;
 
-  ret = 0;
-  for(i = 1; i < argc; ++ i)
+    result = FALSE;
+  }
+  else
   {
-    fprintf(stderr, "%s... ", argv[i]);
-    fflush(stderr);
+    session = inf_adopted_session_replay_get_session(replay);
+    buffer = inf_session_get_buffer(INF_SESSION(session));
+    content = inf_test_text_replay_load_buffer(INF_TEXT_BUFFER(buffer));
+    user_table = inf_session_get_user_table(INF_SESSION(session));
+    data.algorithm = inf_adopted_session_get_algorithm(session);
+    data.undo_groupings = NULL;
+
+    g_signal_connect(
+      inf_session_get_buffer(INF_SESSION(session)),
+      "text-inserted",
+      G_CALLBACK(inf_test_text_replay_text_inserted_cb),
+      content
+    );
+
+    g_signal_connect(
+      inf_session_get_buffer(INF_SESSION(session)),
+      "text-erased",
+      G_CALLBACK(inf_test_text_replay_text_erased_cb),
+      content
+    );
+
+    g_signal_connect(
+      data.algorithm,
+      "begin-execute-request",
+      G_CALLBACK(inf_test_text_replay_begin_execute_request_cb),
+      content
+    );
 
-    replay = inf_adopted_session_replay_new();
-    inf_adopted_session_replay_set_record(
-      replay,
-      argv[i],
-      &INF_TEST_TEXT_REPLAY_TEXT_PLUGIN,
-      &error
+    g_signal_connect(
+      data.algorithm,
+      "end-execute-request",
+      G_CALLBACK(inf_test_text_replay_end_execute_request_cb),
+      content
     );
 
-    if(error != NULL)
+    /* Let an undo grouper group stuff, just as a consistency check
+     * that it does not crash or behave otherwise badly. */
+    inf_user_table_foreach_user(
+      user_table,
+      inf_test_text_replay_play_user_table_foreach_func,
+      &data
+    );
+
+    g_signal_connect_after(
+      user_table,
+      "add-user",
+      G_CALLBACK(inf_test_text_replay_add_user_cb),
+      &data
+    );
+
+    if(!inf_adopted_session_replay_play_to_end(replay, &error))
     {
+      if(quiet) fprintf(stderr, "%s: ", filename);
       fprintf(stderr, "%s\n", error->message);
       g_error_free(error);
       error = NULL;
 
-      ret = -1;
+      result = FALSE;
     }
-    else
+    else if(!quiet)
     {
-      session = inf_adopted_session_replay_get_session(replay);
-      buffer = inf_session_get_buffer(INF_SESSION(session));
-      content = inf_test_text_replay_load_buffer(INF_TEXT_BUFFER(buffer));
-      user_table = inf_session_get_user_table(INF_SESSION(session));
-      data.algorithm = inf_adopted_session_get_algorithm(session);
-      data.undo_groupings = NULL;
-
-      g_signal_connect(
-        inf_session_get_buffer(INF_SESSION(session)),
-        "text-inserted",
-        G_CALLBACK(inf_test_text_replay_text_inserted_cb),
-        content
-      );
+      fprintf(stderr, "\n");
+      inf_test_util_print_buffer(INF_TEXT_BUFFER(buffer));
+    }
 
-      g_signal_connect(
-        inf_session_get_buffer(INF_SESSION(session)),
-        "text-erased",
-        G_CALLBACK(inf_test_text_replay_text_erased_cb),
-        content
-      );
+    *n_requests = inf_adopted_session_replay_get_position(replay);
 
-      g_signal_connect(
-        data.algorithm,
-        "begin-execute-request",
-        G_CALLBACK(inf_test_text_replay_begin_execute_request_cb),
-        content
-      );
+    g_string_free(content, TRUE);
+    for(item = data.undo_groupings; item != NULL; item = item->next)
+      g_object_unref(item->data);
+    g_slist_free(data.undo_groupings);
+  }
 
-      g_signal_connect(
-        data.algorithm,
-        "end-execute-request",
-        G_CALLBACK(inf_test_text_replay_end_execute_request_cb),
-        content
-      );
+  g_object_unref(replay);
+  return result;
+}
 
-      /* Let an undo grouper group stuff, just as a consistency check
-       * that it does not crash or behave otherwise badly. */
-      inf_user_table_foreach_user(
-        user_table,
-        inf_test_text_replay_play_user_table_foreach_func,
-        &data
-      );
+#ifndef G_OS_WIN32
+/*
+ * Parallel replay
+ */
 
-      g_signal_connect_after(
-        user_table,
-        "add-user",
-        G_CALLBACK(inf_test_text_replay_add_user_cb),
-        &data
-      );
+typedef enum _InfTestTextReplayStatus {
+  INF_TEST_TEXT_REPLAY_OK,
+  INF_TEST_TEXT_REPLAY_FAILED,
+  INF_TEST_TEXT_REPLAY_CRASHED
+} InfTestTextReplayStatus;
+
+typedef struct _InfTestTextReplayJob InfTestTextReplayJob;
+struct _InfTestTextReplayJob {
+  const gchar* filename;
+  pid_t pid;
+  int fd;
+  gint64 start;
+
+  InfTestTextReplayStatus status;
+  guint n_requests;
+  gdouble seconds;
+  glong peak_rss; /* in KiB */
+};
 
-      if(!inf_adopted_session_replay_play_to_end(replay, &error))
-      {
-        fprintf(stderr, "%s\n", error->message);
-        g_error_free(error);
-        error = NULL;
+static const gchar*
+inf_test_text_replay_status_string(InfTestTextReplayStatus status)
+{
+  switch(status)
+  {
+  case INF_TEST_TEXT_REPLAY_OK: return "ok";
+  case INF_TEST_TEXT_REPLAY_FAILED: return "failed";
+  case INF_TEST_TEXT_REPLAY_CRASHED: return "crashed";
+  default: g_assert_not_reached(); return NULL;
+  }
+}
 
-        ret = -1;
-      }
+static gboolean
+inf_test_text_replay_start_job(InfTestTextReplayJob* job)
+{
+  int fds[2];
+  guint n_requests;
+  gboolean result;
+
+  if(pipe(fds) == -1)
+  {
+    fprintf(stderr, "pipe: %s\n", g_strerror(errno));
+    return FALSE;
+  }
+
+  /* Make sure buffered output is not written twice */
+  fflush(stdout);
+  fflush(stderr);
+
+  job->start = g_get_monotonic_time();
+  job->pid = fork();
+
+  if(job->pid == -1)
+  {
+    fprintf(stderr, "fork: %s\n", g_strerror(errno));
+    close(fds[0]);
+    close(fds[1]);
+    return FALSE;
+  }
+
+  if(job->pid == 0)
+  {
+    close(fds[0]);
+    result = inf_test_text_replay_file(job->filename, TRUE, &n_requests);
+
+    if(write(fds[1], &n_requests, sizeof(n_requests)) !=
+       sizeof(n_requests))
+    {
+      _exit(2);
+    }
+
+    _exit(result ? 0 : 1);
+  }
+
+  close(fds[1]);
+  job->fd = fds[0];
+  return TRUE;
+}
+
+static void
+inf_test_text_replay_finish_job(InfTestTextReplayJob* job,
+                                int status,
+                                const struct rusage* usage)
+{
+  guint n_requests;
+
+  job->seconds = (g_get_monotonic_time() - job->start) / 1e6;
+  job->peak_rss = usage->ru_maxrss;
+
+  if(read(job->fd, &n_requests, sizeof(n_requests)) == sizeof(n_requests))
+    job->n_requests = n_requests;
+  close(job->fd);
+  job->fd = -1;
+
+  if(WIFEXITED(status) && WEXITSTATUS(status) == 0)
+    job->status = INF_TEST_TEXT_REPLAY_OK;
+  else if(WIFEXITED(status))
+    job->status = INF_TEST_TEXT_REPLAY_FAILED;
+  else
+    job->status = INF_TEST_TEXT_REPLAY_CRASHED;
+
+  fprintf(
+    stderr,
+    "%s: %s, %u requests in %.3f s (%.0f requests/s), peak RSS %ld KiB\n",
+    job->filename,
+    inf_test_text_replay_status_string(job->status),
+    job->n_requests,
+    job->seconds,
+    job->seconds > 0.0 ? job->n_requests / job->seconds : 0.0,
+    job->peak_rss
+  );
+}
+
+static void
+inf_test_text_replay_write_json_string(FILE* stream,
+                                       const gchar* str)
+{
+  fputc('"', stream);
+  for(; *str != '\0'; ++str)
+  {
+    if(*str == '"' || *str == '\\')
+      fprintf(stream, "\\%c", *str);
+    else if((guchar)*str < 0x20)
+      fprintf(stream, "\\u%04x", (guint)(guchar)*str);
+    else
+      fputc(*str, stream);
+  }
+  fputc('"', stream);
+}
+
+static void
+inf_test_text_replay_write_summary(FILE* stream,
+                                   InfTestTextReplayJob* jobs,
+                                   guint n_jobs,
+                                   guint n_workers,
+                                   gdouble seconds)
+{
+  guint64 n_requests;
+  glong peak_rss;
+  guint n_failed;
+  guint i;
+
+  n_requests = 0;
+  peak_rss = 0;
+  n_failed = 0;
+
+  fprintf(stream, "{\n  \"files\": [\n");
+  for(i = 0; i < n_jobs; ++i)
+  {
+    fprintf(stream, "    { \"file\": ");
+    inf_test_text_replay_write_json_string(stream, jobs[i].filename);
+    fprintf(
+      stream,
+      ", \"status\": \"%s\", \"requests\": %u, \"seconds\": %.6f, "
+      "\"requests_per_second\": %.1f, \"peak_rss_kib\": %ld }%s\n",
+      inf_test_text_replay_status_string(jobs[i].status),
+      jobs[i].n_requests,
+      jobs[i].seconds,
+      jobs[i].seconds > 0.0 ? jobs[i].n_requests / jobs[i].seconds : 0.0,
+      jobs[i].peak_rss,
+      i + 1 < n_jobs ? "," : ""
+    );
+
+    n_requests += jobs[i].n_requests;
+    peak_rss = MAX(peak_rss, jobs[i].peak_rss);
+    if(jobs[i].status != INF_TEST_TEXT_REPLAY_OK)
+      ++n_failed;
+  }
+
+  fprintf(
+    stream,
+    "  ],\n"
+    "  \"workers\": %u,\n"
+    "  \"files_total\": %u,\n"
+    "  \"files_failed\": %u,\n"
+    "  \"requests\": %" G_GUINT64_FORMAT ",\n"
+    "  \"seconds\": %.6f,\n"
+    "  \"requests_per_second\": %.1f,\n"
+    "  \"peak_rss_kib\": %ld\n"
+    "}\n",
+    n_workers,
+    n_jobs,
+    n_failed,
+    n_requests,
+    seconds,
+    seconds > 0.0 ? n_requests / seconds : 0.0,
+    peak_rss
+  );
+}
+
+/* Replays each file in a separate process, running up to n_workers
+ * processes at a time. Processes give per-file peak memory usage and keep
+ * a crashing replay from taking down the whole run. */
+static gboolean
+inf_test_text_replay_parallel(gchar** filenames,
+                              guint n_workers,
+                              const gchar* summary)
+{
+  InfTestTextReplayJob* jobs;
+  guint n_jobs;
+  guint next;
+  guint running;
+  gboolean result;
+  gint64 start;
+  struct rusage usage;
+  int status;
+  pid_t pid;
+  FILE* stream;
+  guint i;
+
+  n_jobs = g_strv_length(filenames);
+  jobs = g_new0(InfTestTextReplayJob, n_jobs);
+  for(i = 0; i < n_jobs; ++i)
+  {
+    jobs[i].filename = filenames[i];
+    jobs[i].fd = -1;
+    jobs[i].status = INF_TEST_TEXT_REPLAY_CRASHED;
+  }
+
+  result = TRUE;
+  start = g_get_monotonic_time();
+  next = 0;
+  running = 0;
+
+  while(next < n_jobs || running > 0)
+  {
+    if(next < n_jobs && running < n_workers)
+    {
+      if(inf_test_text_replay_start_job(&jobs[next]))
+        ++running;
       else
+        result = FALSE;
+
+      ++next;
+      continue;
+    }
+
+    pid = wait4(-1, &status, 0, &usage);
+    if(pid == -1)
+    {
+      if(errno == EINTR) continue;
+      fprintf(stderr, "wait4: %s\n", g_strerror(errno));
+      result = FALSE;
+      break;
+    }
+
+    for(i = 0; i < next; ++i)
+    {
+      if(jobs[i].pid == pid && jobs[i].fd != -1)
       {
-        fprintf(stderr, "\n");
-        inf_test_util_print_buffer(INF_TEXT_BUFFER(buffer));
+        inf_test_text_replay_finish_job(&jobs[i], status, &usage);
+        if(jobs[i].status != INF_TEST_TEXT_REPLAY_OK)
+          result = FALSE;
+        --running;
+        break;
       }
+    }
+  }
 
-      g_string_free(content, TRUE);
-      for(item = data.undo_groupings; item != NULL; item = item->next)
-        g_object_unref(item->data);
-      g_slist_free(data.undo_groupings);
+  if(summary == NULL || strcmp(summary, "-") == 0)
+  {
+    stream = stdout;
+  }
+  else
+  {
+    stream = fopen(summary, "w");
+    if(stream == NULL)
+    {
+      fprintf(stderr, "%s: %s\n", summary, g_strerror(errno));
+      g_free(jobs);
+      return FALSE;
     }
+  }
+
+  inf_test_text_replay_write_summary(
+    stream,
+    jobs,
+    n_jobs,
+    n_workers,
+    (g_get_monotonic_time() - start) / 1e6
+  );
 
-    g_object_unref(replay);
+  if(stream != stdout)
+    fclose(stream);
+
+  g_free(jobs);
+  return result;
+}
+#endif
+
+/*
+ * Entry point
+ */
+
+int main(int argc, char* argv[])
+{
+  GOptionContext* context;
+  GError* error;
+  gchar** filenames;
+  gint jobs;
+  gchar* summary;
+  guint n_requests;
+  int ret;
+  guint i;
+
+  GOptionEntry entries[] = {
+    { "jobs", 'j', 0,
+      G_OPTION_ARG_INT, NULL,
+      "Replay files in up to N parallel processes, printing timing and "
+      "memory usage. 0 uses one process per CPU.", "N" },
+    { "summary", 's', 0,
+      G_OPTION_ARG_FILENAME, NULL,
+      "Write a JSON summary of a parallel replay to FILE instead of "
+      "standard output", "FILE" },
+    { G_OPTION_REMAINING, 0, 0,
+      G_OPTION_ARG_FILENAME_ARRAY, NULL,
+      NULL, NULL },
+    { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL }
+  };
+
+  filenames = NULL;
+  jobs = -1;
+  summary = NULL;
+
+  entries[0].arg_data = &jobs;
+  entries[1].arg_data = &summary;
+  entries[2].arg_data = &filenames;
+
+  error = NULL;
+  context = g_option_context_new("<record-file1> <record-file2> ...");
+  g_option_context_add_main_entries(context, entries, NULL);
+
+  if(!g_option_context_parse(context, &argc, &argv, &error))
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    g_option_context_free(context);
+    return -1;
+  }
+
+  g_option_context_free(context);
+
+  if(filenames == NULL || filenames[0] == NULL)
+  {
+    fprintf(stderr, "Usage: %s <record-file1> <record-file2> ...\n", argv[0]);
+    g_strfreev(filenames);
+    g_free(summary);
+    return -1;
+  }
+
+  if(!inf_init(&error))
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    g_strfreev(filenames);
+    g_free(summary);
+    return -1;
+  }
+
+  ret = 0;
+  if(jobs >= 0)
+  {
+#ifndef G_OS_WIN32
+    if(jobs == 0)
+      jobs = g_get_num_processors();
+
+    if(!inf_test_text_replay_parallel(filenames, jobs, summary))
+      ret = -1;
+#else
+    fprintf(stderr, "Parallel replay is not supported on this platform\n");
+    ret = -1;
+#endif
+  }
+  else
+  {
+    for(i = 0; filenames[i] != NULL; ++i)
+      if(!inf_test_text_replay_file(filenames[i], FALSE, &n_requests))
+        ret = -1;
   }
 
+  g_strfreev(filenames);
+  g_free(summary);
   return ret;
 }
 
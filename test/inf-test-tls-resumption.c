@@ -0,0 +1,308 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Measures the CPU time of TLS handshakes with and without session
+ * resumption via InfCertificateCredentials. */
+
+#include <libinfinity/common/inf-certificate-credentials.h>
+#include <libinfinity/common/inf-cert-util.h>
+#include <libinfinity/common/inf-init.h>
+
+#include <sys/socket.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <time.h>
+
+#define INF_TEST_TLS_RESUMPTION_ROUNDS 20
+
+typedef struct _InfTestTlsResumptionServer InfTestTlsResumptionServer;
+struct _InfTestTlsResumptionServer {
+  InfCertificateCredentials* creds;
+  int fd;
+  int result;
+};
+
+static gpointer
+inf_test_tls_resumption_server_func(gpointer data)
+{
+  InfTestTlsResumptionServer* server;
+  const gnutls_datum_t* ticket_key;
+  gnutls_session_t session;
+  int res;
+
+  server = (InfTestTlsResumptionServer*)data;
+
+  gnutls_init(&session, GNUTLS_SERVER);
+  gnutls_priority_set_direct(session, "NORMAL", NULL);
+  gnutls_credentials_set(
+    session,
+    GNUTLS_CRD_CERTIFICATE,
+    inf_certificate_credentials_get(server->creds)
+  );
+
+  ticket_key = inf_certificate_credentials_get_session_ticket_key(
+    server->creds
+  );
+
+  if(ticket_key != NULL)
+    gnutls_session_ticket_enable_server(session, ticket_key);
+
+  gnutls_transport_set_int(session, server->fd);
+
+  do
+  {
+    res = gnutls_handshake(session);
+  } while(res < 0 && gnutls_error_is_fatal(res) == 0);
+
+  /* Send some application data, so that the client also processes a
+   * TLS 1.3 session ticket that is sent after the handshake. */
+  if(res == GNUTLS_E_SUCCESS)
+    res = gnutls_record_send(session, "x", 1);
+  if(res >= 0)
+    res = gnutls_bye(session, GNUTLS_SHUT_WR);
+
+  server->result = res;
+  gnutls_deinit(session);
+  return NULL;
+}
+
+/* Performs a handshake between a client and a server. Returns -1 on error,
+ * or whether the client resumed its previous session. */
+static int
+inf_test_tls_resumption_connect(InfCertificateCredentials* server_creds,
+                                InfCertificateCredentials* client_creds)
+{
+  InfTestTlsResumptionServer server;
+  gnutls_session_t session;
+  GThread* thread;
+  int fds[2];
+  char buf[1];
+  int res;
+  int resumed;
+
+  if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+    return -1;
+
+  server.creds = server_creds;
+  server.fd = fds[0];
+  server.result = 0;
+
+  thread = g_thread_new(
+    "server",
+    inf_test_tls_resumption_server_func,
+    &server
+  );
+
+  gnutls_init(&session, GNUTLS_CLIENT);
+  gnutls_priority_set_direct(session, "NORMAL", NULL);
+  gnutls_credentials_set(
+    session,
+    GNUTLS_CRD_CERTIFICATE,
+    inf_certificate_credentials_get(client_creds)
+  );
+
+  inf_certificate_credentials_restore_session(
+    client_creds,
+    "localhost",
+    session
+  );
+
+  gnutls_transport_set_int(session, fds[1]);
+
+  do
+  {
+    res = gnutls_handshake(session);
+  } while(res < 0 && gnutls_error_is_fatal(res) == 0);
+
+  if(res == GNUTLS_E_SUCCESS)
+  {
+    do
+    {
+      res = gnutls_record_recv(session, buf, sizeof(buf));
+    } while(res == GNUTLS_E_AGAIN || res == GNUTLS_E_INTERRUPTED);
+  }
+
+  resumed = gnutls_session_is_resumed(session) ? 1 : 0;
+  if(res >= 0)
+  {
+    inf_certificate_credentials_store_session(
+      client_creds,
+      "localhost",
+      session
+    );
+  }
+
+  gnutls_deinit(session);
+  close(fds[1]);
+
+  g_thread_join(thread);
+  close(fds[0]);
+
+  if(res < 0 || server.result < 0)
+  {
+    fprintf(
+      stderr,
+      "Handshake failed: %s\n",
+      gnutls_strerror(res < 0 ? res : server.result)
+    );
+
+    return -1;
+  }
+
+  return resumed;
+}
+
+/* Returns the CPU time for a number of handshakes in milliseconds, or a
+ * negative value on error. */
+static double
+inf_test_tls_resumption_run(InfCertificateCredentials* server_creds,
+                            InfCertificateCredentials* client_creds,
+                            gboolean expect_resumed)
+{
+  clock_t start;
+  int res;
+  guint i;
+
+  /* The first connection always performs a full handshake */
+  if(inf_test_tls_resumption_connect(server_creds, client_creds) < 0)
+    return -1.0;
+
+  start = clock();
+  for(i = 0; i < INF_TEST_TLS_RESUMPTION_ROUNDS; ++i)
+  {
+    res = inf_test_tls_resumption_connect(server_creds, client_creds);
+    if(res < 0)
+      return -1.0;
+
+    if(res != (expect_resumed ? 1 : 0))
+    {
+      fprintf(
+        stderr,
+        "Session was %sresumed unexpectedly\n",
+        res ? "" : "not "
+      );
+
+      return -1.0;
+    }
+  }
+
+  return (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+int
+main(int argc, char* argv[])
+{
+  InfCertUtilDescription desc;
+  gnutls_x509_privkey_t key;
+  gnutls_x509_crt_t cert;
+  InfCertificateCredentials* server_creds;
+  InfCertificateCredentials* client_creds;
+  GError* error;
+  double full_time;
+  double resumed_time;
+  int res;
+
+  error = NULL;
+  if(!inf_init(&error))
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return 1;
+  }
+
+  key = inf_cert_util_create_private_key(GNUTLS_PK_RSA, 2048, &error);
+  if(key == NULL)
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return 1;
+  }
+
+  desc.validity = 3600;
+  desc.dn_common_name = "localhost";
+  desc.san_dnsname = "localhost";
+
+  cert = inf_cert_util_create_self_signed_certificate(key, &desc, &error);
+  if(cert == NULL)
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    gnutls_x509_privkey_deinit(key);
+    return 1;
+  }
+
+  server_creds = inf_certificate_credentials_new();
+  res = gnutls_certificate_set_x509_key(
+    inf_certificate_credentials_get(server_creds),
+    &cert,
+    1,
+    key
+  );
+
+  gnutls_x509_crt_deinit(cert);
+  gnutls_x509_privkey_deinit(key);
+
+  if(res != GNUTLS_E_SUCCESS)
+  {
+    fprintf(stderr, "%s\n", gnutls_strerror(res));
+    inf_certificate_credentials_unref(server_creds);
+    return 1;
+  }
+
+  /* Without a ticket key, every handshake is a full one */
+  client_creds = inf_certificate_credentials_new();
+  full_time = inf_test_tls_resumption_run(server_creds, client_creds, FALSE);
+  inf_certificate_credentials_unref(client_creds);
+
+  if(full_time < 0.0)
+  {
+    inf_certificate_credentials_unref(server_creds);
+    return 1;
+  }
+
+  if(!inf_certificate_credentials_rotate_session_ticket_key(server_creds,
+                                                            &error))
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    inf_certificate_credentials_unref(server_creds);
+    return 1;
+  }
+
+  client_creds = inf_certificate_credentials_new();
+  resumed_time =
+    inf_test_tls_resumption_run(server_creds, client_creds, TRUE);
+  inf_certificate_credentials_unref(client_creds);
+  inf_certificate_credentials_unref(server_creds);
+
+  if(resumed_time < 0.0)
+    return 1;
+
+  printf(
+    "%u full handshakes: %.1f ms CPU\n"
+    "%u resumed handshakes: %.1f ms CPU\n",
+    INF_TEST_TLS_RESUMPTION_ROUNDS, full_time,
+    INF_TEST_TLS_RESUMPTION_ROUNDS, resumed_time
+  );
+
+  inf_deinit();
+  return 0;
+}
+
+/* vim:set et sw=2 ts=2: */